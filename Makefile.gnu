@@ -11,7 +11,7 @@ INSTALLDIR ?= $(DESTDIR)/usr/lib
 # Converts cr/lf to just lf
 DOS2UNIX = dos2unix
 
-LIBRARIES = -lstdc++
+LIBRARIES = -lstdc++ -lpthread
 
 MODULES = $(SRCS:.c=.o)
 MODULES := $(MODULES:.cpp=.o)
@@ -24,6 +24,8 @@ CFLAGS += -DOPJ_STATIC
 CFLAGS += -DNO_LCMS
 # LibJXR
 CFLAGS += -DDISABLE_PERF_MEASUREMENT -D__ANSI__
+# LibPNG, ZLib SIMD code paths
+CFLAGS += -DPNG_INTEL_SSE -DZ_CRC32_SIMD
 CFLAGS += $(INCLUDE)
 
 # C++ flags
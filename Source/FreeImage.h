@@ -461,7 +461,7 @@ FI_ENUM(FREE_IMAGE_QUANTIZE) {
 };
 
 /** Dithering algorithms.
-Constants used in FreeImage_Dither.
+Constants used in FreeImage_Dither, FreeImage_DitherToPalette and FreeImage_ColorQuantizeDither.
 */
 FI_ENUM(FREE_IMAGE_DITHER) {
     FID_FS			= 0,	//! Floyd & Steinberg error diffusion
@@ -470,7 +470,8 @@ FI_ENUM(FREE_IMAGE_DITHER) {
 	FID_CLUSTER6x6	= 3,	//! Ordered clustered dot dithering (order 3 - 6x6 matrix)
 	FID_CLUSTER8x8	= 4,	//! Ordered clustered dot dithering (order 4 - 8x8 matrix)
 	FID_CLUSTER16x16= 5,	//! Ordered clustered dot dithering (order 8 - 16x16 matrix)
-	FID_BAYER16x16	= 6		//! Bayer ordered dispersed dot dithering (order 4 dithering matrix)
+	FID_BAYER16x16	= 6,	//! Bayer ordered dispersed dot dithering (order 4 dithering matrix)
+	FID_SIERRALITE	= 7		//! Sierra Lite error diffusion
 };
 
 /** Lossless JPEG transformations
@@ -524,6 +525,56 @@ FI_ENUM(FREE_IMAGE_COLOR_CHANNEL) {
 	FICC_PHASE	= 9		//! Complex images: use phase
 };
 
+/** Point adjustments.
+Constants used in FreeImage_AdjustChain.
+*/
+FI_ENUM(FREE_IMAGE_ADJUST) {
+	FIADJ_BRIGHTNESS	= 0,	//! Brightness, value is a percentage (-100 <= value <= 100)
+	FIADJ_CONTRAST		= 1,	//! Contrast, value is a percentage (-100 <= value <= 100)
+	FIADJ_GAMMA			= 2,	//! Gamma correction, value is the gamma (value > 0)
+	FIADJ_INVERT		= 3,	//! Inversion, value is ignored
+	FIADJ_CURVE			= 4		//! Lookup table of 256 entries, value is ignored
+};
+
+/** One step of an adjustment chain.
+*/
+FI_STRUCT (FIADJUSTMENT) {
+	FREE_IMAGE_ADJUST type;				//! adjustment performed by this step
+	double value;						//! percentage or gamma value
+	BYTE *LUT;							//! lookup table of a FIADJ_CURVE step
+	FREE_IMAGE_COLOR_CHANNEL channel;	//! channel(s) processed by this step
+};
+
+/** Image statistics.
+Channels are stored in red, green, blue, alpha order, or as a single channel for 
+greyscale, FIT_UINT16 and FIT_FLOAT images.
+*/
+FI_STRUCT (FISTATISTICS) {
+	unsigned channels;	//! number of channels (1, 3 or 4)
+	double min[4];		//! smallest sample value of each channel
+	double max[4];		//! largest sample value of each channel
+	double mean[4];		//! mean sample value of each channel
+	double stddev[4];	//! standard deviation of the sample values of each channel
+};
+
+/** Porter-Duff compositing operators.
+Constants used in FreeImage_AlphaComposite.
+*/
+FI_ENUM(FREE_IMAGE_COMPOSITE_OP) {
+	FICO_CLEAR		= 0,	//! Clear the destination
+	FICO_SRC		= 1,	//! Copy the source
+	FICO_DST		= 2,	//! Keep the destination
+	FICO_SRC_OVER	= 3,	//! Source over the destination
+	FICO_DST_OVER	= 4,	//! Destination over the source
+	FICO_SRC_IN		= 5,	//! Part of the source inside the destination
+	FICO_DST_IN		= 6,	//! Part of the destination inside the source
+	FICO_SRC_OUT	= 7,	//! Part of the source outside the destination
+	FICO_DST_OUT	= 8,	//! Part of the destination outside the source
+	FICO_SRC_ATOP	= 9,	//! Source inside the destination, over the destination
+	FICO_DST_ATOP	= 10,	//! Destination inside the source, over the source
+	FICO_XOR		= 11	//! Parts of the source and of the destination outside each other
+};
+
 // Metadata support ---------------------------------------------------------
 
 /**
@@ -622,12 +673,46 @@ FI_STRUCT (FIMEMORY) { void *data; };
 
 FI_STRUCT(FreeImageLoadArgs) {
 	unsigned flags;      //< lower 16 bits: same as old flags argument
-	unsigned option;     //< lower 16 bits: FIF_JPEG: desired downscale size
+	unsigned option;     //< lower 16 bits: FIF_JPEG, FIF_RAW, FIF_WEBP: desired downscale size
 
 	unsigned cbOption;   //< lower 8 bits: number of times onProgress should be called while loading
 	const struct FreeImageCB* cb;
 
-	void* more;
+	void* more;          //< optional format specific arguments (e.g. FreeImageEXRLoadArgs), ignored by other formats
+};
+
+/**
+Format specific load arguments, passed with FreeImageLoadArgs::more. 
+They all start with the format they are meant for, so that a plugin can tell its own arguments from those of another format.
+*/
+FI_STRUCT(FreeImageEXRLoadArgs) {
+	FREE_IMAGE_FORMAT format; //< FIF_EXR
+	int threads;              //< number of decoding threads: 0 = automatic, 1 = calling thread only
+
+	int left, top;            //< sub-rectangle to load, in data window coordinates
+	int width, height;        //< size of the sub-rectangle, 0 = whole data window
+
+	int level_x, level_y;     //< level to load from a tiled mipmap (level_x only) or ripmap file, 0 = full resolution
+};
+
+FI_STRUCT(FreeImageRAWLoadArgs) {
+	FREE_IMAGE_FORMAT format; //< FIF_RAW
+	int threads;              //< number of processing threads when LibRaw is built with OpenMP: 0 = automatic, 1 = calling thread only
+	int demosaic;             //< demosaicing algorithm, one of the RAW_DEMOSAIC_xxx constants
+};
+
+FI_STRUCT(FreeImageWebPLoadArgs) {
+	FREE_IMAGE_FORMAT format; //< FIF_WEBP
+	int threads;              //< decoding threads: 0 = automatic, 1 = calling thread only
+
+	BOOL bypass_filtering;    //< skip the in-loop deblocking filter of lossy images (faster, lower quality)
+	BOOL no_fancy_upsampling; //< use pointwise instead of smooth chroma upsampling for lossy images (faster)
+
+	int left, top;            //< crop rectangle, applied before scaling
+	int width, height;        //< size of the crop rectangle, 0 = whole image
+
+	int scaled_width;         //< output size, applied after cropping: 0 = no scaling, 
+	int scaled_height;        //< a single 0 keeps the aspect ratio (see also FreeImageLoadArgs::option)
 };
 
 #ifndef PLUGINS
@@ -650,6 +735,7 @@ typedef BOOL (DLL_CALLCONV *FI_SupportsExportBPPProc)(int bpp);
 typedef BOOL (DLL_CALLCONV *FI_SupportsExportTypeProc)(FREE_IMAGE_TYPE type);
 typedef BOOL (DLL_CALLCONV *FI_SupportsICCProfilesProc)(void);
 typedef BOOL (DLL_CALLCONV *FI_SupportsNoPixelsProc)(void);
+typedef void *(DLL_CALLCONV *FI_AppendProc)(FreeImageIO *io, fi_handle handle);
 
 FI_STRUCT (Plugin) {
 	FI_FormatProc format_proc;
@@ -669,6 +755,7 @@ FI_STRUCT (Plugin) {
 	FI_SupportsExportTypeProc supports_export_type_proc;
 	FI_SupportsICCProfilesProc supports_icc_profiles_proc;
 	FI_SupportsNoPixelsProc supports_no_pixels_proc;
+	FI_AppendProc append_proc;
 };
 
 typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
@@ -683,7 +770,10 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define BMP_DEFAULT         0
 #define BMP_SAVE_RLE        1
 #define CUT_DEFAULT         0
-#define DDS_DEFAULT			0
+#define DDS_DEFAULT			0		//! save 24-bit images as BC1 (DXT1), 32-bit images as BC3 (DXT5)
+#define DDS_BC1				0x0001	//! save with BC1 (DXT1) compression, 32-bit pixels with alpha < 128 become transparent
+#define DDS_BC3				0x0002	//! save with BC3 (DXT5) compression
+#define DDS_FAST			0x0004	//! fast compression: bounding box endpoints, no refinement
 #define EXR_DEFAULT			0		//! save data as half with piz-based wavelet compression
 #define EXR_FLOAT			0x0001	//! save data as float instead of as half (not recommended)
 #define EXR_NONE			0x0002	//! save with no compression
@@ -692,6 +782,8 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define EXR_PXR24			0x0010	//! save with lossy 24-bit float compression
 #define EXR_B44				0x0020	//! save with lossy 44% float compression - goes to 22% when combined with EXR_LC
 #define EXR_LC				0x0040	//! save images with one luminance and two chroma channels, rather than as RGB (lossy compression)
+#define EXR_TILED			0x0080	//! save as a tiled file, with 64x64 tiles unless a size is given with EXR_TILE_SIZE (ignored with EXR_LC)
+#define EXR_TILE_SIZE(size)	(EXR_TILED | (((size) & 0x7FFF) << 16))	//! save as a tiled file with size x size tiles (use | to combine with other save flags)
 #define FAXG3_DEFAULT		0
 #define GIF_DEFAULT			0
 #define GIF_LOAD256			1		//! load the image as a 256 color image with ununsed palette entries, if it's 16 or 2 color
@@ -737,6 +829,10 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define PNG_Z_BEST_COMPRESSION		0x0009	//! save using ZLib level 9 compression flag (default value is 6)
 #define PNG_Z_NO_COMPRESSION		0x0100	//! save without ZLib compression
 #define PNG_INTERLACED				0x0200	//! save using Adam7 interlacing (use | to combine with other save flags)
+#define PNG_Z_RLE					0x0400	//! save using the ZLib Z_RLE strategy (use | to combine with a compression level)
+#define PNG_FAST_FILTERING			0x0800	//! save using a cheap row filter selection (SUB or UP only)
+#define PNG_PARALLEL				0x1000	//! save compressing the image data on all available threads (ignored with PNG_INTERLACED)
+#define PNG_Z_FASTEST				(PNG_Z_BEST_SPEED | PNG_Z_RLE | PNG_FAST_FILTERING)	//! save using the fastest settings (ZLib level 1, Z_RLE strategy, fast filtering)
 #define PNM_DEFAULT         0
 #define PNM_SAVE_RAW        0       //! if set the writer saves in RAW format (i.e. P4, P5 or P6)
 #define PNM_SAVE_ASCII      1       //! if set the writer saves in ASCII format (i.e. P1, P2 or P3)
@@ -752,6 +848,14 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define RAW_DISPLAY			2		//! load the file as RGB 24-bit
 #define RAW_HALFSIZE		4		//! output a half-size color image
 #define RAW_UNPROCESSED		8		//! output a FIT_UINT16 raw Bayer image
+#define RAW_DEMOSAIC_DEFAULT	0	//! FreeImageRAWLoadArgs::demosaic: default algorithm (AHD)
+#define RAW_DEMOSAIC_BILINEAR	1	//! FreeImageRAWLoadArgs::demosaic: bilinear interpolation (fastest)
+#define RAW_DEMOSAIC_VNG		2	//! FreeImageRAWLoadArgs::demosaic: Variable Number of Gradients
+#define RAW_DEMOSAIC_PPG		3	//! FreeImageRAWLoadArgs::demosaic: Patterned Pixel Grouping
+#define RAW_DEMOSAIC_AHD		4	//! FreeImageRAWLoadArgs::demosaic: Adaptive Homogeneity-Directed
+#define RAW_DEMOSAIC_DCB		5	//! FreeImageRAWLoadArgs::demosaic: DCB
+#define RAW_DEMOSAIC_DHT		6	//! FreeImageRAWLoadArgs::demosaic: DHT
+#define RAW_DEMOSAIC_AAHD		7	//! FreeImageRAWLoadArgs::demosaic: modified AHD
 #define SGI_DEFAULT			0
 #define TARGA_DEFAULT       0
 #define TARGA_LOAD_RGB888   1       //! if set the loader converts RGB555 and ARGB8888 -> RGB888.
@@ -772,6 +876,14 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define XPM_DEFAULT			0
 #define WEBP_DEFAULT		0		//! save with good quality (75:1)
 #define WEBP_LOSSLESS		0x100	//! save in lossless mode
+#define WEBP_FAST			0x200	//! save with a fast encoding preset (low method, multi-threaded), for latency sensitive paths
+#define WEBP_BEST			0x400	//! save with the slowest, best compressing preset, for offline jobs
+#define WEBP_MULTITHREAD	0x800	//! use multi-threaded encoding
+#define WEBP_LOW_MEMORY		0x1000	//! reduce the encoder memory usage, at the cost of CPU time
+#define WEBP_ANIMATION_FRAME	0x2000	//! save a single image carrying FIMD_ANIMATION metadata as a one-frame animation, keeping its frame time and loop count
+#define WEBP_METHOD(method)		((((method) & 0x7) + 1) << 16)	//! save with a given quality/speed trade-off, from 0 (fast) to 6 (slower, smaller), overrides the preset
+#define WEBP_PASS(pass)			(((pass) & 0xF) << 20)			//! number of entropy-analysis passes, in [1..10] (lossy only)
+#define WEBP_SEGMENTS(segments)	(((segments) & 0x7) << 24)		//! maximum number of segments, in [1..4] (lossy only)
 #define JXR_DEFAULT			0		//! save with quality 80 and no chroma subsampling (4:4:4)
 #define JXR_LOSSLESS		0x0064	//! save lossless
 #define JXR_PROGRESSIVE		0x2000	//! save as a progressive-JXR (use | to combine with other save flags)
@@ -792,6 +904,20 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
 
+// Warp options --------------------------------------------------------------
+// Constants used in FreeImage_Warp
+
+#define FI_WARP_DEFAULT				0x00	//! default options; none of the following other options apply
+#define FI_WARP_INVERSE				0x01	//! the matrix maps destination coordinates to source coordinates
+#define FI_WARP_OMIT_METADATA		0x02	//! do not copy metadata to the warped image
+#define FI_WARP_NO_SEPARABLE		0x04	//! always use the single pass evaluation, even when a separable rescale would apply
+
+// Poisson solver options ----------------------------------------------------
+// Constants used in FreeImage_MultigridPoissonSolverEx
+
+#define FI_POISSON_DEFAULT			0x00	//! solve on a (2^j + 1)x(2^j + 1) square grid enclosing the image
+#define FI_POISSON_RECTANGULAR		0x01	//! solve on a (2^j*cx + 1)x(2^j*cy + 1) grid, padding each dimension separately
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -825,6 +951,12 @@ typedef BOOL(DLL_CALLCONV* FI_OnStartedProc)(void* user, FREE_IMAGE_OPERATION op
 typedef BOOL(DLL_CALLCONV* FI_OnProgressProc)(void* user, double progress, void* more);
 typedef void (DLL_CALLCONV* FI_OnFinishedProc)(void* user, const BOOL* success, void* more);
 typedef void (DLL_CALLCONV* FI_OnMessageProc)(void* user, const char* msg, void* more);
+/**
+Called by the PNG (Adam7 interlaced) and JPEG (progressive) loaders after each complete pass or scan, but the last one.
+dib is the partially decoded image, owned by the loader and only valid during the call (clone it to keep it).
+pass is the zero-based index of the completed pass. Return FALSE to stop decoding: the loader then returns the image as decoded so far.
+*/
+typedef BOOL(DLL_CALLCONV* FI_OnPreviewProc)(void* user, FIBITMAP* dib, unsigned pass, void* more);
 
 FI_STRUCT(FreeImageCB) {
 	void* user;
@@ -834,6 +966,8 @@ FI_STRUCT(FreeImageCB) {
 	FI_OnMessageProc onMessage;
 
 	void* more;
+
+	FI_OnPreviewProc onPreview;  //< optional, setting it enables progressive decoding
 };
 
 
@@ -852,6 +986,9 @@ DLL_API void DLL_CALLCONV FreeImage_OutputMessageProcCB(const FreeImageCB* cb, i
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Allocate(int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp FI_DEFAULT(8), unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_Clone(FIBITMAP *dib);
+DLL_API FIBITMAP * DLL_CALLCONV FreeImage_CloneShared(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_MakeWritable(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_IsShared(FIBITMAP *dib);
 DLL_API void DLL_CALLCONV FreeImage_Unload(FIBITMAP *dib);
 
 // Header loading routines
@@ -1057,6 +1194,8 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantize(FIBITMAP *dib, FREE_IMAGE
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantizeEx(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize FI_DEFAULT(FIQ_WUQUANT), int PaletteSize FI_DEFAULT(256), int ReserveSize FI_DEFAULT(0), RGBQUAD *ReservePalette FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Threshold(FIBITMAP *dib, BYTE T);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_DitherToPalette(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm, RGBQUAD *palette, int PaletteSize);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantizeDither(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize FI_DEFAULT(FIQ_WUQUANT), FREE_IMAGE_DITHER algorithm FI_DEFAULT(FID_FS), int PaletteSize FI_DEFAULT(256), int ReserveSize FI_DEFAULT(0), RGBQUAD *ReservePalette FI_DEFAULT(NULL));
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBits(BYTE *bits, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, BOOL topdown FI_DEFAULT(FALSE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBitsEx(BOOL copySource, BYTE *bits, FREE_IMAGE_TYPE type, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, BOOL topdown FI_DEFAULT(FALSE));
@@ -1153,6 +1292,8 @@ DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* sr
 // rotation and flipping
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeBSplineCoefficients(FIBITMAP *dib);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateExCoefficients(FIBITMAP *coeff, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipHorizontal(FIBITMAP *dib);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
 
@@ -1161,15 +1302,21 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, i
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, BOOL convert FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
 
+// geometric transforms
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Warp(FIBITMAP *dib, int dst_width, int dst_height, const double *matrix, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), const void *bkcolor FI_DEFAULT(NULL), unsigned flags FI_DEFAULT(FI_WARP_DEFAULT));
+
 // color manipulation routines (point operations)
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
+DLL_API BOOL DLL_CALLCONV FreeImage_AdjustCurve16(FIBITMAP *dib, WORD *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustGamma(FIBITMAP *dib, double gamma);
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustBrightness(FIBITMAP *dib, double percentage);
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustContrast(FIBITMAP *dib, double percentage);
 DLL_API BOOL DLL_CALLCONV FreeImage_Invert(FIBITMAP *dib);
 DLL_API BOOL DLL_CALLCONV FreeImage_GetHistogram(FIBITMAP *dib, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_BLACK));
+DLL_API BOOL DLL_CALLCONV FreeImage_GetStatistics(FIBITMAP *dib, FISTATISTICS *stats, DWORD *histo FI_DEFAULT(NULL), unsigned bins FI_DEFAULT(256), double range_min FI_DEFAULT(0), double range_max FI_DEFAULT(1));
 DLL_API int DLL_CALLCONV FreeImage_GetAdjustColorsLookupTable(BYTE *LUT, double brightness, double contrast, double gamma, BOOL invert);
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double gamma, BOOL invert FI_DEFAULT(FALSE));
+DLL_API BOOL DLL_CALLCONV FreeImage_AdjustChain(FIBITMAP *dib, const FIADJUSTMENT *steps, unsigned count);
 DLL_API unsigned DLL_CALLCONV FreeImage_ApplyColorMapping(FIBITMAP *dib, RGBQUAD *srccolors, RGBQUAD *dstcolors, unsigned count, BOOL ignore_alpha, BOOL swap);
 DLL_API unsigned DLL_CALLCONV FreeImage_SwapColors(FIBITMAP *dib, RGBQUAD *color_a, RGBQUAD *color_b, BOOL ignore_alpha);
 DLL_API unsigned DLL_CALLCONV FreeImage_ApplyPaletteIndexMapping(FIBITMAP *dib, BYTE *srcindices,	BYTE *dstindices, unsigned count, BOOL swap);
@@ -1180,14 +1327,20 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetChannel(FIBITMAP *dib, FREE_IMAGE_CO
 DLL_API BOOL DLL_CALLCONV FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetComplexChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API BOOL DLL_CALLCONV FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
+DLL_API unsigned DLL_CALLCONV FreeImage_SplitChannels(FIBITMAP *dib, FIBITMAP **planes, unsigned count);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MergeChannels(FIBITMAP **planes, unsigned count);
+DLL_API unsigned DLL_CALLCONV FreeImage_ConvertToPlanarFloat(FIBITMAP *dib, float *planes, const float *scale FI_DEFAULT(NULL), const float *offset FI_DEFAULT(NULL));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromPlanarFloat(const float *planes, unsigned width, unsigned height, unsigned channels, FREE_IMAGE_TYPE type FI_DEFAULT(FIT_BITMAP), const float *scale FI_DEFAULT(NULL), const float *offset FI_DEFAULT(NULL));
 
 // copy / paste / composite routines
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Copy(FIBITMAP *dib, int left, int top, int right, int bottom);
 DLL_API BOOL DLL_CALLCONV FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CopyShared(FIBITMAP *dib, int left, int top, int right, int bottom);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg FI_DEFAULT(FALSE), RGBQUAD *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
 DLL_API BOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_AlphaComposite(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_COMPOSITE_OP op FI_DEFAULT(FICO_SRC_OVER), BOOL premultiplied FI_DEFAULT(FALSE));
 
 // background filling routines
 DLL_API BOOL DLL_CALLCONV FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options FI_DEFAULT(0));
@@ -1197,6 +1350,7 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateExT(FREE_IMAGE_TYPE type, int w
 
 // miscellaneous algorithms
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle FI_DEFAULT(3));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MultigridPoissonSolverEx(FIBITMAP *Laplacian, int ncycle FI_DEFAULT(3), unsigned flags FI_DEFAULT(FI_POISSON_DEFAULT));
 
 // restore the borland-specific enum size option
 #if defined(__BORLANDC__)
@@ -29,6 +29,7 @@
 #endif 
 
 #include <stdlib.h>
+#include <mutex>
 #if defined(_WIN32) || defined(_WIN64) || defined(__MINGW32__)
 #include <malloc.h>
 #endif // _WIN32 || _WIN64 || __MINGW32__
@@ -69,6 +70,27 @@ FI_STRUCT (METADATAHEADER) {
 	TAGMAP *tagmap;	//! pointer to the tag map
 };
 
+// ----------------------------------------------------------
+//  Shared pixels definition
+// ----------------------------------------------------------
+
+/**
+Reference counted pixel storage. 
+The data block of the image that allocated the pixels is kept alive 
+as long as an image (the owner, a view or a copy-on-write copy) refers to it.
+*/
+FI_STRUCT (FIPIXELSTORAGE) {
+	/** number of images referring to the pixels */
+	unsigned refcount;
+	/** number of copy-on-write images among them */
+	unsigned copies;
+	/** data block of the owner, holding the pixels */
+	void *data;
+};
+
+/** protects the pixel storages and the copy-on-write flags */
+static std::mutex s_storage_mutex;
+
 // ----------------------------------------------------------
 //  FIBITMAP definition
 // ----------------------------------------------------------
@@ -118,6 +140,14 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	unsigned external_pitch;
 	//@}
 
+	/**@name shared pixel buffer management */
+	//@{
+	/** storage of the pixels when they are shared with other images, NULL otherwise */
+	FIPIXELSTORAGE *storage;
+	/** TRUE if the pixels must be copied (see FreeImage_MakeWritable) before being written */
+	BOOL copy_on_write;
+	//@}
+
 	//BYTE filler[1];			 // fill to 32-bit alignment
 };
 
@@ -426,6 +456,11 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			fih->external_bits = ext_bits;
 			fih->external_pitch = ext_pitch;
 
+			// pixels are not shared yet
+
+			fih->storage = NULL;
+			fih->copy_on_write = FALSE;
+
 			// write out the BITMAPINFOHEADER
 
 			BITMAPINFOHEADER *bih   = FreeImage_GetInfoHeader(bitmap);
@@ -492,6 +527,118 @@ FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsign
 	return FreeImage_AllocateBitmap(FALSE, NULL, 0, type, width, height, bpp, red_mask, green_mask, blue_mask);
 }
 
+// ----------------------------------------------------------
+//  Shared pixels management
+// ----------------------------------------------------------
+
+/**
+Get the storage of the pixels of an image, create it if the pixels are not shared yet. 
+Must be called with s_storage_mutex locked.
+@return Returns the storage, or NULL if the pixels belong to a user provided buffer 
+(or if the storage cannot be allocated)
+*/
+static FIPIXELSTORAGE *
+FreeImage_GetPixelStorage(FIBITMAP *dib) {
+	FREEIMAGEHEADER *fih = (FREEIMAGEHEADER *)dib->data;
+
+	if(!fih->storage && !fih->external_bits) {
+		FIPIXELSTORAGE *storage = new(std::nothrow) FIPIXELSTORAGE;
+		if(storage) {
+			storage->refcount = 1;
+			storage->copies = 0;
+			storage->data = dib->data;
+			fih->storage = storage;
+		}
+	}
+
+	return fih->storage;
+}
+
+/**
+Let an image refer to the pixel storage of another image. 
+Must be called with s_storage_mutex locked.
+@param dst Image whose external bits point to the pixels of src
+@param src Image owning or referring to the storage
+@param storage Storage of the pixels of src
+@param copy_on_write If TRUE, src and dst become copy-on-write images, otherwise dst is a view of src
+*/
+static void
+FreeImage_AttachPixelStorage(FIBITMAP *dst, FIBITMAP *src, FIPIXELSTORAGE *storage, BOOL copy_on_write) {
+	FREEIMAGEHEADER *src_fih = (FREEIMAGEHEADER *)src->data;
+	FREEIMAGEHEADER *dst_fih = (FREEIMAGEHEADER *)dst->data;
+
+	dst_fih->storage = storage;
+	storage->refcount++;
+
+	if(copy_on_write) {
+		if(!src_fih->copy_on_write) {
+			src_fih->copy_on_write = TRUE;
+			storage->copies++;
+		}
+		dst_fih->copy_on_write = TRUE;
+		storage->copies++;
+	}
+}
+
+/**
+Release the data block of an image, and its reference to shared pixels if any. 
+The data block of the owner of shared pixels is released with the last reference to these pixels.
+*/
+static void
+FreeImage_ReleasePixels(FIBITMAP *dib) {
+	FREEIMAGEHEADER *fih = (FREEIMAGEHEADER *)dib->data;
+	FIPIXELSTORAGE *storage = fih->storage;
+
+	if(!storage) {
+		FreeImage_Aligned_Free(dib->data);
+		return;
+	}
+
+	// the owner's header stays alive with its pixels, don't let it refer to released objects
+	fih->metadata = NULL;
+	fih->thumbnail = NULL;
+
+	// storage may be released by another reference as soon as the lock is released
+	BOOL is_owner = FALSE;
+	BOOL last_reference = FALSE;
+	{
+		std::lock_guard<std::mutex> lock(s_storage_mutex);
+		if(fih->copy_on_write) {
+			storage->copies--;
+		}
+		is_owner = (storage->data == dib->data);
+		last_reference = (--storage->refcount == 0);
+	}
+
+	if(!is_owner) {
+		// a view or a copy-on-write copy
+		FreeImage_Aligned_Free(dib->data);
+	}
+	if(last_reference) {
+		FreeImage_Aligned_Free(storage->data);
+		delete storage;
+	}
+}
+
+BOOL 
+FreeImage_SharePixels(FIBITMAP *dst, FIBITMAP *src, BOOL copy_on_write) {
+	if(!dst || !src || !FreeImage_HasPixels(src)) {
+		return FALSE;
+	}
+
+	std::lock_guard<std::mutex> lock(s_storage_mutex);
+
+	FIPIXELSTORAGE *storage = FreeImage_GetPixelStorage(src);
+	if(!storage) {
+		return FALSE;
+	}
+	FreeImage_AttachPixelStorage(dst, src, storage, copy_on_write);
+
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
 void DLL_CALLCONV
 FreeImage_Unload(FIBITMAP *dib) {
 	if (NULL != dib) {	
@@ -523,7 +670,7 @@ FreeImage_Unload(FIBITMAP *dib) {
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
 			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			FreeImage_ReleasePixels(dib);
 		}
 
 		free(dib);		// ... and the wrapper
@@ -532,8 +679,15 @@ FreeImage_Unload(FIBITMAP *dib) {
 
 // ----------------------------------------------------------
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_Clone(FIBITMAP *dib) {
+/**
+Clone an image.
+@param dib Image to clone
+@param share_pixels If TRUE, the clone shares the pixels of dib (both images become copy-on-write images), 
+unless these pixels belong to a user provided buffer. Otherwise, the pixels are copied.
+@return Returns the clone if successful, returns NULL otherwise
+*/
+static FIBITMAP *
+FreeImage_CloneBitmap(FIBITMAP *dib, BOOL share_pixels) {
 	if(!dib) {
 		return NULL;
 	}
@@ -552,8 +706,22 @@ FreeImage_Clone(FIBITMAP *dib) {
 	// check whether this image has masks defined ...
 	BOOL need_masks = (bpp == 16 && type == FIT_BITMAP) ? TRUE : FALSE;
 
-	// allocate a new dib
-	FIBITMAP *new_dib = FreeImage_AllocateHeaderT(header_only, type, width, height, bpp,
+	// lock the pixel storage while the clone is attached to it
+	std::unique_lock<std::mutex> lock(s_storage_mutex, std::defer_lock);
+	FIPIXELSTORAGE *storage = NULL;
+	if(share_pixels && !header_only) {
+		lock.lock();
+		storage = FreeImage_GetPixelStorage(dib);
+		if(!storage) {
+			lock.unlock();
+		}
+	}
+
+	// allocate a new dib (a header referring to the pixels of dib when sharing them)
+	FIBITMAP *new_dib = storage ?
+		FreeImage_AllocateBitmap(FALSE, FreeImage_GetBits(dib), FreeImage_GetPitch(dib), type, width, height, bpp,
+			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib)) :
+		FreeImage_AllocateHeaderT(header_only, type, width, height, bpp,
 			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib));
 
 	if (new_dib) {
@@ -570,9 +738,9 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// palette is aligned on a 16 bytes boundary
 		// pixels are aligned on a 16 bytes boundary
 		
-		// when using a user provided pixel buffer, force a 'header only' calculation		
+		// when using a user provided pixel buffer or sharing the pixels, force a 'header only' calculation		
 
-		size_t dib_size = FreeImage_GetInternalImageSize(header_only || ext_bits, width, height, bpp, need_masks);
+		size_t dib_size = FreeImage_GetInternalImageSize(header_only || ext_bits || storage, width, height, bpp, need_masks);
 
 		// copy the bitmap + internal pointers (remember to restore new_dib internal pointers later)
 		memcpy(new_dib->data, dib->data, dib_size);
@@ -590,6 +758,18 @@ FreeImage_Clone(FIBITMAP *dib) {
 		((FREEIMAGEHEADER *)new_dib->data)->external_bits = NULL;
 		((FREEIMAGEHEADER *)new_dib->data)->external_pitch = 0;
 
+		// reset shared pixels link for new_dib
+		((FREEIMAGEHEADER *)new_dib->data)->storage = NULL;
+		((FREEIMAGEHEADER *)new_dib->data)->copy_on_write = FALSE;
+
+		if(storage) {
+			// refer to the pixels of dib
+			((FREEIMAGEHEADER *)new_dib->data)->external_bits = FreeImage_GetBits(dib);
+			((FREEIMAGEHEADER *)new_dib->data)->external_pitch = FreeImage_GetPitch(dib);
+			FreeImage_AttachPixelStorage(new_dib, dib, storage, TRUE);
+			lock.unlock();
+		}
+
 		// copy possible ICC profile
 		FreeImage_CreateICCProfile(new_dib, src_iccProfile->data, src_iccProfile->size);
 		dst_iccProfile->flags = src_iccProfile->flags;
@@ -623,7 +803,7 @@ FreeImage_Clone(FIBITMAP *dib) {
 		FreeImage_SetThumbnail(new_dib, FreeImage_GetThumbnail(dib));
 
 		// copy user provided pixel buffer (if any)
-		if(ext_bits) {
+		if(ext_bits && !storage) {
 			const unsigned pitch = FreeImage_GetPitch(dib);
 			const unsigned linesize = FreeImage_GetLine(dib);
 			for(unsigned y = 0; y < height; y++) {
@@ -638,6 +818,61 @@ FreeImage_Clone(FIBITMAP *dib) {
 	return NULL;
 }
 
+FIBITMAP * DLL_CALLCONV
+FreeImage_Clone(FIBITMAP *dib) {
+	return FreeImage_CloneBitmap(dib, FALSE);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_CloneShared(FIBITMAP *dib) {
+	return FreeImage_CloneBitmap(dib, TRUE);
+}
+
+BOOL DLL_CALLCONV
+FreeImage_MakeWritable(FIBITMAP *dib) {
+	if(!dib) {
+		return FALSE;
+	}
+
+	FREEIMAGEHEADER *fih = (FREEIMAGEHEADER *)dib->data;
+	{
+		std::lock_guard<std::mutex> lock(s_storage_mutex);
+		if(!fih->copy_on_write) {
+			return TRUE;
+		}
+		if(fih->storage->copies == 1) {
+			// the other copies are gone, the pixels can be written in place
+			fih->copy_on_write = FALSE;
+			fih->storage->copies = 0;
+			return TRUE;
+		}
+	}
+
+	// get a private copy of the pixels, then swap the data blocks
+	FIBITMAP *copy = FreeImage_CloneBitmap(dib, FALSE);
+	if(!copy) {
+		return FALSE;
+	}
+	void *data = dib->data;
+	dib->data = copy->data;
+	copy->data = data;
+	FreeImage_Unload(copy);
+
+	return TRUE;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_IsShared(FIBITMAP *dib) {
+	if(!dib) {
+		return FALSE;
+	}
+
+	FREEIMAGEHEADER *fih = (FREEIMAGEHEADER *)dib->data;
+
+	std::lock_guard<std::mutex> lock(s_storage_mutex);
+	return (fih->storage && (fih->storage->refcount > 1)) ? TRUE : FALSE;
+}
+
 // ----------------------------------------------------------
 
 BYTE * DLL_CALLCONV
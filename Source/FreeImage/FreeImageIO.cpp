@@ -19,6 +19,16 @@
 // Use at your own risk!
 // ==========================================================
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif // _WIN32
+
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "FreeImageIO.h"
@@ -220,3 +230,79 @@ SetMemoryIO(FreeImageIO *io) {
 	io->tell_proc  = _MemoryTellProc;
 	io->write_proc = _MemoryWriteProc;
 }
+
+// =====================================================================
+// Zero-copy stream view
+// =====================================================================
+
+FIStreamView::FIStreamView(FreeImageIO *io, fi_handle handle) 
+: _data(NULL), _size(0), _map_base(NULL), _map_size(0), _map_handle(NULL) {
+	if(!io || !handle) {
+		return;
+	}
+
+	if(io->read_proc == _MemoryReadProc) {
+		// memory stream: view the buffer in place
+		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
+		if(mem_header->data && (mem_header->current_position < mem_header->file_length)) {
+			_data = (BYTE*)mem_header->data + mem_header->current_position;
+			_size = (size_t)(mem_header->file_length - mem_header->current_position);
+		}
+	}
+	else if(io->read_proc == _ReadProc) {
+		// file stream: map the whole file read-only
+		FILE *stream = (FILE*)handle;
+		const long position = ftell(stream);
+		if(position < 0) {
+			return;
+		}
+#ifdef _WIN32
+		HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(stream));
+		if(hFile == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		LARGE_INTEGER file_size;
+		if(!GetFileSizeEx(hFile, &file_size) || (file_size.QuadPart <= position) || ((ULONGLONG)file_size.QuadPart > (ULONGLONG)((size_t)-1))) {
+			return;
+		}
+		HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(!hMapping) {
+			return;
+		}
+		void *base = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if(!base) {
+			CloseHandle(hMapping);
+			return;
+		}
+		_map_handle = hMapping;
+		_map_size = (size_t)file_size.QuadPart;
+#else
+		struct stat file_stat;
+		if((fstat(fileno(stream), &file_stat) != 0) || !S_ISREG(file_stat.st_mode) || (file_stat.st_size <= position)) {
+			return;
+		}
+		if((unsigned long long)file_stat.st_size > (unsigned long long)((size_t)-1)) {
+			return;
+		}
+		void *base = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fileno(stream), 0);
+		if(base == MAP_FAILED) {
+			return;
+		}
+		_map_size = (size_t)file_stat.st_size;
+#endif // _WIN32
+		_map_base = base;
+		_data = (BYTE*)base + position;
+		_size = _map_size - (size_t)position;
+	}
+}
+
+FIStreamView::~FIStreamView() {
+	if(_map_base) {
+#ifdef _WIN32
+		UnmapViewOfFile(_map_base);
+		CloseHandle((HANDLE)_map_handle);
+#else
+		munmap(_map_base, _map_size);
+#endif // _WIN32
+	}
+}
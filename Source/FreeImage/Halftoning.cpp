@@ -25,6 +25,10 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
+#include "Quantizers.h"
+
+#include <atomic>
 
 static const int WHITE = 255;
 static const int BLACK = 0;
@@ -207,9 +211,11 @@ static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
 // See also : The newsprint web site at http://www.cl.cam.ac.uk/~and1000/newsprint/
 // for more technical info on this dithering technique
 //
-static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
-	// Order-3 clustered dithering matrix.
-	int cluster3[] = {
+
+// Order-3, 4 and 8 clustered dithering matrices
+static const int *
+ClusterMatrix(int order) {
+	static const int cluster3[] = {
 	  9,11,10, 8, 6, 7,
 	  12,17,16, 5, 0, 1,
 	  13,14,15, 4, 3, 2,
@@ -217,9 +223,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	  5, 0, 1,12,17,16,
 	  4, 3, 2,13,14,15
 	};
-
-	// Order-4 clustered dithering matrix. 
-	int cluster4[] = {
+	static const int cluster4[] = {
 	  18,20,19,16,13,11,12,15,
 	  27,28,29,22, 4, 3, 2, 9,
 	  26,31,30,21, 5, 0, 1,10,
@@ -229,9 +233,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	  5, 0, 1,10,26,31,30,21,
 	  8, 6, 7,14,23,25,24,17
 	};
-
-	// Order-8 clustered dithering matrix. 
-	int cluster8[] = {
+	static const int cluster8[] = {
 	   64, 69, 77, 87, 86, 76, 68, 67, 63, 58, 50, 40, 41, 51, 59, 60,
 	   70, 94,100,109,108, 99, 93, 75, 57, 33, 27, 18, 19, 28, 34, 52,
 	   78,101,114,116,115,112, 98, 83, 49, 26, 13, 11, 12, 15, 29, 44,
@@ -249,7 +251,18 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	   56, 32, 24, 23, 22, 31, 35, 53, 71, 95,103,104,105, 96, 92, 74,
 	   62, 55, 47, 37, 36, 46, 54, 61, 65, 72, 80, 90, 91, 81, 73, 66
 	};
+	switch(order) {
+		case 3:
+			return cluster3;
+		case 4:
+			return cluster4;
+		case 8:
+			return cluster8;
+	}
+	return NULL;
+}
 
+static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	int x, y, pixel;
 	int width, height;
 	BYTE *bits, *new_bits;
@@ -261,28 +274,18 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	new_dib = FreeImage_Allocate(width, height, 8);
 	if(NULL == new_dib) return NULL;
 
-	// select the dithering matrix
-	int *matrix = NULL;
-	switch(order) {
-		case 3:
-			matrix = &cluster3[0];
-			break;
-		case 4:
-			matrix = &cluster4[0];
-			break;
-		case 8:
-			matrix = &cluster8[0];
-			break;
-		default:
-			return NULL;
+	// select and scale the dithering matrix
+	const int *cluster = ClusterMatrix(order);
+	if(NULL == cluster) {
+		FreeImage_Unload(new_dib);
+		return NULL;
 	}
-
-	// scale the dithering matrix
+	int matrix[256];
 	int l = 2 * order;
 	int scale = 256 / (l * order);
 	for(y = 0; y < l; y++) {
 		for(x = 0; x < l; x++) {
-			matrix[y*l + x] *= scale;
+			matrix[y*l + x] = cluster[y*l + x] * scale;
 		}
 	}
 
@@ -305,6 +308,8 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 }
 
 
+static FIBITMAP* SierraLite(FIBITMAP *dib);
+
 // ==========================================================
 // Halftoning function
 //
@@ -371,10 +376,16 @@ FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
 		case FID_CLUSTER16x16:
 			dib8 = OrderedClusteredDot(input, 8);
 			break;
+		case FID_SIERRALITE:
+			dib8 = SierraLite(input);
+			break;
+		default:
+			break;
 	}
 	if(input != dib) {
 		FreeImage_Unload(input);
 	}
+	if(NULL == dib8) return NULL;
 
 	// Build a greyscale palette (needed by threshold)
 	RGBQUAD *grey_pal = FreeImage_GetPalette(dib8);
@@ -472,3 +483,351 @@ FreeImage_Threshold(FIBITMAP *dib, BYTE T) {
 	return new_dib;
 }
 
+// ==========================================================
+// Palette dithering
+//
+
+// Minimum number of pixels worth a palette dithering thread
+static const size_t PALETTE_MIN_THREAD_PIXELS = 256 * 256;
+
+// Serpentine Floyd & Steinberg error diffusion against an arbitrary palette
+// Lines are scanned in alternate directions, the filter being mirrored on right to left lines
+//          *   7
+//      3   5   1     (1/16)
+// The errors are kept in an integer buffer, in 1/16 units
+static void
+PaletteFloydSteinberg(FIBITMAP *src, FIBITMAP *dst, const PaletteMapper &mapper) {
+	const int width = (int)FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	const RGBQUAD *pal = FreeImage_GetPalette(dst);
+
+	// errors of the current and of the next line, with a guard pixel on both sides
+	const size_t count = (size_t)(width + 2) * 3;
+	unique_mem buffer(malloc(2 * count * sizeof(int)));
+	if(!buffer) throw FI_MSG_ERROR_MEMORY;
+	int *cerr = (int*)buffer.get();
+	int *nerr = cerr + count;
+	memset(cerr, 0, 2 * count * sizeof(int));
+
+	// scan from the top line down
+	for(unsigned k = 0; k < height; k++) {
+		const unsigned y = height - 1 - k;
+		const BYTE *bits = FreeImage_GetScanLine(src, y);
+		BYTE *new_bits = FreeImage_GetScanLine(dst, y);
+
+		const int dir = (k & 1) ? -1 : 1;
+		const int next = 3 * dir;
+
+		for(int x = (k & 1) ? width - 1 : 0; (x >= 0) && (x < width); x += dir) {
+			const BYTE *pixel = bits + x * bytespp;
+			int *ce = cerr + 3 * (x + 1);
+			int *ne = nerr + 3 * (x + 1);
+			const int red = CLAMP(pixel[FI_RGBA_RED] + ((ce[0] + 8) >> 4), 0, 255);
+			const int green = CLAMP(pixel[FI_RGBA_GREEN] + ((ce[1] + 8) >> 4), 0, 255);
+			const int blue = CLAMP(pixel[FI_RGBA_BLUE] + ((ce[2] + 8) >> 4), 0, 255);
+
+			const BYTE index = mapper.GetIndex(red, green, blue);
+			new_bits[x] = index;
+
+			const int error[3] = { red - pal[index].rgbRed, green - pal[index].rgbGreen, blue - pal[index].rgbBlue };
+			for(int c = 0; c < 3; c++) {
+				ce[c + next] += 7 * error[c];
+				ne[c - next] += 3 * error[c];
+				ne[c] += 5 * error[c];
+				ne[c + next] += error[c];
+			}
+		}
+
+		int *terr = cerr; cerr = nerr; nerr = terr;
+		memset(nerr, 0, count * sizeof(int));
+	}
+}
+
+// Sierra Lite error diffusion against an arbitrary palette
+//          *   2
+//      1   1         (1/4)
+// Lines are scanned left to right, from the top line down, and several lines are processed 
+// concurrently: a line may process pixel x once the line above has completed pixel x + 1 
+// (wavefront). The result does not depend on the number of threads.
+static void
+PaletteSierraLite(FIBITMAP *src, FIBITMAP *dst, const PaletteMapper &mapper) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	const RGBQUAD *pal = FreeImage_GetPalette(dst);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, PALETTE_MIN_THREAD_PIXELS);
+
+	// ring of error lines, in 1/4 units and with a guard pixel on both sides: line k reads 
+	// buffer k % count and diffuses to buffer (k + 1) % count. Lines complete in order and 
+	// at most threads - 1 lines run behind a line, so a buffer is free when it is cleared.
+	const unsigned count = threads + 1;
+	const size_t length = (size_t)(width + 2) * 3;
+	unique_mem buffer(malloc(count * length * sizeof(int)));
+	if(!buffer) throw FI_MSG_ERROR_MEMORY;
+	int *errors = (int*)buffer.get();
+	memset(errors, 0, length * sizeof(int));
+
+	// number of pixels completed on each line, published every REPORT pixels
+	static const unsigned REPORT = 32;
+	std::vector<std::atomic<unsigned> > done(height);
+	for(unsigned k = 0; k < height; k++) {
+		done[k].store(0, std::memory_order_relaxed);
+	}
+
+	// lines are handed out in order, so that a line only waits for lines already being processed
+	std::atomic<unsigned> next_line(0);
+
+	FreeImage_ParallelFor(0, threads, threads, [&](unsigned, unsigned, unsigned) {
+		for(unsigned k = next_line.fetch_add(1); k < height; k = next_line.fetch_add(1)) {
+			const unsigned y = height - 1 - k;
+			const BYTE *bits = FreeImage_GetScanLine(src, y);
+			BYTE *new_bits = FreeImage_GetScanLine(dst, y);
+
+			const int *ce = errors + (size_t)(k % count) * length + 3;
+			int *ne = errors + (size_t)((k + 1) % count) * length + 3;
+			memset(ne - 3, 0, length * sizeof(int));
+
+			// pixels completed on the line above
+			unsigned ready = (k > 0) ? 0 : width;
+			// error diffused to the right
+			int carry[3] = { 0, 0, 0 };
+
+			for(unsigned x = 0; x < width; x++) {
+				const unsigned needed = MIN(x + 2, width);
+				while(ready < needed) {
+					ready = done[k - 1].load(std::memory_order_acquire);
+					if(ready < needed) {
+						std::this_thread::yield();
+					}
+				}
+
+				const int red = CLAMP(bits[FI_RGBA_RED] + ((ce[0] + carry[0] + 2) >> 2), 0, 255);
+				const int green = CLAMP(bits[FI_RGBA_GREEN] + ((ce[1] + carry[1] + 2) >> 2), 0, 255);
+				const int blue = CLAMP(bits[FI_RGBA_BLUE] + ((ce[2] + carry[2] + 2) >> 2), 0, 255);
+
+				const BYTE index = mapper.GetIndex(red, green, blue);
+				new_bits[x] = index;
+
+				const int error[3] = { red - pal[index].rgbRed, green - pal[index].rgbGreen, blue - pal[index].rgbBlue };
+				for(int c = 0; c < 3; c++) {
+					carry[c] = 2 * error[c];
+					ne[c - 3] += error[c];
+					ne[c] += error[c];
+				}
+
+				if(((x + 1) % REPORT) == 0) {
+					done[k].store(x + 1, std::memory_order_release);
+				}
+				bits += bytespp;
+				ce += 3;
+				ne += 3;
+			}
+			done[k].store(width, std::memory_order_release);
+		}
+	});
+}
+
+// Mean distance from each palette colour to its nearest distinct palette colour
+static double
+PaletteSpacing(const RGBQUAD *pal, unsigned size) {
+	double sum = 0;
+	unsigned count = 0;
+	for(unsigned i = 0; i < size; i++) {
+		int best = INT_MAX;
+		for(unsigned j = 0; j < size; j++) {
+			const int dr = pal[i].rgbRed - pal[j].rgbRed;
+			const int dg = pal[i].rgbGreen - pal[j].rgbGreen;
+			const int db = pal[i].rgbBlue - pal[j].rgbBlue;
+			const int d = dr * dr + dg * dg + db * db;
+			if((d > 0) && (d < best)) {
+				best = d;
+			}
+		}
+		if(best < INT_MAX) {
+			sum += sqrt((double)best);
+			count++;
+		}
+	}
+	return count ? (sum / count) : 0;
+}
+
+// Ordered dithering against an arbitrary palette
+// Each pixel is moved along the grey axis by the threshold of the dithering matrix, scaled to 
+// the mean spacing of the palette colours, then mapped to the nearest palette entry
+static void
+PaletteOrdered(FIBITMAP *src, FIBITMAP *dst, const PaletteMapper &mapper, unsigned size, FREE_IMAGE_DITHER algorithm) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+
+	// matrix size and thresholds in range [0, levels)
+	int order = 0;
+	BOOL clustered = FALSE;
+	switch(algorithm) {
+		case FID_BAYER4x4:
+			order = 2;
+			break;
+		case FID_BAYER8x8:
+			order = 3;
+			break;
+		case FID_BAYER16x16:
+			order = 4;
+			break;
+		case FID_CLUSTER6x6:
+			order = 3; clustered = TRUE;
+			break;
+		case FID_CLUSTER8x8:
+			order = 4; clustered = TRUE;
+			break;
+		case FID_CLUSTER16x16:
+			order = 8; clustered = TRUE;
+			break;
+		default:
+			return;
+	}
+	const unsigned l = clustered ? 2 * order : (1 << order);
+	const int levels = clustered ? 2 * order * order : (int)(l * l);
+
+	// offsets added to the components of a pixel, indexed by (x % l) + l * (y % l)
+	const double spacing = PaletteSpacing(FreeImage_GetPalette(dst), size);
+	int offset[256];
+	for(unsigned y = 0; y < l; y++) {
+		for(unsigned x = 0; x < l; x++) {
+			const int threshold = clustered ? ClusterMatrix(order)[y + l * x] : dithervalue(y, x, order);
+			offset[x + l * y] = (int)floor((((threshold + 0.5) / levels) - 0.5) * spacing + 0.5);
+		}
+	}
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, PALETTE_MIN_THREAD_PIXELS);
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned y = first; y < last; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(src, y);
+			BYTE *new_bits = FreeImage_GetScanLine(dst, y);
+			const int *row = offset + l * ((height - 1 - y) % l);
+			for(unsigned x = 0; x < width; x++) {
+				const int d = row[x % l];
+				new_bits[x] = mapper.GetIndex(
+					CLAMP(bits[FI_RGBA_RED] + d, 0, 255), 
+					CLAMP(bits[FI_RGBA_GREEN] + d, 0, 255), 
+					CLAMP(bits[FI_RGBA_BLUE] + d, 0, 255));
+				bits += bytespp;
+			}
+		}
+	});
+}
+
+// Dither a 24- or 32-bit image to the first 'size' entries of the palette of an 8-bit image of the same size
+static BOOL
+PaletteDither(FIBITMAP *src, FIBITMAP *dst, unsigned size, FREE_IMAGE_DITHER algorithm) {
+	try {
+		switch(algorithm) {
+			case FID_FS:
+				PaletteFloydSteinberg(src, dst, PaletteMapper(FreeImage_GetPalette(dst), size));
+				return TRUE;
+			case FID_SIERRALITE:
+				PaletteSierraLite(src, dst, PaletteMapper(FreeImage_GetPalette(dst), size));
+				return TRUE;
+			case FID_BAYER4x4:
+			case FID_BAYER8x8:
+			case FID_BAYER16x16:
+			case FID_CLUSTER6x6:
+			case FID_CLUSTER8x8:
+			case FID_CLUSTER16x16:
+				PaletteOrdered(src, dst, PaletteMapper(FreeImage_GetPalette(dst), size), size, algorithm);
+				return TRUE;
+		}
+	} catch(const char *message) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, message);
+	}
+	return FALSE;
+}
+
+// Sierra Lite halftoning of a 8-bit greyscale image, using the palette dithering against black and white
+// Returns a 8-bit image whose pixels are 0 or 255
+static FIBITMAP*
+SierraLite(FIBITMAP *dib) {
+	FIBITMAP *input = FreeImage_ConvertTo24Bits(dib);
+	if(NULL == input) return NULL;
+
+	FIBITMAP *new_dib = FreeImage_Allocate(FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), 8);
+	if(new_dib) {
+		RGBQUAD *pal = FreeImage_GetPalette(new_dib);
+		pal[0].rgbRed = pal[0].rgbGreen = pal[0].rgbBlue = 0;
+		pal[1].rgbRed = pal[1].rgbGreen = pal[1].rgbBlue = 255;
+		if(PaletteDither(input, new_dib, 2, FID_SIERRALITE)) {
+			// palette indices to grey levels
+			const unsigned width = FreeImage_GetWidth(new_dib);
+			const unsigned height = FreeImage_GetHeight(new_dib);
+			for(unsigned y = 0; y < height; y++) {
+				BYTE *bits = FreeImage_GetScanLine(new_dib, y);
+				for(unsigned x = 0; x < width; x++) {
+					bits[x] = bits[x] ? WHITE : BLACK;
+				}
+			}
+		} else {
+			FreeImage_Unload(new_dib);
+			new_dib = NULL;
+		}
+	}
+	FreeImage_Unload(input);
+
+	return new_dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_DitherToPalette(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm, RGBQUAD *palette, int PaletteSize) {
+	if(!FreeImage_HasPixels(dib) || !palette || (PaletteSize < 1)) return NULL;
+	if(FreeImage_GetImageType(dib) != FIT_BITMAP) return NULL;
+	if(PaletteSize > 256) PaletteSize = 256;
+
+	// convert the input dib to a 24-bit dib if needed
+	FIBITMAP *input = dib;
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if((bpp != 24) && (bpp != 32)) {
+		input = FreeImage_ConvertTo24Bits(dib);
+		if(NULL == input) return NULL;
+	}
+
+	FIBITMAP *new_dib = FreeImage_Allocate(FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), 8);
+	if(new_dib) {
+		memcpy(FreeImage_GetPalette(new_dib), palette, PaletteSize * sizeof(RGBQUAD));
+		if(!PaletteDither(input, new_dib, PaletteSize, algorithm)) {
+			FreeImage_Unload(new_dib);
+			new_dib = NULL;
+		}
+	}
+	if(input != dib) {
+		FreeImage_Unload(input);
+	}
+	if(NULL == new_dib) return NULL;
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(new_dib, dib);
+
+	return new_dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ColorQuantizeDither(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize, FREE_IMAGE_DITHER algorithm, int PaletteSize, int ReserveSize, RGBQUAD *ReservePalette) {
+	if(!FreeImage_HasPixels(dib)) return NULL;
+
+	FIBITMAP *dst = FreeImage_ColorQuantizeEx(dib, quantize, PaletteSize, ReserveSize, ReservePalette);
+	if(quantize == FIQ_LFPQUANT) {
+		if(dst) {
+			// lossless, there is nothing to dither
+			return dst;
+		}
+		// the image has more colors than the palette, fall back to a real quantizer
+		dst = FreeImage_ColorQuantizeEx(dib, FIQ_WUQUANT, PaletteSize, ReserveSize, ReservePalette);
+	}
+	if(!dst) return NULL;
+
+	if(!PaletteDither(dib, dst, (unsigned)CLAMP(PaletteSize, 2, 256), algorithm)) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
@@ -103,6 +103,7 @@ struct MULTIBITMAPHEADER {
 		, handle(NULL)
 		, changed(FALSE)
 		, page_count(0)
+		, src_page_count(0)
 		, read_only(TRUE)
 		, cache_fif(fif)
 		, load_flags(0)
@@ -118,6 +119,7 @@ struct MULTIBITMAPHEADER {
 	std::map<FIBITMAP *, int> locked_pages;
 	BOOL changed;
 	int page_count;
+	int src_page_count;
 	BlockList m_blocks;
 	std::string m_filename;
 	BOOL read_only;
@@ -143,6 +145,21 @@ ReplaceExtension(std::string& dst_filename, const std::string& src_filename, con
 	}
 }
 
+/**
+Save flags used when a page is written to the cache file.<br>
+Pages must round-trip unchanged: formats whose default save is lossy are cached in their lossless mode, 
+and animation frames keep their frame time and loop count.
+*/
+inline int
+GetCacheFlags(FREE_IMAGE_FORMAT cache_fif) {
+	switch (cache_fif) {
+		case FIF_WEBP:
+			return WEBP_LOSSLESS | WEBP_FAST | WEBP_ANIMATION_FRAME;
+		default:
+			return 0;
+	}
+}
+
 } //< ns
 
 
@@ -289,6 +306,7 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, BOOL crea
 				// cache the page count
 
 				header->page_count = FreeImage_InternalGetPageCount(bitmap.get());
+				header->src_page_count = header->page_count;
 
 				// allocate a continueus block to describe the bitmap
 
@@ -356,6 +374,7 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 					// cache the page count
 
 					header->page_count = FreeImage_InternalGetPageCount(bitmap.get());
+					header->src_page_count = header->page_count;
 
 					// allocate a continueus block to describe the bitmap
 					
@@ -384,6 +403,133 @@ FreeImageLoadArgs argsFromFlags(int flags) {
 	return args;
 }
 
+/**
+Check if the only changes made to a multipage bitmap are new pages, appended after all the (untouched) source pages
+@param header Multipage bitmap header
+@param first_new Receives the first block of the appended pages (end() if there are none)
+@return Returns TRUE if the source pages can be kept as-is, returns FALSE otherwise
+*/
+static BOOL
+FreeImage_IsAppendOnly(MULTIBITMAPHEADER *header, BlockListIterator *first_new) {
+	if (!header->handle || (header->src_page_count <= 0)) {
+		return FALSE;
+	}
+
+	// the source pages must come first, in their original order
+
+	int next_page = 0;
+	BlockListIterator i = header->m_blocks.begin();
+
+	for (; (i != header->m_blocks.end()) && (i->m_type == BLOCK_CONTINUEUS); ++i) {
+		if (i->getStart() != next_page) {
+			return FALSE;
+		}
+		next_page = i->getEnd() + 1;
+	}
+
+	if (next_page != header->src_page_count) {
+		return FALSE;
+	}
+
+	// ... followed by new pages only
+
+	for (BlockListIterator j = i; j != header->m_blocks.end(); ++j) {
+		if (j->m_type != BLOCK_REFERENCE) {
+			return FALSE;
+		}
+	}
+
+	*first_new = i;
+
+	return TRUE;
+}
+
+/**
+Decode a page stored in the cache
+*/
+static FIBITMAP *
+FreeImage_LoadPageFromBlock(MULTIBITMAPHEADER *header, const PageBlock& block) {
+	// read the compressed data
+
+	BYTE *compressed_data = (BYTE*)malloc(block.getSize() * sizeof(BYTE));
+	if (!compressed_data) {
+		return NULL;
+	}
+
+	header->m_cachefile.readFile((BYTE *)compressed_data, block.getReference(), block.getSize());
+
+	// uncompress the data
+
+	FIMEMORY *hmem = FreeImage_OpenMemory(compressed_data, block.getSize());
+	FIBITMAP *dib = FreeImage_LoadFromMemory(header->cache_fif, hmem, 0);
+	FreeImage_CloseMemory(hmem);
+
+	// get rid of the buffer
+	free(compressed_data);
+
+	return dib;
+}
+
+/**
+Write the new pages of an append-only multipage bitmap to a handle already holding the source pages.<br>
+Only the new pages are encoded, the source pages are neither decoded nor rewritten.
+@see FreeImage_IsAppendOnly
+*/
+static BOOL
+FreeImage_AppendPagesToHandle(MULTIBITMAPHEADER *header, PluginNode *node, BlockListIterator first_new, FreeImageIO *io, fi_handle handle, int flags) {
+	if (first_new == header->m_blocks.end()) {
+		return TRUE;
+	}
+
+	void *data = FreeImage_OpenAppend(node, io, handle);
+	if (!data) {
+		return FALSE;
+	}
+
+	BOOL success = TRUE;
+
+	int count = header->src_page_count;
+
+	for (BlockListIterator i = first_new; (i != header->m_blocks.end()) && success; ++i) {
+		FIBITMAP *dib = FreeImage_LoadPageFromBlock(header, *i);
+
+		success = dib ? node->m_plugin->save_proc(io, dib, handle, count, flags, data) : FALSE;
+		count++;
+
+		FreeImage_Unload(dib);
+	}
+
+	FreeImage_Close(node, io, handle, data);
+
+	return success;
+}
+
+/**
+Byte-copy the whole source stream of a multipage bitmap to a handle
+*/
+static BOOL
+FreeImage_CopySourceToHandle(MULTIBITMAPHEADER *header, FreeImageIO *io, fi_handle handle) {
+	const unsigned buffer_size = 1024 * 1024;
+
+	BYTE *buffer = (BYTE*)malloc(buffer_size);
+	if (!buffer) {
+		return FALSE;
+	}
+
+	BOOL success = TRUE;
+
+	header->io.seek_proc(header->handle, 0, SEEK_SET);
+
+	unsigned count = 0;
+	while (success && (count = header->io.read_proc(buffer, 1, buffer_size, header->handle)) > 0) {
+		success = (io->write_proc(buffer, 1, count, handle) == count) ? TRUE : FALSE;
+	}
+
+	free(buffer);
+
+	return success;
+}
+
 BOOL DLL_CALLCONV
 FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FreeImageIO *io, fi_handle handle, int flags) {
 	if(!bitmap || !bitmap->data || !io || !handle) {
@@ -441,20 +587,9 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 						
 						case BLOCK_REFERENCE:
 						{
-							// read the compressed data
-							
-							BYTE *compressed_data = (BYTE*)malloc(i->getSize() * sizeof(BYTE));
-							
-							header->m_cachefile.readFile((BYTE *)compressed_data, i->getReference(), i->getSize());
-							
-							// uncompress the data
-							
-							FIMEMORY *hmem = FreeImage_OpenMemory(compressed_data, i->getSize());
-							FIBITMAP *dib = FreeImage_LoadFromMemory(header->cache_fif, hmem, 0);
-							FreeImage_CloseMemory(hmem);
-							
-							// get rid of the buffer
-							free(compressed_data);
+							// load the page from the cache
+
+							FIBITMAP *dib = FreeImage_LoadPageFromBlock(header, *i);
 							
 							// save the data
 							
@@ -513,7 +648,21 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 						FreeImage_OutputMessageProc(header->fif, "Failed to open %s, %s", spool_name.c_str(), strerror(errno));
 						success = FALSE;
 					} else {
-						success = FreeImage_SaveMultiBitmapToHandle(header->fif, bitmap, &header->io, (fi_handle)f, flags);
+						BlockListIterator first_new;
+
+						if ((header->node->m_plugin->append_proc != NULL) && FreeImage_IsAppendOnly(header, &first_new)) {
+							// only new pages: copy the source as-is, then append the new pages to the copy
+
+							success = FreeImage_CopySourceToHandle(header, &header->io, (fi_handle)f);
+
+							if (success) {
+								header->io.seek_proc((fi_handle)f, 0, SEEK_SET);
+
+								success = FreeImage_AppendPagesToHandle(header, header->node, first_new, &header->io, (fi_handle)f, flags);
+							}
+						} else {
+							success = FreeImage_SaveMultiBitmapToHandle(header->fif, bitmap, &header->io, (fi_handle)f, flags);
+						}
 
 						// close the files
 
@@ -606,7 +755,7 @@ FreeImage_SavePageToBlock(MULTIBITMAPHEADER *header, FIBITMAP *data) {
 		return res;
 	}
 	// save the file to memory
-	if(!FreeImage_SaveToMemory(header->cache_fif, data, hmem, 0)) {
+	if(!FreeImage_SaveToMemory(header->cache_fif, data, hmem, GetCacheFlags(header->cache_fif))) {
 		FreeImage_CloseMemory(hmem);
 		return res;
 	}
@@ -769,7 +918,7 @@ FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *page, BOOL changed) {
 				// open a memory handle
 				FIMEMORY *hmem = FreeImage_OpenMemory();
 				// save the page to memory
-				FreeImage_SaveToMemory(header->cache_fif, page, hmem, 0);
+				FreeImage_SaveToMemory(header->cache_fif, page, hmem, GetCacheFlags(header->cache_fif));
 				// get the buffer from the memory stream
 				FreeImage_AcquireMemory(hmem, &compressed_data, &compressed_size);
 
@@ -885,6 +1034,7 @@ FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int
 						// cache the page count
 
 						header->page_count = FreeImage_InternalGetPageCount(bitmap);
+						header->src_page_count = header->page_count;
 
 						// allocate a continueus block to describe the bitmap
 						
@@ -910,6 +1060,48 @@ FreeImage_SaveMultiBitmapToMemory(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 		FreeImageIO io;
 		SetMemoryIO(&io);
 
+		if (bitmap && bitmap->data) {
+			MULTIBITMAPHEADER *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+			BlockListIterator first_new;
+
+			if ((fif == header->fif) && (header->node->m_plugin->append_proc != NULL) && FreeImage_IsAppendOnly(header, &first_new)) {
+				// only new pages: copy the source as-is, then append the new pages to it.
+				// Offsets stored in the document (e.g. TIFF IFD offsets) are absolute, so unless 
+				// the stream is empty the document is assembled in a scratch stream first
+
+				const long start = io.tell_proc((fi_handle)stream);
+
+				FIMEMORY *target = (start == 0) ? stream : FreeImage_OpenMemory();
+				if (!target) {
+					return FALSE;
+				}
+
+				BOOL success = FreeImage_CopySourceToHandle(header, &io, (fi_handle)target);
+
+				if (success) {
+					io.seek_proc((fi_handle)target, 0, SEEK_SET);
+
+					success = FreeImage_AppendPagesToHandle(header, header->node, first_new, &io, (fi_handle)target, flags);
+				}
+
+				if (target != stream) {
+					BYTE *data = NULL;
+					DWORD size = 0;
+
+					if (success && FreeImage_AcquireMemory(target, &data, &size)) {
+						success = (io.write_proc(data, 1, size, (fi_handle)stream) == size) ? TRUE : FALSE;
+					} else {
+						success = FALSE;
+					}
+
+					FreeImage_CloseMemory(target);
+				}
+
+				return success;
+			}
+		}
+
 		return FreeImage_SaveMultiBitmapToHandle(fif, bitmap, &io, (fi_handle)stream, flags);
 	}
 
@@ -33,7 +33,10 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
+// Minimum number of pixels worth a remapping thread
+#define NN_MIN_THREAD_PIXELS	(256 * 256)
 
 // Four primes near 500 - assume no image has a length so large
 // that it is divisible by all four primes
@@ -111,120 +114,6 @@ void NNQuantizer::unbiasnet() {
 	}
 }
 
-//////////////////////////////////////////////////////////////////////////////////
-// Insertion sort of network and building of netindex[0..255] (to do after unbias)
-// -------------------------------------------------------------------------------
-
-void NNQuantizer::inxbuild() {
-	int i,j,smallpos,smallval;
-	int *p,*q;
-	int previouscol,startpos;
-
-	previouscol = 0;
-	startpos = 0;
-	for (i = 0; i < netsize; i++) {
-		p = network[i];
-		smallpos = i;
-		smallval = p[FI_RGBA_GREEN];			// index on g
-		// find smallest in i..netsize-1
-		for (j = i+1; j < netsize; j++) {
-			q = network[j];
-			if (q[FI_RGBA_GREEN] < smallval) {	// index on g
-				smallpos = j;
-				smallval = q[FI_RGBA_GREEN];	// index on g
-			}
-		}
-		q = network[smallpos];
-		// swap p (i) and q (smallpos) entries
-		if (i != smallpos) {
-			j = q[FI_RGBA_BLUE];  q[FI_RGBA_BLUE]  = p[FI_RGBA_BLUE];  p[FI_RGBA_BLUE]  = j;
-			j = q[FI_RGBA_GREEN]; q[FI_RGBA_GREEN] = p[FI_RGBA_GREEN]; p[FI_RGBA_GREEN] = j;
-			j = q[FI_RGBA_RED];   q[FI_RGBA_RED]   = p[FI_RGBA_RED];   p[FI_RGBA_RED]   = j;
-			j = q[3];   q[3] = p[3];   p[3] = j;
-		}
-		// smallval entry is now in position i
-		if (smallval != previouscol) {
-			netindex[previouscol] = (startpos+i)>>1;
-			for (j = previouscol+1; j < smallval; j++)
-				netindex[j] = i;
-			previouscol = smallval;
-			startpos = i;
-		}
-	}
-	netindex[previouscol] = (startpos+maxnetpos)>>1;
-	for (j = previouscol+1; j < 256; j++)
-		netindex[j] = maxnetpos; // really 256
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// Search for BGR values 0..255 (after net is unbiased) and return colour index
-// ----------------------------------------------------------------------------
-
-int NNQuantizer::inxsearch(int b, int g, int r) {
-	int i, j, dist, a, bestd;
-	int *p;
-	int best;
-
-	bestd = 1000;		// biggest possible dist is 256*3
-	best = -1;
-	i = netindex[g];	// index on g
-	j = i-1;			// start at netindex[g] and work outwards
-
-	while ((i < netsize) || (j >= 0)) {
-		if (i < netsize) {
-			p = network[i];
-			dist = p[FI_RGBA_GREEN] - g;				// inx key
-			if (dist >= bestd)
-				i = netsize;	// stop iter
-			else {
-				i++;
-				if (dist < 0)
-					dist = -dist;
-				a = p[FI_RGBA_BLUE] - b;
-				if (a < 0)
-					a = -a;
-				dist += a;
-				if (dist < bestd) {
-					a = p[FI_RGBA_RED] - r;
-					if (a<0)
-						a = -a;
-					dist += a;
-					if (dist < bestd) {
-						bestd = dist;
-						best = p[3];
-					}
-				}
-			}
-		}
-		if (j >= 0) {
-			p = network[j];
-			dist = g - p[FI_RGBA_GREEN];			// inx key - reverse dif
-			if (dist >= bestd)
-				j = -1;	// stop iter
-			else {
-				j--;
-				if (dist < 0)
-					dist = -dist;
-				a = p[FI_RGBA_BLUE] - b;
-				if (a<0)
-					a = -a;
-				dist += a;
-				if (dist < bestd) {
-					a = p[FI_RGBA_RED] - r;
-					if (a<0)
-						a = -a;
-					dist += a;
-					if (dist < bestd) {
-						bestd = dist;
-						best = p[3];
-					}
-				}
-			}
-		}
-	}
-	return best;
-}
-
 ///////////////////////////////
 // Search for biased BGR values
 // ----------------------------
@@ -488,19 +377,20 @@ FIBITMAP* NNQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, RGBQUAD *Reserve
 		new_pal[j].rgbRed	= (BYTE)network[j][FI_RGBA_RED];
 	}
 
-	inxbuild();
-
-	// 6) Write output image using inxsearch(b,g,r)
-
-	for (WORD rows = 0; rows < img_height; rows++) {
-		BYTE *new_bits = FreeImage_GetScanLine(new_dib, rows);			
-		BYTE *bits = FreeImage_GetScanLine(dib_ptr, rows);
+	// 6) Write output image, mapping each pixel to the nearest palette entry
 
-		for (WORD cols = 0; cols < img_width; cols++) {
-			new_bits[cols] = (BYTE)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
+	try {
+		const PaletteMapper mapper(new_pal, netsize);
 
-			bits += 3;
-		}
+		const unsigned threads = FreeImage_GetThreadCount((size_t)img_width * img_height, NN_MIN_THREAD_PIXELS);
+		FreeImage_ParallelFor(0, img_height, threads, [&](unsigned first, unsigned last, unsigned) {
+			for (unsigned y = first; y < last; y++) {
+				mapper.MapLine(FreeImage_GetScanLine(new_dib, y), FreeImage_GetScanLine(dib_ptr, y), img_width, 3);
+			}
+		});
+	} catch (const char *) {
+		FreeImage_Unload(new_dib);
+		return NULL;
 	}
 
 	return (FIBITMAP*) new_dib;
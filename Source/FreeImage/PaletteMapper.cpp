@@ -0,0 +1,213 @@
+// ==========================================================
+// PaletteMapper class implementation
+// Nearest colour lookup against an arbitrary palette
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "Quantizers.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+
+// ----------------------------------------------------------
+
+/**
+Squared distance from a component value to the nearest and to the farthest
+value of the cell interval [lo, lo + 2^CELL_SHIFT - 1]
+*/
+static inline void
+CellDistance(int c, int lo, int hi, int *dmin, int *dmax) {
+	const int below = c - lo;
+	const int above = hi - c;
+	const int near_d = (below < 0) ? -below : ((above < 0) ? -above : 0);
+	const int far_d = MAX(below, above);
+	*dmin = near_d * near_d;
+	*dmax = far_d * far_d;
+}
+
+PaletteMapper::PaletteMapper(const RGBQUAD *palette, unsigned size) : m_groups(NULL), m_first(NULL), m_single(NULL) {
+	size = MAX(1U, MIN(size, 256U));
+
+	int red[256], green[256], blue[256];
+	for(unsigned i = 0; i < size; i++) {
+		red[i] = palette[i].rgbRed;
+		green[i] = palette[i].rgbGreen;
+		blue[i] = palette[i].rgbBlue;
+	}
+
+	m_first = (unsigned*)malloc((CELL_COUNT + 1) * sizeof(unsigned));
+	m_single = (short*)malloc(CELL_COUNT * sizeof(short));
+	// candidate lists of all cells, before they are packed into groups
+	BYTE *lists = (BYTE*)malloc(CELL_COUNT * size * sizeof(BYTE));
+	unsigned *counts = (unsigned*)malloc(CELL_COUNT * sizeof(unsigned));
+	if(!m_first || !m_single || !lists || !counts) {
+		free(lists);
+		free(counts);
+		free(m_first);
+		free(m_single);
+		throw FI_MSG_ERROR_MEMORY;
+	}
+
+	// an entry is a candidate of a cell if its distance to the cell is not greater than
+	// the smallest distance to the farthest point of the cell over all the entries: any
+	// colour of the cell is at least that close to some entry
+
+	int dmin[256];
+	unsigned total = 0;
+	const int side = 1 << CELL_SHIFT;
+
+	for(unsigned cell = 0; cell < CELL_COUNT; cell++) {
+		const int r0 = (int)(cell / (CELL_SIDE * CELL_SIDE)) << CELL_SHIFT;
+		const int g0 = (int)((cell / CELL_SIDE) % CELL_SIDE) << CELL_SHIFT;
+		const int b0 = (int)(cell % CELL_SIDE) << CELL_SHIFT;
+
+		int bound = INT_MAX;
+		for(unsigned i = 0; i < size; i++) {
+			int nr, ng, nb, fr, fg, fb;
+			CellDistance(red[i], r0, r0 + side - 1, &nr, &fr);
+			CellDistance(green[i], g0, g0 + side - 1, &ng, &fg);
+			CellDistance(blue[i], b0, b0 + side - 1, &nb, &fb);
+			dmin[i] = nr + ng + nb;
+			bound = MIN(bound, fr + fg + fb);
+		}
+
+		BYTE *list = lists + cell * size;
+		unsigned count = 0;
+		for(unsigned i = 0; i < size; i++) {
+			if(dmin[i] <= bound) {
+				list[count++] = (BYTE)i;
+			}
+		}
+		counts[cell] = count;
+		m_single[cell] = (count == 1) ? (short)list[0] : (short)-1;
+		m_first[cell] = total;
+		total += (count == 1) ? 0 : (count + 3) / 4;
+	}
+	m_first[CELL_COUNT] = total;
+
+	m_groups = (CandidateGroup*)malloc(MAX(total, 1U) * sizeof(CandidateGroup));
+	if(!m_groups) {
+		free(lists);
+		free(counts);
+		free(m_first);
+		free(m_single);
+		throw FI_MSG_ERROR_MEMORY;
+	}
+
+	// pack the lists, candidate k of a cell goes to lane k % 4 of group k / 4,
+	// so that each lane sees its candidates in increasing palette order
+	for(unsigned cell = 0; cell < CELL_COUNT; cell++) {
+		if(m_single[cell] >= 0) {
+			continue;
+		}
+		const BYTE *list = lists + cell * size;
+		const unsigned count = counts[cell];
+		CandidateGroup *group = m_groups + m_first[cell];
+		for(unsigned k = 0; k < (count + 3) / 4 * 4; k++) {
+			const unsigned i = list[MIN(k, count - 1)];
+			CandidateGroup &g = group[k / 4];
+			const unsigned lane = k % 4;
+			g.rg[2 * lane] = (short)red[i];
+			g.rg[2 * lane + 1] = (short)green[i];
+			g.b[2 * lane] = (short)blue[i];
+			g.b[2 * lane + 1] = 0;
+			g.index[lane] = (int)i;
+		}
+	}
+
+	free(lists);
+	free(counts);
+}
+
+PaletteMapper::~PaletteMapper() {
+	free(m_groups);
+	free(m_first);
+	free(m_single);
+}
+
+BYTE
+PaletteMapper::GetIndex(int red, int green, int blue) const {
+	const unsigned cell = (((unsigned)red >> CELL_SHIFT) * CELL_SIDE + ((unsigned)green >> CELL_SHIFT)) * CELL_SIDE + ((unsigned)blue >> CELL_SHIFT);
+	if(m_single[cell] >= 0) {
+		return (BYTE)m_single[cell];
+	}
+
+	const CandidateGroup *group = m_groups + m_first[cell];
+	const CandidateGroup *end = m_groups + m_first[cell + 1];
+
+#ifdef FREEIMAGE_SSE2
+	const __m128i color_rg = _mm_set1_epi32((green << 16) | red);
+	const __m128i color_b = _mm_set1_epi32(blue);
+	__m128i best = _mm_set1_epi32(INT_MAX);
+	__m128i best_index = _mm_setzero_si128();
+
+	for(; group < end; group++) {
+		const __m128i drg = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)group->rg), color_rg);
+		const __m128i db = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)group->b), color_b);
+		const __m128i dist = _mm_add_epi32(_mm_madd_epi16(drg, drg), _mm_madd_epi16(db, db));
+		// strictly closer only, so that each lane keeps its lowest index on ties
+		const __m128i closer = _mm_cmplt_epi32(dist, best);
+		best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+		best_index = _mm_or_si128(_mm_and_si128(closer, _mm_loadu_si128((const __m128i*)group->index)), _mm_andnot_si128(closer, best_index));
+	}
+
+	int dist[4], index[4];
+	_mm_storeu_si128((__m128i*)dist, best);
+	_mm_storeu_si128((__m128i*)index, best_index);
+
+	unsigned k = 0;
+	for(unsigned lane = 1; lane < 4; lane++) {
+		if((dist[lane] < dist[k]) || ((dist[lane] == dist[k]) && (index[lane] < index[k]))) {
+			k = lane;
+		}
+	}
+	return (BYTE)index[k];
+#else
+	int best = INT_MAX;
+	int best_index = 0;
+
+	// candidates are visited in increasing palette order
+	for(; group < end; group++) {
+		for(unsigned lane = 0; lane < 4; lane++) {
+			const int dr = group->rg[2 * lane] - red;
+			const int dg = group->rg[2 * lane + 1] - green;
+			const int db = group->b[2 * lane] - blue;
+			const int dist = dr * dr + dg * dg + db * db;
+			if(dist < best) {
+				best = dist;
+				best_index = group->index[lane];
+			}
+		}
+	}
+	return (BYTE)best_index;
+#endif // FREEIMAGE_SSE2
+}
+
+void
+PaletteMapper::MapLine(BYTE *target, const BYTE *source, unsigned width, unsigned bytespp) const {
+	// runs of identical pixels are looked up once
+	unsigned last_color = 0xFFFFFFFF;
+	BYTE last_index = 0;
+
+	for(unsigned x = 0; x < width; x++) {
+		const unsigned color = source[FI_RGBA_RED] | (source[FI_RGBA_GREEN] << 8) | (source[FI_RGBA_BLUE] << 16);
+		if(color != last_color) {
+			last_index = GetIndex(source[FI_RGBA_RED], source[FI_RGBA_GREEN], source[FI_RGBA_BLUE]);
+			last_color = color;
+		}
+		target[x] = last_index;
+		source += bytespp;
+	}
+}
@@ -364,6 +364,15 @@ FreeImage_Open(PluginNode *node, FreeImageIO *io, fi_handle handle, BOOL open_fo
 	return NULL;
 }
 
+void * DLL_CALLCONV
+FreeImage_OpenAppend(PluginNode *node, FreeImageIO *io, fi_handle handle) {
+	if (node->m_plugin->append_proc != NULL) {
+		return node->m_plugin->append_proc(io, handle);
+	}
+
+	return NULL;
+}
+
 void DLL_CALLCONV
 FreeImage_Close(PluginNode *node, FreeImageIO *io, fi_handle handle, void *data) {
 	if (node->m_plugin->close_proc != NULL) {
@@ -23,6 +23,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 // ----------------------------------------------------------
 //   Definitions for the RGB 444 format
@@ -288,50 +289,48 @@ typedef struct tagDDSHEADER {
 #define FOURCC_DXT4	MAKEFOURCC('D','X','T','4')
 #define FOURCC_DXT5	MAKEFOURCC('D','X','T','5')
 
-// ----------------------------------------------------------
-//   Structures used by DXT textures
-// ----------------------------------------------------------
+#define FOURCC_ATI1	MAKEFOURCC('A','T','I','1')
+#define FOURCC_BC4U	MAKEFOURCC('B','C','4','U')
+#define FOURCC_BC4S	MAKEFOURCC('B','C','4','S')
+#define FOURCC_ATI2	MAKEFOURCC('A','T','I','2')
+#define FOURCC_BC5U	MAKEFOURCC('B','C','5','U')
+#define FOURCC_BC5S	MAKEFOURCC('B','C','5','S')
+#define FOURCC_DX10	MAKEFOURCC('D','X','1','0')
 
-typedef struct tagColor8888 {
-	BYTE b;
-	BYTE g;
-	BYTE r;
-	BYTE a;
-} Color8888;
-
-typedef struct tagColor565 {
-	WORD b : 5;
-	WORD g : 6;
-	WORD r : 5;
-} Color565;
-
-typedef struct tagDXTColBlock {
-	Color565 colors[2];
-	BYTE row[4];
-} DXTColBlock;
-
-typedef struct tagDXTAlphaBlockExplicit {
-	WORD row[4];
-} DXTAlphaBlockExplicit;
-
-typedef struct tagDXTAlphaBlock3BitLinear {
-	BYTE alpha[2];
-	BYTE data[6];
-} DXTAlphaBlock3BitLinear;
-
-typedef struct tagDXT1Block {
-	DXTColBlock color;
-} DXT1Block;
-
-typedef struct tagDXT3Block {		// also used by dxt2
-	DXTAlphaBlockExplicit alpha;
-	DXTColBlock color;
-} DXT3Block;
-
-typedef struct tagDXT5Block {		// also used by dxt4
-	DXTAlphaBlock3BitLinear alpha;
-	DXTColBlock color;
-} DXT5Block;
+/**
+DDS_HEADER_DXT10 structure, following the DDS_HEADER when the FourCC is DX10
+*/
+typedef struct tagDDSHEADER_DXT10 {
+	DWORD dxgiFormat;			//! DXGI_FORMAT of the surface
+	DWORD resourceDimension;	//! D3D10_RESOURCE_DIMENSION of the surface
+	DWORD miscFlag;				//! DDS_RESOURCE_MISC_* flags
+	DWORD arraySize;			//! Number of elements in a texture array
+	DWORD miscFlags2;			//! Alpha mode
+} DDSHEADER_DXT10;
+
+/**
+DXGI_FORMAT values of the block compressed formats
+*/
+enum {
+	DXGI_FORMAT_BC1_TYPELESS	= 70,
+	DXGI_FORMAT_BC1_UNORM		= 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB	= 72,
+	DXGI_FORMAT_BC2_TYPELESS	= 73,
+	DXGI_FORMAT_BC2_UNORM		= 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB	= 75,
+	DXGI_FORMAT_BC3_TYPELESS	= 76,
+	DXGI_FORMAT_BC3_UNORM		= 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB	= 78,
+	DXGI_FORMAT_BC4_TYPELESS	= 79,
+	DXGI_FORMAT_BC4_UNORM		= 80,
+	DXGI_FORMAT_BC4_SNORM		= 81,
+	DXGI_FORMAT_BC5_TYPELESS	= 82,
+	DXGI_FORMAT_BC5_UNORM		= 83,
+	DXGI_FORMAT_BC5_SNORM		= 84,
+	DXGI_FORMAT_BC7_TYPELESS	= 97,
+	DXGI_FORMAT_BC7_UNORM		= 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB	= 99
+};
 
 #ifdef _WIN32
 #	pragma pack(pop)
@@ -356,220 +355,907 @@ SwapHeader(DDSHEADER *header) {
 	for(int i=0; i<11; i++) {
 		SwapLong(&header->surfaceDesc.dwReserved1[i]);
 	}
+	SwapLong(&header->surfaceDesc.ddspf.dwSize);
+	SwapLong(&header->surfaceDesc.ddspf.dwFlags);
+	SwapLong(&header->surfaceDesc.ddspf.dwFourCC);
+	SwapLong(&header->surfaceDesc.ddspf.dwRGBBitCount);
+	SwapLong(&header->surfaceDesc.ddspf.dwRBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwGBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwBBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwRGBAlphaBitMask);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwCaps1);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwCaps2);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwReserved[0]);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwReserved[1]);
 	SwapLong(&header->surfaceDesc.dwReserved2);
 }
+
+static void
+SwapHeaderDXT10(DDSHEADER_DXT10 *header) {
+	SwapLong(&header->dxgiFormat);
+	SwapLong(&header->resourceDimension);
+	SwapLong(&header->miscFlag);
+	SwapLong(&header->arraySize);
+	SwapLong(&header->miscFlags2);
+}
 #endif
 
+// ==========================================================
+//   Block compression (BCn) codecs
 // ==========================================================
 
 /**
-Get the 4 possible colors for a block
+Minimum number of pixels worth a thread when compressing or decompressing
 */
-static void 
-GetBlockColors(const DXTColBlock *block, Color8888 colors[4], bool isDXT1) {
-
-	// expand from 565 to 888
-	for (int i = 0; i < 2; i++)	{
-		colors[i].a = 0xFF;
-		/*
-		colors[i].r = (BYTE)(unsigned(block->colors[i].r) * 0xFF / 0x1F);
-		colors[i].g = (BYTE)(unsigned(block->colors[i].g) * 0xFF / 0x3F);
-		colors[i].b = (BYTE)(unsigned(block->colors[i].b) * 0xFF / 0x1F);
-		*/
-		colors[i].r = (BYTE)((unsigned(block->colors[i].r) << 3U) | (unsigned(block->colors[i].r) >> 2U));
-		colors[i].g = (BYTE)((unsigned(block->colors[i].g) << 2U) | (unsigned(block->colors[i].g) >> 4U));
-		colors[i].b = (BYTE)((unsigned(block->colors[i].b) << 3U) | (unsigned(block->colors[i].b) >> 2U));
-	}
-
-	const WORD *wCol = (WORD *)block->colors;
-	if ((wCol[0] > wCol[1]) || !isDXT1) {
-		// 4 color block
-		for (unsigned i = 0; i < 2; i++)	{
-			colors[i + 2].a = 0xFF;
-			colors[i + 2].r = (BYTE)((unsigned(colors[0].r) * (2 - i) + unsigned(colors[1].r) * (1 + i)) / 3);
-			colors[i + 2].g = (BYTE)((unsigned(colors[0].g) * (2 - i) + unsigned(colors[1].g) * (1 + i)) / 3);
-			colors[i + 2].b = (BYTE)((unsigned(colors[0].b) * (2 - i) + unsigned(colors[1].b) * (1 + i)) / 3);
+#define DDS_MIN_THREAD_PIXELS	(256 * 256)
+
+/**
+Block compressed formats
+*/
+typedef enum {
+	BLOCK_UNKNOWN = 0,
+	BLOCK_BC1 = 1,	//! DXT1
+	BLOCK_BC2 = 2,	//! DXT3
+	BLOCK_BC3 = 3,	//! DXT5
+	BLOCK_BC4U = 4,	//! ATI1, unsigned
+	BLOCK_BC4S = 5,	//! signed BC4
+	BLOCK_BC5U = 6,	//! ATI2, unsigned
+	BLOCK_BC5S = 7,	//! signed BC5
+	BLOCK_BC7 = 8	//! BPTC
+} DDSBlockFormat;
+
+/**
+Decode a 4x4 block into 16 pixels, stored row by row.
+Color formats output 32-bit pixels, BC4 outputs 8-bit and BC5 outputs 24-bit pixels.
+*/
+typedef void (*BlockDecoder)(const BYTE *block, BYTE *pixels);
+
+static inline DWORD
+MakePixel(unsigned r, unsigned g, unsigned b, unsigned a) {
+	return ((DWORD)r << FI_RGBA_RED_SHIFT) | ((DWORD)g << FI_RGBA_GREEN_SHIFT) | ((DWORD)b << FI_RGBA_BLUE_SHIFT) | ((DWORD)a << FI_RGBA_ALPHA_SHIFT);
+}
+
+/**
+Expand a RGB565 color to RGB888
+*/
+static inline void
+Expand565(unsigned color, int rgb[3]) {
+	rgb[0] = (int)(((color >> 8) & 0xF8) | (color >> 13));
+	rgb[1] = (int)(((color >> 3) & 0xFC) | ((color >> 9) & 0x03));
+	rgb[2] = (int)(((color << 3) & 0xF8) | ((color >> 2) & 0x07));
+}
+
+/**
+Get the 4 possible colors of a color block
+@param c0 First RGB565 endpoint
+@param c1 Second RGB565 endpoint
+@param colors Returned RGB colors
+@param three_color If true, use the 3 colors + transparent black mode
+*/
+static inline void
+GetBlockColors(unsigned c0, unsigned c1, int colors[4][3], bool three_color) {
+	Expand565(c0, colors[0]);
+	Expand565(c1, colors[1]);
+	for (int c = 0; c < 3; c++) {
+		if (!three_color) {
+			colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+			colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+		} else {
+			colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+			colors[3][c] = 0;
+		}
+	}
+}
+
+/**
+Get the 4 possible colors of a color block, as 32-bit pixels
+@param block Color block: 2 RGB565 endpoints followed by the 2-bit indices
+@param palette Returned pixels
+@param isBC1 BC1 blocks whose endpoints are not in decreasing order use the 3 colors + transparent black mode, 
+BC2 and BC3 blocks always use the 4 colors mode
+*/
+static inline void
+GetBlockPalette(const BYTE *block, DWORD palette[4], bool isBC1) {
+	const unsigned c0 = (unsigned)block[0] | ((unsigned)block[1] << 8);
+	const unsigned c1 = (unsigned)block[2] | ((unsigned)block[3] << 8);
+	const bool three_color = isBC1 && (c0 <= c1);
+
+	int colors[4][3];
+	GetBlockColors(c0, c1, colors, three_color);
+	for (int i = 0; i < 4; i++) {
+		palette[i] = MakePixel(colors[i][0], colors[i][1], colors[i][2], 0xFF);
+	}
+	if (three_color) {
+		palette[3] = 0;
+	}
+}
+
+/**
+Expand the 2-bit indices of a color block, a row of 4 pixels at a time
+@param indices 4 rows of 2-bit indices
+@param palette Block colors
+@param pixels Returned pixels
+*/
+static inline void
+DecodeColorIndices(const BYTE *indices, const DWORD palette[4], DWORD *pixels) {
+#ifdef FREEIMAGE_SSE2
+	const __m128i p0 = _mm_set1_epi32((int)palette[0]);
+	const __m128i p1 = _mm_set1_epi32((int)palette[1]);
+	const __m128i p2 = _mm_set1_epi32((int)palette[2]);
+	const __m128i p3 = _mm_set1_epi32((int)palette[3]);
+	// the index of pixel x is compared in place, at bit 2x
+	const __m128i mask = _mm_setr_epi32(0x03, 0x0C, 0x30, 0xC0);
+	const __m128i one = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+	const __m128i two = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+
+	for (int y = 0; y < 4; y++) {
+		const __m128i bits = _mm_and_si128(_mm_set1_epi32(indices[y]), mask);
+		__m128i color = _mm_and_si128(_mm_cmpeq_epi32(bits, _mm_setzero_si128()), p0);
+		color = _mm_or_si128(color, _mm_and_si128(_mm_cmpeq_epi32(bits, one), p1));
+		color = _mm_or_si128(color, _mm_and_si128(_mm_cmpeq_epi32(bits, two), p2));
+		color = _mm_or_si128(color, _mm_and_si128(_mm_cmpeq_epi32(bits, mask), p3));
+		_mm_storeu_si128((__m128i*)(pixels + 4 * y), color);
+	}
+#else
+	for (int y = 0; y < 4; y++) {
+		const unsigned row = indices[y];
+		for (int x = 0; x < 4; x++) {
+			pixels[4 * y + x] = palette[(row >> (2 * x)) & 3];
+		}
+	}
+#endif // FREEIMAGE_SSE2
+}
+
+/**
+Get the 8 possible values of an unsigned channel block (BC3 alpha, BC4, BC5)
+*/
+static inline void
+GetChannelTable(int a0, int a1, int table[8]) {
+	table[0] = a0;
+	table[1] = a1;
+	if (a0 > a1) {
+		// 8 values block
+		for (int i = 0; i < 6; i++) {
+			table[i + 2] = ((6 - i) * a0 + (1 + i) * a1 + 3) / 7;
 		}
 	}
 	else {
-		// 3 color block, number 4 is transparent
-		colors[2].a = 0xFF;
-		colors[2].r = (BYTE)((unsigned(colors[0].r) + unsigned(colors[1].r)) / 2);
-		colors[2].g = (BYTE)((unsigned(colors[0].g) + unsigned(colors[1].g)) / 2);
-		colors[2].b = (BYTE)((unsigned(colors[0].b) + unsigned(colors[1].b)) / 2);
-
-		colors[3].a = 0x00;
-		colors[3].g = 0x00;
-		colors[3].b = 0x00;
-		colors[3].r = 0x00;
-	}
-}
-
-typedef struct DXT_INFO_1 {
-	typedef DXT1Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 8
-	};
-} DXT_INFO_1;
-
-typedef struct DXT_INFO_3 {
-	typedef DXT3Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-} DXT_INFO_3;
-
-typedef struct DXT_INFO_5 {
-	typedef DXT5Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-} DXT_INFO_5;
-
-/**
-Base decoder
-*/
-template <class DXT_INFO> class DXT_BLOCKDECODER_BASE {
-protected:
-	Color8888 m_colors[4];
-	const typename DXT_INFO::Block *m_pBlock;
-	unsigned m_colorRow;
+		// 6 values block
+		for (int i = 0; i < 4; i++) {
+			table[i + 2] = ((4 - i) * a0 + (1 + i) * a1 + 2) / 5;
+		}
+		table[6] = 0;
+		table[7] = 0xFF;
+	}
+}
 
-public:
-	void Setup(const BYTE *pBlock) {
-		// get a pointer to the block
-		m_pBlock = (const typename DXT_INFO::Block *)pBlock;
+/**
+Decode a channel block: 2 endpoints followed by the 3-bit indices
+@param block Channel block
+@param values Returned values
+@param isSigned If true, the block holds signed values, which are returned biased to [0..255]
+*/
+static inline void
+DecodeChannelBlock(const BYTE *block, BYTE values[16], bool isSigned) {
+	int table[8];
 
-		// get the 4 possible colors for a block
-		GetBlockColors(&m_pBlock->color, m_colors, DXT_INFO::isDXT1);
+	if (!isSigned) {
+		GetChannelTable(block[0], block[1], table);
+	}
+	else {
+		// -128 is the same as -127
+		const int a0 = MAX((int)(signed char)block[0], -127);
+		const int a1 = MAX((int)(signed char)block[1], -127);
+		table[0] = a0;
+		table[1] = a1;
+		if (a0 > a1) {
+			for (int i = 0; i < 6; i++) {
+				const int v = (6 - i) * a0 + (1 + i) * a1;
+				table[i + 2] = (v >= 0) ? (v + 3) / 7 : (v - 3) / 7;
+			}
+		}
+		else {
+			for (int i = 0; i < 4; i++) {
+				const int v = (4 - i) * a0 + (1 + i) * a1;
+				table[i + 2] = (v >= 0) ? (v + 2) / 5 : (v - 2) / 5;
+			}
+			table[6] = -127;
+			table[7] = 127;
+		}
+		for (int i = 0; i < 8; i++) {
+			table[i] = ((table[i] + 127) * 255 + 127) / 254;
+		}
 	}
 
-	/**
-	Update y scanline
-	*/
-	void SetY(const int y) {
-		m_colorRow = m_pBlock->color.row[y];
+	UINT64 bits = 0;
+	for (int i = 0; i < 6; i++) {
+		bits |= (UINT64)block[2 + i] << (8 * i);
 	}
+	for (int i = 0; i < 16; i++) {
+		values[i] = (BYTE)table[(bits >> (3 * i)) & 7];
+	}
+}
 
-	/**
-	Get Color at (x, y) where y is set by SetY
-	@see SetY
-	*/
-	void GetColor(const int x, Color8888 *color) {
-		unsigned bits = (m_colorRow >> (x * 2)) & 3;
-		memcpy(color, &m_colors[bits], sizeof(Color8888));
+static void
+DecodeBlockBC1(const BYTE *block, BYTE *pixels) {
+	DWORD palette[4];
+	GetBlockPalette(block, palette, true);
+	DecodeColorIndices(block + 4, palette, (DWORD*)pixels);
+}
+
+static void
+DecodeBlockBC2(const BYTE *block, BYTE *pixels) {
+	DWORD *colors = (DWORD*)pixels;
+	DWORD palette[4];
+	GetBlockPalette(block + 8, palette, false);
+	DecodeColorIndices(block + 12, palette, colors);
+
+	// explicit 4-bit alpha
+	for (int i = 0; i < 16; i++) {
+		const unsigned alpha = (block[i >> 1] >> ((i & 1) * 4)) & 0xF;
+		colors[i] = (colors[i] & ~(DWORD)FI_RGBA_ALPHA_MASK) | ((DWORD)(alpha * 0x11) << FI_RGBA_ALPHA_SHIFT);
+	}
+}
+
+static void
+DecodeBlockBC3(const BYTE *block, BYTE *pixels) {
+	DWORD *colors = (DWORD*)pixels;
+	DWORD palette[4];
+	GetBlockPalette(block + 8, palette, false);
+	DecodeColorIndices(block + 12, palette, colors);
+
+	// interpolated alpha
+	BYTE alpha[16];
+	DecodeChannelBlock(block, alpha, false);
+	for (int i = 0; i < 16; i++) {
+		colors[i] = (colors[i] & ~(DWORD)FI_RGBA_ALPHA_MASK) | ((DWORD)alpha[i] << FI_RGBA_ALPHA_SHIFT);
+	}
+}
+
+static void
+DecodeBlockBC4U(const BYTE *block, BYTE *pixels) {
+	DecodeChannelBlock(block, pixels, false);
+}
+
+static void
+DecodeBlockBC4S(const BYTE *block, BYTE *pixels) {
+	DecodeChannelBlock(block, pixels, true);
+}
+
+static inline void
+DecodeBlockBC5(const BYTE *block, BYTE *pixels, bool isSigned) {
+	BYTE red[16], green[16];
+	DecodeChannelBlock(block, red, isSigned);
+	DecodeChannelBlock(block + 8, green, isSigned);
+	for (int i = 0; i < 16; i++, pixels += 3) {
+		pixels[FI_RGBA_RED] = red[i];
+		pixels[FI_RGBA_GREEN] = green[i];
+		pixels[FI_RGBA_BLUE] = 0;
 	}
+}
 
+static void
+DecodeBlockBC5U(const BYTE *block, BYTE *pixels) {
+	DecodeBlockBC5(block, pixels, false);
+}
+
+static void
+DecodeBlockBC5S(const BYTE *block, BYTE *pixels) {
+	DecodeBlockBC5(block, pixels, true);
+}
+
+// ----------------------------------------------------------
+//   BC7
+// ----------------------------------------------------------
+
+/**
+BC7 block modes
+*/
+typedef struct tagBC7Mode {
+	BYTE subsets;			//! number of subsets (partitions)
+	BYTE partitionBits;		//! partition selection bits
+	BYTE rotationBits;		//! channel rotation bits
+	BYTE indexSelectionBits;//! index selection bit
+	BYTE colorBits;			//! color endpoint bits
+	BYTE alphaBits;			//! alpha endpoint bits
+	BYTE endpointPBits;		//! one P-bit per endpoint
+	BYTE sharedPBits;		//! one P-bit per subset
+	BYTE indexBits;			//! primary index bits
+	BYTE index2Bits;		//! secondary index bits
+} BC7Mode;
+
+static const BC7Mode s_bc7_modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
 };
 
-class DXT_BLOCKDECODER_1 : public DXT_BLOCKDECODER_BASE<DXT_INFO_1> {
-public:
-	typedef DXT_INFO_1 INFO;
+/**
+2 subsets partitions: bit i gives the subset of pixel i
+*/
+static const WORD s_bc7_partitions2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
 };
 
-class DXT_BLOCKDECODER_3 : public DXT_BLOCKDECODER_BASE<DXT_INFO_3> {
-public:
-	typedef DXT_BLOCKDECODER_BASE<DXT_INFO_3> base;
-	typedef DXT_INFO_3 INFO;
+/**
+3 subsets partitions: subset of each pixel
+*/
+static const BYTE s_bc7_partitions3[64][16] = {
+	{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 },
+	{ 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+	{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 },
+	{ 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+	{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 },
+	{ 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+	{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 },
+	{ 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+	{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 },
+	{ 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+	{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 },
+	{ 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+	{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 },
+	{ 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+	{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 },
+	{ 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+	{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 },
+	{ 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+	{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+	{ 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+	{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 },
+	{ 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+	{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 },
+	{ 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+	{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 },
+	{ 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+	{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 },
+	{ 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+	{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 },
+	{ 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+	{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 },
+	{ 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 }
+};
 
-protected:
-	unsigned m_alphaRow;
+/**
+Anchor index of the second subset, 2 subsets partitions
+*/
+static const BYTE s_bc7_anchors2[64] = {
+	15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+	15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+	 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15
+};
+
+/**
+Anchor index of the second subset, 3 subsets partitions
+*/
+static const BYTE s_bc7_anchors3_2[64] = {
+	 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+	 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+	 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+	 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3
+};
+
+/**
+Anchor index of the third subset, 3 subsets partitions
+*/
+static const BYTE s_bc7_anchors3_3[64] = {
+	15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+	15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+	15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+	15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8
+};
+
+static const BYTE s_bc7_weights2[4] = { 0, 21, 43, 64 };
+static const BYTE s_bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const BYTE s_bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/**
+Little-endian bit reader over a 128-bit block
+*/
+class BC7BitReader {
+private:
+	UINT64 m_low;
+	UINT64 m_high;
 
 public:
-	void SetY(int y) {
-		base::SetY(y);
-		m_alphaRow = m_pBlock->alpha.row[y];
+	BC7BitReader(const BYTE *block) : m_low(0), m_high(0) {
+		for (int i = 0; i < 8; i++) {
+			m_low |= (UINT64)block[i] << (8 * i);
+			m_high |= (UINT64)block[8 + i] << (8 * i);
+		}
 	}
 
 	/**
-	Get the color at (x, y) where y is set by SetY
-	@see SetY
+	Read up to 8 bits
 	*/
-	void GetColor(int x, Color8888 *color) {
-		base::GetColor(x, color);
-		const unsigned bits = (m_alphaRow >> (x * 4)) & 0xF;
-		color->a = (BYTE)((bits * 0xFF) / 0xF);
+	unsigned read(unsigned count) {
+		if (count == 0) {
+			return 0;
+		}
+		const unsigned value = (unsigned)(m_low & ((1U << count) - 1));
+		m_low = (m_low >> count) | (m_high << (64 - count));
+		m_high >>= count;
+		return value;
 	}
 };
 
-class DXT_BLOCKDECODER_5 : public DXT_BLOCKDECODER_BASE<DXT_INFO_5> {
-public:
-	typedef DXT_BLOCKDECODER_BASE<DXT_INFO_5> base;
-	typedef DXT_INFO_5 INFO;
+static inline const BYTE *
+GetBC7Weights(unsigned bits) {
+	return (bits == 2) ? s_bc7_weights2 : ((bits == 3) ? s_bc7_weights3 : s_bc7_weights4);
+}
 
-protected:
-	unsigned m_alphas[8];
-	unsigned m_alphaBits;
-	int m_offset;
+/**
+Expand a quantized endpoint component to 8 bits
+*/
+static inline unsigned
+UnquantizeBC7(unsigned value, unsigned bits) {
+	value <<= (8 - bits);
+	return value | (value >> bits);
+}
 
-public:
-	void Setup (const BYTE *pBlock) {
-		base::Setup (pBlock);
-
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphas[0] = block.alpha[0];
-		m_alphas[1] = block.alpha[1];
-		if (m_alphas[0] > m_alphas[1]) {
-			// 8 alpha block
-			for (int i = 0; i < 6; i++) {
-				m_alphas[i + 2] = ((6 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 3) / 7;
+static void
+DecodeBlockBC7(const BYTE *block, BYTE *pixels) {
+	DWORD *colors = (DWORD*)pixels;
+
+	unsigned mode = 0;
+	while ((mode < 8) && !(block[0] & (1 << mode))) {
+		mode++;
+	}
+	if (mode == 8) {
+		// reserved mode: transparent black
+		memset(colors, 0, 16 * sizeof(DWORD));
+		return;
+	}
+
+	const BC7Mode &info = s_bc7_modes[mode];
+	BC7BitReader bits(block);
+	bits.read(mode + 1);
+
+	const unsigned partition = bits.read(info.partitionBits);
+	const unsigned rotation = bits.read(info.rotationBits);
+	const unsigned index_selection = bits.read(info.indexSelectionBits);
+
+	// endpoints, channel after channel
+	const unsigned endpoints = 2 * info.subsets;
+	unsigned ep[6][4];
+	for (unsigned c = 0; c < 3; c++) {
+		for (unsigned e = 0; e < endpoints; e++) {
+			ep[e][c] = bits.read(info.colorBits);
+		}
+	}
+	for (unsigned e = 0; e < endpoints; e++) {
+		ep[e][3] = info.alphaBits ? bits.read(info.alphaBits) : 0xFF;
+	}
+
+	unsigned color_bits = info.colorBits;
+	unsigned alpha_bits = info.alphaBits;
+	if (info.endpointPBits || info.sharedPBits) {
+		unsigned pbits[6];
+		if (info.endpointPBits) {
+			for (unsigned e = 0; e < endpoints; e++) {
+				pbits[e] = bits.read(1);
+			}
+		} else {
+			for (unsigned s = 0; s < info.subsets; s++) {
+				pbits[2 * s] = pbits[2 * s + 1] = bits.read(1);
 			}
 		}
-		else {
-			// 6 alpha block
-			for (int i = 0; i < 4; i++) {
-				m_alphas[i + 2] = ((4 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 2) / 5;
+		for (unsigned e = 0; e < endpoints; e++) {
+			for (unsigned c = 0; c < 3; c++) {
+				ep[e][c] = (ep[e][c] << 1) | pbits[e];
+			}
+			if (alpha_bits) {
+				ep[e][3] = (ep[e][3] << 1) | pbits[e];
 			}
-			m_alphas[6] = 0;
-			m_alphas[7] = 0xFF;
 		}
+		color_bits++;
+		if (alpha_bits) {
+			alpha_bits++;
+		}
+	}
+	for (unsigned e = 0; e < endpoints; e++) {
+		for (unsigned c = 0; c < 3; c++) {
+			ep[e][c] = UnquantizeBC7(ep[e][c], color_bits);
+		}
+		if (alpha_bits) {
+			ep[e][3] = UnquantizeBC7(ep[e][3], alpha_bits);
+		}
+	}
+
+	// subset of each pixel and anchor indices, whose most significant bit is implicit
+	BYTE subset[16];
+	unsigned anchors[3] = { 0, 0, 0 };
+	for (unsigned i = 0; i < 16; i++) {
+		switch (info.subsets) {
+			case 1:
+				subset[i] = 0;
+				break;
+			case 2:
+				subset[i] = (BYTE)((s_bc7_partitions2[partition] >> i) & 1);
+				break;
+			default:
+				subset[i] = s_bc7_partitions3[partition][i];
+				break;
+		}
+	}
+	if (info.subsets == 2) {
+		anchors[1] = s_bc7_anchors2[partition];
+	}
+	else if (info.subsets == 3) {
+		anchors[1] = s_bc7_anchors3_2[partition];
+		anchors[2] = s_bc7_anchors3_3[partition];
 	}
 
-	void SetY(const int y) {
-		base::SetY(y);
-		const int i = y / 2;
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		const BYTE *data = &block.data[i * 3];
-		m_alphaBits = unsigned(data[0]) | (unsigned(data[1]) << 8) | (unsigned(data[2]) << 16);
-		m_offset = (y & 1) * 12;
+	BYTE indices[16];
+	BYTE indices2[16];
+	for (unsigned i = 0; i < 16; i++) {
+		const unsigned anchor = (i == anchors[subset[i]]) ? 1 : 0;
+		indices[i] = (BYTE)bits.read(info.indexBits - anchor);
+	}
+	if (info.index2Bits) {
+		for (unsigned i = 0; i < 16; i++) {
+			indices2[i] = (BYTE)bits.read(info.index2Bits - (i == 0 ? 1 : 0));
+		}
 	}
 
-	/**
-	Get the color at (x, y) where y is set by SetY
-	@see SetY
-	*/
-	void GetColor(int x, Color8888 *color) {
-		base::GetColor(x, color);
-		unsigned bits = (m_alphaBits >> (x * 3 + m_offset)) & 7;
-		color->a = (BYTE)m_alphas[bits];
+	// select the index sets used for the color and the alpha
+	const BYTE *color_indices = indices;
+	const BYTE *alpha_indices = indices;
+	unsigned color_index_bits = info.indexBits;
+	unsigned alpha_index_bits = info.indexBits;
+	if (info.index2Bits) {
+		if (index_selection) {
+			color_indices = indices2;
+			color_index_bits = info.index2Bits;
+		} else {
+			alpha_indices = indices2;
+			alpha_index_bits = info.index2Bits;
+		}
+	}
+	const BYTE *color_weights = GetBC7Weights(color_index_bits);
+	const BYTE *alpha_weights = GetBC7Weights(alpha_index_bits);
+
+	for (unsigned i = 0; i < 16; i++) {
+		const unsigned *e0 = ep[2 * subset[i]];
+		const unsigned *e1 = ep[2 * subset[i] + 1];
+		const unsigned cw = color_weights[color_indices[i]];
+		const unsigned aw = alpha_weights[alpha_indices[i]];
+
+		unsigned rgba[4];
+		for (unsigned c = 0; c < 3; c++) {
+			rgba[c] = ((64 - cw) * e0[c] + cw * e1[c] + 32) >> 6;
+		}
+		rgba[3] = ((64 - aw) * e0[3] + aw * e1[3] + 32) >> 6;
+		if (rotation) {
+			// swap the alpha with the red (1), green (2) or blue (3) channel
+			const unsigned tmp = rgba[3];
+			rgba[3] = rgba[rotation - 1];
+			rgba[rotation - 1] = tmp;
+		}
+		colors[i] = MakePixel(rgba[0], rgba[1], rgba[2], rgba[3]);
+	}
+}
+
+// ----------------------------------------------------------
+//   BC1 / BC3 encoder
+// ----------------------------------------------------------
+
+static inline int
+ClampByte(int value) {
+	return (value < 0) ? 0 : ((value > 0xFF) ? 0xFF : value);
+}
+
+static inline unsigned
+PackRGB565(const int rgb[3]) {
+	const unsigned r = (unsigned)(ClampByte(rgb[0]) * 31 + 127) / 255;
+	const unsigned g = (unsigned)(ClampByte(rgb[1]) * 63 + 127) / 255;
+	const unsigned b = (unsigned)(ClampByte(rgb[2]) * 31 + 127) / 255;
+	return (r << 11) | (g << 5) | b;
+}
+
+/**
+Get a 4x4 block of RGBA pixels, replicating the last row and column of partial blocks
+*/
+static inline void
+FetchBlock(FIBITMAP *dib, unsigned width, unsigned height, unsigned bytespp, unsigned x0, unsigned y0, BYTE pixels[16][4]) {
+	for (unsigned y = 0; y < 4; y++) {
+		const BYTE *line = FreeImage_GetScanLine(dib, height - 1 - MIN(y0 + y, height - 1));
+		for (unsigned x = 0; x < 4; x++) {
+			const BYTE *p = line + MIN(x0 + x, width - 1) * bytespp;
+			BYTE *dst = pixels[4 * y + x];
+			dst[0] = p[FI_RGBA_RED];
+			dst[1] = p[FI_RGBA_GREEN];
+			dst[2] = p[FI_RGBA_BLUE];
+			dst[3] = (bytespp == 4) ? p[FI_RGBA_ALPHA] : 0xFF;
+		}
+	}
+}
+
+/**
+Choose the color endpoints of a block
+@param pixels Block pixels
+@param fast If true, use the inset bounding box of the colors, otherwise use the principal axis of the colors
+@param skip_transparent If true, ignore the pixels with alpha < 128
+@param ep0 Returned first endpoint
+@param ep1 Returned second endpoint
+*/
+static void
+GetColorEndpoints(const BYTE pixels[16][4], bool fast, bool skip_transparent, int ep0[3], int ep1[3]) {
+	int lo[3] = { 255, 255, 255 };
+	int hi[3] = { 0, 0, 0 };
+	int sum[3] = { 0, 0, 0 };
+	int count = 0;
+
+	for (int i = 0; i < 16; i++) {
+		if (skip_transparent && (pixels[i][3] < 128)) {
+			continue;
+		}
+		for (int c = 0; c < 3; c++) {
+			lo[c] = MIN(lo[c], (int)pixels[i][c]);
+			hi[c] = MAX(hi[c], (int)pixels[i][c]);
+			sum[c] += pixels[i][c];
+		}
+		count++;
+	}
+	if (count == 0) {
+		for (int c = 0; c < 3; c++) {
+			ep0[c] = ep1[c] = 0;
+		}
+		return;
 	}
-};
 
-template <class DECODER> void DecodeDXTBlock (BYTE *dstData, const BYTE *srcBlock, long dstPitch, int bw, int bh) {
-	DECODER decoder;
-	decoder.Setup(srcBlock);
-	for (int y = 0; y < bh; y++) {
-		BYTE *dst = dstData - y * dstPitch;
-		// update scanline
-		decoder.SetY(y);
-		for (int x = 0; x < bw; x++) {
-			// GetColor(x, y, dst)
-			Color8888 *color = (Color8888*)dst;
-			decoder.GetColor(x, color);
+	if (fast) {
+		// inset the bounding box by 1/16 of its size, on each side
+		for (int c = 0; c < 3; c++) {
+			const int inset = (hi[c] - lo[c]) >> 4;
+			ep0[c] = hi[c] - inset;
+			ep1[c] = lo[c] + inset;
+		}
+		return;
+	}
+
+	// covariance matrix of the colors
+	float mean[3];
+	for (int c = 0; c < 3; c++) {
+		mean[c] = (float)sum[c] / count;
+	}
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		if (skip_transparent && (pixels[i][3] < 128)) {
+			continue;
+		}
+		const float r = pixels[i][0] - mean[0];
+		const float g = pixels[i][1] - mean[1];
+		const float b = pixels[i][2] - mean[2];
+		cov[0] += r * r;
+		cov[1] += r * g;
+		cov[2] += r * b;
+		cov[3] += g * g;
+		cov[4] += g * b;
+		cov[5] += b * b;
+	}
+
+	// principal axis, by power iteration from the bounding box diagonal
+	float axis[3] = { (float)(hi[0] - lo[0]), (float)(hi[1] - lo[1]), (float)(hi[2] - lo[2]) };
+	for (int iter = 0; iter < 4; iter++) {
+		const float r = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+		const float g = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+		const float b = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+		const float norm = MAX(fabsf(r), MAX(fabsf(g), fabsf(b)));
+		if (norm < 1e-6F) {
+			break;
+		}
+		axis[0] = r / norm;
+		axis[1] = g / norm;
+		axis[2] = b / norm;
+	}
+
+	// the endpoints are the extreme colors along the axis
+	float min_dot = 1e30F, max_dot = -1e30F;
+	int min_index = 0, max_index = 0;
+	for (int i = 0; i < 16; i++) {
+		if (skip_transparent && (pixels[i][3] < 128)) {
+			continue;
+		}
+		const float dot = pixels[i][0] * axis[0] + pixels[i][1] * axis[1] + pixels[i][2] * axis[2];
+		if (dot < min_dot) {
+			min_dot = dot;
+			min_index = i;
+		}
+		if (dot > max_dot) {
+			max_dot = dot;
+			max_index = i;
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		ep0[c] = pixels[max_index][c];
+		ep1[c] = pixels[min_index][c];
+	}
+}
+
+/**
+Choose the nearest block color of each pixel
+@return Returns the squared error of the block
+*/
+static int
+SelectColorIndices(const BYTE pixels[16][4], unsigned c0, unsigned c1, bool three_color, BYTE indices[16]) {
+	int colors[4][3];
+	GetBlockColors(c0, c1, colors, three_color);
+	const int count = three_color ? 3 : 4;
+
+	int error = 0;
+	for (int i = 0; i < 16; i++) {
+		if (three_color && (pixels[i][3] < 128)) {
+			// transparent black
+			indices[i] = 3;
+			continue;
+		}
+		int best = 0;
+		int best_error = INT_MAX;
+		for (int k = 0; k < count; k++) {
+			const int dr = colors[k][0] - pixels[i][0];
+			const int dg = colors[k][1] - pixels[i][1];
+			const int db = colors[k][2] - pixels[i][2];
+			const int e = dr * dr + dg * dg + db * db;
+			if (e < best_error) {
+				best_error = e;
+				best = k;
+			}
+		}
+		indices[i] = (BYTE)best;
+		error += best_error;
+	}
+	return error;
+}
+
+/**
+Solve the endpoints which best fit the pixels, for the given 4 colors mode indices (least squares)
+@return Returns false if the system is singular
+*/
+static bool
+RefineColorEndpoints(const BYTE pixels[16][4], const BYTE indices[16], int ep0[3], int ep1[3]) {
+	static const float w0[4] = { 1.0F, 0.0F, 2.0F / 3, 1.0F / 3 };
+
+	float a = 0, b = 0, c = 0;
+	float x0[3] = { 0, 0, 0 };
+	float x1[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		const float u = w0[indices[i]];
+		const float v = 1.0F - u;
+		a += u * u;
+		b += u * v;
+		c += v * v;
+		for (int k = 0; k < 3; k++) {
+			x0[k] += u * pixels[i][k];
+			x1[k] += v * pixels[i][k];
+		}
+	}
+	const float det = a * c - b * b;
+	if (fabsf(det) < 1e-6F) {
+		return false;
+	}
+	for (int k = 0; k < 3; k++) {
+		ep0[k] = (int)floorf((c * x0[k] - b * x1[k]) / det + 0.5F);
+		ep1[k] = (int)floorf((a * x1[k] - b * x0[k]) / det + 0.5F);
+	}
+	return true;
+}
+
+/**
+Order the endpoints as required by the block mode: decreasing for the 4 colors mode, 
+increasing for the 3 colors + transparent mode
+*/
+static inline void
+OrderEndpoints(unsigned &c0, unsigned &c1, bool three_color) {
+	if (three_color ? (c0 > c1) : (c0 < c1)) {
+		const unsigned tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+}
+
+/**
+Encode the color part of a block
+@param pixels Block pixels
+@param punch_through If true, pixels with alpha < 128 are encoded as transparent (BC1 only)
+@param fast If true, skip the principal axis search and the least squares refinement
+@param block Returned 8-byte color block
+*/
+static void
+EncodeColorBlock(const BYTE pixels[16][4], bool punch_through, bool fast, BYTE *block) {
+	bool three_color = false;
+	if (punch_through) {
+		for (int i = 0; i < 16; i++) {
+			if (pixels[i][3] < 128) {
+				three_color = true;
+				break;
+			}
+		}
+	}
+
+	int ep0[3], ep1[3];
+	GetColorEndpoints(pixels, fast, three_color, ep0, ep1);
+	unsigned c0 = PackRGB565(ep0);
+	unsigned c1 = PackRGB565(ep1);
+	OrderEndpoints(c0, c1, three_color);
+
+	BYTE indices[16];
+	int error = SelectColorIndices(pixels, c0, c1, three_color, indices);
+
+	if (!fast && !three_color && (error > 0)) {
+		if (RefineColorEndpoints(pixels, indices, ep0, ep1)) {
+			unsigned r0 = PackRGB565(ep0);
+			unsigned r1 = PackRGB565(ep1);
+			OrderEndpoints(r0, r1, false);
+
+			BYTE refined[16];
+			const int refined_error = SelectColorIndices(pixels, r0, r1, false, refined);
+			if (refined_error < error) {
+				c0 = r0;
+				c1 = r1;
+				memcpy(indices, refined, sizeof(refined));
+			}
+		}
+	}
+
+	block[0] = (BYTE)(c0 & 0xFF);
+	block[1] = (BYTE)(c0 >> 8);
+	block[2] = (BYTE)(c1 & 0xFF);
+	block[3] = (BYTE)(c1 >> 8);
+	for (int y = 0; y < 4; y++) {
+		block[4 + y] = (BYTE)(indices[4 * y] | (indices[4 * y + 1] << 2) | (indices[4 * y + 2] << 4) | (indices[4 * y + 3] << 6));
+	}
+}
+
+/**
+Encode the alpha part of a BC3 block
+@param pixels Block pixels
+@param block Returned 8-byte alpha block
+*/
+static void
+EncodeAlphaBlock(const BYTE pixels[16][4], BYTE *block) {
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++) {
+		lo = MIN(lo, (int)pixels[i][3]);
+		hi = MAX(hi, (int)pixels[i][3]);
+	}
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB 
-			INPLACESWAP(dst[FI_RGBA_RED], dst[FI_RGBA_BLUE]);
-#endif 
-			dst += 4;
+	block[0] = (BYTE)hi;
+	block[1] = (BYTE)lo;
+
+	UINT64 bits = 0;
+	if (hi > lo) {
+		// 8 values mode
+		int table[8];
+		GetChannelTable(hi, lo, table);
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int best_error = INT_MAX;
+			for (int k = 0; k < 8; k++) {
+				const int e = abs(table[k] - (int)pixels[i][3]);
+				if (e < best_error) {
+					best_error = e;
+					best = k;
+				}
+			}
+			bits |= (UINT64)best << (3 * i);
 		}
 	}
+	for (int i = 0; i < 6; i++) {
+		block[2 + i] = (BYTE)(bits >> (8 * i));
+	}
 }
 
 // ==========================================================
@@ -671,106 +1357,149 @@ LoadRGB(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
 }
 
 /**
+@param format Block compressed format
+@param desc DDS_HEADER structure
 @param io FreeImage IO
 @param handle FreeImage handle
-@param dib Returned dib (already allocated)
-@param width Image width
-@param height Image height
 */
-template <class DECODER> static void 
-LoadDXT_Helper(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int width, int height) {
-	typedef typename DECODER::INFO INFO;
-	typedef typename INFO::Block Block;
+static FIBITMAP *
+LoadBC(DDSBlockFormat format, const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
+	BlockDecoder decoder = NULL;
+	unsigned block_size = 16;
+	unsigned bpp = 32;
 
-	// get the size of a line in bytes
-	int line = CalculateLine(width, FreeImage_GetBPP(dib));
+	switch (format) {
+		case BLOCK_BC1:
+			decoder = DecodeBlockBC1;
+			block_size = 8;
+			break;
+		case BLOCK_BC2:
+			decoder = DecodeBlockBC2;
+			break;
+		case BLOCK_BC3:
+			decoder = DecodeBlockBC3;
+			break;
+		case BLOCK_BC4U:
+		case BLOCK_BC4S:
+			decoder = (format == BLOCK_BC4U) ? DecodeBlockBC4U : DecodeBlockBC4S;
+			block_size = 8;
+			bpp = 8;
+			break;
+		case BLOCK_BC5U:
+		case BLOCK_BC5S:
+			decoder = (format == BLOCK_BC5U) ? DecodeBlockBC5U : DecodeBlockBC5S;
+			bpp = 24;
+			break;
+		case BLOCK_BC7:
+			decoder = DecodeBlockBC7;
+			break;
+		default:
+			return NULL;
+	}
 
-	Block *input_buffer = new(std::nothrow) Block[(width + 3) / 4];
-	if (!input_buffer) {
-		return;
+	// blocks cover the whole image, the last row and column of blocks may be partially used
+	const unsigned width = (unsigned)desc->dwWidth;
+	const unsigned height = (unsigned)desc->dwHeight;
+	if (!width || !height) {
+		return NULL;
+	}
+	const unsigned blocks_x = (width + 3) / 4;
+	const unsigned blocks_y = (height + 3) / 4;
+	const size_t line_size = (size_t)blocks_x * block_size;
+	const size_t size = line_size * blocks_y;
+	if (size > (size_t)UINT_MAX) {
+		throw FI_MSG_ERROR_MEMORY;
 	}
 
-	const int widthRest = (int) width & 3;
-	const int heightRest = (int) height & 3;
-	const int inputLine = (width + 3) / 4;
-	int y = 0;
+	BYTE *input = (BYTE*)malloc(size);
+	if (!input) {
+		throw FI_MSG_ERROR_MEMORY;
+	}
+	unique_mem input_storage(input);
 
-	if (height >= 4) {
-		for (; y < height; y += 4) {
-			io->read_proc (input_buffer, sizeof(typename INFO::Block), inputLine, handle);
-			// TODO: probably need some endian work here
-			const BYTE *pbSrc = (BYTE *)input_buffer;
-			BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
+	// read the top level surface at once
+	if (io->read_proc(input, 1, (unsigned)size, handle) != size) {
+		throw "Truncated DDS surface";
+	}
 
-			if (width >= 4) {
-				for (int x = 0; x < width; x += 4) {
-					DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, 4, 4);
-					pbSrc += INFO::bytesPerBlock;
-					pbDst += 16;	// 4 * 4;
-				}
-			}
-			if (widthRest) {
-				DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, widthRest, 4);
+	FIBITMAP *dib = NULL;
+	if (bpp == 8) {
+		dib = FreeImage_Allocate(width, height, 8);
+		if (dib) {
+			RGBQUAD *pal = FreeImage_GetPalette(dib);
+			for (int i = 0; i < 256; i++) {
+				pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
 			}
 		}
+	} else {
+		dib = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	}
+	if (!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
 	}
-	if (heightRest)	{
-		io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-		// TODO: probably need some endian work here
-		const BYTE *pbSrc = (BYTE *)input_buffer;
-		BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
 
-		if (width >= 4) {
-			for (int x = 0; x < width; x += 4) {
-				DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, 4, heightRest);
-				pbSrc += INFO::bytesPerBlock;
-				pbDst += 16;	// 4 * 4;
+	// decode the rows of blocks concurrently
+	const unsigned pixel_size = bpp / 8;
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, DDS_MIN_THREAD_PIXELS);
+	FreeImage_ParallelFor(0, blocks_y, threads, [&](unsigned first, unsigned last, unsigned) {
+		DWORD pixels[16];	// large enough for any block
+		for (unsigned by = first; by < last; by++) {
+			const BYTE *src = input + by * line_size;
+			const unsigned y0 = by * 4;
+			const unsigned rows = MIN(4U, height - y0);
+			for (unsigned bx = 0; bx < blocks_x; bx++, src += block_size) {
+				decoder(src, (BYTE*)pixels);
+
+				const unsigned x0 = bx * 4;
+				const unsigned row_size = MIN(4U, width - x0) * pixel_size;
+				for (unsigned y = 0; y < rows; y++) {
+					BYTE *dst = FreeImage_GetScanLine(dib, height - 1 - (y0 + y)) + x0 * pixel_size;
+					memcpy(dst, (BYTE*)pixels + y * 4 * pixel_size, row_size);
+				}
 			}
 		}
-		if (widthRest) {
-			DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, widthRest, heightRest);
-		}
-
-	}
+	});
 
-	delete [] input_buffer;
+	return dib;
 }
 
 /**
-@param decoder_type Decoder to be used, either 1 (DXT1), 3 (DXT3) or 5 (DXT5)
-@param desc DDS_HEADER structure
-@param io FreeImage IO
-@param handle FreeImage handle
+Get the block compressed format of a DX10 surface
 */
-static FIBITMAP *
-LoadDXT(int decoder_type, const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
-	// get image size, rounded to 32-bit
-	int width = (int)desc->dwWidth & ~3;
-	int height = (int)desc->dwHeight & ~3;
-
-	// allocate a 32-bit dib
-	FIBITMAP *dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-	if (dib == NULL) {
-		return NULL;
-	}
-
-	// select the right decoder, then decode the image
-	switch (decoder_type) {
-		case 1:
-			LoadDXT_Helper<DXT_BLOCKDECODER_1>(io, handle, dib, width, height);
-			break;
-		case 3:
-			LoadDXT_Helper<DXT_BLOCKDECODER_3>(io, handle, dib, width, height);
-			break;
-		case 5:
-			LoadDXT_Helper<DXT_BLOCKDECODER_5>(io, handle, dib, width, height);
-			break;
+static DDSBlockFormat
+GetDXGIBlockFormat(DWORD dxgiFormat) {
+	switch (dxgiFormat) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			return BLOCK_BC1;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			return BLOCK_BC2;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			return BLOCK_BC3;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+			return BLOCK_BC4U;
+		case DXGI_FORMAT_BC4_SNORM:
+			return BLOCK_BC4S;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+			return BLOCK_BC5U;
+		case DXGI_FORMAT_BC5_SNORM:
+			return BLOCK_BC5S;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return BLOCK_BC7;
 		default:
-			break;
+			return BLOCK_UNKNOWN;
 	}
-	
-	return dib;
 }
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -819,12 +1548,15 @@ Validate(FreeImageIO *io, fi_handle handle) {
 
 static BOOL DLL_CALLCONV
 SupportsExportDepth(int depth) {
-	return FALSE;
+	return (
+		(depth == 24) ||
+		(depth == 32)
+		);
 }
 
 static BOOL DLL_CALLCONV 
 SupportsExportType(FREE_IMAGE_TYPE type) {
-	return FALSE;
+	return (type == FIT_BITMAP) ? TRUE : FALSE;
 }
 
 // ----------------------------------------------------------
@@ -856,34 +1588,156 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	const DDSURFACEDESC2 *surfaceDesc = &(header.surfaceDesc);
 
-	if ((dwFlags & DDPF_RGB) == DDPF_RGB) {
-		// uncompressed data
-		dib = LoadRGB(surfaceDesc, io, handle);
-	}
-	else if ((dwFlags & DDPF_FOURCC) == DDPF_FOURCC) {
-		// compressed data
-		switch (surfaceDesc->ddspf.dwFourCC) {
-			case FOURCC_DXT1:
-				dib = LoadDXT(1, surfaceDesc, io, handle);
-				break;
-			case FOURCC_DXT3:
-				dib = LoadDXT(3, surfaceDesc, io, handle);
-				break;
-			case FOURCC_DXT5:
-				dib = LoadDXT(5, surfaceDesc, io, handle);
+	try {
+		if ((dwFlags & DDPF_RGB) == DDPF_RGB) {
+			// uncompressed data
+			dib = LoadRGB(surfaceDesc, io, handle);
+		}
+		else if ((dwFlags & DDPF_FOURCC) == DDPF_FOURCC) {
+			// compressed data
+			DDSBlockFormat format = BLOCK_UNKNOWN;
+			switch (surfaceDesc->ddspf.dwFourCC) {
+				case FOURCC_DXT1:
+					format = BLOCK_BC1;
+					break;
+				case FOURCC_DXT3:
+					format = BLOCK_BC2;
+					break;
+				case FOURCC_DXT5:
+					format = BLOCK_BC3;
+					break;
+				case FOURCC_ATI1:
+				case FOURCC_BC4U:
+					format = BLOCK_BC4U;
+					break;
+				case FOURCC_BC4S:
+					format = BLOCK_BC4S;
+					break;
+				case FOURCC_ATI2:
+				case FOURCC_BC5U:
+					format = BLOCK_BC5U;
+					break;
+				case FOURCC_BC5S:
+					format = BLOCK_BC5S;
+					break;
+				case FOURCC_DX10:
+				{
+					// the format is given by the extended header
+					DDSHEADER_DXT10 header10;
+					memset(&header10, 0, sizeof(header10));
+					if (io->read_proc(&header10, sizeof(header10), 1, handle) != 1) {
+						throw FI_MSG_ERROR_PARSING;
+					}
+#ifdef FREEIMAGE_BIGENDIAN
+					SwapHeaderDXT10(&header10);
+#endif
+					format = GetDXGIBlockFormat(header10.dxgiFormat);
+				}
 				break;
+			}
+			dib = LoadBC(format, surfaceDesc, io, handle);
 		}
+
+		return dib;
+
+	} catch (const char *message) {
+		FreeImage_OutputMessageProc(s_format_id, message);
 	}
 
-	return dib;
+	return NULL;
 }
 
-/*
 static BOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
+	if (!dib || !handle) {
+		return FALSE;
+	}
+
+	try {
+		const unsigned bpp = FreeImage_GetBPP(dib);
+		if ((FreeImage_GetImageType(dib) != FIT_BITMAP) || ((bpp != 24) && (bpp != 32))) {
+			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+		}
+
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned bytespp = bpp / 8;
+
+		DDSBlockFormat format = (bpp == 32) ? BLOCK_BC3 : BLOCK_BC1;
+		if ((flags & DDS_BC1) == DDS_BC1) {
+			format = BLOCK_BC1;
+		} else if ((flags & DDS_BC3) == DDS_BC3) {
+			format = BLOCK_BC3;
+		}
+		const bool fast = ((flags & DDS_FAST) == DDS_FAST);
+		const bool punch_through = (format == BLOCK_BC1) && (bpp == 32);
+
+		const unsigned block_size = (format == BLOCK_BC1) ? 8 : 16;
+		const unsigned blocks_x = (width + 3) / 4;
+		const unsigned blocks_y = (height + 3) / 4;
+		const size_t line_size = (size_t)blocks_x * block_size;
+		const size_t size = line_size * blocks_y;
+		if (size > (size_t)UINT_MAX) {
+			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+		}
+
+		BYTE *output = (BYTE*)malloc(size);
+		if (!output) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		unique_mem output_storage(output);
+
+		// compress the rows of blocks concurrently
+		const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, DDS_MIN_THREAD_PIXELS);
+		FreeImage_ParallelFor(0, blocks_y, threads, [&](unsigned first, unsigned last, unsigned) {
+			BYTE pixels[16][4];
+			for (unsigned by = first; by < last; by++) {
+				BYTE *dst = output + by * line_size;
+				for (unsigned bx = 0; bx < blocks_x; bx++, dst += block_size) {
+					FetchBlock(dib, width, height, bytespp, bx * 4, by * 4, pixels);
+					if (format == BLOCK_BC3) {
+						EncodeAlphaBlock(pixels, dst);
+						EncodeColorBlock(pixels, false, fast, dst + 8);
+					} else {
+						EncodeColorBlock(pixels, punch_through, fast, dst);
+					}
+				}
+			}
+		});
+
+		// write the header, then the top level surface
+
+		DDSHEADER header;
+		memset(&header, 0, sizeof(header));
+		header.dwMagic = MAKEFOURCC('D', 'D', 'S', ' ');
+		header.surfaceDesc.dwSize = sizeof(header.surfaceDesc);
+		header.surfaceDesc.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+		header.surfaceDesc.dwHeight = height;
+		header.surfaceDesc.dwWidth = width;
+		header.surfaceDesc.dwPitchOrLinearSize = (DWORD)size;
+		header.surfaceDesc.ddspf.dwSize = sizeof(header.surfaceDesc.ddspf);
+		header.surfaceDesc.ddspf.dwFlags = DDPF_FOURCC | (punch_through ? DDPF_ALPHAPIXELS : 0);
+		header.surfaceDesc.ddspf.dwFourCC = (format == BLOCK_BC1) ? FOURCC_DXT1 : FOURCC_DXT5;
+		header.surfaceDesc.ddsCaps.dwCaps1 = DDSCAPS_TEXTURE;
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapHeader(&header);
+#endif
+
+		if (io->write_proc(&header, sizeof(header), 1, handle) != 1) {
+			throw "Failed to write the DDS header";
+		}
+		if (io->write_proc(output, 1, (unsigned)size, handle) != (unsigned)size) {
+			throw "Failed to write the DDS surface";
+		}
+
+		return TRUE;
+
+	} catch (const char *message) {
+		FreeImage_OutputMessageProc(s_format_id, message);
+	}
+
 	return FALSE;
 }
-*/
 
 // ==========================================================
 //   Init
@@ -902,7 +1756,7 @@ InitDDS(Plugin *plugin, int format_id) {
 	plugin->pagecount_proc = NULL;
 	plugin->pagecapability_proc = NULL;
 	plugin->load_proc = Load;
-	plugin->save_proc = NULL;	//Save;	// not implemented (yet?)
+	plugin->save_proc = Save;
 	plugin->validate_proc = Validate;
 	plugin->mime_proc = MimeType;
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
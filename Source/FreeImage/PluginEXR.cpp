@@ -22,6 +22,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 #include <cmath>
 
 #ifdef _MSC_VER
@@ -33,12 +34,20 @@
 #include "../OpenEXR/Iex/Iex.h"
 #include "../OpenEXR/IlmImf/ImfOutputFile.h"
 #include "../OpenEXR/IlmImf/ImfInputFile.h"
+#include "../OpenEXR/IlmImf/ImfTiledInputFile.h"
+#include "../OpenEXR/IlmImf/ImfTiledOutputFile.h"
+#include "../OpenEXR/IlmImf/ImfThreading.h"
 #include "../OpenEXR/IlmImf/ImfRgbaFile.h"
 #include "../OpenEXR/IlmImf/ImfChannelList.h"
 #include "../OpenEXR/IlmImf/ImfRgba.h"
 #include "../OpenEXR/IlmImf/ImfArray.h"
 #include "../OpenEXR/IlmImf/ImfPreviewImage.h"
 #include "../OpenEXR/Half/half.h"
+#include "../OpenEXR/IlmThread/IlmThread.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
 
 
 // ==========================================================
@@ -112,6 +121,97 @@ public:
 
 // ----------------------------------------------------------
 
+/**
+Minimum number of pixels for a thread to be worth starting
+*/
+#define EXR_MIN_THREAD_PIXELS	0x40000
+
+/**
+Default tile size used with EXR_TILED
+*/
+#define EXR_DEFAULT_TILE_SIZE	64
+
+/**
+Get the number of threads to use with a file, and make sure the OpenEXR global thread pool can run them
+@param requested Number of threads asked by the caller, 0 for automatic
+@param pixels Number of pixels of the image
+@return Returns the numThreads argument of the OpenEXR file constructors (0 means the calling thread only)
+*/
+static int
+GetEXRThreadCount(int requested, size_t pixels) {
+	const int threads = (requested > 0) ? requested : (int)FreeImage_GetThreadCount(pixels, EXR_MIN_THREAD_PIXELS);
+	if((threads <= 1) || !IlmThread::supportsThreads()) {
+		return 0;
+	}
+
+	// the pool is shared by all files: it only grows, so that concurrent loads don't shrink it under each other
+	static std::mutex s_pool_mutex;
+	std::lock_guard<std::mutex> lock(s_pool_mutex);
+	if(Imf::globalThreadCount() < threads) {
+		Imf::setGlobalThreadCount(threads);
+	}
+
+	return threads;
+}
+
+/**
+Get the number of scanlines compressed together by a compression method
+*/
+static int
+GetEXRLinesPerBlock(Imf::Compression compression) {
+	switch(compression) {
+		case Imf::ZIP_COMPRESSION:
+		case Imf::PXR24_COMPRESSION:
+			return 16;
+		case Imf::PIZ_COMPRESSION:
+		case Imf::B44_COMPRESSION:
+		case Imf::B44A_COMPRESSION:
+		case Imf::DWAA_COMPRESSION:
+			return 32;
+		case Imf::DWAB_COMPRESSION:
+			return 256;
+		default:
+			return 1;
+	}
+}
+
+/**
+Insert the Y or R, G, B[, A] slices of a top-down buffer of half or float pixels into a frame buffer. 
+Pixel (x, y) of the file is stored at origin + (x - x0) * bytespp + (y - y0) * y_stride
+*/
+static void
+InsertEXRSlices(Imf::FrameBuffer &frameBuffer, Imf::PixelType type, int components, char *origin, int x0, int y0, size_t y_stride) {
+	const size_t bytespc = (type == Imf::HALF) ? sizeof(half) : sizeof(float);
+	const size_t bytespp = bytespc * components;
+
+	// OpenEXR addresses pixels from the data window origin: use signed offsets, 
+	// so that a non-zero origin does not rely on unsigned wrap-around
+	char *base = origin - (ptrdiff_t)x0 * (ptrdiff_t)bytespp - (ptrdiff_t)y0 * (ptrdiff_t)y_stride;
+
+	if(components == 1) {
+		frameBuffer.insert ("Y",	// name
+			Imf::Slice (type,		// type
+			base,					// base
+			bytespp,				// xStride
+			y_stride,				// yStride
+			1, 1,					// x/y sampling
+			0.0));					// fillValue
+	} else if((components == 3) || (components == 4)) {
+		const char *channel_name[4] = { "R", "G", "B", "A" };
+
+		for(int c = 0; c < components; c++) {
+			frameBuffer.insert (
+				channel_name[c],					// name
+				Imf::Slice (type,					// type
+				base + c * bytespc,					// base
+				bytespp,							// xStride
+				y_stride,							// yStride
+				1, 1,								// x/y sampling
+				0.0));								// fillValue
+		}
+	}
+}
+
 
 // ==========================================================
 // Plugin Implementation
@@ -187,6 +287,12 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		}
 		BOOL header_only = (args->flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
+		const FreeImageEXRLoadArgs *exr_args = (const FreeImageEXRLoadArgs*)args->more;
+		if(exr_args && (exr_args->format != s_format_id)) {
+			// arguments meant for another format
+			exr_args = NULL;
+		}
+
 		// save the stream starting point
 		const long stream_start = io->tell_proc(handle);
 
@@ -194,14 +300,12 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		C_IStream istream(io, handle);
 
 		// open the file
-		Imf::InputFile file(istream);
+		Imf::InputFile file(istream, 0);
 
 		// get file info			
 		const Imath::Box2i &dataWindow = file.header().dataWindow();
-		int width  = dataWindow.max.x - dataWindow.min.x + 1;
-		int height = dataWindow.max.y - dataWindow.min.y + 1;
 
-		//const Imf::Compression &compression = file.header().compression();
+		const Imf::Compression &compression = file.header().compression();
 
 		const Imf::ChannelList &channels = file.header().channels();
 
@@ -307,6 +411,54 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 			THROW (Iex::InputExc, "Unsupported color model: " << exr_color_model);
 		}
 
+		// number of threads, for the whole data window
+		const int threads = GetEXRThreadCount(exr_args ? exr_args->threads : 0, 
+			(size_t)(dataWindow.max.x - dataWindow.min.x + 1) * (dataWindow.max.y - dataWindow.min.y + 1));
+
+		// select the level and the region to load
+		// --------------------------------------------------------------
+
+		int level_x = 0;
+		int level_y = 0;
+		std::unique_ptr<Imf::TiledInputFile> tiled_file;
+
+		Imath::Box2i source = dataWindow;	// pixels of the selected level
+
+		if(exr_args && (exr_args->level_x || exr_args->level_y)) {
+			if(!file.header().hasTileDescription()) {
+				THROW (Iex::ArgExc, "Levels can only be loaded from tiled files");
+			}
+			if(bUseRgbaInterface) {
+				THROW (Iex::ArgExc, "Levels cannot be loaded from luminance/chroma images");
+			}
+
+			// re-open using the tiled interface
+			io->seek_proc(handle, stream_start, SEEK_SET);
+			tiled_file.reset(new Imf::TiledInputFile(istream, threads));
+
+			level_x = exr_args->level_x;
+			level_y = (tiled_file->levelMode() == Imf::MIPMAP_LEVELS) ? level_x : exr_args->level_y;
+			if(!tiled_file->isValidLevel(level_x, level_y)) {
+				THROW (Iex::ArgExc, "Invalid level (" << level_x << ", " << level_y << ")");
+			}
+			source = tiled_file->dataWindowForLevel(level_x, level_y);
+		}
+
+		Imath::Box2i region = source;	// pixels to load
+
+		if(exr_args && (exr_args->width > 0) && (exr_args->height > 0)) {
+			region.min.x = MAX(source.min.x, exr_args->left);
+			region.min.y = MAX(source.min.y, exr_args->top);
+			region.max.x = MIN(source.max.x, exr_args->left + exr_args->width - 1);
+			region.max.y = MIN(source.max.y, exr_args->top + exr_args->height - 1);
+			if((region.min.x > region.max.x) || (region.min.y > region.max.y)) {
+				THROW (Iex::ArgExc, "The requested region is outside of the data window");
+			}
+		}
+
+		const int width  = region.max.x - region.min.x + 1;
+		const int height = region.max.y - region.min.y + 1;
+
 		// allocate a new dib
 		FIBITMAP* dib = FreeImage_AllocateHeaderT(header_only, image_type, width, height, 0);
 		if(!dib) THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
@@ -359,108 +511,124 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		// load pixels
 		// --------------------------------------------------------------
 
-		const BYTE *bits = FreeImage_GetBits(dib);			// pointer to our pixel buffer
 		const size_t bytespp = sizeof(float) * components;	// size of our pixel in bytes
 		const unsigned pitch = FreeImage_GetPitch(dib);		// size of our yStride in bytes
+		const size_t line = bytespp * width;				// size of a region line in bytes
+
+		// the file is top-down while the dib is bottom-up: line y of the region goes to top_line + y * dib_stride
+		char *top_line = (char*)FreeImage_GetScanLine(dib, height - 1);
+		const ptrdiff_t dib_stride = -(ptrdiff_t)pitch;
 
-		Imf::PixelType pixelType = Imf::FLOAT;	// load as float data type;
+		// number of lines read at once, enough to keep all threads busy
+		const int lines_per_block = file.header().hasTileDescription() ? (int)file.header().tileDescription().ySize : GetEXRLinesPerBlock(compression);
+		const int band_size = MAX(16, lines_per_block * MAX(threads, 1));
 		
 		if(bUseRgbaInterface) {
 			// use the RGBA interface (used when loading RY BY Y images )
-			/// @todo allow user-provided chunk size
-			const int chunk_size = 16;
-
-			BYTE *scanline = (BYTE*)bits;
 
 			// re-open using the RGBA interface
 			io->seek_proc(handle, stream_start, SEEK_SET);
-			Imf::RgbaInputFile rgbaFile(istream);
+			Imf::RgbaInputFile rgbaFile(istream, threads);
+
+			// read the file in bands of whole data window lines
+			const int source_width = source.max.x - source.min.x + 1;
+			Imf::Array2D<Imf::Rgba> band(band_size, source_width);
+
+			FIProgress::Step step = progress.getStepProgress(fi_progress_t((height + band_size - 1) / band_size), .99);
 
-			// read the file in chunks
-			Imath::Box2i dw = dataWindow;
-			Imf::Array2D<Imf::Rgba> chunk(chunk_size, width);
+			for(int y = region.min.y; y <= region.max.y; y += band_size) {
+				const int rows = MIN(band_size, region.max.y - y + 1);
 
-			FIProgress::Step step = progress.getStepProgress(fi_progress_t(std::ceil(float(dw.max.y - dw.min.y) / chunk_size)), .99);
+				// read a band
+				rgbaFile.setFrameBuffer (&band[0][0] - source.min.x - y * source_width, 1, source_width);
+				rgbaFile.readPixels (y, y + rows - 1);
 
-			while (dw.min.y <= dw.max.y) {
-				// read a chunk
-				rgbaFile.setFrameBuffer (&chunk[0][0] - dw.min.x - dw.min.y * width, 1, width);
-				rgbaFile.readPixels (dw.min.y, MIN(dw.min.y + chunk_size - 1, dw.max.y));
 				// fill the dib
-				const int y_max = ((dw.max.y - dw.min.y) <= chunk_size) ? (dw.max.y - dw.min.y) : chunk_size;
-				for(int y = 0; y < y_max; y++) {
-					FIRGBF *pixel = (FIRGBF*)scanline;
-					const Imf::Rgba *half_rgba = chunk[y];
+				for(int row = 0; row < rows; row++) {
+					FIRGBF *pixel = (FIRGBF*)(top_line + (ptrdiff_t)(y + row - region.min.y) * dib_stride);
+					const Imf::Rgba *half_rgba = band[row] + (region.min.x - source.min.x);
 					for(int x = 0; x < width; x++) {
 						// convert from half to float
 						pixel[x].red = half_rgba[x].r;
 						pixel[x].green = half_rgba[x].g;
 						pixel[x].blue = half_rgba[x].b;
 					}
-					// next line
-					scanline += pitch;
+				}
 
-					if(! step.progress()) {
-						return NULL;
-					}
+				if(! step.progress()) {
+					return NULL;
 				}
-				// next chunk
-				dw.min.y += chunk_size;
 			}
 
 		} else {
 			// use the low level interface
 
-			// build a frame buffer (i.e. what we want on output)
-			Imf::FrameBuffer frameBuffer;
+			Imf::InputFile *pixel_file = &file;
+			std::unique_ptr<Imf::InputFile> threaded_file;
+			if(threads && !tiled_file) {
+				// re-open with decoding threads
+				io->seek_proc(handle, stream_start, SEEK_SET);
+				threaded_file.reset(new Imf::InputFile(istream, threads));
+				pixel_file = threaded_file.get();
+			}
 
-			// allow dataWindow with minimal bounds different form zero
-			size_t offset = - dataWindow.min.x * bytespp - dataWindow.min.y * pitch;
+			// pixels are read through a top-down band buffer (OpenEXR only handles positive strides 
+			// and always fills whole lines or tiles), then the region part of each line goes to the dib
 
-			if(components == 1) {
-				frameBuffer.insert ("Y",	// name
-					Imf::Slice (pixelType,	// type
-					(char*)(bits + offset), // base
-					bytespp,				// xStride
-					pitch,					// yStride
-					1, 1,					// x/y sampling
-					0.0));					// fillValue
-			} else if((components == 3) || (components == 4)) {
-				const char *channel_name[4] = { "R", "G", "B", "A" };
+			const int source_width = source.max.x - source.min.x + 1;
+			const size_t band_pitch = bytespp * source_width;
 
-				for(int c = 0; c < components; c++) {
-					frameBuffer.insert (
-						channel_name[c],					// name
-						Imf::Slice (pixelType,				// type
-						(char*)(bits + c * sizeof(float) + offset), // base
-						bytespp,							// xStride
-						pitch,								// yStride
-						1, 1,								// x/y sampling
-						0.0));								// fillValue
-				}
+			const int band_lines = tiled_file ? (int)tiled_file->tileYSize() : band_size;
+
+			std::vector<float> band((size_t)band_lines * source_width * components);
+
+			// first and last tile rows / columns of the region
+			int tx1 = 0, tx2 = 0, ty1 = 0, ty2 = 0;
+			if(tiled_file) {
+				const int tile_width = (int)tiled_file->tileXSize();
+				tx1 = (region.min.x - source.min.x) / tile_width;
+				tx2 = (region.max.x - source.min.x) / tile_width;
+				ty1 = (region.min.y - source.min.y) / band_lines;
+				ty2 = (region.max.y - source.min.y) / band_lines;
 			}
 
-			// read the file
-			file.setFrameBuffer(frameBuffer);
+			const int first = tiled_file ? ty1 : region.min.y;
+			const int last = tiled_file ? ty2 : region.max.y;
+			const int step_size = tiled_file ? 1 : band_lines;
 
-			if(! progress.callback()) {
-				file.readPixels(dataWindow.min.y, dataWindow.max.y);
-			} else {
-				/// @todo allow user-provided chunk size
-				const int chunk_size = 16;
-				Imath::Box2i dw = dataWindow;
+			FIProgress::Step step = progress.getStepProgress(fi_progress_t((last - first) / step_size + 1), .99);
 
-				FIProgress::Step step = progress.getStepProgress(fi_progress_t(std::ceil(float(dw.max.y - dw.min.y) / chunk_size)), .99);
+			for(int b = first; b <= last; b += step_size) {
+				// lines of the band, in data window coordinates
+				const int y1 = tiled_file ? (source.min.y + b * band_lines) : b;
+				const int y2 = MIN(y1 + band_lines - 1, tiled_file ? source.max.y : region.max.y);
 
-				while (dw.min.y <= dw.max.y) {
-					file.readPixels(dw.min.y, MIN(dw.min.y + chunk_size - 1, dw.max.y));
+				// build a frame buffer (i.e. what we want on output)
+				Imf::FrameBuffer bandBuffer;
+				InsertEXRSlices(bandBuffer, Imf::FLOAT, components, (char*)&band[0], source.min.x, y1, band_pitch);
+				if(tiled_file) {
+					tiled_file->setFrameBuffer(bandBuffer);
+				} else {
+					pixel_file->setFrameBuffer(bandBuffer);
+				}
 
-					if(! step.progress()) {
-						return NULL;
-					} 
+				// read the band
+				if(tiled_file) {
+					tiled_file->readTiles(tx1, tx2, b, b, level_x, level_y);
+				} else {
+					pixel_file->readPixels(y1, y2);
+				}
+
+				// copy the region part of the band
+				const int row_min = MAX(y1, region.min.y);
+				const int row_max = MIN(y2, region.max.y);
+				for(int y = row_min; y <= row_max; y++) {
+					const char *src_bits = (const char*)&band[0] + (y - y1) * band_pitch + (region.min.x - source.min.x) * bytespp;
+					memcpy(top_line + (ptrdiff_t)(y - region.min.y) * dib_stride, src_bits, line);
+				}
 
-					// next chunk
-					dw.min.y += chunk_size;
+				if(! step.progress()) {
+					return NULL;
 				}
 			}
 		}
@@ -469,9 +637,6 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 			return NULL;
 		}
 
-		// lastly, flip dib lines
-		FreeImage_FlipVertical(dib);
-
 		return dib_storage.release();
 	}
 	catch(Iex::BaseExc & e) {
@@ -534,7 +699,7 @@ SetPreviewImage(FIBITMAP *dib, Imf::Header& header) {
 Save using EXR_LC compression (works only with RGB[A]F images)
 */
 static BOOL 
-SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width, int height) {
+SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width, int height, int threads) {
 	int x, y;
 	Imf::RgbaChannels rgbaChannels;
 
@@ -576,7 +741,7 @@ SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width,
 		}
 
 		// write the data
-		Imf::RgbaOutputFile file(ostream, header, rgbaChannels);
+		Imf::RgbaOutputFile file(ostream, header, rgbaChannels, threads);
 		file.setFrameBuffer (&pixels[0][0], 1, width);
 		file.writePixels (height);
 
@@ -593,8 +758,7 @@ SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width,
 static BOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	const char *channel_name[4] = { "R", "G", "B", "A" };
-	BOOL bIsFlipped = FALSE;
-	half *halfData = NULL;
+	char *bandData = NULL;
 
 	if(!dib || !handle) return FALSE;
 
@@ -649,10 +813,20 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 		// handle thumbnail
 		SetPreviewImage(dib, header);
+
+		// compression threads
+		const int threads = GetEXRThreadCount(0, (size_t)width * height);
 		
 		// check for EXR_LC compression
 		if((flags & EXR_LC) == EXR_LC) {
-			return SaveAsEXR_LC(ostream, dib, header, width, height);
+			return SaveAsEXR_LC(ostream, dib, header, width, height, threads);
+		}
+
+		// check for tiled output
+		const BOOL bTiled = ((flags & EXR_TILED) == EXR_TILED);
+		if(bTiled) {
+			const int tile_size = ((flags >> 16) & 0x7FFF) ? ((flags >> 16) & 0x7FFF) : EXR_DEFAULT_TILE_SIZE;
+			header.setTileDescription(Imf::TileDescription(tile_size, tile_size, Imf::ONE_LEVEL));
 		}
 
 		// output pixel type
@@ -691,87 +865,71 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				THROW (Iex::ArgExc, "Cannot save: invalid data type.\nConvert the image to float before saving as OpenEXR.");
 		}
 
-		// build a frame buffer (i.e. what we have on input)
-		Imf::FrameBuffer frameBuffer;
+		// the dib is bottom-up while the file is top-down: lines are converted to half (or copied) 
+		// band by band into a top-down buffer, so that OpenEXR only sees positive strides
 
-		BYTE *bits = NULL;	// pointer to our pixel buffer
-		size_t bytespp = 0;	// size of our pixel in bytes
-		size_t bytespc = 0;	// size of our pixel component in bytes
-		unsigned pitch = 0;	// size of our yStride in bytes
+		const size_t bytespc = (pixelType == Imf::HALF) ? sizeof(half) : sizeof(float);
+		const size_t stride = bytespc * components * width;	// size of our yStride in bytes
 
+		std::unique_ptr<Imf::TiledOutputFile> tiled_file;
+		std::unique_ptr<Imf::OutputFile> scanline_file;
+		int band_lines = 0;
+		if(bTiled) {
+			tiled_file.reset(new Imf::TiledOutputFile (ostream, header, threads));
+			band_lines = (int)tiled_file->tileYSize();
+		} else {
+			scanline_file.reset(new Imf::OutputFile (ostream, header, threads));
+			// enough lines to keep all threads busy
+			band_lines = MAX(16, GetEXRLinesPerBlock(compress) * MAX(threads, 1));
+		}
+		band_lines = MIN(band_lines, height);
 
-		if(pixelType == Imf::HALF) {
-			// convert from float to half
-			halfData = new(std::nothrow) half[width * height * components];
-			if(!halfData) {
-				THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
-			}
+		bandData = new(std::nothrow) char[band_lines * stride];
+		if(!bandData) {
+			THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
+		}
 
-			for(int y = 0; y < height; y++) {
-				float *src_bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
-				half *dst_bits = halfData + y * width * components;
-				for(int x = 0; x < width; x++) {
-					for(int c = 0; c < components; c++) {
-						dst_bits[c] = src_bits[c];
+		for(int y1 = 0; y1 < height; y1 += band_lines) {
+			const int rows = MIN(band_lines, height - y1);
+
+			const unsigned convert_threads = (pixelType == Imf::HALF) ? FreeImage_GetThreadCount((size_t)width * rows, EXR_MIN_THREAD_PIXELS) : 1;
+			FreeImage_ParallelFor(0, rows, convert_threads, [&](unsigned first, unsigned last, unsigned) {
+				for(unsigned row = first; row < last; row++) {
+					const float *src_bits = (float*)FreeImage_GetScanLine(dib, height - 1 - (y1 + row));
+					char *dst_bits = bandData + row * stride;
+					if(pixelType == Imf::HALF) {
+						half *dst_half = (half*)dst_bits;
+						for(int x = 0; x < width * components; x++) {
+							dst_half[x] = src_bits[x];
+						}
+					} else {
+						memcpy(dst_bits, src_bits, stride);
 					}
-					src_bits += components;
-					dst_bits += components;
 				}
-			}
-			bits = (BYTE*)halfData;
-			bytespc = sizeof(half);
-			bytespp = sizeof(half) * components;
-			pitch = sizeof(half) * width * components;
-		} else if(pixelType == Imf::FLOAT) {
-			// invert dib scanlines
-			bIsFlipped = FreeImage_FlipVertical(dib);
-		
-			bits = FreeImage_GetBits(dib);
-			bytespc = sizeof(float);
-			bytespp = sizeof(float) * components;
-			pitch = FreeImage_GetPitch(dib);
-		}
+			});
 
-		if(image_type == FIT_FLOAT) {
-			frameBuffer.insert ("Y",	// name
-				Imf::Slice (pixelType,	// type
-				(char*)(bits),			// base
-				bytespp,				// xStride
-				pitch));				// yStride
-		} else if((image_type == FIT_RGBF) || (image_type == FIT_RGBAF)) {			
-			for(int c = 0; c < components; c++) {
-				char *channel_base = (char*)(bits) + c*bytespc;
-				frameBuffer.insert (channel_name[c],// name
-					Imf::Slice (pixelType,			// type
-					channel_base,					// base
-					bytespp,	// xStride
-					pitch));	// yStride
+			// build a frame buffer (i.e. what we have on input)
+			Imf::FrameBuffer frameBuffer;
+			InsertEXRSlices(frameBuffer, pixelType, components, bandData, 0, y1, stride);
+
+			// write the data
+			if(bTiled) {
+				const int tile_row = y1 / band_lines;
+				tiled_file->setFrameBuffer (frameBuffer);
+				tiled_file->writeTiles (0, tiled_file->numXTiles() - 1, tile_row, tile_row);
+			} else {
+				scanline_file->setFrameBuffer (frameBuffer);
+				scanline_file->writePixels (rows);
 			}
 		}
 
-		// write the data
-		Imf::OutputFile file (ostream, header);
-		file.setFrameBuffer (frameBuffer);
-		file.writePixels (height);
-
-		if(halfData != NULL) {
-			delete[] halfData;
-		}
-		if(bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
-		}
+		delete[] bandData;
+		bandData = NULL;
 
 		return TRUE;
 
 	} catch(Iex::BaseExc & e) {
-		if(halfData != NULL) {
-			delete[] halfData;
-		}
-		if(bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
-		}
+		delete[] bandData;
 
 		FreeImage_OutputMessageProc(s_format_id, e.what());
 
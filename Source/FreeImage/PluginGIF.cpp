@@ -140,46 +140,6 @@ protected:
 static int g_GifInterlaceOffset[GIF_INTERLACE_PASSES] = {0, 4, 2, 1};
 static int g_GifInterlaceIncrement[GIF_INTERLACE_PASSES] = {8, 8, 4, 2};
 
-// ==========================================================
-// Helpers Functions
-// ==========================================================
-
-static BOOL 
-FreeImage_SetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, WORD id, FREE_IMAGE_MDTYPE type, DWORD count, DWORD length, const void *value)
-{
-	BOOL bResult = FALSE;
-	FITAG *tag = FreeImage_CreateTag();
-	if(tag) {
-		FreeImage_SetTagKey(tag, key);
-		FreeImage_SetTagID(tag, id);
-		FreeImage_SetTagType(tag, type);
-		FreeImage_SetTagCount(tag, count);
-		FreeImage_SetTagLength(tag, length);
-		FreeImage_SetTagValue(tag, value);
-		if(model == FIMD_ANIMATION) {
-			TagLib& s = TagLib::instance();
-			// get the tag description
-			const char *description = s.getTagDescription(TagLib::ANIMATION, id);
-			FreeImage_SetTagDescription(tag, description);
-		}
-		// store the tag
-		bResult = FreeImage_SetMetadata(model, dib, key, tag);
-		FreeImage_DeleteTag(tag);
-	}
-	return bResult;
-}
-
-static BOOL 
-FreeImage_GetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag)
-{
-	if( FreeImage_GetMetadata(model, dib, key, tag) ) {
-		if( FreeImage_GetTagType(*tag) == type ) {
-			return TRUE;
-		}
-	}
-	return FALSE;
-}
-
 StringTable::StringTable()
 {
 	m_buffer = NULL;
@@ -629,6 +589,28 @@ Open(FreeImageIO *io, fi_handle handle, BOOL read) {
 	return info;
 }
 
+/**
+Open an existing GIF for appending new frames.<br>
+The file is scanned like for reading, then the handle is positioned on the trailer 
+so that frames written with Save (page > 0) overwrite it. Close writes a new trailer. 
+The handle must be readable and writable.
+*/
+static void *DLL_CALLCONV 
+Append(FreeImageIO *io, fi_handle handle) {
+	GIFinfo *info = (GIFinfo *)Open(io, handle, TRUE);
+	if( info == NULL ) {
+		return NULL;
+	}
+
+	// the block scan stops right after the trailer
+	io->seek_proc(handle, -1, SEEK_CUR);
+
+	// switch to Write mode
+	info->read = FALSE;
+
+	return info;
+}
+
 static void DLL_CALLCONV 
 Close(FreeImageIO *io, fi_handle handle, void *data) {
 	if( data == NULL ) {
@@ -821,7 +803,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					//copy frame time
 					if( page == end ) {
 						FITAG *tag;
-						if( FreeImage_GetMetadataEx(FIMD_ANIMATION, pagedib, "FrameTime", FIDT_LONG, &tag) ) {
+						if( GetMetadataTag(FIMD_ANIMATION, pagedib, "FrameTime", FIDT_LONG, &tag) ) {
 							delay_time = *(LONG *)FreeImage_GetTagValue(tag);
 						}
 					}
@@ -830,7 +812,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 
 			//setup frame time
-			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
+			SetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
 			return dib;
 		}
 
@@ -868,12 +850,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
 
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameLeft", ANIMTAG_FRAMELEFT, FIDT_SHORT, 1, 2, &left);
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameTop", ANIMTAG_FRAMETOP, FIDT_SHORT, 1, 2, &top);
+		SetMetadataTag(FIMD_ANIMATION, dib, "FrameLeft", ANIMTAG_FRAMELEFT, FIDT_SHORT, 1, 2, &left);
+		SetMetadataTag(FIMD_ANIMATION, dib, "FrameTop", ANIMTAG_FRAMETOP, FIDT_SHORT, 1, 2, &top);
 		b = no_local_palette ? 1 : 0;
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "NoLocalPalette", ANIMTAG_NOLOCALPALETTE, FIDT_BYTE, 1, 1, &b);
+		SetMetadataTag(FIMD_ANIMATION, dib, "NoLocalPalette", ANIMTAG_NOLOCALPALETTE, FIDT_BYTE, 1, 1, &b);
 		b = interlaced ? 1 : 0;
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "Interlaced", ANIMTAG_INTERLACED, FIDT_BYTE, 1, 1, &b);
+		SetMetadataTag(FIMD_ANIMATION, dib, "Interlaced", ANIMTAG_INTERLACED, FIDT_BYTE, 1, 1, &b);
 
 		//Palette
 		RGBQUAD *pal = FreeImage_GetPalette(dib);
@@ -966,8 +948,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			SwapShort(&logicalwidth);
 			SwapShort(&logicalheight);
 #endif
-			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "LogicalWidth", ANIMTAG_LOGICALWIDTH, FIDT_SHORT, 1, 2, &logicalwidth);
-			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "LogicalHeight", ANIMTAG_LOGICALHEIGHT, FIDT_SHORT, 1, 2, &logicalheight);
+			SetMetadataTag(FIMD_ANIMATION, dib, "LogicalWidth", ANIMTAG_LOGICALWIDTH, FIDT_SHORT, 1, 2, &logicalwidth);
+			SetMetadataTag(FIMD_ANIMATION, dib, "LogicalHeight", ANIMTAG_LOGICALHEIGHT, FIDT_SHORT, 1, 2, &logicalheight);
 
 			//Global Color Table
 			if( info->global_color_table_offset != 0 ) {
@@ -981,7 +963,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					globalpalette[i].rgbReserved = 0;
 					i++;
 				}
-				FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "GlobalPalette", ANIMTAG_GLOBALPALETTE, FIDT_PALETTE, info->global_color_table_size, info->global_color_table_size * 4, globalpalette);
+				SetMetadataTag(FIMD_ANIMATION, dib, "GlobalPalette", ANIMTAG_GLOBALPALETTE, FIDT_PALETTE, info->global_color_table_size, info->global_color_table_size * 4, globalpalette);
 				//background color
 				if( info->background_color < info->global_color_table_size ) {
 					FreeImage_SetBackgroundColor(dib, &globalpalette[info->background_color]);
@@ -1011,7 +993,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 				}
 			}
-			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "Loop", ANIMTAG_LOOP, FIDT_LONG, 1, 4, &loop);
+			SetMetadataTag(FIMD_ANIMATION, dib, "Loop", ANIMTAG_LOOP, FIDT_LONG, 1, 4, &loop);
 
 			//Comment Extension
 			for( idx = 0; idx < info->comment_extension_offsets.size(); idx++ ) {
@@ -1027,7 +1009,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				comment.append(1, '\0');
 				sprintf(buf, "Comment%zd", idx);
 				DWORD comment_size = (DWORD)comment.size();
-				FreeImage_SetMetadataEx(FIMD_COMMENTS, dib, buf, 1, FIDT_ASCII, comment_size, comment_size, comment.c_str());
+				SetMetadataTag(FIMD_COMMENTS, dib, buf, 1, FIDT_ASCII, comment_size, comment_size, comment.c_str());
 			}
 		}
 
@@ -1054,9 +1036,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				}
 			}
 		}
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
+		SetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
 		b = (BYTE)disposal_method;
-		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "DisposalMethod", ANIMTAG_DISPOSALMETHOD, FIDT_BYTE, 1, 1, &b);
+		SetMetadataTag(FIMD_ANIMATION, dib, "DisposalMethod", ANIMTAG_DISPOSALMETHOD, FIDT_BYTE, 1, 1, &b);
 
 		delete stringtable;
 
@@ -1096,22 +1078,22 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		int disposal_method = GIF_DISPOSAL_BACKGROUND, delay_time = 100, transparent_color = 0;
 		WORD left = 0, top = 0, width = (WORD)FreeImage_GetWidth(dib), height = (WORD)FreeImage_GetHeight(dib);
 		WORD output_height = height;
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "FrameLeft", FIDT_SHORT, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "FrameLeft", FIDT_SHORT, &tag) ) {
 			left = *(WORD *)FreeImage_GetTagValue(tag);
 		}
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "FrameTop", FIDT_SHORT, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "FrameTop", FIDT_SHORT, &tag) ) {
 			top = *(WORD *)FreeImage_GetTagValue(tag);
 		}
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "NoLocalPalette", FIDT_BYTE, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "NoLocalPalette", FIDT_BYTE, &tag) ) {
 			no_local_palette = *(BYTE *)FreeImage_GetTagValue(tag) ? true : false;
 		}
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "Interlaced", FIDT_BYTE, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "Interlaced", FIDT_BYTE, &tag) ) {
 			interlaced = *(BYTE *)FreeImage_GetTagValue(tag) ? true : false;
 		}
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "FrameTime", FIDT_LONG, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", FIDT_LONG, &tag) ) {
 			delay_time = *(LONG *)FreeImage_GetTagValue(tag);
 		}
-		if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "DisposalMethod", FIDT_BYTE, &tag) ) {
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "DisposalMethod", FIDT_BYTE, &tag) ) {
 			disposal_method = *(BYTE *)FreeImage_GetTagValue(tag);
 		}
 
@@ -1126,14 +1108,14 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		if( page == 0 ) {
 			//gather some info
 			WORD logicalwidth = width; // width has already been swapped...
-			if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "LogicalWidth", FIDT_SHORT, &tag) ) {
+			if( GetMetadataTag(FIMD_ANIMATION, dib, "LogicalWidth", FIDT_SHORT, &tag) ) {
 				logicalwidth = *(WORD *)FreeImage_GetTagValue(tag);
 #ifdef FREEIMAGE_BIGENDIAN
 				SwapShort(&logicalwidth);
 #endif
 			}
 			WORD logicalheight = height; // height has already been swapped...
-			if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "LogicalHeight", FIDT_SHORT, &tag) ) {
+			if( GetMetadataTag(FIMD_ANIMATION, dib, "LogicalHeight", FIDT_SHORT, &tag) ) {
 				logicalheight = *(WORD *)FreeImage_GetTagValue(tag);
 #ifdef FREEIMAGE_BIGENDIAN
 				SwapShort(&logicalheight);
@@ -1141,7 +1123,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			}
 			RGBQUAD *globalpalette = NULL;
 			int globalpalette_size = 0;
-			if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "GlobalPalette", FIDT_PALETTE, &tag) ) {
+			if( GetMetadataTag(FIMD_ANIMATION, dib, "GlobalPalette", FIDT_PALETTE, &tag) ) {
 				globalpalette_size = FreeImage_GetTagCount(tag);
 				if( globalpalette_size >= 2 ) {
 					globalpalette = (RGBQUAD *)FreeImage_GetTagValue(tag);
@@ -1213,7 +1195,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			//Application Extension
 			LONG loop = 0;
-			if( FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "Loop", FIDT_LONG, &tag) ) {
+			if( GetMetadataTag(FIMD_ANIMATION, dib, "Loop", FIDT_LONG, &tag) ) {
 				loop = *(LONG *)FreeImage_GetTagValue(tag);
 			}
 			if( loop != 1 ) {
@@ -1402,4 +1384,5 @@ InitGIF(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = NULL;
+	plugin->append_proc = Append;
 }
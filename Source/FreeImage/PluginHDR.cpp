@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 // ==========================================================
 // Plugin Interface
@@ -48,6 +49,14 @@ static int s_format_id;
 #define RGBE_DATA_GREEN  1
 #define RGBE_DATA_BLUE   2
 
+// size of the buffer used to read the pixel data
+#define HDR_READ_BUFFER_SIZE	65536
+
+// number of scanlines encoded by a thread in a single pass
+#define HDR_BAND_LINES			32
+// minimum number of pixels worth a thread
+#define HDR_MIN_THREAD_PIXELS	(128 * 128)
+
 // ----------------------------------------------------------
 #ifdef _WIN32
 #pragma pack(push, 1)
@@ -120,12 +129,27 @@ rgbe_GetLine(FreeImageIO *io, fi_handle handle, char *buffer, int length) {
 	return (i < length) ? TRUE : FALSE;
 }
 
+/**
+Get the scale factor of a RGBE exponent, 2^(e - 136).
+Exponents >= 10 build the float directly, smaller ones would give denormals.
+*/
+static inline float
+rgbe_ExponentScale(BYTE e) {
+	if (e >= 10) {
+		union { DWORD i; float f; } scale;
+		scale.i = (DWORD)(e - 9) << 23;
+		return scale.f;
+	}
+	return e ? (float)ldexp(1.0, (int)e - (int)(128+8)) : 0;
+}
+
 /**
 Standard conversion from float pixels to rgbe pixels. 
-Note: you can remove the "inline"s if your compiler complains about it 
+The frexp call is replaced by a read of the float exponent: 
+for v = m * 2^e with m in [0.5, 1), the mantissas are scaled by 2^(8 - e).
 */
 static inline void 
-rgbe_FloatToRGBE(BYTE rgbe[4], FIRGBF *rgbf) {
+rgbe_FloatToRGBE(BYTE rgbe[4], const FIRGBF *rgbf) {
 	float v = rgbf->red;
 	if (rgbf->green > v) {
 		v = rgbf->green;
@@ -133,16 +157,18 @@ rgbe_FloatToRGBE(BYTE rgbe[4], FIRGBF *rgbf) {
 	if (rgbf->blue > v) {
 		v = rgbf->blue;
 	}
-	if (v < 1e-32) {
+	if (!(v >= 1e-32F)) {
 		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
 	}
 	else {
-		int e;
-		v = (float)(frexp(v, &e) * 256.0 / v);
-		rgbe[0] = (BYTE) (rgbf->red * v);
-		rgbe[1] = (BYTE) (rgbf->green * v);
-		rgbe[2] = (BYTE) (rgbf->blue * v);
-		rgbe[3] = (BYTE) (e + 128);
+		union { float f; DWORD i; } value, scale;
+		value.f = v;
+		const int exponent = (int)((value.i >> 23) & 0xFF);	// e + 126
+		scale.i = (DWORD)(261 - exponent) << 23;			// 2^(8 - e)
+		rgbe[0] = (BYTE) (MAX(rgbf->red, 0.0F) * scale.f);
+		rgbe[1] = (BYTE) (MAX(rgbf->green, 0.0F) * scale.f);
+		rgbe[2] = (BYTE) (MAX(rgbf->blue, 0.0F) * scale.f);
+		rgbe[3] = (BYTE) (exponent + 2);
 	}
 }
 
@@ -152,15 +178,123 @@ Note: Ward uses ldexp(col+0.5,exp-(128+8)).
 However we wanted pixels in the range [0,1] to map back into the range [0,1].
 */
 static inline void 
-rgbe_RGBEToFloat(FIRGBF *rgbf, BYTE rgbe[4]) {
-	if (rgbe[3]) {   // nonzero pixel
-		const float f = (float)(ldexp(1.0, rgbe[3] - (int)(128+8)));
-		rgbf->red   = rgbe[0] * f;
-		rgbf->green = rgbe[1] * f;
-		rgbf->blue  = rgbe[2] * f;
+rgbe_RGBEToFloat(FIRGBF *rgbf, const BYTE rgbe[4]) {
+	const float f = rgbe_ExponentScale(rgbe[3]);
+	rgbf->red   = rgbe[0] * f;
+	rgbf->green = rgbe[1] * f;
+	rgbf->blue  = rgbe[2] * f;
+}
+
+/**
+Convert a planar RGBE scanline (as stored by the RLE scheme) to float pixels
+*/
+static void
+rgbe_PlanarToFloat(const BYTE *r, const BYTE *g, const BYTE *b, const BYTE *e, FIRGBF *data, unsigned count) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i min_exponent = _mm_set1_epi32(10);
+	const __m128i bias = _mm_set1_epi32(9);
+
+	for (; x + 4 <= count; x += 4) {
+		int e4;
+		memcpy(&e4, e + x, 4);
+		const __m128i exponent = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(e4), zero), zero);
+		if (_mm_movemask_epi8(_mm_cmplt_epi32(exponent, min_exponent))) {
+			// zero or denormal pixels
+			for (unsigned k = x; k < x + 4; k++) {
+				const BYTE rgbe[4] = { r[k], g[k], b[k], e[k] };
+				rgbe_RGBEToFloat(&data[k], rgbe);
+			}
+			continue;
+		}
+		const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(exponent, bias), 23));
+
+		int r4, g4, b4;
+		memcpy(&r4, r + x, 4);
+		memcpy(&g4, g + x, 4);
+		memcpy(&b4, b + x, 4);
+		const __m128 red = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(r4), zero), zero)), scale);
+		const __m128 green = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(g4), zero), zero)), scale);
+		const __m128 blue = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(b4), zero), zero)), scale);
+
+		// interleave to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+		const __m128 rg01 = _mm_unpacklo_ps(red, green);
+		const __m128 rg23 = _mm_unpackhi_ps(red, green);
+		const __m128 b0r1 = _mm_shuffle_ps(blue, red, _MM_SHUFFLE(1, 1, 0, 0));
+		const __m128 g1b1 = _mm_shuffle_ps(green, blue, _MM_SHUFFLE(1, 1, 1, 1));
+		const __m128 b2r3 = _mm_shuffle_ps(blue, red, _MM_SHUFFLE(3, 3, 2, 2));
+		const __m128 g3b3 = _mm_shuffle_ps(green, blue, _MM_SHUFFLE(3, 3, 3, 3));
+		float *dst = (float*)&data[x];
+		_mm_storeu_ps(dst, _mm_shuffle_ps(rg01, b0r1, _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(g1b1, rg23, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(b2r3, g3b3, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif // FREEIMAGE_SSE2
+	for (; x < count; x++) {
+		const BYTE rgbe[4] = { r[x], g[x], b[x], e[x] };
+		rgbe_RGBEToFloat(&data[x], rgbe);
 	}
-	else {
-		rgbf->red = rgbf->green = rgbf->blue = 0;
+}
+
+/**
+Convert float pixels to a planar RGBE scanline (as stored by the RLE scheme)
+*/
+static void
+rgbe_FloatToPlanar(const FIRGBF *data, BYTE *r, BYTE *g, BYTE *b, BYTE *e, unsigned count) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 min_value = _mm_set1_ps(1e-32F);
+	const __m128i exponent_mask = _mm_set1_epi32(0xFF);
+	const __m128i scale_bias = _mm_set1_epi32(261);
+	const __m128i exponent_bias = _mm_set1_epi32(2);
+
+	for (; x + 4 <= count; x += 4) {
+		// deinterleave r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+		const float *src = (const float*)&data[x];
+		const __m128 in0 = _mm_loadu_ps(src);
+		const __m128 in1 = _mm_loadu_ps(src + 4);
+		const __m128 in2 = _mm_loadu_ps(src + 8);
+		const __m128 r23 = _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(1, 1, 2, 2));
+		const __m128 red = _mm_shuffle_ps(in0, r23, _MM_SHUFFLE(2, 0, 3, 0));
+		const __m128 g01 = _mm_shuffle_ps(in0, in1, _MM_SHUFFLE(0, 0, 1, 1));
+		const __m128 g23 = _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(2, 2, 3, 3));
+		const __m128 green = _mm_shuffle_ps(g01, g23, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 b01 = _mm_shuffle_ps(in0, in1, _MM_SHUFFLE(1, 1, 2, 2));
+		const __m128 b23 = _mm_shuffle_ps(in2, in2, _MM_SHUFFLE(3, 3, 0, 0));
+		const __m128 blue = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2, 0, 2, 0));
+
+		const __m128 v = _mm_max_ps(red, _mm_max_ps(green, blue));
+		// pixels below the threshold (or NaN) are set to zero
+		const __m128i valid = _mm_castps_si128(_mm_cmpge_ps(v, min_value));
+		const __m128i exponent = _mm_and_si128(_mm_srli_epi32(_mm_castps_si128(v), 23), exponent_mask);
+		const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(scale_bias, exponent), 23));
+
+		const __m128i r4 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_max_ps(red, zero), scale)), valid);
+		const __m128i g4 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_max_ps(green, zero), scale)), valid);
+		const __m128i b4 = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_max_ps(blue, zero), scale)), valid);
+		const __m128i e4 = _mm_and_si128(_mm_add_epi32(exponent, exponent_bias), valid);
+
+		// pack to bytes: r0..r3 g0..g3 | b0..b3 e0..e3
+		const __m128i rgbe = _mm_packus_epi16(_mm_packs_epi32(r4, g4), _mm_packs_epi32(b4, e4));
+		const int r32 = _mm_cvtsi128_si32(rgbe);
+		const int g32 = _mm_cvtsi128_si32(_mm_srli_si128(rgbe, 4));
+		const int b32 = _mm_cvtsi128_si32(_mm_srli_si128(rgbe, 8));
+		const int e32 = _mm_cvtsi128_si32(_mm_srli_si128(rgbe, 12));
+		memcpy(r + x, &r32, 4);
+		memcpy(g + x, &g32, 4);
+		memcpy(b + x, &b32, 4);
+		memcpy(e + x, &e32, 4);
+	}
+#endif // FREEIMAGE_SSE2
+	for (; x < count; x++) {
+		BYTE rgbe[4];
+		rgbe_FloatToRGBE(rgbe, &data[x]);
+		r[x] = rgbe[0];
+		g[x] = rgbe[1];
+		b[x] = rgbe[2];
+		e[x] = rgbe[3];
 	}
 }
 
@@ -307,121 +441,168 @@ rgbe_WriteMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info) {
 	return TRUE;
 }
 
-/** 
-Simple read routine. Will not correctly handle run length encoding 
-@todo THIS IS SLOW, reading an `rgbe` at a time!
+/**
+Buffered reader used for the pixel data, so that the RLE decoder does not need a read call per run.
+Unread data is given back to the stream when the reader is destroyed.
 */
-static BOOL 
-rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels, const FreeImageCB* cb) {
-  BYTE rgbe[4];
+class rgbeReader {
+private:
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	BYTE *m_buffer;
+	BYTE *m_pos;
+	BYTE *m_end;
 
-  for(unsigned x = 0; x < numpixels; x++) {
-	if(io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
-		return rgbe_Error(cb, rgbe_read_error, NULL);
+	rgbeReader(const rgbeReader&);
+	rgbeReader& operator=(const rgbeReader&);
+
+	BOOL fill() {
+		const unsigned count = m_io->read_proc(m_buffer, 1, HDR_READ_BUFFER_SIZE, m_handle);
+		m_pos = m_buffer;
+		m_end = m_buffer + count;
+		return (count > 0) ? TRUE : FALSE;
 	}
-	rgbe_RGBEToFloat(&data[x], rgbe);
-  }
 
-  return TRUE;
-}
+public:
+	rgbeReader(FreeImageIO *io, fi_handle handle) : m_io(io), m_handle(handle) {
+		m_buffer = (BYTE*)malloc(HDR_READ_BUFFER_SIZE);
+		m_pos = m_end = m_buffer;
+	}
 
-/**
- Simple write routine that does not use run length encoding. 
- These routines can be made faster by allocating a larger buffer and
- fread-ing and fwrite-ing the data in larger chunks.
+	~rgbeReader() {
+		if (m_end > m_pos) {
+			m_io->seek_proc(m_handle, -(long)(m_end - m_pos), SEEK_CUR);
+		}
+		free(m_buffer);
+	}
+
+	BOOL isValid() const {
+		return m_buffer ? TRUE : FALSE;
+	}
+
+	/**
+	Read count bytes
+	*/
+	inline BOOL read(void *dst, size_t count) {
+		if ((size_t)(m_end - m_pos) >= count) {
+			memcpy(dst, m_pos, count);
+			m_pos += count;
+			return TRUE;
+		}
+		BYTE *p = (BYTE*)dst;
+		while (count > 0) {
+			if ((m_pos == m_end) && !fill()) {
+				return FALSE;
+			}
+			const size_t chunk = MIN(count, (size_t)(m_end - m_pos));
+			memcpy(p, m_pos, chunk);
+			m_pos += chunk;
+			p += chunk;
+			count -= chunk;
+		}
+		return TRUE;
+	}
+
+	/**
+	Read a single byte
+	*/
+	inline BOOL read(BYTE *value) {
+		if ((m_pos == m_end) && !fill()) {
+			return FALSE;
+		}
+		*value = *m_pos++;
+		return TRUE;
+	}
+};
+
+/** 
+Simple read routine, for files which are not run length encoded
 */
 static BOOL 
-rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels) {
-  BYTE rgbe[4];
+rgbe_ReadPixels(rgbeReader& reader, FIRGBF *data, unsigned numpixels, const FreeImageCB* cb) {
+	BYTE rgbe[4];
 
-  for(unsigned x = 0; x < numpixels; x++) {
-	  rgbe_FloatToRGBE(rgbe, &data[x]);
-	  if (io->write_proc(rgbe, sizeof(rgbe), 1, handle) < 1) {
-		  return rgbe_Error(NULL, rgbe_write_error, NULL);
-	  }
-  }
+	for(unsigned x = 0; x < numpixels; x++) {
+		if(!reader.read(rgbe, sizeof(rgbe))) {
+			return rgbe_Error(cb, rgbe_read_error, NULL);
+		}
+		rgbe_RGBEToFloat(&data[x], rgbe);
+	}
 
-  return TRUE;
+	return TRUE;
 }
 
+/**
+Read run length encoded scanlines
+@param reader Pixel data reader
+@param data Output pixels
+@param scanline_width Image width
+@param num_scanlines Number of scanlines to read
+@param scanline_buffer Planar scanline buffer, of size 4 * scanline_width
+@param cb Error callback
+*/
 static BOOL 
-rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines, const FreeImageCB* cb) {
+rgbe_ReadPixels_RLE(rgbeReader& reader, FIRGBF *data, int scanline_width, unsigned num_scanlines, BYTE *scanline_buffer, const FreeImageCB* cb) {
 	BYTE rgbe[4], *ptr, *ptr_end;
 	int i, count;
-	BYTE buf[2];
+	BYTE code, value;
 	
 	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
 		// run length encoding is not allowed so read flat
-		return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines, cb);
+		return rgbe_ReadPixels(reader, data, scanline_width * num_scanlines, cb);
 	}
-	BYTE* scanline_buffer = NULL;
-	unique_mem scanline_buffer_storage(NULL);
 
 	// read in each successive scanline 
 	while(num_scanlines > 0) {
-		if(io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
+		if(!reader.read(rgbe, sizeof(rgbe))) {
 			return rgbe_Error(cb, rgbe_read_error,NULL);
 		}
 		if((rgbe[0] != 2) || (rgbe[1] != 2) || (rgbe[2] & 0x80)) {
 			// this file is not run length encoded
 			rgbe_RGBEToFloat(data, rgbe);
 			data ++;
-			return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines - 1, cb);
+			return rgbe_ReadPixels(reader, data, scanline_width * num_scanlines - 1, cb);
 		}
 		if((((int)rgbe[2]) << 8 | rgbe[3]) != scanline_width) {
 			return rgbe_Error(cb, rgbe_format_error,"wrong scanline width");
 		}
-		if(scanline_buffer == NULL) {
-			scanline_buffer = (BYTE*)malloc(sizeof(BYTE) * 4 * scanline_width);
-			if(scanline_buffer == NULL) {
-				return rgbe_Error(cb, rgbe_memory_error, "unable to allocate buffer space");
-			}
-			scanline_buffer_storage.reset(scanline_buffer);
-		}
 		
 		ptr = &scanline_buffer[0];
 		// read each of the four channels for the scanline into the buffer
 		for(i = 0; i < 4; i++) {
 			ptr_end = &scanline_buffer[(i+1)*scanline_width];
 			while(ptr < ptr_end) {
-				if(io->read_proc(buf, 1, 2 * sizeof(BYTE), handle) < 1) {
+				if(!reader.read(&code)) {
 					return rgbe_Error(cb, rgbe_read_error, NULL);
 				}
-				if(buf[0] > 128) {
+				if(code > 128) {
 					// a run of the same value
-					count = buf[0] - 128;
-					if((count == 0) || (count > ptr_end - ptr)) {
+					count = code - 128;
+					if(count > ptr_end - ptr) {
 						return rgbe_Error(cb, rgbe_format_error, "bad scanline data");
 					}
-					while (count-- > 0) {
-						*ptr++ = buf[1];
+					if(!reader.read(&value)) {
+						return rgbe_Error(cb, rgbe_read_error, NULL);
 					}
+					memset(ptr, value, count);
+					ptr += count;
 				}
 				else {
 					// a non-run
-					count = buf[0];
+					count = code;
 					if((count == 0) || (count > ptr_end - ptr)) {
 						return rgbe_Error(cb, rgbe_format_error, "bad scanline data");
 					}
-					*ptr++ = buf[1];
-					if(--count > 0) {
-						if(io->read_proc(ptr, 1, sizeof(BYTE) * count, handle) < 1) {
-							return rgbe_Error(cb, rgbe_read_error, NULL);
-						}
-						ptr += count;
+					if(!reader.read(ptr, count)) {
+						return rgbe_Error(cb, rgbe_read_error, NULL);
 					}
+					ptr += count;
 				}
 			}
 		}
 		// now convert data from buffer into floats
-		for(i = 0; i < scanline_width; i++) {
-			rgbe[0] = scanline_buffer[i];
-			rgbe[1] = scanline_buffer[i+scanline_width];
-			rgbe[2] = scanline_buffer[i+2*scanline_width];
-			rgbe[3] = scanline_buffer[i+3*scanline_width];
-			rgbe_RGBEToFloat(data, rgbe);
-			data ++;
-		}
+		rgbe_PlanarToFloat(scanline_buffer, scanline_buffer + scanline_width, scanline_buffer + 2 * scanline_width, scanline_buffer + 3 * scanline_width, data, scanline_width);
+		data += scanline_width;
 
 		num_scanlines--;
 	}
@@ -429,18 +610,27 @@ rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanlin
 	return TRUE;
 }
 
+/**
+Get the largest size of an encoded scanline
+*/
+static inline size_t
+rgbe_GetMaxEncodedSize(unsigned scanline_width) {
+	// each run of at most 128 literals adds a byte
+	return 4 + 4 * ((size_t)scanline_width + scanline_width / 128 + 1);
+}
+
 /**
  The code below is only needed for the run-length encoded files.
  Run length encoding adds considerable complexity but does 
  save some space.  For each scanline, each channel (r,g,b,e) is 
  encoded separately for better compression. 
- @return Returns TRUE if successful, returns FALSE otherwise
+ @return Returns the number of bytes written to dst
 */
-static BOOL 
-rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes) {
+static size_t
+rgbe_EncodeBytes_RLE(const BYTE *data, int numbytes, BYTE *dst) {
 	static const int MINRUNLENGTH = 4;
 	int cur, beg_run, run_count, old_run_count, nonrun_count;
-	BYTE buf[2];
+	BYTE *start = dst;
 	
 	cur = 0;
 	while(cur < numbytes) {
@@ -457,11 +647,8 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes)
 		}
 		// if data before next big run is a short run then write it as such 
 		if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
-			buf[0] = (BYTE)(128 + old_run_count);   // write short run
-			buf[1] = data[cur];
-			if (io->write_proc(buf, 2 * sizeof(BYTE), 1, handle) < 1) {
-				return rgbe_Error(NULL, rgbe_write_error, NULL);
-			}
+			*dst++ = (BYTE)(128 + old_run_count);   // write short run
+			*dst++ = data[cur];
 			cur = beg_run;
 		}
 		// write out bytes until we reach the start of the next run 
@@ -470,75 +657,56 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes)
 			if (nonrun_count > 128) {
 				nonrun_count = 128;
 			}
-			buf[0] = (BYTE)nonrun_count;
-			if (io->write_proc(buf, sizeof(buf[0]), 1, handle) < 1) {
-				return rgbe_Error(NULL, rgbe_write_error, NULL);
-			}
-			if (io->write_proc(&data[cur], sizeof(data[0]) * nonrun_count, 1, handle) < 1) {
-				return rgbe_Error(NULL, rgbe_write_error, NULL);
-			}
+			*dst++ = (BYTE)nonrun_count;
+			memcpy(dst, &data[cur], nonrun_count);
+			dst += nonrun_count;
 			cur += nonrun_count;
 		}
 		// write out next run if one was found 
 		if (run_count >= MINRUNLENGTH) {
-			buf[0] = (BYTE)(128 + run_count);
-			buf[1] = data[beg_run];
-			if (io->write_proc(buf, sizeof(buf[0]) * 2, 1, handle) < 1) {
-				return rgbe_Error(NULL, rgbe_write_error, NULL);
-			}
+			*dst++ = (BYTE)(128 + run_count);
+			*dst++ = data[beg_run];
 			cur += run_count;
 		}
 	}
 	
-	return TRUE;
+	return (size_t)(dst - start);
 }
 
-static BOOL 
-rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines) {
-	BYTE rgbe[4];
-	BYTE *buffer;
-	
+/**
+Encode a scanline, run length encoded when the width allows it
+@param data Input pixels
+@param scanline_width Image width
+@param planar Planar scanline buffer, of size 4 * scanline_width
+@param dst Output buffer, of size rgbe_GetMaxEncodedSize(scanline_width)
+@return Returns the number of bytes written to dst
+*/
+static size_t
+rgbe_EncodeScanline(const FIRGBF *data, unsigned scanline_width, BYTE *planar, BYTE *dst) {
 	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
 		// run length encoding is not allowed so write flat
-		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
-	}
-	buffer = (BYTE*)malloc(sizeof(BYTE) * 4 * scanline_width);
-	if (buffer == NULL) {
-		// no buffer space so write flat 
-		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
-	}
-	while(num_scanlines-- > 0) {
-		rgbe[0] = (BYTE)2;
-		rgbe[1] = (BYTE)2;
-		rgbe[2] = (BYTE)(scanline_width >> 8);
-		rgbe[3] = (BYTE)(scanline_width & 0xFF);
-		if(io->write_proc(rgbe, sizeof(rgbe), 1, handle) < 1) {
-			free(buffer);
-			return rgbe_Error(NULL, rgbe_write_error, NULL);
-		}
 		for(unsigned x = 0; x < scanline_width; x++) {
-			rgbe_FloatToRGBE(rgbe, data);
-			buffer[x] = rgbe[0];
-			buffer[x+scanline_width] = rgbe[1];
-			buffer[x+2*scanline_width] = rgbe[2];
-			buffer[x+3*scanline_width] = rgbe[3];
-			data ++;
-		}
-		// write out each of the four channels separately run length encoded
-		// first red, then green, then blue, then exponent
-		for(int i = 0; i < 4; i++) {
-			BOOL bOK = rgbe_WriteBytes_RLE(io, handle, &buffer[i*scanline_width], scanline_width);
-			if(!bOK) {
-				free(buffer);
-				return bOK;
-			}
+			rgbe_FloatToRGBE(dst + 4 * x, &data[x]);
 		}
+		return 4 * (size_t)scanline_width;
 	}
-	free(buffer);
-	
-	return TRUE;
-}
 
+	BYTE *start = dst;
+	*dst++ = 2;
+	*dst++ = 2;
+	*dst++ = (BYTE)(scanline_width >> 8);
+	*dst++ = (BYTE)(scanline_width & 0xFF);
+
+	rgbe_FloatToPlanar(data, planar, planar + scanline_width, planar + 2 * scanline_width, planar + 3 * scanline_width, scanline_width);
+
+	// write out each of the four channels separately run length encoded
+	// first red, then green, then blue, then exponent
+	for(int i = 0; i < 4; i++) {
+		dst += rgbe_EncodeBytes_RLE(&planar[i * scanline_width], (int)scanline_width, dst);
+	}
+
+	return (size_t)(dst - start);
+}
 
 // ----------------------------------------------------------
 
@@ -641,11 +809,22 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 
 		// read the image pixels and fill the dib
 
+		BYTE *scanline_buffer = (BYTE*)malloc(sizeof(BYTE) * 4 * width);
+		if(!scanline_buffer) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		unique_mem scanline_buffer_storage(scanline_buffer);
+
+		rgbeReader reader(io, handle);
+		if(!reader.isValid()) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
 		FIProgress::Step step = progress.getStepProgress(height, 1);
 		
 		for(unsigned y = 0; y < height; y++) {
 			FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
-			if(!rgbe_ReadPixels_RLE(io, handle, scanline, width, 1, args->cb)) {
+			if(!rgbe_ReadPixels_RLE(reader, scanline, width, 1, scanline_buffer, args->cb)) {
 				throw (const char*)NULL;
 			}
 			if(!step.progress()) {
@@ -692,12 +871,37 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return FALSE;
 	}
 
-	// write each scanline
+	// encode the scanlines by groups of bands, then write them in order
 
-	for(unsigned y = 0; y < height; y++) {
-		FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
-		if(!rgbe_WritePixels_RLE(io, handle, scanline, width, 1)) {
-			return FALSE;
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, HDR_MIN_THREAD_PIXELS);
+	const unsigned group_lines = MIN(height, threads * HDR_BAND_LINES);
+	const size_t max_line_size = rgbe_GetMaxEncodedSize(width);
+
+	BYTE *encoded = (BYTE*)malloc(group_lines * max_line_size);
+	BYTE *planar = (BYTE*)malloc((size_t)threads * 4 * width);
+	size_t *line_size = (size_t*)malloc(group_lines * sizeof(size_t));
+	unique_mem encoded_storage(encoded);
+	unique_mem planar_storage(planar);
+	unique_mem line_size_storage(line_size);
+	if(!encoded || !planar || !line_size) {
+		return rgbe_Error(NULL, rgbe_memory_error, "unable to allocate buffer space");
+	}
+
+	for(unsigned y0 = 0; y0 < height; y0 += group_lines) {
+		const unsigned lines = MIN(group_lines, height - y0);
+
+		FreeImage_ParallelFor(0, lines, threads, [&](unsigned first, unsigned last, unsigned band) {
+			BYTE *band_planar = planar + (size_t)band * 4 * width;
+			for(unsigned k = first; k < last; k++) {
+				const FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - (y0 + k));
+				line_size[k] = rgbe_EncodeScanline(scanline, width, band_planar, encoded + k * max_line_size);
+			}
+		});
+
+		for(unsigned k = 0; k < lines; k++) {
+			if(io->write_proc(encoded + k * max_line_size, (unsigned)line_size[k], 1, handle) < 1) {
+				return rgbe_Error(NULL, rgbe_write_error, NULL);
+			}
 		}
 	}
 
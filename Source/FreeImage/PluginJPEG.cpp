@@ -1088,6 +1088,108 @@ store_size_info(FIBITMAP *dib, JDIMENSION width, JDIMENSION height) {
 	}
 }
 
+// ------------------------------------------------------------
+//   Read the scanlines of an output pass into a dib
+// ------------------------------------------------------------
+
+/**
+Decode the scanlines of the current output pass, converting them to the dib layout
+@param cinfo Decompressor, started or in a buffered-image output pass
+@param dib Destination image
+@param flags Load flags
+@param step Progress of the pass
+@return Returns FALSE if the caller canceled the load
+*/
+static BOOL 
+read_scanlines(j_decompress_ptr cinfo, FIBITMAP *dib, int flags, FIProgress::Step &step) {
+	if((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+		// convert from CMYK to RGB
+
+		JSAMPARRAY buffer;		// output row buffer
+		unsigned row_stride;	// physical row width in output buffer
+
+		// JSAMPLEs per row in output buffer
+		row_stride = cinfo->output_width * cinfo->output_components;
+		// make a one-row-high sample array that will go away when done with image
+		buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, row_stride, 1);
+
+		while (cinfo->output_scanline < cinfo->output_height) {
+			JSAMPROW src = buffer[0];
+			JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo->output_height - cinfo->output_scanline - 1);
+
+			jpeg_read_scanlines(cinfo, buffer, 1);
+
+			for(unsigned x = 0; x < cinfo->output_width; x++) {
+				WORD K = (WORD)src[3];
+				dst[FI_RGBA_RED]   = (BYTE)((K * src[0]) / 255);	// C -> R
+				dst[FI_RGBA_GREEN] = (BYTE)((K * src[1]) / 255);	// M -> G
+				dst[FI_RGBA_BLUE]  = (BYTE)((K * src[2]) / 255);	// Y -> B
+				src += 4;
+				dst += 3;
+			}
+
+			if(! step.progress()) {
+				return FALSE;
+			}
+		}
+
+	} else if((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
+		// convert from LibJPEG CMYK to standard CMYK
+
+		JSAMPARRAY buffer;		// output row buffer
+		unsigned row_stride;	// physical row width in output buffer
+
+		// JSAMPLEs per row in output buffer
+		row_stride = cinfo->output_width * cinfo->output_components;
+		// make a one-row-high sample array that will go away when done with image
+		buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, row_stride, 1);
+
+		while (cinfo->output_scanline < cinfo->output_height) {
+			JSAMPROW src = buffer[0];
+			JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo->output_height - cinfo->output_scanline - 1);
+
+			jpeg_read_scanlines(cinfo, buffer, 1);
+
+			for(unsigned x = 0; x < cinfo->output_width; x++) {
+				// CMYK pixels are inverted
+				dst[0] = ~src[0];	// C
+				dst[1] = ~src[1];	// M
+				dst[2] = ~src[2];	// Y
+				dst[3] = ~src[3];	// K
+				src += 4;
+				dst += 4;
+			}
+
+			if(! step.progress()) {
+				return FALSE;
+			}
+		}
+
+	} else {
+		// normal case (RGB or greyscale image)
+
+		while (cinfo->output_scanline < cinfo->output_height) {
+			JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo->output_height - cinfo->output_scanline - 1);
+
+			jpeg_read_scanlines(cinfo, &dst, 1);
+
+			if(! step.progress()) {
+				return FALSE;
+			}
+		}
+
+		// swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
+		// The default behavior of the JPEG library is kept "as is" because LibTIFF uses 
+		// LibJPEG "as is".
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		SwapRedBlue32(dib);
+#endif
+	}
+
+	return TRUE;
+}
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -1236,6 +1338,12 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 				cinfo.out_color_space = JCS_GRAYSCALE;
 			}
 
+			// with a preview callback, progressive images are decoded in buffered-image mode
+
+			if(! header_only && jpeg_has_multiple_scans(&cinfo) && progress.wantsPreview()) {
+				cinfo.buffered_image = TRUE;
+			}
+
 			// step 5a: start decompressor and calculate output width and height
 
 			jpeg_start_decompress(&cinfo);
@@ -1307,99 +1415,54 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 
 			const bool shouldRotateExif = ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE);
 
-			FIProgress::Step step = progress.getStepProgress(cinfo.output_height, shouldRotateExif ? .9 : 1.);
-
-			if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
-				// convert from CMYK to RGB
-
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
-
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, buffer, 1);
+			BOOL bPreviewStopped = FALSE;
 
-					for(unsigned x = 0; x < cinfo.output_width; x++) {
-						WORD K = (WORD)src[3];
-						dst[FI_RGBA_RED]   = (BYTE)((K * src[0]) / 255);	// C -> R
-						dst[FI_RGBA_GREEN] = (BYTE)((K * src[1]) / 255);	// M -> G
-						dst[FI_RGBA_BLUE]  = (BYTE)((K * src[2]) / 255);	// Y -> B
-						src += 4;
-						dst += 3;
-					}
+			if(! cinfo.buffered_image) {
+				FIProgress::Step step = progress.getStepProgress(cinfo.output_height, shouldRotateExif ? .9 : 1.);
 
-					if(! step.progress()) {
-						return NULL;
-					}
+				if(! read_scanlines(&cinfo, dib, flags, step)) {
+					return NULL;
 				}
-				
-				// if original image is CMYK but is converted to RGB, remove ICC profile from Exif-TIFF metadata
-				FreeImage_SetMetadata(FIMD_EXIF_MAIN, dib, "InterColorProfile", NULL);
-
-			} else if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
-				// convert from LibJPEG CMYK to standard CMYK
-
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
+			} else {
+				// progressive JPEG: one output pass per scan, each one showing the data received so far
 
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+				const double end_progress = shouldRotateExif ? .9 : 1.;
+				double pass_progress = 0;
 
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
+				for(unsigned pass = 0; ; pass++) {
+					// give each pass half of the remaining progress range, as the number of scans is unknown
+					pass_progress += (end_progress - pass_progress) / 2;
+					FIProgress::Step step = progress.getStepProgress(cinfo.output_height, pass_progress);
 
-					jpeg_read_scanlines(&cinfo, buffer, 1);
+					jpeg_start_output(&cinfo, cinfo.input_scan_number);
 
-					for(unsigned x = 0; x < cinfo.output_width; x++) {
-						// CMYK pixels are inverted
-						dst[0] = ~src[0];	// C
-						dst[1] = ~src[1];	// M
-						dst[2] = ~src[2];	// Y
-						dst[3] = ~src[3];	// K
-						src += 4;
-						dst += 4;
-					}
-
-					if(! step.progress()) {
+					if(! read_scanlines(&cinfo, dib, flags, step)) {
 						return NULL;
 					}
-				}
 
-			} else {
-				// normal case (RGB or greyscale image)
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
+					jpeg_finish_output(&cinfo);
 
-					jpeg_read_scanlines(&cinfo, &dst, 1);
-
-					if(! step.progress()) {
-						return NULL;
+					if(jpeg_input_complete(&cinfo)) {
+						break;
+					}
+					if(! progress.reportPreview(dib, pass)) {
+						// early stop: the rest of the stream is not decoded
+						bPreviewStopped = TRUE;
+						break;
 					}
 				}
+			}
 
-				// step 7b: swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
-				// The default behavior of the JPEG library is kept "as is" because LibTIFF uses 
-				// LibJPEG "as is".
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-				SwapRedBlue32(dib);
-#endif
+			if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+				// if original image is CMYK but is converted to RGB, remove ICC profile from Exif-TIFF metadata
+				FreeImage_SetMetadata(FIMD_EXIF_MAIN, dib, "InterColorProfile", NULL);
 			}
 
 			// step 8: finish decompression
 
-			jpeg_finish_decompress(&cinfo);
+			if(! bPreviewStopped) {
+				jpeg_finish_decompress(&cinfo);
+			}
 
 			// step 9: release of JPEG decompression object is done by dib_storage (also called when aborting, but it is safe to call multiple times)
 
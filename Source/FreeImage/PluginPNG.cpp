@@ -29,6 +29,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -36,6 +37,9 @@
 
 #define PNG_BYTES_TO_CHECK 8
 
+// size of the IDAT data block passed to zlib at once when loading (libpng default is 8K)
+#define PNG_IDAT_READ_BUFFER_SIZE 0x10000
+
 #undef PNG_Z_DEFAULT_COMPRESSION	// already used in ../LibPNG/pnglibconf.h
 
 // ----------------------------------------------------------
@@ -584,6 +588,12 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 
 			png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
 
+			// feed the inflater with large blocks, and skip the Adler-32 check of the image data:
+			// it is redundant with the CRC-32 check of the IDAT chunks, which is always performed
+
+			png_set_compression_buffer_size(png_ptr, PNG_IDAT_READ_BUFFER_SIZE);
+			png_set_option(png_ptr, PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+
 			// read the IHDR chunk
 
 			png_read_info(png_ptr, info_ptr);
@@ -767,6 +777,16 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 
 			png_set_benign_errors(png_ptr, 1);
 
+			// check if the bitmap contains transparency, if so enable it in the header
+
+			if (FreeImage_GetBPP(dib) == 32) {
+				if (FreeImage_GetColorType(dib) == FIC_RGBALPHA) {
+					FreeImage_SetTransparent(dib, TRUE);
+				} else {
+					FreeImage_SetTransparent(dib, FALSE);
+				}
+			}
+
 			// read image
 
 			if(! args->cb) {
@@ -774,26 +794,34 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 			} else {
 				FIProgress::Step step = progress.getStepProgress(fi_progress_t(height) * passes, .95);
 
+				// with a preview callback, the rows are given to libpng as 'display' rows:
+				// each pass then fills the blocks of the pixels it has not reached yet,
+				// so that every pass leaves a complete (lower resolution) image behind
+
+				const BOOL preview = (passes > 1) && progress.wantsPreview();
+
 				for(unsigned p = 0; p < passes; p++) {
 					png_bytepp rp = row_pointers;
 					for(unsigned y = 0; y < height; y++) {
-						png_read_row(png_ptr, *rp, NULL);
+						if(preview) {
+							png_read_row(png_ptr, NULL, *rp);
+						} else {
+							png_read_row(png_ptr, *rp, NULL);
+						}
 						rp++;
 
 						if(! step.progress()) {
 							return NULL;
 						}
 					}
-				}
-			}
 
-			// check if the bitmap contains transparency, if so enable it in the header
+					if(preview && (p + 1 < passes) && !progress.reportPreview(dib, p)) {
+						// early stop: the remaining image data is not read
 
-			if (FreeImage_GetBPP(dib) == 32) {
-				if (FreeImage_GetColorType(dib) == FIC_RGBALPHA) {
-					FreeImage_SetTransparent(dib, TRUE);
-				} else {
-					FreeImage_SetTransparent(dib, FALSE);
+						ReadMetadata(png_ptr, info_ptr, dib);
+
+						return dib_storage.release();
+					}
 				}
 			}
 
@@ -819,6 +847,348 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 	return NULL;
 }
 
+// ==========================================================
+// Parallel IDAT writer
+// ==========================================================
+
+/**
+Size of the image data handled by one deflate stream when saving with PNG_PARALLEL. 
+Smaller bands would cost compression ratio for little gain.
+*/
+#define PNG_PARALLEL_MIN_BAND	0x40000
+/**
+Maximum size of an IDAT chunk written by the parallel writer
+*/
+#define PNG_PARALLEL_IDAT_SIZE	0x100000
+
+/**
+Image layout and encoder settings shared by the parallel writer threads
+*/
+typedef struct tagPNGParallelEncoder {
+	FIBITMAP *dib;
+	unsigned width;
+	unsigned height;
+	unsigned rowbytes;		//! size of a packed PNG row, without the filter byte
+	unsigned bpp;			//! filter distance, in bytes
+	int pixel_depth;		//! FreeImage pixel depth
+	int channels;			//! number of PNG channels
+	int bit_depth;			//! PNG bit depth
+	BOOL invert;			//! invert the samples (min-is-white greyscale)
+	int filters;			//! candidate filters, PNG_FILTER_xxx mask
+	int zlib_level;
+	int zlib_strategy;
+} PNGParallelEncoder;
+
+/**
+Convert a FreeImage scanline to a packed PNG row, applying the transformations libpng 
+would have applied to the same row (RGB order, 32- to 24-bit conversion, mono inversion, 16-bit byte swapping)
+*/
+static void 
+PackPNGRow(const PNGParallelEncoder &enc, BYTE *dst, unsigned y) {
+	const BYTE *src = FreeImage_GetScanLine(enc.dib, enc.height - y - 1);
+
+	if(enc.bit_depth == 16) {
+#ifndef FREEIMAGE_BIGENDIAN
+		for(unsigned i = 0; i < enc.rowbytes; i += 2) {
+			dst[i]     = src[i + 1];
+			dst[i + 1] = src[i];
+		}
+#else
+		memcpy(dst, src, enc.rowbytes);
+#endif
+	} else if(enc.pixel_depth >= 24) {
+		const unsigned src_bpp = enc.pixel_depth / 8;
+		for(unsigned x = 0; x < enc.width; x++) {
+			dst[0] = src[FI_RGBA_RED];
+			dst[1] = src[FI_RGBA_GREEN];
+			dst[2] = src[FI_RGBA_BLUE];
+			if(enc.channels == 4) {
+				dst[3] = src[FI_RGBA_ALPHA];
+			}
+			dst += enc.channels;
+			src += src_bpp;
+		}
+	} else if(enc.invert) {
+		for(unsigned i = 0; i < enc.rowbytes; i++) {
+			dst[i] = (BYTE)~src[i];
+		}
+	} else {
+		memcpy(dst, src, enc.rowbytes);
+	}
+}
+
+/**
+Apply a PNG filter to a row
+@param dst Output row, its first byte receives the filter type
+@param row Packed PNG row
+@param prev Previous packed row, or NULL for the first row of the image
+*/
+static void 
+FilterPNGRow(BYTE *dst, const BYTE *row, const BYTE *prev, unsigned rowbytes, unsigned bpp, int filter) {
+	*dst++ = (BYTE)filter;
+
+	switch(filter) {
+		case 1: // Sub
+			for(unsigned i = 0; i < rowbytes; i++) {
+				dst[i] = (BYTE)(row[i] - ((i >= bpp) ? row[i - bpp] : 0));
+			}
+			break;
+		case 2: // Up
+			for(unsigned i = 0; i < rowbytes; i++) {
+				dst[i] = (BYTE)(row[i] - (prev ? prev[i] : 0));
+			}
+			break;
+		case 3: // Average
+			for(unsigned i = 0; i < rowbytes; i++) {
+				const unsigned a = (i >= bpp) ? row[i - bpp] : 0;
+				const unsigned b = prev ? prev[i] : 0;
+				dst[i] = (BYTE)(row[i] - ((a + b) >> 1));
+			}
+			break;
+		case 4: // Paeth
+			for(unsigned i = 0; i < rowbytes; i++) {
+				const int a = (i >= bpp) ? row[i - bpp] : 0;
+				const int b = prev ? prev[i] : 0;
+				const int c = (prev && (i >= bpp)) ? prev[i - bpp] : 0;
+				const int pa = abs(b - c);
+				const int pb = abs(a - c);
+				const int pc = abs(a + b - 2 * c);
+				const int p = ((pa <= pb) && (pa <= pc)) ? a : ((pb <= pc) ? b : c);
+				dst[i] = (BYTE)(row[i] - p);
+			}
+			break;
+		default: // None
+			memcpy(dst, row, rowbytes);
+			break;
+	}
+}
+
+/**
+Minimum sum of absolute differences heuristic, the same one libpng uses to choose a filter
+*/
+static unsigned long 
+ScorePNGRow(const BYTE *filtered, unsigned rowbytes) {
+	unsigned long sum = 0;
+	for(unsigned i = 1; i <= rowbytes; i++) {
+		const unsigned v = filtered[i];
+		sum += (v < 128) ? v : (256 - v);
+	}
+	return sum;
+}
+
+/**
+Pack and filter the rows [first, last) of the image into their final place in the filtered image buffer
+@return Returns FALSE if a scratch buffer could not be allocated
+*/
+static BOOL 
+FilterPNGRows(const PNGParallelEncoder &enc, BYTE *filtered, unsigned first, unsigned last) {
+	const size_t pitch = enc.rowbytes + 1;
+
+	BYTE *rows = (BYTE*)malloc(2 * enc.rowbytes + pitch);
+	if(!rows) {
+		return FALSE;
+	}
+	BYTE *prev = rows;
+	BYTE *row = rows + enc.rowbytes;
+	BYTE *trial = rows + 2 * enc.rowbytes;
+
+	if(first > 0) {
+		PackPNGRow(enc, prev, first - 1);
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		PackPNGRow(enc, row, y);
+
+		BYTE *dst = filtered + y * pitch;
+		const BYTE *up = (y > 0) ? prev : NULL;
+
+		int filter = -1;
+		unsigned long best = 0;
+		for(int f = 0; f < 5; f++) {
+			if((enc.filters & (PNG_FILTER_NONE << f)) == 0) {
+				continue;
+			}
+			if(filter < 0) {
+				FilterPNGRow(dst, row, up, enc.rowbytes, enc.bpp, f);
+				if(enc.filters == (PNG_FILTER_NONE << f)) {
+					break;
+				}
+				best = ScorePNGRow(dst, enc.rowbytes);
+			} else {
+				FilterPNGRow(trial, row, up, enc.rowbytes, enc.bpp, f);
+				const unsigned long score = ScorePNGRow(trial, enc.rowbytes);
+				if(score < best) {
+					memcpy(dst, trial, pitch);
+					best = score;
+				}
+			}
+			filter = f;
+		}
+
+		BYTE *tmp = prev;
+		prev = row;
+		row = tmp;
+	}
+
+	free(rows);
+
+	return TRUE;
+}
+
+/**
+Compress a band of the filtered image as a raw deflate stream. 
+The band is primed with the 32K of data preceding it, so that the concatenation of all bands 
+is a valid deflate stream (pigz-style), which only loses the matches crossing band boundaries. 
+Every band but the last ends on a byte boundary, with a non final block.
+@param out_size Size of the output buffer, receives the compressed size
+@return Returns Z_OK if successful, returns the zlib error code otherwise
+*/
+static int 
+DeflatePNGBand(const PNGParallelEncoder &enc, const BYTE *data, size_t begin, size_t end, BOOL last, BYTE *out, size_t *out_size) {
+	z_stream zs;
+	memset(&zs, 0, sizeof(z_stream));
+
+	int status = deflateInit2(&zs, enc.zlib_level, Z_DEFLATED, -MAX_WBITS, 8, enc.zlib_strategy);
+	if(status != Z_OK) {
+		return status;
+	}
+
+	if(begin > 0) {
+		const size_t dict_size = MIN(begin, (size_t)(1 << MAX_WBITS));
+		status = deflateSetDictionary(&zs, data + begin - dict_size, (uInt)dict_size);
+	}
+
+	zs.next_in = (Bytef*)(data + begin);
+	zs.avail_in = (uInt)(end - begin);
+	zs.next_out = out;
+	zs.avail_out = (uInt)*out_size;
+
+	if(status == Z_OK) {
+		status = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if(last) {
+			status = (status == Z_STREAM_END) ? Z_OK : ((status == Z_OK) ? Z_BUF_ERROR : status);
+		} else if((status == Z_OK) && ((zs.avail_in != 0) || (zs.avail_out == 0))) {
+			// the output slot is too small
+			status = Z_BUF_ERROR;
+		}
+	}
+
+	*out_size -= zs.avail_out;
+	deflateEnd(&zs);
+
+	return status;
+}
+
+/**
+Write the image data as a zlib stream whose bands are filtered and compressed concurrently
+@return Returns NULL if successful, returns the memory or zlib error message otherwise, with nothing written
+*/
+static const char* 
+WriteParallelIDAT(png_structp png_ptr, const PNGParallelEncoder &enc) {
+	const size_t pitch = enc.rowbytes + 1;
+	const size_t total = pitch * enc.height;
+
+	BYTE *filtered = (BYTE*)malloc(total);
+	if(!filtered) {
+		return FI_MSG_ERROR_MEMORY;
+	}
+
+	BOOL bSuccess = TRUE;
+	const char *error = NULL;
+
+	// filter the rows
+
+	const unsigned threads = FreeImage_GetThreadCount(total, PNG_PARALLEL_MIN_BAND);
+
+	std::vector<BYTE> thread_status(threads, TRUE);
+	FreeImage_ParallelFor(0, enc.height, threads, [&](unsigned first, unsigned last, unsigned index) {
+		thread_status[index] = (BYTE)FilterPNGRows(enc, filtered, first, last);
+	});
+	for(unsigned index = 0; index < threads; index++) {
+		bSuccess = bSuccess && thread_status[index];
+	}
+	if(!bSuccess) {
+		error = FI_MSG_ERROR_MEMORY;
+	}
+
+	// compress the bands, each one into its own slot of the output buffer
+	// the band layout does not depend on the number of threads, so that the output does not either
+
+	const unsigned bands = (unsigned)MAX((size_t)1, total / PNG_PARALLEL_MIN_BAND);
+
+	std::vector<size_t> band_begin(bands + 1);
+	std::vector<size_t> slot_begin(bands + 1);
+	for(unsigned band = 0; band <= bands; band++) {
+		band_begin[band] = (size_t)(((unsigned long long)total * band) / bands);
+	}
+	slot_begin[0] = 2;
+	for(unsigned band = 0; band < bands; band++) {
+		// extra room for the sync marker
+		slot_begin[band + 1] = slot_begin[band] + compressBound((uLong)(band_begin[band + 1] - band_begin[band])) + 16;
+	}
+
+	BYTE *zdata = NULL;
+	if(bSuccess) {
+		zdata = (BYTE*)malloc(slot_begin[bands] + 4);
+		bSuccess = (zdata != NULL);
+		if(!bSuccess) {
+			error = FI_MSG_ERROR_MEMORY;
+		}
+	}
+
+	if(bSuccess) {
+		std::vector<size_t> zsize(bands);
+		std::vector<int> zstatus(bands);
+		std::vector<uLong> adler(bands);
+
+		FreeImage_ParallelFor(0, bands, FreeImage_GetThreadCount(bands, 1), [&](unsigned first, unsigned last, unsigned) {
+			for(unsigned band = first; band < last; band++) {
+				const size_t size = band_begin[band + 1] - band_begin[band];
+				zsize[band] = slot_begin[band + 1] - slot_begin[band];
+				zstatus[band] = DeflatePNGBand(enc, filtered, band_begin[band], band_begin[band + 1], (band == bands - 1),
+					zdata + slot_begin[band], &zsize[band]);
+				adler[band] = adler32(adler32(0L, Z_NULL, 0), filtered + band_begin[band], (uInt)size);
+			}
+		});
+
+		// stitch the bands together and wrap them in a zlib header / trailer
+
+		static const BYTE zlib_flevel[10] = { 0x01, 0x01, 0x5E, 0x5E, 0x5E, 0x5E, 0x9C, 0xDA, 0xDA, 0xDA };
+		zdata[0] = 0x78;
+		zdata[1] = zlib_flevel[(enc.zlib_level >= 0 && enc.zlib_level <= 9) ? enc.zlib_level : 6];
+
+		size_t zlength = 2;
+		uLong checksum = adler[0];
+		for(unsigned band = 0; band < bands; band++) {
+			if(zstatus[band] != Z_OK) {
+				error = zError(zstatus[band]);
+				bSuccess = FALSE;
+				break;
+			}
+			if(band > 0) {
+				checksum = adler32_combine(checksum, adler[band], (z_off_t)(band_begin[band + 1] - band_begin[band]));
+			}
+			memmove(zdata + zlength, zdata + slot_begin[band], zsize[band]);
+			zlength += zsize[band];
+		}
+		zdata[zlength++] = (BYTE)(checksum >> 24);
+		zdata[zlength++] = (BYTE)(checksum >> 16);
+		zdata[zlength++] = (BYTE)(checksum >> 8);
+		zdata[zlength++] = (BYTE)(checksum);
+
+		if(bSuccess) {
+			for(size_t offset = 0; offset < zlength; offset += PNG_PARALLEL_IDAT_SIZE) {
+				png_write_chunk(png_ptr, (png_const_bytep)"IDAT", zdata + offset, MIN(zlength - offset, (size_t)PNG_PARALLEL_IDAT_SIZE));
+			}
+		}
+	}
+
+	free(zdata);
+	free(filtered);
+
+	return error;
+}
+
 // --------------------------------------------------------------------------
 
 static BOOL DLL_CALLCONV
@@ -909,14 +1279,6 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				png_set_compression_level(png_ptr, Z_NO_COMPRESSION);
 			}
 
-			// filtered strategy works better for high color images
-			if(pixel_depth >= 16){
-				png_set_compression_strategy(png_ptr, Z_FILTERED);
-				png_set_filter(png_ptr, 0, PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH);
-			} else {
-				png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-			}
-
 			FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 			if(image_type == FIT_BITMAP) {
 				// standard image type
@@ -1007,6 +1369,27 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 					break;
 			}
 
+			// filtered strategy works better for high color images
+			int zlib_strategy = Z_DEFAULT_STRATEGY;
+			int row_filters = PNG_ALL_FILTERS;
+			if(pixel_depth >= 16){
+				zlib_strategy = Z_FILTERED;
+				row_filters = PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH;
+			}
+			if((flags & PNG_Z_RLE) == PNG_Z_RLE) {
+				zlib_strategy = Z_RLE;
+			}
+			if((flags & PNG_FAST_FILTERING) == PNG_FAST_FILTERING) {
+				// trying 2 filters instead of up to 5 ones, Paeth being the most expensive
+				row_filters = PNG_FILTER_SUB|PNG_FILTER_UP;
+			}
+			if(bit_depth < 8 || png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_PALETTE) {
+				// libpng default for palettized and low bit depth images
+				row_filters = PNG_FILTER_NONE;
+			}
+			png_set_compression_strategy(png_ptr, zlib_strategy);
+			png_set_filter(png_ptr, 0, row_filters);
+
 			// write possible ICC profile
 
 			FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
@@ -1064,7 +1447,35 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				number_passes = png_set_interlace_handling(png_ptr);
 			}
 
-			if ((pixel_depth == 32) && (!has_alpha_channel)) {
+			BOOL bParallel = ((flags & PNG_PARALLEL) == PNG_PARALLEL) && !bInterlaced && (FreeImage_GetColorType(dib) != FIC_CMYK);
+
+			if (bParallel) {
+				// filter and compress the image data ourselves, then close the file
+
+				PNGParallelEncoder enc;
+				enc.dib = dib;
+				enc.width = width;
+				enc.height = height;
+				enc.pixel_depth = pixel_depth;
+				enc.channels = png_get_channels(png_ptr, info_ptr);
+				enc.bit_depth = bit_depth;
+				enc.rowbytes = (unsigned)png_get_rowbytes(png_ptr, info_ptr);
+				enc.bpp = MAX(1, (enc.channels * bit_depth) / 8);
+				enc.invert = (FreeImage_GetColorType(dib) == FIC_MINISWHITE) && !bIsTransparent;
+				enc.filters = row_filters;
+				enc.zlib_level = ((zlib_level >= 1) && (zlib_level <= 9)) ? zlib_level : (((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) ? Z_NO_COMPRESSION : Z_DEFAULT_COMPRESSION);
+				enc.zlib_strategy = zlib_strategy;
+
+				const char *error = WriteParallelIDAT(png_ptr, enc);
+				if (error) {
+					throw error;
+				}
+
+				// all ancillary chunks were written by png_write_info
+
+				png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
+
+			} else if ((pixel_depth == 32) && (!has_alpha_channel)) {
 				BYTE *buffer = (BYTE *)malloc(width * 3);
 
 				// transparent conversion to 24-bit
@@ -1088,7 +1499,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			// It is REQUIRED to call this to finish writing the rest of the file
 			// Bug with png_flush
 
-			png_write_end(png_ptr, info_ptr);
+			if (!bParallel) {
+				png_write_end(png_ptr, info_ptr);
+			}
 
 			// clean up after the write, and free any memory allocated
 			if (palette) {
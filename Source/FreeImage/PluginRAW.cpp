@@ -23,6 +23,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 #include "../Metadata/FreeImageTag.h"
 
 // ==========================================================
@@ -133,6 +134,23 @@ public:
 	}
 };
 
+/**
+Wrap the input stream into a LibRaw datastream. 
+Memory streams and files are handed to LibRaw as a contiguous buffer (zero-copy, no per-read callback), 
+any other stream is read through the FreeImageIO functions. 
+@param io FreeImage IO functions
+@param handle FreeImage IO handle
+@param view View of the stream, must outlive the returned datastream
+@return Returns the datastream (to be deleted by the caller)
+*/
+static LibRaw_abstract_datastream*
+libraw_CreateDatastream(FreeImageIO *io, fi_handle handle, const FIStreamView& view) {
+	if(view.isValid()) {
+		return new(std::nothrow) LibRaw_buffer_datastream(view.data(), view.size());
+	}
+	return new(std::nothrow) LibRaw_freeimage_datastream(io, handle);
+}
+
 // ----------------------------------------------------------
 
 /**
@@ -175,14 +193,12 @@ libraw_ConvertProcessedRawToDib(LibRaw *RawProcessor) {
 			}
 		}
 
-		// copy post-processed bitmap data into FIBITMAP buffer
-		if(RawProcessor->copy_mem_image(FreeImage_GetBits(dib), FreeImage_GetPitch(dib), bgr) != LIBRAW_SUCCESS) {
+		// copy post-processed bitmap data into FIBITMAP buffer, 
+		// starting from the top scanline so that no vertical flip is needed
+		if(RawProcessor->copy_mem_image(FreeImage_GetScanLine(dib, height - 1), -(int)FreeImage_GetPitch(dib), bgr) != LIBRAW_SUCCESS) {
 			throw "LibRaw : failed to copy data into dib";
 		}
 
-		// flip vertically
-		FreeImage_FlipVertical(dib);
-
 		return dib;
 
 	} catch(const char *text) {
@@ -270,13 +286,22 @@ libraw_ConvertProcessedImageToDib(libraw_processed_image_t *image, FIProgress& p
 /** 
 Get the embedded JPEG preview image from RAW picture with included Exif Data. 
 @param RawProcessor Libraw handle
-@param flags JPEG load flags
+@param loadNoPixels Load the preview header and metadata only
+@param requested_size If positive, minimum size of the larger side of the preview, 
+which is downscaled on loading when possible
 @return Returns the loaded dib if successfull, returns NULL otherwise
 */
 static FIBITMAP * 
-libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, bool loadNoPixels, FIProgress& progress) {
+libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, bool loadNoPixels, FIProgress& progress, int requested_size = 0) {
 	FIBITMAP *dib = NULL;
-	
+
+	if(requested_size > 0) {
+		// when known, check the preview size before unpacking it
+		const libraw_thumbnail_t *thumbnail = &RawProcessor->imgdata.thumbnail;
+		if(thumbnail->twidth && thumbnail->theight && (MAX(thumbnail->twidth, thumbnail->theight) < requested_size)) {
+			return NULL;
+		}
+	}
 
 	// unpack data
 	if(RawProcessor->unpack_thumb() != LIBRAW_SUCCESS) {
@@ -304,6 +329,7 @@ libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, bool loadNoPixels, FIProgress&
 			if(loadNoPixels) {
 				args.flags |= FIF_LOAD_NOPIXELS;
 			}
+			args.option = requested_size;
 			args.cb = progress.callback();
 			// load an image from the memory stream
 			dib = FreeImage_LoadFromMemoryAdv(fif, hmem, &args);
@@ -317,16 +343,51 @@ libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, bool loadNoPixels, FIProgress&
 		FreeImage_OutputMessageProcCB(progress.callback(), s_format_id, "LibRaw : failed to run dcraw_make_mem_thumb");
 	}
 
+	if(dib && (requested_size > 0) && (MAX(FreeImage_GetWidth(dib), FreeImage_GetHeight(dib)) < (unsigned)requested_size)) {
+		// the preview is too small
+		FreeImage_Unload(dib);
+		dib = NULL;
+	}
+
 	return dib;
 }
+/**
+Get the LibRaw interpolation quality (user_qual) of a demosaicing algorithm
+@param demosaic One of the RAW_DEMOSAIC_xxx constants
+*/
+static int 
+libraw_GetInterpolationQuality(int demosaic) {
+	switch(demosaic) {
+		case RAW_DEMOSAIC_BILINEAR:
+			return 0;
+		case RAW_DEMOSAIC_VNG:
+			return 1;
+		case RAW_DEMOSAIC_PPG:
+			return 2;
+		case RAW_DEMOSAIC_DCB:
+			return 4;
+		case RAW_DEMOSAIC_DHT:
+			return 11;
+		case RAW_DEMOSAIC_AAHD:
+			return 12;
+		case RAW_DEMOSAIC_AHD:
+		case RAW_DEMOSAIC_DEFAULT:
+		default:
+			return 3;
+	}
+}
+
 /**
 Load raw data and convert to FIBITMAP
 @param RawProcessor Libraw handle
 @param bitspersample Output bitdepth (8- or 16-bit)
+@param raw_args Optional processing arguments
+@param requested_size If positive, minimum size of the larger side of the output image: 
+the image is processed at half size when it is large enough
 @return Returns the loaded dib if successfull, returns NULL otherwise
 */
 static FIBITMAP * 
-libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
+libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample, const FreeImageRAWLoadArgs *raw_args, int requested_size) {
 	FIBITMAP *dib = NULL;
 
 	try {
@@ -349,8 +410,15 @@ libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
 		RawProcessor->imgdata.params.no_auto_bright = 1;
 		// (-a) Use automatic white balance obtained after averaging over the entire image
 		RawProcessor->imgdata.params.use_auto_wb = 1;
-		// (-q 3) Adaptive homogeneity-directed demosaicing algorithm (AHD)
-		RawProcessor->imgdata.params.user_qual = 3;
+		// (-q [0..12]) demosaicing algorithm, Adaptive homogeneity-directed (AHD) by default
+		RawProcessor->imgdata.params.user_qual = libraw_GetInterpolationQuality(raw_args ? raw_args->demosaic : RAW_DEMOSAIC_DEFAULT);
+		// (-h) process a half-size image when it is still larger than the requested size
+		if(requested_size > 0) {
+			const libraw_image_sizes_t *sizes = &RawProcessor->imgdata.sizes;
+			if(MAX(sizes->width, sizes->height) / 2 >= requested_size) {
+				RawProcessor->imgdata.params.half_size = 1;
+			}
+		}
 
 		// -----------------------
 
@@ -360,7 +428,19 @@ libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
 		}
 
 		// process data (... most consuming task ...)
-		if(RawProcessor->dcraw_process() != LIBRAW_SUCCESS) {
+#ifdef LIBRAW_USE_OPENMP
+		// LibRaw is parallelized with OpenMP: the thread count setting 
+		// only applies to the parallel regions started by the calling thread
+		const int max_threads = omp_get_max_threads();
+		if(raw_args && (raw_args->threads > 0)) {
+			omp_set_num_threads(raw_args->threads);
+		}
+		const int process_result = RawProcessor->dcraw_process();
+		omp_set_num_threads(max_threads);
+#else
+		const int process_result = RawProcessor->dcraw_process();
+#endif
+		if(process_result != LIBRAW_SUCCESS) {
 			throw "LibRaw : failed to process data";
 		}
 
@@ -646,10 +726,11 @@ Validate(FreeImageIO *io, fi_handle handle) {
 			BOOL bSuccess = TRUE;
 
 			// wrap the input datastream
-			LibRaw_freeimage_datastream datastream(io, handle);
+			FIStreamView view(io, handle);
+			unique_obj<LibRaw_abstract_datastream> datastream(libraw_CreateDatastream(io, handle, view));
 
 			// open the datastream
-			if(RawProcessor->open_datastream(&datastream) != LIBRAW_SUCCESS) {
+			if(!datastream || (RawProcessor->open_datastream(datastream.get()) != LIBRAW_SUCCESS)) {
 				bSuccess = FALSE;	// LibRaw : failed to open input stream (unknown format)
 			}
 
@@ -698,6 +779,15 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		if(progress.isCanceled()) {
 			return NULL;
 		}
+
+		const FreeImageRAWLoadArgs *raw_args = (const FreeImageRAWLoadArgs*)args->more;
+		if(raw_args && (raw_args->format != s_format_id)) {
+			// arguments meant for another format
+			raw_args = NULL;
+		}
+		// requested size of the larger side of the output image, 0 if none
+		const int requested_size = (int)(args->option & 0xFFFF);
+
 		// do not declare RawProcessor on the stack as it may be huge (300 KB)
 		LibRaw *RawProcessor = new(std::nothrow) LibRaw;
 		if(!RawProcessor) {
@@ -706,7 +796,11 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		unique_obj<LibRaw> RawProcessor_storage(RawProcessor);
 
 		// wrap the input datastream
-		LibRaw_freeimage_datastream datastream(io, handle);
+		FIStreamView view(io, handle);
+		unique_obj<LibRaw_abstract_datastream> datastream(libraw_CreateDatastream(io, handle, view));
+		if(!datastream) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
 
 		// set decoding parameters
 		// the following parameters affect data reading
@@ -722,7 +816,7 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 		RawProcessor->imgdata.params.half_size = ((flags & RAW_HALFSIZE) == RAW_HALFSIZE) ? 1 : 0;
 
 		// open the datastream
-		if(RawProcessor->open_datastream(&datastream) != LIBRAW_SUCCESS) {
+		if(RawProcessor->open_datastream(datastream.get()) != LIBRAW_SUCCESS) {
 			throw "LibRaw : failed to open input stream (unknown format)";
 		}
 
@@ -735,20 +829,20 @@ LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* ar
 			dib = libraw_LoadUnprocessedData(RawProcessor);
 		}
 		else if((flags & RAW_PREVIEW) == RAW_PREVIEW) {
-			// try to get the embedded JPEG
-			dib = libraw_LoadEmbeddedPreview(RawProcessor, false, progress);
+			// try to get the embedded JPEG, if it is at least as large as requested
+			dib = libraw_LoadEmbeddedPreview(RawProcessor, false, progress, requested_size);
 			if(!dib) {
-				// no JPEG preview: try to load as 8-bit/sample (i.e. RGB 24-bit)
-				dib = libraw_LoadRawData(RawProcessor, 8);
+				// no suitable JPEG preview: try to load as 8-bit/sample (i.e. RGB 24-bit)
+				dib = libraw_LoadRawData(RawProcessor, 8, raw_args, requested_size);
 			}
 		} 
 		else if((flags & RAW_DISPLAY) == RAW_DISPLAY) {
 			// load raw data as 8-bit/sample (i.e. RGB 24-bit)
-			dib = libraw_LoadRawData(RawProcessor, 8);
+			dib = libraw_LoadRawData(RawProcessor, 8, raw_args, requested_size);
 		} 
 		else {
 			// default: load raw data as linear 16-bit/sample (i.e. RGB 48-bit)
-			dib = libraw_LoadRawData(RawProcessor, 16);
+			dib = libraw_LoadRawData(RawProcessor, 16, raw_args, requested_size);
 		}
 
 		// save ICC profile if present
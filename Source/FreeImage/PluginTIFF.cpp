@@ -1090,6 +1090,34 @@ Open(FreeImageIO *io, fi_handle handle, BOOL read) {
 	return fio;
 }
 
+/**
+Open an existing TIFF for appending new directories.<br>
+Directories written with Save are linked after the last directory of the file, 
+existing directories and image data are left untouched. 
+The handle must be readable and writable.
+*/
+static void * DLL_CALLCONV
+Append(FreeImageIO *io, fi_handle handle) {
+	// wrapper for TIFF I/O
+	fi_TIFFIO *fio = (fi_TIFFIO*)malloc(sizeof(fi_TIFFIO));
+	if (!fio) {
+		return NULL;
+	}
+	fio->io = io;
+	fio->handle = handle;
+	fio->thumbnailCount = 0;
+
+	// mode = "a"	: append to Classic or Big TIFF (as found in the file header)
+	fio->tif = TIFFFdOpen((thandle_t)fio, "", "a");
+
+	if(fio->tif == NULL) {
+		free(fio);
+		FreeImage_OutputMessageProc(s_format_id, "Error while opening TIFF for appending: data is invalid");
+		return NULL;
+	}
+	return fio;
+}
+
 static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
 	if(data) {
@@ -2811,4 +2839,5 @@ InitTIFF(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels; 
+	plugin->append_proc = Append;
 }
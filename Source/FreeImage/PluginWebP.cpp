@@ -27,6 +27,8 @@
 #include "../LibWebP/src/webp/decode.h"
 #include "../LibWebP/src/webp/encode.h"
 #include "../LibWebP/src/webp/mux.h"
+#include "../LibWebP/src/webp/demux.h"
+#include "../LibWebP/src/webp/format_constants.h"
 
 // ==========================================================
 // Plugin Interface
@@ -34,6 +36,51 @@
 
 static int s_format_id;
 
+/// default duration of an animation frame without FrameTime metadata, in ms
+static const LONG WEBP_DEFAULT_FRAME_TIME = 100;
+
+/**
+Plugin data, created by Open. 
+Reading: still images are decoded incrementally, straight from the input stream. 
+Animations are read into memory and indexed (demuxed) on the first access to a page; 
+their frames are rendered by a WebPAnimDecoder which is kept from one call to the next, 
+so that sequential access decodes each frame once. 
+Writing: page -1 is saved as a still image, pages >= 0 are added to a WebPAnimEncoder 
+and the animation is written by Close.
+*/
+struct WebPContext {
+	BOOL read;
+	//! stream position of the RIFF header (reading)
+	long start_pos;
+	//! whole file, read on the first access to the animation frames
+	WebPData bitstream;
+	//! frame index
+	WebPDemuxer *demux;
+	//! frame renderer, created on the first frame load
+	WebPAnimDecoder *decoder;
+	//! index of the frame the decoder renders next
+	int next_frame;
+	//! still image, or metadata chunks of an animation (writing)
+	WebPMux *mux;
+	//! animation encoder, created by the first frame (writing)
+	WebPAnimEncoder *encoder;
+	//! animation size, set by the first frame (writing)
+	int canvas_width, canvas_height;
+	//! start time of the next frame, in ms (writing)
+	int timestamp;
+
+	WebPContext() : read(FALSE), start_pos(0), demux(NULL), decoder(NULL), next_frame(0), mux(NULL), encoder(NULL), canvas_width(0), canvas_height(0), timestamp(0) {
+		WebPDataInit(&bitstream);
+	}
+	~WebPContext() {
+		WebPAnimDecoderDelete(decoder);
+		WebPDemuxDelete(demux);
+		WebPDataClear(&bitstream);
+		WebPAnimEncoderDelete(encoder);
+		WebPMuxDelete(mux);
+	}
+};
+
 // ----------------------------------------------------------
 //   Helpers for the load function
 // ----------------------------------------------------------
@@ -109,6 +156,325 @@ WebP_MemoryWriter(const BYTE *data, size_t data_size, const WebPPicture* const p
 	return data_size ? (FreeImage_WriteMemory(data, 1, (unsigned)data_size, hmem) == data_size) : 0;
 }
 
+/**
+Set the encoding parameters from the FreeImage save flags
+@param config Coding parameters
+@param picture Input buffer, set to ARGB for lossless encoding
+@param flags FreeImage save flags
+*/
+static void
+SetEncoderConfig(WebPConfig *config, WebPPicture *picture, int flags) {
+	// Initialize encoding parameters to default values
+	if(!WebPConfigInit(config)) {
+		throw "Library version mismatch";
+	}
+
+	// quality/speed trade-off (0=fast, 6=slower-better)
+	config->method = 6;
+
+	if((flags & WEBP_LOSSLESS) == WEBP_LOSSLESS) {
+		// lossless encoding
+		config->lossless = 1;
+		picture->use_argb = 1;
+		// presets trade the compression effort (method and quality) for speed
+		if((flags & WEBP_FAST) == WEBP_FAST) {
+			WebPConfigLosslessPreset(config, 1);
+		} else if((flags & WEBP_BEST) == WEBP_BEST) {
+			WebPConfigLosslessPreset(config, 9);
+		}
+	} else {
+		if((flags & 0x7F) > 0) {
+			// lossy encoding
+			config->lossless = 0;
+			// quality is between 1 (smallest file) and 100 (biggest) - default to 75
+			config->quality = (float)(flags & 0x7F);
+			if(config->quality > 100) {
+				config->quality = 100;
+			}
+		}
+		if((flags & WEBP_FAST) == WEBP_FAST) {
+			config->method = 2;
+		} else if((flags & WEBP_BEST) == WEBP_BEST) {
+			config->pass = 10;
+			config->autofilter = 1;
+		}
+	}
+
+	// fast encoding is worth all the cores
+	if((flags & (WEBP_FAST | WEBP_MULTITHREAD)) != 0) {
+		config->thread_level = 1;
+	}
+	if((flags & WEBP_LOW_MEMORY) == WEBP_LOW_MEMORY) {
+		config->low_memory = 1;
+	}
+
+	// explicit settings override the presets
+	if((flags >> 16) & 0x7) {
+		config->method = ((flags >> 16) & 0x7) - 1;
+	}
+	if((flags >> 20) & 0xF) {
+		config->pass = (flags >> 20) & 0xF;
+	}
+	if((flags >> 24) & 0x7) {
+		config->segments = (flags >> 24) & 0x7;
+	}
+
+	// validate encoding parameters
+	if(WebPValidateConfig(config) == 0) {
+		throw "Failed to initialize encoder";
+	}
+}
+
+/**
+Import the pixels of a 24- or 32-bit dib into a picture. 
+The dib is bottom-up, so the import starts on its last scanline and uses a negative stride.
+@param picture Input buffer, whose size must be the dib size
+@param dib Image to import
+@return Returns TRUE if successful, FALSE otherwise
+*/
+static BOOL
+ImportPicture(WebPPicture *picture, FIBITMAP *dib) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	const BYTE *bits = FreeImage_GetScanLine(dib, height - 1);
+	const int stride = -(int)FreeImage_GetPitch(dib);
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	return (FreeImage_GetBPP(dib) == 32) ? WebPPictureImportBGRA(picture, bits, stride) : WebPPictureImportBGR(picture, bits, stride);
+#else
+	return (FreeImage_GetBPP(dib) == 32) ? WebPPictureImportRGBA(picture, bits, stride) : WebPPictureImportRGB(picture, bits, stride);
+#endif // FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+}
+
+/**
+Store the ICC profile, XMP and Exif metadata of a dib as mux chunks
+@return Returns WEBP_MUX_OK if successful, an error code otherwise
+*/
+static WebPMuxError
+SetMuxMetadata(WebPMux *mux, FIBITMAP *dib) {
+	const int copy_data = 1;	// 1 : copy data into the mux, 0 : keep a link to local data
+
+	// set ICC color profile
+	{
+		FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
+		if (iccProfile->size && iccProfile->data) {
+			WebPData icc_profile;
+			icc_profile.bytes = (uint8_t*)iccProfile->data;
+			icc_profile.size = (size_t)iccProfile->size;
+			WebPMuxError error_status = WebPMuxSetChunk(mux, "ICCP", &icc_profile, copy_data);
+			if(error_status != WEBP_MUX_OK) {
+				return error_status;
+			}
+		}
+	}
+
+	// set XMP metadata
+	{
+		FITAG *tag = NULL;
+		if(FreeImage_GetMetadata(FIMD_XMP, dib, g_TagLib_XMPFieldName, &tag)) {
+			WebPData xmp_profile;
+			xmp_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
+			xmp_profile.size = (size_t)FreeImage_GetTagLength(tag);
+			WebPMuxError error_status = WebPMuxSetChunk(mux, "XMP ", &xmp_profile, copy_data);
+			if(error_status != WEBP_MUX_OK) {
+				return error_status;
+			}
+		}
+	}
+
+	// set Exif metadata
+	{
+		FITAG *tag = NULL;
+		if(FreeImage_GetMetadata(FIMD_EXIF_RAW, dib, g_TagLib_ExifRawFieldName, &tag)) {
+			WebPData exif_profile;
+			exif_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
+			exif_profile.size = (size_t)FreeImage_GetTagLength(tag);
+			WebPMuxError error_status = WebPMuxSetChunk(mux, "EXIF", &exif_profile, copy_data);
+			if(error_status != WEBP_MUX_OK) {
+				return error_status;
+			}
+		}
+	}
+
+	return WEBP_MUX_OK;
+}
+
+/**
+Assemble the frames added to the animation encoder and write the animation, 
+with the metadata chunks of its first frame
+@param io FreeImage IO functions
+@param handle FreeImage IO handle
+@param context Plugin data
+*/
+static void
+WriteAnimation(FreeImageIO *io, fi_handle handle, WebPContext *context) {
+	typedef unique_ptr<WebPData, void(*)(WebPData*)> unique_webpdata;
+
+	// the last frame lasts until the end timestamp
+	if(!WebPAnimEncoderAdd(context->encoder, NULL, context->timestamp, NULL)) {
+		throw WebPAnimEncoderGetError(context->encoder);
+	}
+
+	WebPData anim_data;
+	WebPDataInit(&anim_data);
+	unique_webpdata anim_data_storage(&anim_data, &WebPDataClear);
+	if(!WebPAnimEncoderAssemble(context->encoder, &anim_data)) {
+		throw WebPAnimEncoderGetError(context->encoder);
+	}
+
+	WebPData output_data;
+	WebPDataInit(&output_data);
+	unique_webpdata output_data_storage(&output_data, &WebPDataClear);
+
+	// add the metadata chunks, if any
+	static const char *chunk_ids[] = { "ICCP", "XMP ", "EXIF" };
+	WebPMux *mux = NULL;
+	for(int i = 0; i < 3; i++) {
+		WebPData chunk;
+		if(WebPMuxGetChunk(context->mux, chunk_ids[i], &chunk) == WEBP_MUX_OK) {
+			if(!mux) {
+				mux = WebPMuxCreate(&anim_data, 0);
+				if(!mux) {
+					throw "Failed to create mux object from animation";
+				}
+			}
+			if(WebPMuxSetChunk(mux, chunk_ids[i], &chunk, 1) != WEBP_MUX_OK) {
+				WebPMuxDelete(mux);
+				throw "Failed to set animation metadata";
+			}
+		}
+	}
+	const WebPData *data = &anim_data;
+	if(mux) {
+		WebPMuxError error_status = WebPMuxAssemble(mux, &output_data);
+		WebPMuxDelete(mux);
+		if(error_status != WEBP_MUX_OK) {
+			throw "Failed to create webp output file";
+		}
+		data = &output_data;
+	}
+
+	// write the file to the output stream
+	if(io->write_proc((void*)data->bytes, 1, (unsigned)data->size, handle) != data->size) {
+		throw "Failed to write webp output file";
+	}
+}
+
+/**
+Write a little-endian value of a WebP container field
+*/
+static inline void
+PutLE(BYTE *dst, unsigned value, int size) {
+	for(int i = 0; i < size; i++) {
+		dst[i] = (BYTE)(value >> (8 * i));
+	}
+}
+
+static inline void
+WriteBytes(FreeImageIO *io, fi_handle handle, const void *data, size_t size) {
+	if(io->write_proc((void*)data, 1, (unsigned)size, handle) != size) {
+		throw "Failed to write webp output file";
+	}
+}
+
+/**
+Write a still WebP bitstream as a one-frame animation.<br>
+The mux and the animation encoder both turn single frame animations into still images, 
+so the container is rebuilt here: the image chunks are wrapped into an ANMF chunk, 
+and a VP8X chunk with the animation flag is followed by an ANIM chunk.
+@param io FreeImage IO functions
+@param handle FreeImage IO handle
+@param still Assembled still image, with its metadata chunks
+@param dib Source image
+@param duration Frame duration, in ms
+@param loop_count Animation loop count (0 = infinite)
+*/
+static void
+WriteSingleFrameAnimation(FreeImageIO *io, fi_handle handle, const WebPData *still, FIBITMAP *dib, int duration, int loop_count) {
+	const BYTE *bytes = still->bytes;
+	const size_t size = still->size;
+
+	if((size < RIFF_HEADER_SIZE) || memcmp(bytes, "RIFF", TAG_SIZE) || memcmp(bytes + 8, "WEBP", TAG_SIZE)) {
+		throw "Invalid webp bitstream";
+	}
+
+	// locate the image chunks (ALPH, VP8, VP8L) and skip the VP8X chunk, if any
+	BYTE vp8x_flags = ANIMATION_FLAG;
+	size_t head_begin = RIFF_HEADER_SIZE;
+	size_t image_begin = 0;
+	size_t image_end = 0;
+	for(size_t pos = RIFF_HEADER_SIZE; pos + CHUNK_HEADER_SIZE <= size; ) {
+		const BYTE *chunk = bytes + pos;
+		const size_t payload_size = (size_t)chunk[4] | ((size_t)chunk[5] << 8) | ((size_t)chunk[6] << 16) | ((size_t)chunk[7] << 24);
+		const size_t disk_size = CHUNK_HEADER_SIZE + payload_size + (payload_size & 1);
+		if(pos + disk_size > size) {
+			throw "Invalid webp bitstream";
+		}
+		if(!memcmp(chunk, "VP8X", TAG_SIZE)) {
+			vp8x_flags |= chunk[CHUNK_HEADER_SIZE] & (ICCP_FLAG | ALPHA_FLAG | EXIF_FLAG | XMP_FLAG);
+			head_begin = pos + disk_size;
+		}
+		else if(!memcmp(chunk, "ALPH", TAG_SIZE) || !memcmp(chunk, "VP8 ", TAG_SIZE) || !memcmp(chunk, "VP8L", TAG_SIZE)) {
+			if(image_end == 0) {
+				image_begin = pos;
+			}
+			image_end = pos + disk_size;
+		}
+		pos += disk_size;
+	}
+	if(image_end == 0) {
+		throw "Invalid webp bitstream";
+	}
+	if(FreeImage_GetBPP(dib) == 32) {
+		vp8x_flags |= ALPHA_FLAG;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const size_t head_size = image_begin - head_begin;
+	const size_t image_size = image_end - image_begin;
+	const size_t tail_size = size - image_end;
+	const size_t riff_size = TAG_SIZE 
+		+ CHUNK_HEADER_SIZE + VP8X_CHUNK_SIZE + head_size 
+		+ CHUNK_HEADER_SIZE + ANIM_CHUNK_SIZE 
+		+ CHUNK_HEADER_SIZE + ANMF_CHUNK_SIZE + image_size 
+		+ tail_size;
+
+	BYTE riff[RIFF_HEADER_SIZE];
+	memcpy(riff, "RIFF", TAG_SIZE);
+	PutLE(riff + 4, (unsigned)riff_size, 4);
+	memcpy(riff + 8, "WEBP", TAG_SIZE);
+
+	BYTE vp8x[CHUNK_HEADER_SIZE + VP8X_CHUNK_SIZE] = { 0 };
+	memcpy(vp8x, "VP8X", TAG_SIZE);
+	PutLE(vp8x + 4, VP8X_CHUNK_SIZE, 4);
+	vp8x[CHUNK_HEADER_SIZE] = vp8x_flags;
+	PutLE(vp8x + CHUNK_HEADER_SIZE + 4, width - 1, 3);
+	PutLE(vp8x + CHUNK_HEADER_SIZE + 7, height - 1, 3);
+
+	BYTE anim[CHUNK_HEADER_SIZE + ANIM_CHUNK_SIZE];
+	memcpy(anim, "ANIM", TAG_SIZE);
+	PutLE(anim + 4, ANIM_CHUNK_SIZE, 4);
+	PutLE(anim + CHUNK_HEADER_SIZE, 0xFFFFFFFF, 4);	// background color
+	PutLE(anim + CHUNK_HEADER_SIZE + 4, (unsigned)MIN(MAX(loop_count, 0), MAX_LOOP_COUNT - 1), 2);
+
+	BYTE anmf[CHUNK_HEADER_SIZE + ANMF_CHUNK_SIZE] = { 0 };
+	memcpy(anmf, "ANMF", TAG_SIZE);
+	PutLE(anmf + 4, (unsigned)(ANMF_CHUNK_SIZE + image_size), 4);
+	// frame offset is (0, 0)
+	PutLE(anmf + CHUNK_HEADER_SIZE + 6, width - 1, 3);
+	PutLE(anmf + CHUNK_HEADER_SIZE + 9, height - 1, 3);
+	PutLE(anmf + CHUNK_HEADER_SIZE + 12, (unsigned)MIN(MAX(duration, 0), MAX_DURATION - 1), 3);
+	anmf[CHUNK_HEADER_SIZE + 15] = 0x02;	// do not blend, do not dispose
+
+	WriteBytes(io, handle, riff, sizeof(riff));
+	WriteBytes(io, handle, vp8x, sizeof(vp8x));
+	WriteBytes(io, handle, bytes + head_begin, head_size);
+	WriteBytes(io, handle, anim, sizeof(anim));
+	WriteBytes(io, handle, anmf, sizeof(anmf));
+	WriteBytes(io, handle, bytes + image_begin, image_size);
+	WriteBytes(io, handle, bytes + image_end, tail_size);
+}
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -182,299 +548,559 @@ SupportsNoPixels() {
 
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, BOOL read) {
-	WebPMux *mux = NULL;
+	WebPContext *context = new(std::nothrow) WebPContext;
+	if(!context) {
+		return NULL;
+	}
+
+	context->read = read;
 
-	if(! read) {
+	if(read) {
+		// frames are indexed on the first access, single image loads do not need it
+		context->start_pos = io->tell_proc(handle);
+	} else {
 		// creates an empty mux object
-		mux = WebPMuxNew();
-		if(mux == NULL) {
+		context->mux = WebPMuxNew();
+		if(context->mux == NULL) {
 			FreeImage_OutputMessageProc(s_format_id, "Failed to create empty mux object");
+			delete context;
 			return NULL;
 		}
 	}
 	
-	return mux;
+	return context;
 }
 
 static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
-	WebPMux *mux = (WebPMux*)data;
-	if(mux != NULL) {
-		// free the MUX object
-		WebPMuxDelete(mux);
+	WebPContext *context = (WebPContext*)data;
+	if(context == NULL) {
+		return;
+	}
+
+	if(!context->read && context->encoder) {
+		try {
+			WriteAnimation(io, handle, context);
+		} catch(const char *text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+
+	delete context;
+}
+
+/**
+Read the whole file and index its frames, on the first call
+*/
+static void
+IndexFrames(FreeImageIO *io, fi_handle handle, WebPContext *context) {
+	if(context->demux) {
+		return;
+	}
+
+	io->seek_proc(handle, context->start_pos, SEEK_SET);
+	FIProgress progress(0, NULL, FI_OP_LOAD, s_format_id);
+	ReadFileToWebPData(io, handle, &context->bitstream, progress);
+
+	context->demux = WebPDemux(&context->bitstream);
+	if(!context->demux) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+}
+
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	WebPContext *context = (WebPContext*)data;
+	if((context == NULL) || !context->read) {
+		return 0;
+	}
+
+	try {
+		IndexFrames(io, handle, context);
+
+		return (int)WebPDemuxGetI(context->demux, WEBP_FF_FRAME_COUNT);
+
+	} catch(const char *text) {
+		FreeImage_OutputMessageProc(s_format_id, text);
+		return 0;
 	}
 }
 
 // ----------------------------------------------------------
 
+/// size of the pieces read from the input stream by the incremental decoder
+static const size_t WEBP_READ_SIZE = 64 * 1024;
+
 /**
-Decode a WebP image and returns a FIBITMAP image
-@param webp_image Raw WebP image
-@param flags FreeImage load flags
-@return Returns a dib if successfull, returns NULL otherwise
+Read a little-endian 32-bit value from a RIFF header
 */
-static FIBITMAP *
-DecodeImage(WebPData *webp_image, const FreeImageLoadArgs* args, FIProgress& progress) {
-	FIBITMAP *dib = NULL;
+static inline uint32_t 
+GetLE32(const BYTE *data) {
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
 
-	const uint8_t* data = webp_image->bytes;	// raw image data
-	const size_t data_size = webp_image->size;	// raw image size
+/**
+Get the WebP specific load arguments, if any
+*/
+static const FreeImageWebPLoadArgs*
+GetWebPLoadArgs(const FreeImageLoadArgs* args) {
+	const FreeImageWebPLoadArgs *webp_args = (const FreeImageWebPLoadArgs*)args->more;
+	if(webp_args && (webp_args->format != s_format_id)) {
+		// arguments meant for another format
+		return NULL;
+	}
+	return webp_args;
+}
 
-  VP8StatusCode webp_status = VP8_STATUS_OK;
+/**
+Set the decoding options from the load arguments and compute the size of the output image. 
+Cropping is applied first, then scaling (to the FreeImageWebPLoadArgs size or to the requested size). 
+@param config Decoder configuration, whose input features must have been filled
+@param args FreeImage load arguments
+@param width On return, output image width
+@param height On return, output image height
+*/
+static void
+SetDecoderOptions(WebPDecoderConfig *config, const FreeImageLoadArgs* args, int *width, int *height) {
+	WebPDecoderOptions *options = &config->options;
 
-	BOOL header_only = (args->flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+	const FreeImageWebPLoadArgs *webp_args = GetWebPLoadArgs(args);
 
-	// Main object storing the configuration for advanced decoding
-	WebPDecoderConfig decoder_config;
-	// Output buffer
-	WebPDecBuffer* const output_buffer = &decoder_config.output;
-	// Features gathered from the bitstream
-	WebPBitstreamFeatures* const bitstream = &decoder_config.input;
+	*width = config->input.width;
+	*height = config->input.height;
 
-	unique_ptr<WebPDecBuffer, void(*)(WebPDecBuffer*)> output_buffer_storage(output_buffer, &WebPFreeDecBuffer);
+	// use multi-threaded decoding unless told otherwise
+	options->use_threads = (webp_args && (webp_args->threads == 1)) ? 0 : 1;
 
-	// Initialize the configuration as empty
-	// This function must always be called first, unless WebPGetFeatures() is to be called
-	if(!WebPInitDecoderConfig(&decoder_config)) {
-		throw "Library version mismatch";
-	}
+	if(webp_args) {
+		options->bypass_filtering = webp_args->bypass_filtering ? 1 : 0;
+		options->no_fancy_upsampling = webp_args->no_fancy_upsampling ? 1 : 0;
 
-	// Retrieve features from the bitstream
-	// The bitstream structure is filled with information gathered from the bitstream
-	webp_status = WebPGetFeatures(data, data_size, bitstream);
-	if(webp_status != VP8_STATUS_OK) {
-		throw FI_MSG_ERROR_PARSING;
+		if((webp_args->width > 0) && (webp_args->height > 0)) {
+			if((webp_args->left < 0) || (webp_args->top < 0) || (webp_args->left + webp_args->width > *width) || (webp_args->top + webp_args->height > *height)) {
+				throw "Invalid crop rectangle";
+			}
+			options->use_cropping = 1;
+			options->crop_left = webp_args->left;
+			options->crop_top = webp_args->top;
+			options->crop_width = webp_args->width;
+			options->crop_height = webp_args->height;
+			*width = webp_args->width;
+			*height = webp_args->height;
+		}
 	}
 
-	// Allocate output dib
+	int scaled_width = webp_args ? webp_args->scaled_width : 0;
+	int scaled_height = webp_args ? webp_args->scaled_height : 0;
 
-	const unsigned bpp = bitstream->has_alpha ? 32 : 24;	
-	const unsigned width = (unsigned)bitstream->width;
-	const unsigned height = (unsigned)bitstream->height;
+	if((scaled_width <= 0) && (scaled_height <= 0)) {
+		// downscale the larger side to the requested size, if any
+		const int requested_size = (int)(args->option & 0xFFFF);
+		if((requested_size > 0) && (MAX(*width, *height) > requested_size)) {
+			if(*width >= *height) {
+				scaled_width = requested_size;
+			} else {
+				scaled_height = requested_size;
+			}
+		}
+	}
+	if((scaled_width > 0) || (scaled_height > 0)) {
+		// a single missing dimension keeps the aspect ratio
+		if(scaled_width <= 0) {
+			scaled_width = MAX(1, (int)((double)*width * scaled_height / *height + 0.5));
+		} else if(scaled_height <= 0) {
+			scaled_height = MAX(1, (int)((double)*height * scaled_width / *width + 0.5));
+		}
+		options->use_scaling = 1;
+		options->scaled_width = scaled_width;
+		options->scaled_height = scaled_height;
+		*width = scaled_width;
+		*height = scaled_height;
+	}
+}
 
-	dib = FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+/**
+Allocate the output dib and make the decoder write straight into it. 
+The dib is bottom-up, so the output buffer starts on its last scanline and uses a negative stride. 
+@param config Decoder configuration, whose input features must have been filled
+@param width Output image width
+@param height Output image height
+@param header_only If TRUE, allocate the header only
+@return Returns the dib
+*/
+static FIBITMAP *
+AllocateOutput(WebPDecoderConfig *config, int width, int height, BOOL header_only) {
+	const unsigned bpp = config->input.has_alpha ? 32 : 24;
+
+	FIBITMAP *dib = FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if(!dib) {
 		throw FI_MSG_ERROR_DIB_MEMORY;
 	}
 
-	if(header_only) {
-		return dib;
+	if(!header_only) {
+		WebPDecBuffer* const output_buffer = &config->output;
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		output_buffer->colorspace = config->input.has_alpha ? MODE_BGRA : MODE_BGR;
+#else
+		output_buffer->colorspace = config->input.has_alpha ? MODE_RGBA : MODE_RGB;
+#endif
+		const unsigned pitch = FreeImage_GetPitch(dib);
+
+		output_buffer->is_external_memory = 1;
+		output_buffer->u.RGBA.rgba = FreeImage_GetScanLine(dib, height - 1);
+		output_buffer->u.RGBA.stride = -(int)pitch;
+		output_buffer->u.RGBA.size = (size_t)pitch * height;
 	}
 
-	unique_dib dib_storage(dib);
+	return dib;
+}
 
-	// --- Set decoding options ---
+/**
+Attach the ICC profile, XMP and Exif metadata chunks to a dib
+*/
+static void
+SetMetadata(FIBITMAP *dib, const WebPData *color_profile, const WebPData *xmp_metadata, const WebPData *exif_metadata) {
+	// ICC profile
+	if(color_profile && color_profile->size) {
+		FreeImage_CreateICCProfile(dib, (void*)color_profile->bytes, (long)color_profile->size);
+	}
 
-	// use multi-threaded decoding
-	// @todo let user control threading
-	decoder_config.options.use_threads = 1;
-	// set output color space
-	output_buffer->colorspace = bitstream->has_alpha ? MODE_BGRA : MODE_BGR;
+	// XMP metadata
+	if(xmp_metadata && xmp_metadata->size) {
+		// create a tag
+		FITAG *tag = FreeImage_CreateTag();
+		if(tag) {
+			FreeImage_SetTagKey(tag, g_TagLib_XMPFieldName);
+			FreeImage_SetTagLength(tag, (DWORD)xmp_metadata->size);
+			FreeImage_SetTagCount(tag, (DWORD)xmp_metadata->size);
+			FreeImage_SetTagType(tag, FIDT_ASCII);
+			FreeImage_SetTagValue(tag, xmp_metadata->bytes);
+
+			// store the tag
+			FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag), tag);
+
+			// destroy the tag
+			FreeImage_DeleteTag(tag);
+		}
+	}
 
-	if(! progress.callback()) {
+	// Exif metadata
+	if(exif_metadata && exif_metadata->size) {
+		// read the Exif raw data as a blob
+		jpeg_read_exif_profile_raw(dib, exif_metadata->bytes, (unsigned)exif_metadata->size);
+		// read and decode the Exif data
+		jpeg_read_exif_profile(dib, exif_metadata->bytes, (unsigned)exif_metadata->size);
+	}
+}
 
-		// decode the input stream, taking 'config' into account. 
+/**
+Load a still WebP image incrementally, straight from the input stream. 
+The RIFF chunks are walked as they are read: the image chunks are fed to a WebPIDecoder 
+in WEBP_READ_SIZE pieces (the file is never buffered as a whole) and the metadata chunks are kept. 
+Once the image is decoded, or its header is known in header only mode, the remaining image data is skipped. 
+@param io FreeImage IO functions
+@param handle FreeImage IO handle
+@param args FreeImage load arguments
+@param progress Progress reporter
+@param is_animation On return, TRUE if the file is an animation, which must be loaded through the mux instead
+@return Returns a dib if successfull, returns NULL if the file is an animation or if the load was canceled, throws an exception otherwise
+*/
+static FIBITMAP *
+LoadIncremental(FreeImageIO *io, fi_handle handle, const FreeImageLoadArgs* args, FIProgress& progress, BOOL *is_animation) {
+	BOOL header_only = (args->flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-		webp_status = WebPDecode(data, data_size, &decoder_config);
-		if(webp_status != VP8_STATUS_OK) {
-			throw FI_MSG_ERROR_PARSING;
-		}
+	*is_animation = FALSE;
+
+	const long start_pos = io->tell_proc(handle);
+	io->seek_proc(handle, 0, SEEK_END);
+	const long end_pos = io->tell_proc(handle);
+	io->seek_proc(handle, start_pos, SEEK_SET);
 
-		// fill the dib with the decoded data
-		// @todo use external memory
+	// RIFF header
+	BYTE riff_header[RIFF_HEADER_SIZE];
+	if(io->read_proc(riff_header, 1, RIFF_HEADER_SIZE, handle) != RIFF_HEADER_SIZE) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+	if((memcmp(riff_header, "RIFF", TAG_SIZE) != 0) || (memcmp(riff_header + CHUNK_HEADER_SIZE, "WEBP", TAG_SIZE) != 0)) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+	const long riff_end = MIN(end_pos, start_pos + CHUNK_HEADER_SIZE + (long)GetLE32(riff_header + TAG_SIZE));
 
-		const BYTE* src_bitmap = output_buffer->u.RGBA.rgba;
-		const unsigned src_pitch = (unsigned)output_buffer->u.RGBA.stride;
+	WebPDecoderConfig decoder_config;
+	if(!WebPInitDecoderConfig(&decoder_config)) {
+		throw "Library version mismatch";
+	}
+	unique_ptr<WebPDecBuffer, void(*)(WebPDecBuffer*)> output_buffer_storage(&decoder_config.output, &WebPFreeDecBuffer);
+	unique_ptr<WebPIDecoder, void(*)(WebPIDecoder*)> idec_storage(NULL, &WebPIDelete);
+	unique_dib dib_storage(NULL);
+
+	// bytes read until the image features are known
+	std::vector<BYTE> head(riff_header, riff_header + RIFF_HEADER_SIZE);
+	// extended format header and metadata chunks
+	std::vector<BYTE> vp8x_header, color_profile, xmp_metadata, exif_metadata;
+	
+	BOOL done = FALSE;	// TRUE when no more image data is needed
+
+	// feed the decoder with the next bytes of the stream
+	auto feed = [&](const BYTE *data, size_t size) {
+		if(!dib_storage) {
+			head.insert(head.end(), data, data + size);
+			VP8StatusCode status = WebPGetFeatures(head.data(), head.size(), &decoder_config.input);
+			if(status == VP8_STATUS_NOT_ENOUGH_DATA) {
+				return;
+			}
+			if(status != VP8_STATUS_OK) {
+				throw FI_MSG_ERROR_PARSING;
+			}
 
-		switch(bpp) {
-		case 24:
-			for(unsigned y = 0; y < height; y++) {
-				const BYTE* src_bits = src_bitmap + y * src_pitch;
-				BYTE* dst_bits = (BYTE*)FreeImage_GetScanLine(dib, height - 1 - y);
-				for(unsigned x = 0; x < width; x++) {
-					dst_bits[FI_RGBA_BLUE] = src_bits[0];	// B
-					dst_bits[FI_RGBA_GREEN] = src_bits[1];	// G
-					dst_bits[FI_RGBA_RED] = src_bits[2];	// R
-					src_bits += 3;
-					dst_bits += 3;
-				}
+			int width, height;
+			SetDecoderOptions(&decoder_config, args, &width, &height);
+			dib_storage.reset(AllocateOutput(&decoder_config, width, height, header_only));
+			if(header_only) {
+				done = TRUE;
+				return;
 			}
-			break;
-		case 32:
-			for(unsigned y = 0; y < height; y++) {
-				const BYTE* src_bits = src_bitmap + y * src_pitch;
-				BYTE* dst_bits = (BYTE*)FreeImage_GetScanLine(dib, height - 1 - y);
-				for(unsigned x = 0; x < width; x++) {
-					dst_bits[FI_RGBA_BLUE] = src_bits[0];	// B
-					dst_bits[FI_RGBA_GREEN] = src_bits[1];	// G
-					dst_bits[FI_RGBA_RED] = src_bits[2];	// R
-					dst_bits[FI_RGBA_ALPHA] = src_bits[3];	// A
-					src_bits += 4;
-					dst_bits += 4;
-				}
+
+			idec_storage.reset(WebPIDecode(NULL, 0, &decoder_config));
+			if(!idec_storage) {
+				throw "WebPIDecode creation failed";
 			}
-			break;
+			data = head.data();
+			size = head.size();
 		}
 
-	} else {
-		output_buffer->u.RGBA.size = FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
-		output_buffer->u.RGBA.rgba = FreeImage_GetBits(dib) + output_buffer->u.RGBA.size - FreeImage_GetPitch(dib);
-		output_buffer->u.RGBA.stride = -FreeImage_GetPitch(dib);
-		output_buffer->is_external_memory = 1;
+		VP8StatusCode status = WebPIAppend(idec_storage.get(), data, size);
+		if(status == VP8_STATUS_OK) {
+			done = TRUE;
+		} else if(status != VP8_STATUS_SUSPENDED) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+	};
 
-		WebPIDecoder* idec = WebPINewDecoder(output_buffer);
-		if(!idec)
-			throw "WebPINewDecoder creation failed";
-		unique_ptr<WebPIDecoder, void(*)(WebPIDecoder*)> idec_storage(idec, &WebPIDelete);
+	std::vector<BYTE> piece(WEBP_READ_SIZE);
 
-		const size_t line_size = width * (bpp / 8);
-		const size_t line_count = data_size / line_size;
-		const size_t leftover = data_size - (line_count * line_size);
+	long pos = start_pos + RIFF_HEADER_SIZE;
 
-		FIProgress::Step step = progress.getStepProgress(fi_progress_t(line_count) + (leftover ? 1 : 0), 1);
+	while(pos + CHUNK_HEADER_SIZE <= riff_end) {
+		BYTE chunk_header[CHUNK_HEADER_SIZE];
+		if(io->read_proc(chunk_header, 1, CHUNK_HEADER_SIZE, handle) != CHUNK_HEADER_SIZE) {
+			break;
+		}
+		const uint32_t chunk_size = GetLE32(chunk_header + TAG_SIZE);
+		const long disk_size = (long)MIN((uint32_t)(riff_end - pos - CHUNK_HEADER_SIZE), chunk_size + (chunk_size & 1));
+		
+		if(!done) {
+			feed(chunk_header, CHUNK_HEADER_SIZE);
+		}
 
-		uint8_t* begin = (uint8_t*)data;
-		uint8_t*const end = (uint8_t*)data + (line_count * line_size);
-		for(; begin != end; begin += line_size) {
-			// ... (get additional data in some new_data[] buffer)
-			VP8StatusCode status = WebPIAppend(idec, begin, line_size);
-			if(status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
-				throw FI_MSG_ERROR_PARSING;
-			}
-			// The above call decodes the current available buffer.
-			// Part of the image can now be refreshed by calling
-			// WebPIDecGetRGB()/WebPIDecGetYUVA() etc.
+		std::vector<BYTE> *kept = NULL;
+		if(memcmp(chunk_header, "VP8X", TAG_SIZE) == 0) {
+			kept = &vp8x_header;
+		} else if(memcmp(chunk_header, "ICCP", TAG_SIZE) == 0) {
+			kept = &color_profile;
+		} else if(memcmp(chunk_header, "XMP ", TAG_SIZE) == 0) {
+			kept = &xmp_metadata;
+		} else if(memcmp(chunk_header, "EXIF", TAG_SIZE) == 0) {
+			kept = &exif_metadata;
+		}
 
-			if(! step.progress()) {
+		if(kept) {
+			// keep the chunk, it is also part of the decoder input when it comes before the image data
+			kept->resize((size_t)disk_size);
+			if(disk_size && (io->read_proc(kept->data(), 1, (unsigned)disk_size, handle) != (unsigned)disk_size)) {
+				throw "Error while reading input stream";
+			}
+			if((kept == &vp8x_header) && !vp8x_header.empty() && (vp8x_header[0] & ANIMATION_FLAG)) {
+				// rewind for the caller
+				*is_animation = TRUE;
+				io->seek_proc(handle, start_pos, SEEK_SET);
 				return NULL;
 			}
-		}
-		if(leftover) {
-			VP8StatusCode status = WebPIAppend(idec, begin, leftover);
-			if(status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
-				throw FI_MSG_ERROR_PARSING;
+			if(!done) {
+				feed(kept->data(), kept->size());
 			}
+			kept->resize(MIN((size_t)chunk_size, kept->size()));
+		}
+		else if(!done) {
+			// image data (or an unknown chunk): stream it through the decoder
+			for(long remaining = disk_size; remaining > 0; ) {
+				const unsigned size = (unsigned)MIN((long)WEBP_READ_SIZE, remaining);
+				if(io->read_proc(piece.data(), 1, size, handle) != size) {
+					throw "Error while reading input stream";
+				}
+				remaining -= size;
 
-			if(! step.progress()) {
-				return NULL;
+				if(!done) {
+					feed(piece.data(), size);
+				}
+				if(progress.callback() && !progress.reportProgress((double)(pos + disk_size - remaining - start_pos) / (end_pos - start_pos))) {
+					return NULL;
+				}
 			}
 		}
+		else {
+			// image data no longer needed
+			io->seek_proc(handle, disk_size, SEEK_CUR);
+		}
+
+		pos += CHUNK_HEADER_SIZE + disk_size;
 	}
 
-		
-		return dib_storage.release();
+	if(!dib_storage || !done) {
+		// truncated stream
+		throw FI_MSG_ERROR_PARSING;
+	}
+
+	const WebPData chunk_data[3] = {
+		{ color_profile.data(), color_profile.size() },
+		{ xmp_metadata.data(), xmp_metadata.size() },
+		{ exif_metadata.data(), exif_metadata.size() }
+	};
+	SetMetadata(dib_storage.get(), &chunk_data[0], &chunk_data[1], &chunk_data[2]);
+
+	return dib_storage.release();
 }
 
-static FIBITMAP * DLL_CALLCONV
-LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* args, void *data) {
+/**
+Load a frame of an animation, as a 32-bit image of the canvas size. 
+Frames are rendered in sequence: the decoder of the previous call is reused when the frames are accessed 
+in increasing order and is only rewound when going back. 
+The first frame holds the Loop, LogicalWidth and LogicalHeight animation tags and the file metadata, 
+each frame holds its FrameTime (in ms). 
+@param io FreeImage IO functions
+@param handle FreeImage IO handle
+@param context Plugin data
+@param page Frame index
+@param args FreeImage load arguments
+@return Returns a dib if successfull, returns NULL if the page does not exist, throws an exception otherwise
+*/
+static FIBITMAP *
+LoadFrame(FreeImageIO *io, fi_handle handle, WebPContext *context, int page, const FreeImageLoadArgs* args) {
+	BOOL header_only = (args->flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-	WebPMux *mux;
-	WebPMuxFrameInfo webp_frame = { 0 };	// raw image
-	WebPData color_profile;	// ICC raw data
-	WebPData xmp_metadata;	// XMP raw data
-	WebPData exif_metadata;	// EXIF raw data
-	FIBITMAP *dib = NULL;
-	WebPMuxError error_status;
+	IndexFrames(io, handle, context);
 
-	if(!handle) {
+	WebPDemuxer *demux = context->demux;
+	if(page >= (int)WebPDemuxGetI(demux, WEBP_FF_FRAME_COUNT)) {
 		return NULL;
 	}
+	const unsigned canvas_width = WebPDemuxGetI(demux, WEBP_FF_CANVAS_WIDTH);
+	const unsigned canvas_height = WebPDemuxGetI(demux, WEBP_FF_CANVAS_HEIGHT);
 
-	try {
-		FIProgress progress(args->cbOption, args->cb, FI_OP_LOAD, s_format_id);
-		if(progress.isCanceled()) {
-			return NULL;
-		}
-
-		typedef unique_ptr<WebPData, void(*)(WebPData*)> unique_webpdata;
+	unique_dib dib_storage(FreeImage_AllocateHeader(header_only, canvas_width, canvas_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+	FIBITMAP *dib = dib_storage.get();
+	if(!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
 
-		// create the MUX object from the input stream
-		WebPData bitstream;
-		unique_webpdata bitstream_storage(&bitstream, &WebPDataClear);
-		// read the input file and put it in memory
-		ReadFileToWebPData(io, handle, &bitstream, progress);
+	if(!header_only) {
+		if(!context->decoder) {
+			WebPAnimDecoderOptions options;
+			if(!WebPAnimDecoderOptionsInit(&options)) {
+				throw "Library version mismatch";
+			}
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+			options.color_mode = MODE_BGRA;
+#else
+			options.color_mode = MODE_RGBA;
+#endif
+			const FreeImageWebPLoadArgs *webp_args = GetWebPLoadArgs(args);
+			options.use_threads = (webp_args && (webp_args->threads == 1)) ? 0 : 1;
 
-		if(progress.isCanceled()) { //< ReadFileToWebPData can cancel
-			return NULL;
+			context->decoder = WebPAnimDecoderNew(&context->bitstream, &options);
+			if(!context->decoder) {
+				throw FI_MSG_ERROR_PARSING;
+			}
+			context->next_frame = 0;
 		}
 
-		// create the MUX object
-		mux = WebPMuxCreate(&bitstream, 0);
-
-		if(mux == NULL) {
-			FreeImage_OutputMessageProcCB(args->cb, s_format_id, "Failed to create mux object from file");
-			return NULL;
+		if(page < context->next_frame) {
+			// going back: render again from the first frame
+			WebPAnimDecoderReset(context->decoder);
+			context->next_frame = 0;
 		}
-		unique_ptr<WebPMux, void(*)(WebPMux*)> mux_storage(mux, &WebPMuxDelete);
 
-		// gets the feature flags from the mux object
-		uint32_t webp_flags = 0;
-		error_status = WebPMuxGetFeatures(mux, &webp_flags);
-		if(error_status != WEBP_MUX_OK) {
-			throw "WebPMuxGetFeatures returned with an error";
+		uint8_t *canvas = NULL;
+		int timestamp = 0;
+		while(context->next_frame <= page) {
+			if(!WebPAnimDecoderGetNext(context->decoder, &canvas, &timestamp)) {
+				context->next_frame = INT_MAX;	//< force a reset on the next call
+				throw FI_MSG_ERROR_PARSING;
+			}
+			context->next_frame++;
 		}
 
-		// get image data
-		error_status = WebPMuxGetFrame(mux, 1, &webp_frame);
-		if(error_status != WEBP_MUX_OK) {
-			throw "WebPMuxGetFrame returned with an error";
+		// the canvas is top-down
+		const size_t line = (size_t)canvas_width * 4;
+		for(unsigned y = 0; y < canvas_height; y++) {
+			memcpy(FreeImage_GetScanLine(dib, canvas_height - 1 - y), canvas + y * line, line);
 		}
-		unique_webpdata output_buffer_storage(&webp_frame.bitstream, &WebPDataClear);
+	}
 
-		// decode the data (can be limited to the header if flags uses FIF_LOAD_NOPIXELS)
-		dib = DecodeImage(&webp_frame.bitstream, args, progress);
+	// frame duration
+	WebPIterator iter;
+	if(WebPDemuxGetFrame(demux, page + 1, &iter)) {
+		LONG frame_time = iter.duration;
+		SetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &frame_time);
+		WebPDemuxReleaseIterator(&iter);
+	}
 
-		if(progress.isCanceled()) { //< DecodeImage can cancel
-			return NULL;
-		}
-		
-		// get ICC profile
-		if(webp_flags & ICCP_FLAG) {
-			error_status = WebPMuxGetChunk(mux, "ICCP", &color_profile);
-			if(error_status == WEBP_MUX_OK) {
-				FreeImage_CreateICCProfile(dib, (void*)color_profile.bytes, (long)color_profile.size);
+	if(page == 0) {
+		// animation parameters
+		WORD logical_width = (WORD)canvas_width;
+		WORD logical_height = (WORD)canvas_height;
+		LONG loop = (LONG)WebPDemuxGetI(demux, WEBP_FF_LOOP_COUNT);
+		SetMetadataTag(FIMD_ANIMATION, dib, "LogicalWidth", ANIMTAG_LOGICALWIDTH, FIDT_SHORT, 1, 2, &logical_width);
+		SetMetadataTag(FIMD_ANIMATION, dib, "LogicalHeight", ANIMTAG_LOGICALHEIGHT, FIDT_SHORT, 1, 2, &logical_height);
+		SetMetadataTag(FIMD_ANIMATION, dib, "Loop", ANIMTAG_LOOP, FIDT_LONG, 1, 4, &loop);
+
+		// file metadata
+		WebPData chunks[3] = { { NULL, 0 }, { NULL, 0 }, { NULL, 0 } };
+		static const char *chunk_ids[] = { "ICCP", "XMP ", "EXIF" };
+		for(int i = 0; i < 3; i++) {
+			WebPChunkIterator chunk_iter;
+			if(WebPDemuxGetChunk(demux, chunk_ids[i], 1, &chunk_iter)) {
+				chunks[i] = chunk_iter.chunk;
+				WebPDemuxReleaseChunkIterator(&chunk_iter);
 			}
 		}
+		SetMetadata(dib, &chunks[0], &chunks[1], &chunks[2]);
+	}
 
-		// get XMP metadata
-		if(webp_flags & XMP_FLAG) {
-			error_status = WebPMuxGetChunk(mux, "XMP ", &xmp_metadata);
-			if(error_status != WEBP_MUX_OK) {
-				FreeImage_OutputMessageProcCB(args->cb, s_format_id, "Warning: XMP falied to load");
-			} else {
-				// create a tag
-				FITAG *tag = FreeImage_CreateTag();
-				if(tag) {
-					FreeImage_SetTagKey(tag, g_TagLib_XMPFieldName);
-					FreeImage_SetTagLength(tag, (DWORD)xmp_metadata.size);
-					FreeImage_SetTagCount(tag, (DWORD)xmp_metadata.size);
-					FreeImage_SetTagType(tag, FIDT_ASCII);
-					FreeImage_SetTagValue(tag, xmp_metadata.bytes);
-
-					// store the tag
-					FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag), tag);
-
-					// destroy the tag
-					FreeImage_DeleteTag(tag);
-				}
-			}
+	return dib_storage.release();
+}
+
+static FIBITMAP * DLL_CALLCONV
+LoadAdv(FreeImageIO *io, fi_handle handle, int page, const FreeImageLoadArgs* args, void *data) {
+	WebPContext *context = (WebPContext*)data;
+
+	if(!handle || !context) {
+		return NULL;
+	}
+
+	try {
+		FIProgress progress(args->cbOption, args->cb, FI_OP_LOAD, s_format_id);
+		if(progress.isCanceled()) {
+			return NULL;
 		}
 
-		// get Exif metadata
-		if(webp_flags & EXIF_FLAG) {
-			error_status = WebPMuxGetChunk(mux, "EXIF", &exif_metadata);
-			if(error_status != WEBP_MUX_OK) {
-				FreeImage_OutputMessageProcCB(args->cb, s_format_id, "Warning: EXIF falied to load");
-			} else {
-				// read the Exif raw data as a blob
-				jpeg_read_exif_profile_raw(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-				// read and decode the Exif data
-				jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
+		if(page <= 0) {
+			// still images are decoded straight from the input stream
+			if(page == 0) {
+				io->seek_proc(handle, context->start_pos, SEEK_SET);
 			}
+			BOOL is_animation = FALSE;
+			FIBITMAP *dib = LoadIncremental(io, handle, args, progress, &is_animation);
+			if(!is_animation) {
+				return dib;
+			}
+			page = 0;
 		}
 
+		// animation frames
+		return LoadFrame(io, handle, context, page, args);
 
-		return dib;
 	} catch(const char* text) {
 		FreeImage_OutputMessageProcCB(args->cb, s_format_id, text);
 		return NULL;
@@ -495,13 +1121,15 @@ EncodeImage(FIMEMORY *hmem, FIBITMAP *dib, int flags) {
 	WebPPicture picture;	// Input buffer
 	WebPConfig config;		// Coding parameters
 
-	BOOL bIsFlipped = FALSE;
+	if(WebPPictureInit(&picture) != 1) {
+		FreeImage_OutputMessageProc(s_format_id, "Couldn't initialize WebPPicture");
+		return FALSE;
+	}
 
 	try {
 		const unsigned width = FreeImage_GetWidth(dib);
 		const unsigned height = FreeImage_GetHeight(dib);
 		const unsigned bpp = FreeImage_GetBPP(dib);
-		const unsigned pitch = FreeImage_GetPitch(dib);
 
 		// check image type
 		FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -517,95 +1145,134 @@ EncodeImage(FIMEMORY *hmem, FIBITMAP *dib, int flags) {
 		}
 
 		// Initialize output I/O
-		if(WebPPictureInit(&picture) == 1) {
-			picture.writer = WebP_MemoryWriter;
-			picture.custom_ptr = hmem;
-			picture.width = (int)width;
-			picture.height = (int)height;
-		} else {
-			throw "Couldn't initialize WebPPicture";
-		}
+		picture.writer = WebP_MemoryWriter;
+		picture.custom_ptr = hmem;
+		picture.width = (int)width;
+		picture.height = (int)height;
 
 		// --- Set encoding parameters ---
 
-		// Initialize encoding parameters to default values
-		WebPConfigInit(&config);
+		SetEncoderConfig(&config, &picture, flags);
 
-		// quality/speed trade-off (0=fast, 6=slower-better)
-		config.method = 6;
+		// --- Perform encoding ---
 
-		if((flags & WEBP_LOSSLESS) == WEBP_LOSSLESS) {
-			// lossless encoding
-			config.lossless = 1;
-			picture.use_argb = 1;
-		} else if((flags & 0x7F) > 0) {
-			// lossy encoding
-			config.lossless = 0;
-			// quality is between 1 (smallest file) and 100 (biggest) - default to 75
-			config.quality = (float)(flags & 0x7F);
-			if(config.quality > 100) {
-				config.quality = 100;
-			}
+		// convert dib buffer to output stream
+		if(!ImportPicture(&picture, dib)) {
+			throw FI_MSG_ERROR_MEMORY;
 		}
 
-		// validate encoding parameters
-		if(WebPValidateConfig(&config) == 0) {
-			throw "Failed to initialize encoder";
+		if(!WebPEncode(&config, &picture)) {
+			throw "Failed to encode image";
 		}
 
-		// --- Perform encoding ---
-		
-		// Invert dib scanlines
-		bIsFlipped = FreeImage_FlipVertical(dib);
+		WebPPictureFree(&picture);
 
+		return TRUE;
 
-		// convert dib buffer to output stream
+	} catch (const char* text) {
 
-		const BYTE *bits = FreeImage_GetBits(dib);
+		WebPPictureFree(&picture);
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-		switch(bpp) {
-			case 24:
-				WebPPictureImportBGR(&picture, bits, pitch);
-				break;
-			case 32:
-				WebPPictureImportBGRA(&picture, bits, pitch);
-				break;
+		if(NULL != text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
 		}
-#else
-		switch(bpp) {
-			case 24:
-				WebPPictureImportRGB(&picture, bits, pitch);
-				break;
-			case 32:
-				WebPPictureImportRGBA(&picture, bits, pitch);
-				break;
+	}
+
+	return FALSE;
+}
+
+/**
+Add a frame to the animation written by Close. 
+All frames must have the size of the first one (the canvas size). 
+The frame lasts for its FrameTime (in ms, default to 100 ms), the Loop count is read from the first frame. 
+@param dib The frame to encode
+@param context Plugin data
+@param flags FreeImage save flags
+@return Returns TRUE if successfull, returns FALSE otherwise
+*/
+static BOOL
+SaveFrame(FIBITMAP *dib, WebPContext *context, int flags) {
+	WebPPicture picture;	// Input buffer
+	WebPConfig config;		// Coding parameters
+
+	if(WebPPictureInit(&picture) != 1) {
+		FreeImage_OutputMessageProc(s_format_id, "Couldn't initialize WebPPicture");
+		return FALSE;
+	}
+
+	try {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned bpp = FreeImage_GetBPP(dib);
+		FITAG *tag = NULL;
+
+		if( !((FreeImage_GetImageType(dib) == FIT_BITMAP) && ((bpp == 24) || (bpp == 32))) )  {
+			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
 		}
 
-#endif // FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		if(!context->encoder) {
+			// the first frame sets the canvas size and the animation parameters
+			if(MAX(width, height) > WEBP_MAX_DIMENSION) {
+				throw "Unsupported image size";
+			}
 
-		if(!WebPEncode(&config, &picture)) {
-			throw "Failed to encode image";
+			WebPAnimEncoderOptions options;
+			if(!WebPAnimEncoderOptionsInit(&options)) {
+				throw "Library version mismatch";
+			}
+			if( GetMetadataTag(FIMD_ANIMATION, dib, "Loop", FIDT_LONG, &tag) ) {
+				options.anim_params.loop_count = MAX(0, (int)*(LONG*)FreeImage_GetTagValue(tag));
+			}
+			if((flags & WEBP_BEST) == WEBP_BEST) {
+				// try both lossy and lossless encodings, and the key-frame choice, for each frame
+				options.minimize_size = 1;
+			}
+
+			context->encoder = WebPAnimEncoderNew((int)width, (int)height, &options);
+			if(!context->encoder) {
+				throw FI_MSG_ERROR_MEMORY;
+			}
+
+			context->canvas_width = (int)width;
+			context->canvas_height = (int)height;
+
+			if(SetMuxMetadata(context->mux, dib) != WEBP_MUX_OK) {
+				throw "Failed to set animation metadata";
+			}
+		}
+		else if(((int)width != context->canvas_width) || ((int)height != context->canvas_height)) {
+			throw "Frame size differs from the animation size";
 		}
 
-		WebPPictureFree(&picture);
+		picture.width = (int)width;
+		picture.height = (int)height;
+		// the animation encoder works on ARGB frames
+		picture.use_argb = 1;
+
+		SetEncoderConfig(&config, &picture, flags);
 
-		if(bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
+		if(!ImportPicture(&picture, dib)) {
+			throw FI_MSG_ERROR_MEMORY;
 		}
 
+		if(!WebPAnimEncoderAdd(context->encoder, &picture, context->timestamp, &config)) {
+			throw WebPAnimEncoderGetError(context->encoder);
+		}
+
+		LONG frame_time = WEBP_DEFAULT_FRAME_TIME;
+		if( GetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", FIDT_LONG, &tag) ) {
+			frame_time = MAX(0, (int)*(LONG*)FreeImage_GetTagValue(tag));
+		}
+		context->timestamp += frame_time;
+
+		WebPPictureFree(&picture);
+
 		return TRUE;
 
 	} catch (const char* text) {
 
 		WebPPictureFree(&picture);
 
-		if(bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
-		}
-
 		if(NULL != text) {
 			FreeImage_OutputMessageProc(s_format_id, text);
 		}
@@ -628,10 +1295,17 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return FALSE;
 	}
 
+	WebPContext *context = (WebPContext*)data;
+
+	if(page >= 0) {
+		// multipage: animation frame
+		return SaveFrame(dib, context, flags);
+	}
+
 	try {
 
 		// get the MUX object
-		mux = (WebPMux*)data;
+		mux = context->mux;
 		if(!mux) {
 			return FALSE;
 		}
@@ -649,6 +1323,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		FreeImage_AcquireMemory(hmem, &data, &data_size);
 		webp_image.bytes = data;
 		webp_image.size = data_size;
+
 		error_status = WebPMuxSetImage(mux, &webp_image, copy_data);
 		// no longer needed since copy_data == 1
 		FreeImage_CloseMemory(hmem);
@@ -659,46 +1334,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 		// --- set metadata ---
 		
-		// set ICC color profile
-		{
-			FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
-			if (iccProfile->size && iccProfile->data) {
-				WebPData icc_profile;
-				icc_profile.bytes = (uint8_t*)iccProfile->data;
-				icc_profile.size = (size_t)iccProfile->size;
-				error_status = WebPMuxSetChunk(mux, "ICCP", &icc_profile, copy_data);
-				if(error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
-		}
-
-		// set XMP metadata
-		{
-			FITAG *tag = NULL;
-			if(FreeImage_GetMetadata(FIMD_XMP, dib, g_TagLib_XMPFieldName, &tag)) {
-				WebPData xmp_profile;
-				xmp_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
-				xmp_profile.size = (size_t)FreeImage_GetTagLength(tag);
-				error_status = WebPMuxSetChunk(mux, "XMP ", &xmp_profile, copy_data);
-				if(error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
-		}
-
-		// set Exif metadata
-		{
-			FITAG *tag = NULL;
-			if(FreeImage_GetMetadata(FIMD_EXIF_RAW, dib, g_TagLib_ExifRawFieldName, &tag)) {
-				WebPData exif_profile;
-				exif_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
-				exif_profile.size = (size_t)FreeImage_GetTagLength(tag);
-				error_status = WebPMuxSetChunk(mux, "EXIF", &exif_profile, copy_data);
-				if(error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
+		error_status = SetMuxMetadata(mux, dib);
+		if(error_status != WEBP_MUX_OK) {
+			throw (1);
 		}
 		
 		// get data from mux in WebP RIFF format
@@ -708,8 +1346,24 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			throw (1);
 		}
 
+		FITAG *frame_time = NULL;
+		FITAG *loop = NULL;
+		const BOOL has_frame_time = GetMetadataTag(FIMD_ANIMATION, dib, "FrameTime", FIDT_LONG, &frame_time);
+		const BOOL has_loop = GetMetadataTag(FIMD_ANIMATION, dib, "Loop", FIDT_LONG, &loop);
+
+		if(((flags & WEBP_ANIMATION_FRAME) == WEBP_ANIMATION_FRAME) && (has_frame_time || has_loop)) {
+			// write a one-frame animation, so that the animation metadata survives
+			const int duration = has_frame_time ? (int)*(LONG*)FreeImage_GetTagValue(frame_time) : WEBP_DEFAULT_FRAME_TIME;
+			const int loop_count = has_loop ? (int)*(LONG*)FreeImage_GetTagValue(loop) : 0;
+			try {
+				WriteSingleFrameAnimation(io, handle, &output_data, dib, duration, loop_count);
+			} catch(const char *text) {
+				FreeImage_OutputMessageProc(s_format_id, text);
+				throw (1);
+			}
+		}
 		// write the file to the output stream
-		if(io->write_proc((void*)output_data.bytes, 1, (unsigned)output_data.size, handle) != output_data.size) {
+		else if(io->write_proc((void*)output_data.bytes, 1, (unsigned)output_data.size, handle) != output_data.size) {
 			FreeImage_OutputMessageProc(s_format_id, "Failed to write webp output file");
 			throw (1);
 		}
@@ -744,7 +1398,7 @@ InitWEBP(Plugin *plugin, int format_id) {
 	plugin->regexpr_proc = RegExpr;
 	plugin->open_proc = Open;
 	plugin->close_proc = Close;
-	plugin->pagecount_proc = NULL;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = NULL;
 	plugin->load_proc = NULL;
 	plugin->loadAdv_proc = LoadAdv;
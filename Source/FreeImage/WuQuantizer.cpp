@@ -33,6 +33,7 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -44,6 +45,9 @@
 
 #define MAXCOLOR	256
 
+// Minimum number of pixels worth a histogram thread
+#define WU_MIN_THREAD_PIXELS	(512 * 512)
+
 // Constructor / Destructor
 
 WuQuantizer::WuQuantizer(FIBITMAP *dib) {
@@ -103,49 +107,71 @@ WuQuantizer::Hist3D(LONG *vwt, LONG *vmr, LONG *vmg, LONG *vmb, float *m2, int R
 	int ind = 0;
 	int inr, ing, inb, table[256];
 	int i;
-	unsigned y, x;
 
 	for(i = 0; i < 256; i++)
 		table[i] = i * i;
 
-	if (FreeImage_GetBPP(m_dib) == 24) {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 3;
-			}
+	const unsigned bytespp = FreeImage_GetLine(m_dib) / width;
+
+	// the image is split into bands of rows, each band is counted into its own tables
+	// (band 0 directly into the output ones) and the tables are summed afterwards;
+	// c^2 is summed as an integer so that the result does not depend on the band count
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, WU_MIN_THREAD_PIXELS);
+
+	std::vector<LONG> band_moments((size_t)(threads - 1) * 4 * SIZE_3D, 0);
+	std::vector<UINT64> band_m2((size_t)threads * SIZE_3D, 0);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
+		LONG *bwt = vwt, *bmr = vmr, *bmg = vmg, *bmb = vmb;
+		if(band > 0) {
+			bwt = &band_moments[(size_t)(band - 1) * 4 * SIZE_3D];
+			bmr = bwt + SIZE_3D;
+			bmg = bmr + SIZE_3D;
+			bmb = bmg + SIZE_3D;
 		}
-	} else {
-		for(y = 0; y < height; y++) {
-			BYTE *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for(x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[y*width + x] = (WORD)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 4;
+		UINT64 *bm2 = &band_m2[(size_t)band * SIZE_3D];
+
+		for(unsigned y = first; y < last; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(m_dib, y);
+			WORD *qadd = Qadd + (size_t)y * width;
+
+			for(unsigned x = 0; x < width; x++) {
+				const int red = bits[FI_RGBA_RED];
+				const int green = bits[FI_RGBA_GREEN];
+				const int blue = bits[FI_RGBA_BLUE];
+				const int r = (red >> 3) + 1;
+				const int g = (green >> 3) + 1;
+				const int b = (blue >> 3) + 1;
+				const int index = INDEX(r, g, b);
+				qadd[x] = (WORD)index;
+				// [r][g][b]
+				bwt[index]++;
+				bmr[index] += red;
+				bmg[index] += green;
+				bmb[index] += blue;
+				bm2[index] += (UINT64)(table[red] + table[green] + table[blue]);
+				bits += bytespp;
 			}
 		}
+	});
+
+	for(unsigned band = 1; band < threads; band++) {
+		const LONG *bwt = &band_moments[(size_t)(band - 1) * 4 * SIZE_3D];
+		const LONG *bmr = bwt + SIZE_3D;
+		const LONG *bmg = bmr + SIZE_3D;
+		const LONG *bmb = bmg + SIZE_3D;
+		const UINT64 *bm2 = &band_m2[(size_t)band * SIZE_3D];
+		for(i = 0; i < SIZE_3D; i++) {
+			vwt[i] += bwt[i];
+			vmr[i] += bmr[i];
+			vmg[i] += bmg[i];
+			vmb[i] += bmb[i];
+			band_m2[i] += bm2[i];
+		}
+	}
+	for(i = 0; i < SIZE_3D; i++) {
+		m2[i] = (float)band_m2[i];
 	}
 
 	if( ReserveSize > 0 ) {
@@ -69,7 +69,7 @@ static const float CIE_C_bD = ( (1/CIE_y_w) * ( CIE_x_w*(CIE_y_r - CIE_y_g) - CI
 /**
 RGB to XYZ (no white balance)
 */
-static const float  RGB2XYZ[3][3] = {
+const float RGB2XYZ[3][3] = {
 	{ CIE_x_r*CIE_C_rD / CIE_D, 
 	  CIE_x_g*CIE_C_gD / CIE_D, 
 	  CIE_x_b*CIE_C_bD / CIE_D 
@@ -87,7 +87,7 @@ static const float  RGB2XYZ[3][3] = {
 /**
 XYZ to RGB (no white balance)
 */
-static const float  XYZ2RGB[3][3] = {
+const float XYZ2RGB[3][3] = {
 	{(CIE_y_g - CIE_y_b - CIE_x_b*CIE_y_g + CIE_y_b*CIE_x_g) / CIE_C_rD,
 	 (CIE_x_b - CIE_x_g - CIE_x_b*CIE_y_g + CIE_x_g*CIE_y_b) / CIE_C_rD,
 	 (CIE_x_g*CIE_y_b - CIE_x_b*CIE_y_g) / CIE_C_rD
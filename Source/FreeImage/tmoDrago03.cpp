@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "Parallel.h"
 
 // ----------------------------------------------------------
 // Logarithmic mapping operator
@@ -55,163 +56,98 @@ pade_log(const double x) {
 	return log(x + 1);
 }
 
+// size of the gamma correction lookup table, indexed by values in [0, 1]
+#define DRAGO03_GAMMA_LUT_SIZE	16384
+
 /**
-Log mapping operator
-@param dib Input / Output Yxy image
-@param maxLum Maximum luminance
-@param avgLum Average luminance (world adaptation luminance)
-@param biasParam Bias parameter (a zero value default to 0.85)
-@param exposure Exposure parameter (default to 0)
-@return Returns TRUE if successful, returns FALSE otherwise
+Parameters of the fused Drago03 pipeline
 */
-static BOOL 
-ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure) {
-	const float LOG05 = -0.693147F;	// log(0.5) 
-
-	double Lmax, divider, interpol, biasP;
-	unsigned x, y;
-	double L;
-
-	if(FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
-
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-
+typedef struct tagDrago03Params {
+	float lum_scale;		// exposure / average luminance
+	float Lmax_inv;			// 1 / maximum luminance (normalized by average luminance)
+	float biasP;			// bias power, log(bias) / log(0.5)
+	float divider_inv;		// 1 / log10(Lmax + 1)
+	const BYTE *gamma_lut;	// gamma corrected 8-bit values, NULL when no gamma correction is applied
+} Drago03Params;
 
-	// arbitrary Bias Parameter 
-	if(biasParam == 0) 
-		biasParam = 0.85F;
+/**
+Luminance statistics of a band of pixels
+*/
+typedef struct tagDrago03Stats {
+	float max_lum;
+	double sum_log;
+} Drago03Stats;
 
-	// normalize maximum luminance by average luminance
-	Lmax = maxLum / avgLum;
-	
-	divider = log10(Lmax+1);
-	biasP = log(biasParam)/LOG05;
-
-#if !defined(DRAGO03_FAST)
-
-	/**
-	Normal tone mapping of every pixel
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	*/
-	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(x = 0; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
+/**
+Get the Y component of a RGBF pixel, as computed by ConvertInPlaceRGBFToYxy, clamped to positive values
+*/
+static inline float 
+LuminanceDrago03(const FIRGBF& pixel) {
+	float XYZ[3];
+	for(int i = 0; i < 3; i++) {
+		XYZ[i] = RGB2XYZ[i][0] * pixel.red + RGB2XYZ[i][1] * pixel.green + RGB2XYZ[i][2] * pixel.blue;
 	}
+	const float W = XYZ[0] + XYZ[1] + XYZ[2];
+	return ((W > 0) && (XYZ[1] > 0)) ? XYZ[1] : 0;
+}
 
-#else
-	unsigned index;
-	int i, j;
-
-	unsigned max_width  = width - (width % 3);
-	unsigned max_height = height - (height % 3); 
-	unsigned fpitch = pitch / sizeof(FIRGBF);
-
-	/**
-	fast tone mapping
-	split the image into 3x3 pixel tiles and perform the computation for each group of 9 pixels
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	=> produce artifacts and not so faster, so the code has been disabled
-	*/
-#define PIXEL(x, y)	image[y*fpitch + x].red
-
-	FIRGBF *image = (FIRGBF*)FreeImage_GetBits(dib);
-	for(y = 0; y < max_height; y += 3) {
-		for(x = 0; x < max_width; x += 3) {
-			double average = 0;
-			for(i = 0; i < 3; i++) {
-				for(j = 0; j < 3; j++) {
-					index = (y + i)*fpitch + (x + j);
-					image[index].red /= (float)avgLum;
-					image[index].red *= exposure; 
-					average += image[index].red;
-				}
-			}
-			average = average / 9 - PIXEL(x, y);
-			if(average > -1 && average < 1) {
-				interpol = log(2 + pow(PIXEL(x + 1, y + 1) / Lmax, biasP) * 8);
-				for(i = 0; i < 3; i++) {
-					for(j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
-			}
-			else {
-				for(i = 0; i < 3; i++) {
-					for(j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						interpol = log(2 + pow(image[index].red / Lmax, biasP) * 8);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
+/**
+Get the maximum luminance and the sum of the log luminance over a band of scanlines
+*/
+static void 
+LuminanceStatsDrago03(FIBITMAP *dib, unsigned first, unsigned last, Drago03Stats *stats) {
+	const unsigned width = FreeImage_GetWidth(dib);
+
+	float max_lum = 0;
+	double sum = 0;
+
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 contrast = _mm_set1_ps(2.3e-5F);
+		__m128 vmax = zero;
+		__m128 vsum = zero;
+		for(; x + 4 <= width; x += 4) {
+			__m128 red, green, blue;
+			tmo_LoadRGBF(&pixel[x], red, green, blue);
+			__m128 XYZ[3];
+			for(int i = 0; i < 3; i++) {
+				XYZ[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][0]), red), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][1]), green)), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][2]), blue));
 			}
-		} //x
-	} // y
-
-	/**
-	Normal tone mapping of every pixel for the remaining right and bottom bands
-	*/
-	BYTE *bits;
-
-	// right band
-	bits = (BYTE*)FreeImage_GetBits(dib);
-	for(y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(x = max_width; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
+			const __m128 W = _mm_add_ps(_mm_add_ps(XYZ[0], XYZ[1]), XYZ[2]);
+			const __m128 L = _mm_and_ps(_mm_max_ps(XYZ[1], zero), _mm_cmpgt_ps(W, zero));
+			vmax = _mm_max_ps(L, vmax);
+			vsum = _mm_add_ps(vsum, tmo_log_ps(_mm_add_ps(L, contrast)));
 		}
-		// next line
-		bits += pitch;
-	}
-	// bottom band
-	bits = (BYTE*)FreeImage_GetBits(dib);
-	for(y = max_height; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for(x = 0; x < max_width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
+		float m[4], s[4];
+		_mm_storeu_ps(m, vmax);
+		_mm_storeu_ps(s, vsum);
+		for(int k = 0; k < 4; k++) {
+			max_lum = (max_lum < m[k]) ? m[k] : max_lum;
+			sum += s[k];
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			const float L = LuminanceDrago03(pixel[x]);
+			max_lum = (max_lum < L) ? L : max_lum;	// max Luminance in the scene
+			sum += log(2.3e-5F + L);				// contrast constant in Tumblin paper
 		}
-		// next line
-		bits += pitch;
 	}
 
-#endif	// DRAGO03_FAST
-
-	return TRUE;
+	stats->max_lum = max_lum;
+	stats->sum_log = sum;
 }
 
 /**
-Custom gamma correction based on the ITU-R BT.709 standard
-@param dib RGBF image to be corrected
+Custom gamma correction based on the ITU-R BT.709 standard, 
+tabulated with the clamping and the conversion to 8-bit
+@param lut Output table of DRAGO03_GAMMA_LUT_SIZE entries, for values in [0, 1]
 @param gammaval Gamma value (2.2 is a good default value)
-@return Returns TRUE if successful, returns FALSE otherwise
 */
-static BOOL 
-REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
-	if(FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
-
+static void 
+REC709GammaCorrection(BYTE *lut, const double gammaval) {
 	float slope = 4.5F;
 	float start = 0.018F;
 	
@@ -224,23 +160,174 @@ REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
 		slope = (float)(4.5 / ((2 - gammaval) * 7.5));
 	}
 
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
+	for(int i = 0; i < DRAGO03_GAMMA_LUT_SIZE; i++) {
+		const float value = (float)i / (DRAGO03_GAMMA_LUT_SIZE - 1);
+		lut[i] = tmo_ClampToByte((value <= start) ? value * slope : (1.099F * (float)pow(value, fgamma) - 0.099F));
+	}
+}
 
-	BYTE *bits = (BYTE*)FreeImage_GetBits(dib);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			for(int i = 0; i < 3; i++) {
-				*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
-				pixel++;
-			}
+/**
+Clamp a display value, gamma correct it and convert it to 8-bit
+*/
+static inline BYTE 
+QuantizeDrago03(const Drago03Params& params, float value) {
+	if(params.gamma_lut) {
+		value = (value > 0) ? value : 0;
+		value = (value > 1) ? 1 : value;
+		return params.gamma_lut[(int)(value * (DRAGO03_GAMMA_LUT_SIZE - 1) + 0.5F)];
+	}
+	return tmo_ClampToByte(value);
+}
+
+/**
+Tone map a RGBF pixel: RGB to Yxy, log mapping of Y, Yxy to RGB, gamma correction and conversion to 8-bit
+*/
+static inline void 
+ToneMapPixelDrago03(const Drago03Params& params, const FIRGBF& pixel, BYTE *dst) {
+	static const float EPSILON = 1e-06F;
+
+	float XYZ[3];
+	for(int i = 0; i < 3; i++) {
+		XYZ[i] = RGB2XYZ[i][0] * pixel.red + RGB2XYZ[i][1] * pixel.green + RGB2XYZ[i][2] * pixel.blue;
+	}
+	const float W = XYZ[0] + XYZ[1] + XYZ[2];
+	float x = 0, y = 0, Y = 0;
+	if(W > 0) {
+		Y = (XYZ[1] > 0) ? XYZ[1] : 0;
+		x = XYZ[0] / W;
+		y = XYZ[1] / W;
+	}
+
+	// log mapping of the luminance
+	const double Yw = Y * params.lum_scale;
+	const double interpol = log(2 + biasFunction(params.biasP, Yw * params.Lmax_inv) * 8);
+	const double L = pade_log(Yw);// log(Yw + 1)
+	Y = (float)((L / interpol) * params.divider_inv);
+
+	// back to RGB
+	if((Y > EPSILON) && (x > EPSILON) && (y > EPSILON)) {
+		XYZ[0] = (x * Y) / y;
+		XYZ[2] = (XYZ[0] / x) - XYZ[0] - Y;
+	} else {
+		XYZ[0] = XYZ[2] = EPSILON;
+	}
+	XYZ[1] = Y;
+	float RGB[3];
+	for(int i = 0; i < 3; i++) {
+		RGB[i] = XYZ2RGB[i][0] * XYZ[0] + XYZ2RGB[i][1] * XYZ[1] + XYZ2RGB[i][2] * XYZ[2];
+	}
+
+	dst[FI_RGBA_RED]   = QuantizeDrago03(params, RGB[0]);
+	dst[FI_RGBA_GREEN] = QuantizeDrago03(params, RGB[1]);
+	dst[FI_RGBA_BLUE]  = QuantizeDrago03(params, RGB[2]);
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+SSE2 version of ToneMapPixelDrago03, for 4 pixels.<br>
+When the chromaticity is kept, converting Yxy back to RGB amounts to scaling RGB by Y' / Y, 
+which saves the divisions by x and y.
+*/
+static inline void 
+ToneMapPixelsDrago03(const Drago03Params& params, const FIRGBF *pixel, BYTE *dst) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0F);
+	const __m128 epsilon = _mm_set1_ps(1e-06F);
+
+	__m128 RGB[3];
+	tmo_LoadRGBF(pixel, RGB[0], RGB[1], RGB[2]);
+
+	__m128 XYZ[3];
+	for(int i = 0; i < 3; i++) {
+		XYZ[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][0]), RGB[0]), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][1]), RGB[1])), _mm_mul_ps(_mm_set1_ps(RGB2XYZ[i][2]), RGB[2]));
+	}
+	const __m128 W = _mm_add_ps(_mm_add_ps(XYZ[0], XYZ[1]), XYZ[2]);
+	const __m128 valid = _mm_cmpgt_ps(W, zero);
+	const __m128 Y = _mm_and_ps(valid, _mm_max_ps(XYZ[1], zero));
+	// (x > EPSILON) && (y > EPSILON)
+	const __m128 eW = _mm_mul_ps(epsilon, W);
+	const __m128 chroma = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(XYZ[0], eW), _mm_cmpgt_ps(XYZ[1], eW)));
+
+	// log mapping of the luminance
+	const __m128 Yw = _mm_mul_ps(Y, _mm_set1_ps(params.lum_scale));
+	const __m128 bias = tmo_pow_ps(_mm_mul_ps(Yw, _mm_set1_ps(params.Lmax_inv)), _mm_set1_ps(params.biasP));
+	const __m128 interpol = tmo_log_ps(_mm_add_ps(_mm_set1_ps(2.0F), _mm_mul_ps(bias, _mm_set1_ps(8.0F))));
+
+	// Pad approximation of log(Yw + 1) as num / den, see pade_log
+	const __m128 below1 = _mm_cmplt_ps(Yw, one);
+	const __m128 below2 = _mm_cmplt_ps(Yw, _mm_set1_ps(2.0F));
+	const __m128 a = _mm_or_ps(_mm_and_ps(below1, one), _mm_andnot_ps(below1, _mm_set1_ps(0.7662F)));
+	const __m128 b = _mm_or_ps(_mm_and_ps(below1, _mm_set1_ps(6.0F)), _mm_andnot_ps(below1, _mm_set1_ps(5.9897F)));
+	const __m128 c = _mm_or_ps(_mm_and_ps(below1, _mm_set1_ps(4.0F)), _mm_andnot_ps(below1, _mm_set1_ps(3.7658F)));
+	__m128 num = _mm_mul_ps(Yw, _mm_add_ps(_mm_set1_ps(6.0F), _mm_mul_ps(a, Yw)));
+	__m128 den = _mm_add_ps(b, _mm_mul_ps(c, Yw));
+	if(_mm_movemask_ps(below2) != 0xF) {
+		num = _mm_or_ps(_mm_and_ps(below2, num), _mm_andnot_ps(below2, tmo_log_ps(_mm_add_ps(Yw, one))));
+		den = _mm_or_ps(_mm_and_ps(below2, den), _mm_andnot_ps(below2, one));
+	}
+
+	// ratio of the mapped luminance Y' = (L / interpol) / divider to Y
+	const __m128 positive = _mm_cmpgt_ps(Y, zero);
+	const __m128 Y_safe = _mm_or_ps(_mm_and_ps(positive, Y), _mm_andnot_ps(positive, one));
+	const __m128 ratio = _mm_div_ps(_mm_mul_ps(num, _mm_set1_ps(params.divider_inv)), _mm_mul_ps(_mm_mul_ps(den, interpol), Y_safe));
+	const __m128 Ym = _mm_mul_ps(ratio, Y);
+
+	// back to RGB, pixels with a too small Y' or chromaticity use X = Z = EPSILON
+	const __m128 mapped = _mm_and_ps(chroma, _mm_cmpgt_ps(Ym, epsilon));
+	for(int i = 0; i < 3; i++) {
+		const __m128 scaled = _mm_mul_ps(RGB[i], ratio);
+		const __m128 clipped = _mm_add_ps(_mm_set1_ps((XYZ2RGB[i][0] + XYZ2RGB[i][2]) * 1e-06F), _mm_mul_ps(_mm_set1_ps(XYZ2RGB[i][1]), Ym));
+		RGB[i] = _mm_or_ps(_mm_and_ps(mapped, scaled), _mm_andnot_ps(mapped, clipped));
+	}
+
+	if(params.gamma_lut) {
+		// clamp to [0, 1] (NaN gives 0) then use the gamma table
+		const __m128 scale = _mm_set1_ps(DRAGO03_GAMMA_LUT_SIZE - 1);
+		const __m128 half = _mm_set1_ps(0.5F);
+		int index[3][4];
+		for(int i = 0; i < 3; i++) {
+			const __m128 value = _mm_min_ps(_mm_max_ps(RGB[i], zero), one);
+			_mm_storeu_si128((__m128i*)index[i], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half)));
+		}
+		for(int k = 0; k < 4; k++) {
+			dst[FI_RGBA_RED]   = params.gamma_lut[index[0][k]];
+			dst[FI_RGBA_GREEN] = params.gamma_lut[index[1][k]];
+			dst[FI_RGBA_BLUE]  = params.gamma_lut[index[2][k]];
+			dst += 3;
 		}
-		bits += pitch;
+	} else {
+		tmo_StoreRGB24(dst, RGB[0], RGB[1], RGB[2]);
 	}
+}
+
+#endif // FREEIMAGE_SSE2
 
-	return TRUE;
+/**
+Log mapping operator, fused with the color conversions, the gamma correction and the 24-bit conversion
+@param src Input RGBF image
+@param dst Output 24-bit image
+@param params Operator parameters
+@param first First scanline to process
+@param last Last scanline to process (excluded)
+*/
+static void 
+ToneMappingDrago03(FIBITMAP *src, FIBITMAP *dst, const Drago03Params& params, unsigned first, unsigned last) {
+	const unsigned width = FreeImage_GetWidth(src);
+
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(src, y);
+		BYTE *dst_pixel = FreeImage_GetScanLine(dst, y);
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		for(; x + 4 <= width; x += 4) {
+			ToneMapPixelsDrago03(params, &pixel[x], dst_pixel + 3 * x);
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			ToneMapPixelDrago03(params, pixel[x], dst_pixel + 3 * x);
+		}
+	}
 }
 
 // ----------------------------------------------------------
@@ -256,37 +343,71 @@ Apply the Adaptive Logarithmic Mapping operator to a HDR image and convert to 24
 */
 FIBITMAP* DLL_CALLCONV 
 FreeImage_TmoDrago03(FIBITMAP *src, double gamma, double exposure) {
-	float maxLum, minLum, avgLum;
+	const float LOG05 = -0.693147F;	// log(0.5) 
 
 	if(!FreeImage_HasPixels(src)) return NULL;
 
-	// working RGBF variable
-	FIBITMAP *dib = NULL;
-
-	dib = FreeImage_ConvertToRGBF(src);
+	// working RGBF variable (the operator does not modify it)
+	FIBITMAP *dib = (FreeImage_GetImageType(src) == FIT_RGBF) ? src : FreeImage_ConvertToRGBF(src);
 	if(!dib) return NULL;
 
+	const unsigned width  = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(!dst) {
+		if(dib != src) FreeImage_Unload(dib);
+		return NULL;
+	}
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, TMO_MIN_THREAD_PIXELS);
+
+	// get the luminance statistics (one partial result per band, summed in order)
+	std::vector<Drago03Stats> stats(threads);
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
+		LuminanceStatsDrago03(dib, first, last, &stats[band]);
+	});
+	float maxLum = 0;
+	double sum = 0;
+	for(unsigned i = 0; i < threads; i++) {
+		maxLum = (maxLum < stats[i].max_lum) ? stats[i].max_lum : maxLum;
+		sum += stats[i].sum_log;
+	}
+	// world adaptation luminance
+	const float avgLum = (float)exp(sum / ((double)width * height));
+
 	// default algorithm parameters
 	const float biasParam = 0.85F;
 	const float expoParam = (float)pow(2.0, exposure); //default exposure is 1, 2^0
 
-	// convert to Yxy
-	ConvertInPlaceRGBFToYxy(dib);
-	// get the luminance
-	LuminanceFromYxy(dib, &maxLum, &minLum, &avgLum);
-	// perform the tone mapping
-	ToneMappingDrago03(dib, maxLum, avgLum, biasParam, expoParam);
-	// convert back to RGBF
-	ConvertInPlaceYxyToRGBF(dib);
+	// normalize maximum luminance by average luminance
+	const double Lmax = maxLum / avgLum;
+
+	Drago03Params params;
+	params.lum_scale = expoParam / avgLum;
+	params.Lmax_inv = (float)(1 / Lmax);
+	params.biasP = (float)(log(biasParam) / LOG05);
+	params.divider_inv = (float)(1 / log10(Lmax + 1));
+	params.gamma_lut = NULL;
+
+	std::vector<BYTE> gamma_lut;
 	if(gamma != 1) {
-		// perform gamma correction
-		REC709GammaCorrection(dib, (float)gamma);
+		// gamma correction
+		gamma_lut.resize(DRAGO03_GAMMA_LUT_SIZE);
+		REC709GammaCorrection(&gamma_lut[0], gamma);
+		params.gamma_lut = &gamma_lut[0];
 	}
-	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
+
+	// perform the tone mapping, convert back to RGB, gamma correct, 
+	// clamp image highest values to display white and convert to 24-bit RGB
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		ToneMappingDrago03(dib, dst, params, first, last);
+	});
 
 	// clean-up and return
-	FreeImage_Unload(dib);
+	if(dib != src) {
+		FreeImage_Unload(dib);
+	}
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(dst, src);
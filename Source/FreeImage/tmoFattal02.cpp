@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "Parallel.h"
 
 // ----------------------------------------------------------
 // Gradient domain HDR compression
@@ -34,16 +35,25 @@
 
 static const float EPSILON = 1e-4F;
 
+/**
+Get the number of threads worth using on an image. 
+The result never exceeds the image height, so that each band of a row split fills its partial result.
+*/
+static inline unsigned 
+GetThreadCountFattal02(FIBITMAP *dib) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	return MIN(FreeImage_GetThreadCount((size_t)FreeImage_GetWidth(dib) * height, TMO_MIN_THREAD_PIXELS), height);
+}
+
 /**
 Performs a 5 by 5 gaussian filtering using two 1D convolutions, 
 followed by a subsampling by 2. 
 @param dib Input image
 @return Returns a blurred image of size SIZE(dib)/2
-@see GaussianPyramid
+@see GradientPyramid
 */
 static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 	FIBITMAP *h_dib = NULL, *v_dib = NULL, *dst = NULL;
-	float *src_pixel, *dst_pixel;
 
 	try {
 		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -57,47 +67,78 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 		if(!h_dib || !v_dib) throw(1);
 
 		const unsigned pitch = FreeImage_GetPitch(dib) / sizeof(float);
+		const unsigned threads = GetThreadCountFattal02(dib);
 
 		// horizontal convolution dib -> h_dib
 
-		src_pixel = (float*)FreeImage_GetBits(dib);
-		dst_pixel = (float*)FreeImage_GetBits(h_dib);
-
-		for(unsigned y = 0; y < height; y++) {
-			// work on line y
-			for(unsigned x = 2; x < width - 2; x++) {
-				dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
-				dst_pixel[x] /= 16;
+		FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+			for(unsigned y = first; y < last; y++) {
+				// work on line y
+				const float *src_pixel = (float*)FreeImage_GetBits(dib) + y * pitch;
+				float *dst_pixel = (float*)FreeImage_GetBits(h_dib) + y * pitch;
+				for(unsigned x = 2; x < width - 2; x++) {
+					dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
+					dst_pixel[x] /= 16;
+				}
+				// boundary mirroring
+				dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
+				dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
+				dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
+				dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
 			}
-			// boundary mirroring
-			dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
-			dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
-			dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
-			dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
-
-			// next line
-			src_pixel += pitch;
-			dst_pixel += pitch;
-		}
-
-		// vertical convolution h_dib -> v_dib
-
-		src_pixel = (float*)FreeImage_GetBits(h_dib);
-		dst_pixel = (float*)FreeImage_GetBits(v_dib);
-
-		for(unsigned x = 0; x < width; x++) {		
-			// work on column x
-			for(unsigned y = 2; y < height - 2; y++) {
-				const unsigned index = y*pitch + x;
-				dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
-				dst_pixel[index] /= 16;
+		});
+
+		// vertical convolution h_dib -> v_dib, 
+		// computed line by line from the 5 neighbouring lines of h_dib
+
+		FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+			const float *src_bits = (float*)FreeImage_GetBits(h_dib);
+			for(unsigned y = first; y < last; y++) {
+				float *dst_pixel = (float*)FreeImage_GetBits(v_dib) + y * pitch;
+				if((y >= 2) && (y < height - 2)) {
+					const float *s0 = src_bits + (y-2) * pitch;
+					const float *s1 = s0 + pitch;
+					const float *s2 = s1 + pitch;
+					const float *s3 = s2 + pitch;
+					const float *s4 = s3 + pitch;
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = s0[x] + s4[x] + 4 * (s1[x] + s3[x]) + 6 * s2[x];
+						dst_pixel[x] /= 16;
+					}
+				} else if(y == 0) {
+					// boundary mirroring
+					const float *s0 = src_bits;
+					const float *s1 = s0 + pitch;
+					const float *s2 = s1 + pitch;
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = (2 * s2[x] + 8 * s1[x] + 6 * s0[x]) / 16;
+					}
+				} else if(y == 1) {
+					const float *s0 = src_bits;
+					const float *s1 = s0 + pitch;
+					const float *s2 = s1 + pitch;
+					const float *s3 = s2 + pitch;
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = (s3[x] + 4 * (s0[x] + s2[x]) + 7 * s1[x]) / 16;
+					}
+				} else if(y == height - 2) {
+					const float *s0 = src_bits + (height-4) * pitch;
+					const float *s1 = s0 + pitch;
+					const float *s2 = s1 + pitch;
+					const float *s3 = s2 + pitch;
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = (s0[x] + 5 * s3[x] + 4 * s1[x] + 6 * s2[x]) / 16;
+					}
+				} else {
+					const float *s0 = src_bits + (height-3) * pitch;
+					const float *s1 = s0 + pitch;
+					const float *s2 = s1 + pitch;
+					for(unsigned x = 0; x < width; x++) {
+						dst_pixel[x] = (s0[x] + 5 * s1[x] + 10 * s2[x]) / 16;
+					}
+				}
 			}
-			// boundary mirroring
-			dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
-			dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
-			dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
-			dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
-		}
+		});
 
 		FreeImage_Unload(h_dib); h_dib = NULL;
 
@@ -117,35 +158,6 @@ static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
 	}
 }
 
-/**
-Compute a Gaussian pyramid using the specified number of levels. 
-@param H Original bitmap
-@param pyramid Resulting pyramid array 
-@param nlevels Number of resolution levels
-@return Returns TRUE if successful, returns FALSE otherwise
-*/
-static BOOL GaussianPyramid(FIBITMAP *H, FIBITMAP **pyramid, int nlevels) {
-	try {
-		// first level is the original image
-		pyramid[0] = FreeImage_Clone(H);
-		if(pyramid[0] == NULL) throw(1);
-		// compute next levels
-		for(int k = 1; k < nlevels; k++) {
-			pyramid[k] = GaussianLevel5x5(pyramid[k-1]);
-			if(pyramid[k] == NULL) throw(1);
-		}
-		return TRUE;
-	} catch(int) {
-		for(int k = 0; k < nlevels; k++) {
-			if(pyramid[k] != NULL) {
-				FreeImage_Unload(pyramid[k]);
-				pyramid[k] = NULL;
-			}
-		}
-		return FALSE;
-	}
-}
-
 /**
 Compute the gradient magnitude of an input image H using central differences, 
 and returns the average gradient. 
@@ -171,30 +183,39 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
 		
 		const float divider = (float)(1 << (k + 1));
-		float average = 0;
-		
-		float *src_pixel = (float*)FreeImage_GetBits(H);
-		float *dst_pixel = (float*)FreeImage_GetBits(G);
 
-		for(unsigned y = 0; y < height; y++) {
-			const unsigned n = (y == 0 ? 0 : y-1);
-			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {
-				const unsigned w = (x == 0 ? 0 : x-1);
-				const unsigned e = (x+1 == width ? x : x+1);		
-				// central difference
-				const float gx = (src_pixel[y*pitch+e] - src_pixel[y*pitch+w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
-				const float gy = (src_pixel[s*pitch+x] - src_pixel[n*pitch+x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
-				// gradient
-				dst_pixel[x] = sqrt(gx*gx + gy*gy);
-				// average gradient
-				average += dst_pixel[x];
+		const float *src_pixel = (float*)FreeImage_GetBits(H);
+
+		// one partial sum per band, added in order
+		const unsigned threads = GetThreadCountFattal02(H);
+		std::vector<double> sums(threads);
+
+		FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
+			double average = 0;
+			for(unsigned y = first; y < last; y++) {
+				float *dst_pixel = (float*)FreeImage_GetBits(G) + y * pitch;
+				const unsigned n = (y == 0 ? 0 : y-1);
+				const unsigned s = (y+1 == height ? y : y+1);
+				for(unsigned x = 0; x < width; x++) {
+					const unsigned w = (x == 0 ? 0 : x-1);
+					const unsigned e = (x+1 == width ? x : x+1);		
+					// central difference
+					const float gx = (src_pixel[y*pitch+e] - src_pixel[y*pitch+w]) / divider; // [Hk(x+1, y) - Hk(x-1, y)] / 2**(k+1)
+					const float gy = (src_pixel[s*pitch+x] - src_pixel[n*pitch+x]) / divider; // [Hk(x, y+1) - Hk(x, y-1)] / 2**(k+1)
+					// gradient
+					dst_pixel[x] = sqrt(gx*gx + gy*gy);
+					// average gradient
+					average += dst_pixel[x];
+				}
 			}
-			// next line
-			dst_pixel += pitch;
+			sums[band] = average;
+		});
+
+		double average = 0;
+		for(unsigned i = 0; i < threads; i++) {
+			average += sums[i];
 		}
-		
-		*avgGrad = average / (width * height);
+		*avgGrad = (float)(average / ((double)width * height));
 
 		return G;
 
@@ -205,22 +226,34 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 }
 
 /**
-Calculate gradient magnitude and its average value on each pyramid level
-@param pyramid Gaussian pyramid (nlevels levels)
+Calculate gradient magnitude and its average value on each level of the Gaussian pyramid of H. 
+Gaussian levels are computed on the fly and released as soon as their gradient is known. 
+@param H Original bitmap
 @param nlevels Number of levels
 @param gradients [out] Gradient pyramid (nlevels levels)
 @param avgGrad [out] Average gradient on each level (array of size nlevels)
 @return Returns TRUE if successful, returns FALSE otherwise
 */
-static BOOL GradientPyramid(FIBITMAP **pyramid, int nlevels, FIBITMAP **gradients, float *avgGrad) {
+static BOOL GradientPyramid(FIBITMAP *H, int nlevels, FIBITMAP **gradients, float *avgGrad) {
+	// first level is the original image
+	FIBITMAP *Hk = H;
+
 	try {
 		for(int k = 0; k < nlevels; k++) {
-			FIBITMAP *Hk = pyramid[k];
 			gradients[k] = GradientLevel(Hk, &avgGrad[k], k);
 			if(gradients[k] == NULL) throw(1);
+			// compute next level
+			if(k < nlevels-1) {
+				FIBITMAP *next = GaussianLevel5x5(Hk);
+				if(Hk != H) FreeImage_Unload(Hk);
+				Hk = next;
+				if(Hk == NULL) throw(1);
+			}
 		}
+		if(Hk && (Hk != H)) FreeImage_Unload(Hk);
 		return TRUE;
 	} catch(int) {
+		if(Hk && (Hk != H)) FreeImage_Unload(Hk);
 		for(int k = 0; k < nlevels; k++) {
 			if(gradients[k] != NULL) {
 				FreeImage_Unload(gradients[k]);
@@ -231,6 +264,54 @@ static BOOL GradientPyramid(FIBITMAP **pyramid, int nlevels, FIBITMAP **gradient
 	}
 }
 
+/**
+Compute a band of lines of PHI(k) = L( PHI(k+1) ) * phi(k), 
+where phi(k) = MIN(1, (alpha / grad) * (grad / alpha) ** beta)
+@param Gk Gradient magnitude at level k
+@param L Upsampled PHI(k+1), NULL at the coarsest level
+@param PHI Output attenuation at level k
+@param ALPHA Parameter alpha at level k
+@param exponent beta - 1
+*/
+static void AttenuationFattal02(FIBITMAP *Gk, FIBITMAP *L, FIBITMAP *PHI, float ALPHA, float exponent, unsigned first, unsigned last) {
+	const unsigned width = FreeImage_GetWidth(Gk);
+
+	for(unsigned y = first; y < last; y++) {
+		const float *src_pixel = (float*)FreeImage_GetScanLine(Gk, y);
+		const float *l_pixel = L ? (float*)FreeImage_GetScanLine(L, y) : NULL;
+		float *dst_pixel = (float*)FreeImage_GetScanLine(PHI, y);
+
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0F);
+		const __m128 alpha_inv = _mm_set1_ps(1 / ALPHA);
+		const __m128 p = _mm_set1_ps(exponent);
+		for(; x + 4 <= width; x += 4) {
+			const __m128 v = _mm_mul_ps(_mm_loadu_ps(src_pixel + x), alpha_inv);
+			// a zero gradient gives an infinite value, clamped to 1
+			const __m128 positive = _mm_cmpgt_ps(v, zero);
+			__m128 value = tmo_pow_ps(v, p);
+			value = _mm_or_ps(_mm_and_ps(positive, value), _mm_andnot_ps(positive, one));
+			value = _mm_min_ps(value, one);
+			if(l_pixel) {
+				value = _mm_mul_ps(value, _mm_loadu_ps(l_pixel + x));
+			}
+			_mm_storeu_ps(dst_pixel + x, value);
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			// compute (alpha / grad) * (grad / alpha) ** beta
+			const float v = src_pixel[x] / ALPHA;
+			const float value = (float)pow((float)v, exponent);
+			dst_pixel[x] = (value > 1) ? 1 : value;
+			if(l_pixel) {
+				dst_pixel[x] *= l_pixel[x];
+			}
+		}
+	}
+}
+
 /**
 Compute the gradient attenuation function PHI(x, y)
 @param gradients Gradient pyramid (nlevels levels)
@@ -241,14 +322,10 @@ Compute the gradient attenuation function PHI(x, y)
 @return Returns the attenuation matrix Phi if successful, returns NULL otherwise
 */
 static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, float alpha, float beta) {
-	float *src_pixel, *dst_pixel;
-	FIBITMAP **phi = NULL;
+	FIBITMAP *phi = NULL;	// PHI(k+1), then PHI(k)
+	FIBITMAP *L = NULL;
 
 	try {
-		phi = (FIBITMAP**)malloc(nlevels * sizeof(FIBITMAP*));
-		if(!phi) throw(1);
-		memset(phi, 0, nlevels * sizeof(FIBITMAP*));
-
 		for(int k = nlevels-1; k >= 0; k--) {
 			// compute phi(k)
 
@@ -256,7 +333,6 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 
 			const unsigned width = FreeImage_GetWidth(Gk);
 			const unsigned height = FreeImage_GetHeight(Gk);
-			const unsigned pitch = FreeImage_GetPitch(Gk) / sizeof(float);
 
 			// parameter alpha is 0.1 times the average gradient magnitude
 			// also, note the factor of 2**k in the denominator; 
@@ -265,63 +341,37 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 			float ALPHA =  alpha * avgGrad[k] * (float)((int)1 << k);
 			if(ALPHA == 0) ALPHA = EPSILON;
 
-			phi[k] = FreeImage_AllocateT(FIT_FLOAT, width, height);
-			if(!phi[k]) throw(1);
-			
-			src_pixel = (float*)FreeImage_GetBits(Gk);
-			dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-			for(unsigned y = 0; y < height; y++) {
-				for(unsigned x = 0; x < width; x++) {
-					// compute (alpha / grad) * (grad / alpha) ** beta
-					const float v = src_pixel[x] / ALPHA;
-					const float value = (float)pow((float)v, (float)(beta-1));
-					dst_pixel[x] = (value > 1) ? 1 : value;
-				}
-				// next line
-				src_pixel += pitch;
-				dst_pixel += pitch;
+			if(phi) {
+				// upsample PHI(k+1) ...
+				L = FreeImage_Rescale(phi, width, height, FILTER_BILINEAR);
+				if(!L) throw(1);
+				// ... which is no longer needed
+				FreeImage_Unload(phi);
+				phi = NULL;
 			}
 
-			if(k < nlevels-1) {
-				// compute PHI(k) = L( PHI(k+1) ) * phi(k)
-				FIBITMAP *L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
-				if(!L) throw(1);
+			phi = FreeImage_AllocateT(FIT_FLOAT, width, height);
+			if(!phi) throw(1);
 
-				src_pixel = (float*)FreeImage_GetBits(L);
-				dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-				for(unsigned y = 0; y < height; y++) {
-					for(unsigned x = 0; x < width; x++) {
-						dst_pixel[x] *= src_pixel[x];
-					}
-					// next line
-					src_pixel += pitch;
-					dst_pixel += pitch;
-				}
+			// compute PHI(k) = L( PHI(k+1) ) * phi(k)
+			FreeImage_ParallelFor(0, height, GetThreadCountFattal02(Gk), [&](unsigned first, unsigned last, unsigned) {
+				AttenuationFattal02(Gk, L, phi, ALPHA, beta - 1, first, last);
+			});
 
+			if(L) {
 				FreeImage_Unload(L);
-
-				// PHI(k+1) is no longer needed
-				FreeImage_Unload(phi[k+1]);
-				phi[k+1] = NULL;
+				L = NULL;
 			}
 
 			// next level
 		}
 
-		// get the final result and return
-		FIBITMAP *dst = phi[0];
-
-		free(phi);
-
-		return dst;
+		// return the final result
+		return phi;
 
 	} catch(int) {
-		if(phi) {
-			for(int k = nlevels-1; k >= 0; k--) {
-				if(phi[k]) FreeImage_Unload(phi[k]);
-			}
-			free(phi);
-		}
+		if(phi) FreeImage_Unload(phi);
+		if(L) FreeImage_Unload(L);
 		return NULL;
 	}
 }
@@ -329,84 +379,52 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 /**
 Compute gradients in x and y directions, attenuate them with the attenuation matrix, 
 then compute the divergence div G from the attenuated gradient. 
+Attenuated gradients are computed on the fly, without being stored. 
 @param H Normalized luminance
 @param PHI Attenuation matrix
 @return Returns the divergence matrix if successful, returns NULL otherwise
 */
 static FIBITMAP* Divergence(FIBITMAP *H, FIBITMAP *PHI) {
-	FIBITMAP *Gx = NULL, *Gy = NULL, *divG = NULL;
-	float *phi, *h, *gx, *gy, *divg;
-
-	try {
-		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(H);
-		if(image_type != FIT_FLOAT) throw(1);
-
-		const unsigned width = FreeImage_GetWidth(H);
-		const unsigned height = FreeImage_GetHeight(H);
-
-		Gx = FreeImage_AllocateT(image_type, width, height);
-		if(!Gx) throw(1);
-		Gy = FreeImage_AllocateT(image_type, width, height);
-		if(!Gy) throw(1);
-		
-		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
-		
-		// perform gradient attenuation
-
-		phi = (float*)FreeImage_GetBits(PHI);
-		h   = (float*)FreeImage_GetBits(H);
-		gx  = (float*)FreeImage_GetBits(Gx);
-		gy  = (float*)FreeImage_GetBits(Gy);
-
-		for(unsigned y = 0; y < height; y++) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(H);
+	if(image_type != FIT_FLOAT) return NULL;
+
+	const unsigned width = FreeImage_GetWidth(H);
+	const unsigned height = FreeImage_GetHeight(H);
+
+	FIBITMAP *divG = FreeImage_AllocateT(image_type, width, height);
+	if(!divG) return NULL;
+	
+	const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
+	
+	const float *phi = (float*)FreeImage_GetBits(PHI);
+	const float *h   = (float*)FreeImage_GetBits(H);
+
+	FreeImage_ParallelFor(0, height, GetThreadCountFattal02(H), [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned y = first; y < last; y++) {
 			const unsigned s = (y+1 == height ? y : y+1);
-			for(unsigned x = 0; x < width; x++) {				
+			const float *h_y = h + y*pitch;
+			const float *h_s = h + s*pitch;
+			const float *phi_y = phi + y*pitch;
+			// previous line, for Gy(x, y-1)
+			const float *h_n = (y > 0) ? h_y - pitch : NULL;
+			const float *phi_n = (y > 0) ? phi_y - pitch : NULL;
+			float *divg = (float*)FreeImage_GetBits(divG) + y*pitch;
+			for(unsigned x = 0; x < width; x++) {
 				const unsigned e = (x+1 == width ? x : x+1);
 				// forward difference
-				const unsigned index = y*pitch + x;
-				const float phi_xy = phi[index];
-				const float h_xy   = h[index];
-				gx[x] = (h[y*pitch+e] - h_xy) * phi_xy; // [H(x+1, y) - H(x, y)] * PHI(x, y)
-				gy[x] = (h[s*pitch+x] - h_xy) * phi_xy; // [H(x, y+1) - H(x, y)] * PHI(x, y)
-			}
-			// next line
-			gx += pitch;
-			gy += pitch;
-		}
-
-		// calculate the divergence
-
-		divG = FreeImage_AllocateT(image_type, width, height);
-		if(!divG) throw(1);
-		
-		gx  = (float*)FreeImage_GetBits(Gx);
-		gy  = (float*)FreeImage_GetBits(Gy);
-		divg = (float*)FreeImage_GetBits(divG);
-
-		for(unsigned y = 0; y < height; y++) {
-			for(unsigned x = 0; x < width; x++) {				
+				const float gx = (h_y[e] - h_y[x]) * phi_y[x]; // Gx(x, y) = [H(x+1, y) - H(x, y)] * PHI(x, y)
+				const float gy = (h_s[x] - h_y[x]) * phi_y[x]; // Gy(x, y) = [H(x, y+1) - H(x, y)] * PHI(x, y)
 				// backward difference approximation
 				// divG = Gx(x, y) - Gx(x-1, y) + Gy(x, y) - Gy(x, y-1)
-				const unsigned index = y*pitch + x;
-				divg[index] = gx[index] + gy[index];
-				if(x > 0) divg[index] -= gx[index-1];
-				if(y > 0) divg[index] -= gy[index-pitch];
+				divg[x] = gx + gy;
+				if(x > 0) divg[x] -= (h_y[x] - h_y[x-1]) * phi_y[x-1];
+				if(y > 0) divg[x] -= (h_y[x] - h_n[x]) * phi_n[x];
 			}
 		}
+	});
 
-		// no longer needed ... 
-		FreeImage_Unload(Gx);
-		FreeImage_Unload(Gy);
-
-		// return the divergence
-		return divG;
-
-	} catch(int) {
-		if(Gx) FreeImage_Unload(Gx);
-		if(Gy) FreeImage_Unload(Gy);
-		if(divG) FreeImage_Unload(divG);
-		return NULL;
-	}
+	// return the divergence
+	return divG;
 }
 
 /**
@@ -416,52 +434,62 @@ normalize to range 0..100 and take the logarithm.
 @return Returns the normalized luminance H if successful, returns NULL otherwise
 */
 static FIBITMAP* LogLuminance(FIBITMAP *Y) {
-	FIBITMAP *H = NULL;
+	// get the luminance channel
+	FIBITMAP *H = FreeImage_Clone(Y);
+	if(!H) return NULL;
 
-	try {
-		// get the luminance channel
-		FIBITMAP *H = FreeImage_Clone(Y);
-		if(!H) throw(1);
+	const unsigned width  = FreeImage_GetWidth(H);
+	const unsigned height = FreeImage_GetHeight(H);
+	const unsigned threads = GetThreadCountFattal02(H);
 
-		const unsigned width  = FreeImage_GetWidth(H);
-		const unsigned height = FreeImage_GetHeight(H);
-		const unsigned pitch  = FreeImage_GetPitch(H);
-
-		// find max & min luminance values
+	// find max & min luminance values (one partial result per band)
+	std::vector<float> max_band(threads), min_band(threads);
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
 		float maxLum = -1e20F, minLum = 1e20F;
-
-		BYTE *bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			const float *pixel = (float*)bits;
+		for(unsigned y = first; y < last; y++) {
+			const float *pixel = (float*)FreeImage_GetScanLine(H, y);
 			for(unsigned x = 0; x < width; x++) {
 				const float value = pixel[x];
 				maxLum = (maxLum < value) ? value : maxLum;	// max Luminance in the scene
 				minLum = (minLum < value) ? minLum : value;	// min Luminance in the scene
 			}
-			// next line
-			bits += pitch;
 		}
-		if(maxLum == minLum) throw(1);
+		max_band[band] = maxLum;
+		min_band[band] = minLum;
+	});
+	float maxLum = -1e20F, minLum = 1e20F;
+	for(unsigned i = 0; i < threads; i++) {
+		maxLum = (maxLum < max_band[i]) ? max_band[i] : maxLum;
+		minLum = (minLum < min_band[i]) ? minLum : min_band[i];
+	}
+	if(maxLum == minLum) {
+		FreeImage_Unload(H);
+		return NULL;
+	}
 
-		// normalize to range 0..100 and take the logarithm
-		const float scale = 100.F / (maxLum - minLum);
-		bits = (BYTE*)FreeImage_GetBits(H);
-		for(unsigned y = 0; y < height; y++) {
-			float *pixel = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
+	// normalize to range 0..100 and take the logarithm
+	const float scale = 100.F / (maxLum - minLum);
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned y = first; y < last; y++) {
+			float *pixel = (float*)FreeImage_GetScanLine(H, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128 vmin = _mm_set1_ps(minLum);
+			const __m128 vscale = _mm_set1_ps(scale);
+			const __m128 epsilon = _mm_set1_ps(EPSILON);
+			for(; x + 4 <= width; x += 4) {
+				const __m128 value = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pixel + x), vmin), vscale);
+				_mm_storeu_ps(pixel + x, tmo_log_ps(_mm_add_ps(value, epsilon)));
+			}
+#endif // FREEIMAGE_SSE2
+			for(; x < width; x++) {
 				const float value = (pixel[x] - minLum) * scale;
 				pixel[x] = log(value + EPSILON);
 			}
-			// next line
-			bits += pitch;
 		}
+	});
 
-		return H;
-
-	} catch(int) {
-		if(H) FreeImage_Unload(H);
-		return NULL;
-	}
+	return H;
 }
 
 /**
@@ -471,16 +499,22 @@ Given a normalized luminance, perform exponentiation and recover the log compres
 static void ExpLuminance(FIBITMAP *Y) {
 	const unsigned width = FreeImage_GetWidth(Y);
 	const unsigned height = FreeImage_GetHeight(Y);
-	const unsigned pitch = FreeImage_GetPitch(Y);
 
-	BYTE *bits = (BYTE*)FreeImage_GetBits(Y);
-	for(unsigned y = 0; y < height; y++) {
-		float *pixel = (float*)bits;
-		for(unsigned x = 0; x < width; x++) {
-			pixel[x] = exp(pixel[x]) - EPSILON;
+	FreeImage_ParallelFor(0, height, GetThreadCountFattal02(Y), [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned y = first; y < last; y++) {
+			float *pixel = (float*)FreeImage_GetScanLine(Y, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128 epsilon = _mm_set1_ps(EPSILON);
+			for(; x + 4 <= width; x += 4) {
+				_mm_storeu_ps(pixel + x, _mm_sub_ps(tmo_exp_ps(_mm_loadu_ps(pixel + x)), epsilon));
+			}
+#endif // FREEIMAGE_SSE2
+			for(; x < width; x++) {
+				pixel[x] = exp(pixel[x]) - EPSILON;
+			}
 		}
-		bits += pitch;
-	}
+	});
 }
 
 // --------------------------------------------------------------------------
@@ -496,7 +530,6 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 	const unsigned MIN_PYRAMID_SIZE = 32;	// minimun size (width or height) of the coarsest level of the pyramid
 
 	FIBITMAP *H = NULL;
-	FIBITMAP **pyramid = NULL;
 	FIBITMAP **gradients = NULL;
 	FIBITMAP *phy = NULL;
 	FIBITMAP *divG = NULL;
@@ -508,7 +541,7 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 
 	try {
 		// get the normalized luminance
-		FIBITMAP *H = LogLuminance(Y);
+		H = LogLuminance(Y);
 		if(!H) throw(1);
 		
 		// get the number of levels for the pyramid
@@ -519,28 +552,16 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 			nlevels++;
 			minsize /= 2;
 		}
+		if(nlevels == 0) throw(1);
 
-		// create the Gaussian pyramid
-		pyramid = (FIBITMAP**)malloc(nlevels * sizeof(FIBITMAP*));
-		if(!pyramid) throw(1);
-		memset(pyramid, 0, nlevels * sizeof(FIBITMAP*));
-
-		if(!GaussianPyramid(H, pyramid, nlevels)) throw(1);
-
-		// calculate gradient magnitude and its average value on each pyramid level
+		// calculate gradient magnitude and its average value on each level of the Gaussian pyramid
 		gradients = (FIBITMAP**)malloc(nlevels * sizeof(FIBITMAP*));
 		if(!gradients) throw(1);
 		memset(gradients, 0, nlevels * sizeof(FIBITMAP*));
 		avgGrad = (float*)malloc(nlevels * sizeof(float));
 		if(!avgGrad) throw(1);
 
-		if(!GradientPyramid(pyramid, nlevels, gradients, avgGrad)) throw(1);
-
-		// free the Gaussian pyramid
-		for(k = 0; k < nlevels; k++) {
-			if(pyramid[k]) FreeImage_Unload(pyramid[k]);
-		}
-		free(pyramid); pyramid = NULL;
+		if(!GradientPyramid(H, nlevels, gradients, avgGrad)) throw(1);
 
 		// compute the gradient attenuation function PHI(x, y)
 		phy = PhiMatrix(gradients, avgGrad, nlevels, alpha, beta);
@@ -563,7 +584,7 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		FreeImage_Unload(phy); phy = NULL;
 
 		// solve the PDE (Poisson equation) using a multigrid solver and 3 cycles
-		FIBITMAP *U = FreeImage_MultigridPoissonSolver(divG, 3);
+		U = FreeImage_MultigridPoissonSolverEx(divG, 3, FI_POISSON_RECTANGULAR);
 		if(!U) throw(1);
 
 		FreeImage_Unload(divG);
@@ -575,12 +596,6 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 
 	} catch(int) {
 		if(H) FreeImage_Unload(H);
-		if(pyramid) {
-			for(int i = 0; i < nlevels; i++) {
-				if(pyramid[i]) FreeImage_Unload(pyramid[i]);
-			}
-			free(pyramid);
-		}
 		if(gradients) {
 			for(int i = 0; i < nlevels; i++) {
 				if(gradients[i]) FreeImage_Unload(gradients[i]);
@@ -596,6 +611,57 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 	}
 }
 
+/**
+Compress the dynamic range of a band of lines and convert them to 24-bit RGB : 
+color = (color / Lin) ** s * Lout, clamped to display white
+@param src Input RGBF image
+@param Yin Input luminance
+@param Yout Tone mapped luminance
+@param dst Output 24-bit image
+@param s Color saturation exponent
+*/
+static void CompressRangeFattal02(FIBITMAP *src, FIBITMAP *Yin, FIBITMAP *Yout, FIBITMAP *dst, float s, unsigned first, unsigned last) {
+	const unsigned width = FreeImage_GetWidth(src);
+
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *color = (FIRGBF*)FreeImage_GetScanLine(src, y);
+		const float *Lin = (float*)FreeImage_GetScanLine(Yin, y);
+		const float *Lout = (float*)FreeImage_GetScanLine(Yout, y);
+		BYTE *dst_pixel = FreeImage_GetScanLine(dst, y);
+
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0F);
+		const __m128 exponent = _mm_set1_ps(s);
+		for(; x + 4 <= width; x += 4) {
+			__m128 red, green, blue;
+			tmo_LoadRGBF(&color[x], red, green, blue);
+			const __m128 lin = _mm_loadu_ps(Lin + x);
+			const __m128 lout = _mm_and_ps(_mm_loadu_ps(Lout + x), _mm_cmpgt_ps(lin, zero));
+			const __m128 lin_inv = _mm_div_ps(one, _mm_max_ps(lin, _mm_set1_ps(1e-30F)));
+			red = _mm_mul_ps(tmo_pow_ps(_mm_mul_ps(red, lin_inv), exponent), lout);
+			green = _mm_mul_ps(tmo_pow_ps(_mm_mul_ps(green, lin_inv), exponent), lout);
+			blue = _mm_mul_ps(tmo_pow_ps(_mm_mul_ps(blue, lin_inv), exponent), lout);
+			tmo_StoreRGB24(dst_pixel, red, green, blue);
+			dst_pixel += 12;
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			float red = 0, green = 0, blue = 0;
+			if(Lin[x] > 0) {
+				red   = pow(color[x].red / Lin[x], s) * Lout[x];
+				green = pow(color[x].green / Lin[x], s) * Lout[x];
+				blue  = pow(color[x].blue / Lin[x], s) * Lout[x];
+			}
+			dst_pixel[FI_RGBA_RED]   = tmo_ClampToByte(red);
+			dst_pixel[FI_RGBA_GREEN] = tmo_ClampToByte(green);
+			dst_pixel[FI_RGBA_BLUE]  = tmo_ClampToByte(blue);
+			dst_pixel += 3;
+		}
+	}
+}
+
 // ----------------------------------------------------------
 //  Main algorithm
 // ----------------------------------------------------------
@@ -622,8 +688,8 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 
 	try {
 
-		// convert to RGBF
-		src = FreeImage_ConvertToRGBF(dib);
+		// convert to RGBF (the input is only read)
+		src = (FreeImage_GetImageType(dib) == FIT_RGBF) ? dib : FreeImage_ConvertToRGBF(dib);
 		if(!src) throw(1);
 
 		// get the luminance channel
@@ -638,42 +704,23 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		//NormalizeY(Yout, 0.001F, 0.995F);
 		NormalizeY(Yout, 0, 1);
 
-		// compress the dynamic range
-
 		const unsigned width = FreeImage_GetWidth(src);
 		const unsigned height = FreeImage_GetHeight(src);
 
-		const unsigned rgb_pitch = FreeImage_GetPitch(src);
-		const unsigned y_pitch = FreeImage_GetPitch(Yin);
-
-		BYTE *bits      = (BYTE*)FreeImage_GetBits(src);
-		BYTE *bits_yin  = (BYTE*)FreeImage_GetBits(Yin);
-		BYTE *bits_yout = (BYTE*)FreeImage_GetBits(Yout);
-
-		for(unsigned y = 0; y < height; y++) {
-			float *Lin = (float*)bits_yin;
-			float *Lout = (float*)bits_yout;
-			float *color = (float*)bits;
-			for(unsigned x = 0; x < width; x++) {
-				for(unsigned c = 0; c < 3; c++) {
-					*color = (Lin[x] > 0) ? pow(*color/Lin[x], s) * Lout[x] : 0;
-					color++;
-				}
-			}
-			bits += rgb_pitch;
-			bits_yin += y_pitch;
-			bits_yout += y_pitch;
-		}
-
-		// not needed anymore
-		FreeImage_Unload(Yin);  Yin  = NULL;
-		FreeImage_Unload(Yout); Yout = NULL;
+		dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		if(!dst) throw(1);
 
+		// compress the dynamic range, 
 		// clamp image highest values to display white, then convert to 24-bit RGB
-		dst = ClampConvertRGBFTo24(src);
+		FreeImage_ParallelFor(0, height, GetThreadCountFattal02(src), [&](unsigned first, unsigned last, unsigned) {
+			CompressRangeFattal02(src, Yin, Yout, dst, s, first, last);
+		});
 
 		// clean-up and return
-		FreeImage_Unload(src); src = NULL;
+		FreeImage_Unload(Yin);  Yin  = NULL;
+		FreeImage_Unload(Yout); Yout = NULL;
+		if(src != dib) FreeImage_Unload(src);
+		src = NULL;
 
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, dib);
@@ -681,7 +728,7 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		return dst;
 
 	} catch(int) {
-		if(src) FreeImage_Unload(src);
+		if(src && (src != dib)) FreeImage_Unload(src);
 		if(Yin) FreeImage_Unload(Yin);
 		if(Yout) FreeImage_Unload(Yout);
 		return NULL;
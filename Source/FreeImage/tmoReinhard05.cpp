@@ -23,6 +23,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "Parallel.h"
 
 // ----------------------------------------------------------
 // Global and/or local tone mapping operator
@@ -34,169 +35,319 @@
 // ----------------------------------------------------------
 
 /**
-Tone mapping operator
-@param dib Input / Output RGBF image
-@param Y Input luminance image version of dib
-@param f Overall intensity in range [-8:8] : default to 0
-@param m Contrast in range [0.3:1) : default to 0
-@param a Adaptation in range [0:1] : default to 1
-@param c Color correction in range [0:1] : default to 0
-@return Returns TRUE if successful, returns FALSE otherwise
-@see LuminanceFromY
+Parameters of the tone mapping operator
 */
-static BOOL 
-ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, float c) {
-	float Cav[3];		// channel average
-	float Lav = 0;		// average luminance
-	float Llav = 0;		// log average luminance
-	float minLum = 1;	// min luminance
-	float maxLum = 1;	// max luminance
-
-	float L;		// pixel luminance
-	float I_g, I_l; // global and local light adaptation
-	float I_a;		// interpolated pixel light adaptation
-	float k = 0;	// key (low-key means overall dark image, high-key means overall light image)
+typedef struct tagReinhard05Params {
+	float f;		// exp(-intensity)
+	float m;		// contrast
+	float a;		// adaptation
+	float c;		// color correction
+	float Cav[3];	// channel average
+	float Lav;		// average luminance
+	BOOL global;	// default values (a == 1) and (c == 0): the adaptation is the pixel luminance
+} Reinhard05Params;
 
-	// check input parameters 
+/**
+Statistics of a band of pixels
+*/
+typedef struct tagReinhard05Stats {
+	float max_lum;		// max luminance
+	float min_lum;		// min luminance
+	double sum_lum;		// sum of the luminance
+	double sum_log;		// sum of the log luminance
+	double sum_color[3];// sum of each channel
+	float max_color;	// max tone mapped value
+	float min_color;	// min tone mapped value
+} Reinhard05Stats;
 
-	if((FreeImage_GetImageType(dib) != FIT_RGBF) || (FreeImage_GetImageType(Y) != FIT_FLOAT)) {
-		return FALSE;
-	}
+/**
+Get the luminance of a RGBF pixel, as computed by ConvertRGBFToY
+*/
+static inline float 
+LuminanceReinhard05(const FIRGBF& pixel) {
+	const float L = LUMA_REC709(pixel.red, pixel.green, pixel.blue);
+	return (L > 0) ? L : 0;
+}
 
-	if(f < -8) f = -8; if(f > 8) f = 8;
-    if(m < 0)  m = 0;  if(m > 1) m = 1;
-    if(a < 0)  a = 0;  if(a > 1) a = 1;
-    if(c < 0)  c = 0;  if(c > 1) c = 1;
+#ifdef FREEIMAGE_SSE2
 
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
+/**
+SSE2 version of LuminanceReinhard05, for 4 pixels
+*/
+static inline __m128 
+LuminanceReinhard05(__m128 red, __m128 green, __m128 blue) {
+	const __m128 L = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2126F), red), _mm_mul_ps(_mm_set1_ps(0.7152F), green)), _mm_mul_ps(_mm_set1_ps(0.0722F), blue));
+	return _mm_max_ps(L, _mm_setzero_ps());
+}
 
-	const unsigned dib_pitch  = FreeImage_GetPitch(dib);
-	const unsigned y_pitch    = FreeImage_GetPitch(Y);
+#endif // FREEIMAGE_SSE2
 
-	int i;
-	unsigned x, y;
-	BYTE *bits = NULL, *Ybits = NULL;
+/**
+Get the luminance statistics and channel sums over a band of scanlines
+@param dib Input RGBF image
+@param first First scanline to process
+@param last Last scanline to process (excluded)
+@param luminance Compute the luminance statistics
+@param channels Compute the channel sums
+@param stats Output statistics
+*/
+static void 
+StatsReinhard05(FIBITMAP *dib, unsigned first, unsigned last, BOOL luminance, BOOL channels, Reinhard05Stats *stats) {
+	const unsigned width = FreeImage_GetWidth(dib);
+
+	float max_lum = -1e20F, min_lum = 1e20F;
+	double sum_lum = 0, sum_log = 0;
+	double sum_color[3] = { 0, 0, 0 };
+
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		if(luminance) {
+			const __m128 contrast = _mm_set1_ps(2.3e-5F);
+			__m128 vmax = _mm_set1_ps(max_lum);
+			__m128 vmin = _mm_set1_ps(min_lum);
+			__m128 vsum = _mm_setzero_ps();
+			__m128 vsum_log = _mm_setzero_ps();
+			__m128 vsum_color[3] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			for(; x + 4 <= width; x += 4) {
+				__m128 red, green, blue;
+				tmo_LoadRGBF(&pixel[x], red, green, blue);
+				const __m128 L = LuminanceReinhard05(red, green, blue);
+				vmax = _mm_max_ps(L, vmax);
+				vmin = _mm_min_ps(L, vmin);
+				vsum = _mm_add_ps(vsum, L);
+				vsum_log = _mm_add_ps(vsum_log, tmo_log_ps(_mm_add_ps(L, contrast)));
+				if(channels) {
+					vsum_color[0] = _mm_add_ps(vsum_color[0], red);
+					vsum_color[1] = _mm_add_ps(vsum_color[1], green);
+					vsum_color[2] = _mm_add_ps(vsum_color[2], blue);
+				}
+			}
+			float v[4][4];
+			_mm_storeu_ps(v[0], vmax);
+			_mm_storeu_ps(v[1], vmin);
+			_mm_storeu_ps(v[2], vsum);
+			_mm_storeu_ps(v[3], vsum_log);
+			for(int k = 0; k < 4; k++) {
+				max_lum = (max_lum < v[0][k]) ? v[0][k] : max_lum;
+				min_lum = (min_lum < v[1][k]) ? min_lum : v[1][k];
+				sum_lum += v[2][k];
+				sum_log += v[3][k];
+			}
+			for(int i = 0; i < 3; i++) {
+				_mm_storeu_ps(v[0], vsum_color[i]);
+				sum_color[i] += (double)v[0][0] + v[0][1] + v[0][2] + v[0][3];
+			}
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			if(luminance) {
+				const float L = LuminanceReinhard05(pixel[x]);
+				max_lum = (max_lum < L) ? L : max_lum;	// max Luminance in the scene
+				min_lum = (min_lum < L) ? min_lum : L;	// min Luminance in the scene
+				sum_lum += L;							// average luminance
+				sum_log += log(2.3e-5F + L);			// contrast constant in Tumblin paper
+			}
+			if(channels) {
+				sum_color[0] += pixel[x].red;
+				sum_color[1] += pixel[x].green;
+				sum_color[2] += pixel[x].blue;
+			}
+		}
+	}
 
-	// get statistics about the data (but only if its really needed)
+	stats->max_lum = max_lum;
+	stats->min_lum = min_lum;
+	stats->sum_lum = sum_lum;
+	stats->sum_log = sum_log;
+	for(int i = 0; i < 3; i++) {
+		stats->sum_color[i] = sum_color[i];
+	}
+}
 
-	f = exp(-f);
-	if((m == 0) || (a != 1) && (c != 1)) {
-		// avoid these calculations if its not needed after ...
-		LuminanceFromY(Y, &maxLum, &minLum, &Lav, &Llav);
-		k = (log(maxLum) - Llav) / (log(maxLum) - log(minLum));
-		if(k < 0) {
-			// pow(k, 1.4F) is undefined ...
-			// there's an ambiguity about the calculation of Llav between Reinhard papers and the various implementations  ...
-			// try another world adaptation luminance formula using instead 'worldLum = log(Llav)'
-			k = (log(maxLum) - log(Llav)) / (log(maxLum) - log(minLum));
-			if(k < 0) m = 0.3F;
+/**
+Tone map a RGBF pixel, before normalization
+*/
+static inline void 
+ToneMapPixelReinhard05(const Reinhard05Params& params, const FIRGBF& pixel, float color[3]) {
+	const float L = LuminanceReinhard05(pixel);	// luminance(x, y)
+	color[0] = pixel.red;
+	color[1] = pixel.green;
+	color[2] = pixel.blue;
+	if(params.global) {
+		const float I_a = (float)pow(params.f * L, params.m);
+		for(int i = 0; i < 3; i++) {
+			color[i] /= (color[i] + I_a);
+		}
+	} else {
+		for(int i = 0; i < 3; i++) {
+			const float I_l = params.c * color[i] + (1 - params.c) * L;		// local light adaptation
+			const float I_g = params.c * params.Cav[i] + (1 - params.c) * params.Lav;	// global light adaptation
+			const float I_a = params.a * I_l + (1 - params.a) * I_g;		// interpolated pixel light adaptation
+			color[i] /= (color[i] + (float)pow(params.f * I_a, params.m));
 		}
 	}
-	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
-
-	float max_color = -1e6F;
-	float min_color = +1e6F;
+}
 
-	// tone map image
+#ifdef FREEIMAGE_SSE2
 
-	bits  = (BYTE*)FreeImage_GetBits(dib);
-	Ybits = (BYTE*)FreeImage_GetBits(Y);
+/**
+SSE2 version of ToneMapPixelReinhard05, for 4 pixels
+*/
+static inline void 
+ToneMapPixelsReinhard05(const Reinhard05Params& params, const FIRGBF *pixel, __m128 color[3]) {
+	const __m128 f = _mm_set1_ps(params.f);
+	const __m128 m = _mm_set1_ps(params.m);
+
+	tmo_LoadRGBF(pixel, color[0], color[1], color[2]);
+	const __m128 L = LuminanceReinhard05(color[0], color[1], color[2]);
+	if(params.global) {
+		const __m128 I_a = tmo_pow_ps(_mm_mul_ps(f, L), m);
+		for(int i = 0; i < 3; i++) {
+			color[i] = _mm_div_ps(color[i], _mm_add_ps(color[i], I_a));
+		}
+	} else {
+		const __m128 c = _mm_set1_ps(params.c);
+		const __m128 c1 = _mm_set1_ps(1 - params.c);
+		const __m128 a = _mm_set1_ps(params.a);
+		const __m128 a1 = _mm_set1_ps(1 - params.a);
+		for(int i = 0; i < 3; i++) {
+			const __m128 I_l = _mm_add_ps(_mm_mul_ps(c, color[i]), _mm_mul_ps(c1, L));
+			const __m128 I_g = _mm_set1_ps(params.c * params.Cav[i] + (1 - params.c) * params.Lav);
+			const __m128 I_a = _mm_add_ps(_mm_mul_ps(a, I_l), _mm_mul_ps(a1, I_g));
+			color[i] = _mm_div_ps(color[i], _mm_add_ps(color[i], tmo_pow_ps(_mm_mul_ps(f, I_a), m)));
+		}
+	}
+}
 
-	if((a == 1) && (c == 0)) {
-		// when using default values, use a fastest code
+#endif // FREEIMAGE_SSE2
 
-		for(y = 0; y < height; y++) {
-			float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
+/**
+Get the range of the tone mapped values over a band of scanlines
+@param dib Input RGBF image
+@param work If not NULL, output RGBF image receiving the tone mapped values
+@param params Operator parameters
+@param first First scanline to process
+@param last Last scanline to process (excluded)
+@param stats Output statistics
+*/
+static void 
+ColorRangeReinhard05(FIBITMAP *dib, FIBITMAP *work, const Reinhard05Params& params, unsigned first, unsigned last, Reinhard05Stats *stats) {
+	const unsigned width = FreeImage_GetWidth(dib);
 
-			for(x = 0; x < width; x++) {
-				I_a = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
+	float max_color = -1e6F;
+	float min_color = +1e6F;
 
-					color++;
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		FIRGBF *work_pixel = work ? (FIRGBF*)FreeImage_GetScanLine(work, y) : NULL;
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		__m128 vmax = _mm_set1_ps(max_color);
+		__m128 vmin = _mm_set1_ps(min_color);
+		for(; x + 4 <= width; x += 4) {
+			__m128 color[3];
+			ToneMapPixelsReinhard05(params, &pixel[x], color);
+			for(int i = 0; i < 3; i++) {
+				// NaN values are ignored
+				vmax = _mm_max_ps(color[i], vmax);
+				vmin = _mm_min_ps(color[i], vmin);
+			}
+			if(work_pixel) {
+				float c[3][4];
+				for(int i = 0; i < 3; i++) {
+					_mm_storeu_ps(c[i], color[i]);
+				}
+				for(int k = 0; k < 4; k++) {
+					work_pixel[x + k].red   = c[0][k];
+					work_pixel[x + k].green = c[1][k];
+					work_pixel[x + k].blue  = c[2][k];
 				}
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
 		}
-	} else {
-		// complete algorithm
-
-		// channel averages
-
-		Cav[0] = Cav[1] = Cav[2] = 0;
-		if((a != 1) && (c != 0)) {
-			// channel averages are not needed when (a == 1) or (c == 0)
-			bits = (BYTE*)FreeImage_GetBits(dib);
-			for(y = 0; y < height; y++) {
-				float *color = (float*)bits;
-				for(x = 0; x < width; x++) {
-					for(i = 0; i < 3; i++) {
-						Cav[i] += *color;
-						color++;
-					}
-				}
-				// next line
-				bits += dib_pitch;
+		float v[2][4];
+		_mm_storeu_ps(v[0], vmax);
+		_mm_storeu_ps(v[1], vmin);
+		for(int k = 0; k < 4; k++) {
+			max_color = (v[0][k] > max_color) ? v[0][k] : max_color;
+			min_color = (v[1][k] < min_color) ? v[1][k] : min_color;
+		}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			float color[3];
+			ToneMapPixelReinhard05(params, pixel[x], color);
+			for(int i = 0; i < 3; i++) {
+				max_color = (color[i] > max_color) ? color[i] : max_color;
+				min_color = (color[i] < min_color) ? color[i] : min_color;
 			}
-			const float image_size = (float)width * height;
-			for(i = 0; i < 3; i++) {
-				Cav[i] /= image_size;
+			if(work_pixel) {
+				work_pixel[x].red   = color[0];
+				work_pixel[x].green = color[1];
+				work_pixel[x].blue  = color[2];
 			}
 		}
+	}
 
-		// perform tone mapping
-
-		bits = (BYTE*)FreeImage_GetBits(dib);
-		for(y = 0; y < height; y++) {
-			const float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for(x = 0; x < width; x++) {
-				L = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					I_l = c * *color + (1-c) * L;
-					I_g = c * Cav[i] + (1-c) * Lav;
-					I_a = a * I_l + (1-a) * I_g;
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
-
-					color++;
-				}
+	stats->max_color = max_color;
+	stats->min_color = min_color;
+}
+
+/**
+Tone map a band of scanlines, normalize the intensities and convert to 24-bit RGB
+@param dib Input RGBF image
+@param work If not NULL, tone mapped values computed by ColorRangeReinhard05
+@param dst Output 24-bit image
+@param params Operator parameters
+@param min_color Minimum tone mapped value
+@param max_color Maximum tone mapped value
+@param first First scanline to process
+@param last Last scanline to process (excluded)
+*/
+static void 
+ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *work, FIBITMAP *dst, const Reinhard05Params& params, float min_color, float max_color, unsigned first, unsigned last) {
+	const unsigned width = FreeImage_GetWidth(dib);
+
+	// normalize intensities (no normalization if the range is empty)
+	const float offset = (max_color != min_color) ? min_color : 0;
+	const float scale = (max_color != min_color) ? 1 / (max_color - min_color) : 1;
+
+	for(unsigned y = first; y < last; y++) {
+		const FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		const FIRGBF *work_pixel = work ? (FIRGBF*)FreeImage_GetScanLine(work, y) : NULL;
+		BYTE *dst_pixel = FreeImage_GetScanLine(dst, y);
+		unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+		const __m128 voffset = _mm_set1_ps(offset);
+		const __m128 vscale = _mm_set1_ps(scale);
+		for(; x + 4 <= width; x += 4) {
+			__m128 color[3];
+			if(work) {
+				tmo_LoadRGBF(&work_pixel[x], color[0], color[1], color[2]);
+			} else {
+				ToneMapPixelsReinhard05(params, &pixel[x], color);
+			}
+			for(int i = 0; i < 3; i++) {
+				color[i] = _mm_mul_ps(_mm_sub_ps(color[i], voffset), vscale);
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
+			tmo_StoreRGB24(dst_pixel + 3 * x, color[0], color[1], color[2]);
 		}
-	}
-
-	// normalize intensities
-
-	if(max_color != min_color) {
-		bits = (BYTE*)FreeImage_GetBits(dib);
-		const float range = max_color - min_color;
-		for(y = 0; y < height; y++) {
-			float *color = (float*)bits;
-			for(x = 0; x < width; x++) {
-				for(i = 0; i < 3; i++) {
-					*color = (*color - min_color) / range;
-					color++;
-				}
+#endif // FREEIMAGE_SSE2
+		for(; x < width; x++) {
+			float color[3];
+			if(work) {
+				color[0] = work_pixel[x].red;
+				color[1] = work_pixel[x].green;
+				color[2] = work_pixel[x].blue;
+			} else {
+				ToneMapPixelReinhard05(params, pixel[x], color);
 			}
-			// next line
-			bits += dib_pitch;
+			BYTE *p = dst_pixel + 3 * x;
+			p[FI_RGBA_RED]   = tmo_ClampToByte((color[0] - offset) * scale);
+			p[FI_RGBA_GREEN] = tmo_ClampToByte((color[1] - offset) * scale);
+			p[FI_RGBA_BLUE]  = tmo_ClampToByte((color[2] - offset) * scale);
 		}
 	}
-
-	return TRUE;
 }
 
 // ----------------------------------------------------------
@@ -217,28 +368,125 @@ FIBITMAP* DLL_CALLCONV
 FreeImage_TmoReinhard05Ex(FIBITMAP *src, double intensity, double contrast, double adaptation, double color_correction) {
 	if(!FreeImage_HasPixels(src)) return NULL;
 
-	// working RGBF variable
-	FIBITMAP *dib = NULL, *Y = NULL;
-
-	dib = FreeImage_ConvertToRGBF(src);
+	// working RGBF variable (the operator does not modify it)
+	FIBITMAP *dib = (FreeImage_GetImageType(src) == FIT_RGBF) ? src : FreeImage_ConvertToRGBF(src);
 	if(!dib) return NULL;
 
-	// get the Luminance channel
-	Y = ConvertRGBFToY(dib);
-	if(!Y) {
-		FreeImage_Unload(dib);
+	const unsigned width  = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(!dst) {
+		if(dib != src) FreeImage_Unload(dib);
 		return NULL;
 	}
 
-	// perform the tone mapping
-	ToneMappingReinhard05(dib, Y, (float)intensity, (float)contrast, (float)adaptation, (float)color_correction);
-	// not needed anymore
-	FreeImage_Unload(Y);
+	// check input parameters 
+
+	float f = (float)intensity, m = (float)contrast, a = (float)adaptation, c = (float)color_correction;
+	if(f < -8) f = -8;
+	if(f > 8)  f = 8;
+	if(m < 0)  m = 0;
+	if(m > 1)  m = 1;
+	if(a < 0)  a = 0;
+	if(a > 1)  a = 1;
+	if(c < 0)  c = 0;
+	if(c > 1)  c = 1;
+
+	Reinhard05Params params;
+	params.f = (float)exp(-f);
+	params.a = a;
+	params.c = c;
+	params.global = ((a == 1) && (c == 0)) ? TRUE : FALSE;
+	params.Cav[0] = params.Cav[1] = params.Cav[2] = 0;
+	params.Lav = 0;
+
+	// FreeImage_ParallelFor never runs more bands than rows: every partial result must be filled
+	const unsigned threads = MIN(FreeImage_GetThreadCount((size_t)width * height, TMO_MIN_THREAD_PIXELS), height);
+	std::vector<Reinhard05Stats> stats(threads);
+
+	// get statistics about the data (but only if its really needed)
+
+	float k = 0;	// key (low-key means overall dark image, high-key means overall light image)
+
+	// luminance statistics are not needed when using the contrast and (a == 1) or (c == 1)
+	const BOOL luminance = ((m == 0) || ((a != 1) && (c != 1))) ? TRUE : FALSE;
+	// channel averages are not needed when (a == 1) or (c == 0)
+	const BOOL channels = ((a != 1) && (c != 0)) ? TRUE : FALSE;
+
+	if(luminance || channels) {
+		FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
+			StatsReinhard05(dib, first, last, luminance, channels, &stats[band]);
+		});
+		float maxLum = -1e20F, minLum = 1e20F;
+		double sum_lum = 0, sum_log = 0;
+		double sum_color[3] = { 0, 0, 0 };
+		for(unsigned i = 0; i < threads; i++) {
+			maxLum = (maxLum < stats[i].max_lum) ? stats[i].max_lum : maxLum;
+			minLum = (minLum < stats[i].min_lum) ? minLum : stats[i].min_lum;
+			sum_lum += stats[i].sum_lum;
+			sum_log += stats[i].sum_log;
+			for(int j = 0; j < 3; j++) {
+				sum_color[j] += stats[i].sum_color[j];
+			}
+		}
+		const double image_size = (double)width * height;
+		if(channels) {
+			for(int j = 0; j < 3; j++) {
+				params.Cav[j] = (float)(sum_color[j] / image_size);
+			}
+		}
+		if(luminance) {
+			// average luminance
+			params.Lav = (float)(sum_lum / image_size);
+			// average log luminance, a.k.a. world adaptation luminance
+			const float Llav = (float)exp(sum_log / image_size);
+
+			k = (log(maxLum) - Llav) / (log(maxLum) - log(minLum));
+			if(k < 0) {
+				// pow(k, 1.4F) is undefined ...
+				// there's an ambiguity about the calculation of Llav between Reinhard papers and the various implementations  ...
+				// try another world adaptation luminance formula using instead 'worldLum = log(Llav)'
+				k = (log(maxLum) - log(Llav)) / (log(maxLum) - log(minLum));
+				if(k < 0) m = 0.3F;
+			}
+		}
+	}
+	params.m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
+
+	// get the range of the tone mapped values
+	// the complete algorithm computes 3 powers per pixel: keep its results for the normalization, 
+	// in place when working on a converted copy of src
+
+	FIBITMAP *work = NULL;
+	if(!params.global) {
+		work = (dib != src) ? dib : FreeImage_AllocateT(FIT_RGBF, width, height);
+	}
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned band) {
+		ColorRangeReinhard05(dib, work, params, first, last, &stats[band]);
+	});
+	float max_color = -1e6F;
+	float min_color = +1e6F;
+	for(unsigned i = 0; i < threads; i++) {
+		max_color = (stats[i].max_color > max_color) ? stats[i].max_color : max_color;
+		min_color = (stats[i].min_color < min_color) ? stats[i].min_color : min_color;
+	}
+
+	// tone map image, normalize intensities, 
 	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		ToneMappingReinhard05(dib, work, dst, params, min_color, max_color, first, last);
+	});
 
 	// clean-up and return
-	FreeImage_Unload(dib);
+	if(work && (work != dib)) {
+		FreeImage_Unload(work);
+	}
+	if(dib != src) {
+		FreeImage_Unload(dib);
+	}
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(dst, src);
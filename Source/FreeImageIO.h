@@ -60,4 +60,37 @@ void SetDefaultIO(FreeImageIO *io);
 
 void SetMemoryIO(FreeImageIO *io);
 
+// ----------------------------------------------------------
+
+/**
+Read-only, zero-copy view of a stream, from its current position to the end of the stream.
+Memory streams (FIMEMORY) are viewed in place and files opened with the default IO are memory-mapped, 
+so that decoders able to work on a contiguous buffer can bypass the FreeImageIO callbacks. 
+Any other stream, or a file which cannot be mapped, gives an empty view: 
+the caller must then fall back to reading through the FreeImageIO functions. 
+The stream position is left unchanged.
+*/
+class FIStreamView {
+public:
+	FIStreamView(FreeImageIO *io, fi_handle handle);
+	~FIStreamView();
+	/// Returns TRUE if the view is available
+	BOOL isValid() const { return _data ? TRUE : FALSE; }
+	/// Start of the viewed bytes (i.e. the stream current position)
+	BYTE* data() const { return _data; }
+	/// Number of bytes from the stream current position to the end of the stream
+	size_t size() const { return _size; }
+
+private:
+	BYTE *_data;
+	size_t _size;
+	/// base address, size and OS handle of a file mapping, if any
+	void *_map_base;
+	size_t _map_size;
+	void *_map_handle;
+
+	FIStreamView(const FIStreamView&);
+	FIStreamView& operator=(const FIStreamView&);
+};
+
 #endif // !FREEIMAGE_IO_H
@@ -46,6 +46,7 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #include <float.h>
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 #define PI	((double)3.14159265358979323846264338327950288419716939937510)
 
@@ -54,81 +55,34 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #define ROTATE_QUARTIC   4L	// Use B-splines of degree 4 (quartic interpolation)
 #define ROTATE_QUINTIC   5L	// Use B-splines of degree 5 (quintic interpolation)
 
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Prototypes definition
-
-static void ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance);
-static double InitialCausalCoefficient(double *c, long DataLength, double z, double Tolerance);
-static void GetColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	GetRow(double *Image, long y, double *Line, long Width);
-static double InitialAntiCausalCoefficient(double *c, long DataLength, double z);
-static void	PutColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	PutRow(double *Image, long y, double *Line, long Width);
-static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree);
-static double InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
-
-static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
+#define BSPLINE_BLOCK				64		// number of columns filtered together by the column pass
+#define BSPLINE_MIN_THREAD_SAMPLES	0x10000	// minimum number of samples per thread
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Coefficients routines
 
-/**
- ConvertToInterpolationCoefficients
-
- @param c Input samples --> output coefficients
- @param DataLength Number of samples or coefficients
- @param z Poles
- @param NbPoles Number of poles
- @param Tolerance Admissible relative error
-*/
-static void 
-ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance) {
-	double	Lambda = 1;
-	long	n, k;
-
-	// special case required by mirror boundaries
-	if(DataLength == 1L) {
-		return;
-	}
-	// compute the overall gain
-	for(k = 0L; k < NbPoles; k++) {
-		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
-	}
-	// apply the gain 
-	for (n = 0L; n < DataLength; n++) {
-		c[n] *= Lambda;
-	}
-	// loop over all poles 
-	for (k = 0L; k < NbPoles; k++) {
-		// causal initialization 
-		c[0] = InitialCausalCoefficient(c, DataLength, z[k], Tolerance);
-		// causal recursion 
-		for (n = 1L; n < DataLength; n++) {
-			c[n] += z[k] * c[n - 1L];
-		}
-		// anticausal initialization 
-		c[DataLength - 1L] = InitialAntiCausalCoefficient(c, DataLength, z[k]);
-		// anticausal recursion 
-		for (n = DataLength - 2L; 0 <= n; n--) {
-			c[n] = z[k] * (c[n + 1L] - c[n]);
-		}
-	}
-} 
+// All routines work on a set of 'count' lines at once (count <= BSPLINE_BLOCK). 
+// Sample n of line l is c[n * stride + l], so that the lines can be the interleaved channels 
+// of an image row (stride = number of channels), or adjacent columns of an image (stride = pitch).
+// The columns are then filtered by blocks, a row at a time, instead of being copied one by one.
+// Parameter T can be double or float.
 
 /**
  InitialCausalCoefficient
 
  @param c Coefficients
  @param DataLength Number of coefficients
+ @param stride Distance between two coefficients of a line
+ @param count Number of lines
  @param z Actual pole
  @param Tolerance Admissible relative error
- @return
 */
-static double 
-InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance) {
-	double	Sum, zn, z2n, iz;
+template <class T> static void 
+InitialCausalCoefficient(T *c, long DataLength, ptrdiff_t stride, unsigned count, double z, double Tolerance) {
+	T		Sum[BSPLINE_BLOCK];
+	double	zn, z2n, iz;
 	long	n, Horizon;
+	unsigned l;
 
 	// this initialization corresponds to mirror boundaries 
 	Horizon = DataLength;
@@ -138,64 +92,44 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
 	if(Horizon < DataLength) {
 		// accelerated loop
 		zn = z;
-		Sum = c[0];
+		for(l = 0; l < count; l++) {
+			Sum[l] = c[l];
+		}
 		for (n = 1L; n < Horizon; n++) {
-			Sum += zn * c[n];
+			const T f = (T)zn;
+			const T *cn = c + n * stride;
+			for(l = 0; l < count; l++) {
+				Sum[l] += f * cn[l];
+			}
 			zn *= z;
 		}
-		return(Sum);
+		for(l = 0; l < count; l++) {
+			c[l] = Sum[l];
+		}
 	}
 	else {
 		// full loop 
 		zn = z;
 		iz = 1.0 / z;
 		z2n = pow(z, (double)(DataLength - 1L));
-		Sum = c[0] + z2n * c[DataLength - 1L];
+		const T *cl = c + (DataLength - 1L) * stride;
+		for(l = 0; l < count; l++) {
+			Sum[l] = c[l] + (T)z2n * cl[l];
+		}
 		z2n *= z2n * iz;
 		for (n = 1L; n <= DataLength - 2L; n++) {
-			Sum += (zn + z2n) * c[n];
+			const T f = (T)(zn + z2n);
+			const T *cn = c + n * stride;
+			for(l = 0; l < count; l++) {
+				Sum[l] += f * cn[l];
+			}
 			zn *= z;
 			z2n *= iz;
 		}
-		return(Sum / (1.0 - zn * zn));
-	}
-}
-
-/**
- GetColumn
-
- @param Image Input image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Output linear array
- @param Height Length of the line
-*/
-static void 
-GetColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long y;
-
-	Image = Image + x;
-	for(y = 0L; y < Height; y++) {
-		Line[y] = (double)*Image;
-		Image += Width;
-	}
-}
-
-/**
- GetRow
-
- @param Image Input image array
- @param y y coordinate of the selected line
- @param Line Output linear array
- @param Width Length of the line
-*/
-static void	
-GetRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		Line[x] = (double)*Image++;
+		const T f = (T)(1.0 - zn * zn);
+		for(l = 0; l < count; l++) {
+			c[l] = Sum[l] / f;
+		}
 	}
 }
 
@@ -204,52 +138,80 @@ GetRow(double *Image, long y, double *Line, long Width) {
 
  @param c Coefficients
  @param DataLength Number of samples or coefficients
+ @param stride Distance between two coefficients of a line
+ @param count Number of lines
  @param z Actual pole
- @return
 */
-static double 
-InitialAntiCausalCoefficient(double	*c, long DataLength, double	z) {
+template <class T> static void 
+InitialAntiCausalCoefficient(T *c, long DataLength, ptrdiff_t stride, unsigned count, double z) {
 	// this initialization corresponds to mirror boundaries
-	return((z / (z * z - 1.0)) * (z * c[DataLength - 2L] + c[DataLength - 1L]));
-}
-
-/**
- PutColumn
-
- @param Image Output image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Input linear array
- @param Height Length of the line and height of the image
-*/
-static void	
-PutColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long	y;
-
-	Image = Image + x;
-	for(y = 0L; y < Height; y++) {
-		*Image = (double)Line[y];
-		Image += Width;
+	const T f = (T)(z / (z * z - 1.0));
+	const T zk = (T)z;
+	T *cl = c + (DataLength - 1L) * stride;
+	const T *cm = cl - stride;
+	for(unsigned l = 0; l < count; l++) {
+		cl[l] = f * (zk * cm[l] + cl[l]);
 	}
 }
 
 /**
- PutRow
+ ConvertToInterpolationCoefficients
 
- @param Image Output image array
- @param y y coordinate of the selected line
- @param Line Input linear array
- @param Width length of the line and width of the image
+ @param c Input samples --> output coefficients
+ @param DataLength Number of samples or coefficients
+ @param stride Distance between two samples of a line
+ @param count Number of lines
+ @param z Poles
+ @param NbPoles Number of poles
+ @param Tolerance Admissible relative error
 */
-static void	
-PutRow(double *Image, long y, double *Line, long Width) {
-	long	x;
+template <class T> static void 
+ConvertToInterpolationCoefficients(T *c, long DataLength, ptrdiff_t stride, unsigned count, const double *z, long NbPoles, double Tolerance) {
+	double	Lambda = 1;
+	long	n, k;
+	unsigned l;
 
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		*Image++ = (double)Line[x];
+	// special case required by mirror boundaries
+	if(DataLength == 1L) {
+		return;
 	}
-}
+	// compute the overall gain
+	for(k = 0L; k < NbPoles; k++) {
+		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
+	}
+	// apply the gain 
+	const T gain = (T)Lambda;
+	for (n = 0L; n < DataLength; n++) {
+		T *cn = c + n * stride;
+		for(l = 0; l < count; l++) {
+			cn[l] *= gain;
+		}
+	}
+	// loop over all poles 
+	for (k = 0L; k < NbPoles; k++) {
+		const T zk = (T)z[k];
+		// causal initialization 
+		InitialCausalCoefficient(c, DataLength, stride, count, z[k], Tolerance);
+		// causal recursion 
+		for (n = 1L; n < DataLength; n++) {
+			T *cn = c + n * stride;
+			const T *cp = cn - stride;
+			for(l = 0; l < count; l++) {
+				cn[l] += zk * cp[l];
+			}
+		}
+		// anticausal initialization 
+		InitialAntiCausalCoefficient(c, DataLength, stride, count, z[k]);
+		// anticausal recursion 
+		for (n = DataLength - 2L; 0 <= n; n--) {
+			T *cn = c + n * stride;
+			const T *cx = cn + stride;
+			for(l = 0; l < count; l++) {
+				cn[l] = zk * (cx[l] - cn[l]);
+			}
+		}
+	}
+} 
 
 /**
  SamplesToCoefficients.<br>
@@ -258,19 +220,20 @@ PutRow(double *Image, long y, double *Line, long Width) {
  data are processed in-place. 
  Even though this algorithm is robust with respect to quantization, 
  we advocate the use of a floating-point format for the data. 
+ Rows, then blocks of columns, are processed concurrently.
 
- @param Image Input / Output image (in-place processing)
+ @param Image Input / Output image (in-place processing), pointer to the top row
  @param Width Width of the image
  @param Height Height of the image
+ @param pitch Signed distance between two rows, in samples
+ @param channels Number of interleaved channels
  @param spline_degree Degree of the spline model
  @return Returns true if success, false otherwise
 */
-static bool	
-SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree) {
-	double	*Line;
+template <class T> static bool	
+SamplesToCoefficients(T *Image, long Width, long Height, ptrdiff_t pitch, unsigned channels, long spline_degree) {
 	double	Pole[2];
 	long	NbPoles;
-	long	x, y;
 
 	// recover the poles from a lookup table
 	switch (spline_degree) {
@@ -299,33 +262,29 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 			return false;
 	}
 
+	// admissible relative error, depends on the precision of T
+	const double Tolerance = std::numeric_limits<T>::epsilon();
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)Width * Height * channels, BSPLINE_MIN_THREAD_SAMPLES);
+
 	// convert the image samples into interpolation coefficients 
 
 	// in-place separable process, along x 
-	Line = (double *)malloc(Width * sizeof(double));
-	if (Line == NULL) {
-		// Row allocation failed
-		return false;
-	}
-	for (y = 0L; y < Height; y++) {
-		GetRow(Image, y, Line, Width);
-		ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
-		PutRow(Image, y, Line, Width);
-	}
-	free(Line);
+	FreeImage_ParallelFor(0, (unsigned)Height, threads, [=](unsigned y_begin, unsigned y_end, unsigned) {
+		for(unsigned y = y_begin; y < y_end; y++) {
+			ConvertToInterpolationCoefficients(Image + (ptrdiff_t)y * pitch, Width, channels, channels, Pole, NbPoles, Tolerance);
+		}
+	});
 
 	// in-place separable process, along y 
-	Line = (double *)malloc(Height * sizeof(double));
-	if (Line == NULL) {
-		// Column allocation failed
-		return false;
-	}
-	for (x = 0L; x < Width; x++) {
-		GetColumn(Image, Width, x, Line, Height);
-		ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
-		PutColumn(Image, Width, x, Line, Height);
-	}
-	free(Line);
+	const unsigned lines = (unsigned)Width * channels;
+	const unsigned blocks = (lines + BSPLINE_BLOCK - 1) / BSPLINE_BLOCK;
+	FreeImage_ParallelFor(0, blocks, threads, [=](unsigned block_begin, unsigned block_end, unsigned) {
+		for(unsigned b = block_begin; b < block_end; b++) {
+			const unsigned first = b * BSPLINE_BLOCK;
+			ConvertToInterpolationCoefficients(Image + first, Height, pitch, MIN((unsigned)BSPLINE_BLOCK, lines - first), Pole, NbPoles, Tolerance);
+		}
+	});
 
 	return true;
 }
@@ -334,260 +293,129 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 // Interpolation routines
 
 /**
-Perform the bidimensional interpolation of an image.
-Given an array of spline coefficients, return the value of 
-the underlying continuous spline model, sampled at the location (x, y). 
+Same as (long)floor(x), without the library call
+*/
+static inline long 
+FloorToLong(double x) {
+	const long i = (long)x;
+	return (x < (double)i) ? (i - 1L) : i;
+}
+
+/**
+Compute the interpolation indexes and weights along one axis.
 The model degree can be 2 (quadratic), 3 (cubic), 4 (quartic), or 5 (quintic).
 
-@param Bcoeff Input B-spline array of coefficients
-@param Width Width of the image
-@param Height Height of the image
-@param x x coordinate where to interpolate
-@param y y coordinate where to interpolate
+@param x Coordinate where to interpolate
+@param Length Length of the axis (width or height of the image)
 @param spline_degree Degree of the spline model
-@return Returns the value of the underlying continuous spline model, 
-sampled at the location (x, y)
+@param Weight Output interpolation weights (spline_degree + 1)
+@param Index Output interpolation indexes (spline_degree + 1), with mirror boundary conditions applied
 */
-static double 
-InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree) {
-	double	*p;
-	double	xWeight[6], yWeight[6];
-	double	interpolated;
+static inline void 
+InterpolationWeights(double x, long Length, long spline_degree, double *Weight, long *Index) {
 	double	w, w2, w4, t, t0, t1;
-	long	xIndex[6], yIndex[6];
-	long	Width2 = 2L * Width - 2L, Height2 = 2L * Height - 2L;
-	long	i, j, k;
+	long	Length2 = 2L * Length - 2L;
+	long	i, k;
 
 	// compute the interpolation indexes
 	if (spline_degree & 1L) {
-		i = (long)floor(x) - spline_degree / 2L;
-		j = (long)floor(y) - spline_degree / 2L;
-		for(k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
+		i = FloorToLong(x) - spline_degree / 2L;
 	}
 	else {
-		i = (long)floor(x + 0.5) - spline_degree / 2L;
-		j = (long)floor(y + 0.5) - spline_degree / 2L;
-		for (k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
+		i = FloorToLong(x + 0.5) - spline_degree / 2L;
+	}
+	for(k = 0; k <= spline_degree; k++) {
+		Index[k] = i++;
 	}
 
 	// compute the interpolation weights
 	switch (spline_degree) {
 		case 2L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[1] = 3.0 / 4.0 - w * w;
-			xWeight[2] = (1.0 / 2.0) * (w - xWeight[1] + 1.0);
-			xWeight[0] = 1.0 - xWeight[1] - xWeight[2];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[1] = 3.0 / 4.0 - w * w;
-			yWeight[2] = (1.0 / 2.0) * (w - yWeight[1] + 1.0);
-			yWeight[0] = 1.0 - yWeight[1] - yWeight[2];
+			w = x - (double)Index[1];
+			Weight[1] = 3.0 / 4.0 - w * w;
+			Weight[2] = (1.0 / 2.0) * (w - Weight[1] + 1.0);
+			Weight[0] = 1.0 - Weight[1] - Weight[2];
 			break;
 		case 3L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[3] = (1.0 / 6.0) * w * w * w;
-			xWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - xWeight[3];
-			xWeight[2] = w + xWeight[0] - 2.0 * xWeight[3];
-			xWeight[1] = 1.0 - xWeight[0] - xWeight[2] - xWeight[3];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[3] = (1.0 / 6.0) * w * w * w;
-			yWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - yWeight[3];
-			yWeight[2] = w + yWeight[0] - 2.0 * yWeight[3];
-			yWeight[1] = 1.0 - yWeight[0] - yWeight[2] - yWeight[3];
+			w = x - (double)Index[1];
+			Weight[3] = (1.0 / 6.0) * w * w * w;
+			Weight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - Weight[3];
+			Weight[2] = w + Weight[0] - 2.0 * Weight[3];
+			Weight[1] = 1.0 - Weight[0] - Weight[2] - Weight[3];
 			break;
 		case 4L:
-			/* x */
-			w = x - (double)xIndex[2];
-			w2 = w * w;
-			t = (1.0 / 6.0) * w2;
-			xWeight[0] = 1.0 / 2.0 - w;
-			xWeight[0] *= xWeight[0];
-			xWeight[0] *= (1.0 / 24.0) * xWeight[0];
-			t0 = w * (t - 11.0 / 24.0);
-			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			xWeight[1] = t1 + t0;
-			xWeight[3] = t1 - t0;
-			xWeight[4] = xWeight[0] + t0 + (1.0 / 2.0) * w;
-			xWeight[2] = 1.0 - xWeight[0] - xWeight[1] - xWeight[3] - xWeight[4];
-			/* y */
-			w = y - (double)yIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
 			t = (1.0 / 6.0) * w2;
-			yWeight[0] = 1.0 / 2.0 - w;
-			yWeight[0] *= yWeight[0];
-			yWeight[0] *= (1.0 / 24.0) * yWeight[0];
+			Weight[0] = 1.0 / 2.0 - w;
+			Weight[0] *= Weight[0];
+			Weight[0] *= (1.0 / 24.0) * Weight[0];
 			t0 = w * (t - 11.0 / 24.0);
 			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			yWeight[1] = t1 + t0;
-			yWeight[3] = t1 - t0;
-			yWeight[4] = yWeight[0] + t0 + (1.0 / 2.0) * w;
-			yWeight[2] = 1.0 - yWeight[0] - yWeight[1] - yWeight[3] - yWeight[4];
+			Weight[1] = t1 + t0;
+			Weight[3] = t1 - t0;
+			Weight[4] = Weight[0] + t0 + (1.0 / 2.0) * w;
+			Weight[2] = 1.0 - Weight[0] - Weight[1] - Weight[3] - Weight[4];
 			break;
 		case 5L:
-			/* x */
-			w = x - (double)xIndex[2];
-			w2 = w * w;
-			xWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-			w2 -= w;
-			w4 = w2 * w2;
-			w -= 1.0 / 2.0;
-			t = w2 * (w2 - 3.0);
-			xWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - xWeight[5];
-			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			xWeight[2] = t0 + t1;
-			xWeight[3] = t0 - t1;
-			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			xWeight[1] = t0 + t1;
-			xWeight[4] = t0 - t1;
-			/* y */
-			w = y - (double)yIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
-			yWeight[5] = (1.0 / 120.0) * w * w2 * w2;
+			Weight[5] = (1.0 / 120.0) * w * w2 * w2;
 			w2 -= w;
 			w4 = w2 * w2;
 			w -= 1.0 / 2.0;
 			t = w2 * (w2 - 3.0);
-			yWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - yWeight[5];
+			Weight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - Weight[5];
 			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
 			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			yWeight[2] = t0 + t1;
-			yWeight[3] = t0 - t1;
+			Weight[2] = t0 + t1;
+			Weight[3] = t0 - t1;
 			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
 			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			yWeight[1] = t0 + t1;
-			yWeight[4] = t0 - t1;
+			Weight[1] = t0 + t1;
+			Weight[4] = t0 - t1;
 			break;
-		default:
-			// Invalid spline degree
-			return 0;
 	}
 
-	// apply the mirror boundary conditions
-	for(k = 0; k <= spline_degree; k++) {
-		xIndex[k] = (Width == 1L) ? (0L) : ((xIndex[k] < 0L) ?
-			(-xIndex[k] - Width2 * ((-xIndex[k]) / Width2))
-			: (xIndex[k] - Width2 * (xIndex[k] / Width2)));
-		if (Width <= xIndex[k]) {
-			xIndex[k] = Width2 - xIndex[k];
-		}
-		yIndex[k] = (Height == 1L) ? (0L) : ((yIndex[k] < 0L) ?
-			(-yIndex[k] - Height2 * ((-yIndex[k]) / Height2))
-			: (yIndex[k] - Height2 * (yIndex[k] / Height2)));
-		if (Height <= yIndex[k]) {
-			yIndex[k] = Height2 - yIndex[k];
-		}
-	}
-
-	// perform interpolation
-	interpolated = 0.0;
-	for(j = 0; j <= spline_degree; j++) {
-		p = Bcoeff + (yIndex[j] * Width);
-		w = 0.0;
-		for(i = 0; i <= spline_degree; i++) {
-			w += xWeight[i] * p[xIndex[i]];
+	// apply the mirror boundary conditions (indexes inside the image are left unchanged)
+	if((Index[0] < 0L) || (Length <= Index[spline_degree])) {
+		for(k = 0; k <= spline_degree; k++) {
+			Index[k] = (Length == 1L) ? (0L) : ((Index[k] < 0L) ?
+				(-Index[k] - Length2 * ((-Index[k]) / Length2))
+				: (Index[k] - Length2 * (Index[k] / Length2)));
+			if (Length <= Index[k]) {
+				Index[k] = Length2 - Index[k];
+			}
 		}
-		interpolated += yWeight[j] * w;
 	}
-
-	return interpolated;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// FreeImage implementation
-
-
 /** 
- Image translation and rotation using B-Splines.
-
- @param dib Input 8-bit greyscale image
+ Image translation and rotation of a B-spline coefficients array. 
+ Given an array of spline coefficients, visit all pixels of the output image 
+ and assign them the value of the underlying continuous spline model. 
+ The interpolation weights of a pixel are shared by all its channels. 
+ Rows of the output image are processed concurrently.
+
+ @param Bcoeff Input B-spline array of coefficients, pointer to the top row
+ @param pitch Signed distance between two rows of Bcoeff, in coefficients
+ @param channels Number of interleaved channels of Bcoeff
+ @param width Width of the image
+ @param height Height of the image
+ @param dst Output 8-, 24- or 32-bit image, width x height
+ @param offsets Byte offset of each channel in a dst pixel
  @param angle Output image rotation in degree
  @param x_shift Output image horizontal shift
  @param y_shift Output image vertical shift
  @param x_origin Output origin of the x-axis
  @param y_origin Output origin of the y-axis
- @param spline_degree Output degree of the B-spline model
  @param use_mask Whether or not to mask the image
- @return Returns the translated & rotated dib if successful, returns NULL otherwise
+ Parameter spline is the degree of the B-spline model.
 */
-static FIBITMAP * 
-Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
-	double	*ImageRasterArray;
-	double	p;
+template <class T, long spline> static void 
+RotateCoefficients(const T *Bcoeff, ptrdiff_t pitch, unsigned channels, long width, long height, FIBITMAP *dst, const unsigned *offsets, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask) {
 	double	a11, a12, a21, a22;
-	double	x0, y0, x1, y1;
-	long	x, y;
-	long	spline;
-	bool	bResult;
-
-	int bpp = FreeImage_GetBPP(dib);
-	if(bpp != 8) {
-		return NULL;
-	}
-	
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
-	switch(spline_degree) {
-		case ROTATE_QUADRATIC:
-			spline = 2L;	// Use splines of degree 2 (quadratic interpolation)
-			break;
-		case ROTATE_CUBIC:
-			spline = 3L;	// Use splines of degree 3 (cubic interpolation)
-			break;
-		case ROTATE_QUARTIC:
-			spline = 4L;	// Use splines of degree 4 (quartic interpolation)
-			break;
-		case ROTATE_QUINTIC:
-			spline = 5L;	// Use splines of degree 5 (quintic interpolation)
-			break;
-		default:
-			spline = 3L;
-	}
-
-	// allocate output image
-	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp);
-	if(!dst)
-		return NULL;
-	// buid a grey scale palette
-	RGBQUAD *pal = FreeImage_GetPalette(dst);
-	for(int i = 0; i < 256; i++) {
-		pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
-	}
-
-	// allocate a temporary array
-	ImageRasterArray = (double*)malloc(width * height * sizeof(double));
-	if(!ImageRasterArray) {
-		FreeImage_Unload(dst);
-		return NULL;
-	}
-	// copy data samples
-	for(y = 0; y < height; y++) {
-		double *pImage = &ImageRasterArray[y*width];
-		BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y);
-
-		for(x = 0; x < width; x++) {
-			pImage[x] = (double)src_bits[x];
-		}
-	}
-
-	// convert between a representation based on image samples
-	// and a representation based on image B-spline coefficients
-	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline);
-	if(!bResult) {
-		FreeImage_Unload(dst);
-		free(ImageRasterArray);
-		return NULL;
-	}
+	double	x0, y0;
 
 	// prepare the geometry
 	angle *= PI / 180.0;
@@ -600,40 +428,96 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	x_shift = x_origin - x0;
 	y_shift = y_origin - y0;
 
+	const unsigned bytespp = FreeImage_GetLine(dst) / FreeImage_GetWidth(dst);
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height * channels, BSPLINE_MIN_THREAD_SAMPLES);
+
 	// visit all pixels of the output image and assign their value
-	for(y = 0; y < height; y++) {
-		BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
-		
-		x0 = a12 * (double)y + x_shift;
-		y0 = a22 * (double)y + y_shift;
-
-		for(x = 0; x < width; x++) {
-			x1 = x0 + a11 * (double)x;
-			y1 = y0 + a21 * (double)x;
-			if(use_mask) {
-				if((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
-					p = 0;
+	FreeImage_ParallelFor(0, (unsigned)height, threads, [=](unsigned y_begin, unsigned y_end, unsigned) {
+		double	xWeight[6], yWeight[6];
+		long	xIndex[6], yIndex[6];
+		T		xw[6], values[4];
+
+		for(long y = y_begin; y < (long)y_end; y++) {
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
+
+			const double x0 = a12 * (double)y + x_shift;
+			const double y0 = a22 * (double)y + y_shift;
+
+			for(long x = 0; x < width; x++, dst_bits += bytespp) {
+				const double x1 = x0 + a11 * (double)x;
+				const double y1 = y0 + a21 * (double)x;
+				if(use_mask) {
+					if((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
+						for(unsigned c = 0; c < channels; c++) {
+							dst_bits[offsets[c]] = 0;
+						}
+						continue;
+					}
+				}
+
+				// compute the interpolation indexes and weights, once for all channels
+				InterpolationWeights(x1, width, spline, xWeight, xIndex);
+				InterpolationWeights(y1, height, spline, yWeight, yIndex);
+				for(long i = 0; i <= spline; i++) {
+					xw[i] = (T)xWeight[i];
+					xIndex[i] *= channels;
 				}
-				else {
-					p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+
+				// perform interpolation
+				for(unsigned c = 0; c < channels; c++) {
+					values[c] = 0;
+				}
+				for(long j = 0; j <= spline; j++) {
+					const T *p = Bcoeff + yIndex[j] * pitch;
+					const T yw = (T)yWeight[j];
+					for(unsigned c = 0; c < channels; c++) {
+						T w = 0;
+						for(long i = 0; i <= spline; i++) {
+							w += xw[i] * p[xIndex[i] + c];
+						}
+						values[c] += yw * w;
+					}
+				}
+
+				// clamp and convert to BYTE
+				for(unsigned c = 0; c < channels; c++) {
+					dst_bits[offsets[c]] = (BYTE)MIN(MAX((int)0, (int)(values[c] + 0.5)), (int)255);
 				}
 			}
-			else {
-				p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
-			}
-			// clamp and convert to BYTE
-			dst_bits[x] = (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
 		}
-	}
+	});
+}
 
-	// free working array and return
-	free(ImageRasterArray);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FreeImage implementation
 
+// byte offsets of the channels of a coefficients image, in a 8-, 24- or 32-bit pixel
+static const unsigned BSPLINE_OFFSETS_GREY[1] = { 0 };
+static const unsigned BSPLINE_OFFSETS_RGBA[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+
+/**
+Allocate the output image of a B-spline rotation
+@param width Image width
+@param height Image height
+@param bpp Image bit depth (8, 24 or 32)
+@return Returns the allocated dib if successful, returns NULL otherwise
+*/
+static FIBITMAP * 
+AllocateRotated(int width, int height, int bpp) {
+	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(dst && (bpp == 8)) {
+		// buid a grey scale palette
+		RGBQUAD *pal = FreeImage_GetPalette(dst);
+		for(int i = 0; i < 256; i++) {
+			pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+		}
+	}
 	return dst;
 }
 
 /** 
  Image rotation using a 3rd order (cubic) B-Splines.
+ Each channel is processed in double precision.
 
  @param dib Input dib (8, 24 or 32-bit)
  @param angle Output image rotation
@@ -646,85 +530,170 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 */
 FIBITMAP * DLL_CALLCONV 
 FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask) {
+	if(!FreeImage_HasPixels(dib)) return NULL;
 
-	int x, y, bpp;
-	int channel, nb_channels;
-	BYTE *src_bits, *dst_bits;
-	FIBITMAP *src8 = NULL, *dst8 = NULL, *dst = NULL;
+	const int bpp = FreeImage_GetBPP(dib);
+	if((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+		return NULL;
+	}
 
-	if(!FreeImage_HasPixels(dib)) return NULL;
+	const int width  = FreeImage_GetWidth(dib);
+	const int height = FreeImage_GetHeight(dib);
+	const unsigned nb_channels = (bpp / 8);
 
-	try {
+	// allocate dst image
+	FIBITMAP *dst = AllocateRotated(width, height, bpp);
+	if(!dst) {
+		return NULL;
+	}
 
-		bpp = FreeImage_GetBPP(dib);
+	// allocate a temporary array
+	double *ImageRasterArray = (double*)malloc((size_t)width * height * sizeof(double));
+	if(!ImageRasterArray) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
 
-		if(bpp == 8) {
-			FIBITMAP *dst_8 = Rotate8Bit(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-			if(dst_8) {
-				// copy metadata from src to dst
-				FreeImage_CloneMetadata(dst_8, dib);
+	// process each channel separately
+	// -------------------------------
+
+	for(unsigned channel = 0; channel < nb_channels; channel++) {
+		// copy data samples
+		for(int y = 0; y < height; y++) {
+			double *pImage = &ImageRasterArray[(size_t)y * width];
+			const BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y) + channel;
+			for(int x = 0; x < width; x++) {
+				pImage[x] = (double)*src_bits;
+				src_bits += nb_channels;
 			}
-			return dst_8;
 		}
-		if((bpp == 24) || (bpp == 32)) {
-			// allocate dst image
-			int width  = FreeImage_GetWidth(dib);
-			int height = FreeImage_GetHeight(dib);
-			if( bpp == 24 ) {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			} else {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			}
-			if(!dst) throw(1);
-
-			// allocate a temporary 8-bit dib (no need to build a palette)
-			src8 = FreeImage_Allocate(width, height, 8);
-			if(!src8) throw(1);
-
-			// process each channel separately
-			// -------------------------------
-			nb_channels = (bpp / 8);
-
-			for(channel = 0; channel < nb_channels; channel++) {
-				// extract channel from source dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dib, y);
-					dst_bits = FreeImage_GetScanLine(src8, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[x] = src_bits[channel];
-						src_bits += nb_channels;
-					}
-				}
 
-				// process channel
-				dst8 = Rotate8Bit(src8, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-				if(!dst8) throw(1);
-
-				// insert channel to destination dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dst8, y);
-					dst_bits = FreeImage_GetScanLine(dst, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[channel] = src_bits[x];
-						dst_bits += nb_channels;
-					}
-				}
+		// convert between a representation based on image samples
+		// and a representation based on image B-spline coefficients
+		SamplesToCoefficients(ImageRasterArray, width, height, width, 1, ROTATE_CUBIC);
 
-				FreeImage_Unload(dst8);
-			}
+		// rotate into the channel of dst
+		RotateCoefficients<double, ROTATE_CUBIC>(ImageRasterArray, width, 1, width, height, dst, &channel, angle, x_shift, y_shift, x_origin, y_origin, use_mask);
+	}
+
+	// free working array
+	free(ImageRasterArray);
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, dib);
+
+	return dst;
+}
+
+/** 
+ Compute the cubic B-spline coefficients of an image, in single precision. 
+ The result can be given to FreeImage_RotateExCoefficients any number of times.
+
+ @param dib Input dib (8, 24 or 32-bit)
+ @return Returns a FIT_FLOAT, FIT_RGBF or FIT_RGBAF coefficients image if successful, returns NULL otherwise
+*/
+FIBITMAP * DLL_CALLCONV 
+FreeImage_MakeBSplineCoefficients(FIBITMAP *dib) {
+	if(!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) return NULL;
+
+	FREE_IMAGE_TYPE coeff_type;
+	const unsigned *offsets = BSPLINE_OFFSETS_RGBA;
+	switch(FreeImage_GetBPP(dib)) {
+		case 8:
+			coeff_type = FIT_FLOAT;
+			offsets = BSPLINE_OFFSETS_GREY;
+			break;
+		case 24:
+			coeff_type = FIT_RGBF;
+			break;
+		case 32:
+			coeff_type = FIT_RGBAF;
+			break;
+		default:
+			return NULL;
+	}
 
-			FreeImage_Unload(src8);
+	const int width  = FreeImage_GetWidth(dib);
+	const int height = FreeImage_GetHeight(dib);
 
-			// copy metadata from src to dst
-			FreeImage_CloneMetadata(dst, dib);
-			
-			return dst;
+	FIBITMAP *coeff = FreeImage_AllocateT(coeff_type, width, height);
+	if(!coeff) {
+		return NULL;
+	}
+
+	// copy data samples
+	const unsigned src_bytespp = FreeImage_GetLine(dib) / width;
+	const unsigned channels = FreeImage_GetLine(coeff) / width / sizeof(float);
+	for(int y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(dib, y);
+		float *dst_bits = (float*)FreeImage_GetScanLine(coeff, y);
+		for(int x = 0; x < width; x++) {
+			for(unsigned c = 0; c < channels; c++) {
+				dst_bits[c] = (float)src_bits[offsets[c]];
+			}
+			src_bits += src_bytespp;
+			dst_bits += channels;
 		}
-	} catch(int) {
-		if(src8) FreeImage_Unload(src8);
-		if(dst8) FreeImage_Unload(dst8);
-		if(dst)  FreeImage_Unload(dst);
 	}
 
-	return NULL;
+	// convert to B-spline coefficients, rows are processed from top to bottom
+	const ptrdiff_t pitch = FreeImage_GetPitch(coeff) / sizeof(float);
+	SamplesToCoefficients((float*)FreeImage_GetScanLine(coeff, height - 1), width, height, -pitch, channels, ROTATE_CUBIC);
+
+	// copy metadata from src to coefficients, for FreeImage_RotateExCoefficients
+	FreeImage_CloneMetadata(coeff, dib);
+
+	return coeff;
+}
+
+/** 
+ Image rotation using precomputed cubic B-spline coefficients. 
+ Same as FreeImage_RotateEx, without recomputing the coefficients of the image.
+
+ @param coeff Input coefficients, from FreeImage_MakeBSplineCoefficients
+ @param angle Output image rotation
+ @param x_shift Output image horizontal shift
+ @param y_shift Output image vertical shift
+ @param x_origin Output origin of the x-axis
+ @param y_origin Output origin of the y-axis
+ @param use_mask Whether or not to mask the image
+ @return Returns the translated & rotated 8-, 24- or 32-bit dib if successful, returns NULL otherwise
+*/
+FIBITMAP * DLL_CALLCONV 
+FreeImage_RotateExCoefficients(FIBITMAP *coeff, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask) {
+	if(!FreeImage_HasPixels(coeff)) return NULL;
+
+	int bpp;
+	const unsigned *offsets = BSPLINE_OFFSETS_RGBA;
+	switch(FreeImage_GetImageType(coeff)) {
+		case FIT_FLOAT:
+			bpp = 8;
+			offsets = BSPLINE_OFFSETS_GREY;
+			break;
+		case FIT_RGBF:
+			bpp = 24;
+			break;
+		case FIT_RGBAF:
+			bpp = 32;
+			break;
+		default:
+			return NULL;
+	}
+
+	const int width  = FreeImage_GetWidth(coeff);
+	const int height = FreeImage_GetHeight(coeff);
+	const unsigned channels = bpp / 8;
+
+	FIBITMAP *dst = AllocateRotated(width, height, bpp);
+	if(!dst) {
+		return NULL;
+	}
+
+	const ptrdiff_t pitch = FreeImage_GetPitch(coeff) / sizeof(float);
+	RotateCoefficients<float, ROTATE_CUBIC>((const float*)FreeImage_GetScanLine(coeff, height - 1), -pitch, channels, width, height, dst, offsets, angle, x_shift, y_shift, x_origin, y_origin, use_mask);
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, coeff);
+
+	return dst;
 }
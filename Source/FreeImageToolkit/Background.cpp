@@ -201,47 +201,129 @@ GetAlphaBlendedColor(const RGBQUAD *bgcolor, const RGBQUAD *fgcolor, RGBQUAD *bl
 	return TRUE;
 }
 
-/** @brief Fills a FIT_BITMAP image with the specified color.
+// ----------------------------------------------------------
+//   Fill kernels
+// ----------------------------------------------------------
 
- This function does the dirty work for FreeImage_FillBackground for FIT_BITMAP
- images.
- @param dib The image to be filled.
- @param color The color, the specified image should be filled with.
- @param options Options that affect the color search process for palletized images.
- @return Returns TRUE on success, FALSE otherwise. This function fails if any of
- the dib and color is NULL or the provided image is not a FIT_BITMAP image.
+// fills larger than this (in bytes) bypass the caches with non-temporal stores
+#define FILL_STREAM_MIN_BYTES	(4 * 1024 * 1024)
+
+/** @brief Replicates a pixel value along a line.
+
+ The pixel is written once, then the already filled part of the line is
+ copied over the remaining part, doubling the filled part at each step.
+ @param dst The line to be filled.
+ @param pixel The pixel value.
+ @param bytespp The size of the pixel value in bytes.
+ @param count The number of pixels to be written.
  */
-static BOOL
-FillBackgroundBitmap(FIBITMAP *dib, const RGBQUAD *color, int options) {
+static void
+ReplicatePixel(BYTE *dst, const BYTE *pixel, unsigned bytespp, unsigned count) {
+	const size_t total = (size_t)bytespp * count;
+	if (total == 0) {
+		return;
+	}
+	if (bytespp == 1) {
+		memset(dst, pixel[0], total);
+		return;
+	}
+	memcpy(dst, pixel, bytespp);
+	size_t filled = bytespp;
+	while (filled < total) {
+		const size_t n = MIN(filled, total - filled);
+		memcpy(dst + filled, dst, n);
+		filled += n;
+	}
+}
 
-	if ((!dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
-		return FALSE;;
+/** @brief Copies a line into the following lines of an image.
+
+ Large fills use non-temporal stores, so that they do not evict the caches.
+ @param bits The first line, already filled.
+ @param pitch The image's pitch.
+ @param bytes The number of bytes to be copied per line.
+ @param lines The total number of lines, including the first one.
+ */
+static void
+ReplicateLine(BYTE *bits, unsigned pitch, unsigned bytes, unsigned lines) {
+	BYTE *dst_bits = bits + pitch;
+
+#ifdef FREEIMAGE_SSE2
+	if ((size_t)bytes * lines >= FILL_STREAM_MIN_BYTES) {
+		for (unsigned y = 1; y < lines; y++, dst_bits += pitch) {
+			// bytes before the first 16-byte boundary
+			unsigned head = (unsigned)((16 - ((size_t)dst_bits & 15)) & 15);
+			head = MIN(head, bytes);
+			memcpy(dst_bits, bits, head);
+			unsigned x = head;
+			for (; x + 16 <= bytes; x += 16) {
+				_mm_stream_si128((__m128i *)(dst_bits + x), _mm_loadu_si128((const __m128i *)(bits + x)));
+			}
+			memcpy(dst_bits + x, bits + x, bytes - x);
+		}
+		_mm_sfence();
+		return;
 	}
-	
-	if (!color) {
-		return FALSE;
+#endif // FREEIMAGE_SSE2
+
+	for (unsigned y = 1; y < lines; y++, dst_bits += pitch) {
+		memcpy(dst_bits, bits, bytes);
 	}
-	
-	const RGBQUAD *color_intl = color;
+}
+
+/** @brief Fills a rectangular area of an image of 8 or more bits per pixel with a pixel value.
+
+ @param dib The image to be filled.
+ @param pixel The pixel value.
+ @param bytespp The size of the pixel value in bytes.
+ @param x The left position of the area.
+ @param y The first scanline of the area (scanlines are counted from the bottom).
+ @param width The width of the area.
+ @param height The number of scanlines of the area.
+ */
+static void
+FillRect(FIBITMAP *dib, const BYTE *pixel, unsigned bytespp, unsigned x, unsigned y, unsigned width, unsigned height) {
+	if ((width == 0) || (height == 0)) {
+		return;
+	}
+	BYTE *bits = FreeImage_GetScanLine(dib, y) + x * bytespp;
+	ReplicatePixel(bits, pixel, bytespp, width);
+	ReplicateLine(bits, FreeImage_GetPitch(dib), width * bytespp, height);
+}
+
+/** @brief Gets the color actually used to fill a FIT_BITMAP image.
+
+ A fill color with an alpha value smaller than 255 (with option FI_COLOR_IS_RGBA_COLOR)
+ gets blended with the image's bottom-left pixel. The fill color is looked up in the
+ palette of palletized images.
+ @param dib The image to be filled.
+ @param color The color, the specified image should be filled with.
+ @param options Options that affect the color search process for palletized images.
+ @param fill Receives the fill color.
+ @param index Receives the palette index of the fill color (images of 8 or less bits per pixel).
+ @return Returns 1 if the image must be filled, 0 if the fill color is fully transparent
+ and -1 if no palette index was found.
+ */
+static int
+GetFillColorBitmap(FIBITMAP *dib, const RGBQUAD *color, int options, RGBQUAD *fill, int *index) {
 	unsigned bpp = FreeImage_GetBPP(dib);
-	unsigned width = FreeImage_GetWidth(dib);
-	unsigned height = FreeImage_GetHeight(dib);
-	
+
 	FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
-	
+
 	// get a pointer to the first scanline (bottom line)
-	BYTE *src_bits = FreeImage_GetScanLine(dib, 0);
-	BYTE *dst_bits = src_bits;	
-	
+	const BYTE *src_bits = FreeImage_GetScanLine(dib, 0);
+
 	BOOL supports_alpha = ((bpp >= 24) || ((bpp == 8) && (color_type != FIC_PALETTE)));
-	
+
+	*fill = *color;
+
 	// Check for RGBA case if bitmap supports alpha 
 	// blending (8-bit greyscale, 24- or 32-bit images)
 	if (supports_alpha && (options & FI_COLOR_IS_RGBA_COLOR)) {
 		
 		if (color->rgbReserved == 0) {
 			// the fill color is fully transparent; we are done
-			return TRUE;
+			return 0;
 		}
 		
 		// Only if the fill color is NOT fully opaque, draw it with
@@ -264,19 +346,115 @@ FillBackgroundBitmap(FIBITMAP *dib, const RGBQUAD *color, int options) {
 				bgcolor.rgbRed = src_bits[FI_RGBA_RED];
 				bgcolor.rgbReserved = 0xFF;
 			}
-			RGBQUAD blend;
-			GetAlphaBlendedColor(&bgcolor, color_intl, &blend);
-			color_intl = &blend;
+			GetAlphaBlendedColor(&bgcolor, color, fill);
 		}
 	}
 	
-	int index = (bpp <= 8) ? GetPaletteIndex(dib, color_intl, options, &color_type) : 0;
-	if (index == -1) {
+	*index = (bpp <= 8) ? GetPaletteIndex(dib, fill, options, &color_type) : 0;
+	if (*index == -1) {
 		// No palette index found for a palletized
 		// image. This should never happen...
+		return -1;
+	}
+
+	return 1;
+}
+
+/** @brief Gets the pixel value used to fill an image of 8 or more bits per pixel.
+
+ @param dib The image to be filled.
+ @param color The color, the specified image should be filled with (see FreeImage_FillBackground).
+ @param options Options that affect the color search process for palletized images.
+ @param pixel Receives the pixel value (at least 16 bytes).
+ @return Returns the size of the pixel value in bytes, 0 if the image must not be
+ filled and -1 on failure.
+ */
+static int
+GetFillPixel(FIBITMAP *dib, const void *color, int options, BYTE *pixel) {
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+
+	if (FreeImage_GetImageType(dib) != FIT_BITMAP) {
+		memcpy(pixel, color, bytespp);
+		return (int)bytespp;
+	}
+
+	RGBQUAD fill;
+	int index = 0;
+	const int result = GetFillColorBitmap(dib, (const RGBQUAD *)color, options, &fill, &index);
+	if (result <= 0) {
+		return result;
+	}
+
+	switch (bytespp) {
+		case 1:
+			pixel[0] = (BYTE)index;
+			break;
+		case 2: {
+			WORD wcolor = RGBQUAD_TO_WORD(dib, (&fill));
+			memcpy(pixel, &wcolor, sizeof(WORD));
+			break;
+		}
+		case 3:
+			memcpy(pixel, &fill, sizeof(RGBTRIPLE));
+			break;
+		case 4:
+			fill.rgbReserved = 0xFF;
+			memcpy(pixel, &fill, sizeof(RGBQUAD));
+			break;
+		default:
+			return -1;
+	}
+	return (int)bytespp;
+}
+
+// ----------------------------------------------------------
+
+/** @brief Fills a FIT_BITMAP image with the specified color.
+
+ This function does the dirty work for FreeImage_FillBackground for FIT_BITMAP
+ images.
+ @param dib The image to be filled.
+ @param color The color, the specified image should be filled with.
+ @param options Options that affect the color search process for palletized images.
+ @return Returns TRUE on success, FALSE otherwise. This function fails if any of
+ the dib and color is NULL or the provided image is not a FIT_BITMAP image.
+ */
+static BOOL
+FillBackgroundBitmap(FIBITMAP *dib, const RGBQUAD *color, int options) {
+
+	if ((!dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return FALSE;;
+	}
+	
+	if (!color) {
 		return FALSE;
 	}
 	
+	unsigned bpp = FreeImage_GetBPP(dib);
+	unsigned width = FreeImage_GetWidth(dib);
+	unsigned height = FreeImage_GetHeight(dib);
+
+	if (bpp >= 8) {
+		// replicate the pixel value over the whole image
+		BYTE pixel[16];
+		const int bytespp = GetFillPixel(dib, color, options, pixel);
+		if (bytespp < 0) {
+			return FALSE;
+		}
+		FillRect(dib, pixel, (unsigned)bytespp, 0, 0, width, height);
+		return TRUE;
+	}
+
+	RGBQUAD fill;
+	int index = 0;
+	const int result = GetFillColorBitmap(dib, color, options, &fill, &index);
+	if (result <= 0) {
+		return (result == 0) ? TRUE : FALSE;
+	}
+
+	// get a pointer to the first scanline (bottom line)
+	BYTE *dst_bits = FreeImage_GetScanLine(dib, 0);
+	
 	// first, build the first scanline (line 0)
 	switch (bpp) {
 		case 1: {
@@ -305,51 +483,13 @@ FillBackgroundBitmap(FIBITMAP *dib, const RGBQUAD *color, int options) {
 			}
 			break;
 		}
-		case 8: {
-			memset(dst_bits, index, FreeImage_GetLine(dib));
-			break;
-		}
-		case 16: {
-			WORD wcolor = RGBQUAD_TO_WORD(dib, color_intl);
-			for (unsigned x = 0; x < width; x++) {
-				((WORD *)dst_bits)[x] = wcolor;
-			}
-			break;
-		}
-		case 24: {
-			RGBTRIPLE rgbt = *((RGBTRIPLE *)color_intl);
-			for (unsigned x = 0; x < width; x++) {
-				((RGBTRIPLE *)dst_bits)[x] = rgbt;
-			}
-			break;
-		}
-		case 32: {
-			RGBQUAD rgbq;
-			rgbq.rgbBlue = ((RGBTRIPLE *)color_intl)->rgbtBlue;
-			rgbq.rgbGreen = ((RGBTRIPLE *)color_intl)->rgbtGreen;
-			rgbq.rgbRed = ((RGBTRIPLE *)color_intl)->rgbtRed;
-			rgbq.rgbReserved = 0xFF;
-			for (unsigned x = 0; x < width; x++) {
-				((RGBQUAD *)dst_bits)[x] = rgbq;
-			}
-			break;
-		}
 		default:
 			return FALSE;
 	}
 
 	// Then, copy the first scanline into all following scanlines.
-	// 'src_bits' is a pointer to the first scanline and is already
-	// set up correctly.
-	if (src_bits) {
-		unsigned pitch = FreeImage_GetPitch(dib);
-		unsigned bytes = FreeImage_GetLine(dib);
-		dst_bits = src_bits + pitch;
-		for (unsigned y = 1; y < height; y++) {
-			memcpy(dst_bits, src_bits, bytes);
-			dst_bits += pitch;
-		}
-	}
+	ReplicateLine(dst_bits, FreeImage_GetPitch(dib), FreeImage_GetLine(dib), height);
+
 	return TRUE;
 }
 
@@ -433,27 +573,47 @@ FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options) {
 		return FillBackgroundBitmap(dib, (RGBQUAD *)color, options);
 	}
 	
-	// first, construct the first scanline (bottom line)
+	// replicate the color value over the whole image
 	unsigned bytespp = (FreeImage_GetBPP(dib) / 8);
-	BYTE *src_bits = FreeImage_GetScanLine(dib, 0);
-	BYTE *dst_bits = src_bits;
-	for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
-		memcpy(dst_bits, color, bytespp);
-		dst_bits += bytespp;
-	}
+	FillRect(dib, (const BYTE *)color, bytespp, 0, 0, FreeImage_GetWidth(dib), FreeImage_GetHeight(dib));
 
-	// then, copy the first scanline into all following scanlines
-	unsigned height = FreeImage_GetHeight(dib);
-	unsigned pitch = FreeImage_GetPitch(dib);
-	unsigned bytes = FreeImage_GetLine(dib);
-	dst_bits = src_bits + pitch;
-	for (unsigned y = 1; y < height; y++) {
-		memcpy(dst_bits, src_bits, bytes);
-		dst_bits += pitch;
-	}
 	return TRUE;
 }
 
+/** @brief Determines, whether a newly allocated image of 8 or more bits per pixel
+ needs to be filled with the specified color.
+
+ A newly allocated image is filled with zeros, so it is only filled if the specified
+ color differs from "black", that is not all bytes of the color are equal to zero.
+ 8-bit images are always filled, since the color is looked up in the palette.
+ @param dib The image to be filled.
+ @param color The color, the specified image should be filled with.
+ @return Returns TRUE if the image needs to be filled, FALSE otherwise.
+ */
+static BOOL
+IsFillNeeded(FIBITMAP *dib, const void *color) {
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	switch (bpp) {
+		case 8:
+			return TRUE;
+		case 16: {
+			WORD wcolor = (FreeImage_GetImageType(dib) == FIT_BITMAP) ?
+				RGBQUAD_TO_WORD(dib, ((RGBQUAD *)color)) : *((WORD *)color);
+			return (wcolor != 0) ? TRUE : FALSE;
+		}
+		default: {
+			const unsigned bytespp = bpp / 8;
+			for (unsigned i = 0; i < bytespp; i++) {
+				if (((BYTE *)color)[i] != 0) {
+					return TRUE;
+				}
+			}
+			return FALSE;
+		}
+	}
+}
+
 /** @brief Allocates a new image of the specified type, width, height and bit depth and
  optionally fills it with the specified color.
 
@@ -626,21 +786,9 @@ FreeImage_AllocateExT(FREE_IMAGE_TYPE type, int width, int height, int bpp, cons
 				FreeImage_FillBackground(bitmap, color, options);
 				break;
 			}
-			case 16: {
-				WORD wcolor = (type == FIT_BITMAP) ?
-					RGBQUAD_TO_WORD(bitmap, ((RGBQUAD *)color)) : *((WORD *)color);
-				if (wcolor != 0) {
-					FreeImage_FillBackground(bitmap, color, options);
-				}
-				break;
-			}
 			default: {
-				int bytespp = bpp / 8;
-				for (int i = 0; i < bytespp; i++) {
-					if (((BYTE *)color)[i] != 0) {
-						FreeImage_FillBackground(bitmap, color, options);
-						break;
-					}
+				if (IsFillNeeded(bitmap, color)) {
+					FreeImage_FillBackground(bitmap, color, options);
 				}
 				break;
 			}
@@ -805,24 +953,30 @@ FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom,
 		return NULL;
 	}
 
+	if ((width + left + right <= 0) || (height + top + bottom <= 0)) {
+		return NULL;
+	}
+
 	unsigned newWidth = width + left + right;
 	unsigned newHeight = height + top + bottom;
 
 	FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
 	unsigned bpp = FreeImage_GetBPP(src);
 
-	FIBITMAP *dst = FreeImage_AllocateExT(
-		type, newWidth, newHeight, bpp, color, options,
-		FreeImage_GetPalette(src),
-		FreeImage_GetRedMask(src),
-		FreeImage_GetGreenMask(src),
-		FreeImage_GetBlueMask(src));
-
-	if (!dst) {
-		return NULL;
-	}
+	FIBITMAP *dst = NULL;
 
 	if ((type == FIT_BITMAP) && (bpp <= 4)) {
+		dst = FreeImage_AllocateExT(
+			type, newWidth, newHeight, bpp, color, options,
+			FreeImage_GetPalette(src),
+			FreeImage_GetRedMask(src),
+			FreeImage_GetGreenMask(src),
+			FreeImage_GetBlueMask(src));
+
+		if (!dst) {
+			return NULL;
+		}
+
 		FIBITMAP *copy = FreeImage_Copy(src,
 			((left >= 0) ? 0 : -left),
 			((top >= 0) ? 0 : -top),
@@ -846,6 +1000,41 @@ FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom,
 
 	} else {
 
+		// allocate the canvas without filling it: only the borders get filled,
+		// the area covered by the source image is copied directly
+		dst = FreeImage_AllocateT(type, newWidth, newHeight, bpp,
+			FreeImage_GetRedMask(src),
+			FreeImage_GetGreenMask(src),
+			FreeImage_GetBlueMask(src));
+
+		if (!dst) {
+			return NULL;
+		}
+
+		if ((type == FIT_BITMAP) && (bpp == 8)) {
+			memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), 256 * sizeof(RGBQUAD));
+		}
+
+		// fill the borders with the pixel value FreeImage_AllocateExT would use
+		if (IsFillNeeded(dst, color)) {
+			BYTE pixel[16];
+			const int size = GetFillPixel(dst, color, options, pixel);
+			if (size > 0) {
+				const unsigned leftBorder = MAX(0, left);
+				const unsigned rightBorder = MAX(0, right);
+				const unsigned topBorder = MAX(0, top);
+				const unsigned bottomBorder = MAX(0, bottom);
+				const unsigned middleLines = newHeight - topBorder - bottomBorder;
+
+				// bottom and top borders (scanlines are counted from the bottom)
+				FillRect(dst, pixel, size, 0, 0, newWidth, bottomBorder);
+				FillRect(dst, pixel, size, 0, newHeight - topBorder, newWidth, topBorder);
+				// left and right borders
+				FillRect(dst, pixel, size, 0, bottomBorder, leftBorder, middleLines);
+				FillRect(dst, pixel, size, newWidth - rightBorder, bottomBorder, rightBorder, middleLines);
+			}
+		}
+
 		int bytespp = bpp / 8;
 		BYTE *srcPtr = FreeImage_GetScanLine(src, height - 1 - ((top >= 0) ? 0 : -top));
 		BYTE *dstPtr = FreeImage_GetScanLine(dst, newHeight - 1 - ((top <= 0) ? 0 : top));
@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 
 /** @brief Retrieves the red, green, blue or alpha channel of a BGR[A] image. 
@@ -486,3 +487,678 @@ FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANN
 
 	return TRUE;
 }
+
+// ----------------------------------------------------------
+//   Planar split / merge
+// ----------------------------------------------------------
+
+// minimum number of pixels worth a thread in the planar routines
+#define PLANAR_MIN_THREAD_PIXELS	(256 * 256)
+
+/**
+Describe the samples of a greyscale or RGB[A] image.
+@param dib Input image
+@param sample_type Receives the image type of a single plane (FIT_BITMAP, FIT_UINT16 or FIT_FLOAT)
+@param position Receives the position of the red, green, blue and alpha samples inside a pixel, in samples
+@return Returns the number of channels (1, 3 or 4), returns 0 if the image type is not supported
+*/
+static unsigned
+GetPlanarLayout(FIBITMAP *dib, FREE_IMAGE_TYPE *sample_type, unsigned *position) {
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	// always RGB[A], except for 24- and 32-bit images
+	for(unsigned c = 0; c < 4; c++) {
+		position[c] = c;
+	}
+
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			*sample_type = FIT_BITMAP;
+			if((bpp == 8) && (FreeImage_GetColorType(dib) == FIC_MINISBLACK)) {
+				return 1;
+			}
+			if((bpp == 24) || (bpp == 32)) {
+				position[0] = FI_RGBA_RED;
+				position[1] = FI_RGBA_GREEN;
+				position[2] = FI_RGBA_BLUE;
+				position[3] = FI_RGBA_ALPHA;
+				return bpp / 8;
+			}
+			return 0;
+
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			*sample_type = FIT_UINT16;
+			return bpp / 16;
+
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			*sample_type = FIT_FLOAT;
+			return bpp / 32;
+
+		default:
+			return 0;
+	}
+}
+
+/**
+Allocate a greyscale, RGB or RGBA image made of 8-bit, 16-bit or float samples.
+@param sample_type FIT_BITMAP, FIT_UINT16 or FIT_FLOAT
+@param channels Number of channels (1, 3 or 4)
+@return Returns the allocated image, returns NULL otherwise
+*/
+static FIBITMAP*
+AllocatePlanarImage(FREE_IMAGE_TYPE sample_type, unsigned channels, unsigned width, unsigned height) {
+	static const FREE_IMAGE_TYPE types16[] = { FIT_UINT16, FIT_UNKNOWN, FIT_RGB16, FIT_RGBA16 };
+	static const FREE_IMAGE_TYPE typesF[] = { FIT_FLOAT, FIT_UNKNOWN, FIT_RGBF, FIT_RGBAF };
+
+	switch(sample_type) {
+		case FIT_BITMAP:
+			if(channels == 1) {
+				FIBITMAP *dib = FreeImage_Allocate(width, height, 8);
+				if(dib) {
+					CREATE_GREYSCALE_PALETTE(FreeImage_GetPalette(dib), 256);
+				}
+				return dib;
+			}
+			return FreeImage_Allocate(width, height, 8 * channels, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		case FIT_UINT16:
+			return FreeImage_AllocateT(types16[channels - 1], width, height);
+		case FIT_FLOAT:
+			return FreeImage_AllocateT(typesF[channels - 1], width, height);
+		default:
+			return NULL;
+	}
+}
+
+/**
+Copy the samples of the pixels [x, width) of a line to one line per channel
+*/
+template <class T> static void
+SplitLine(BYTE *const *planes, const BYTE *pixels, unsigned x, unsigned width, unsigned channels, const unsigned *position) {
+	const T *src = (const T*)pixels;
+	for(unsigned c = 0; c < channels; c++) {
+		T *dst = (T*)planes[c];
+		for(unsigned i = x; i < width; i++) {
+			dst[i] = src[i * channels + position[c]];
+		}
+	}
+}
+
+/**
+Copy the samples of the pixels [x, width) of one line per channel to a line
+*/
+template <class T> static void
+MergeLine(BYTE *pixels, const BYTE *const *planes, unsigned x, unsigned width, unsigned channels, const unsigned *position) {
+	T *dst = (T*)pixels;
+	for(unsigned c = 0; c < channels; c++) {
+		const T *src = (const T*)planes[c];
+		for(unsigned i = x; i < width; i++) {
+			dst[i * channels + position[c]] = src[i];
+		}
+	}
+}
+
+/**
+Convert the samples of the pixels [x, width) of a line to one float line per channel
+*/
+template <class T> static void
+ToPlanarFloatLine(float *const *planes, const BYTE *pixels, unsigned x, unsigned width, unsigned channels, const unsigned *position, const float *scale, const float *offset) {
+	const T *src = (const T*)pixels;
+	for(unsigned c = 0; c < channels; c++) {
+		float *dst = planes[c];
+		for(unsigned i = x; i < width; i++) {
+			dst[i] = (float)src[i * channels + position[c]] * scale[c] + offset[c];
+		}
+	}
+}
+
+/**
+Convert the pixels [x, width) of one float line per channel to a line of integer samples,
+rounding to the nearest value of the range [0, max_value]
+*/
+template <class T> static void
+FromPlanarFloatLine(BYTE *pixels, const float *const *planes, unsigned x, unsigned width, unsigned channels, const unsigned *position, const float *inv_scale, const float *offset, float max_value) {
+	T *dst = (T*)pixels;
+	for(unsigned c = 0; c < channels; c++) {
+		const float *src = planes[c];
+		for(unsigned i = x; i < width; i++) {
+			float value = (src[i] - offset[c]) * inv_scale[c];
+			// NaN goes to 0
+			value = (value > 0) ? value : 0;
+			value = (value < max_value) ? value : max_value;
+			dst[i * channels + position[c]] = (T)(value + 0.5F);
+		}
+	}
+}
+
+/**
+Convert the pixels [x, width) of one float line per channel to a line of float samples
+*/
+static void
+FromPlanarFloatLineF(BYTE *pixels, const float *const *planes, unsigned x, unsigned width, unsigned channels, const float *inv_scale, const float *offset) {
+	float *dst = (float*)pixels;
+	for(unsigned c = 0; c < channels; c++) {
+		const float *src = planes[c];
+		for(unsigned i = x; i < width; i++) {
+			dst[i * channels + c] = (src[i] - offset[c]) * inv_scale[c];
+		}
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Load 4 pixels of 3 bytes into the 32-bit lanes of a vector, the high byte of each lane is undefined.
+Reads 16 bytes.
+*/
+static inline __m128i
+LoadPixels24(const BYTE *pixels) {
+	const __m128i v = _mm_loadu_si128((const __m128i*)pixels);
+	const __m128i lo = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+	const __m128i hi = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+/**
+Gather one byte of each 32-bit lane of 4 vectors into 16 bytes
+*/
+static inline __m128i
+GatherBytes(__m128i p0, __m128i p1, __m128i p2, __m128i p3, unsigned position) {
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i shift = _mm_cvtsi32_si128((int)(8 * position));
+	const __m128i lo = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(p0, shift), mask), _mm_and_si128(_mm_srl_epi32(p1, shift), mask));
+	const __m128i hi = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(p2, shift), mask), _mm_and_si128(_mm_srl_epi32(p3, shift), mask));
+	return _mm_packus_epi16(lo, hi);
+}
+
+#endif // FREEIMAGE_SSE2
+
+static void
+SplitLine8(BYTE *const *planes, const BYTE *pixels, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		for(; x + 16 <= width; x += 16) {
+			const BYTE *p = pixels + 4 * x;
+			const __m128i p0 = _mm_loadu_si128((const __m128i*)p);
+			const __m128i p1 = _mm_loadu_si128((const __m128i*)(p + 16));
+			const __m128i p2 = _mm_loadu_si128((const __m128i*)(p + 32));
+			const __m128i p3 = _mm_loadu_si128((const __m128i*)(p + 48));
+			for(unsigned c = 0; c < 4; c++) {
+				_mm_storeu_si128((__m128i*)(planes[c] + x), GatherBytes(p0, p1, p2, p3, position[c]));
+			}
+		}
+	} else if(channels == 3) {
+		// the last load reads 4 bytes past the 16th pixel
+		for(; x + 18 <= width; x += 16) {
+			const BYTE *p = pixels + 3 * x;
+			const __m128i p0 = LoadPixels24(p);
+			const __m128i p1 = LoadPixels24(p + 12);
+			const __m128i p2 = LoadPixels24(p + 24);
+			const __m128i p3 = LoadPixels24(p + 36);
+			for(unsigned c = 0; c < 3; c++) {
+				_mm_storeu_si128((__m128i*)(planes[c] + x), GatherBytes(p0, p1, p2, p3, position[c]));
+			}
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	SplitLine<BYTE>(planes, pixels, x, width, channels, position);
+}
+
+static void
+MergeLine8(BYTE *pixels, const BYTE *const *planes, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		// planes in memory order
+		const BYTE *src[4];
+		for(unsigned c = 0; c < 4; c++) {
+			src[position[c]] = planes[c];
+		}
+		for(; x + 16 <= width; x += 16) {
+			const __m128i v0 = _mm_loadu_si128((const __m128i*)(src[0] + x));
+			const __m128i v1 = _mm_loadu_si128((const __m128i*)(src[1] + x));
+			const __m128i v2 = _mm_loadu_si128((const __m128i*)(src[2] + x));
+			const __m128i v3 = _mm_loadu_si128((const __m128i*)(src[3] + x));
+			const __m128i lo01 = _mm_unpacklo_epi8(v0, v1);
+			const __m128i hi01 = _mm_unpackhi_epi8(v0, v1);
+			const __m128i lo23 = _mm_unpacklo_epi8(v2, v3);
+			const __m128i hi23 = _mm_unpackhi_epi8(v2, v3);
+			BYTE *p = pixels + 4 * x;
+			_mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)(p + 16), _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)(p + 32), _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i*)(p + 48), _mm_unpackhi_epi16(hi01, hi23));
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	MergeLine<BYTE>(pixels, planes, x, width, channels, position);
+}
+
+static void
+SplitLine16(BYTE *const *planes, const BYTE *pixels, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		// RGBA16, position[c] == c
+		for(; x + 8 <= width; x += 8) {
+			const __m128i *p = (const __m128i*)(pixels + 8 * x);
+			const __m128i p01 = _mm_loadu_si128(p);
+			const __m128i p23 = _mm_loadu_si128(p + 1);
+			const __m128i p45 = _mm_loadu_si128(p + 2);
+			const __m128i p67 = _mm_loadu_si128(p + 3);
+			// R0 R2 G0 G2 B0 B2 A0 A2 | R1 R3 G1 G3 B1 B3 A1 A3
+			const __m128i a = _mm_unpacklo_epi16(p01, p23);
+			const __m128i b = _mm_unpackhi_epi16(p01, p23);
+			const __m128i c = _mm_unpacklo_epi16(p45, p67);
+			const __m128i d = _mm_unpackhi_epi16(p45, p67);
+			// R0 R1 R2 R3 G0 G1 G2 G3 | B0 B1 B2 B3 A0 A1 A2 A3
+			const __m128i rg03 = _mm_unpacklo_epi16(a, b);
+			const __m128i ba03 = _mm_unpackhi_epi16(a, b);
+			const __m128i rg47 = _mm_unpacklo_epi16(c, d);
+			const __m128i ba47 = _mm_unpackhi_epi16(c, d);
+			_mm_storeu_si128((__m128i*)(planes[0] + 2 * x), _mm_unpacklo_epi64(rg03, rg47));
+			_mm_storeu_si128((__m128i*)(planes[1] + 2 * x), _mm_unpackhi_epi64(rg03, rg47));
+			_mm_storeu_si128((__m128i*)(planes[2] + 2 * x), _mm_unpacklo_epi64(ba03, ba47));
+			_mm_storeu_si128((__m128i*)(planes[3] + 2 * x), _mm_unpackhi_epi64(ba03, ba47));
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	SplitLine<WORD>(planes, pixels, x, width, channels, position);
+}
+
+static void
+MergeLine16(BYTE *pixels, const BYTE *const *planes, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		// RGBA16, position[c] == c
+		for(; x + 8 <= width; x += 8) {
+			const __m128i r = _mm_loadu_si128((const __m128i*)(planes[0] + 2 * x));
+			const __m128i g = _mm_loadu_si128((const __m128i*)(planes[1] + 2 * x));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(planes[2] + 2 * x));
+			const __m128i a = _mm_loadu_si128((const __m128i*)(planes[3] + 2 * x));
+			const __m128i rg_lo = _mm_unpacklo_epi16(r, g);
+			const __m128i rg_hi = _mm_unpackhi_epi16(r, g);
+			const __m128i ba_lo = _mm_unpacklo_epi16(b, a);
+			const __m128i ba_hi = _mm_unpackhi_epi16(b, a);
+			__m128i *p = (__m128i*)(pixels + 8 * x);
+			_mm_storeu_si128(p, _mm_unpacklo_epi32(rg_lo, ba_lo));
+			_mm_storeu_si128(p + 1, _mm_unpackhi_epi32(rg_lo, ba_lo));
+			_mm_storeu_si128(p + 2, _mm_unpacklo_epi32(rg_hi, ba_hi));
+			_mm_storeu_si128(p + 3, _mm_unpackhi_epi32(rg_hi, ba_hi));
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	MergeLine<WORD>(pixels, planes, x, width, channels, position);
+}
+
+static void
+SplitLineF(BYTE *const *planes, const BYTE *pixels, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		// RGBAF, position[c] == c
+		for(; x + 4 <= width; x += 4) {
+			const float *p = (const float*)pixels + 4 * x;
+			__m128 r = _mm_loadu_ps(p);
+			__m128 g = _mm_loadu_ps(p + 4);
+			__m128 b = _mm_loadu_ps(p + 8);
+			__m128 a = _mm_loadu_ps(p + 12);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			_mm_storeu_ps((float*)planes[0] + x, r);
+			_mm_storeu_ps((float*)planes[1] + x, g);
+			_mm_storeu_ps((float*)planes[2] + x, b);
+			_mm_storeu_ps((float*)planes[3] + x, a);
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	SplitLine<float>(planes, pixels, x, width, channels, position);
+}
+
+static void
+MergeLineF(BYTE *pixels, const BYTE *const *planes, unsigned width, unsigned channels, const unsigned *position) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		// RGBAF, position[c] == c
+		for(; x + 4 <= width; x += 4) {
+			__m128 p0 = _mm_loadu_ps((const float*)planes[0] + x);
+			__m128 p1 = _mm_loadu_ps((const float*)planes[1] + x);
+			__m128 p2 = _mm_loadu_ps((const float*)planes[2] + x);
+			__m128 p3 = _mm_loadu_ps((const float*)planes[3] + x);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			float *p = (float*)pixels + 4 * x;
+			_mm_storeu_ps(p, p0);
+			_mm_storeu_ps(p + 4, p1);
+			_mm_storeu_ps(p + 8, p2);
+			_mm_storeu_ps(p + 12, p3);
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	MergeLine<float>(pixels, planes, x, width, channels, position);
+}
+
+static void
+ToPlanarFloatLine8(float *const *planes, const BYTE *pixels, unsigned width, unsigned channels, const unsigned *position, const float *scale, const float *offset) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if((channels == 3) || (channels == 4)) {
+		const __m128i mask = _mm_set1_epi32(0xFF);
+		__m128 s[4], o[4];
+		__m128i shift[4];
+		for(unsigned c = 0; c < channels; c++) {
+			s[c] = _mm_set1_ps(scale[c]);
+			o[c] = _mm_set1_ps(offset[c]);
+			shift[c] = _mm_cvtsi32_si128((int)(8 * position[c]));
+		}
+		// a line of 3-byte pixels is read 4 bytes past the 4th pixel
+		const unsigned end = (channels == 4) ? width : ((width > 2) ? width - 2 : 0);
+		for(; x + 4 <= end; x += 4) {
+			const __m128i p = (channels == 4) ? _mm_loadu_si128((const __m128i*)(pixels + 4 * x)) : LoadPixels24(pixels + 3 * x);
+			for(unsigned c = 0; c < channels; c++) {
+				const __m128 value = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(p, shift[c]), mask));
+				_mm_storeu_ps(planes[c] + x, _mm_add_ps(_mm_mul_ps(value, s[c]), o[c]));
+			}
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	ToPlanarFloatLine<BYTE>(planes, pixels, x, width, channels, position, scale, offset);
+}
+
+static void
+FromPlanarFloatLine8(BYTE *pixels, const float *const *planes, unsigned width, unsigned channels, const unsigned *position, const float *inv_scale, const float *offset) {
+	unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+	if(channels == 4) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 max_value = _mm_set1_ps(255);
+		const __m128 half = _mm_set1_ps(0.5F);
+		for(; x + 4 <= width; x += 4) {
+			__m128i p = _mm_setzero_si128();
+			for(unsigned c = 0; c < 4; c++) {
+				__m128 value = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(planes[c] + x), _mm_set1_ps(offset[c])), _mm_set1_ps(inv_scale[c]));
+				// same clamping and rounding as FromPlanarFloatLine, NaN goes to 0
+				value = _mm_min_ps(_mm_max_ps(value, zero), max_value);
+				const __m128i sample = _mm_cvttps_epi32(_mm_add_ps(value, half));
+				p = _mm_or_si128(p, _mm_sll_epi32(sample, _mm_cvtsi32_si128((int)(8 * position[c]))));
+			}
+			_mm_storeu_si128((__m128i*)(pixels + 4 * x), p);
+		}
+	}
+#endif // FREEIMAGE_SSE2
+	FromPlanarFloatLine<BYTE>(pixels, planes, x, width, channels, position, inv_scale, offset, 255);
+}
+
+/**
+Get the value that maps the full range of a sample type to [0, 1]
+*/
+static float
+GetDefaultPlanarScale(FREE_IMAGE_TYPE sample_type) {
+	switch(sample_type) {
+		case FIT_BITMAP:
+			return 1.0F / 255;
+		case FIT_UINT16:
+			return 1.0F / 65535;
+		default:
+			return 1;
+	}
+}
+
+/** @brief Split a greyscale or RGB[A] image into one greyscale image per channel.
+
+8-bit samples go to 8-bit greyscale images, 16-bit samples to FIT_UINT16 images and 
+float samples to FIT_FLOAT images. Channels are returned in red, green, blue, alpha order.
+@param dib Input image (8-bit greyscale, 24- or 32-bit, FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF or FIT_RGBAF)
+@param planes Array receiving the channel images
+@param count Size of the planes array, must be at least the number of channels of dib
+@return Returns the number of channel images (1, 3 or 4) if successful, returns 0 otherwise
+@see FreeImage_MergeChannels, FreeImage_GetChannel
+*/
+unsigned DLL_CALLCONV
+FreeImage_SplitChannels(FIBITMAP *dib, FIBITMAP **planes, unsigned count) {
+	if(!FreeImage_HasPixels(dib) || !planes) return 0;
+
+	FREE_IMAGE_TYPE sample_type;
+	unsigned position[4];
+	const unsigned channels = GetPlanarLayout(dib, &sample_type, position);
+	if(!channels || (count < channels)) return 0;
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIBITMAP *plane[4] = { NULL, NULL, NULL, NULL };
+	for(unsigned c = 0; c < channels; c++) {
+		plane[c] = AllocatePlanarImage(sample_type, 1, width, height);
+		if(!plane[c]) {
+			for(unsigned k = 0; k < c; k++) {
+				FreeImage_Unload(plane[k]);
+			}
+			return 0;
+		}
+	}
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, PLANAR_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		BYTE *lines[4];
+		for(unsigned y = first; y < last; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(dib, y);
+			for(unsigned c = 0; c < channels; c++) {
+				lines[c] = FreeImage_GetScanLine(plane[c], y);
+			}
+			switch(sample_type) {
+				case FIT_BITMAP:
+					SplitLine8(lines, bits, width, channels, position);
+					break;
+				case FIT_UINT16:
+					SplitLine16(lines, bits, width, channels, position);
+					break;
+				default:
+					SplitLineF(lines, bits, width, channels, position);
+					break;
+			}
+		}
+	});
+
+	for(unsigned c = 0; c < channels; c++) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(plane[c], dib);
+		planes[c] = plane[c];
+	}
+
+	return channels;
+}
+
+/** @brief Build a RGB[A] image from one greyscale image per channel.
+
+All the channel images must have the same size and type: 8-bit greyscale images make 
+a 24- or 32-bit image, FIT_UINT16 images a FIT_RGB16 or FIT_RGBA16 image and FIT_FLOAT 
+images a FIT_RGBF or FIT_RGBAF image.
+@param planes Channel images, in red, green, blue, alpha order
+@param count Number of channel images (3 or 4)
+@return Returns the merged image if successful, returns NULL otherwise
+@see FreeImage_SplitChannels, FreeImage_SetChannel
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_MergeChannels(FIBITMAP **planes, unsigned count) {
+	if(!planes || ((count != 3) && (count != 4))) return NULL;
+
+	FREE_IMAGE_TYPE sample_type = FIT_UNKNOWN;
+	unsigned width = 0, height = 0;
+
+	for(unsigned c = 0; c < count; c++) {
+		FREE_IMAGE_TYPE plane_type;
+		unsigned plane_position[4];
+		if(!FreeImage_HasPixels(planes[c]) || (GetPlanarLayout(planes[c], &plane_type, plane_position) != 1)) {
+			return NULL;
+		}
+		if(c == 0) {
+			sample_type = plane_type;
+			width = FreeImage_GetWidth(planes[c]);
+			height = FreeImage_GetHeight(planes[c]);
+		} else if((plane_type != sample_type) || (FreeImage_GetWidth(planes[c]) != width) || (FreeImage_GetHeight(planes[c]) != height)) {
+			return NULL;
+		}
+	}
+
+	FIBITMAP *dst = AllocatePlanarImage(sample_type, count, width, height);
+	if(!dst) return NULL;
+
+	unsigned position[4];
+	GetPlanarLayout(dst, &sample_type, position);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, PLANAR_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		const BYTE *lines[4];
+		for(unsigned y = first; y < last; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dst, y);
+			for(unsigned c = 0; c < count; c++) {
+				lines[c] = FreeImage_GetScanLine(planes[c], y);
+			}
+			switch(sample_type) {
+				case FIT_BITMAP:
+					MergeLine8(bits, lines, width, count, position);
+					break;
+				case FIT_UINT16:
+					MergeLine16(bits, lines, width, count, position);
+					break;
+				default:
+					MergeLineF(bits, lines, width, count, position);
+					break;
+			}
+		}
+	});
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, planes[0]);
+
+	return dst;
+}
+
+/** @brief Convert a greyscale or RGB[A] image to planar float samples.
+
+The planes are stored one after the other in red, green, blue, alpha order, each plane 
+being width x height floats with rows stored top-down. A sample value v is stored as 
+v * scale[c] + offset[c].
+@param dib Input image (8-bit greyscale, 24- or 32-bit, FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF or FIT_RGBAF)
+@param planes Output buffer of channels x width x height floats. If NULL, only the number of channels is returned
+@param scale Scale of each channel. If NULL, samples are scaled to [0, 1] (1/255 for 8-bit samples, 1/65535 for 16-bit samples, 1 for float samples)
+@param offset Offset of each channel. If NULL, no offset is added
+@return Returns the number of channels (1, 3 or 4) if successful, returns 0 otherwise
+@see FreeImage_ConvertFromPlanarFloat
+*/
+unsigned DLL_CALLCONV
+FreeImage_ConvertToPlanarFloat(FIBITMAP *dib, float *planes, const float *scale, const float *offset) {
+	if(!FreeImage_HasPixels(dib)) return 0;
+
+	FREE_IMAGE_TYPE sample_type;
+	unsigned position[4];
+	const unsigned channels = GetPlanarLayout(dib, &sample_type, position);
+	if(!channels || !planes) return channels;
+
+	float s[4], o[4];
+	for(unsigned c = 0; c < channels; c++) {
+		s[c] = scale ? scale[c] : GetDefaultPlanarScale(sample_type);
+		o[c] = offset ? offset[c] : 0;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const size_t plane_size = (size_t)width * height;
+
+	const unsigned threads = FreeImage_GetThreadCount(plane_size, PLANAR_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		float *lines[4];
+		for(unsigned y = first; y < last; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+			for(unsigned c = 0; c < channels; c++) {
+				lines[c] = planes + c * plane_size + (size_t)y * width;
+			}
+			switch(sample_type) {
+				case FIT_BITMAP:
+					ToPlanarFloatLine8(lines, bits, width, channels, position, s, o);
+					break;
+				case FIT_UINT16:
+					ToPlanarFloatLine<WORD>(lines, bits, 0, width, channels, position, s, o);
+					break;
+				default:
+					ToPlanarFloatLine<float>(lines, bits, 0, width, channels, position, s, o);
+					break;
+			}
+		}
+	});
+
+	return channels;
+}
+
+/** @brief Build a greyscale or RGB[A] image from planar float samples.
+
+This is the reverse of FreeImage_ConvertToPlanarFloat: a planar value p is stored as 
+(p - offset[c]) / scale[c], rounded and clamped to the range of the sample type.
+@param planes Input buffer of channels x width x height floats, planes in red, green, blue, alpha order, rows stored top-down
+@param width Image width
+@param height Image height
+@param channels Number of channels (1, 3 or 4)
+@param type Sample type: FIT_BITMAP (8-bit greyscale, 24- or 32-bit image), FIT_UINT16 (FIT_UINT16, FIT_RGB16 or FIT_RGBA16 image) or FIT_FLOAT (FIT_FLOAT, FIT_RGBF or FIT_RGBAF image)
+@param scale Scale of each channel. If NULL, [0, 1] is mapped to the full range of the sample type
+@param offset Offset of each channel. If NULL, no offset is subtracted
+@return Returns the converted image if successful, returns NULL otherwise
+@see FreeImage_ConvertToPlanarFloat
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertFromPlanarFloat(const float *planes, unsigned width, unsigned height, unsigned channels, FREE_IMAGE_TYPE type, const float *scale, const float *offset) {
+	if(!planes || !width || !height) return NULL;
+	if((channels != 1) && (channels != 3) && (channels != 4)) return NULL;
+	if((type != FIT_BITMAP) && (type != FIT_UINT16) && (type != FIT_FLOAT)) return NULL;
+
+	float inv_scale[4], o[4];
+	for(unsigned c = 0; c < channels; c++) {
+		if(scale) {
+			if(scale[c] == 0) return NULL;
+			inv_scale[c] = (float)(1.0 / scale[c]);
+		} else {
+			inv_scale[c] = (type == FIT_BITMAP) ? 255.0F : ((type == FIT_UINT16) ? 65535.0F : 1.0F);
+		}
+		o[c] = offset ? offset[c] : 0;
+	}
+
+	FIBITMAP *dst = AllocatePlanarImage(type, channels, width, height);
+	if(!dst) return NULL;
+
+	FREE_IMAGE_TYPE sample_type;
+	unsigned position[4];
+	GetPlanarLayout(dst, &sample_type, position);
+
+	const size_t plane_size = (size_t)width * height;
+
+	const unsigned threads = FreeImage_GetThreadCount(plane_size, PLANAR_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned first, unsigned last, unsigned) {
+		const float *lines[4];
+		for(unsigned y = first; y < last; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dst, height - 1 - y);
+			for(unsigned c = 0; c < channels; c++) {
+				lines[c] = planes + c * plane_size + (size_t)y * width;
+			}
+			switch(sample_type) {
+				case FIT_BITMAP:
+					FromPlanarFloatLine8(bits, lines, width, channels, position, inv_scale, o);
+					break;
+				case FIT_UINT16:
+					FromPlanarFloatLine<WORD>(bits, lines, 0, width, channels, position, inv_scale, o, 65535);
+					break;
+				default:
+					FromPlanarFloatLineF(bits, lines, 0, width, channels, inv_scale, o);
+					break;
+			}
+		}
+	});
+
+	return dst;
+}
@@ -35,10 +35,367 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 #define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
 
+#define ROTATE_MIN_THREAD_PIXELS	0x40000	// minimum number of pixels per thread
+
 // --------------------------------------------------------------------------
+// Block transpose kernels, used by the 90 and 270 degree rotations
+
+/** Pixel of N bytes, copied as a whole */
+template <unsigned N> struct TransposePixel {
+	BYTE bytes[N];
+};
+
+/**
+Transpose a width x height area: pixel (x, y) of src is copied to pixel (y, x) of dst.
+Pitches are signed, so that the rows of src or dst can be walked in reverse order.
+*/
+template <unsigned N> static void
+TransposeScalarT(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch, unsigned width, unsigned height) {
+	typedef TransposePixel<N> T;
+
+	for(unsigned x = 0; x < width; x++) {
+		const BYTE *src_bits = src + x * N;
+		T *dst_bits = reinterpret_cast<T*>(dst + (ptrdiff_t)x * dst_pitch);
+		for(unsigned y = 0; y < height; y++) {
+			dst_bits[y] = *reinterpret_cast<const T*>(src_bits);
+			src_bits += src_pitch;
+		}
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+In-register transpose of K x K tiles of N-byte pixels.
+*/
+template <unsigned N> struct TransposeTile;
+
+/** 8 x 8 tile of 8-bit pixels */
+template <> struct TransposeTile<1> {
+	enum { K = 8 };
+
+	static inline void transpose(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch) {
+		__m128i r[8];
+		for(int i = 0; i < 8; i++) {
+			r[i] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i * src_pitch));
+		}
+		const __m128i t0 = _mm_unpacklo_epi8(r[0], r[1]);
+		const __m128i t1 = _mm_unpacklo_epi8(r[2], r[3]);
+		const __m128i t2 = _mm_unpacklo_epi8(r[4], r[5]);
+		const __m128i t3 = _mm_unpacklo_epi8(r[6], r[7]);
+		const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+		const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+		const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+		const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+		// each vector holds two output rows
+		const __m128i v[4] = {
+			_mm_unpacklo_epi32(u0, u2), _mm_unpackhi_epi32(u0, u2),
+			_mm_unpacklo_epi32(u1, u3), _mm_unpackhi_epi32(u1, u3)
+		};
+		for(int i = 0; i < 4; i++) {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (2 * i) * dst_pitch), v[i]);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (2 * i + 1) * dst_pitch), _mm_unpackhi_epi64(v[i], v[i]));
+		}
+	}
+};
+
+/** 8 x 8 tile of 16-bit pixels */
+template <> struct TransposeTile<2> {
+	enum { K = 8 };
+
+	static inline void transpose(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch) {
+		__m128i r[8], t[8], u[8];
+		for(int i = 0; i < 8; i++) {
+			r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * src_pitch));
+		}
+		for(int i = 0; i < 8; i += 2) {
+			t[i]     = _mm_unpacklo_epi16(r[i], r[i + 1]);
+			t[i + 1] = _mm_unpackhi_epi16(r[i], r[i + 1]);
+		}
+		for(int i = 0; i < 8; i += 4) {
+			u[i]     = _mm_unpacklo_epi32(t[i], t[i + 2]);
+			u[i + 1] = _mm_unpackhi_epi32(t[i], t[i + 2]);
+			u[i + 2] = _mm_unpacklo_epi32(t[i + 1], t[i + 3]);
+			u[i + 3] = _mm_unpackhi_epi32(t[i + 1], t[i + 3]);
+		}
+		for(int i = 0; i < 4; i++) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (2 * i) * dst_pitch), _mm_unpacklo_epi64(u[i], u[i + 4]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (2 * i + 1) * dst_pitch), _mm_unpackhi_epi64(u[i], u[i + 4]));
+		}
+	}
+};
+
+/** 4 x 4 tile of 32-bit pixels */
+template <> struct TransposeTile<4> {
+	enum { K = 4 };
+
+	static inline void transpose(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch) {
+		const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + src_pitch));
+		const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * src_pitch));
+		const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * src_pitch));
+		const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+		const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+		const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+		const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + dst_pitch), _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * dst_pitch), _mm_unpacklo_epi64(t2, t3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * dst_pitch), _mm_unpackhi_epi64(t2, t3));
+	}
+};
+
+/** 2 x 2 tile of 64-bit pixels */
+template <> struct TransposeTile<8> {
+	enum { K = 2 };
+
+	static inline void transpose(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch) {
+		const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + src_pitch));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi64(r0, r1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + dst_pitch), _mm_unpackhi_epi64(r0, r1));
+	}
+};
+
+/**
+Transpose a width x height area with in-register tiles. 
+The edges that do not fill a whole tile are handled by TransposeScalarT.
+*/
+template <unsigned N> static void
+TransposeTiledT(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch, unsigned width, unsigned height) {
+	const unsigned K = TransposeTile<N>::K;
+	const unsigned tiled_width  = width - width % K;
+	const unsigned tiled_height = height - height % K;
+
+	for(unsigned x = 0; x < tiled_width; x += K) {
+		const BYTE *src_bits = src + x * N;
+		BYTE *dst_bits = dst + (ptrdiff_t)x * dst_pitch;
+		for(unsigned y = 0; y < tiled_height; y += K) {
+			TransposeTile<N>::transpose(src_bits + (ptrdiff_t)y * src_pitch, src_pitch, dst_bits + y * N, dst_pitch);
+		}
+	}
+	if(tiled_width < width) {
+		TransposeScalarT<N>(src + tiled_width * N, src_pitch, dst + (ptrdiff_t)tiled_width * dst_pitch, dst_pitch, width - tiled_width, height);
+	}
+	if(tiled_height < height) {
+		TransposeScalarT<N>(src + (ptrdiff_t)tiled_height * src_pitch, src_pitch, dst + tiled_height * N, dst_pitch, tiled_width, height - tiled_height);
+	}
+}
+
+#else
+
+template <unsigned N> static void
+TransposeTiledT(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch, unsigned width, unsigned height) {
+	TransposeScalarT<N>(src, src_pitch, dst, dst_pitch, width, height);
+}
+
+#endif // FREEIMAGE_SSE2
+
+typedef void (*TransposeBlockProc)(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch, unsigned width, unsigned height);
+
+/**
+Transpose an image of 8-bit pixels or more: pixel (x, y) of src is copied to pixel (y, x) of dst. 
+The image is processed by cache friendly blocks of RBLOCK*RBLOCK pixels, bands of 
+blocks are processed concurrently.
+@param src Pointer to the first pixel of the first source row
+@param src_pitch Signed distance in bytes between two source rows
+@param dst Pointer to the first pixel of the first destination row
+@param dst_pitch Signed distance in bytes between two destination rows
+@param width Source width
+@param height Source height
+@param bytespp Number of bytes per pixel
+@return Returns FALSE if the pixel size is not supported, TRUE otherwise
+*/
+static BOOL
+Transpose(const BYTE *src, ptrdiff_t src_pitch, BYTE *dst, ptrdiff_t dst_pitch, unsigned width, unsigned height, unsigned bytespp) {
+	TransposeBlockProc transpose_block = NULL;
+
+	switch(bytespp) {
+		case 1:
+			transpose_block = TransposeTiledT<1>;
+			break;
+		case 2:
+			transpose_block = TransposeTiledT<2>;
+			break;
+		case 3:
+			transpose_block = TransposeScalarT<3>;
+			break;
+		case 4:
+			transpose_block = TransposeTiledT<4>;
+			break;
+		case 6:
+			transpose_block = TransposeScalarT<6>;
+			break;
+		case 8:
+			transpose_block = TransposeTiledT<8>;
+			break;
+		case 12:
+			transpose_block = TransposeScalarT<12>;
+			break;
+		case 16:
+			transpose_block = TransposeScalarT<16>;
+			break;
+		default:
+			return FALSE;
+	}
+
+	// bands of source columns (i.e. destination rows), in whole blocks
+	const unsigned blocks = (width + RBLOCK - 1) / RBLOCK;
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, ROTATE_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, blocks, threads, [=](unsigned block_begin, unsigned block_end, unsigned) {
+		for(unsigned xs = block_begin * RBLOCK; xs < MIN(block_end * RBLOCK, width); xs += RBLOCK) {
+			const unsigned block_width = MIN((unsigned)RBLOCK, width - xs);
+			for(unsigned ys = 0; ys < height; ys += RBLOCK) {
+				const unsigned block_height = MIN((unsigned)RBLOCK, height - ys);
+				transpose_block(src + (ptrdiff_t)ys * src_pitch + xs * bytespp, src_pitch, 
+					dst + (ptrdiff_t)xs * dst_pitch + ys * bytespp, dst_pitch, block_width, block_height);
+			}
+		}
+	});
+
+	return TRUE;
+}
+
+// --------------------------------------------------------------------------
+// Skew kernels, used by the 3-shear rotation
+
+/**
+Compute the left over of a row of samples, i.e. the part of each sample that is 
+carried over to the next pixel by a skew: 
+left[k] = T(bkg + (src[k] - bkg) * weight + 0.5), bkg being the background sample of src[k].
+@param src Source samples
+@param left Output left overs
+@param begin First sample to process, a multiple of samples
+@param end One past the last sample to process
+@param samples Number of samples per pixel
+@param bkg Background pixel
+@param weight Relative weight of the right pixel
+*/
+template <class T> static inline void 
+SkewWeightsT(const T *src, T *left, unsigned begin, unsigned end, unsigned samples, const T *bkg, double weight) {
+	for(unsigned k = begin, j = 0; k < end; k++) {
+		left[k] = static_cast<T>(bkg[j] + (src[k] - bkg[j]) * weight + 0.5);
+		if(++j == samples) {
+			j = 0;
+		}
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Loads 4 samples minus their background as doubles, and stores 4 doubles back as samples. 
+The conversions match the ones done by SkewWeightsT.
+*/
+struct SkewVectorBYTE {
+	static inline __m128i load(const BYTE *p) {
+		int v;
+		memcpy(&v, p, sizeof(v));
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+	}
+	static inline void diff(const BYTE *src, const BYTE *bkg, __m128d &lo, __m128d &hi) {
+		const __m128i d = _mm_sub_epi32(load(src), load(bkg));
+		lo = _mm_cvtepi32_pd(d);
+		hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+	static inline void store(BYTE *p, __m128d lo, __m128d hi) {
+		__m128i v = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+		v = _mm_packs_epi32(v, v);
+		v = _mm_packus_epi16(v, v);
+		const int r = _mm_cvtsi128_si32(v);
+		memcpy(p, &r, sizeof(r));
+	}
+};
+
+struct SkewVectorWORD {
+	static inline __m128i load(const WORD *p) {
+		return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+	}
+	static inline void diff(const WORD *src, const WORD *bkg, __m128d &lo, __m128d &hi) {
+		const __m128i d = _mm_sub_epi32(load(src), load(bkg));
+		lo = _mm_cvtepi32_pd(d);
+		hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+	static inline void store(WORD *p, __m128d lo, __m128d hi) {
+		__m128i v = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+		// keep the low 16 bits, as a cast to WORD does
+		v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(v, v));
+	}
+};
+
+struct SkewVectorFloat {
+	static inline void diff(const float *src, const float *bkg, __m128d &lo, __m128d &hi) {
+		// the difference is a float operation
+		const __m128 d = _mm_sub_ps(_mm_loadu_ps(src), _mm_loadu_ps(bkg));
+		lo = _mm_cvtps_pd(d);
+		hi = _mm_cvtps_pd(_mm_movehl_ps(d, d));
+	}
+	static inline void store(float *p, __m128d lo, __m128d hi) {
+		_mm_storeu_ps(p, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+	}
+};
+
+/**
+SSE2 version of SkewWeightsT, 4 samples at a time in double precision. 
+Samples are processed by groups of 12, a multiple of 1, 3 and 4 samples per pixel, 
+so that the background pattern is the same for all groups.
+@return Returns the number of samples processed
+*/
+template <class V, class T> static unsigned 
+SkewWeightsSSE2(const T *src, T *left, unsigned count, unsigned samples, const T *bkg, double weight) {
+	T bkg_samples[12];
+	double bkg_values[12];
+	for(unsigned k = 0; k < 12; k++) {
+		bkg_samples[k] = bkg[k % samples];
+		bkg_values[k] = bkg_samples[k];
+	}
+
+	const __m128d w = _mm_set1_pd(weight);
+	const __m128d half = _mm_set1_pd(0.5);
+
+	unsigned k = 0;
+	for(; k + 12 <= count; k += 12) {
+		for(unsigned g = 0; g < 12; g += 4) {
+			__m128d lo, hi;
+			V::diff(src + k + g, bkg_samples + g, lo, hi);
+			lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(lo, w), _mm_loadu_pd(bkg_values + g)), half);
+			hi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(hi, w), _mm_loadu_pd(bkg_values + g + 2)), half);
+			V::store(left + k + g, lo, hi);
+		}
+	}
+	return k;
+}
+
+static inline unsigned
+SkewWeightsVector(const BYTE *src, BYTE *left, unsigned count, unsigned samples, const BYTE *bkg, double weight) {
+	return SkewWeightsSSE2<SkewVectorBYTE>(src, left, count, samples, bkg, weight);
+}
+
+static inline unsigned
+SkewWeightsVector(const WORD *src, WORD *left, unsigned count, unsigned samples, const WORD *bkg, double weight) {
+	return SkewWeightsSSE2<SkewVectorWORD>(src, left, count, samples, bkg, weight);
+}
+
+static inline unsigned
+SkewWeightsVector(const float *src, float *left, unsigned count, unsigned samples, const float *bkg, double weight) {
+	return SkewWeightsSSE2<SkewVectorFloat>(src, left, count, samples, bkg, weight);
+}
+
+#else
+
+template <class T> static inline unsigned
+SkewWeightsVector(const T *src, T *left, unsigned count, unsigned samples, const T *bkg, double weight) {
+	return 0;
+}
+
+#endif // FREEIMAGE_SSE2
 
 /**
 Skews a row horizontally (with filtered weights). 
@@ -50,16 +407,15 @@ Parameter T can be BYTE, WORD of float.
 @param iOffset Skew offset
 @param dWeight Relative weight of right pixel
 @param bkcolor Background color
+@param buffer Work buffer of (width + 1) pixels of src
 */
-template <class T> void 
-HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weight, const void *bkcolor = NULL) {
+template <class T> static void 
+HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weight, const void *bkcolor, T *buffer) {
 	int iXPos;
 
 	const unsigned src_width  = FreeImage_GetWidth(src);
 	const unsigned dst_width  = FreeImage_GetWidth(dst);
 
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-	
 	// background
 	const T pxlBlack[4] = {0, 0, 0, 0 };
 	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
@@ -73,7 +429,7 @@ HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weigh
 	// calculate the number of samples per pixel
 	const unsigned samples = bytespp / sizeof(T);
 
-	BYTE *src_bits = FreeImage_GetScanLine(src, row);
+	const T *src_bits = reinterpret_cast<const T*>(FreeImage_GetScanLine(src, row));
 	BYTE *dst_bits = FreeImage_GetScanLine(dst, row);
 
 	// fill gap left of skew with background
@@ -81,36 +437,29 @@ HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weigh
 		for(int k = 0; k < iOffset; k++) {
 			memcpy(&dst_bits[k * bytespp], bkcolor, bytespp);
 		}
-		AssignPixel((BYTE*)&pxlOldLeft[0], (BYTE*)bkcolor, bytespp);
 	} else {
 		if(iOffset > 0) {
 			memset(dst_bits, 0, iOffset * bytespp);
 		}		
-		memset(&pxlOldLeft[0], 0, bytespp);
 	}
 
-	for(unsigned i = 0; i < src_width; i++) {
-		// loop through row pixels
-		AssignPixel((BYTE*)&pxlSrc[0], (BYTE*)src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
-		}
-		// check boundaries 
-		iXPos = i + iOffset;
-		if((iXPos >= 0) && (iXPos < (int)dst_width)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			AssignPixel((BYTE*)&dst_bits[iXPos*bytespp], (BYTE*)&pxlSrc[0], bytespp);
+	// buffer holds the left over of the background, followed by the left over of each pixel in scan
+	for(unsigned j = 0; j < samples; j++) {
+		buffer[j] = pxlBkg[j];
+	}
+	const unsigned count = src_width * samples;
+	const unsigned done = SkewWeightsVector(src_bits, buffer + samples, count, samples, pxlBkg, weight);
+	SkewWeightsT(src_bits, buffer + samples, done, count, samples, pxlBkg, weight);
+
+	// pixels that fall within dst : update left over on source
+	const int first = MAX(0, -iOffset);
+	const int last  = MIN((int)src_width, (int)dst_width - iOffset);
+	if(first < last) {
+		T *dst_samples = reinterpret_cast<T*>(dst_bits + (first + iOffset) * bytespp);
+		for(unsigned k = first * samples; k < last * samples; k++) {
+			*dst_samples++ = static_cast<T>(src_bits[k] - (buffer[k + samples] - buffer[k]));
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)&pxlOldLeft[0], (BYTE*)&pxlLeft[0], bytespp);
-
-		// next pixel in scan
-		src_bits += bytespp;
-	}			
+	}
 
 	// go to rightmost point of skew
 	iXPos = src_width + iOffset; 
@@ -119,7 +468,7 @@ HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weigh
 		dst_bits = FreeImage_GetScanLine(dst, row) + iXPos * bytespp;
 
 		// If still in image bounds, put leftovers there
-		AssignPixel((BYTE*)dst_bits, (BYTE*)&pxlOldLeft[0], bytespp);
+		AssignPixel((BYTE*)dst_bits, (BYTE*)&buffer[count], bytespp);
 
 		// clear to the right of the skewed line with background
 		dst_bits += bytespp;
@@ -143,9 +492,10 @@ Limited to 45 degree skewing only. Filters two adjacent pixels.
 @param iOffset Skew offset
 @param dWeight Relative weight of right pixel
 @param bkcolor Background color
+@param buffer Work buffer of (width + 1) pixels of src
 */
 static void 
-HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeight, const void *bkcolor) {
+HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeight, const void *bkcolor, void *buffer) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	switch(image_type) {
@@ -154,161 +504,156 @@ HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeigh
 				case 8:
 				case 24:
 				case 32:
-					HorizontalSkewT<BYTE>(src, dst, row, iOffset, dWeight, bkcolor);
+					HorizontalSkewT<BYTE>(src, dst, row, iOffset, dWeight, bkcolor, (BYTE*)buffer);
 				break;
 			}
 			break;
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
-			HorizontalSkewT<WORD>(src, dst, row, iOffset, dWeight, bkcolor);
+			HorizontalSkewT<WORD>(src, dst, row, iOffset, dWeight, bkcolor, (WORD*)buffer);
 			break;
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-			HorizontalSkewT<float>(src, dst, row, iOffset, dWeight, bkcolor);
+			HorizontalSkewT<float>(src, dst, row, iOffset, dWeight, bkcolor, (float*)buffer);
 			break;
 	}
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-Parameter T can be BYTE, WORD of float. 
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+Skews all the rows of an image horizontally, rows are processed concurrently.
+@param src Pointer to source image
+@param dst Pointer to destination image, with the same height as src
+@param offsets Skew offset of each row
 @param bkcolor Background color
+@return Returns TRUE if successful, FALSE otherwise
 */
-template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iYPos;
-
-	unsigned src_height = FreeImage_GetHeight(src);
-	unsigned dst_height = FreeImage_GetHeight(dst);
+static BOOL 
+HorizontalSkewRows(FIBITMAP *src, FIBITMAP *dst, const std::vector<double> &offsets, const void *bkcolor) {
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	if(FreeImage_GetBPP(src) < 8) {
+		// sub-byte pixels cannot be skewed
+		return FALSE;
+	}
 
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
+	const unsigned threads = FreeImage_GetThreadCount((size_t)FreeImage_GetWidth(dst) * height, ROTATE_MIN_THREAD_PIXELS);
 
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if(!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
+	// one work buffer per band
+	std::vector<std::vector<double> > buffers;
+	try {
+		buffers.resize(threads, std::vector<double>(((width + 1) * bytespp + sizeof(double) - 1) / sizeof(double)));
+	} catch(std::bad_alloc &) {
+		return FALSE;
 	}
 
-	// calculate the number of bytes per pixel
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-	// calculate the number of samples per pixel
-	const unsigned samples = bytespp / sizeof(T);
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned band) {
+		for(unsigned u = row_begin; u < row_end; u++) {
+			const int iShear = int(floor(offsets[u]));
+			HorizontalSkew(src, dst, u, iShear, offsets[u] - double(iShear), bkcolor, &buffers[band][0]);
+		}
+	});
 
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
-	const unsigned index = col * bytespp;
+	return TRUE;
+}
 
-	BYTE *src_bits = FreeImage_GetBits(src) + index;
-	BYTE *dst_bits = FreeImage_GetBits(dst) + index;
+/**
+Skews all the columns of an image vertically. 
+The image is transposed, so that its columns are skewed as rows by HorizontalSkewRows, 
+with the same results and a cache friendly access, then transposed back.
+@param src Pointer to source image
+@param dst_height Height of the destination image
+@param offsets Skew offset of each column
+@param bkcolor Background color
+@return Returns a pointer to a newly allocated skewed image if successful, returns NULL otherwise
+*/
+static FIBITMAP* 
+VerticalSkewColumns(FIBITMAP *src, unsigned dst_height, const std::vector<double> &offsets, const void *bkcolor) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
 
-	// fill gap above skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for(int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memset(&pxlOldLeft[0], 0, bytespp);
+	FIBITMAP *columns = FreeImage_AllocateT(image_type, height, width, bpp);
+	if(NULL == columns) {
+		return NULL;
 	}
-
-	for(unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
-		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (BYTE*)(&pxlSrc[0]), bytespp);
-		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)(&pxlOldLeft[0]), (BYTE*)(&pxlLeft[0]), bytespp);
-
-		// next pixel in scan
-		src_bits += src_pitch;
+	if(!Transpose(FreeImage_GetBits(src), FreeImage_GetPitch(src), FreeImage_GetBits(columns), FreeImage_GetPitch(columns), width, height, bytespp)) {
+		FreeImage_Unload(columns);
+		return NULL;
 	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
-
-	if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
 
-		// if still in image bounds, put leftovers there				
-		AssignPixel((BYTE*)(dst_bits), (BYTE*)(&pxlOldLeft[0]), bytespp);
+	FIBITMAP *skewed = FreeImage_AllocateT(image_type, dst_height, width, bpp);
+	if((NULL == skewed) || !HorizontalSkewRows(columns, skewed, offsets, bkcolor)) {
+		FreeImage_Unload(skewed);
+		FreeImage_Unload(columns);
+		return NULL;
+	}
+	FreeImage_Unload(columns);
 
-		// clear below skewed line with background
-		if(bkcolor) {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((BYTE*)(dst_bits), (BYTE*)(bkcolor), bytespp);
-			}
-		} else {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
-			}
-		}
+	FIBITMAP *dst = FreeImage_AllocateT(image_type, width, dst_height, bpp);
+	if(NULL == dst) {
+		FreeImage_Unload(skewed);
+		return NULL;
 	}
+	const BOOL bTransposed = Transpose(FreeImage_GetBits(skewed), FreeImage_GetPitch(skewed), FreeImage_GetBits(dst), FreeImage_GetPitch(dst), dst_height, width, bytespp);
+	FreeImage_Unload(skewed);
+	if(!bTransposed) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
-@param bkcolor Background color
+Rotates a 4-bit image by a multiple of 90 degrees (counter clockwise), pixel per pixel. 
+The rows of dst are processed concurrently.
+@param src Pointer to source image
+@param dst Pointer to destination image, with the rotated dimensions of src
+@param quarters Number of quarter turns (1, 2 or 3)
 */
-static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
-
-	switch(image_type) {
-		case FIT_BITMAP:
-			switch(FreeImage_GetBPP(src)) {
-				case 8:
-				case 24:
-				case 32:
-					VerticalSkewT<BYTE>(src, dst, col, iOffset, dWeight, bkcolor);
-					break;
+static void
+RotateNibbles(FIBITMAP *src, FIBITMAP *dst, unsigned quarters) {
+	const unsigned dst_width  = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)dst_width * dst_height, ROTATE_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, dst_height, threads, [=](unsigned y_begin, unsigned y_end, unsigned) {
+		for(unsigned y = y_begin; y < y_end; y++) {
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+			for(unsigned x = 0; x < dst_width; x++) {
+				// get the (x_src, y_src) source pixel of (x, y)
+				unsigned x_src, y_src;
+				switch(quarters) {
+					case 1:
+						x_src = dst_height - 1 - y;
+						y_src = x;
+						break;
+					case 2:
+						x_src = dst_width - 1 - x;
+						y_src = dst_height - 1 - y;
+						break;
+					default:
+						x_src = y;
+						y_src = dst_width - 1 - x;
+						break;
+				}
+				const BYTE *src_bits = FreeImage_GetScanLine(src, y_src);
+				const BYTE nibble = (x_src & 0x01) ? (src_bits[x_src >> 1] & 0x0F) : (src_bits[x_src >> 1] >> 4);
+				if(x & 0x01) {
+					dst_bits[x >> 1] = (BYTE)((dst_bits[x >> 1] & 0xF0) | nibble);
+				} else {
+					dst_bits[x >> 1] = (BYTE)((dst_bits[x >> 1] & 0x0F) | (nibble << 4));
+				}
 			}
-			break;
-			case FIT_UINT16:
-			case FIT_RGB16:
-			case FIT_RGBA16:
-				VerticalSkewT<WORD>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
-			case FIT_FLOAT:
-			case FIT_RGBF:
-			case FIT_RGBAF:
-				VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
-	}
-} 
+		}
+	});
+}
 
 /**
 Rotates an image by 90 degrees (counter clockwise). 
@@ -366,45 +711,13 @@ Rotate90(FIBITMAP *src) {
 						}
 					}
 				}
+				break;
 			}
-			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+			if(bpp == 4) {
+				RotateNibbles(src, dst, 1);
+				break;
 			}
-			break;
+			// else if bpp >= 8, FALL THROUGH
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
@@ -412,20 +725,15 @@ Rotate90(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
+			// dst.SetPixel(x, y, src.GetPixel(dst_height - 1 - y, x)) : 
+			// transpose src into dst, walking the rows of dst from top to bottom
+			if(!Transpose(FreeImage_GetBits(src), src_pitch, 
+				FreeImage_GetScanLine(dst, dst_height - 1), -(ptrdiff_t)dst_pitch, src_width, src_height, bytespp)) {
+				FreeImage_Unload(dst);
+				return NULL;
 			}
 		}
 		break;
@@ -442,7 +750,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -472,7 +780,11 @@ Rotate180(FIBITMAP *src) {
 				}
 				break;
 			}
-			// else if((bpp == 8) || (bpp == 24) || (bpp == 32)) FALL TROUGH
+			if(bpp == 4) {
+				RotateNibbles(src, dst, 2);
+				break;
+			}
+			// else if bpp >= 8, FALL THROUGH
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
@@ -483,17 +795,14 @@ Rotate180(FIBITMAP *src) {
 			 // Calculate the number of bytes per pixel
 			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(y = 0; y < src_height; y++) {
-				BYTE *src_bits = FreeImage_GetScanLine(src, y);
-				BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for(x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;					
-				}				
-			}
+			const unsigned threads = FreeImage_GetThreadCount((size_t)src_width * src_height, ROTATE_MIN_THREAD_PIXELS);
+
+			FreeImage_ParallelFor(0, src_height, threads, [=](unsigned y_begin, unsigned y_end, unsigned) {
+				for(unsigned y = y_begin; y < y_end; y++) {
+					// set pixel at (dst_width - x - 1, dst_height - y - 1) to pixel at (x, y)
+					MirrorScanLine(FreeImage_GetScanLine(dst, dst_height - y - 1), FreeImage_GetScanLine(src, y), src_width, bytespp);
+				}
+			});
 		}
 		break;
 	}
@@ -510,7 +819,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -558,45 +867,13 @@ Rotate270(FIBITMAP *src) {
 						}
 					}
 				}
-			} 
-			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				break;
 			}
-			break;
+			if(bpp == 4) {
+				RotateNibbles(src, dst, 3);
+				break;
+			}
+			// else if bpp >= 8, FALL THROUGH
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
@@ -604,20 +881,15 @@ Rotate270(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
 			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
+			// dst.SetPixel(x, y, src.GetPixel(y, dst_width - 1 - x)) : 
+			// transpose src into dst, walking the rows of src from top to bottom
+			if(!Transpose(FreeImage_GetScanLine(src, src_height - 1), -(ptrdiff_t)src_pitch, 
+				FreeImage_GetBits(dst), dst_pitch, src_width, src_height, bytespp)) {
+				FreeImage_Unload(dst);
+				return NULL;
 			}
 		}
 		break;
@@ -654,6 +926,24 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	const unsigned width_1  = src_width + unsigned((double)src_height * fabs(dTan) + 0.5);
 	const unsigned height_1 = src_height; 
 
+	// Calc 2nd shear (vertical) destination image dimensions
+	const unsigned width_2  = width_1;
+	const unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
+
+	// Calc 3rd shear (horizontal) destination image dimensions
+	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
+	const unsigned height_3 = height_2;
+
+	// Skew offsets of the rows (or columns) of each shear
+	std::vector<double> offsets_1, offsets_2, offsets_3;
+	try {
+		offsets_1.resize(height_1);
+		offsets_2.resize(width_2);
+		offsets_3.resize(height_3);
+	} catch(std::bad_alloc &) {
+		return NULL;
+	}
+
 	// Perform 1st shear (horizontal)
 	// ----------------------------------------------------------------------
 
@@ -674,24 +964,16 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 			// Negative angle
 			dShear = (double(u) - height_1 + 0.5) * dTan;
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
+		offsets_1[u] = dShear;
 	}
-
-	// Perform 2nd shear  (vertical)
-	// ----------------------------------------------------------------------
-
-	// Calc 2nd shear (vertical) destination image dimensions
-	const unsigned width_2  = width_1;
-	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
-
-	// Allocate image for 2nd shear
-	FIBITMAP *dst2 = FreeImage_AllocateT(image_type, width_2, height_2, bpp);
-	if(NULL == dst2) {
+	if(!HorizontalSkewRows(src, dst1, offsets_1, bkcolor)) {
 		FreeImage_Unload(dst1);
 		return NULL;
 	}
 
+	// Perform 2nd shear  (vertical)
+	// ----------------------------------------------------------------------
+
 	double dOffset;     // Variable skew offset
 	if(dSinE > 0)	{   
 		// Positive angle
@@ -703,19 +985,21 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	}
 
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets_2[u] = dOffset;
 	}
 
-	// Perform 3rd shear (horizontal)
-	// ----------------------------------------------------------------------
+	// Allocate image for 2nd shear and skew the columns
+	FIBITMAP *dst2 = VerticalSkewColumns(dst1, height_2, offsets_2, bkcolor);
 
 	// Free result of 1st shear
 	FreeImage_Unload(dst1);
 
-	// Calc 3rd shear (horizontal) destination image dimensions
-	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
-	const unsigned height_3 = height_2;
+	if(NULL == dst2) {
+		return NULL;
+	}
+
+	// Perform 3rd shear (horizontal)
+	// ----------------------------------------------------------------------
 
 	// Allocate image for 3rd shear
 	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
@@ -733,19 +1017,25 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		offsets_3[u] = dOffset;
 	}
+	const BOOL bSkewed = HorizontalSkewRows(dst2, dst3, offsets_3, bkcolor);
+
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
 
+	if(!bSkewed) {
+		FreeImage_Unload(dst3);
+		return NULL;
+	}
+
 	// Return result of 3rd shear
 	return dst3;      
 }
 
 /**
-Rotates a 1-, 8-, 24- or 32-bit image by a given angle (given in degree). 
-Angle is unlimited, except for 1-bit images (limited to integer multiples of 90 degree). 
+Rotates a 1-, 4-, 8-, 24- or 32-bit image by a given angle (given in degree). 
+Angle is unlimited, except for 1- and 4-bit images (limited to integer multiples of 90 degree). 
 3-shears technique is used.
 @param src Pointer to source image to rotate
 @param dAngle Rotation angle
@@ -839,7 +1129,25 @@ FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor) {
 		
 		switch(image_type) {
 			case FIT_BITMAP:
-				if(bpp == 1) {
+				if(bpp == 4) {
+					// only rotate for integer multiples of 90 degree
+					if(fmod(angle, 90) != 0)
+						return NULL;
+
+					// perform the rotation
+					FIBITMAP *dst = RotateAny(dib, angle, bkcolor);
+					if(!dst) throw(1);
+
+					// copy original palette and transparency table to rotated bitmap
+					memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(dib), 16 * sizeof(RGBQUAD));
+					FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+
+					// copy metadata from src to dst
+					FreeImage_CloneMetadata(dst, dib);
+
+					return dst;
+				}
+				else if(bpp == 1) {
 					// only rotate for integer multiples of 90 degree
 					if(fmod(angle, 90) != 0)
 						return NULL;
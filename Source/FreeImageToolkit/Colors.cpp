@@ -23,6 +23,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
+#include "ToneMapping.h"
 
 // ----------------------------------------------------------
 //   Macros + structures
@@ -37,9 +39,486 @@
 
 // ----------------------------------------------------------
 
+// minimum number of pixels worth a thread in the point operations
+#define ADJUST_MIN_THREAD_PIXELS	(256 * 256)
+
+// channels processed by an adjustment step
+#define ADJUST_RED		0x01
+#define ADJUST_GREEN	0x02
+#define ADJUST_BLUE		0x04
+#define ADJUST_ALPHA	0x08
+
+// contrast pivot, on the [0..1] range of float images
+#define ADJUST_FLOAT_CENTER	(128.0 / 255.0)
+
+/**
+Adjustment step, as processed by the point operation engine
+*/
+struct AdjustStep {
+	FREE_IMAGE_ADJUST type;	//! adjustment performed by this step
+	double factor;			//! brightness or contrast scale, or gamma exponent
+	const BYTE *lut8;		//! 256 entry curve
+	const WORD *lut16;		//! 65536 entry curve (used instead of lut8 when not NULL)
+	unsigned channels;		//! ADJUST_xxx bits of the processed channels
+};
+
+// ----------------------------------------------------------
+//   Point operation engine
+// ----------------------------------------------------------
+
+/**
+Get the ADJUST_xxx bits of a color channel
+*/
+static unsigned
+GetAdjustChannels(FREE_IMAGE_COLOR_CHANNEL channel) {
+	switch(channel) {
+		case FICC_RGB:
+			return ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE;
+		case FICC_RED:
+			return ADJUST_RED;
+		case FICC_GREEN:
+			return ADJUST_GREEN;
+		case FICC_BLUE:
+			return ADJUST_BLUE;
+		case FICC_ALPHA:
+			return ADJUST_ALPHA;
+		default:
+			return 0;
+	}
+}
+
+/**
+Check whether a step processes a channel. 
+Channel 0 stands for the single channel of grey, palette, UINT16 and FLOAT images, 
+which is processed by every step whatever its channel (as FreeImage_AdjustCurve always did).
+*/
+static inline BOOL
+AppliesTo(const AdjustStep &step, unsigned channel) {
+	return (channel == 0) || ((step.channels & channel) != 0);
+}
+
+/**
+Evaluate a curve at a value of the range [0..scale], interpolating linearly between the table entries
+*/
+static inline double
+CurveValue(const AdjustStep &step, double value, double scale) {
+	const unsigned last = step.lut16 ? 65535 : 255;
+	double t = value * last / scale;
+	if(!(t > 0)) {
+		t = 0;
+	} else if(t > last) {
+		t = last;
+	}
+	const unsigned i = (unsigned)t;
+	const unsigned j = MIN(i + 1, last);
+	const double a = step.lut16 ? step.lut16[i] : step.lut8[i];
+	const double b = step.lut16 ? step.lut16[j] : step.lut8[j];
+	return (a + (t - i) * (b - a)) * scale / last;
+}
+
+/**
+Build the lookup table of a channel of an integer image. 
+The steps are evaluated in double precision, clamped to the range [0..size] after each step 
+and rounded once at the end.
+@param lut Output table of size + 1 entries
+@param work Work buffer of size + 1 entries
+@param size Largest sample value (255 or 65535)
+@param steps Steps to apply
+@param count Number of steps
+@param channel ADJUST_xxx bit of the channel, 0 for single channel images
+*/
+template <class T> static void
+BuildLUT(T *lut, double *work, unsigned size, const AdjustStep *steps, unsigned count, unsigned channel) {
+	const double scale = size;
+	unsigned i;
+
+	for(i = 0; i <= size; i++) {
+		work[i] = i;
+	}
+
+	for(unsigned s = 0; s < count; s++) {
+		const AdjustStep &step = steps[s];
+		if(!AppliesTo(step, channel)) {
+			continue;
+		}
+		switch(step.type) {
+			case FIADJ_BRIGHTNESS:
+				for(i = 0; i <= size; i++) {
+					work[i] = work[i] * step.factor;
+				}
+				break;
+			case FIADJ_CONTRAST:
+			{
+				const double center = scale * 128 / 255;
+				for(i = 0; i <= size; i++) {
+					work[i] = center + (work[i] - center) * step.factor;
+				}
+				break;
+			}
+			case FIADJ_GAMMA:
+			{
+				const double v = scale * pow(scale, -step.factor);
+				for(i = 0; i <= size; i++) {
+					work[i] = pow(work[i], step.factor) * v;
+				}
+				break;
+			}
+			case FIADJ_INVERT:
+				for(i = 0; i <= size; i++) {
+					work[i] = scale - work[i];
+				}
+				break;
+			case FIADJ_CURVE:
+				for(i = 0; i <= size; i++) {
+					work[i] = CurveValue(step, work[i], scale);
+				}
+				break;
+		}
+		for(i = 0; i <= size; i++) {
+			work[i] = MAX(0.0, MIN(work[i], scale));
+		}
+	}
+
+	for(i = 0; i <= size; i++) {
+		lut[i] = (T)floor(work[i] + 0.5);
+	}
+}
+
+/**
+Apply per sample lookup tables to every pixel of an integer image, in parallel row bands
+@param dib Image to process
+@param lut Table of each sample of a pixel
+@param samples Number of samples per pixel
+*/
+template <class T> static void
+ApplyLUT(FIBITMAP *dib, const T *const *lut, unsigned samples) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	BOOL uniform = TRUE;
+	for(unsigned k = 1; k < samples; k++) {
+		uniform = uniform && (lut[k] == lut[0]);
+	}
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, ADJUST_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		for(unsigned y = row_begin; y < row_end; y++) {
+			T *bits = (T*)FreeImage_GetScanLine(dib, y);
+
+			if(uniform) {
+				// same table for all the samples, process the line as a flat array
+				const T *table = lut[0];
+				const unsigned n = width * samples;
+				unsigned x = 0;
+				for(; x + 4 <= n; x += 4) {
+					const T a = table[bits[x]];
+					const T b = table[bits[x + 1]];
+					const T c = table[bits[x + 2]];
+					const T d = table[bits[x + 3]];
+					bits[x] = a;
+					bits[x + 1] = b;
+					bits[x + 2] = c;
+					bits[x + 3] = d;
+				}
+				for(; x < n; x++) {
+					bits[x] = table[bits[x]];
+				}
+			} else {
+				for(unsigned x = 0; x < width; x++) {
+					for(unsigned k = 0; k < samples; k++) {
+						bits[k] = lut[k][bits[k]];
+					}
+					bits += samples;
+				}
+			}
+		}
+	});
+}
+
+/**
+Process an integer image through one lookup table per channel
+@param dib Image to process
+@param steps Steps to apply
+@param count Number of steps
+@param samples Number of samples per pixel
+@param channels ADJUST_xxx bit of each sample
+@param size Largest sample value (255 or 65535)
+*/
+template <class T> static void
+AdjustInteger(FIBITMAP *dib, const AdjustStep *steps, unsigned count, unsigned samples, const unsigned *channels, unsigned size) {
+	std::vector<T> tables((size + 1) * samples);
+	std::vector<double> work(size + 1);
+	const T *lut[4] = { NULL, NULL, NULL, NULL };
+
+	for(unsigned k = 0; k < samples; k++) {
+		// share the table of a sample processed by the same steps
+		for(unsigned j = 0; (j < k) && !lut[k]; j++) {
+			BOOL same = TRUE;
+			for(unsigned s = 0; (s < count) && same; s++) {
+				same = (AppliesTo(steps[s], channels[j]) == AppliesTo(steps[s], channels[k]));
+			}
+			if(same) {
+				lut[k] = lut[j];
+			}
+		}
+		if(!lut[k]) {
+			T *table = &tables[(size + 1) * k];
+			BuildLUT(table, &work[0], size, steps, count, channels[k]);
+			lut[k] = table;
+		}
+	}
+
+	if((FreeImage_GetImageType(dib) == FIT_BITMAP) && (FreeImage_GetColorType(dib) == FIC_PALETTE)) {
+		// apply the table to the palette
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(unsigned i = 0; i < FreeImage_GetColorsUsed(dib); i++) {
+			pal[i].rgbRed   = (BYTE)lut[0][pal[i].rgbRed];
+			pal[i].rgbGreen = (BYTE)lut[0][pal[i].rgbGreen];
+			pal[i].rgbBlue  = (BYTE)lut[0][pal[i].rgbBlue];
+		}
+	} else {
+		ApplyLUT(dib, lut, samples);
+	}
+}
+
+/**
+Apply a step to a float sample, on the [0..1] range. 
+Float samples are not clamped, gamma gives 0 for values <= 0.
+*/
+static inline float
+AdjustFloat(const AdjustStep &step, float value) {
+	switch(step.type) {
+		case FIADJ_BRIGHTNESS:
+			return value * (float)step.factor;
+		case FIADJ_CONTRAST:
+			return (float)ADJUST_FLOAT_CENTER + (value - (float)ADJUST_FLOAT_CENTER) * (float)step.factor;
+		case FIADJ_GAMMA:
+			return (value > 0) ? (float)pow((double)value, step.factor) : 0;
+		case FIADJ_INVERT:
+			return 1 - value;
+		case FIADJ_CURVE:
+			return (float)CurveValue(step, value, 1.0);
+	}
+	return value;
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Apply a step to 4 float samples, see AdjustFloat. 
+Gamma uses the polynomial pow of the tone mapping operators.
+*/
+static inline __m128
+AdjustFloat4(const AdjustStep &step, __m128 value) {
+	switch(step.type) {
+		case FIADJ_BRIGHTNESS:
+			return _mm_mul_ps(value, _mm_set1_ps((float)step.factor));
+		case FIADJ_CONTRAST:
+		{
+			const __m128 center = _mm_set1_ps((float)ADJUST_FLOAT_CENTER);
+			return _mm_add_ps(center, _mm_mul_ps(_mm_sub_ps(value, center), _mm_set1_ps((float)step.factor)));
+		}
+		case FIADJ_GAMMA:
+			return tmo_pow_ps(value, _mm_set1_ps((float)step.factor));
+		case FIADJ_INVERT:
+			return _mm_sub_ps(_mm_set1_ps(1.0F), value);
+		case FIADJ_CURVE:
+		{
+			float v[4];
+			_mm_storeu_ps(v, value);
+			for(int k = 0; k < 4; k++) {
+				v[k] = (float)CurveValue(step, v[k], 1.0);
+			}
+			return _mm_loadu_ps(v);
+		}
+	}
+	return value;
+}
+
+#endif // FREEIMAGE_SSE2
+
+/**
+Process a float image, applying all the steps to each sample in a single pass
+@param dib Image to process
+@param steps Steps to apply
+@param count Number of steps
+@param samples Number of samples per pixel
+@param channels ADJUST_xxx bit of each sample
+*/
+static void
+AdjustFloatImage(FIBITMAP *dib, const AdjustStep *steps, unsigned count, unsigned samples, const unsigned *channels) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned n = width * samples;
+
+#ifdef FREEIMAGE_SSE2
+	// lanes processed by each step over 12 samples (3 vectors), a whole number of 1, 3 or 4 sample pixels
+	std::vector<int> masks(12 * count);
+	for(unsigned s = 0; s < count; s++) {
+		for(unsigned k = 0; k < 12; k++) {
+			masks[12 * s + k] = AppliesTo(steps[s], channels[k % samples]) ? -1 : 0;
+		}
+	}
+#endif
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, ADJUST_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		for(unsigned y = row_begin; y < row_end; y++) {
+			float *bits = (float*)FreeImage_GetScanLine(dib, y);
+			unsigned x = 0;
+
+#ifdef FREEIMAGE_SSE2
+			for(; x + 12 <= n; x += 12) {
+				for(unsigned v = 0; v < 3; v++) {
+					__m128 value = _mm_loadu_ps(bits + x + 4 * v);
+					for(unsigned s = 0; s < count; s++) {
+						const __m128 mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&masks[12 * s + 4 * v]));
+						const __m128 result = AdjustFloat4(steps[s], value);
+						value = _mm_or_ps(_mm_and_ps(mask, result), _mm_andnot_ps(mask, value));
+					}
+					_mm_storeu_ps(bits + x + 4 * v, value);
+				}
+			}
+#endif // FREEIMAGE_SSE2
+
+			for(; x < n; x++) {
+				const unsigned channel = channels[x % samples];
+				float value = bits[x];
+				for(unsigned s = 0; s < count; s++) {
+					if(AppliesTo(steps[s], channel)) {
+						value = AdjustFloat(steps[s], value);
+					}
+				}
+				bits[x] = value;
+			}
+		}
+	});
+}
+
+/**
+Apply a sequence of adjustment steps to an image, with a single pass over the pixels. 
+8-bit and 16-bit images go through one lookup table per channel, float images 
+are processed directly.
+@param dib Image to process
+@param steps Steps to apply
+@param count Number of steps
+@return Returns TRUE if successful, FALSE if the image type is not supported
+*/
+static BOOL
+AdjustImage(FIBITMAP *dib, const AdjustStep *steps, unsigned count) {
+	if(!FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	// ADJUST_xxx bit of each sample of a pixel, 0 for single channel images
+	unsigned channels[4] = { 0, 0, 0, 0 };
+	unsigned samples = 1;
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			if((bpp == 24) || (bpp == 32)) {
+				samples = bpp / 8;
+				channels[FI_RGBA_RED] = ADJUST_RED;
+				channels[FI_RGBA_GREEN] = ADJUST_GREEN;
+				channels[FI_RGBA_BLUE] = ADJUST_BLUE;
+				if(bpp == 32) {
+					channels[FI_RGBA_ALPHA] = ADJUST_ALPHA;
+				}
+			} else if(bpp != 8) {
+				return FALSE;
+			}
+			break;
+		case FIT_UINT16:
+		case FIT_FLOAT:
+			break;
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			samples = ((image_type == FIT_RGBA16) || (image_type == FIT_RGBAF)) ? 4 : 3;
+			channels[0] = ADJUST_RED;
+			channels[1] = ADJUST_GREEN;
+			channels[2] = ADJUST_BLUE;
+			channels[3] = ADJUST_ALPHA;
+			break;
+		default:
+			return FALSE;
+	}
+
+	try {
+		// drop the steps which process none of the channels of the image
+		std::vector<AdjustStep> active;
+		for(unsigned s = 0; s < count; s++) {
+			for(unsigned k = 0; k < samples; k++) {
+				if(AppliesTo(steps[s], channels[k])) {
+					active.push_back(steps[s]);
+					break;
+				}
+			}
+		}
+		if(active.empty()) {
+			return TRUE;
+		}
+
+		switch(image_type) {
+			case FIT_BITMAP:
+				AdjustInteger<BYTE>(dib, &active[0], (unsigned)active.size(), samples, channels, 255);
+				break;
+			case FIT_UINT16:
+			case FIT_RGB16:
+			case FIT_RGBA16:
+				AdjustInteger<WORD>(dib, &active[0], (unsigned)active.size(), samples, channels, 65535);
+				break;
+			default:
+				AdjustFloatImage(dib, &active[0], (unsigned)active.size(), samples, channels);
+				break;
+		}
+	} catch(std::bad_alloc &) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, FI_MSG_ERROR_MEMORY);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+Invert all the bytes of each scanline, in parallel row bands
+*/
+static void
+InvertLines(FIBITMAP *dib) {
+	const unsigned line = FreeImage_GetLine(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)line * height, 4 * ADJUST_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		for(unsigned y = row_begin; y < row_end; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dib, y);
+			unsigned x = 0;
+#ifdef FREEIMAGE_SSE2
+			const __m128i ones = _mm_set1_epi32(-1);
+			for(; x + 16 <= line; x += 16) {
+				_mm_storeu_si128((__m128i*)(bits + x), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(bits + x)), ones));
+			}
+#endif // FREEIMAGE_SSE2
+			for(; x < line; x++) {
+				bits[x] = ~bits[x];
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------
+
 
 /** @brief Inverts each pixel data.
 
+Float images are inverted on the range [0..1] (value = 1 - value).
 @param src Input image to be processed.
 @return Returns TRUE if successful, FALSE otherwise.
 */
@@ -48,10 +527,6 @@ FreeImage_Invert(FIBITMAP *src) {
 
 	if (!FreeImage_HasPixels(src)) return FALSE;
 	
-	unsigned i, x, y, k;
-	
-	const unsigned width = FreeImage_GetWidth(src);
-	const unsigned height = FreeImage_GetHeight(src);
 	const unsigned bpp = FreeImage_GetBPP(src);
 
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
@@ -68,19 +543,13 @@ FreeImage_Invert(FIBITMAP *src) {
 				if (FreeImage_GetColorType(src) == FIC_PALETTE) {
 					RGBQUAD *pal = FreeImage_GetPalette(src);
 
-					for(i = 0; i < FreeImage_GetColorsUsed(src); i++) {
+					for(unsigned i = 0; i < FreeImage_GetColorsUsed(src); i++) {
 						pal[i].rgbRed	= 255 - pal[i].rgbRed;
 						pal[i].rgbGreen = 255 - pal[i].rgbGreen;
 						pal[i].rgbBlue	= 255 - pal[i].rgbBlue;
 					}
 				} else {
-					for(y = 0; y < height; y++) {
-						BYTE *bits = FreeImage_GetScanLine(src, y);
-
-						for (x = 0; x < FreeImage_GetLine(src); x++) {
-							bits[x] = ~bits[x];
-						}
-					}
+					InvertLines(src);
 				}
 
 				break;
@@ -88,39 +557,20 @@ FreeImage_Invert(FIBITMAP *src) {
 
 			case 24 :
 			case 32 :
-			{
-				// Calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / width;
-
-				for(y = 0; y < height; y++) {
-					BYTE *bits = FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						for(k = 0; k < bytespp; k++) {
-							bits[k] = ~bits[k];
-						}
-						bits += bytespp;
-					}
-				}
-
+				InvertLines(src);
 				break;
-			}
+
 			default:
 				return FALSE;
 		}
 	}
 	else if((image_type == FIT_UINT16) || (image_type == FIT_RGB16) || (image_type == FIT_RGBA16)) {
-		// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-		const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
-
-		for(y = 0; y < height; y++) {
-			WORD *bits = (WORD*)FreeImage_GetScanLine(src, y);
-			for(x = 0; x < width; x++) {
-				for(k = 0; k < wordspp; k++) {
-					bits[k] = ~bits[k];
-				}
-				bits += wordspp;
-			}
-		}
+		// inverting the bytes inverts the words
+		InvertLines(src);
+	}
+	else if((image_type == FIT_FLOAT) || (image_type == FIT_RGBF) || (image_type == FIT_RGBAF)) {
+		const AdjustStep step = { FIADJ_INVERT, 0, NULL, NULL, ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE | ADJUST_ALPHA };
+		return AdjustImage(src, &step, 1);
 	}
 	else {
 		// anything else ... 
@@ -137,130 +587,47 @@ The transformation is done as follows.<br>
 Image 8-bit : if the image has a color palette, the LUT is applied to this palette, 
 otherwise, it is applied to the grey values.<br>
 Image 24-bit & 32-bit : if channel == FICC_RGB, the same LUT is applied to each color
-plane (R,G, and B). Otherwise, the LUT is applied to the specified channel only.
+plane (R,G, and B). Otherwise, the LUT is applied to the specified channel only.<br>
+Image 16-bit (FIT_UINT16, FIT_RGB16, FIT_RGBA16) and float (FIT_FLOAT, FIT_RGBF, FIT_RGBAF) : 
+the LUT is scaled to the sample range ([0..65535] or [0..1]) and interpolated linearly.
 @param src Input image to be processed.
 @param LUT Lookup table. <b>The size of 'LUT' is assumed to be 256.</b>
-@param channel The color channel to be processed (only used with 24 & 32-bit DIB).
+@param channel The color channel to be processed (only used with RGB images).
 @return Returns TRUE if successful, FALSE otherwise.
 @see FREE_IMAGE_COLOR_CHANNEL
 */
 BOOL DLL_CALLCONV 
 FreeImage_AdjustCurve(FIBITMAP *src, BYTE *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
-	unsigned x, y;
-	BYTE *bits = NULL;
-
-	if(!FreeImage_HasPixels(src) || !LUT || (FreeImage_GetImageType(src) != FIT_BITMAP))
+	if(!LUT) {
 		return FALSE;
+	}
+	const AdjustStep step = { FIADJ_CURVE, 0, LUT, NULL, GetAdjustChannels(channel) };
+	return AdjustImage(src, &step, 1);
+}
 
-	int bpp = FreeImage_GetBPP(src);
-	if((bpp != 8) && (bpp != 24) && (bpp != 32))
-		return FALSE;
-
-	// apply the LUT
-	switch(bpp) {
-
-		case 8 :
-		{
-			// if the dib has a colormap, apply the LUT to it
-			// else, apply the LUT to pixel values
-
-			if(FreeImage_GetColorType(src) == FIC_PALETTE) {
-				RGBQUAD *rgb = FreeImage_GetPalette(src);
-				for (unsigned pal = 0; pal < FreeImage_GetColorsUsed(src); pal++) {
-					rgb->rgbRed   = LUT[rgb->rgbRed];
-					rgb->rgbGreen = LUT[rgb->rgbGreen];
-					rgb->rgbBlue  = LUT[rgb->rgbBlue];
-					rgb++;
-				}
-			}
-			else {
-				for(y = 0; y < FreeImage_GetHeight(src); y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < FreeImage_GetWidth(src); x++) {
-						bits[x] = LUT[ bits[x] ];
-					}
-				}
-			}
-
-			break;
-		}
-
-		case 24 :
-		case 32 :
-		{
-			int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			switch(channel) {
-				case FICC_RGB :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE]	= LUT[ bits[FI_RGBA_BLUE] ];	// B
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							bits[FI_RGBA_RED]	= LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_BLUE :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE] = LUT[ bits[FI_RGBA_BLUE] ];		// B
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_GREEN :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_RED :
-					for(y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for(x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_RED] = LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-					
-				case FICC_ALPHA :
-					if(32 == bpp) {
-						for(y = 0; y < FreeImage_GetHeight(src); y++) {
-							bits =  FreeImage_GetScanLine(src, y);
-							for(x = 0; x < FreeImage_GetWidth(src); x++) {
-								bits[FI_RGBA_ALPHA] = LUT[ bits[FI_RGBA_ALPHA] ];	// A
-								
-								bits += bytespp;
-							}
-						}
-					}
-					break;
+/** @brief Perfoms an histogram transformation on a 16-bit or float image 
+according to the values of a 16-bit lookup table (LUT).
 
-				default:
-					break;
-			}
-			break;
-		}
+Works as FreeImage_AdjustCurve, with a LUT of 65536 entries. 16-bit images 
+(FIT_UINT16, FIT_RGB16, FIT_RGBA16) are mapped directly, float images (FIT_FLOAT, 
+FIT_RGBF, FIT_RGBAF) use the LUT over the range [0..1] with linear interpolation, 
+and 8-bit images use every 257th entry.
+@param src Input image to be processed.
+@param LUT Lookup table. <b>The size of 'LUT' is assumed to be 65536.</b>
+@param channel The color channel to be processed (only used with RGB images).
+@return Returns TRUE if successful, FALSE otherwise.
+@see FreeImage_AdjustCurve
+*/
+BOOL DLL_CALLCONV 
+FreeImage_AdjustCurve16(FIBITMAP *src, WORD *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
+	if(!LUT) {
+		return FALSE;
 	}
-
-	return TRUE;
+	const AdjustStep step = { FIADJ_CURVE, 0, NULL, LUT, GetAdjustChannels(channel) };
+	return AdjustImage(src, &step, 1);
 }
 
-/** @brief Performs gamma correction on a 8, 24 or 32-bit image.
+/** @brief Performs gamma correction on a 8, 24 or 32-bit, 16-bit or float image.
 
 @param src Input image to be processed.
 @param gamma Gamma value to use. A value of 1.0 leaves the image alone, 
@@ -269,27 +636,14 @@ less than one darkens it, and greater than one lightens it.
 */
 BOOL DLL_CALLCONV 
 FreeImage_AdjustGamma(FIBITMAP *src, double gamma) {
-	BYTE LUT[256];		// Lookup table
-
-	if(!FreeImage_HasPixels(src) || (gamma <= 0))
+	if(gamma <= 0) {
 		return FALSE;
-	
-	// Build the lookup table
-
-	double exponent = 1 / gamma;
-	double v = 255.0 * (double)pow((double)255, -exponent);
-	for(int i = 0; i < 256; i++) {
-		double color = (double)pow((double)i, exponent) * v;
-		if(color > 255)
-			color = 255;
-		LUT[i] = (BYTE)floor(color + 0.5);
 	}
-
-	// Apply the gamma correction
-	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
+	const AdjustStep step = { FIADJ_GAMMA, 1 / gamma, NULL, NULL, ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE };
+	return AdjustImage(src, &step, 1);
 }
 
-/** @brief Adjusts the brightness of a 8, 24 or 32-bit image by a certain amount.
+/** @brief Adjusts the brightness of a 8, 24 or 32-bit, 16-bit or float image by a certain amount.
 
 @param src Input image to be processed.
 @param percentage Where -100 <= percentage <= 100<br>
@@ -299,23 +653,11 @@ and greater than 0 will make the image brighter.
 */
 BOOL DLL_CALLCONV 
 FreeImage_AdjustBrightness(FIBITMAP *src, double percentage) {
-	BYTE LUT[256];		// Lookup table
-	double value;
-
-	if(!FreeImage_HasPixels(src))
-		return FALSE;
-	
-	// Build the lookup table
-	const double scale = (100 + percentage) / 100;
-	for(int i = 0; i < 256; i++) {
-		value = i * scale;
-		value = MAX(0.0, MIN(value, 255.0));
-		LUT[i] = (BYTE)floor(value + 0.5);
-	}
-	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
+	const AdjustStep step = { FIADJ_BRIGHTNESS, (100 + percentage) / 100, NULL, NULL, ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE };
+	return AdjustImage(src, &step, 1);
 }
 
-/** @brief Adjusts the contrast of a 8, 24 or 32-bit image by a certain amount.
+/** @brief Adjusts the contrast of a 8, 24 or 32-bit, 16-bit or float image by a certain amount.
 
 @param src Input image to be processed.
 @param percentage Where -100 <= percentage <= 100<br>
@@ -325,20 +667,8 @@ and greater than 0 will increase the contrast of the image.
 */
 BOOL DLL_CALLCONV 
 FreeImage_AdjustContrast(FIBITMAP *src, double percentage) {
-	BYTE LUT[256];		// Lookup table
-	double value;
-
-	if(!FreeImage_HasPixels(src))
-		return FALSE;
-	
-	// Build the lookup table
-	const double scale = (100 + percentage) / 100;
-	for(int i = 0; i < 256; i++) {
-		value = 128 + (i - 128) * scale;
-		value = MAX(0.0, MIN(value, 255.0));
-		LUT[i] = (BYTE)floor(value + 0.5);
-	}
-	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
+	const AdjustStep step = { FIADJ_CONTRAST, (100 + percentage) / 100, NULL, NULL, ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE };
+	return AdjustImage(src, &step, 1);
 }
 
 /** @brief Computes image histogram
@@ -442,6 +772,292 @@ FreeImage_GetHistogram(FIBITMAP *src, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL cha
 	return FALSE;
 }
 
+// minimum number of pixels worth a thread in the statistics
+#define STATS_MIN_THREAD_PIXELS	(256 * 256)
+
+/**
+Statistics and histograms of an 8-bit or 16-bit image. 
+Every band counts each sample value in a full resolution histogram per sample, 
+then the statistics are derived from the merged counts.
+@param dib Image to process
+@param samples Number of samples per pixel
+@param offsets Sample offset of each channel
+@param channels Number of channels
+@param levels Number of sample values (256 or 65536)
+@param stats Output statistics, may be NULL
+@param histo Output histograms (channels x bins), may be NULL
+@param bins Number of bins of each output histogram, at most 'levels'
+*/
+template <class T> static void
+GetIntegerStatistics(FIBITMAP *dib, unsigned samples, const unsigned *offsets, unsigned channels, unsigned levels, FISTATISTICS *stats, DWORD *histo, unsigned bins) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, STATS_MIN_THREAD_PIXELS);
+
+	// partial counts of each band
+	std::vector<DWORD> counts((size_t)threads * samples * levels);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned band) {
+		DWORD *count = &counts[(size_t)band * samples * levels];
+		for(unsigned y = row_begin; y < row_end; y++) {
+			const T *bits = (const T*)FreeImage_GetScanLine(dib, y);
+			if(samples == 1) {
+				for(unsigned x = 0; x < width; x++) {
+					count[bits[x]]++;
+				}
+			} else {
+				for(unsigned x = 0; x < width; x++) {
+					for(unsigned k = 0; k < samples; k++) {
+						count[k * levels + bits[k]]++;
+					}
+					bits += samples;
+				}
+			}
+		}
+	});
+
+	// merge the bands, in band order
+	std::vector<DWORD> total(counts.begin(), counts.begin() + (size_t)samples * levels);
+	for(unsigned band = 1; band < threads; band++) {
+		const DWORD *count = &counts[(size_t)band * samples * levels];
+		for(size_t i = 0; i < total.size(); i++) {
+			total[i] += count[i];
+		}
+	}
+
+	// palette images: count the colours of the indices
+	if((FreeImage_GetImageType(dib) == FIT_BITMAP) && (FreeImage_GetColorType(dib) == FIC_PALETTE)) {
+		const RGBQUAD *pal = FreeImage_GetPalette(dib);
+		const unsigned used = FreeImage_GetColorsUsed(dib);
+		std::vector<DWORD> colors(3 * 256, 0);
+		for(unsigned i = 0; i < MIN(used, 256U); i++) {
+			colors[pal[i].rgbRed] += total[i];
+			colors[256 + pal[i].rgbGreen] += total[i];
+			colors[512 + pal[i].rgbBlue] += total[i];
+		}
+		total.swap(colors);
+	}
+
+	if(stats) {
+		stats->channels = channels;
+	}
+
+	for(unsigned c = 0; c < channels; c++) {
+		const DWORD *count = &total[offsets[c] * levels];
+
+		if(histo) {
+			DWORD *h = histo + c * bins;
+			memset(h, 0, bins * sizeof(DWORD));
+			for(unsigned v = 0; v < levels; v++) {
+				h[(unsigned)(((unsigned long long)v * bins) / levels)] += count[v];
+			}
+		}
+
+		if(stats) {
+			double n = 0, sum = 0;
+			unsigned min = levels, max = 0;
+			for(unsigned v = 0; v < levels; v++) {
+				if(count[v]) {
+					min = MIN(min, v);
+					max = v;
+					n += count[v];
+					sum += (double)v * count[v];
+				}
+			}
+			const double mean = sum / n;
+			double m2 = 0;
+			for(unsigned v = min; v <= max; v++) {
+				m2 += (v - mean) * (v - mean) * count[v];
+			}
+			stats->min[c] = min;
+			stats->max[c] = max;
+			stats->mean[c] = mean;
+			stats->stddev[c] = sqrt(m2 / n);
+		}
+	}
+}
+
+/**
+Statistics and histograms of a float image. 
+Every band accumulates the sums of each channel relative to the first pixel, 
+which keeps the variance accurate when the mean is large compared to the deviation.
+@param dib Image to process
+@param channels Number of channels (= samples per pixel)
+@param stats Output statistics, may be NULL
+@param histo Output histograms (channels x bins), may be NULL
+@param bins Number of bins of each output histogram
+@param range_min Sample value of the start of the first bin
+@param range_max Sample value of the end of the last bin
+*/
+static void
+GetFloatStatistics(FIBITMAP *dib, unsigned channels, FISTATISTICS *stats, DWORD *histo, unsigned bins, double range_min, double range_max) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	// FreeImage_ParallelFor never runs more bands than rows: every partial result must be filled
+	const unsigned threads = MIN(FreeImage_GetThreadCount((size_t)width * height, STATS_MIN_THREAD_PIXELS), height);
+
+	struct Partial {
+		double min[4], max[4], sum[4], sum2[4];
+	};
+	std::vector<Partial> partials(threads);
+	std::vector<DWORD> counts(histo ? (size_t)threads * channels * bins : 0);
+
+	const float *first = (const float*)FreeImage_GetScanLine(dib, 0);
+	const double scale = bins / (range_max - range_min);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned band) {
+		Partial &p = partials[band];
+		DWORD *count = histo ? &counts[(size_t)band * channels * bins] : NULL;
+		for(unsigned c = 0; c < channels; c++) {
+			p.min[c] = first[c];
+			p.max[c] = first[c];
+			p.sum[c] = 0;
+			p.sum2[c] = 0;
+		}
+		for(unsigned y = row_begin; y < row_end; y++) {
+			const float *bits = (const float*)FreeImage_GetScanLine(dib, y);
+			for(unsigned c = 0; c < channels; c++) {
+				const double shift = first[c];
+				double lo = p.min[c], hi = p.max[c], sum = 0, sum2 = 0;
+				for(unsigned x = 0; x < width; x++) {
+					const double value = bits[x * channels + c];
+					lo = (value < lo) ? value : lo;
+					hi = (value > hi) ? value : hi;
+					sum += value - shift;
+					sum2 += (value - shift) * (value - shift);
+				}
+				p.min[c] = lo;
+				p.max[c] = hi;
+				p.sum[c] += sum;
+				p.sum2[c] += sum2;
+
+				if(count) {
+					DWORD *h = count + c * bins;
+					for(unsigned x = 0; x < width; x++) {
+						// out of range values go to the first or last bin
+						const double t = (bits[x * channels + c] - range_min) * scale;
+						const unsigned bin = (t > 0) ? ((t < bins) ? (unsigned)t : bins - 1) : 0;
+						h[bin]++;
+					}
+				}
+			}
+		}
+	});
+
+	if(stats) {
+		const double n = (double)width * height;
+		stats->channels = channels;
+		for(unsigned c = 0; c < channels; c++) {
+			double lo = partials[0].min[c], hi = partials[0].max[c], sum = 0, sum2 = 0;
+			for(unsigned band = 0; band < threads; band++) {
+				lo = MIN(lo, partials[band].min[c]);
+				hi = MAX(hi, partials[band].max[c]);
+				sum += partials[band].sum[c];
+				sum2 += partials[band].sum2[c];
+			}
+			const double mean = sum / n;
+			stats->min[c] = lo;
+			stats->max[c] = hi;
+			stats->mean[c] = first[c] + mean;
+			stats->stddev[c] = sqrt(MAX(0.0, sum2 / n - mean * mean));
+		}
+	}
+
+	if(histo) {
+		memcpy(histo, &counts[0], channels * bins * sizeof(DWORD));
+		for(unsigned band = 1; band < threads; band++) {
+			const DWORD *count = &counts[(size_t)band * channels * bins];
+			for(unsigned i = 0; i < channels * bins; i++) {
+				histo[i] += count[i];
+			}
+		}
+	}
+}
+
+/** @brief Computes the statistics and the histograms of all the channels of an image, 
+in a single pass.
+
+Supported images are 8-bit (greyscale or palette), 24-bit and 32-bit bitmaps, 16-bit images 
+(FIT_UINT16, FIT_RGB16, FIT_RGBA16) and float images (FIT_FLOAT, FIT_RGBF, FIT_RGBAF). 
+Palette images are described by the red, green and blue channels of their colours. 
+The standard deviation is the population one (divided by the number of pixels).<br>
+The histogram of channel c is stored at histo[c * bins]. For 8-bit and 16-bit images, 
+the bins split the range of the sample values evenly ('bins' must not be greater than 
+256 for 8-bit and 65536 for 16-bit images). For float images, the bins split the range 
+[range_min, range_max) evenly and out of range values are counted in the first or last bin.
+@param dib Input image to be processed.
+@param stats Output statistics, may be NULL if only the histograms are needed.
+@param histo Output histograms, may be NULL. <b>The size of 'histo' is assumed to be 
+stats->channels x bins, that is at most 4 x bins.</b>
+@param bins Number of bins of each histogram.
+@param range_min Lower bound of the histogram range of float images.
+@param range_max Upper bound of the histogram range of float images.
+@return Returns TRUE if successful, FALSE otherwise.
+@see FISTATISTICS
+*/
+BOOL DLL_CALLCONV 
+FreeImage_GetStatistics(FIBITMAP *dib, FISTATISTICS *stats, DWORD *histo, unsigned bins, double range_min, double range_max) {
+	if(!FreeImage_HasPixels(dib) || (!stats && !histo) || (histo && (bins == 0))) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	// sample offset of the red, green, blue and alpha channels
+	const unsigned rgba[4] = { 0, 1, 2, 3 };
+
+	try {
+		switch(image_type) {
+			case FIT_BITMAP:
+				if(histo && (bins > 256)) {
+					return FALSE;
+				}
+				if(bpp == 8) {
+					const unsigned channels = (FreeImage_GetColorType(dib) == FIC_PALETTE) ? 3 : 1;
+					GetIntegerStatistics<BYTE>(dib, 1, rgba, channels, 256, stats, histo, bins);
+				} else if((bpp == 24) || (bpp == 32)) {
+					const unsigned offsets[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+					GetIntegerStatistics<BYTE>(dib, bpp / 8, offsets, bpp / 8, 256, stats, histo, bins);
+				} else {
+					return FALSE;
+				}
+				break;
+
+			case FIT_UINT16:
+			case FIT_RGB16:
+			case FIT_RGBA16:
+			{
+				if(histo && (bins > 65536)) {
+					return FALSE;
+				}
+				const unsigned samples = bpp / 16;
+				GetIntegerStatistics<WORD>(dib, samples, rgba, samples, 65536, stats, histo, bins);
+				break;
+			}
+
+			case FIT_FLOAT:
+			case FIT_RGBF:
+			case FIT_RGBAF:
+				if(histo && !(range_max > range_min)) {
+					return FALSE;
+				}
+				GetFloatStatistics(dib, bpp / 32, stats, histo, bins, range_min, range_max);
+				break;
+
+			default:
+				return FALSE;
+		}
+	} catch(std::bad_alloc &) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, FI_MSG_ERROR_MEMORY);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 // ----------------------------------------------------------
 
 
@@ -614,10 +1230,35 @@ BOOL DLL_CALLCONV
 FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double gamma, BOOL invert) {
 	BYTE LUT[256];
 
-	if (!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+	if (!FreeImage_HasPixels(dib)) {
 		return FALSE;
 	}
 
+	if (FreeImage_GetImageType(dib) != FIT_BITMAP) {
+		// 16-bit and float images: same adjustments in the same order, 
+		// evaluated at the precision of the image
+		const unsigned rgb = ADJUST_RED | ADJUST_GREEN | ADJUST_BLUE;
+		AdjustStep steps[4];
+		unsigned count = 0;
+		if (contrast != 0.0) {
+			const AdjustStep step = { FIADJ_CONTRAST, (100.0 + contrast) / 100.0, NULL, NULL, rgb };
+			steps[count++] = step;
+		}
+		if (brightness != 0.0) {
+			const AdjustStep step = { FIADJ_BRIGHTNESS, (100.0 + brightness) / 100.0, NULL, NULL, rgb };
+			steps[count++] = step;
+		}
+		if ((gamma > 0) && (gamma != 1.0)) {
+			const AdjustStep step = { FIADJ_GAMMA, 1 / gamma, NULL, NULL, rgb };
+			steps[count++] = step;
+		}
+		if (invert) {
+			const AdjustStep step = { FIADJ_INVERT, 0, NULL, NULL, rgb };
+			steps[count++] = step;
+		}
+		return count ? AdjustImage(dib, steps, count) : FALSE;
+	}
+
 	int bpp = FreeImage_GetBPP(dib);
 	if ((bpp != 8) && (bpp != 24) && (bpp != 32)) {
 		return FALSE;
@@ -629,6 +1270,85 @@ FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double
 	return FALSE;
 }
 
+/** @brief Applies a chain of point adjustments to an image, with a single pass 
+ over the pixels.
+ 
+ The steps are applied in the given order. Each step performs a brightness, 
+ contrast, gamma, inversion or curve (lookup table) adjustment on some channel(s), 
+ with the same definition as FreeImage_AdjustBrightness, FreeImage_AdjustContrast, 
+ FreeImage_AdjustGamma and FreeImage_AdjustCurve.<br>
+ For 8-bit (palette, greyscale, 24-bit & 32-bit) and 16-bit (FIT_UINT16, FIT_RGB16, 
+ FIT_RGBA16) images, the whole chain is collapsed into one lookup table per channel, 
+ computed in double precision and rounded once. The result is thus equal to, or more 
+ accurate than, calling each adjustment function in turn. For float images (FIT_FLOAT, 
+ FIT_RGBF, FIT_RGBAF), the steps are applied to each sample on the range [0..1], 
+ without clamping.<br>
+ The channel of a step is ignored on single channel images (greyscale, palette, 
+ FIT_UINT16, FIT_FLOAT). A FIADJ_INVERT step on FICC_RGB leaves the alpha channel 
+ alone, unlike FreeImage_Invert.
+ 
+ // example: contrast on all channels, then a curve on the blue channel
+ FIADJUSTMENT chain[2] = {
+   { FIADJ_CONTRAST, 15.0, NULL, FICC_RGB },
+   { FIADJ_CURVE, 0, blue_LUT, FICC_BLUE }
+ };
+ FreeImage_AdjustChain(dib, chain, 2);
+ 
+ @param dib Input/output image to be processed.
+ @param steps Array of adjustment steps.
+ @param count Number of steps in the array.
+ @return Returns TRUE if successful, FALSE otherwise (unsupported image type, 
+ gamma <= 0 or missing LUT).
+ @see FREE_IMAGE_ADJUST
+ */
+BOOL DLL_CALLCONV
+FreeImage_AdjustChain(FIBITMAP *dib, const FIADJUSTMENT *steps, unsigned count) {
+	if (!FreeImage_HasPixels(dib) || (!steps && count)) {
+		return FALSE;
+	}
+
+	std::vector<AdjustStep> chain;
+	try {
+		chain.resize(count);
+	} catch(std::bad_alloc &) {
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < count; i++) {
+		AdjustStep &step = chain[i];
+		step.type = steps[i].type;
+		step.factor = 0;
+		step.lut8 = NULL;
+		step.lut16 = NULL;
+		step.channels = GetAdjustChannels(steps[i].channel);
+
+		switch (steps[i].type) {
+			case FIADJ_BRIGHTNESS:
+			case FIADJ_CONTRAST:
+				step.factor = (100 + steps[i].value) / 100;
+				break;
+			case FIADJ_GAMMA:
+				if (steps[i].value <= 0) {
+					return FALSE;
+				}
+				step.factor = 1 / steps[i].value;
+				break;
+			case FIADJ_INVERT:
+				break;
+			case FIADJ_CURVE:
+				if (!steps[i].LUT) {
+					return FALSE;
+				}
+				step.lut8 = steps[i].LUT;
+				break;
+			default:
+				return FALSE;
+		}
+	}
+
+	return AdjustImage(dib, count ? &chain[0] : NULL, count);
+}
+
 /** @brief Applies color mapping for one or several colors on a 1-, 4- or 8-bit
  palletized or a 16-, 24- or 32-bit high color image.
 
@@ -25,11 +25,69 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
 // ----------------------------------------------------------
 //   Helpers
 // ----------------------------------------------------------
 
+// minimum number of bytes worth a thread when blending images
+#define BLEND_MIN_THREAD_BYTES	(512 * 512)
+
+/**
+Alpha blend a line of samples: dst = (src * alpha + dst * (256 - alpha)) / 256
+@param dst Destination samples, receive the result
+@param src Source samples
+@param count Number of samples
+@param alpha Blend factor (0..255)
+*/
+static void
+BlendLine(BYTE *dst, const BYTE *src, unsigned count, unsigned alpha) {
+	unsigned i = 0;
+
+#ifdef FREEIMAGE_SSE2
+	// the sum is at most 255 * 256, it fits in unsigned 16-bit lanes
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i src_factor = _mm_set1_epi16((short)alpha);
+	const __m128i dst_factor = _mm_set1_epi16((short)(256 - alpha));
+
+	for(; i + 16 <= count; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		const __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), src_factor), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), dst_factor));
+		const __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), src_factor), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), dst_factor));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+#endif // FREEIMAGE_SSE2
+
+	for(; i < count; i++) {
+		dst[i] = (BYTE)(((src[i] - dst[i]) * (int)alpha + (dst[i] << 8)) >> 8);
+	}
+}
+
+/**
+Alpha blend (alpha <= 255) or copy (alpha > 255) the lines of a source image into a destination area, 
+the lines are processed in parallel
+*/
+static void
+BlendLines(BYTE *dst_bits, unsigned dst_pitch, const BYTE *src_bits, unsigned src_pitch, unsigned line, unsigned height, unsigned alpha) {
+	const unsigned threads = FreeImage_GetThreadCount((size_t)line * height, BLEND_MIN_THREAD_BYTES);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		for(unsigned rows = row_begin; rows < row_end; rows++) {
+			BYTE *dst_line = dst_bits + (size_t)rows * dst_pitch;
+			const BYTE *src_line = src_bits + (size_t)rows * src_pitch;
+			if(alpha > 255) {
+				// combine images
+				memcpy(dst_line, src_line, line);
+			} else {
+				// alpha blend images
+				BlendLine(dst_line, src_line, line, alpha);
+			}
+		}
+	});
+}
+
 /////////////////////////////////////////////////////////////
 // Alpha blending / combine functions
 
@@ -208,25 +266,7 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	BlendLines(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -374,25 +414,7 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 3);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if(alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	BlendLines(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -416,25 +438,7 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	BYTE *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 4);
 	BYTE *src_bits = FreeImage_GetBits(src_dib);	
 
-	if (alpha > 255) {
-		// combine images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for(unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	BlendLines(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), FreeImage_GetHeight(src_dib), alpha);
 
 	return TRUE;
 }
@@ -746,44 +750,14 @@ FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha) {
 
 // ----------------------------------------------------------
 
-/** @brief Creates a dynamic read/write view into a FreeImage bitmap.
-
- A dynamic view is a FreeImage bitmap with its own width and height, that,
- however, shares its bits with another FreeImage bitmap. Typically, views
- are used to define one or more rectangular sub-images of an existing
- bitmap. All FreeImage operations, like saving, displaying and all the
- toolkit functions, when applied to the view, only affect the view's
- rectangular area.
-
- Although the view's backing image's bits not need to be copied around,
- which makes the view much faster than similar solutions using
- FreeImage_Copy, a view uses some private memory that needs to be freed by
- calling FreeImage_Unload on the view's handle to prevent memory leaks.
-
- Only the backing image's pixels are shared by the view. For all other image
- data, notably for the resolution, background color, color palette,
- transparency table and for the ICC profile, the view gets a private copy
- of the data. By default, the backing image's metadata is NOT copied to
- the view.
-
- As with all FreeImage functions that take a rectangle region, top and left
- positions are included, whereas right and bottom positions are excluded
- from the rectangle area.
-
- Since the memory block shared by the backing image and the view must start
- at a byte boundary, the value of parameter left must be a multiple of 8
- for 1-bit images and a multiple of 2 for 4-bit images.
-
- @param dib The FreeImage bitmap on which to create the view.
- @param left The left position of the view's area.
- @param top The top position of the view's area.
- @param right The right position of the view's area.
- @param bottom The bottom position of the view's area.
- @return Returns a handle to the newly created view or NULL if the view
- was not created.
- */
-FIBITMAP * DLL_CALLCONV
-FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom) {
+/**
+Create an image referring to a sub part of the pixels of another image. 
+@param copy_on_write If FALSE, create a view. Otherwise, create a copy-on-write image, 
+or return NULL if the pixels cannot be shared.
+@see FreeImage_CreateView, FreeImage_CopyShared
+*/
+static FIBITMAP *
+CreateSharedBitmap(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom, BOOL copy_on_write) {
 	if (!FreeImage_HasPixels(dib)) {
 		return NULL;
 	}
@@ -834,6 +808,12 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 		return NULL;
 	}
 
+	// keep the pixels alive (a view of a user provided buffer does not)
+	if (!FreeImage_SharePixels(dst, dib, copy_on_write) && copy_on_write) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
 	// copy some basic image properties needed for displaying and saving
 
 	// resolution
@@ -859,3 +839,80 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 
 	return dst;
 }
+
+/** @brief Creates a dynamic read/write view into a FreeImage bitmap.
+
+ A dynamic view is a FreeImage bitmap with its own width and height, that,
+ however, shares its bits with another FreeImage bitmap. Typically, views
+ are used to define one or more rectangular sub-images of an existing
+ bitmap. All FreeImage operations, like saving, displaying and all the
+ toolkit functions, when applied to the view, only affect the view's
+ rectangular area.
+
+ Although the view's backing image's bits not need to be copied around,
+ which makes the view much faster than similar solutions using
+ FreeImage_Copy, a view uses some private memory that needs to be freed by
+ calling FreeImage_Unload on the view's handle to prevent memory leaks.
+
+ The view keeps the backing image's pixels alive, so that the backing image
+ may be unloaded before the view (unless its pixels are a user provided
+ buffer, see FreeImage_ConvertFromRawBitsEx).
+
+ Only the backing image's pixels are shared by the view. For all other image
+ data, notably for the resolution, background color, color palette,
+ transparency table and for the ICC profile, the view gets a private copy
+ of the data. By default, the backing image's metadata is NOT copied to
+ the view.
+
+ As with all FreeImage functions that take a rectangle region, top and left
+ positions are included, whereas right and bottom positions are excluded
+ from the rectangle area.
+
+ Since the memory block shared by the backing image and the view must start
+ at a byte boundary, the value of parameter left must be a multiple of 8
+ for 1-bit images and a multiple of 2 for 4-bit images.
+
+ @param dib The FreeImage bitmap on which to create the view.
+ @param left The left position of the view's area.
+ @param top The top position of the view's area.
+ @param right The right position of the view's area.
+ @param bottom The bottom position of the view's area.
+ @return Returns a handle to the newly created view or NULL if the view
+ was not created.
+ */
+FIBITMAP * DLL_CALLCONV
+FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom) {
+	return CreateSharedBitmap(dib, left, top, right, bottom, FALSE);
+}
+
+/**
+Copy a sub part of an image without copying its pixels. 
+The copy shares its pixels with dib until one of them is written: both are copy-on-write 
+images, FreeImage_MakeWritable must be called on an image before writing its pixels. 
+Otherwise, the result is the same as with FreeImage_Copy, which is used when the pixels 
+cannot be shared (a user provided pixel buffer, or a 1- or 4-bit sub image not starting 
+at a byte boundary).
+@param dib Source image
+@param left Specifies the left position of the cropped rectangle. 
+@param top Specifies the top position of the cropped rectangle. 
+@param right Specifies the right position of the cropped rectangle. 
+@param bottom Specifies the bottom position of the cropped rectangle. 
+@return Returns the subimage if successful, NULL otherwise.
+@see FreeImage_CloneShared, FreeImage_MakeWritable
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_CopyShared(FIBITMAP *dib, int left, int top, int right, int bottom) {
+	if((left < 0) || (top < 0) || (right < 0) || (bottom < 0)) {
+		return NULL;
+	}
+
+	FIBITMAP *dst = CreateSharedBitmap(dib, (unsigned)left, (unsigned)top, (unsigned)right, (unsigned)bottom, TRUE);
+	if(!dst) {
+		return FreeImage_Copy(dib, left, top, right, bottom);
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, dib);
+
+	return dst;
+}
@@ -21,7 +21,42 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
 
+// ----------------------------------------------------------
+
+// minimum number of pixels worth a thread in the compositing routines
+#define COMPOSITE_MIN_THREAD_PIXELS	(256 * 256)
+
+/**
+Divide a value of the range [0..65535] by 255, rounding down, with a multiply and a shift
+*/
+static inline unsigned
+Div255(unsigned value) {
+	return (value * 0x8081) >> 23;
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/**
+Divide 8 unsigned 16-bit values by 255, rounding down (see Div255)
+*/
+static inline __m128i
+Div255_epu16(__m128i value) {
+	return _mm_srli_epi16(_mm_mulhi_epu16(value, _mm_set1_epi16((short)0x8081)), 7);
+}
+
+/**
+Broadcast the alpha of each of the 2 pixels held by 8 unsigned 16-bit values (BGRA or RGBA, alpha last)
+*/
+static inline __m128i
+BroadcastAlpha_epu16(__m128i pixels) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+#endif // FREEIMAGE_SSE2
+
+// ----------------------------------------------------------
 
 /**
 @brief Composite a foreground image against a background color or a background image.
@@ -36,7 +71,7 @@ For colour images, the computation is done separately for R, G, and B samples.
 @param appBkColor If not equal to NULL, and useFileBkg is FALSE, use this color as the background color
 @param bg If not equal to NULL and useFileBkg is FALSE and appBkColor is NULL, use this as the background image
 @return Returns the composite image if successful, returns NULL otherwise
-@see FreeImage_IsTransparent, FreeImage_HasBackgroundColor
+@see FreeImage_IsTransparent, FreeImage_HasBackgroundColor, FreeImage_AlphaComposite
 */
 FIBITMAP * DLL_CALLCONV
 FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP *bg) {
@@ -59,14 +94,8 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 
 	int bytespp = (bpp == 8) ? 1 : 4;
 
-	
-	int x, y, c;
-	BYTE alpha = 0, not_alpha;
-	BYTE index;
-	RGBQUAD fgc;	// foreground color
 	RGBQUAD bkc;	// background color
 
-	memset(&fgc, 0, sizeof(RGBQUAD));
 	memset(&bkc, 0, sizeof(RGBQUAD));
 
 	// allocate the composite image
@@ -99,84 +128,92 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 		}
 	}
 
-	for(y = 0; y < height; y++) {
-		// foreground
-		BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, COMPOSITE_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, (unsigned)height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		BYTE alpha = 0, not_alpha;
+		RGBQUAD fgc = bkc;	// foreground color
+		RGBQUAD bgc = bkc;	// background color of the pixel
 
-		for(x = 0; x < width; x++) {
+		for(int y = (int)row_begin; y < (int)row_end; y++) {
+			// foreground
+			BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+			// background
+			BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
+			// composite image
+			BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
 
-			// foreground color + alpha
+			for(int x = 0; x < width; x++) {
 
-			if(bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
-				// get the alpha
-				if(bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
+				// foreground color + alpha
+
+				if(bpp == 8) {
+					// get the foreground color
+					const BYTE index = fg_bits[0];
+					memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
+					// get the alpha
+					if(bIsTransparent) {
+						alpha = trns[index];
+					} else {
+						alpha = 255;
+					}
+				}
+				else if(bpp == 32) {
+					// get the foreground color
+					fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
+					fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
+					fgc.rgbRed   = fg_bits[FI_RGBA_RED];
+					// get the alpha
+					alpha = fg_bits[FI_RGBA_ALPHA];
 				}
-			}
-			else if(bpp == 32) {
-				// get the foreground color
-				fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
-				fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
-				fgc.rgbRed   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
-			}
 
-			// background color
+				// background color
 
-			if(!bHasBkColor) {
-				if(bg) {
-					// get the background color from the background image
-					bkc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
-					bkc.rgbGreen = bg_bits[FI_RGBA_GREEN];
-					bkc.rgbRed   = bg_bits[FI_RGBA_RED];
+				if(!bHasBkColor) {
+					if(bg) {
+						// get the background color from the background image
+						bgc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
+						bgc.rgbGreen = bg_bits[FI_RGBA_GREEN];
+						bgc.rgbRed   = bg_bits[FI_RGBA_RED];
+					}
+					else {
+						// use a checkerboard pattern
+						int c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
+						c = c ? c : 255;
+						bgc.rgbBlue  = (BYTE)c;
+						bgc.rgbGreen = (BYTE)c;
+						bgc.rgbRed   = (BYTE)c;
+					}
+				}
+
+				// composition
+
+				if(alpha == 0) {
+					// output = background
+					cp_bits[FI_RGBA_BLUE] = bgc.rgbBlue;
+					cp_bits[FI_RGBA_GREEN] = bgc.rgbGreen;
+					cp_bits[FI_RGBA_RED] = bgc.rgbRed;
+				}
+				else if(alpha == 255) {
+					// output = foreground
+					cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
+					cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
+					cp_bits[FI_RGBA_RED] = fgc.rgbRed;
 				}
 				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.rgbBlue  = (BYTE)c;
-					bkc.rgbGreen = (BYTE)c;
-					bkc.rgbRed   = (BYTE)c;
+					// output = alpha * foreground + (1-alpha) * background
+					not_alpha = (BYTE)~alpha;
+					cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bgc.rgbBlue) >> 8);
+					cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bgc.rgbGreen) >> 8);
+					cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bgc.rgbRed) >> 8);
 				}
-			}
 
-			// composition
-
-			if(alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = bkc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = bkc.rgbRed;
-			}
-			else if(alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = fgc.rgbRed;
+				fg_bits += bytespp;
+				bg_bits += 3;
+				cp_bits += 3;
 			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (BYTE)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bkc.rgbBlue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bkc.rgbGreen) >> 8);
-				cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bkc.rgbRed) >> 8);
-			}
-
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
 		}
-	}
+	});
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(composite, fg);
@@ -184,47 +221,452 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 	return composite;	
 }
 
+// ----------------------------------------------------------
+
+/**
+Pre-multiply a line of 32-bit pixels: channel = (channel * alpha + 127) / 255
+*/
+static void
+PreMultiplyLine32(BYTE *bits, unsigned width) {
+	unsigned x = 0;
+
+#if defined(FREEIMAGE_SSE2) && (FI_RGBA_ALPHA == 3)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(127);
+	// keeps the alpha lanes of 2 pixels
+	const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+	for(; x + 4 <= width; x += 4) {
+		const __m128i pixels = _mm_loadu_si128((const __m128i*)(bits + 4 * x));
+		__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+		__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+		const __m128i lo_premul = Div255_epu16(_mm_add_epi16(_mm_mullo_epi16(lo, BroadcastAlpha_epu16(lo)), round));
+		const __m128i hi_premul = Div255_epu16(_mm_add_epi16(_mm_mullo_epi16(hi, BroadcastAlpha_epu16(hi)), round));
+		lo = _mm_or_si128(_mm_and_si128(alpha_mask, lo), _mm_andnot_si128(alpha_mask, lo_premul));
+		hi = _mm_or_si128(_mm_and_si128(alpha_mask, hi), _mm_andnot_si128(alpha_mask, hi_premul));
+		_mm_storeu_si128((__m128i*)(bits + 4 * x), _mm_packus_epi16(lo, hi));
+	}
+#endif // FREEIMAGE_SSE2
+
+	for(bits += 4 * x; x < width; x++, bits += 4) {
+		const unsigned alpha = bits[FI_RGBA_ALPHA];
+		bits[FI_RGBA_BLUE] = (BYTE)Div255(alpha * bits[FI_RGBA_BLUE] + 127);
+		bits[FI_RGBA_GREEN] = (BYTE)Div255(alpha * bits[FI_RGBA_GREEN] + 127);
+		bits[FI_RGBA_RED] = (BYTE)Div255(alpha * bits[FI_RGBA_RED] + 127);
+	}
+}
+
 /**
-Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha channel 
+Pre-multiplies an image's red-, green- and blue channels with it's alpha channel 
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
 The transformation changes the red-, green- and blue channels according to the following equation:  
 channel(x, y) = channel(x, y) * alpha_channel(x, y) / 255  
+for 32-bit images, channel(x, y) * alpha_channel(x, y) / 65535 for FIT_RGBA16 images and 
+channel(x, y) * alpha_channel(x, y) for FIT_RGBAF images. 
 @param dib Input/Output dib to be premultiplied
 @return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
 */
 BOOL DLL_CALLCONV 
 FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	if (!FreeImage_HasPixels(dib)) return FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 	
-	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+	if (!((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) == 32)) && (image_type != FIT_RGBA16) && (image_type != FIT_RGBAF)) {
 		return FALSE;
 	}
 
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
-
-	for(int y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const BYTE alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if(alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if(alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_RED] + 127) / 255 );
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, COMPOSITE_MIN_THREAD_PIXELS);
+
+	FreeImage_ParallelFor(0, height, threads, [&](unsigned row_begin, unsigned row_end, unsigned) {
+		for(unsigned y = row_begin; y < row_end; y++) {
+			switch(image_type) {
+				case FIT_BITMAP:
+					PreMultiplyLine32(FreeImage_GetScanLine(dib, y), width);
+					break;
+
+				case FIT_RGBA16:
+				{
+					FIRGBA16 *bits = (FIRGBA16*)FreeImage_GetScanLine(dib, y);
+					for(unsigned x = 0; x < width; x++) {
+						const unsigned alpha = bits[x].alpha;
+						bits[x].red = (WORD)((bits[x].red * alpha + 32767) / 65535);
+						bits[x].green = (WORD)((bits[x].green * alpha + 32767) / 65535);
+						bits[x].blue = (WORD)((bits[x].blue * alpha + 32767) / 65535);
+					}
+					break;
+				}
+
+				default:
+				{
+					FIRGBAF *bits = (FIRGBAF*)FreeImage_GetScanLine(dib, y);
+					for(unsigned x = 0; x < width; x++) {
+						bits[x].red *= bits[x].alpha;
+						bits[x].green *= bits[x].alpha;
+						bits[x].blue *= bits[x].alpha;
+					}
+					break;
+				}
 			}
 		}
-	}
+	});
+
 	return TRUE;
 }
 
+// ----------------------------------------------------------
+//   Porter-Duff compositing
+// ----------------------------------------------------------
+
+/**
+Porter-Duff factors of an operator: result = source * fa + destination * fb 
+(premultiplied colours and alpha)
+*/
+static inline void
+GetPorterDuffFactors(FREE_IMAGE_COMPOSITE_OP op, float src_alpha, float dst_alpha, float *fa, float *fb) {
+	switch(op) {
+		case FICO_CLEAR:	*fa = 0;				*fb = 0;				break;
+		case FICO_SRC:		*fa = 1;				*fb = 0;				break;
+		case FICO_DST:		*fa = 0;				*fb = 1;				break;
+		case FICO_SRC_OVER:	*fa = 1;				*fb = 1 - src_alpha;	break;
+		case FICO_DST_OVER:	*fa = 1 - dst_alpha;	*fb = 1;				break;
+		case FICO_SRC_IN:	*fa = dst_alpha;		*fb = 0;				break;
+		case FICO_DST_IN:	*fa = 0;				*fb = src_alpha;		break;
+		case FICO_SRC_OUT:	*fa = 1 - dst_alpha;	*fb = 0;				break;
+		case FICO_DST_OUT:	*fa = 0;				*fb = 1 - src_alpha;	break;
+		case FICO_SRC_ATOP:	*fa = dst_alpha;		*fb = 1 - src_alpha;	break;
+		case FICO_DST_ATOP:	*fa = 1 - dst_alpha;	*fb = src_alpha;		break;
+		default:			*fa = 1 - dst_alpha;	*fb = 1 - src_alpha;	break;	// FICO_XOR
+	}
+}
+
+/**
+Composite a line of float RGBA pixels (values in [0..1], alpha last) into another one.
+@param dst Destination pixels, receive the result
+@param src Source pixels
+@param width Number of pixels
+@param op Porter-Duff operator
+@param premultiplied TRUE if the colours are premultiplied by alpha
+@param dst_alpha FALSE if the destination has no alpha channel, the result is then left premultiplied
+*/
+static void
+CompositeLineF(float *dst, const float *src, unsigned width, FREE_IMAGE_COMPOSITE_OP op, BOOL premultiplied, BOOL dst_alpha) {
+	unsigned x = 0;
+
+#ifdef FREEIMAGE_SSE2
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 alpha_mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+	for(; x < width; x++) {
+		__m128 s = _mm_loadu_ps(src + 4 * x);
+		__m128 d = _mm_loadu_ps(dst + 4 * x);
+		const __m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m128 da = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3));
+		if(!premultiplied) {
+			s = _mm_or_ps(_mm_and_ps(alpha_mask, s), _mm_andnot_ps(alpha_mask, _mm_mul_ps(s, sa)));
+			d = _mm_or_ps(_mm_and_ps(alpha_mask, d), _mm_andnot_ps(alpha_mask, _mm_mul_ps(d, da)));
+		}
+
+		__m128 fa, fb;
+		switch(op) {
+			case FICO_CLEAR:	fa = zero;					fb = zero;					break;
+			case FICO_SRC:		fa = one;					fb = zero;					break;
+			case FICO_DST:		fa = zero;					fb = one;					break;
+			case FICO_SRC_OVER:	fa = one;					fb = _mm_sub_ps(one, sa);	break;
+			case FICO_DST_OVER:	fa = _mm_sub_ps(one, da);	fb = one;					break;
+			case FICO_SRC_IN:	fa = da;					fb = zero;					break;
+			case FICO_DST_IN:	fa = zero;					fb = sa;					break;
+			case FICO_SRC_OUT:	fa = _mm_sub_ps(one, da);	fb = zero;					break;
+			case FICO_DST_OUT:	fa = zero;					fb = _mm_sub_ps(one, sa);	break;
+			case FICO_SRC_ATOP:	fa = da;					fb = _mm_sub_ps(one, sa);	break;
+			case FICO_DST_ATOP:	fa = _mm_sub_ps(one, da);	fb = sa;					break;
+			default:			fa = _mm_sub_ps(one, da);	fb = _mm_sub_ps(one, sa);	break;	// FICO_XOR
+		}
+		__m128 o = _mm_add_ps(_mm_mul_ps(s, fa), _mm_mul_ps(d, fb));
+
+		if(!premultiplied && dst_alpha) {
+			// back to straight colours, a transparent result is black
+			const __m128 oa = _mm_shuffle_ps(o, o, _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128 visible = _mm_cmpgt_ps(oa, zero);
+			const __m128 straight = _mm_and_ps(visible, _mm_div_ps(o, _mm_max_ps(oa, _mm_set1_ps(1e-30F))));
+			o = _mm_or_ps(_mm_and_ps(alpha_mask, o), _mm_andnot_ps(alpha_mask, straight));
+		}
+		_mm_storeu_ps(dst + 4 * x, o);
+	}
+#endif // FREEIMAGE_SSE2
+
+	for(; x < width; x++) {
+		const float *s = src + 4 * x;
+		float *d = dst + 4 * x;
+		const float sa = s[3];
+		const float da = d[3];
+		const float ks = premultiplied ? 1 : sa;
+		const float kd = premultiplied ? 1 : da;
+
+		float fa, fb;
+		GetPorterDuffFactors(op, sa, da, &fa, &fb);
+
+		const float oa = sa * fa + da * fb;
+		const float scale = (!premultiplied && dst_alpha) ? ((oa > 0) ? 1 / oa : 0) : 1;
+		for(int k = 0; k < 3; k++) {
+			d[k] = (s[k] * ks * fa + d[k] * kd * fb) * scale;
+		}
+		d[3] = oa;
+	}
+}
+
+/**
+Source over, for 32-bit pixels into 32-bit (premultiplied) or 24-bit pixels, 
+with integer arithmetic: result = source * alpha + destination * (255 - alpha) / 255 
+(source * alpha is replaced by source when premultiplied)
+*/
+static void
+SourceOverLine32(BYTE *dst, const BYTE *src, unsigned width, unsigned dst_bytespp, BOOL premultiplied) {
+	unsigned x = 0;
+
+#if defined(FREEIMAGE_SSE2) && (FI_RGBA_ALPHA == 3)
+	if(dst_bytespp == 4) {
+		// premultiplied colours and alpha: o = s + (d * (255 - sa) + 127) / 255
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(127);
+		const __m128i max = _mm_set1_epi16(255);
+		for(; x + 4 <= width; x += 4) {
+			const __m128i s = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+			const __m128i d = _mm_loadu_si128((const __m128i*)(dst + 4 * x));
+			const __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+			const __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+			const __m128i d_lo = Div255_epu16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(max, BroadcastAlpha_epu16(s_lo))), round));
+			const __m128i d_hi = Div255_epu16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(max, BroadcastAlpha_epu16(s_hi))), round));
+			_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_packus_epi16(_mm_add_epi16(s_lo, d_lo), _mm_add_epi16(s_hi, d_hi)));
+		}
+	}
+#endif // FREEIMAGE_SSE2
+
+	src += 4 * x;
+	dst += dst_bytespp * x;
+	for(; x < width; x++) {
+		const unsigned alpha = src[FI_RGBA_ALPHA];
+		const unsigned not_alpha = 255 - alpha;
+		if(premultiplied) {
+			dst[FI_RGBA_BLUE] = (BYTE)MIN(255U, src[FI_RGBA_BLUE] + Div255(dst[FI_RGBA_BLUE] * not_alpha + 127));
+			dst[FI_RGBA_GREEN] = (BYTE)MIN(255U, src[FI_RGBA_GREEN] + Div255(dst[FI_RGBA_GREEN] * not_alpha + 127));
+			dst[FI_RGBA_RED] = (BYTE)MIN(255U, src[FI_RGBA_RED] + Div255(dst[FI_RGBA_RED] * not_alpha + 127));
+			if(dst_bytespp == 4) {
+				dst[FI_RGBA_ALPHA] = (BYTE)MIN(255U, alpha + Div255(dst[FI_RGBA_ALPHA] * not_alpha + 127));
+			}
+		} else {
+			dst[FI_RGBA_BLUE] = (BYTE)Div255(src[FI_RGBA_BLUE] * alpha + dst[FI_RGBA_BLUE] * not_alpha + 127);
+			dst[FI_RGBA_GREEN] = (BYTE)Div255(src[FI_RGBA_GREEN] * alpha + dst[FI_RGBA_GREEN] * not_alpha + 127);
+			dst[FI_RGBA_RED] = (BYTE)Div255(src[FI_RGBA_RED] * alpha + dst[FI_RGBA_RED] * not_alpha + 127);
+		}
+		src += 4;
+		dst += dst_bytespp;
+	}
+}
+
+/**
+Convert a line of pixels to float RGBA on the range [0..1] (alpha = 1 for images without alpha)
+*/
+static void
+LoadLineF(float *buffer, const BYTE *bits, unsigned width, FREE_IMAGE_TYPE image_type, unsigned bpp) {
+	switch(image_type) {
+		case FIT_BITMAP:
+		{
+			const unsigned bytespp = bpp / 8;
+			const float scale = 1.0F / 255;
+			for(unsigned x = 0; x < width; x++, bits += bytespp, buffer += 4) {
+				buffer[0] = bits[FI_RGBA_RED] * scale;
+				buffer[1] = bits[FI_RGBA_GREEN] * scale;
+				buffer[2] = bits[FI_RGBA_BLUE] * scale;
+				buffer[3] = (bytespp == 4) ? bits[FI_RGBA_ALPHA] * scale : 1;
+			}
+			break;
+		}
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		{
+			const WORD *words = (const WORD*)bits;
+			const unsigned wordspp = (image_type == FIT_RGBA16) ? 4 : 3;
+			const float scale = 1.0F / 65535;
+			for(unsigned x = 0; x < width; x++, words += wordspp, buffer += 4) {
+				buffer[0] = words[0] * scale;
+				buffer[1] = words[1] * scale;
+				buffer[2] = words[2] * scale;
+				buffer[3] = (wordspp == 4) ? words[3] * scale : 1;
+			}
+			break;
+		}
+		default:
+		{
+			const float *floats = (const float*)bits;
+			const unsigned floatspp = (image_type == FIT_RGBAF) ? 4 : 3;
+			for(unsigned x = 0; x < width; x++, floats += floatspp, buffer += 4) {
+				buffer[0] = floats[0];
+				buffer[1] = floats[1];
+				buffer[2] = floats[2];
+				buffer[3] = (floatspp == 4) ? floats[3] : 1;
+			}
+			break;
+		}
+	}
+}
+
+/**
+Convert a line of float RGBA pixels back to the pixels of an image (integer types are rounded and clamped)
+*/
+static void
+StoreLineF(BYTE *bits, const float *buffer, unsigned width, FREE_IMAGE_TYPE image_type, unsigned bpp) {
+	switch(image_type) {
+		case FIT_BITMAP:
+		{
+			const unsigned bytespp = bpp / 8;
+			for(unsigned x = 0; x < width; x++, bits += bytespp, buffer += 4) {
+				bits[FI_RGBA_RED] = (BYTE)(CLAMP(buffer[0], 0.0F, 1.0F) * 255 + 0.5F);
+				bits[FI_RGBA_GREEN] = (BYTE)(CLAMP(buffer[1], 0.0F, 1.0F) * 255 + 0.5F);
+				bits[FI_RGBA_BLUE] = (BYTE)(CLAMP(buffer[2], 0.0F, 1.0F) * 255 + 0.5F);
+				if(bytespp == 4) {
+					bits[FI_RGBA_ALPHA] = (BYTE)(CLAMP(buffer[3], 0.0F, 1.0F) * 255 + 0.5F);
+				}
+			}
+			break;
+		}
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		{
+			WORD *words = (WORD*)bits;
+			const unsigned wordspp = (image_type == FIT_RGBA16) ? 4 : 3;
+			for(unsigned x = 0; x < width; x++, words += wordspp, buffer += 4) {
+				for(unsigned k = 0; k < wordspp; k++) {
+					words[k] = (WORD)(CLAMP(buffer[k], 0.0F, 1.0F) * 65535 + 0.5F);
+				}
+			}
+			break;
+		}
+		default:
+		{
+			float *floats = (float*)bits;
+			const unsigned floatspp = (image_type == FIT_RGBAF) ? 4 : 3;
+			for(unsigned x = 0; x < width; x++, floats += floatspp, buffer += 4) {
+				for(unsigned k = 0; k < floatspp; k++) {
+					floats[k] = buffer[k];
+				}
+			}
+			break;
+		}
+	}
+}
+
+/**
+@brief Composite a source image with an alpha channel into a destination image, 
+using one of the Porter-Duff operators.
+
+The source is placed at (left, top) in the destination, and only the area of the destination 
+covered by the source is processed (the parts of the source outside the destination are ignored). 
+Supported combinations are 32-bit into 24- or 32-bit images, FIT_RGBA16 into FIT_RGB16 or 
+FIT_RGBA16 images and FIT_RGBAF into FIT_RGBF or FIT_RGBAF images.<br>
+A destination without alpha channel is opaque. Since it cannot store the result alpha, 
+it receives the premultiplied result colour, i.e. the result composited over black.
+Colours are straight (not premultiplied) unless 'premultiplied' is TRUE, in which case 
+both images must be premultiplied (see FreeImage_PreMultiplyWithAlpha).
+@param dst Destination image, receives the result
+@param src Source image
+@param left Position of the source left edge in the destination
+@param top Position of the source top edge in the destination
+@param op Porter-Duff operator
+@param premultiplied TRUE if the colours of both images are premultiplied by alpha
+@return Returns TRUE if successful, FALSE otherwise
+@see FREE_IMAGE_COMPOSITE_OP
+*/
+BOOL DLL_CALLCONV
+FreeImage_AlphaComposite(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_COMPOSITE_OP op, BOOL premultiplied) {
+	if(!FreeImage_HasPixels(dst) || !FreeImage_HasPixels(src) || (op < FICO_CLEAR) || (op > FICO_XOR)) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(src);
+	const FREE_IMAGE_TYPE dst_type = FreeImage_GetImageType(dst);
+	const unsigned dst_bpp = FreeImage_GetBPP(dst);
+
+	BOOL dst_alpha = FALSE;
+	switch(src_type) {
+		case FIT_BITMAP:
+			if((FreeImage_GetBPP(src) != 32) || (dst_type != FIT_BITMAP) || ((dst_bpp != 24) && (dst_bpp != 32))) {
+				return FALSE;
+			}
+			dst_alpha = (dst_bpp == 32);
+			break;
+		case FIT_RGBA16:
+			if((dst_type != FIT_RGB16) && (dst_type != FIT_RGBA16)) {
+				return FALSE;
+			}
+			dst_alpha = (dst_type == FIT_RGBA16);
+			break;
+		case FIT_RGBAF:
+			if((dst_type != FIT_RGBF) && (dst_type != FIT_RGBAF)) {
+				return FALSE;
+			}
+			dst_alpha = (dst_type == FIT_RGBAF);
+			break;
+		default:
+			return FALSE;
+	}
+
+	// clip the source to the destination
+	const int src_width = (int)FreeImage_GetWidth(src);
+	const int src_height = (int)FreeImage_GetHeight(src);
+	const int dst_width = (int)FreeImage_GetWidth(dst);
+	const int dst_height = (int)FreeImage_GetHeight(dst);
+
+	const int x0 = MAX(left, 0);
+	const int x1 = MIN(left + src_width, dst_width);
+	const int y0 = MAX(top, 0);
+	const int y1 = MIN(top + src_height, dst_height);
+	if((x0 >= x1) || (y0 >= y1)) {
+		return TRUE;
+	}
+	const unsigned width = (unsigned)(x1 - x0);
+
+	const unsigned src_bytespp = FreeImage_GetLine(src) / src_width;
+	const unsigned dst_bytespp = FreeImage_GetLine(dst) / dst_width;
+
+	// 8-bit source over: integer arithmetic, no conversion
+	const BOOL integer = (src_type == FIT_BITMAP) && (op == FICO_SRC_OVER) && (premultiplied || !dst_alpha);
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)width * (y1 - y0), COMPOSITE_MIN_THREAD_PIXELS);
+
+	// one pair of float lines per band
+	std::vector<std::vector<float> > buffers;
+	if(!integer) {
+		try {
+			buffers.resize(threads, std::vector<float>(8 * (size_t)width));
+		} catch(std::bad_alloc &) {
+			FreeImage_OutputMessageProc(FIF_UNKNOWN, FI_MSG_ERROR_MEMORY);
+			return FALSE;
+		}
+	}
+
+	FreeImage_ParallelFor((unsigned)y0, (unsigned)y1, threads, [&](unsigned row_begin, unsigned row_end, unsigned band) {
+		for(unsigned y = row_begin; y < row_end; y++) {
+			// rows are counted from the top
+			const BYTE *src_bits = FreeImage_GetScanLine(src, src_height - 1 - ((int)y - top)) + (x0 - left) * src_bytespp;
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - 1 - (int)y) + x0 * dst_bytespp;
+
+			if(integer) {
+				SourceOverLine32(dst_bits, src_bits, width, dst_bytespp, premultiplied);
+			} else {
+				float *src_line = &buffers[band][0];
+				float *dst_line = src_line + 4 * width;
+				LoadLineF(src_line, src_bits, width, src_type, 32);
+				LoadLineF(dst_line, dst_bits, width, dst_type, dst_bpp);
+				CompositeLineF(dst_line, src_line, width, op, premultiplied, dst_alpha);
+				StoreLineF(dst_bits, dst_line, width, dst_type, dst_bpp);
+			}
+		}
+	});
+
+	return TRUE;
+}
@@ -23,6 +23,148 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Parallel.h"
+
+#define FLIP_MIN_THREAD_PIXELS	0x40000	// minimum number of pixels per thread
+
+// ----------------------------------------------------------
+//   Scanline mirroring
+// ----------------------------------------------------------
+
+/** Pixel of N bytes, copied as a whole */
+template <unsigned N> struct MirrorPixel {
+	BYTE bytes[N];
+};
+
+/**
+Mirror the pixels in the range [left, right) of a scanline. 
+Works in place, as each pair of pixels is read before it is written.
+*/
+template <unsigned N> static inline void
+MirrorRangeT(BYTE *dst, const BYTE *src, unsigned left, unsigned right) {
+	typedef MirrorPixel<N> T;
+	const T *s = reinterpret_cast<const T*>(src);
+	T *d = reinterpret_cast<T*>(dst);
+
+	while(right - left >= 2) {
+		--right;
+		const T a = s[left];
+		const T b = s[right];
+		d[left] = b;
+		d[right] = a;
+		++left;
+	}
+	if(right > left) {
+		d[left] = s[left];
+	}
+}
+
+#ifdef FREEIMAGE_SSE2
+
+/** Reverse the order of the N-byte elements of a 16-byte vector */
+template <unsigned N> static inline __m128i ReverseVector(__m128i v);
+
+template <> inline __m128i ReverseVector<1>(__m128i v) {
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_or_si128(_mm_srli_epi16(v, 8), _mm_slli_epi16(v, 8));
+}
+
+template <> inline __m128i ReverseVector<2>(__m128i v) {
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+template <> inline __m128i ReverseVector<4>(__m128i v) {
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+template <> inline __m128i ReverseVector<8>(__m128i v) {
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+/**
+Mirror a scanline of N-byte pixels, 16 bytes from each end at a time. 
+The middle of the line is handled by MirrorRangeT.
+*/
+template <unsigned N> static void
+MirrorLineT(BYTE *dst, const BYTE *src, unsigned width) {
+	const unsigned n = 16 / N;	// pixels per vector
+
+	unsigned left = 0;
+	unsigned right = width;
+	while(right - left >= 2 * n) {
+		right -= n;
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + left * N));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + right * N));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + left * N), ReverseVector<N>(b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + right * N), ReverseVector<N>(a));
+		left += n;
+	}
+	MirrorRangeT<N>(dst, src, left, right);
+}
+
+#else
+
+template <unsigned N> static void
+MirrorLineT(BYTE *dst, const BYTE *src, unsigned width) {
+	MirrorRangeT<N>(dst, src, 0, width);
+}
+
+#endif // FREEIMAGE_SSE2
+
+void 
+MirrorScanLine(BYTE *dst, const BYTE *src, unsigned width, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			MirrorLineT<1>(dst, src, width);
+			break;
+		case 2:
+			MirrorLineT<2>(dst, src, width);
+			break;
+		case 3:
+			MirrorRangeT<3>(dst, src, 0, width);
+			break;
+		case 4:
+			MirrorLineT<4>(dst, src, width);
+			break;
+		case 6:
+			MirrorRangeT<6>(dst, src, 0, width);
+			break;
+		case 8:
+			MirrorLineT<8>(dst, src, width);
+			break;
+		case 12:
+			MirrorRangeT<12>(dst, src, 0, width);
+			break;
+		case 16:
+			MirrorRangeT<16>(dst, src, 0, width);
+			break;
+		default:
+		{
+			// any other pixel size, byte by byte
+			for(unsigned left = 0, right = width - 1; left < right; left++, right--) {
+				BYTE *a = dst + left * bytespp;
+				BYTE *b = dst + right * bytespp;
+				const BYTE *sa = src + left * bytespp;
+				const BYTE *sb = src + right * bytespp;
+				for(unsigned k = 0; k < bytespp; k++) {
+					const BYTE tmp = sa[k];
+					a[k] = sb[k];
+					b[k] = tmp;
+				}
+			}
+			if((width & 1) && (dst != src)) {
+				memcpy(dst + (width / 2) * bytespp, src + (width / 2) * bytespp, bytespp);
+			}
+		}
+		break;
+	}
+}
+
+// ----------------------------------------------------------
 
 /**
 Flip the image horizontally along the vertical axis.
@@ -36,8 +178,23 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 	unsigned line   = FreeImage_GetLine(src);
 	unsigned width	= FreeImage_GetWidth(src);
 	unsigned height = FreeImage_GetHeight(src);
+	unsigned bpp	= FreeImage_GetBPP(src);
 
-	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+	if(bpp >= 8) {
+		// mirror the lines in place, rows are processed concurrently
+
+		const unsigned bytespp = line / width;
+		const unsigned threads = FreeImage_GetThreadCount((size_t)width * height, FLIP_MIN_THREAD_PIXELS);
+
+		FreeImage_ParallelFor(0, height, threads, [src, width, bytespp](unsigned y_begin, unsigned y_end, unsigned) {
+			for(unsigned y = y_begin; y < y_end; y++) {
+				BYTE *bits = FreeImage_GetScanLine(src, y);
+				MirrorScanLine(bits, bits, width, bytespp);
+			}
+		});
+
+		return TRUE;
+	}
 
 	// copy between aligned memories
 	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
@@ -49,7 +206,7 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 		BYTE *bits = FreeImage_GetScanLine(src, y);
 		memcpy(new_bits, bits, line);
 
-		switch (FreeImage_GetBPP(src)) {
+		switch (bpp) {
 			case 1 :
 			{				
 				for(unsigned x = 0; x < width; x++) {
@@ -64,55 +221,19 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 			case 4 :
 			{
-				for(unsigned c = 0; c < line; c++) {
-					bits[c] = new_bits[line - c - 1];
-
-					BYTE nibble = (bits[c] & 0xF0) >> 4;
-
-					bits[c] = bits[c] << 4;
-					bits[c] |= nibble;
-				}
-			}
-			break;
-
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
+				for(unsigned x = 0; x < width; x++) {
+					// get pixel at (x, y)
+					const BYTE nibble = (x & 0x01) ? (new_bits[x >> 1] & 0x0F) : (new_bits[x >> 1] >> 4);
+					// set pixel at (new_x, y)
+					const unsigned new_x = width - 1 - x;
+					if(new_x & 0x01) {
+						bits[new_x >> 1] = (BYTE)((bits[new_x >> 1] & 0xF0) | nibble);
+					} else {
+						bits[new_x >> 1] = (BYTE)((bits[new_x >> 1] & 0x0F) | (nibble << 4));
 					}
-					src_data -= bytespp;
-				} 
+				}
 			}
 			break;
-
 		}
 	}
 
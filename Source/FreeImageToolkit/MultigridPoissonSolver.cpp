@@ -25,85 +25,94 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "Parallel.h"
 
 static const int NPRE	= 1;		// Number of relaxation sweeps before ...
 static const int NPOST	= 1;		// ... and after the coarse-grid correction is computed
 static const int NGMAX	= 15;		// Maximum number of grids
 
+// minimum number of grid points worth a thread
+static const size_t FMG_MIN_THREAD_POINTS = 256 * 256;
+
 /**
-Copy src into dst
+A grid level. Points are stored row by row, 
+u[row][col] is bits[row * pitch + col] with row in [0..ny-1] and col in [0..nx-1]. 
+Boundary points (first and last rows and columns) are Dirichlet conditions. 
 */
-static inline void fmg_copyArray(FIBITMAP *dst, FIBITMAP *src) {
-	memcpy(FreeImage_GetBits(dst), FreeImage_GetBits(src), FreeImage_GetHeight(dst) * FreeImage_GetPitch(dst));
-}
+struct fmg_grid {
+	float *bits;	// grid points
+	int pitch;		// distance between two rows, in floats
+	int nx;			// number of columns, 2^j*cx + 1
+	int ny;			// number of rows, 2^j*cy + 1
+	float h;		// mesh size
+};
 
 /**
-Fills src with zeros
+All the grid levels of a solve, carved out of a single allocation that is reused by every V-cycle. 
+Level 0 is the coarsest grid, level ng-1 is the finest one. 
+On the coarse levels, rhs[] first holds the restricted right-hand side (rho in Numerical Recipes), 
+then serves as the right-hand side of the coarse-grid corrections. 
 */
-static inline void fmg_fillArrayWithZeros(FIBITMAP *src) {
-	memset(FreeImage_GetBits(src), 0, FreeImage_GetHeight(src) * FreeImage_GetPitch(src));
+struct fmg_workspace {
+	int ng;					// number of grid levels
+	fmg_grid u[NGMAX];		// solution on each level
+	fmg_grid rhs[NGMAX];	// right-hand side on each level
+	float *line;			// scratch memory used by the coarsest grid solver
+};
+
+/**
+Get the number of threads worth using on a grid
+*/
+static inline unsigned 
+fmg_threads(const fmg_grid& grid) {
+	return FreeImage_GetThreadCount((size_t)grid.nx * grid.ny, FMG_MIN_THREAD_POINTS);
 }
 
 /**
-Half-weighting restriction. nc is the coarse-grid dimension. The fine-grid solution is input in
-uf[0..2*nc-2][0..2*nc-2], the coarse-grid solution is returned in uc[0..nc-1][0..nc-1].
+Fills a grid with zeros
 */
-static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
-	int row_uc, row_uf, col_uc, col_uf;
+static inline void 
+fmg_fillArrayWithZeros(const fmg_grid& grid) {
+	memset(grid.bits, 0, (size_t)grid.ny * grid.pitch * sizeof(float));
+}
 
-	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
-	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
-	
-	float *uc_bits = (float*)FreeImage_GetBits(UC);
-	const float *uf_bits = (float*)FreeImage_GetBits(UF);
+/**
+Half-weighting restriction. The fine-grid values are input in UF[0..2*nyc-2][0..2*nxc-2], 
+the coarse-grid values are returned in UC[0..nyc-1][0..nxc-1]. 
+*/
+static void 
+fmg_restrict(const fmg_grid& UC, const fmg_grid& UF) {
+	const int nxc = UC.nx;
+	const int nyc = UC.ny;
 
 	// interior points
-	{
-		float *uc_scan = uc_bits + uc_pitch;
-		for (row_uc = 1, row_uf = 2; row_uc < nc-1; row_uc++, row_uf += 2) {
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
+	FreeImage_ParallelFor(1, nyc - 1, fmg_threads(UF), [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned row_uc = first; row_uc < last; row_uc++) {
+			float *uc_scan = UC.bits + row_uc * UC.pitch;
+			const float *uf_scan = UF.bits + 2 * row_uc * UF.pitch;
+			for(int col_uc = 1, col_uf = 2; col_uc < nxc-1; col_uc++, col_uf += 2) {
 				// calculate 
 				// UC(row_uc, col_uc) = 
 				// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
-				float *uc_pixel = uc_scan + col_uc;
 				const float *uf_center = uf_scan + col_uf;
-				*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
+				uc_scan[col_uc] = 0.5F * *uf_center + 0.125F * ( *(uf_center + UF.pitch) + *(uf_center - UF.pitch) + *(uf_center + 1) + *(uf_center - 1) );
 			}
-			uc_scan += uc_pitch;
 		}
-	}
+	});
+
 	// boundary points
-	const int ncc = 2*nc-1;
-	{
-		/*
-		calculate the following: 
-		for (row_uc = 0, row_uf = 0; row_uc < nc; row_uc++, row_uf += 2) { 
-			UC(row_uc, 0) = UF(row_uf, 0);		
-			UC(row_uc, nc-1) = UF(row_uf, ncc-1);
-		}
-		*/
-		float *uc_scan = uc_bits;
-		for (row_uc = 0, row_uf = 0; row_uc < nc; row_uc++, row_uf += 2) { 
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			uc_scan[0] = uf_scan[0];
-			uc_scan[nc-1] = uf_scan[ncc-1];
-			uc_scan += uc_pitch;
-		}
+	for(int row_uc = 0; row_uc < nyc; row_uc++) {
+		const float *uf_scan = UF.bits + 2 * row_uc * UF.pitch;
+		float *uc_scan = UC.bits + row_uc * UC.pitch;
+		uc_scan[0] = uf_scan[0];
+		uc_scan[nxc-1] = uf_scan[UF.nx-1];
 	}
 	{
-		/*
-		calculate the following: 
-		for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-			UC(0, col_uc) = UF(0, col_uf);
-			UC(nc-1, col_uc) = UF(ncc-1, col_uf);
-		}
-		*/
-		float *uc_scan_top = uc_bits;
-		float *uc_scan_bottom = uc_bits + (nc-1)*uc_pitch;
-		const float *uf_scan_top = uf_bits + (ncc-1)*uf_pitch;
-		const float *uf_scan_bottom = uf_bits;
-		for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
+		float *uc_scan_top = UC.bits;
+		float *uc_scan_bottom = UC.bits + (nyc-1) * UC.pitch;
+		const float *uf_scan_top = UF.bits;
+		const float *uf_scan_bottom = UF.bits + (UF.ny-1) * UF.pitch;
+		for(int col_uc = 0, col_uf = 0; col_uc < nxc; col_uc++, col_uf += 2) {
 			uc_scan_top[col_uc] = uf_scan_top[col_uf];
 			uc_scan_bottom[col_uc] = uf_scan_bottom[col_uf];
 		}
@@ -111,344 +120,277 @@ static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
 }
 
 /**
-Solution of the model problem on the coarsest grid, where h = 1/2 . 
-The right-hand side is input
-in rhs[0..2][0..2] and the solution is returned in u[0..2][0..2].
+Minus the residual of the model problem at an interior point of the fine grid
 */
-static void fmg_solve(FIBITMAP *U, FIBITMAP *RHS) {
-	// fill U with zeros
-	fmg_fillArrayWithZeros(U);
-	// calculate U(1, 1) = -h*h*RHS(1, 1)/4.0 where h = 1/2
-	float *u_scan = (float*)FreeImage_GetScanLine(U, 1);
-	const float *rhs_scan = (float*)FreeImage_GetScanLine(RHS, 1);
-	u_scan[1] = -rhs_scan[1] / 16;
+static inline float 
+fmg_residualAt(const float *u_center, int u_pitch, float rhs_center, float h2i) {
+	// calculate RES(row, col) = 
+	// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
+	float res = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1) - 4 * *u_center;
+	res *= -h2i;
+	res += rhs_center;
+	return res;
 }
 
 /**
-Coarse-to-fine prolongation by bilinear interpolation. nf is the fine-grid dimension. The coarsegrid
-solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2 + 1. The fine-grid solution is
-returned in uf[0..nf-1][0..nf-1].
+Computes minus the residual of the model problem on the fine grid (U, RHS) and restricts it 
+by half-weighting to RC, the next coarser grid. This is fmg_residual followed by fmg_restrict, 
+without storing the fine-grid residual: the residual is zero on the fine-grid boundary, 
+and so is the restricted residual on the coarse-grid boundary. 
 */
-static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
-	int row_uc, row_uf, col_uc, col_uf;
-
-	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
-	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
-	
-	float *uf_bits = (float*)FreeImage_GetBits(UF);
-	const float *uc_bits = (float*)FreeImage_GetBits(UC);
-	
-	// do elements that are copies
-	{
-		const int nc = nf/2 + 1;
-
-		float *uf_scan = uf_bits;
-		const float *uc_scan = uc_bits;		
-		for (row_uc = 0; row_uc < nc; row_uc++) {
-			for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
-				// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
-				uf_scan[col_uf] = uc_scan[col_uc];
-			}
-			uc_scan += uc_pitch;
-			uf_scan += 2 * uf_pitch;
-		}
-	}
-	// do odd-numbered columns, interpolating vertically
-	{		
-		for(row_uf = 1; row_uf < nf-1; row_uf += 2) {
-			float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uf = 0; col_uf < nf; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
-				uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
-			}
-		}
-	}
-	// do even-numbered columns, interpolating horizontally
-	{
-		float *uf_scan = uf_bits;
-		for(row_uf = 0; row_uf < nf; row_uf++) {
-			for (col_uf = 1; col_uf < nf-1; col_uf += 2) {
-				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
-				uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
+static void 
+fmg_restrictResidual(const fmg_grid& RC, const fmg_grid& U, const fmg_grid& RHS) {
+	const int nxc = RC.nx;
+	const int nyc = RC.ny;
+	const float h2i = 1.0F / (U.h * U.h);
+	const int u_pitch = U.pitch;
+
+	FreeImage_ParallelFor(1, nyc - 1, fmg_threads(U), [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned row_rc = first; row_rc < last; row_rc++) {
+			const int row = 2 * row_rc;
+			float *rc_scan = RC.bits + row_rc * RC.pitch;
+			const float *u_scan = U.bits + row * u_pitch;
+			const float *rhs_scan = RHS.bits + row * RHS.pitch;
+
+			rc_scan[0] = 0;
+			for(int col_rc = 1, col = 2; col_rc < nxc-1; col_rc++, col += 2) {
+				const float *u_center = u_scan + col;
+				const float *rhs_center = rhs_scan + col;
+				const float center = fmg_residualAt(u_center, u_pitch, *rhs_center, h2i);
+				const float north = fmg_residualAt(u_center + u_pitch, u_pitch, *(rhs_center + RHS.pitch), h2i);
+				const float south = fmg_residualAt(u_center - u_pitch, u_pitch, *(rhs_center - RHS.pitch), h2i);
+				const float east = fmg_residualAt(u_center + 1, u_pitch, *(rhs_center + 1), h2i);
+				const float west = fmg_residualAt(u_center - 1, u_pitch, *(rhs_center - 1), h2i);
+				rc_scan[col_rc] = 0.5F * center + 0.125F * ( north + south + east + west );
 			}
-			uf_scan += uf_pitch;
+			rc_scan[nxc-1] = 0;
 		}
-	}
+	});
+
+	// boundary points
+	memset(RC.bits, 0, nxc * sizeof(float));
+	memset(RC.bits + (nyc-1) * RC.pitch, 0, nxc * sizeof(float));
 }
 
 /**
-Red-black Gauss-Seidel relaxation for model problem. Updates the current value of the solution
-u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].
+Solution of the model problem on the coarsest grid. 
+The coarsest grid has a single row or a single column of interior points 
+(a single point for square grids, where h = 1/2), so that the problem is a tridiagonal system 
+solved exactly with the Thomas algorithm. 
+The right-hand side is input in RHS and the solution is returned in U. 
+@param line Scratch memory of 2*MAX(nx, ny) floats
 */
-static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col, ipass, isw, jsw;
-	const float h = 1.0F / (n - 1);
-	const float h2 = h*h;
-
-	const int u_pitch  = FreeImage_GetPitch(U) / sizeof(float);
-	const int rhs_pitch  = FreeImage_GetPitch(RHS) / sizeof(float);
-	
-	float *u_bits = (float*)FreeImage_GetBits(U);
-	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
-
-	for (ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
-		float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1, isw = jsw; row < n-1; row++, isw = 3-isw) {
-			for (col = isw; col < n-1; col += 2) { 
-				// Gauss-Seidel formula
-				// calculate U(row, col) = 
-				// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
-				float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
-				*u_center -= h2 * *rhs_center;
-				*u_center *= 0.25F;
-			}
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
+static void 
+fmg_solve(const fmg_grid& U, const fmg_grid& RHS, float *line) {
+	// fill U with zeros
+	fmg_fillArrayWithZeros(U);
+
+	// interior points along the line
+	int n, u_step, rhs_step;
+	if(U.ny == 3) {
+		n = U.nx - 2;
+		u_step = 1;
+		rhs_step = 1;
+	} else {
+		n = U.ny - 2;
+		u_step = U.pitch;
+		rhs_step = RHS.pitch;
+	}
+	float *u = U.bits + U.pitch + 1;
+	const float *rhs = RHS.bits + RHS.pitch + 1;
+	const float h2 = U.h * U.h;
+
+	// solve U(k-1) - 4 * U(k) + U(k+1) = h*h*RHS(k), with U = 0 on the boundary
+	float *c = line;
+	float *d = line + n;
+	c[0] = 1 / -4.0F;
+	d[0] = h2 * rhs[0] / -4.0F;
+	for(int k = 1; k < n; k++) {
+		const float m = -4.0F - c[k-1];
+		c[k] = 1 / m;
+		d[k] = (h2 * rhs[k * rhs_step] - d[k-1]) / m;
+	}
+	u[(n-1) * u_step] = d[n-1];
+	for(int k = n-2; k >= 0; k--) {
+		u[k * u_step] = d[k] - c[k] * u[(k+1) * u_step];
 	}
 }
 
 /**
-Returns minus the residual for the model problem. Input quantities are u[0..n-1][0..n-1] and
-rhs[0..n-1][0..n-1], while res[0..n-1][0..n-1] is returned.
+Coarse-to-fine prolongation by bilinear interpolation. The coarse-grid solution is input as 
+UC[0..nyc-1][0..nxc-1]. The interpolated fine-grid solution UF[0..2*nyc-2][0..2*nxc-2] 
+is stored into UF, or added to UF when add is TRUE (the coarse-grid correction). 
 */
-static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col;
-
-	const float h = 1.0F / (n-1);	
-	const float h2i = 1.0F / (h*h);
-
-	const int res_pitch  = FreeImage_GetPitch(RES) / sizeof(float);
-	const int u_pitch  = FreeImage_GetPitch(U) / sizeof(float);
-	const int rhs_pitch  = FreeImage_GetPitch(RHS) / sizeof(float);
-	
-	float *res_bits = (float*)FreeImage_GetBits(RES);
-	const float *u_bits = (float*)FreeImage_GetBits(U);
-	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
-
-	// interior points
-	{
-		float *res_scan = res_bits + res_pitch;
-		const float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1; row < n-1; row++) {
-			for (col = 1; col < n-1; col++) {
-				// calculate RES(row, col) = 
-				// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
-				float *res_center = res_scan + col;
-				const float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*res_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1) - 4 * *u_center;
-				*res_center *= -h2i;
-				*res_center += *rhs_center;
+static void 
+fmg_prolongate(const fmg_grid& UF, const fmg_grid& UC, BOOL add) {
+	const int nxc = UC.nx;
+
+	FreeImage_ParallelFor(0, UF.ny, fmg_threads(UF), [&](unsigned first, unsigned last, unsigned) {
+		for(unsigned row_uf = first; row_uf < last; row_uf++) {
+			float *uf_scan = UF.bits + row_uf * UF.pitch;
+			// rows that are copies read a single coarse row, 
+			// odd-numbered rows interpolate vertically between two coarse rows
+			const float *uc_below = UC.bits + (row_uf / 2) * UC.pitch;
+			const float *uc_above = (row_uf & 1) ? uc_below + UC.pitch : NULL;
+
+			float left = uc_above ? 0.5F * ( uc_above[0] + uc_below[0] ) : uc_below[0];
+			for(int col_uc = 0; col_uc < nxc; col_uc++) {
+				float *uf_pixel = uf_scan + 2 * col_uc;
+				// even-numbered columns
+				if(add) {
+					uf_pixel[0] += left;
+				} else {
+					uf_pixel[0] = left;
+				}
+				if(col_uc == nxc-1) break;
+				// odd-numbered columns, interpolating horizontally
+				const float right = uc_above ? 0.5F * ( uc_above[col_uc+1] + uc_below[col_uc+1] ) : uc_below[col_uc+1];
+				const float value = 0.5F * ( right + left );
+				if(add) {
+					uf_pixel[1] += value;
+				} else {
+					uf_pixel[1] = value;
+				}
+				left = right;
 			}
-			res_scan += res_pitch;
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
-	}
-
-	// boundary points
-	{
-		memset(FreeImage_GetScanLine(RES, 0), 0, FreeImage_GetPitch(RES));
-		memset(FreeImage_GetScanLine(RES, n-1), 0, FreeImage_GetPitch(RES));
-		float *left = res_bits;
-		float *right = res_bits + (n-1);
-		for(int k = 0; k < n; k++) {
-			*left = 0;
-			*right = 0;
-			left += res_pitch;
-			right += res_pitch;
 		}
-	}
+	});
 }
 
 /**
-Does coarse-to-fine interpolation and adds result to uf. nf is the fine-grid dimension. The
-coarse-grid solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2+1. The fine-grid solution
-is returned in uf[0..nf-1][0..nf-1]. res[0..nf-1][0..nf-1] is used for temporary storage.
+Red-black Gauss-Seidel relaxation for model problem. Updates the current value of the solution 
+U, using the right-hand side function RHS. 
+Points of one colour only depend on points of the other colour, so that each sweep is split 
+into bands of rows processed concurrently. 
 */
-static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
-	fmg_prolongate(RES, UC, nf);
-
-	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
-	const int res_pitch  = FreeImage_GetPitch(RES) / sizeof(float);	
-
-	float *uf_bits = (float*)FreeImage_GetBits(UF);
-	const float *res_bits = (float*)FreeImage_GetBits(RES);
-
-	for(int row = 0; row < nf; row++) {
-		for(int col = 0; col < nf; col++) {
-			// calculate UF(row, col) = UF(row, col) + RES(row, col);
-			uf_bits[col] += res_bits[col];
-		}
-		uf_bits += uf_pitch;
-		res_bits += res_pitch;
+static void 
+fmg_relaxation(const fmg_grid& U, const fmg_grid& RHS) {
+	const int nx = U.nx;
+	const float h2 = U.h * U.h;
+	const int u_pitch = U.pitch;
+	const unsigned threads = fmg_threads(U);
+
+	for(int ipass = 0; ipass < 2; ipass++) { // Red and black sweeps
+		FreeImage_ParallelFor(1, U.ny - 1, threads, [&](unsigned first, unsigned last, unsigned) {
+			for(unsigned row = first; row < last; row++) {
+				float *u_scan = U.bits + row * u_pitch;
+				const float *rhs_scan = RHS.bits + row * RHS.pitch;
+				// first column of the current colour
+				const int isw = (ipass == 0) ? 2 - (int)(row & 1) : 1 + (int)(row & 1);
+				for(int col = isw; col < nx-1; col += 2) {
+					// Gauss-Seidel formula
+					// calculate U(row, col) = 
+					// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
+					float *u_center = u_scan + col;
+					float value = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
+					value -= h2 * rhs_scan[col];
+					*u_center = value * 0.25F;
+				}
+			}
+		});
 	}
 }
 
 /**
-Full Multigrid Algorithm for solution of linear elliptic equation, here the model problem (19.0.6).
-On input u[0..n-1][0..n-1] contains the right-hand side , while on output it returns the solution.
-The dimension n must be of the form 2^j + 1 for some integer j. (j is actually the number of
-grid levels used in the solution, called ng below.) ncycle is the number of V-cycles to be
-used at each level.
+Full Multigrid Algorithm for solution of linear elliptic equation, here the model problem (19.0.6). 
+On input, the finest level of ws.rhs[] contains the right-hand side rho, while on output 
+the finest level of ws.u[] returns the solution. 
+The grid dimensions must be of the form 2^j*c + 1, where j + 1 is the number of grid levels 
+(called ng below) and where the coarsest grid has 3 rows or 3 columns. 
+ncycle is the number of V-cycles to be used at each level. 
 */
-static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
-	int j, jcycle, jj, jpost, jpre, nf, ngrid;
-
-	FIBITMAP **IRHO = NULL;
-	FIBITMAP **IU   = NULL;
-	FIBITMAP **IRHS = NULL;
-	FIBITMAP **IRES = NULL;
-	
-	int ng = 0;		// number of allocated grids
-
-// --------------------------------------------------------------------------
-
-#define _CREATE_ARRAY_GRID_(array, array_size) \
-	array = (FIBITMAP**)malloc(array_size * sizeof(FIBITMAP*));\
-	if(!array) throw(1);\
-	memset(array, 0, array_size * sizeof(FIBITMAP*))
-
-#define _FREE_ARRAY_GRID_(array, array_size) \
-	if(NULL != array) {\
-		for(int k = 0; k < array_size; k++) {\
-			if(NULL != array[k]) {\
-				FreeImage_Unload(array[k]); array[k] = NULL;\
-			}\
-		}\
-		free(array);\
+static void 
+fmg_mglin(fmg_workspace& ws, int ncycle) {
+	const int ng = ws.ng;
+	fmg_grid *U = ws.u;
+	fmg_grid *RHS = ws.rhs;
+
+	if(ng == 1) {
+		// the finest grid is also the coarsest one
+		fmg_solve(U[0], RHS[0], ws.line);
+		return;
 	}
 
-// --------------------------------------------------------------------------
-
-	try {
-		int nn = n;
-		// check grid size and grid levels
-		while (nn >>= 1) ng++;
-		if (n != 1 + (1L << ng)) {
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: n = %d, while n-1 must be a power of 2.", n);
-			throw(1);
-		}
-		if (ng > NGMAX) {
-			FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: ng = %d while NGMAX = %d, increase NGMAX.", ng, NGMAX);
-			throw(1);
-		}
-		// allocate grid arrays
-		{
-			_CREATE_ARRAY_GRID_(IRHO, ng);
-			_CREATE_ARRAY_GRID_(IU, ng);
-			_CREATE_ARRAY_GRID_(IRHS, ng);
-			_CREATE_ARRAY_GRID_(IRES, ng);
-		}
-
-		nn = n/2 + 1;
-		ngrid = ng - 2;
-
-		// allocate storage for r.h.s. on grid (ng - 2) ...
-		IRHO[ngrid] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-		if(!IRHO[ngrid]) throw(1);
-
-		// ... and fill it by restricting from the fine grid
-		fmg_restrict(IRHO[ngrid], U, nn);	
-
-		// similarly allocate storage and fill r.h.s. on all coarse grids.
-		while (nn > 3) {
-			nn = nn/2 + 1; 
-			ngrid--;
-			IRHO[ngrid] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-			if(!IRHO[ngrid]) throw(1);
-			fmg_restrict(IRHO[ngrid], IRHO[ngrid+1], nn);
-		}
+	// fill the r.h.s. on all coarse grids by restricting from the fine grid
+	for(int j = ng - 2; j >= 0; j--) {
+		fmg_restrict(RHS[j], RHS[j+1]);
+	}
 
-		nn = 3;
-
-		IU[0] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-		if(!IU[0]) throw(1);
-		IRHS[0] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-		if(!IRHS[0]) throw(1);
-
-		// initial solution on coarsest grid
-		fmg_solve(IU[0], IRHO[0]);
-		// irho[0] no longer needed ...
-		FreeImage_Unload(IRHO[0]); IRHO[0] = NULL;
-
-		ngrid = ng;
-
-		// nested iteration loop
-		for (j = 1; j < ngrid; j++) {
-			nn = 2*nn - 1;
-
-			IU[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-			if(!IU[j]) throw(1);
-			IRHS[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-			if(!IRHS[j]) throw(1);
-			IRES[j] = FreeImage_AllocateT(FIT_FLOAT, nn, nn);
-			if(!IRES[j]) throw(1);
-
-			fmg_prolongate(IU[j], IU[j-1], nn);
-			
-			// interpolate from coarse grid to next finer grid
-
-			// set up r.h.s.
-			fmg_copyArray(IRHS[j], j != (ngrid - 1) ? IRHO[j] : U);
-			
-			// V-cycle loop
-			for (jcycle = 0; jcycle < ncycle; jcycle++) {
-				nf = nn;
-				// downward stoke of the V
-				for (jj = j; jj >= 1; jj--) {
-					// pre-smoothing
-					for (jpre = 0; jpre < NPRE; jpre++) {
-						fmg_relaxation(IU[jj], IRHS[jj], nf);
-					}
-					fmg_residual(IRES[jj], IU[jj], IRHS[jj], nf);
-					nf = nf/2 + 1;
-					// restriction of the residual is the next r.h.s.
-					fmg_restrict(IRHS[jj-1], IRES[jj], nf);				
-					// zero for initial guess in next relaxation
-					fmg_fillArrayWithZeros(IU[jj-1]);
+	// initial solution on coarsest grid
+	fmg_solve(U[0], RHS[0], ws.line);
+
+	// nested iteration loop
+	for(int j = 1; j < ng; j++) {
+		// interpolate from coarse grid to next finer grid. 
+		// The r.h.s. at level j is still the restricted rho. 
+		fmg_prolongate(U[j], U[j-1], FALSE);
+
+		// V-cycle loop
+		for(int jcycle = 0; jcycle < ncycle; jcycle++) {
+			// downward stoke of the V
+			for(int jj = j; jj >= 1; jj--) {
+				// pre-smoothing
+				for(int jpre = 0; jpre < NPRE; jpre++) {
+					fmg_relaxation(U[jj], RHS[jj]);
 				}
-				// bottom of V: solve on coarsest grid
-				fmg_solve(IU[0], IRHS[0]); 
-				nf = 3; 
-				// upward stroke of V.
-				for (jj = 1; jj <= j; jj++) { 
-					nf = 2*nf - 1;
-					// use res for temporary storage inside addint
-					fmg_addint(IU[jj], IU[jj-1], IRES[jj], nf);				
-					// post-smoothing
-					for (jpost = 0; jpost < NPOST; jpost++) {
-						fmg_relaxation(IU[jj], IRHS[jj], nf);
-					}
+				// restriction of the residual is the next r.h.s.
+				fmg_restrictResidual(RHS[jj-1], U[jj], RHS[jj]);
+				// zero for initial guess in next relaxation
+				fmg_fillArrayWithZeros(U[jj-1]);
+			}
+			// bottom of V: solve on coarsest grid
+			fmg_solve(U[0], RHS[0], ws.line);
+			// upward stroke of V.
+			for(int jj = 1; jj <= j; jj++) {
+				fmg_prolongate(U[jj], U[jj-1], TRUE);
+				// post-smoothing
+				for(int jpost = 0; jpost < NPOST; jpost++) {
+					fmg_relaxation(U[jj], RHS[jj]);
 				}
 			}
 		}
+	}
+}
 
-		// return solution in U
-		fmg_copyArray(U, IU[ngrid-1]);
-
-		// delete allocated arrays
-		_FREE_ARRAY_GRID_(IRES, ng);
-		_FREE_ARRAY_GRID_(IRHS, ng);
-		_FREE_ARRAY_GRID_(IU, ng);
-		_FREE_ARRAY_GRID_(IRHO, ng);
-
-		return TRUE;
-
-	} catch(int) {
-		// delete allocated arrays
-		_FREE_ARRAY_GRID_(IRES, ng);
-		_FREE_ARRAY_GRID_(IRHS, ng);
-		_FREE_ARRAY_GRID_(IU, ng);
-		_FREE_ARRAY_GRID_(IRHO, ng);
+/**
+Allocate a workspace for a nx x ny finest grid and ng levels. 
+The finest grid has mesh size h = 1 / (MAX(nx, ny) - 1) and the mesh size doubles on each coarser level. 
+@return Returns the allocated memory, to be released with free(), or NULL if the allocation failed
+*/
+static float* 
+fmg_allocateWorkspace(fmg_workspace& ws, int nx, int ny, int ng) {
+	// get the size of each level
+	size_t total = 0;
+	for(int j = ng - 1; j >= 0; j--) {
+		const int shift = ng - 1 - j;
+		ws.u[j].nx = ws.rhs[j].nx = ((nx - 1) >> shift) + 1;
+		ws.u[j].ny = ws.rhs[j].ny = ((ny - 1) >> shift) + 1;
+		ws.u[j].pitch = ws.rhs[j].pitch = ws.u[j].nx;
+		ws.u[j].h = ws.rhs[j].h = 1.0F / (MAX(ws.u[j].nx, ws.u[j].ny) - 1);
+		total += 2 * (size_t)ws.u[j].nx * ws.u[j].ny;
+	}
+	const size_t line_size = 2 * (size_t)MAX(ws.u[0].nx, ws.u[0].ny);
+	total += line_size;
+	if(total > ((size_t)-1) / sizeof(float)) {
+		return NULL;
+	}
 
-		return FALSE;
+	float *block = (float*)malloc(total * sizeof(float));
+	if(!block) {
+		return NULL;
+	}
+	ws.ng = ng;
+	float *p = block;
+	for(int j = ng - 1; j >= 0; j--) {
+		const size_t count = (size_t)ws.u[j].nx * ws.u[j].ny;
+		ws.u[j].bits = p;
+		p += count;
+		ws.rhs[j].bits = p;
+		p += count;
 	}
+	ws.line = p;
+
+	return block;
 }
 
 // --------------------------------------------------------------------------
@@ -456,42 +398,82 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 /**
 Poisson solver based on a multigrid algorithm. 
 This routine solves a Poisson equation, remap result pixels to [0..1] and returns the solution. 
-NB: The input image is first stored inside a square image whose size is (2^j + 1)x(2^j + 1) for some integer j, 
-where j is such that 2^j is the nearest larger dimension corresponding to MAX(image width, image height). 
-@param Laplacian Laplacian image
+NB: With FI_POISSON_DEFAULT, the input image is first stored inside a square image whose size is (2^j + 1)x(2^j + 1) 
+for some integer j, where j is such that 2^j is the nearest larger dimension corresponding to MAX(image width, image height). 
+With FI_POISSON_RECTANGULAR, the input image is stored inside a (2^j*cx + 1)x(2^j*cy + 1) image with a boundary 
+of at least one pixel, where MIN(cx, cy) = 2 : the grid is only padded to the next multiple of 2^j in each direction. 
+@param Laplacian Laplacian image (FIT_FLOAT)
 @param ncycle Number of cycles in the multigrid algorithm (usually 2 or 3)
+@param flags Grid options, FI_POISSON_DEFAULT or FI_POISSON_RECTANGULAR
 @return Returns the solved PDE equations if successful, returns NULL otherwise
 */
 FIBITMAP* DLL_CALLCONV 
-FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
-	if(!FreeImage_HasPixels(Laplacian)) return NULL;
-
-	int width = FreeImage_GetWidth(Laplacian);
-	int height = FreeImage_GetHeight(Laplacian);
-
-	// get nearest larger dimension length that is acceptable by the algorithm
-	int n = MAX(width, height);
-	int size = 0;
-	while((n >>= 1) > 0) size++;
-	if((1 << size) < MAX(width, height)) {
-		size++;
+FreeImage_MultigridPoissonSolverEx(FIBITMAP *Laplacian, int ncycle, unsigned flags) {
+	if(!FreeImage_HasPixels(Laplacian) || (FreeImage_GetImageType(Laplacian) != FIT_FLOAT)) return NULL;
+
+	const int width = FreeImage_GetWidth(Laplacian);
+	const int height = FreeImage_GetHeight(Laplacian);
+
+	int nx, ny, ng;
+
+	if((flags & FI_POISSON_RECTANGULAR) == FI_POISSON_RECTANGULAR) {
+		// get the number of levels such that the coarsest grid has 3 rows or 3 columns, 
+		// that is the largest 2^j < MIN(image width, image height) + 1
+		const int m = MIN(width, height) + 1;
+		int j = 0;
+		while((2 << j) < m) j++;
+		// pad each dimension to the next multiple of 2^j, keeping a boundary of at least one pixel
+		nx = (((width + (1 << j)) >> j) << j) + 1;
+		ny = (((height + (1 << j)) >> j) << j) + 1;
+		ng = j + 1;
+	} else {
+		// get nearest larger dimension length that is acceptable by the algorithm
+		int n = MAX(width, height);
+		int size = 0;
+		while((n >>= 1) > 0) size++;
+		if((1 << size) < MAX(width, height)) {
+			size++;
+		}
+		// the coarsest grid is 3x3
+		size = MAX(size, 1);
+		ng = size;
+		// size must be of the form 2^j + 1 for some integer j
+		nx = ny = 1 + (1 << size);
+	}
+	if(ng > NGMAX) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "Multigrid algorithm: ng = %d while NGMAX = %d, increase NGMAX.", ng, NGMAX);
+		return NULL;
 	}
-	// size must be of the form 2^j + 1 for some integer j
-	size = 1 + (1 << size);
 
-	// allocate a temporary square image I
-	FIBITMAP *I = FreeImage_AllocateT(FIT_FLOAT, size, size);
-	if(!I) return NULL;
+	fmg_workspace ws;
+	unique_mem block(fmg_allocateWorkspace(ws, nx, ny, ng));
+	if(!block) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, FI_MSG_ERROR_MEMORY);
+		return NULL;
+	}
 
-	// copy Laplacian into I and shift pixels to create a boundary
-	FreeImage_Paste(I, Laplacian, 1, 1, 255);
+	FIBITMAP *U = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	if(!U) return NULL;
+
+	// copy Laplacian into the finest r.h.s. and shift pixels to create a boundary 
+	// (the image top-left corner is at (1, 1), as with FreeImage_Paste)
+	const fmg_grid& RHS = ws.rhs[ng-1];
+	const fmg_grid& I = ws.u[ng-1];
+	const int row_offset = ny - 1 - height;
+	fmg_fillArrayWithZeros(RHS);
+	for(int y = 0; y < height; y++) {
+		memcpy(RHS.bits + (size_t)(row_offset + y) * RHS.pitch + 1, FreeImage_GetScanLine(Laplacian, y), width * sizeof(float));
+	}
 
 	// solve the PDE equation
-	fmg_mglin(I, size, ncycle);
+	fmg_mglin(ws, ncycle);
 
 	// shift pixels back
-	FIBITMAP *U = FreeImage_Copy(I, 1, 1, width + 1, height + 1);
-	FreeImage_Unload(I);
+	for(int y = 0; y < height; y++) {
+		memcpy(FreeImage_GetScanLine(U, y), I.bits + (size_t)(row_offset + y) * I.pitch + 1, width * sizeof(float));
+	}
+
+	block.reset();
 
 	// remap pixels to [0..1]
 	NormalizeY(U, 0, 1);
@@ -503,3 +485,11 @@ FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
 	return U;
 }
 
+/**
+Poisson solver based on a multigrid algorithm, using a square grid. 
+@see FreeImage_MultigridPoissonSolverEx
+*/
+FIBITMAP* DLL_CALLCONV 
+FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
+	return FreeImage_MultigridPoissonSolverEx(Laplacian, ncycle, FI_POISSON_DEFAULT);
+}
@@ -0,0 +1,791 @@
+// ==========================================================
+// Generic geometric transform (affine / perspective warp)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "Resize.h"
+#include "Parallel.h"
+
+/// Size of the square destination tiles evaluated by a thread
+#define WARP_TILE				64
+/// Minimum number of destination pixels worth a thread
+#define WARP_MIN_THREAD_PIXELS	0x8000
+/// Relative tolerance used to detect zero matrix coefficients
+#define WARP_EPSILON			1e-12
+/// Tolerance used to detect integer source coordinates
+#define WARP_INTEGER_EPSILON	1e-6
+/// Number of samples per pixel of the tabulated filters
+#define WARP_FILTER_RESOLUTION	1024
+/// Number of subpixel phases of the precomputed weights
+#define WARP_FILTER_PHASES		256
+
+// ----------------------------------------------------------
+//   Helpers
+// ----------------------------------------------------------
+
+/**
+Create the filter used for the interpolation
+@param filter Filter type
+@return Returns the filter, to be deleted by the caller, or NULL
+*/
+static CGenericFilter*
+CreateFilter(FREE_IMAGE_FILTER filter) {
+	switch(filter) {
+		case FILTER_BOX:
+			return new(std::nothrow) CBoxFilter();
+		case FILTER_BICUBIC:
+			return new(std::nothrow) CBicubicFilter();
+		case FILTER_BILINEAR:
+			return new(std::nothrow) CBilinearFilter();
+		case FILTER_BSPLINE:
+			return new(std::nothrow) CBSplineFilter();
+		case FILTER_CATMULLROM:
+			return new(std::nothrow) CCatmullRomFilter();
+		case FILTER_LANCZOS3:
+			return new(std::nothrow) CLanczos3Filter();
+	}
+	return NULL;
+}
+
+/**
+Invert a 3x3 matrix
+@param m Row major input matrix
+@param inv Row major inverse matrix
+@return Returns FALSE if the matrix is singular, returns TRUE otherwise
+*/
+static BOOL
+InvertMatrix(const double *m, double *inv) {
+	const double c0 = m[4] * m[8] - m[5] * m[7];
+	const double c1 = m[5] * m[6] - m[3] * m[8];
+	const double c2 = m[3] * m[7] - m[4] * m[6];
+	const double det = m[0] * c0 + m[1] * c1 + m[2] * c2;
+	if((det == 0) || (det != det)) {
+		return FALSE;
+	}
+	inv[0] = c0 / det;
+	inv[1] = (m[2] * m[7] - m[1] * m[8]) / det;
+	inv[2] = (m[1] * m[5] - m[2] * m[4]) / det;
+	inv[3] = c1 / det;
+	inv[4] = (m[0] * m[8] - m[2] * m[6]) / det;
+	inv[5] = (m[2] * m[3] - m[0] * m[5]) / det;
+	inv[6] = c2 / det;
+	inv[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+	inv[8] = (m[0] * m[4] - m[1] * m[3]) / det;
+	return TRUE;
+}
+
+/**
+Check whether a value is an integer in the range [0, max]
+@param value Value to check
+@param max Upper bound
+@param result Rounded value
+*/
+static BOOL
+IsIntegerInRange(double value, int max, int *result) {
+	const double rounded = floor(value + 0.5);
+	if((fabs(value - rounded) > WARP_INTEGER_EPSILON) || (rounded < 0) || (rounded > max)) {
+		return FALSE;
+	}
+	*result = (int)rounded;
+	return TRUE;
+}
+
+/**
+Filter impulse response, tabulated so that the per pixel weights do not need
+virtual calls. All the filters of the library are symmetric; the response is
+evaluated with a linear interpolation and is exact at integer and half-integer
+positions.<br>
+For unscaled samples away from the image edges, normalized weights are also
+precomputed for WARP_FILTER_PHASES subpixel positions.
+*/
+class CWarpFilter
+{
+private:
+	/// Samples of the response over [0, width]
+	std::vector<double> m_table;
+	/// Normalized weights of every phase
+	std::vector<double> m_phases;
+	/// Filter support
+	double m_dWidth;
+	/// Half the number of weights of a phase
+	int m_iRadius;
+
+public:
+	CWarpFilter(CGenericFilter *pFilter) : m_dWidth(pFilter->GetWidth()) {
+		const int size = (int)ceil(m_dWidth * WARP_FILTER_RESOLUTION) + 2;
+		m_table.resize(size);
+		for(int i = 0; i < size; i++) {
+			m_table[i] = pFilter->Filter((double)i / WARP_FILTER_RESOLUTION);
+		}
+		m_table[size - 1] = 0;
+
+		// the weights of a phase apply to the pixels [-radius + 1, radius] around
+		// the pixel preceding the sample
+		m_iRadius = (int)ceil(m_dWidth);
+		const int taps = 2 * m_iRadius;
+		m_phases.resize(WARP_FILTER_PHASES * taps);
+		for(int phase = 0; phase < WARP_FILTER_PHASES; phase++) {
+			const double offset = (double)phase / WARP_FILTER_PHASES;
+			double *weights = &m_phases[phase * taps];
+			double total = 0;
+			for(int k = 0; k < taps; k++) {
+				weights[k] = pFilter->Filter((double)(k - m_iRadius + 1) - offset);
+				total += weights[k];
+			}
+			if((total > 0) && (total != 1)) {
+				for(int k = 0; k < taps; k++) {
+					weights[k] /= total;
+				}
+			}
+		}
+	}
+
+	/// Returns the filter support
+	double GetWidth() const {
+		return m_dWidth;
+	}
+
+	/// Returns F(dVal) where F is the filter's impulse response
+	double Filter(double dVal) const {
+		dVal = fabs(dVal) * WARP_FILTER_RESOLUTION;
+		if(dVal >= (double)(m_table.size() - 1)) {
+			return 0;
+		}
+		const int i = (int)dVal;
+		const double *sample = &m_table[i];
+		return sample[0] + (dVal - i) * (sample[1] - sample[0]);
+	}
+
+	/// Returns half the number of precomputed weights of a phase
+	int GetRadius() const {
+		return m_iRadius;
+	}
+
+	/// Returns the normalized weights of a phase
+	const double* GetPhase(int phase) const {
+		return &m_phases[phase * 2 * m_iRadius];
+	}
+};
+
+/**
+floor() without the library call, for values in the int range
+*/
+static inline int
+FloorToInt(double value) {
+	const int i = (int)value;
+	return (i > value) ? (i - 1) : i;
+}
+
+/**
+Compute the normalized filter weights of a sample, the same way CWeightsTable does.
+@param filter Interpolation filter
+@param center Continuous source position of the sample
+@param scale Filter scale, less than 1 when minifying
+@param size Number of source pixels along the axis
+@param first Receives the index of the first contributing source pixel
+@param weights Receives the weights, must hold 2 * ceil(filter width / scale) + 1 values
+@return Returns the number of contributing source pixels
+*/
+static inline int
+ComputeWeights(const CWarpFilter &filter, double center, double scale, int size, int *first, double *weights) {
+	const double width = filter.GetWidth() / scale;
+	const int left = MAX(0, FloorToInt(center - width + 0.5));
+	const int right = MIN(FloorToInt(center + width + 0.5), size);
+
+	double total = 0;
+	for(int i = left; i < right; i++) {
+		const double weight = scale * filter.Filter(scale * ((double)i + 0.5 - center));
+		weights[i - left] = weight;
+		total += weight;
+	}
+	if((total > 0) && (total != 1)) {
+		const double normalize = 1 / total;
+		for(int i = left; i < right; i++) {
+			weights[i - left] *= normalize;
+		}
+	}
+
+	*first = left;
+	return MAX(0, right - left);
+}
+
+/**
+Get the weights of a sample, from the precomputed phases when possible
+@param filter Interpolation filter
+@param center Continuous source position of the sample
+@param scale Filter scale, less than 1 when minifying
+@param size Number of source pixels along the axis
+@param first Receives the index of the first contributing source pixel
+@param buffer Buffer used when the weights need to be computed
+@param weights Receives a pointer to the weights
+@return Returns the number of contributing source pixels
+*/
+static inline int
+SampleWeights(const CWarpFilter &filter, double center, double scale, int size, int *first, double *buffer, const double **weights) {
+	if(scale == 1) {
+		const double position = center - 0.5;
+		int pixel = FloorToInt(position);
+		int phase = (int)((position - pixel) * WARP_FILTER_PHASES + 0.5);
+		if(phase == WARP_FILTER_PHASES) {
+			pixel++;
+			phase = 0;
+		}
+		const int radius = filter.GetRadius();
+		if((pixel - radius + 1 >= 0) && (pixel + radius < size)) {
+			*first = pixel - radius + 1;
+			*weights = filter.GetPhase(phase);
+			return 2 * radius;
+		}
+	}
+	*weights = buffer;
+	return ComputeWeights(filter, center, scale, size, first, buffer);
+}
+
+/**
+Get the filter scale for a source axis, given how far a source coordinate moves
+when stepping one destination pixel horizontally (dX) and vertically (dY)
+*/
+static inline double
+FootprintScale(double dX, double dY) {
+	const double footprint = sqrt(dX * dX + dY * dY);
+	return (footprint > 1) ? (1 / footprint) : 1;
+}
+
+/**
+Get the number of weights needed by ComputeWeights
+*/
+static inline size_t
+MaxWeights(const CWarpFilter &filter, double scale) {
+	return 2 * (size_t)ceil(filter.GetWidth() / scale) + 1;
+}
+
+static inline void
+StoreSample(double value, BYTE *dst) {
+	*dst = (BYTE)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
+}
+
+static inline void
+StoreSample(double value, WORD *dst) {
+	*dst = (WORD)CLAMP<int>((int)(value + 0.5), 0, 0xFFFF);
+}
+
+static inline void
+StoreSample(double value, float *dst) {
+	*dst = (float)value;
+}
+
+/**
+Filter one destination pixel from a window of source pixels
+@param top Pointer to the top source scanline
+@param pitch Distance in bytes from one source scanline to the next one below
+@param x0 First source column
+@param nx Number of source columns
+@param wx Column weights
+@param y0 First source row, counted from the top
+@param ny Number of source rows
+@param wy Row weights
+@param dst Destination pixel
+*/
+template <class T, unsigned CH> static inline void
+FilterPixel(const BYTE *top, ptrdiff_t pitch, int x0, int nx, const double *wx, int y0, int ny, const double *wy, T *dst) {
+	double value[CH];
+	for(unsigned c = 0; c < CH; c++) {
+		value[c] = 0;
+	}
+	for(int j = 0; j < ny; j++) {
+		const T *pixel = reinterpret_cast<const T*>(top + (y0 + j) * pitch) + x0 * CH;
+		double row[CH];
+		for(unsigned c = 0; c < CH; c++) {
+			row[c] = 0;
+		}
+		for(int i = 0; i < nx; i++, pixel += CH) {
+			const double weight = wx[i];
+			for(unsigned c = 0; c < CH; c++) {
+				row[c] += weight * (double)pixel[c];
+			}
+		}
+		const double weight = wy[j];
+		for(unsigned c = 0; c < CH; c++) {
+			value[c] += weight * row[c];
+		}
+	}
+	for(unsigned c = 0; c < CH; c++) {
+		StoreSample(value[c], &dst[c]);
+	}
+}
+
+// ----------------------------------------------------------
+//   Generic path
+// ----------------------------------------------------------
+
+/**
+Contributions of the source pixels to a destination row or column,
+used when the mapping is axis-aligned
+*/
+typedef struct tagWarpContribution {
+	/// First contributing source pixel, -1 if the sample lies outside the source
+	int first;
+	/// Number of contributing source pixels
+	int count;
+	/// Offset of the weights in the weights array
+	size_t offset;
+} WarpContribution;
+
+/**
+Compute the contributions of a source axis to a destination axis mapped by x = a * X + b
+*/
+static void
+ComputeContributions(const CWarpFilter &filter, double a, double b, int src_size, int dst_size, std::vector<WarpContribution> &contributions, std::vector<double> &weights) {
+	const double scale = FootprintScale(a, 0);
+	const size_t window = MaxWeights(filter, scale);
+
+	contributions.resize(dst_size);
+	weights.resize(dst_size * window);
+
+	for(int u = 0; u < dst_size; u++) {
+		WarpContribution &contribution = contributions[u];
+		const double center = a * ((double)u + 0.5) + b;
+		contribution.offset = u * window;
+		if((center >= 0) && (center < src_size)) {
+			contribution.count = ComputeWeights(filter, center, scale, src_size, &contribution.first, &weights[contribution.offset]);
+		} else {
+			contribution.first = -1;
+			contribution.count = 0;
+		}
+	}
+}
+
+/**
+Inverse mapping of every destination pixel.
+Axis-aligned mappings are filtered separably with per row and per column weights,
+other mappings are evaluated in tiles, with the filter footprint adapted to the local
+scale of each tile.
+@param src Source image
+@param dst Destination image
+@param N Row major matrix mapping destination to source coordinates, with N[8] == 1 when affine
+@param filter Interpolation filter
+@param bkcolor Background color, or NULL for zero
+*/
+template <class T, unsigned CH> static void
+WarpT(FIBITMAP *src, FIBITMAP *dst, const double *N, const CWarpFilter &filter, const void *bkcolor) {
+	const int src_width = (int)FreeImage_GetWidth(src);
+	const int src_height = (int)FreeImage_GetHeight(src);
+	const int dst_width = (int)FreeImage_GetWidth(dst);
+	const int dst_height = (int)FreeImage_GetHeight(dst);
+
+	// FreeImage bitmaps are stored upside down, address them from the top scanline
+	const BYTE *src_top = FreeImage_GetScanLine(src, src_height - 1);
+	const ptrdiff_t src_pitch = -(ptrdiff_t)FreeImage_GetPitch(src);
+	BYTE *dst_top = FreeImage_GetScanLine(dst, dst_height - 1);
+	const ptrdiff_t dst_pitch = -(ptrdiff_t)FreeImage_GetPitch(dst);
+
+	T background[CH];
+	if(bkcolor) {
+		memcpy(background, bkcolor, sizeof(background));
+	} else {
+		memset(background, 0, sizeof(background));
+	}
+
+	const unsigned threads = FreeImage_GetThreadCount((size_t)dst_width * dst_height, WARP_MIN_THREAD_PIXELS);
+
+	const BOOL bAffine = (N[6] == 0) && (N[7] == 0);
+
+	if(bAffine && (N[1] == 0) && (N[3] == 0)) {
+		// axis-aligned mapping: the weights only depend on the column and on the row,
+		// filter separably, one chunk of destination rows at a time
+		std::vector<WarpContribution> columns, rows;
+		std::vector<double> column_weights, row_weights;
+		ComputeContributions(filter, N[0], N[2], src_width, dst_width, columns, column_weights);
+		ComputeContributions(filter, N[4], N[5], src_height, dst_height, rows, row_weights);
+
+		const int chunk = MAX(1, (int)(WARP_TILE / MAX(1.0, fabs(N[4]))));
+		const size_t line = (size_t)dst_width * CH;
+
+		FreeImage_ParallelFor(0, (unsigned)dst_height, threads, [&](unsigned y_begin, unsigned y_end, unsigned) {
+			// horizontally filtered source rows of the current chunk
+			std::vector<double> filtered;
+			std::vector<double> value(line);
+
+			for(int chunk_begin = (int)y_begin; chunk_begin < (int)y_end; chunk_begin += chunk) {
+				const int chunk_end = MIN(chunk_begin + chunk, (int)y_end);
+
+				// source rows used by the chunk
+				int first_row = src_height, last_row = 0;
+				for(int y = chunk_begin; y < chunk_end; y++) {
+					if(rows[y].first >= 0) {
+						first_row = MIN(first_row, rows[y].first);
+						last_row = MAX(last_row, rows[y].first + rows[y].count);
+					}
+				}
+
+				// horizontal pass
+				if(first_row < last_row) {
+					filtered.resize((size_t)(last_row - first_row) * line);
+				}
+				for(int r = first_row; r < last_row; r++) {
+					const T *src_bits = reinterpret_cast<const T*>(src_top + (ptrdiff_t)r * src_pitch);
+					double *row_bits = &filtered[(size_t)(r - first_row) * line];
+					for(int x = 0; x < dst_width; x++, row_bits += CH) {
+						const WarpContribution &column = columns[x];
+						if(column.first < 0) {
+							continue;
+						}
+						const T *pixel = src_bits + column.first * CH;
+						const double *weights = &column_weights[column.offset];
+						double sum[CH];
+						for(unsigned c = 0; c < CH; c++) {
+							sum[c] = 0;
+						}
+						for(int i = 0; i < column.count; i++, pixel += CH) {
+							for(unsigned c = 0; c < CH; c++) {
+								sum[c] += weights[i] * (double)pixel[c];
+							}
+						}
+						for(unsigned c = 0; c < CH; c++) {
+							row_bits[c] = sum[c];
+						}
+					}
+				}
+
+				// vertical pass
+				for(int y = chunk_begin; y < chunk_end; y++) {
+					T *dst_bits = reinterpret_cast<T*>(dst_top + (ptrdiff_t)y * dst_pitch);
+					const WarpContribution &row = rows[y];
+					if(row.first < 0) {
+						for(int x = 0; x < dst_width; x++) {
+							memcpy(dst_bits + x * CH, background, sizeof(background));
+						}
+						continue;
+					}
+					std::fill(value.begin(), value.end(), 0.0);
+					const double *weights = &row_weights[row.offset];
+					for(int j = 0; j < row.count; j++) {
+						const double *row_bits = &filtered[(size_t)(row.first + j - first_row) * line];
+						const double weight = weights[j];
+						for(size_t k = 0; k < line; k++) {
+							value[k] += weight * row_bits[k];
+						}
+					}
+					for(int x = 0; x < dst_width; x++, dst_bits += CH) {
+						if(columns[x].first < 0) {
+							memcpy(dst_bits, background, sizeof(background));
+						} else {
+							for(unsigned c = 0; c < CH; c++) {
+								StoreSample(value[x * CH + c], &dst_bits[c]);
+							}
+						}
+					}
+				}
+			}
+		});
+		return;
+	}
+
+	const unsigned tiles_x = (dst_width + WARP_TILE - 1) / WARP_TILE;
+	const unsigned tiles_y = (dst_height + WARP_TILE - 1) / WARP_TILE;
+
+	FreeImage_ParallelFor(0, tiles_x * tiles_y, threads, [&](unsigned tile_begin, unsigned tile_end, unsigned) {
+		std::vector<double> wx, wy;
+
+		for(unsigned tile = tile_begin; tile < tile_end; tile++) {
+			const int x_begin = (tile % tiles_x) * WARP_TILE;
+			const int y_begin = (tile / tiles_x) * WARP_TILE;
+			const int x_end = MIN(x_begin + WARP_TILE, dst_width);
+			const int y_end = MIN(y_begin + WARP_TILE, dst_height);
+
+			// local scale of the mapping at the center of the tile
+			double scale_x = 1, scale_y = 1;
+			{
+				const double X = 0.5 * (x_begin + x_end);
+				const double Y = 0.5 * (y_begin + y_end);
+				const double px = N[0] * X + N[1] * Y + N[2];
+				const double py = N[3] * X + N[4] * Y + N[5];
+				const double pw = N[6] * X + N[7] * Y + N[8];
+				if(pw > 0) {
+					const double w2 = pw * pw;
+					scale_x = FootprintScale((N[0] * pw - px * N[6]) / w2, (N[1] * pw - px * N[7]) / w2);
+					scale_y = FootprintScale((N[3] * pw - py * N[6]) / w2, (N[4] * pw - py * N[7]) / w2);
+				}
+			}
+			wx.resize(MaxWeights(filter, scale_x));
+			wy.resize(MaxWeights(filter, scale_y));
+
+			for(int y = y_begin; y < y_end; y++) {
+				T *dst_bits = reinterpret_cast<T*>(dst_top + (ptrdiff_t)y * dst_pitch) + x_begin * CH;
+				const double Y = (double)y + 0.5;
+				for(int x = x_begin; x < x_end; x++, dst_bits += CH) {
+					const double X = (double)x + 0.5;
+					const double pw = N[6] * X + N[7] * Y + N[8];
+					const double sx = (N[0] * X + N[1] * Y + N[2]) / pw;
+					const double sy = (N[3] * X + N[4] * Y + N[5]) / pw;
+					// the negated test also rejects NaN coordinates
+					if(!((pw > 0) && (sx >= 0) && (sx < src_width) && (sy >= 0) && (sy < src_height))) {
+						memcpy(dst_bits, background, sizeof(background));
+						continue;
+					}
+					int x0, y0;
+					const double *weights_x, *weights_y;
+					const int nx = SampleWeights(filter, sx, scale_x, src_width, &x0, &wx[0], &weights_x);
+					const int ny = SampleWeights(filter, sy, scale_y, src_height, &y0, &wy[0], &weights_y);
+					FilterPixel<T, CH>(src_top, src_pitch, x0, nx, weights_x, y0, ny, weights_y, dst_bits);
+				}
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------
+//   Separable and transpose fast path
+// ----------------------------------------------------------
+
+/**
+Try to perform the warp as a rescale of a source rectangle, followed by
+right-angle rotations and flips. This applies when the matrix is a scaling,
+possibly combined with a transposition and with mirroring, that maps an integer
+source rectangle onto the whole destination image.
+@param src Source image
+@param dst_width Destination width
+@param dst_height Destination height
+@param N Row major affine matrix mapping destination to source coordinates, with N[8] == 1
+@param pFilter Interpolation filter
+@param dst Receives the warped image, or NULL if an allocation failed
+@return Returns FALSE if the fast path does not apply, returns TRUE otherwise
+*/
+static BOOL
+WarpSeparable(FIBITMAP *src, int dst_width, int dst_height, const double *N, CGenericFilter *pFilter, FIBITMAP **dst) {
+	const double tolerance = WARP_EPSILON * (fabs(N[0]) + fabs(N[1]) + fabs(N[3]) + fabs(N[4]));
+
+	// source coordinates of the destination edges, and orientation of the result
+	BOOL bTranspose;
+	double x_edges[2], y_edges[2];
+	BOOL bFlipX, bFlipY;
+	if((fabs(N[1]) <= tolerance) && (fabs(N[3]) <= tolerance)) {
+		bTranspose = FALSE;
+		x_edges[0] = N[2];
+		x_edges[1] = N[0] * dst_width + N[2];
+		y_edges[0] = N[5];
+		y_edges[1] = N[4] * dst_height + N[5];
+		bFlipX = (N[0] < 0);
+		bFlipY = (N[4] < 0);
+	} else if((fabs(N[0]) <= tolerance) && (fabs(N[4]) <= tolerance)) {
+		bTranspose = TRUE;
+		x_edges[0] = N[2];
+		x_edges[1] = N[1] * dst_height + N[2];
+		y_edges[0] = N[5];
+		y_edges[1] = N[3] * dst_width + N[5];
+		bFlipX = (N[3] < 0);
+		bFlipY = (N[1] < 0);
+	} else {
+		return FALSE;
+	}
+
+	int left, right, top, bottom;
+	if(!IsIntegerInRange(MIN(x_edges[0], x_edges[1]), FreeImage_GetWidth(src), &left)
+		|| !IsIntegerInRange(MAX(x_edges[0], x_edges[1]), FreeImage_GetWidth(src), &right)
+		|| !IsIntegerInRange(MIN(y_edges[0], y_edges[1]), FreeImage_GetHeight(src), &top)
+		|| !IsIntegerInRange(MAX(y_edges[0], y_edges[1]), FreeImage_GetHeight(src), &bottom)
+		|| (left == right) || (top == bottom)) {
+		return FALSE;
+	}
+
+	// rescale the source rectangle, in source orientation
+	CResizeEngine Engine(pFilter);
+	FIBITMAP *scaled = bTranspose
+		? Engine.scale(src, dst_height, dst_width, left, top, right - left, bottom - top, FI_RESCALE_DEFAULT)
+		: Engine.scale(src, dst_width, dst_height, left, top, right - left, bottom - top, FI_RESCALE_DEFAULT);
+	if(!scaled) {
+		*dst = NULL;
+		return TRUE;
+	}
+
+	if(bTranspose) {
+		// a transposition is a 90 degree rotation followed by a vertical flip
+		FIBITMAP *rotated = FreeImage_Rotate(scaled, 90);
+		FreeImage_Unload(scaled);
+		if(!rotated) {
+			*dst = NULL;
+			return TRUE;
+		}
+		scaled = rotated;
+		bFlipY = !bFlipY;
+	}
+	if(bFlipX) {
+		FreeImage_FlipHorizontal(scaled);
+	}
+	if(bFlipY) {
+		FreeImage_FlipVertical(scaled);
+	}
+
+	*dst = scaled;
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+//   Main function
+// ----------------------------------------------------------
+
+/**
+Apply a projective transform to an image.<br>
+Coordinates are continuous, with (0, 0) at the top-left corner of the top-left pixel
+and y pointing down, so that the center of pixel (x, y) is (x + 0.5, y + 0.5).
+Every destination pixel is mapped back to the source image and filtered from its
+neighborhood; when minifying, the filter footprint grows with the local scale of the
+mapping. Destination pixels falling outside the source image are set to bkcolor.<br>
+Scalings combined with right-angle rotations and mirroring that map an integer source
+rectangle onto the whole destination are performed by the separable resize engine
+and by block transposes, unless FI_WARP_NO_SEPARABLE is set. Like FreeImage_RescaleRect,
+this path only reads the pixels of that source rectangle.
+@param dib Source image
+@param dst_width Destination width
+@param dst_height Destination height
+@param matrix Row major 3x3 matrix mapping homogeneous source coordinates to destination
+coordinates (or destination to source coordinates when FI_WARP_INVERSE is set)
+@param filter Interpolation filter
+@param bkcolor Background color, its type must match the destination image type
+(RGBQUAD for 24- and 32-bit images, BYTE for 8-bit images, ...). NULL means zero.
+@param flags FI_WARP_xxx options
+@return Returns the warped image if successful, returns NULL otherwise.
+Palettized images are converted to 24- or 32-bit (8-bit for greyscale images).
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_Warp(FIBITMAP *dib, int dst_width, int dst_height, const double *matrix, FREE_IMAGE_FILTER filter, const void *bkcolor, unsigned flags) {
+	if(!FreeImage_HasPixels(dib) || !matrix || (dst_width <= 0) || (dst_height <= 0)) {
+		return NULL;
+	}
+
+	// matrix mapping destination to source coordinates
+	double N[9];
+	if((flags & FI_WARP_INVERSE) == FI_WARP_INVERSE) {
+		memcpy(N, matrix, sizeof(N));
+	} else if(!InvertMatrix(matrix, N)) {
+		return NULL;
+	}
+	if((N[6] == 0) && (N[7] == 0)) {
+		// affine mapping
+		if(N[8] == 0) {
+			return NULL;
+		}
+		for(int i = 0; i < 9; i++) {
+			N[i] /= N[8];
+		}
+	}
+
+	// images are processed as greyscale, RGB(A) or one of the high precision types
+	FIBITMAP *src = dib;
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	switch(image_type) {
+		case FIT_BITMAP:
+		{
+			const unsigned bpp = FreeImage_GetBPP(dib);
+			if((bpp == 24) || (bpp == 32)) {
+				break;
+			}
+			if(FreeImage_IsTransparent(dib)) {
+				src = FreeImage_ConvertTo32Bits(dib);
+			} else if((bpp <= 8) && (FreeImage_GetColorType(dib) == FIC_MINISBLACK)) {
+				src = (bpp == 8) ? dib : FreeImage_ConvertToGreyscale(dib);
+			} else if((bpp <= 8) && (FreeImage_GetColorType(dib) == FIC_MINISWHITE)) {
+				src = FreeImage_ConvertToGreyscale(dib);
+			} else {
+				src = FreeImage_ConvertTo24Bits(dib);
+			}
+			if(!src) {
+				return NULL;
+			}
+		}
+		break;
+
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			break;
+
+		default:
+			return NULL;
+	}
+
+	CGenericFilter *pFilter = CreateFilter(filter);
+	if(!pFilter) {
+		if(src != dib) {
+			FreeImage_Unload(src);
+		}
+		return NULL;
+	}
+
+	FIBITMAP *dst = NULL;
+
+	const BOOL bAffine = (N[6] == 0) && (N[7] == 0);
+	if(!bAffine || ((flags & FI_WARP_NO_SEPARABLE) == FI_WARP_NO_SEPARABLE) || !WarpSeparable(src, dst_width, dst_height, N, pFilter, &dst)) {
+		const unsigned bpp = FreeImage_GetBPP(src);
+		dst = FreeImage_AllocateT(image_type, dst_width, dst_height, bpp);
+		if(dst) {
+			const CWarpFilter table(pFilter);
+			switch(image_type) {
+				case FIT_BITMAP:
+					switch(bpp) {
+						case 8:
+							WarpT<BYTE, 1>(src, dst, N, table, bkcolor);
+							break;
+						case 24:
+							WarpT<BYTE, 3>(src, dst, N, table, bkcolor);
+							break;
+						case 32:
+							WarpT<BYTE, 4>(src, dst, N, table, bkcolor);
+							break;
+						default:
+							break;
+					}
+					break;
+				case FIT_UINT16:
+					WarpT<WORD, 1>(src, dst, N, table, bkcolor);
+					break;
+				case FIT_RGB16:
+					WarpT<WORD, 3>(src, dst, N, table, bkcolor);
+					break;
+				case FIT_RGBA16:
+					WarpT<WORD, 4>(src, dst, N, table, bkcolor);
+					break;
+				case FIT_FLOAT:
+					WarpT<float, 1>(src, dst, N, table, bkcolor);
+					break;
+				case FIT_RGBF:
+					WarpT<float, 3>(src, dst, N, table, bkcolor);
+					break;
+				case FIT_RGBAF:
+					WarpT<float, 4>(src, dst, N, table, bkcolor);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	delete pFilter;
+
+	if(src != dib) {
+		FreeImage_Unload(src);
+	}
+
+	if(dst && ((flags & FI_WARP_OMIT_METADATA) != FI_WARP_OMIT_METADATA)) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+	}
+
+	return dst;
+}
@@ -351,3 +351,37 @@ FreeImage_GetTagMemorySize(FITAG *tag) {
 	}
 	return size;
 }
+
+BOOL 
+SetMetadataTag(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, WORD id, FREE_IMAGE_MDTYPE type, DWORD count, DWORD length, const void *value) {
+	BOOL bResult = FALSE;
+	FITAG *tag = FreeImage_CreateTag();
+	if(tag) {
+		FreeImage_SetTagKey(tag, key);
+		FreeImage_SetTagID(tag, id);
+		FreeImage_SetTagType(tag, type);
+		FreeImage_SetTagCount(tag, count);
+		FreeImage_SetTagLength(tag, length);
+		FreeImage_SetTagValue(tag, value);
+		if(model == FIMD_ANIMATION) {
+			TagLib& s = TagLib::instance();
+			// get the tag description
+			const char *description = s.getTagDescription(TagLib::ANIMATION, id);
+			FreeImage_SetTagDescription(tag, description);
+		}
+		// store the tag
+		bResult = FreeImage_SetMetadata(model, dib, key, tag);
+		FreeImage_DeleteTag(tag);
+	}
+	return bResult;
+}
+
+BOOL 
+GetMetadataTag(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag) {
+	if( FreeImage_GetMetadata(model, dib, key, tag) ) {
+		if( FreeImage_GetTagType(*tag) == type ) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
@@ -309,6 +309,32 @@ Calculate the memory size required by a tag, including the size of the structure
 */
 size_t FreeImage_GetTagMemorySize(FITAG *tag);
 
+/**
+Create a tag from its fields and attach it to a bitmap. 
+Tags of the FIMD_ANIMATION model get the description of their ID.
+@param model Metadata model
+@param dib Bitmap to attach the tag to
+@param key Tag field name
+@param id Tag ID
+@param type Tag data type
+@param count Number of components
+@param length Length of the value, in bytes
+@param value Tag value
+@return Returns TRUE if successful, FALSE otherwise
+*/
+BOOL SetMetadataTag(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, WORD id, FREE_IMAGE_MDTYPE type, DWORD count, DWORD length, const void *value);
+
+/**
+Retrieve a tag of a given data type attached to a bitmap
+@param model Metadata model
+@param dib Bitmap to query
+@param key Tag field name
+@param type Expected tag data type
+@param tag Returned tag
+@return Returns TRUE if the tag exists and has the expected type, FALSE otherwise
+*/
+BOOL GetMetadataTag(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag);
+
 // --------------------------------------------------------------------------
 
 /**
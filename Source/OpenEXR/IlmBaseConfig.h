@@ -5,7 +5,7 @@ and you want IlmBase to use it for multithreaded file I/O.
 #if defined(_MSC_VER) || defined(__MINGW32__)
 #undef HAVE_PTHREAD
 #else
-#undef HAVE_PTHREAD
+#define HAVE_PTHREAD 1
 #endif
 
 /**
@@ -13,10 +13,10 @@ Define and set to 1 if the target system supports POSIX semaphores
 and you want OpenEXR to use them; otherwise, OpenEXR will use its
 own semaphore implementation.
 */
-#if defined(_MSC_VER) || defined(__MINGW32__)
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__APPLE__)
 #undef HAVE_POSIX_SEMAPHORES
 #else
-#undef HAVE_POSIX_SEMAPHORES
+#define HAVE_POSIX_SEMAPHORES 1
 #endif
 
 /**
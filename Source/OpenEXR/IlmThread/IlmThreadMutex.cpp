@@ -41,7 +41,7 @@
 
 #include "IlmBaseConfig.h"
 
-//#if !defined (_WIN32) && !(_WIN64) && !(HAVE_PTHREAD)
+#if !defined (_WIN32) && !(_WIN64) && !(HAVE_PTHREAD)
 
 #include "IlmThreadMutex.h"
 
@@ -56,4 +56,4 @@ void Mutex::unlock () const {}
 
 ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_EXIT
 
-//#endif
+#endif
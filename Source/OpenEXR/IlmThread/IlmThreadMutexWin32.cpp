@@ -38,6 +38,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#if defined _WIN32 || defined _WIN64
+
 #include "IlmThreadMutex.h"
 #include "Iex.h"
 
@@ -71,3 +73,5 @@ Mutex::unlock () const
 
 
 ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_EXIT
+
+#endif
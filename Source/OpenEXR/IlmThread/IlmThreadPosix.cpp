@@ -63,10 +63,11 @@ supportsThreads ()
 
 namespace {
 
-void
+void *
 threadLoop (void * t)
 {
-    return (reinterpret_cast<Thread*>(t))->run();
+    (reinterpret_cast<Thread*>(t))->run();
+    return 0;
 }
 
 } // namespace
@@ -82,13 +83,14 @@ Thread::~Thread ()
 {
     int error = ::pthread_join (_thread, 0);
     assert (error == 0);
+    (void) error;
 }
 
 
 void
 Thread::start ()
 {
-    if (int error = ::pthread_create (&_thread, 0, Start (threadLoop), this))
+    if (int error = ::pthread_create (&_thread, 0, threadLoop, this))
 	IEX_NAMESPACE::throwErrnoExc ("Cannot create new thread (%T).", error);
 }
 
@@ -62,6 +62,7 @@ Semaphore::~Semaphore ()
 {
     int error = ::sem_destroy (&_semaphore);
     assert (error == 0);
+    (void) error;
 }
 
 
@@ -39,6 +39,8 @@
 //-----------------------------------------------------------------------------
 
 
+#if defined _WIN32 || defined _WIN64
+
 #include "IlmThread.h"
 #include "Iex.h"
 #include <iostream>
@@ -93,3 +95,5 @@ Thread::start ()
 
 
 ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_EXIT
+
+#endif
@@ -0,0 +1,100 @@
+// ==========================================================
+// Multithreading helpers
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_PARALLEL_H
+#define FREEIMAGE_PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+/**
+Upper limit for the number of threads used by a single FreeImage call.
+0 means "use all hardware threads", 1 disables multithreading.
+*/
+#ifndef FREEIMAGE_MAX_THREADS
+#define FREEIMAGE_MAX_THREADS 0
+#endif
+
+/**
+Get the number of threads worth using for a job.
+@param work Total amount of work, in arbitrary units (pixels, bytes, ...)
+@param min_work Minimum amount of work a thread should get to be worth starting
+@return Returns a thread count in the range [1, hardware threads]
+*/
+inline unsigned
+FreeImage_GetThreadCount(size_t work, size_t min_work) {
+	unsigned threads = std::thread::hardware_concurrency();
+#if FREEIMAGE_MAX_THREADS > 0
+	if(threads > FREEIMAGE_MAX_THREADS) {
+		threads = FREEIMAGE_MAX_THREADS;
+	}
+#endif
+	const size_t bands = min_work ? (work / min_work) : work;
+	if(bands < threads) {
+		threads = (unsigned)bands;
+	}
+	return threads ? threads : 1;
+}
+
+/**
+Split the range [begin, end) into contiguous bands and process them concurrently.
+The last band is processed by the calling thread. If a worker thread cannot be
+started, its band is processed by the calling thread as well.
+@param begin First index of the range
+@param end One past the last index of the range
+@param threads Number of bands, usually the result of FreeImage_GetThreadCount
+@param fn Band processor, called as fn(unsigned band_begin, unsigned band_end, unsigned band_index).
+Must not throw.
+*/
+template <class Fn> void
+FreeImage_ParallelFor(unsigned begin, unsigned end, unsigned threads, Fn fn) {
+	const unsigned count = (end > begin) ? (end - begin) : 0;
+	if(threads > count) {
+		threads = count;
+	}
+	if(threads <= 1) {
+		if(count) {
+			fn(begin, end, 0U);
+		}
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+
+	unsigned band_begin = begin;
+	for(unsigned i = 0; i < threads; i++) {
+		const unsigned band_end = begin + (unsigned)(((unsigned long long)count * (i + 1)) / threads);
+		if(i == threads - 1) {
+			fn(band_begin, band_end, i);
+		} else {
+			try {
+				workers.push_back(std::thread(fn, band_begin, band_end, i));
+			} catch(...) {
+				fn(band_begin, band_end, i);
+			}
+		}
+		band_begin = band_end;
+	}
+
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+#endif // FREEIMAGE_PARALLEL_H
@@ -99,6 +99,7 @@ int FreeImage_stricmp(const char *s1, const char *s2);
 extern "C" {
 	BOOL DLL_CALLCONV FreeImage_ValidateFIF(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle);
     void * DLL_CALLCONV FreeImage_Open(PluginNode *node, FreeImageIO *io, fi_handle handle, BOOL open_for_reading);
+    void * DLL_CALLCONV FreeImage_OpenAppend(PluginNode *node, FreeImageIO *io, fi_handle handle); // plugin.cpp
     void DLL_CALLCONV FreeImage_Close(PluginNode *node, FreeImageIO *io, fi_handle handle, void *data); // plugin.cpp
     PluginList * DLL_CALLCONV FreeImage_GetPluginList(); // plugin.cpp
 }
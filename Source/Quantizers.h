@@ -168,9 +168,6 @@ protected:
 	/// the network itself
 	pixel *network;
 
-	/// for network lookup - really 256
-	int netindex[256];
-
 	/// bias array for learning
 	int *bias;
 	/// freq array for learning
@@ -186,12 +183,6 @@ protected:
 	/// Unbias network to give byte values 0..255 and record position i to prepare for sort
 	void unbiasnet();
 
-	/// Insertion sort of network and building of netindex[0..255] (to do after unbias)
-	void inxbuild();
-
-	/// Search for BGR values 0..255 (after net is unbiased) and return colour index
-	int inxsearch(int b, int g, int r);
-
 	/// Search for biased BGR values
 	int contest(int b, int g, int r);
 	
@@ -356,4 +347,76 @@ protected:
 
 };
 
+/**
+  Nearest colour lookup against an arbitrary palette.
+
+  Colours are matched by squared euclidean distance in RGB space, ties resolve
+  to the lowest palette index. The RGB cube is split into 16x16x16 cells and each
+  cell caches the list of palette entries that can be the nearest one for a colour
+  inside the cell, so that a lookup only tests a handful of entries (4 at a time
+  with SSE2) instead of the whole palette.
+
+  The mapper is read-only once constructed and may be shared by several threads.
+*/
+class PaletteMapper {
+public:
+	/**
+	Constructor
+	@param palette Palette to map to
+	@param size Number of palette entries, in range [1..256]
+	@throw FI_MSG_ERROR_MEMORY if the cell tables cannot be allocated
+	*/
+	PaletteMapper(const RGBQUAD *palette, unsigned size);
+
+	/** Destructor */
+	~PaletteMapper();
+
+	/**
+	Returns the index of the palette entry nearest to a colour
+	@param red Red component, in range [0..255]
+	@param green Green component, in range [0..255]
+	@param blue Blue component, in range [0..255]
+	*/
+	BYTE GetIndex(int red, int green, int blue) const;
+
+	/**
+	Maps a 24- or 32-bit scanline to palette indices
+	@param target Output 8-bit scanline
+	@param source Input scanline
+	@param width Number of pixels
+	@param bytespp Bytes per input pixel, 3 or 4
+	*/
+	void MapLine(BYTE *target, const BYTE *source, unsigned width, unsigned bytespp) const;
+
+protected:
+	/** Number of low order bits of a component ignored by the cell index */
+	static const unsigned CELL_SHIFT = 4;
+
+	/** Number of cells per component */
+	static const unsigned CELL_SIDE = 256 >> CELL_SHIFT;
+
+	/** Total number of cells */
+	static const unsigned CELL_COUNT = CELL_SIDE * CELL_SIDE * CELL_SIDE;
+
+	/**
+	Four palette entries, laid out for a SSE2 distance computation
+	(pairs of 16-bit components are multiplied and added with pmaddwd).
+	Incomplete groups are padded with copies of their last entry.
+	*/
+	typedef struct tagCandidateGroup {
+		short rg[8];	// r0 g0 r1 g1 r2 g2 r3 g3
+		short b[8];		// b0 0 b1 0 b2 0 b3 0
+		int index[4];	// palette indices
+	} CandidateGroup;
+
+	/** Candidate groups of all cells, stored one cell after the other */
+	CandidateGroup *m_groups;
+
+	/** First group of each cell, CELL_COUNT + 1 entries */
+	unsigned *m_first;
+
+	/** Palette index of cells with a single candidate, -1 for the other cells */
+	short *m_single;
+};
+
 #endif // FREEIMAGE_QUANTIZER_H
@@ -26,6 +26,9 @@
 extern "C" {
 #endif
 
+extern const float RGB2XYZ[3][3];
+extern const float XYZ2RGB[3][3];
+
 BOOL ConvertInPlaceRGBFToYxy(FIBITMAP *dib);
 BOOL ConvertInPlaceYxyToRGBF(FIBITMAP *dib);
 FIBITMAP* ConvertRGBFToY(FIBITMAP *src);
@@ -41,5 +44,149 @@ FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
 }
 #endif
 
-#endif // FREEIMAGE_TONE_MAPPING_H
+// minimum number of pixels worth a thread in the tone mapping operators
+#define TMO_MIN_THREAD_PIXELS	(128 * 128)
+
+/**
+Clamp a display value to [0, 1] and convert it to 8-bit (NaN gives 0)
+*/
+static inline BYTE 
+tmo_ClampToByte(float value) {
+	value = (value > 0) ? value : 0;
+	value = (value > 1) ? 1 : value;
+	return (BYTE)(255.0F * value + 0.5F);
+}
+
+#ifdef FREEIMAGE_SSE2
+
+// ----------------------------------------------------------
+// Vectorised math used by the tone mapping operators. 
+// log and exp follow the Cephes single precision polynomials 
+// (relative error around 1e-7), which is far below the 8-bit output precision.
+// ----------------------------------------------------------
+
+/**
+Natural logarithm of 4 values. Inputs must be positive and normalized.
+*/
+static inline __m128 
+tmo_log_ps(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0F);
+
+	// x = m * 2^e, with m in [0.5, 1)
+	const __m128i e = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(126));
+	x = _mm_or_ps(_mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007FFFFF))), _mm_set1_ps(0.5F));
+
+	// keep m in [sqrt(1/2), sqrt(2)) : if m < sqrt(1/2) then m = 2m and e = e - 1
+	const __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524F));
+	const __m128 fe = _mm_sub_ps(_mm_cvtepi32_ps(e), _mm_and_ps(mask, one));
+	x = _mm_add_ps(_mm_sub_ps(x, one), _mm_and_ps(mask, x));
+
+	const __m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(7.0376836292E-2F);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1F));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+	y = _mm_add_ps(y, _mm_mul_ps(fe, _mm_set1_ps(-2.12194440E-4F)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5F)));
+	x = _mm_add_ps(x, y);
+	return _mm_add_ps(x, _mm_mul_ps(fe, _mm_set1_ps(0.693359375F)));
+}
+
+/**
+Exponential of 4 values. Inputs are clamped so that the result stays a normalized float.
+*/
+static inline __m128 
+tmo_exp_ps(__m128 x) {
+	const __m128 one = _mm_set1_ps(1.0F);
+
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3F)), _mm_set1_ps(88.0F));
 
+	// x = n * log(2) + r, with |r| <= log(2) / 2
+	__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341F)), _mm_set1_ps(0.5F));
+	const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+	fx = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, fx), one));
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375F)));
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440E-4F)));
+
+	const __m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(1.9875691500E-4F);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1F));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1F));
+	y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+
+	// multiply by 2^n
+	const __m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(y, _mm_castsi128_ps(n));
+}
+
+/**
+x^p for 4 values, returns 0 when x <= 0 (or NaN)
+*/
+static inline __m128 
+tmo_pow_ps(__m128 x, __m128 p) {
+	const __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+	// avoid denormals in the log
+	x = _mm_max_ps(x, _mm_set1_ps(1.17549435E-38F));
+	return _mm_and_ps(tmo_exp_ps(_mm_mul_ps(p, tmo_log_ps(x))), positive);
+}
+
+/**
+Load 4 RGBF pixels as planar red, green and blue vectors
+*/
+static inline void 
+tmo_LoadRGBF(const FIRGBF *pixel, __m128& red, __m128& green, __m128& blue) {
+	// deinterleave r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+	const float *src = (const float*)pixel;
+	const __m128 in0 = _mm_loadu_ps(src);
+	const __m128 in1 = _mm_loadu_ps(src + 4);
+	const __m128 in2 = _mm_loadu_ps(src + 8);
+	const __m128 r23 = _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(1, 1, 2, 2));
+	red = _mm_shuffle_ps(in0, r23, _MM_SHUFFLE(2, 0, 3, 0));
+	const __m128 g01 = _mm_shuffle_ps(in0, in1, _MM_SHUFFLE(0, 0, 1, 1));
+	const __m128 g23 = _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(2, 2, 3, 3));
+	green = _mm_shuffle_ps(g01, g23, _MM_SHUFFLE(2, 0, 2, 0));
+	const __m128 b01 = _mm_shuffle_ps(in0, in1, _MM_SHUFFLE(1, 1, 2, 2));
+	const __m128 b23 = _mm_shuffle_ps(in2, in2, _MM_SHUFFLE(3, 3, 0, 0));
+	blue = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+Clamp 4 display pixels to [0, 1] and store them as 24-bit RGB (NaN gives 0)
+*/
+static inline void 
+tmo_StoreRGB24(BYTE *dst, __m128 red, __m128 green, __m128 blue) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0F);
+	const __m128 scale = _mm_set1_ps(255.0F);
+	const __m128 half = _mm_set1_ps(0.5F);
+
+	// max(x, 0) returns 0 for NaN
+	red = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(red, zero), one), scale), half);
+	green = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(green, zero), one), scale), half);
+	blue = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(blue, zero), one), scale), half);
+
+	int r[4], g[4], b[4];
+	_mm_storeu_si128((__m128i*)r, _mm_cvttps_epi32(red));
+	_mm_storeu_si128((__m128i*)g, _mm_cvttps_epi32(green));
+	_mm_storeu_si128((__m128i*)b, _mm_cvttps_epi32(blue));
+	for(int k = 0; k < 4; k++) {
+		dst[FI_RGBA_RED]   = (BYTE)r[k];
+		dst[FI_RGBA_GREEN] = (BYTE)g[k];
+		dst[FI_RGBA_BLUE]  = (BYTE)b[k];
+		dst += 3;
+	}
+}
+
+#endif // FREEIMAGE_SSE2
+
+#endif // FREEIMAGE_TONE_MAPPING_H
@@ -64,6 +64,24 @@
 void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment);
 void FreeImage_Aligned_Free(void* mem);
 
+// Let an image whose external bits point to the pixels of another image keep these pixels alive
+// (as a view, or as a copy-on-write copy). Returns FALSE if the pixels belong to a user provided buffer.
+// defined in BitmapAccess.cpp
+
+BOOL FreeImage_SharePixels(FIBITMAP *dst, FIBITMAP *src, BOOL copy_on_write);
+
+// ==========================================================
+//   SIMD support
+// ==========================================================
+
+// FREEIMAGE_SSE2 is defined when SSE2 can be used without a runtime check
+// (x86-64, or x86 compiled for SSE2). Define FREEIMAGE_NO_SIMD to disable it.
+
+#if !defined(FREEIMAGE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define FREEIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -392,6 +410,16 @@ Rotate a dib according to Exif info
 */
 void RotateExif(FIBITMAP **dib);
 
+/**
+Mirror a scanline horizontally. Source and destination may be the same line.
+@param dst Destination scanline
+@param src Source scanline
+@param width Line width in pixels
+@param bytespp Number of bytes per pixel (8-bit images and above)
+@see Flip.cpp
+*/
+void MirrorScanLine(BYTE *dst, const BYTE *src, unsigned width, unsigned bytespp);
+
 
 // ==========================================================
 //   Big Endian / Little Endian utility functions
@@ -699,6 +727,18 @@ struct FreeImageCBWrapper
 		return _cb->onFinished(_cb->user, isSuccessful, NULL);
 	}
 
+	bool hasPreview() const {
+		return _cb && _cb->onPreview;
+	}
+
+	bool onPreview(FIBITMAP* dib, unsigned pass) {
+		if (!hasPreview()) {
+			return false;
+		}
+
+		return _cb->onPreview(_cb->user, dib, pass, NULL) != FALSE;
+	}
+
 	operator const FreeImageCB* () { return _cb; }
 
 	bool shouldContinue;
@@ -787,6 +827,12 @@ struct FIProgress {
 		return _cb.onProgress(progress);
 	}
 
+	/// true if the caller wants the partial image after each pass of a progressive decoder
+	bool wantsPreview() const { return _cb.hasPreview(); }
+
+	/// returns false if the caller does not want more passes to be decoded
+	bool reportPreview(FIBITMAP* dib, unsigned pass) { return _cb.onPreview(dib, pass); }
+
 	FreeImageCBWrapper callback() const { return _cb; }
 
 private:
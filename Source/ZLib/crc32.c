@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "crc32_simd.h"
 
 /* Definitions for doing the crc four data bytes at a time. */
 #if !defined(NOBYFOUR) && defined(Z_U4)
@@ -211,6 +212,17 @@ unsigned long ZEXPORT crc32_z(crc, buf, len)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+#ifdef HAVE_CRC32_SIMD
+    if (len >= Z_CRC32_SIMD_MIN_LEN && crc32_simd_available()) {
+        z_size_t chunk = len & ~(z_size_t)15;
+        crc = crc32_simd_((z_crc_t)crc ^ 0xffffffffUL, buf, chunk) ^ 0xffffffffUL;
+        buf += chunk;
+        len -= chunk;
+        if (len == 0)
+            return crc;
+    }
+#endif /* HAVE_CRC32_SIMD */
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         z_crc_t endian;
@@ -0,0 +1,191 @@
+/* crc32_simd.c -- hardware accelerated CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * FreeImage addition, enabled by defining Z_CRC32_SIMD.
+ *
+ * The x86 implementation folds 64 bytes per iteration with carry-less
+ * multiplications, then reduces the 128-bit remainder with Barrett's method.
+ * See "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction", V. Gopal et al., Intel Corporation, 2009.
+ */
+
+#include "crc32_simd.h"
+
+#if defined(CRC32_SIMD_SSE2_PCLMUL)
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#  define Z_TARGET_PCLMUL
+#  define Z_ALIGN16(x) __declspec(align(16)) x
+#else
+#  include <cpuid.h>
+#  define Z_TARGET_PCLMUL __attribute__((target("sse2,pclmul")))
+#  define Z_ALIGN16(x) x __attribute__((aligned(16)))
+#endif
+
+static int crc32_simd_state = -1;
+
+int ZLIB_INTERNAL crc32_simd_available()
+{
+    /* racy but idempotent: every thread computes the same value */
+    if (crc32_simd_state < 0) {
+        int available = 0;
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        available = ((info[2] & (1 << 1)) != 0) && ((info[3] & (1 << 26)) != 0);
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            available = ((ecx & bit_PCLMUL) != 0) && ((edx & bit_SSE2) != 0);
+#endif
+        crc32_simd_state = available;
+    }
+    return crc32_simd_state;
+}
+
+Z_TARGET_PCLMUL
+z_crc_t ZLIB_INTERNAL crc32_simd_(crc, buf, len)
+    z_crc_t crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    /* bit-reflected folding constants and CRC-32 / Barrett polynomials */
+    static const Z_ALIGN16(z_crc_t k1k2[4]) = { 0x54442bd4, 0x1, 0xc6e41596, 0x1 };
+    static const Z_ALIGN16(z_crc_t k3k4[4]) = { 0x751997d0, 0x1, 0xccaa009e, 0x0 };
+    static const Z_ALIGN16(z_crc_t k5k0[4]) = { 0x63cd6124, 0x1, 0x00000000, 0x0 };
+    static const Z_ALIGN16(z_crc_t poly[4]) = { 0xdb710641, 0x1, 0xf7011641, 0x1 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    /* there is at least one block of 64 */
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* parallel fold blocks of 64 */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+        x1 = _mm_xor_si128(x1, x5);
+        x2 = _mm_xor_si128(x2, x6);
+        x3 = _mm_xor_si128(x3, x7);
+        x4 = _mm_xor_si128(x4, x8);
+
+        x1 = _mm_xor_si128(x1, y5);
+        x2 = _mm_xor_si128(x2, y6);
+        x3 = _mm_xor_si128(x3, y7);
+        x4 = _mm_xor_si128(x4, y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold into 128 bits */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x2);
+    x1 = _mm_xor_si128(x1, x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x3);
+    x1 = _mm_xor_si128(x1, x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x4);
+    x1 = _mm_xor_si128(x1, x5);
+
+    /* single fold blocks of 16 */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(x1, x2);
+        x1 = _mm_xor_si128(x1, x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduce to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (z_crc_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+#elif defined(CRC32_SIMD_ARMV8)
+
+#include <arm_acle.h>
+#include <string.h>
+
+int ZLIB_INTERNAL crc32_simd_available()
+{
+    return 1;
+}
+
+z_crc_t ZLIB_INTERNAL crc32_simd_(crc, buf, len)
+    z_crc_t crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    len &= ~(z_size_t)15;
+    while (len) {
+        unsigned long long chunk[2];
+        memcpy(chunk, buf, 16);
+        crc = __crc32d(crc, chunk[0]);
+        crc = __crc32d(crc, chunk[1]);
+        buf += 16;
+        len -= 16;
+    }
+    return crc;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/* crc32_simd.h -- hardware accelerated CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * FreeImage addition, enabled by defining Z_CRC32_SIMD.
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "zutil.h"
+
+#ifdef Z_CRC32_SIMD
+#  if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+     /* SSE2 + PCLMULQDQ folding, selected at runtime */
+#    define CRC32_SIMD_SSE2_PCLMUL
+#  elif defined(__ARM_FEATURE_CRC32)
+     /* ARMv8 CRC32 instructions, enabled by the compiler target */
+#    define CRC32_SIMD_ARMV8
+#  endif
+#endif
+
+#if defined(CRC32_SIMD_SSE2_PCLMUL) || defined(CRC32_SIMD_ARMV8)
+#  define HAVE_CRC32_SIMD
+
+/* Minimum buffer length handled by crc32_simd_ */
+#  define Z_CRC32_SIMD_MIN_LEN 64
+
+/* Returns non-zero if crc32_simd_ can be used on this CPU */
+int ZLIB_INTERNAL crc32_simd_available OF((void));
+
+/*
+ * Update the non-conditioned (pre- and post-inverted by the caller) crc with
+ * the first (len & ~15) bytes of buf. len must be at least Z_CRC32_SIMD_MIN_LEN.
+ */
+z_crc_t ZLIB_INTERNAL crc32_simd_ OF((z_crc_t crc, const unsigned char FAR *buf,
+                                      z_size_t len));
+#endif
+
+#endif /* CRC32_SIMD_H */
@@ -77,6 +77,13 @@ int main(int argc, char *argv[]) {
 	// test memory IO
 	testMemIO("sample.png");
 	testMemIO("exif.jxr");
+	testSavePNGMemIO(width, height);
+	testProgressiveLoadMemIO(width, height);
+	testSaveEXRMemIO(width, height);
+	testSaveWebPMemIO(width, height);
+	testSaveDDSMemIO(width, height);
+	testLoadDDSBlocksMemIO();
+	testSaveHDRMemIO(width, height);
 
 	// test multipage functions
 	testMultiPage("sample.png");
@@ -93,6 +100,24 @@ int main(int argc, char *argv[]) {
 	// test get/set channel
 	testImageChannels(width, height);
 
+	// test right angle rotations & flipping
+	testRotateFlip(width, height);
+
+	// test tone mapping operators
+	testToneMapping(width, height);
+
+	// test colour quantization & palette dithering
+	testQuantize(width, height);
+
+	// test point operations & statistics
+	testColors(width, height);
+
+	// test alpha compositing
+	testComposite(width, height);
+
+	// test background filling & canvas enlarging
+	testBackground(width, height);
+
 	// test loading header only
 	testHeaderOnly();
 	
@@ -108,6 +133,9 @@ int main(int argc, char *argv[]) {
 	// test views
 	testCreateView("exif.jpg", 0);
 
+	// test shared & copy-on-write pixels
+	testSharedPixels("exif.jpg", 0);
+
 #if defined(FREEIMAGE_LIB) || !defined(WIN32)
 	FreeImage_DeInitialise();
 #endif
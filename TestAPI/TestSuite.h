@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if (defined(WIN32) || defined(__WIN32__))
 #if (defined(_DEBUG))
@@ -40,6 +41,7 @@
 // Some useful tools
 // ==========================================================
 FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale);
+BOOL sameImage(FIBITMAP *dib1, FIBITMAP *dib2);
 
 // Test plugins capabilities
 // ==========================================================
@@ -64,6 +66,13 @@ void testExifRaw();
 // ==========================================================
 
 void testMemIO(const char *lpszPathName);
+void testSavePNGMemIO(unsigned width, unsigned height);
+void testProgressiveLoadMemIO(unsigned width, unsigned height);
+void testSaveEXRMemIO(unsigned width, unsigned height);
+void testSaveWebPMemIO(unsigned width, unsigned height);
+void testSaveDDSMemIO(unsigned width, unsigned height);
+void testLoadDDSBlocksMemIO();
+void testSaveHDRMemIO(unsigned width, unsigned height);
 
 // Multipage test suite
 // ==========================================================
@@ -82,6 +91,36 @@ void testJPEG();
 
 void testImageChannels(unsigned width, unsigned height);
 
+// Rotation & flipping test suite
+// ==========================================================
+
+void testRotateFlip(unsigned width, unsigned height);
+
+// Tone mapping test suite
+// ==========================================================
+
+void testToneMapping(unsigned width, unsigned height);
+
+// Colour quantization test suite
+// ==========================================================
+
+void testQuantize(unsigned width, unsigned height);
+
+// Point operations & statistics test suite
+// ==========================================================
+
+void testColors(unsigned width, unsigned height);
+
+// Alpha compositing test suite
+// ==========================================================
+
+void testComposite(unsigned width, unsigned height);
+
+// Background filling test suite
+// ==========================================================
+
+void testBackground(unsigned width, unsigned height);
+
 
 // Thumbnails test suite
 // ==========================================================
@@ -94,6 +133,8 @@ void testWrappedBuffer(const char *lpszPathName, int flags);
 
 void testCreateView(const char *lpszPathName, int flags);
 
+void testSharedPixels(const char *lpszPathName, int flags);
+
 #endif // TEST_FREEIMAGE_API_H
 
 
@@ -0,0 +1,248 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Create an image filled with pseudo-random bytes. 
+16-bit FIT_BITMAP images use the 565 layout, 8-bit images get a pseudo-random palette if 'palette' is TRUE
+*/
+static FIBITMAP* 
+createRandomImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp, BOOL palette, unsigned seed) {
+	FIBITMAP *dib = ((type == FIT_BITMAP) && (bpp == 16)) ? 
+		FreeImage_AllocateT(type, width, height, bpp, FI16_565_RED_MASK, FI16_565_GREEN_MASK, FI16_565_BLUE_MASK) : 
+		FreeImage_AllocateT(type, width, height, bpp);
+	assert(dib != NULL);
+	srand(seed);
+	if(palette) {
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(unsigned i = 0; i < 256; i++) {
+			pal[i].rgbRed = (BYTE)(rand() & 0xFF);
+			pal[i].rgbGreen = (BYTE)(rand() & 0xFF);
+			pal[i].rgbBlue = (BYTE)(rand() & 0xFF);
+		}
+		assert(FreeImage_GetColorType(dib) == FIC_PALETTE);
+	}
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			bits[x] = (BYTE)(rand() & 0xFF);
+		}
+	}
+	return dib;
+}
+
+/**
+Check that all the pixels of an image of 8 or more bits per pixel are equal to 'pixel'
+*/
+static void 
+checkFilled(FIBITMAP *dib, const void *pixel) {
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib); x++, bits += bytespp) {
+			assert(memcmp(bits, pixel, bytespp) == 0);
+		}
+	}
+}
+
+/**
+Check FreeImage_EnlargeCanvas against the original algorithm: a canvas filled by FreeImage_AllocateExT, 
+into which the cropped source is pasted
+*/
+static void 
+checkEnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom, const void *color, int options) {
+	BOOL bResult = FALSE;
+
+	const int width = (int)FreeImage_GetWidth(src);
+	const int height = (int)FreeImage_GetHeight(src);
+
+	FIBITMAP *canvas = FreeImage_EnlargeCanvas(src, left, top, right, bottom, color, options);
+	assert(canvas != NULL);
+	assert((FreeImage_GetWidth(canvas) == (unsigned)(width + left + right)) && (FreeImage_GetHeight(canvas) == (unsigned)(height + top + bottom)));
+
+	FIBITMAP *expected = FreeImage_AllocateExT(FreeImage_GetImageType(src), width + left + right, height + top + bottom, FreeImage_GetBPP(src), 
+		color, options, FreeImage_GetPalette(src), FreeImage_GetRedMask(src), FreeImage_GetGreenMask(src), FreeImage_GetBlueMask(src));
+	assert(expected != NULL);
+	FIBITMAP *copy = FreeImage_Copy(src, (left < 0) ? -left : 0, (top < 0) ? -top : 0, (right < 0) ? width + right : width, (bottom < 0) ? height + bottom : height);
+	assert(copy != NULL);
+	bResult = FreeImage_Paste(expected, copy, (left > 0) ? left : 0, (top > 0) ? top : 0, 256);
+	assert(bResult);
+
+	assert(sameImage(canvas, expected));
+	if(FreeImage_GetPalette(src)) {
+		assert(memcmp(FreeImage_GetPalette(canvas), FreeImage_GetPalette(src), FreeImage_GetColorsUsed(src) * sizeof(RGBQUAD)) == 0);
+	}
+
+	FreeImage_Unload(copy);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(canvas);
+}
+
+// ----------------------------------------------------------
+
+void testBackground(unsigned width, unsigned height) {
+	BOOL bResult = FALSE;
+	FIBITMAP *invalid = NULL;
+
+	printf("testBackground ...\n");
+
+	const unsigned sizes[][2] = { { width, height }, { 37, 21 } };
+
+	for(int j = 0; j < 2; j++) {
+		const unsigned w = sizes[j][0];
+		const unsigned h = sizes[j][1];
+
+		// filling with an explicit pixel value
+		// -------------------------------
+		{
+			RGBQUAD color = { 10, 20, 30, 77 };
+
+			FIBITMAP *dib = createRandomImage(FIT_BITMAP, w, h, 24, FALSE, 1);
+			bResult = FreeImage_FillBackground(dib, &color, 0);
+			assert(bResult);
+			checkFilled(dib, &color);
+			FreeImage_Unload(dib);
+
+			// the alpha channel of a 32-bit image is opaque
+			dib = createRandomImage(FIT_BITMAP, w, h, 32, FALSE, 2);
+			bResult = FreeImage_FillBackground(dib, &color, 0);
+			assert(bResult);
+			const RGBQUAD opaque = { 10, 20, 30, 0xFF };
+			checkFilled(dib, &opaque);
+			FreeImage_Unload(dib);
+
+			// 16-bit 565
+			dib = createRandomImage(FIT_BITMAP, w, h, 16, FALSE, 3);
+			bResult = FreeImage_FillBackground(dib, &color, 0);
+			assert(bResult);
+			const WORD rgb565 = (WORD)(((30 >> 3) << 11) | ((20 >> 2) << 5) | (10 >> 3));
+			checkFilled(dib, &rgb565);
+			FreeImage_Unload(dib);
+
+			// 8-bit greyscale, the index is given by the alpha member
+			dib = createRandomImage(FIT_BITMAP, w, h, 8, FALSE, 4);
+			bResult = FreeImage_FillBackground(dib, &color, FI_COLOR_ALPHA_IS_INDEX);
+			assert(bResult);
+			const BYTE index = 77;
+			checkFilled(dib, &index);
+			FreeImage_Unload(dib);
+
+			// 8-bit palette, the first palette entry of the given colour
+			dib = createRandomImage(FIT_BITMAP, w, h, 8, TRUE, 5);
+			const RGBQUAD *pal = FreeImage_GetPalette(dib);
+			const RGBQUAD entry = { pal[200].rgbBlue, pal[200].rgbGreen, pal[200].rgbRed, 0 };
+			BYTE first = 0;
+			while((pal[first].rgbBlue != entry.rgbBlue) || (pal[first].rgbGreen != entry.rgbGreen) || (pal[first].rgbRed != entry.rgbRed)) {
+				first++;
+			}
+			bResult = FreeImage_FillBackground(dib, &entry, FI_COLOR_FIND_EQUAL_COLOR);
+			assert(bResult);
+			checkFilled(dib, &first);
+			FreeImage_Unload(dib);
+
+			// other image types take the pixel value as is
+			const FREE_IMAGE_TYPE types[] = { FIT_UINT16, FIT_FLOAT, FIT_DOUBLE, FIT_RGB16, FIT_RGBA16, FIT_RGBF, FIT_RGBAF };
+			const BYTE value[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+			for(int t = 0; t < 7; t++) {
+				dib = createRandomImage(types[t], w, h, 0, FALSE, 6 + t);
+				bResult = FreeImage_FillBackground(dib, value, 0);
+				assert(bResult);
+				checkFilled(dib, value);
+				FreeImage_Unload(dib);
+			}
+		}
+
+		// enlarging and cropping, against the original algorithm
+		// -------------------------------
+		{
+			const struct {
+				FREE_IMAGE_TYPE type;
+				unsigned bpp;
+				BOOL palette;
+			} formats[] = {
+				{ FIT_BITMAP, 8, FALSE }, { FIT_BITMAP, 8, TRUE }, { FIT_BITMAP, 16, FALSE }, { FIT_BITMAP, 24, FALSE }, { FIT_BITMAP, 32, FALSE }, 
+				{ FIT_UINT16, 16, FALSE }, { FIT_FLOAT, 32, FALSE }, { FIT_RGB16, 48, FALSE }, { FIT_RGBAF, 128, FALSE }
+			};
+			// borders: enlarged, cropped, and cropped on one side while enlarged on another
+			const int borders[][4] = {
+				{ 3, 5, 7, 2 }, { 0, 1, 0, 0 }, { 6, 0, 0, 0 }, { -5, 3, 7, -4 }, { 4, -6, -3, 9 }, { -2, -3, 1, -1 }, { 0, -(int)h / 2, 5, 0 }
+			};
+			const RGBQUAD colors[] = { { 10, 20, 30, 0xFF }, { 0, 0, 0, 0 }, { 90, 90, 90, 128 } };
+			const BYTE value[16] = { 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+			for(int f = 0; f < 9; f++) {
+				FIBITMAP *src = createRandomImage(formats[f].type, w, h, formats[f].bpp, formats[f].palette, 20 + f);
+				for(int b = 0; b < 7; b++) {
+					if(formats[f].type == FIT_BITMAP) {
+						for(int c = 0; c < 3; c++) {
+							checkEnlargeCanvas(src, borders[b][0], borders[b][1], borders[b][2], borders[b][3], &colors[c], 0);
+						}
+						// an alpha blended colour, a palette index
+						checkEnlargeCanvas(src, borders[b][0], borders[b][1], borders[b][2], borders[b][3], &colors[2], FI_COLOR_IS_RGBA_COLOR);
+						checkEnlargeCanvas(src, borders[b][0], borders[b][1], borders[b][2], borders[b][3], &colors[2], FI_COLOR_ALPHA_IS_INDEX);
+					} else {
+						checkEnlargeCanvas(src, borders[b][0], borders[b][1], borders[b][2], borders[b][3], value, 0);
+					}
+				}
+
+				// the result size must be positive: a border larger than the image, 
+				// or two cropped sides larger than the image together
+				const int half = (int)w / 2 + 1;
+				invalid = FreeImage_EnlargeCanvas(src, -(int)(w + 1), 0, 2, 0, value, 0);
+				assert(invalid == NULL);
+				invalid = FreeImage_EnlargeCanvas(src, -half, 1, -half, 0, value, 0);
+				assert(invalid == NULL);
+				invalid = FreeImage_EnlargeCanvas(src, 1, -(int)h / 2 - 1, 0, -(int)h / 2 - 1, value, 0);
+				assert(invalid == NULL);
+				// a colour is needed to enlarge an image
+				invalid = FreeImage_EnlargeCanvas(src, 1, 0, 0, 0, NULL, 0);
+				assert(invalid == NULL);
+
+				FreeImage_Unload(src);
+			}
+		}
+	}
+
+	// fills of more than 4 MB bypass the caches, on lines whose start is not 16-byte aligned
+	// -------------------------------
+	{
+		const RGBQUAD color = { 10, 20, 30, 0 };
+		FIBITMAP *dib = createRandomImage(FIT_BITMAP, 1021, 1400, 24, FALSE, 40);
+		assert((size_t)FreeImage_GetLine(dib) * FreeImage_GetHeight(dib) >= 4 * 1024 * 1024);
+		bResult = FreeImage_FillBackground(dib, &color, 0);
+		assert(bResult);
+		checkFilled(dib, &color);
+		FreeImage_Unload(dib);
+
+		// large top border
+		dib = createRandomImage(FIT_BITMAP, 1021, 9, 24, FALSE, 41);
+		checkEnlargeCanvas(dib, 2, 1400, 3, 1, &color, 0);
+		FreeImage_Unload(dib);
+
+		// FIT_RGBF
+		const float value[3] = { 0.25F, 0.5F, 0.75F };
+		dib = createRandomImage(FIT_RGBF, 700, 600, 0, FALSE, 42);
+		assert((size_t)FreeImage_GetLine(dib) * FreeImage_GetHeight(dib) >= 4 * 1024 * 1024);
+		bResult = FreeImage_FillBackground(dib, value, 0);
+		assert(bResult);
+		checkFilled(dib, value);
+		FreeImage_Unload(dib);
+	}
+}
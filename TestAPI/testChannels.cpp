@@ -109,6 +109,92 @@ void testRGBAChannels(FREE_IMAGE_TYPE image_type, unsigned width, unsigned heigh
 	FreeImage_Unload(src);
 }
 
+void testPlanarChannels(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned height) {
+	static const FREE_IMAGE_COLOR_CHANNEL ids[] = { FICC_RED, FICC_GREEN, FICC_BLUE, FICC_ALPHA };
+	unsigned uResult = 0;
+
+	// create a random test image
+	FIBITMAP *src = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(src != NULL);
+	unsigned seed = 12345;
+	const unsigned line = FreeImage_GetLine(src);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < line; x++) {
+			seed = seed * 1103515245 + 12345;
+			bits[x] = (BYTE)(seed >> 16);
+		}
+		if((image_type == FIT_FLOAT) || (image_type == FIT_RGBF) || (image_type == FIT_RGBAF)) {
+			float *values = (float*)bits;
+			for(unsigned x = 0; x < line / sizeof(float); x++) {
+				values[x] = (float)bits[4 * x] / 7;
+			}
+		}
+	}
+
+	// split matches FreeImage_GetChannel, merge restores the image
+	FIBITMAP *planes[4];
+	const unsigned channels = FreeImage_SplitChannels(src, planes, 4);
+	uResult = FreeImage_ConvertToPlanarFloat(src, NULL);
+	assert(uResult == channels);
+	assert((channels == 1) || (channels == 3) || (channels == 4));
+	if(channels == 1) {
+		// a greyscale image is its own channel
+		assert(FreeImage_GetImageType(planes[0]) == image_type);
+		for(unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(planes[0], y), FreeImage_GetScanLine(src, y), line) == 0);
+		}
+		// a single channel is not merged
+		FIBITMAP *merged = FreeImage_MergeChannels(planes, channels);
+		assert(merged == NULL);
+	} else {
+		for(unsigned c = 0; c < channels; c++) {
+			FIBITMAP *channel = FreeImage_GetChannel(src, ids[c]);
+			assert(channel != NULL);
+			for(unsigned y = 0; y < height; y++) {
+				assert(memcmp(FreeImage_GetScanLine(channel, y), FreeImage_GetScanLine(planes[c], y), FreeImage_GetLine(channel)) == 0);
+			}
+			FreeImage_Unload(channel);
+		}
+		FIBITMAP *merged = FreeImage_MergeChannels(planes, channels);
+		assert(merged != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(merged, y), FreeImage_GetScanLine(src, y), line) == 0);
+		}
+		FreeImage_Unload(merged);
+	}
+	for(unsigned c = 0; c < channels; c++) {
+		FreeImage_Unload(planes[c]);
+	}
+
+	// planar float round trip, rows are stored top-down
+	float *buffer = (float*)malloc((size_t)channels * width * height * sizeof(float));
+	assert(buffer != NULL);
+	uResult = FreeImage_ConvertToPlanarFloat(src, buffer);
+	assert(uResult == channels);
+	if(image_type == FIT_BITMAP) {
+		const BYTE *top = FreeImage_GetScanLine(src, height - 1);
+		if(channels == 1) {
+			assert(buffer[0] == top[0] * (1.0F / 255));
+		} else {
+			assert(buffer[0] == top[FI_RGBA_RED] * (1.0F / 255));
+			assert(buffer[(size_t)width * height] == top[FI_RGBA_GREEN] * (1.0F / 255));
+		}
+	}
+	const FREE_IMAGE_TYPE sample_type = (image_type == FIT_BITMAP) ? FIT_BITMAP : (((image_type == FIT_UINT16) || (image_type == FIT_RGB16) || (image_type == FIT_RGBA16)) ? FIT_UINT16 : FIT_FLOAT);
+	FIBITMAP *dst = FreeImage_ConvertFromPlanarFloat(buffer, width, height, channels, sample_type);
+	assert(dst != NULL);
+	assert((FreeImage_GetImageType(dst) == image_type) && (FreeImage_GetBPP(dst) == bpp));
+	assert(FreeImage_GetColorType(dst) == FreeImage_GetColorType(src));
+	for(unsigned y = 0; y < height; y++) {
+		assert(memcmp(FreeImage_GetScanLine(dst, y), FreeImage_GetScanLine(src, y), line) == 0);
+	}
+	FreeImage_Unload(dst);
+	free(buffer);
+
+	FreeImage_Unload(src);
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -124,4 +210,14 @@ void testImageChannels(unsigned width, unsigned height) {
 
 	testRGBAChannels(FIT_RGBF, width, height, FALSE);
 	testRGBAChannels(FIT_RGBAF, width, height, TRUE);
+
+	testPlanarChannels(FIT_BITMAP, 8, width + 5, height);
+	testPlanarChannels(FIT_BITMAP, 24, width + 5, height);
+	testPlanarChannels(FIT_BITMAP, 32, width + 5, height);
+	testPlanarChannels(FIT_UINT16, 16, width + 5, height);
+	testPlanarChannels(FIT_RGB16, 48, width + 5, height);
+	testPlanarChannels(FIT_RGBA16, 64, width + 5, height);
+	testPlanarChannels(FIT_FLOAT, 32, width + 5, height);
+	testPlanarChannels(FIT_RGBF, 96, width + 5, height);
+	testPlanarChannels(FIT_RGBAF, 128, width + 5, height);
 }
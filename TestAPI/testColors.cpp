@@ -0,0 +1,406 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Get the number of samples per pixel of a 24-, 32-bit, 16-bit or float RGB(A) image
+*/
+static unsigned 
+getSamples(FIBITMAP *dib) {
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_RGB16:
+		case FIT_RGBF:
+			return 3;
+		case FIT_RGBA16:
+		case FIT_RGBAF:
+			return 4;
+		default:
+			return FreeImage_GetBPP(dib) / 8;
+	}
+}
+
+/**
+Get a sample (channel 0 = red, 1 = green, 2 = blue, 3 = alpha) of a 24-, 32-bit, 
+16-bit or float RGB(A) image, scaled to the range [0..255]
+*/
+static double 
+getSample(FIBITMAP *dib, unsigned x, unsigned y, unsigned channel) {
+	const BYTE *bits = FreeImage_GetScanLine(dib, y);
+	const unsigned index = getSamples(dib) * x + channel;
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			return ((const WORD*)bits)[index] / 257.0;
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			return ((const float*)bits)[index] * 255.0;
+		default:
+		{
+			const unsigned offsets[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+			return bits[getSamples(dib) * x + offsets[channel]];
+		}
+	}
+}
+
+/**
+Create a 24-, 32-bit, 16-bit or float RGB(A) image whose samples cycle through all the byte values 
+(scaled by 257 for 16-bit images and by 1/255 for float images)
+*/
+static FIBITMAP* 
+createSampleRamp(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(dib != NULL);
+	const unsigned samples = getSamples(dib);
+	const unsigned offsets[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			for(unsigned c = 0; c < samples; c++) {
+				const unsigned value = (3 * x + 7 * c + 13 * y) & 0xFF;
+				const unsigned index = samples * x + c;
+				switch(image_type) {
+					case FIT_RGB16:
+					case FIT_RGBA16:
+						((WORD*)bits)[index] = (WORD)(value * 257);
+						break;
+					case FIT_RGBF:
+					case FIT_RGBAF:
+						((float*)bits)[index] = value / 255.0F;
+						break;
+					default:
+						bits[samples * x + offsets[c]] = (BYTE)value;
+						break;
+				}
+			}
+		}
+	}
+	return dib;
+}
+
+/**
+Create a 8-bit (greyscale or palette), 24-, 32-bit or 16-bit integer image filled with pseudo random samples
+*/
+static FIBITMAP* 
+createRandomSamples(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height, unsigned bpp, FREE_IMAGE_COLOR_TYPE color_type) {
+	FIBITMAP *dib = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(dib != NULL);
+	unsigned seed = 12345;
+	if(color_type == FIC_PALETTE) {
+		// a few duplicated colours
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(unsigned i = 0; i < 256; i++) {
+			seed = seed * 1103515245 + 12345;
+			pal[i].rgbRed = (BYTE)(seed >> 8);
+			pal[i].rgbGreen = (BYTE)(seed >> 16);
+			pal[i].rgbBlue = (BYTE)((i % 5 == 0) ? 200 : (seed >> 24));
+		}
+		assert(FreeImage_GetColorType(dib) == FIC_PALETTE);
+	}
+	const unsigned samples = FreeImage_GetLine(dib) / width / ((image_type == FIT_BITMAP) ? 1 : 2);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned i = 0; i < width * samples; i++) {
+			seed = seed * 1103515245 + 12345;
+			if(image_type == FIT_BITMAP) {
+				bits[i] = (BYTE)(seed >> 16);
+			} else {
+				((WORD*)bits)[i] = (WORD)(seed >> 12);
+			}
+		}
+	}
+	return dib;
+}
+
+/**
+Get a sample (channel 0 = red, 1 = green, 2 = blue, 3 = alpha, or the grey level) of an 8-bit (greyscale or palette), 
+24-, 32-bit or 16-bit integer image, at its own precision. Palette images are read as the colours of their indices
+*/
+static unsigned 
+getIntegerSample(FIBITMAP *dib, unsigned x, unsigned y, unsigned channel) {
+	const BYTE *bits = FreeImage_GetScanLine(dib, y);
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			return ((const WORD*)bits)[(FreeImage_GetBPP(dib) / 16) * x + channel];
+		default:
+			if(FreeImage_GetColorType(dib) == FIC_PALETTE) {
+				const RGBQUAD *color = FreeImage_GetPalette(dib) + bits[x];
+				return (channel == 0) ? color->rgbRed : ((channel == 1) ? color->rgbGreen : color->rgbBlue);
+			}
+			if(FreeImage_GetBPP(dib) == 8) {
+				return bits[x];
+			}
+			return (unsigned)getSample(dib, x, y, channel);
+	}
+}
+
+/**
+Check the statistics and the histograms of FreeImage_GetStatistics against a brute force computation, 
+for an 8-bit (greyscale or palette), 24-, 32-bit or 16-bit integer image
+*/
+static void 
+checkIntegerStatistics(FIBITMAP *dib, unsigned bins) {
+	BOOL bResult = FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const BOOL palette = (image_type == FIT_BITMAP) && (FreeImage_GetColorType(dib) == FIC_PALETTE);
+	const unsigned levels = (image_type == FIT_BITMAP) ? 256 : 65536;
+	const unsigned samples = (image_type == FIT_BITMAP) ? FreeImage_GetBPP(dib) / 8 : FreeImage_GetBPP(dib) / 16;
+	const unsigned channels = palette ? 3 : samples;
+
+	FISTATISTICS stats;
+	DWORD *histo = (DWORD*)malloc(4 * bins * sizeof(DWORD));
+	DWORD *expected = (DWORD*)malloc(bins * sizeof(DWORD));
+	assert((histo != NULL) && (expected != NULL));
+	bResult = FreeImage_GetStatistics(dib, &stats, histo, bins);
+	assert(bResult);
+	assert(stats.channels == channels);
+
+	for(unsigned c = 0; c < channels; c++) {
+		unsigned min = levels, max = 0;
+		double sum = 0;
+		memset(expected, 0, bins * sizeof(DWORD));
+		for(unsigned y = 0; y < height; y++) {
+			for(unsigned x = 0; x < width; x++) {
+				const unsigned value = getIntegerSample(dib, x, y, c);
+				min = (value < min) ? value : min;
+				max = (value > max) ? value : max;
+				sum += value;
+				expected[(unsigned)(((unsigned long long)value * bins) / levels)]++;
+			}
+		}
+		const double mean = sum / ((double)width * height);
+		double m2 = 0;
+		for(unsigned y = 0; y < height; y++) {
+			for(unsigned x = 0; x < width; x++) {
+				const double d = getIntegerSample(dib, x, y, c) - mean;
+				m2 += d * d;
+			}
+		}
+		const double stddev = sqrt(m2 / ((double)width * height));
+
+		assert((stats.min[c] == min) && (stats.max[c] == max));
+		assert(fabs(stats.mean[c] - mean) <= 1e-9 * mean);
+		assert(fabs(stats.stddev[c] - stddev) <= 1e-9 * stddev);
+		assert(memcmp(histo + c * bins, expected, bins * sizeof(DWORD)) == 0);
+	}
+
+	free(expected);
+	free(histo);
+}
+
+// ----------------------------------------------------------
+
+void testColors(unsigned width, unsigned height) {
+	BOOL bResult = FALSE;
+
+	printf("testColors ...\n");
+
+	const unsigned sizes[][2] = { { width, height }, { 37, 21 } };
+
+	for(int j = 0; j < 2; j++) {
+		const unsigned w = sizes[j][0];
+		const unsigned h = sizes[j][1];
+
+		// a chain collapses into a single lookup table: contrast then brightness 
+		// gives the table of FreeImage_GetAdjustColorsLookupTable
+		FIBITMAP *src = createSampleRamp(FIT_BITMAP, w, h, 32);
+		FIBITMAP *dst = FreeImage_Clone(src);
+		BYTE LUT[256];
+		FreeImage_GetAdjustColorsLookupTable(LUT, 30.0, -25.0, 1.0, FALSE);
+		const FIADJUSTMENT chain[2] = { { FIADJ_CONTRAST, -25.0, NULL, FICC_RGB }, { FIADJ_BRIGHTNESS, 30.0, NULL, FICC_RGB } };
+		bResult = FreeImage_AdjustChain(dst, chain, 2);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			for(unsigned x = 0; x < w; x++) {
+				for(unsigned c = 0; c < 3; c++) {
+					assert(getSample(dst, x, y, c) == LUT[(int)getSample(src, x, y, c)]);
+				}
+				assert(getSample(dst, x, y, 3) == getSample(src, x, y, 3));
+			}
+		}
+		FreeImage_Unload(dst);
+
+		// the statistics histograms match FreeImage_GetHistogram
+		FISTATISTICS stats;
+		DWORD histo[4 * 256], channel_histo[256];
+		bResult = FreeImage_GetStatistics(src, &stats, histo);
+		assert(bResult);
+		assert(stats.channels == 4);
+		const FREE_IMAGE_COLOR_CHANNEL rgb[3] = { FICC_RED, FICC_GREEN, FICC_BLUE };
+		for(unsigned c = 0; c < 3; c++) {
+			assert(FreeImage_GetHistogram(src, channel_histo, rgb[c]));
+			assert(memcmp(histo + 256 * c, channel_histo, sizeof(channel_histo)) == 0);
+			assert((stats.min[c] >= 0) && (stats.min[c] <= stats.mean[c]) && (stats.mean[c] <= stats.max[c]) && (stats.max[c] <= 255));
+		}
+
+		// exact statistics of integer images, with rebinned histograms
+		{
+			const struct {
+				FREE_IMAGE_TYPE type;
+				unsigned bpp;
+				FREE_IMAGE_COLOR_TYPE color_type;
+			} formats[] = {
+				{ FIT_BITMAP, 8, FIC_MINISBLACK }, { FIT_BITMAP, 8, FIC_PALETTE }, { FIT_BITMAP, 24, FIC_RGB }, { FIT_BITMAP, 32, FIC_RGBALPHA }, 
+				{ FIT_UINT16, 16, FIC_MINISBLACK }, { FIT_RGB16, 48, FIC_RGB }, { FIT_RGBA16, 64, FIC_RGBALPHA }
+			};
+			for(int f = 0; f < 7; f++) {
+				FIBITMAP *dib = createRandomSamples(formats[f].type, w, h, formats[f].bpp, formats[f].color_type);
+				const unsigned bins[] = { 256, 100, 7, 1, 65536, 1000 };
+				for(int b = 0; b < ((formats[f].type == FIT_BITMAP) ? 4 : 6); b++) {
+					checkIntegerStatistics(dib, bins[b]);
+				}
+				// too many bins
+				DWORD *histo = (DWORD*)malloc(4 * 65537 * sizeof(DWORD));
+				bResult = FreeImage_GetStatistics(dib, NULL, histo, (formats[f].type == FIT_BITMAP) ? 257 : 65537);
+				assert(!bResult);
+				free(histo);
+				FreeImage_Unload(dib);
+			}
+		}
+
+		// invalid steps are rejected
+		const FIADJUSTMENT bad_gamma = { FIADJ_GAMMA, 0.0, NULL, FICC_RGB };
+		bResult = FreeImage_AdjustChain(src, &bad_gamma, 1);
+		assert(!bResult);
+		const FIADJUSTMENT bad_curve = { FIADJ_CURVE, 0.0, NULL, FICC_RGB };
+		bResult = FreeImage_AdjustChain(src, &bad_curve, 1);
+		assert(!bResult);
+
+		// inverting twice restores the image
+		dst = FreeImage_Clone(src);
+		bResult = FreeImage_Invert(dst);
+		assert(bResult);
+		bResult = FreeImage_Invert(dst);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			assert(memcmp(FreeImage_GetScanLine(src, y), FreeImage_GetScanLine(dst, y), FreeImage_GetLine(src)) == 0);
+		}
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+
+		// 16-bit and float images follow the 8-bit results, at their own precision
+		const FREE_IMAGE_TYPE types[] = { FIT_RGB16, FIT_RGBA16, FIT_RGBF, FIT_RGBAF };
+		for(int t = 0; t < 4; t++) {
+			FIBITMAP *ref = createSampleRamp(FIT_BITMAP, w, h, 24);
+			src = createSampleRamp(types[t], w, h, 0);
+
+			bResult = FreeImage_AdjustGamma(ref, 2.2);
+			assert(bResult);
+			bResult = FreeImage_AdjustGamma(src, 2.2);
+			assert(bResult);
+			bResult = FreeImage_AdjustContrast(ref, 20.0);
+			assert(bResult);
+			bResult = FreeImage_AdjustContrast(src, 20.0);
+			assert(bResult);
+			bResult = FreeImage_Invert(ref);
+			assert(bResult);
+			bResult = FreeImage_Invert(src);
+			assert(bResult);
+			for(unsigned y = 0; y < h; y++) {
+				for(unsigned x = 0; x < w; x++) {
+					for(unsigned c = 0; c < 3; c++) {
+						// the 8-bit reference is rounded after each call, float samples are not clamped
+						const double value = getSample(src, x, y, c);
+						const double clamped = (value < 0) ? 0 : ((value > 255) ? 255 : value);
+						assert(fabs(clamped - getSample(ref, x, y, c)) <= 1.01);
+					}
+					if(getSamples(src) == 4) {
+						// alpha is only inverted
+						const double alpha = (3 * x + 21 + 13 * y) & 0xFF;
+						assert(fabs(getSample(src, x, y, 3) - (255 - alpha)) < 0.01);
+					}
+				}
+			}
+
+			// float statistics: a ramp of all the byte values, inverted
+			if((types[t] == FIT_RGBF) || (types[t] == FIT_RGBAF)) {
+				FIBITMAP *ramp = createSampleRamp(types[t], w, h, 0);
+				bResult = FreeImage_Invert(ramp);
+				assert(bResult);
+				FISTATISTICS ramp_stats;
+				bResult = FreeImage_GetStatistics(ramp, &ramp_stats);
+				assert(bResult);
+				for(unsigned c = 0; c < ramp_stats.channels; c++) {
+					double sum = 0;
+					for(unsigned y = 0; y < h; y++) {
+						for(unsigned x = 0; x < w; x++) {
+							sum += getSample(ramp, x, y, c) / 255.0;
+						}
+					}
+					assert(fabs(ramp_stats.mean[c] - sum / (w * h)) < 1e-6);
+					assert((ramp_stats.min[c] >= 0) && (ramp_stats.max[c] <= 1) && (ramp_stats.stddev[c] > 0));
+				}
+				FreeImage_Unload(ramp);
+			}
+
+			FreeImage_Unload(src);
+			FreeImage_Unload(ref);
+		}
+
+		// 16-bit curve: an inverted ramp is an inversion, an identity ramp changes nothing
+		WORD *LUT16 = (WORD*)malloc(65536 * sizeof(WORD));
+		assert(LUT16 != NULL);
+		src = createSampleRamp(FIT_RGBA16, w, h, 0);
+		dst = FreeImage_Clone(src);
+		for(unsigned i = 0; i < 65536; i++) {
+			LUT16[i] = (WORD)i;
+		}
+		bResult = FreeImage_AdjustCurve16(dst, LUT16, FICC_RGB);
+		assert(bResult);
+		for(unsigned i = 0; i < 65536; i++) {
+			LUT16[i] = (WORD)(65535 - i);
+		}
+		bResult = FreeImage_AdjustCurve16(dst, LUT16, FICC_RGB);
+		assert(bResult);
+		bResult = FreeImage_AdjustCurve16(dst, LUT16, FICC_ALPHA);
+		assert(bResult);
+		bResult = FreeImage_Invert(src);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			assert(memcmp(FreeImage_GetScanLine(src, y), FreeImage_GetScanLine(dst, y), FreeImage_GetLine(src)) == 0);
+		}
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+		free(LUT16);
+	}
+
+	// float statistics of an image with fewer rows than threads
+	{
+		const unsigned w = 300000, h = 2;
+		FIBITMAP *dib = FreeImage_AllocateT(FIT_FLOAT, w, h);
+		for(unsigned y = 0; y < h; y++) {
+			float *bits = (float*)FreeImage_GetScanLine(dib, y);
+			for(unsigned x = 0; x < w; x++) {
+				bits[x] = 5 + (x % 100) / 100.0F;
+			}
+		}
+		FISTATISTICS stats;
+		bResult = FreeImage_GetStatistics(dib, &stats);
+		assert(bResult);
+		assert((stats.min[0] == 5) && (fabs(stats.max[0] - 5.99) < 1e-6));
+		assert(fabs(stats.mean[0] - 5.495) < 1e-6);
+		FreeImage_Unload(dib);
+	}
+}
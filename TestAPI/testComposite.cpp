@@ -0,0 +1,456 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Create a 32-bit image filled with pseudo-random colours and alpha
+*/
+static FIBITMAP* 
+createRandom32(unsigned width, unsigned height, unsigned seed) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32);
+	assert(dib != NULL);
+	srand(seed);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < 4 * width; x++) {
+			bits[x] = (BYTE)(rand() & 0xFF);
+		}
+	}
+	return dib;
+}
+
+/**
+Convert a 32-bit image to FIT_RGBAF, in [0..1]
+*/
+static FIBITMAP* 
+createRGBAF(FIBITMAP *dib) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	FIBITMAP *dst = FreeImage_AllocateT(FIT_RGBAF, width, height);
+	assert(dst != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(dib, y);
+		FIRGBAF *dst_bits = (FIRGBAF*)FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++, src_bits += 4) {
+			dst_bits[x].red = src_bits[FI_RGBA_RED] / 255.0F;
+			dst_bits[x].green = src_bits[FI_RGBA_GREEN] / 255.0F;
+			dst_bits[x].blue = src_bits[FI_RGBA_BLUE] / 255.0F;
+			dst_bits[x].alpha = src_bits[FI_RGBA_ALPHA] / 255.0F;
+		}
+	}
+	return dst;
+}
+
+/**
+Create a FIT_RGB16 or FIT_RGBA16 image filled with pseudo-random samples, 
+alpha being also fully transparent or opaque on some pixels
+*/
+static FIBITMAP* 
+createRandom16(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height, unsigned seed) {
+	FIBITMAP *dib = FreeImage_AllocateT(image_type, width, height);
+	assert(dib != NULL);
+	const unsigned samples = (image_type == FIT_RGBA16) ? 4 : 3;
+	srand(seed);
+	for(unsigned y = 0; y < height; y++) {
+		WORD *bits = (WORD*)FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++, bits += samples) {
+			for(unsigned c = 0; c < samples; c++) {
+				bits[c] = (WORD)(((rand() & 0xFF) << 8) | (rand() & 0xFF));
+			}
+			if((samples == 4) && (x % 7 == 0)) {
+				bits[3] = (x % 14 == 0) ? 0 : 65535;
+			}
+		}
+	}
+	return dib;
+}
+
+/**
+Convert a value in [0..1] to a 16-bit sample, rounded and clamped
+*/
+static int 
+toWord(double value) {
+	return (value <= 0) ? 0 : ((value >= 1) ? 65535 : (int)floor(value * 65535 + 0.5));
+}
+
+/**
+Check FreeImage_AlphaComposite of a FIT_RGBA16 source into a FIT_RGB16 or FIT_RGBA16 destination 
+against the Porter-Duff equations, computed in double precision
+*/
+static void 
+checkAlphaComposite16(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COMPOSITE_OP op, BOOL premultiplied) {
+	BOOL bResult = FALSE;
+
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const BOOL dst_alpha = (FreeImage_GetImageType(dst) == FIT_RGBA16);
+	const unsigned dst_samples = dst_alpha ? 4 : 3;
+
+	FIBITMAP *result = FreeImage_Clone(dst);
+	bResult = FreeImage_AlphaComposite(result, src, 0, 0, op, premultiplied);
+	assert(bResult);
+
+	for(unsigned y = 0; y < height; y++) {
+		const WORD *s = (const WORD*)FreeImage_GetScanLine(src, y);
+		const WORD *d = (const WORD*)FreeImage_GetScanLine(dst, y);
+		const WORD *r = (const WORD*)FreeImage_GetScanLine(result, y);
+		for(unsigned x = 0; x < width; x++, s += 4, d += dst_samples, r += dst_samples) {
+			const double sa = s[3] / 65535.0;
+			const double da = dst_alpha ? d[3] / 65535.0 : 1;
+
+			// result = source * fa + destination * fb, on premultiplied colours
+			double fa, fb;
+			switch(op) {
+				case FICO_CLEAR:	fa = 0;			fb = 0;			break;
+				case FICO_SRC:		fa = 1;			fb = 0;			break;
+				case FICO_DST:		fa = 0;			fb = 1;			break;
+				case FICO_SRC_OVER:	fa = 1;			fb = 1 - sa;	break;
+				case FICO_DST_OVER:	fa = 1 - da;	fb = 1;			break;
+				case FICO_SRC_IN:	fa = da;		fb = 0;			break;
+				case FICO_DST_IN:	fa = 0;			fb = sa;		break;
+				case FICO_SRC_OUT:	fa = 1 - da;	fb = 0;			break;
+				case FICO_DST_OUT:	fa = 0;			fb = 1 - sa;	break;
+				case FICO_SRC_ATOP:	fa = da;		fb = 1 - sa;	break;
+				case FICO_DST_ATOP:	fa = 1 - da;	fb = sa;		break;
+				default:			fa = 1 - da;	fb = 1 - sa;	break;
+			}
+			const double oa = sa * fa + da * fb;
+			if(dst_alpha) {
+				assert(abs((int)r[3] - toWord(oa)) <= 1);
+			}
+			// straight colours of a nearly transparent result are not accurate
+			if(!premultiplied && dst_alpha && (oa < 1.0 / 16)) {
+				continue;
+			}
+			for(unsigned c = 0; c < 3; c++) {
+				const double ks = premultiplied ? 1 : sa;
+				const double kd = premultiplied ? 1 : da;
+				double v = (s[c] / 65535.0) * ks * fa + (d[c] / 65535.0) * kd * fb;
+				if(!premultiplied && dst_alpha) {
+					v = (oa > 0) ? v / oa : 0;
+				}
+				assert(abs((int)r[c] - toWord(v)) <= 1);
+			}
+		}
+	}
+
+	FreeImage_Unload(result);
+}
+
+/**
+Check FreeImage_Composite against the original per pixel algorithm: 
+output = (alpha * foreground + (255 - alpha) * background) >> 8, 
+the foreground or the background being copied when alpha is 255 or 0
+*/
+static void 
+checkComposite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP *bg) {
+	const unsigned width = FreeImage_GetWidth(fg);
+	const unsigned height = FreeImage_GetHeight(fg);
+	const unsigned bpp = FreeImage_GetBPP(fg);
+
+	FIBITMAP *composite = FreeImage_Composite(fg, useFileBkg, appBkColor, bg);
+	assert(composite != NULL);
+	assert((FreeImage_GetBPP(composite) == 24) && (FreeImage_GetWidth(composite) == width) && (FreeImage_GetHeight(composite) == height));
+
+	// background colour, if any
+	RGBQUAD bkc = { 0, 0, 0, 0 };
+	BOOL has_bkc = FALSE;
+	if(useFileBkg && FreeImage_HasBackgroundColor(fg)) {
+		FreeImage_GetBackgroundColor(fg, &bkc);
+		has_bkc = TRUE;
+	} else if(appBkColor) {
+		bkc = *appBkColor;
+		has_bkc = TRUE;
+	}
+
+	const RGBQUAD *pal = FreeImage_GetPalette(fg);
+	const BYTE *trns = FreeImage_GetTransparencyTable(fg);
+	const BOOL transparent = FreeImage_IsTransparent(fg);
+
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *f = FreeImage_GetScanLine(fg, y);
+		const BYTE *b = bg ? FreeImage_GetScanLine(bg, y) : NULL;
+		const BYTE *o = FreeImage_GetScanLine(composite, y);
+		for(unsigned x = 0; x < width; x++, o += 3) {
+			BYTE fgc[3], bgc[3];
+			unsigned alpha;
+			if(bpp == 8) {
+				fgc[FI_RGBA_BLUE] = pal[f[x]].rgbBlue;
+				fgc[FI_RGBA_GREEN] = pal[f[x]].rgbGreen;
+				fgc[FI_RGBA_RED] = pal[f[x]].rgbRed;
+				alpha = transparent ? trns[f[x]] : 255;
+			} else {
+				fgc[FI_RGBA_BLUE] = f[4 * x + FI_RGBA_BLUE];
+				fgc[FI_RGBA_GREEN] = f[4 * x + FI_RGBA_GREEN];
+				fgc[FI_RGBA_RED] = f[4 * x + FI_RGBA_RED];
+				alpha = f[4 * x + FI_RGBA_ALPHA];
+			}
+			if(has_bkc) {
+				bgc[FI_RGBA_BLUE] = bkc.rgbBlue;
+				bgc[FI_RGBA_GREEN] = bkc.rgbGreen;
+				bgc[FI_RGBA_RED] = bkc.rgbRed;
+			} else if(b) {
+				memcpy(bgc, b + 3 * x, 3);
+			} else {
+				// checkerboard
+				const BYTE c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) ? 192 : 255;
+				bgc[0] = bgc[1] = bgc[2] = c;
+			}
+			for(unsigned c = 0; c < 3; c++) {
+				const unsigned expected = (alpha == 0) ? bgc[c] : ((alpha == 255) ? fgc[c] : ((alpha * fgc[c] + (255 - alpha) * bgc[c]) >> 8));
+				assert(o[c] == expected);
+			}
+		}
+	}
+
+	FreeImage_Unload(composite);
+}
+
+// ----------------------------------------------------------
+
+void testComposite(unsigned width, unsigned height) {
+	BOOL bResult = FALSE;
+	FIBITMAP *invalid = NULL;
+
+	printf("testComposite ...\n");
+
+	const unsigned sizes[][2] = { { width, height }, { 37, 21 } };
+
+	for(int j = 0; j < 2; j++) {
+		const unsigned w = sizes[j][0];
+		const unsigned h = sizes[j][1];
+
+		FIBITMAP *src = createRandom32(w, h, 1);
+		FIBITMAP *dst = createRandom32(w, h, 2);
+
+		// premultiplication matches (c * a + 127) / 255
+		FIBITMAP *premul = FreeImage_Clone(src);
+		bResult = FreeImage_PreMultiplyWithAlpha(premul);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *s = FreeImage_GetScanLine(src, y);
+			const BYTE *p = FreeImage_GetScanLine(premul, y);
+			for(unsigned x = 0; x < w; x++, s += 4, p += 4) {
+				const unsigned a = s[FI_RGBA_ALPHA];
+				assert(p[FI_RGBA_ALPHA] == a);
+				for(unsigned c = 0; c < 3; c++) {
+					assert(p[c] == (s[c] * a + 127) / 255);
+				}
+			}
+		}
+
+		// source over into a 24-bit image matches (s * a + d * (255 - a) + 127) / 255
+		FIBITMAP *dst24 = FreeImage_ConvertTo24Bits(dst);
+		FIBITMAP *over = FreeImage_Clone(dst24);
+		bResult = FreeImage_AlphaComposite(over, src, 0, 0);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *s = FreeImage_GetScanLine(src, y);
+			const BYTE *d = FreeImage_GetScanLine(dst24, y);
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			for(unsigned x = 0; x < w; x++, s += 4, d += 3, o += 3) {
+				const unsigned a = s[FI_RGBA_ALPHA];
+				for(unsigned c = 0; c < 3; c++) {
+					assert(o[c] == (s[c] * a + d[c] * (255 - a) + 127) / 255);
+				}
+			}
+		}
+		FreeImage_Unload(over);
+
+		// premultiplied source over between 32-bit images
+		FIBITMAP *premul_dst = FreeImage_Clone(dst);
+		bResult = FreeImage_PreMultiplyWithAlpha(premul_dst);
+		assert(bResult);
+		over = FreeImage_Clone(premul_dst);
+		bResult = FreeImage_AlphaComposite(over, premul, 0, 0, FICO_SRC_OVER, TRUE);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *s = FreeImage_GetScanLine(premul, y);
+			const BYTE *d = FreeImage_GetScanLine(premul_dst, y);
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			for(unsigned x = 0; x < w; x++, s += 4, d += 4, o += 4) {
+				const unsigned a = s[FI_RGBA_ALPHA];
+				for(unsigned c = 0; c < 4; c++) {
+					const unsigned v = s[c] + (d[c] * (255 - a) + 127) / 255;
+					assert(o[c] == ((v > 255) ? 255 : v));
+				}
+			}
+		}
+		FreeImage_Unload(over);
+		FreeImage_Unload(premul_dst);
+
+		// operator identities
+		over = FreeImage_Clone(dst);
+		bResult = FreeImage_AlphaComposite(over, src, 0, 0, FICO_CLEAR);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			for(unsigned x = 0; x < 4 * w; x++) {
+				assert(o[x] == 0);
+			}
+		}
+		FreeImage_Unload(over);
+
+		over = FreeImage_Clone(dst);
+		bResult = FreeImage_AlphaComposite(over, src, 0, 0, FICO_DST);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *d = FreeImage_GetScanLine(dst, y);
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			for(unsigned x = 0; x < w; x++, d += 4, o += 4) {
+				assert(o[FI_RGBA_ALPHA] == d[FI_RGBA_ALPHA]);
+				if(d[FI_RGBA_ALPHA] != 0) {
+					for(unsigned c = 0; c < 3; c++) {
+						assert(abs((int)o[c] - (int)d[c]) <= 1);
+					}
+				}
+			}
+		}
+		FreeImage_Unload(over);
+
+		// float compositing agrees with the 8-bit one, Porter-Duff XOR
+		over = FreeImage_Clone(dst);
+		bResult = FreeImage_AlphaComposite(over, src, 0, 0, FICO_XOR);
+		assert(bResult);
+		FIBITMAP *src_f = createRGBAF(src);
+		FIBITMAP *over_f = createRGBAF(dst);
+		bResult = FreeImage_AlphaComposite(over_f, src_f, 0, 0, FICO_XOR);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			const FIRGBAF *f = (const FIRGBAF*)FreeImage_GetScanLine(over_f, y);
+			for(unsigned x = 0; x < w; x++, o += 4) {
+				assert(fabs(o[FI_RGBA_ALPHA] / 255.0 - f[x].alpha) < 1e-2);
+				if(o[FI_RGBA_ALPHA] >= 16) {
+					assert(fabs(o[FI_RGBA_RED] / 255.0 - f[x].red) < 1e-2);
+				}
+			}
+		}
+		FreeImage_Unload(over_f);
+		FreeImage_Unload(src_f);
+		FreeImage_Unload(over);
+
+		// clipping: a source partially outside the destination only touches the covered area
+		over = FreeImage_Clone(dst24);
+		bResult = FreeImage_AlphaComposite(over, src, (int)w / 2, -(int)h / 2, FICO_SRC);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *d = FreeImage_GetScanLine(dst24, y);
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			// rows are counted from the top, the source covers the top rows
+			const BOOL covered_row = (h - 1 - y) < h - h / 2;
+			for(unsigned x = 0; x < w; x++) {
+				if(!covered_row || (x < w / 2)) {
+					assert(memcmp(o + 3 * x, d + 3 * x, 3) == 0);
+				}
+			}
+		}
+		FreeImage_Unload(over);
+
+		// blended paste matches (s * a + d * (256 - a)) >> 8
+		FIBITMAP *src24 = FreeImage_ConvertTo24Bits(src);
+		over = FreeImage_Clone(dst24);
+		bResult = FreeImage_Paste(over, src24, 0, 0, 100);
+		assert(bResult);
+		for(unsigned y = 0; y < h; y++) {
+			const BYTE *s = FreeImage_GetScanLine(src24, y);
+			const BYTE *d = FreeImage_GetScanLine(dst24, y);
+			const BYTE *o = FreeImage_GetScanLine(over, y);
+			for(unsigned x = 0; x < 3 * w; x++) {
+				assert(o[x] == ((s[x] * 100 + d[x] * 156) >> 8));
+			}
+		}
+		FreeImage_Unload(over);
+		FreeImage_Unload(src24);
+
+		// FIT_RGBA16 into FIT_RGB16 and FIT_RGBA16, all the operators
+		{
+			FIBITMAP *src16 = createRandom16(FIT_RGBA16, w, h, 3);
+			FIBITMAP *dst16 = createRandom16(FIT_RGBA16, w, h, 4);
+			FIBITMAP *rgb16 = createRandom16(FIT_RGB16, w, h, 5);
+			for(int op = FICO_CLEAR; op <= FICO_XOR; op++) {
+				checkAlphaComposite16(dst16, src16, (FREE_IMAGE_COMPOSITE_OP)op, FALSE);
+				checkAlphaComposite16(rgb16, src16, (FREE_IMAGE_COMPOSITE_OP)op, FALSE);
+			}
+			bResult = FreeImage_PreMultiplyWithAlpha(src16);
+			assert(bResult);
+			bResult = FreeImage_PreMultiplyWithAlpha(dst16);
+			assert(bResult);
+			checkAlphaComposite16(dst16, src16, FICO_SRC_OVER, TRUE);
+			checkAlphaComposite16(dst16, src16, FICO_DST_ATOP, TRUE);
+			checkAlphaComposite16(rgb16, src16, FICO_SRC_OVER, TRUE);
+			bResult = FreeImage_AlphaComposite(dst24, src16, 0, 0);
+			assert(!bResult);
+			bResult = FreeImage_AlphaComposite(src16, src, 0, 0);
+			assert(!bResult);
+			FreeImage_Unload(rgb16);
+			FreeImage_Unload(dst16);
+			FreeImage_Unload(src16);
+		}
+
+		// FreeImage_Composite against a checkerboard, a colour, a background image and the file background colour
+		{
+			RGBQUAD app_color = { 40, 80, 120, 0 };
+			checkComposite(src, FALSE, NULL, NULL);
+			checkComposite(src, FALSE, &app_color, NULL);
+			checkComposite(src, FALSE, NULL, dst24);
+			checkComposite(src, TRUE, NULL, dst24);
+			FIBITMAP *fg = FreeImage_Clone(src);
+			RGBQUAD file_color = { 200, 100, 50, 0 };
+			bResult = FreeImage_SetBackgroundColor(fg, &file_color);
+			assert(bResult);
+			checkComposite(fg, TRUE, &app_color, dst24);
+			checkComposite(fg, FALSE, &app_color, dst24);
+			FreeImage_Unload(fg);
+
+			// 8-bit palette image with a transparency table
+			fg = FreeImage_ColorQuantize(dst24, FIQ_WUQUANT);
+			assert(fg != NULL);
+			BYTE table[256];
+			for(unsigned i = 0; i < 256; i++) {
+				table[i] = (BYTE)((i % 3 == 0) ? 0 : ((i % 3 == 1) ? 255 : 7 * i));
+			}
+			FreeImage_SetTransparencyTable(fg, table, 256);
+			checkComposite(fg, FALSE, NULL, dst24);
+			checkComposite(fg, FALSE, &app_color, NULL);
+			FreeImage_SetTransparent(fg, FALSE);
+			checkComposite(fg, FALSE, NULL, NULL);
+			FreeImage_Unload(fg);
+
+			// unsupported images
+			invalid = FreeImage_Composite(dst24, FALSE, NULL, NULL);
+			assert(invalid == NULL);
+			invalid = FreeImage_Composite(src, FALSE, NULL, src);
+			assert(invalid == NULL);
+		}
+
+		// unsupported combinations
+		bResult = FreeImage_AlphaComposite(dst24, dst24, 0, 0);
+		assert(!bResult);
+		bResult = FreeImage_AlphaComposite(dst, src, 0, 0, (FREE_IMAGE_COMPOSITE_OP)12);
+		assert(!bResult);
+
+		FreeImage_Unload(dst24);
+		FreeImage_Unload(premul);
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+	}
+}
@@ -174,6 +174,138 @@ void testLockDeleteMultiPage(const char *input) {
 
 // --------------------------------------------------------------------------
 
+void testAppendMultiPage(const char *input) {
+
+	BOOL bCreateNew = FALSE;
+	BOOL bReadOnly = FALSE;
+	BOOL bMemoryCache = TRUE;
+
+	struct stat buf;
+	int result = stat(input, &buf);
+	assert(result == 0);
+	const long src_size = (long)buf.st_size;
+
+	// Open src file (read/write, use memory cache)
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(input);
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(fif, input, bCreateNew, bReadOnly, bMemoryCache);
+	assert(src != NULL);
+
+	// get the page count
+	int count = FreeImage_GetPageCount(src);
+	assert(count > 0);
+
+	// append a copy of the first page
+	FIBITMAP *dib = FreeImage_LockPage(src, 0);
+	assert(dib != NULL);
+	FIBITMAP *clone = FreeImage_Clone(dib);
+	FreeImage_UnlockPage(src, dib, FALSE);
+
+	FreeImage_AppendPage(src, clone);
+
+	// Close src (only the new page is written)
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	result = stat(input, &buf);
+	assert((result == 0) && ((long)buf.st_size > src_size));
+
+	// check the result
+	src = FreeImage_OpenMultiBitmap(fif, input, bCreateNew, TRUE, bMemoryCache);
+	assert(src != NULL);
+	assert(FreeImage_GetPageCount(src) == count + 1);
+
+	dib = FreeImage_LockPage(src, count);
+	assert(dib != NULL);
+	assert(FreeImage_GetWidth(dib) == FreeImage_GetWidth(clone));
+	assert(FreeImage_GetHeight(dib) == FreeImage_GetHeight(clone));
+	FreeImage_UnlockPage(src, dib, FALSE);
+
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	FreeImage_Unload(clone);
+}
+
+// --------------------------------------------------------------------------
+
+void testAnimatedWebP(const char *src_filename, const char *dst_filename) {
+	const int frame_count = 3;
+	FIBITMAP *frames[frame_count];
+
+	// build opaque frames, so that lossless encoding gives them back exactly
+	FIBITMAP *src = FreeImage_Load(FreeImage_GetFileType(src_filename), src_filename, 0);
+	assert(src != NULL);
+	for(int k = 0; k < frame_count; k++) {
+		frames[k] = FreeImage_ConvertTo32Bits(src);
+		assert(frames[k] != NULL);
+		for(unsigned y = 0; y < FreeImage_GetHeight(frames[k]); y++) {
+			BYTE *bits = FreeImage_GetScanLine(frames[k], y);
+			for(unsigned x = 0; x < FreeImage_GetWidth(frames[k]); x++, bits += 4) {
+				bits[FI_RGBA_RED] ^= (BYTE)(k * 0x40);
+				bits[FI_RGBA_ALPHA] = 0xFF;
+			}
+		}
+		LONG frame_time = 40 * (k + 1);
+		FITAG *tag = FreeImage_CreateTag();
+		FreeImage_SetTagKey(tag, "FrameTime");
+		FreeImage_SetTagType(tag, FIDT_LONG);
+		FreeImage_SetTagCount(tag, 1);
+		FreeImage_SetTagLength(tag, 4);
+		FreeImage_SetTagValue(tag, &frame_time);
+		FreeImage_SetMetadata(FIMD_ANIMATION, frames[k], FreeImage_GetTagKey(tag), tag);
+		if(k == 0) {
+			LONG loop = 3;
+			FreeImage_SetTagKey(tag, "Loop");
+			FreeImage_SetTagValue(tag, &loop);
+			FreeImage_SetMetadata(FIMD_ANIMATION, frames[k], FreeImage_GetTagKey(tag), tag);
+		}
+		FreeImage_DeleteTag(tag);
+	}
+	FreeImage_Unload(src);
+
+	// write the animation
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_WEBP, dst_filename, TRUE, FALSE, FALSE);
+	assert(out != NULL);
+	for(int k = 0; k < frame_count; k++) {
+		FreeImage_AppendPage(out, frames[k]);
+	}
+	BOOL bResult = FreeImage_CloseMultiBitmap(out, WEBP_LOSSLESS | WEBP_FAST);
+	assert(bResult);
+
+	// read the frames, in order then backward
+	FIMULTIBITMAP *in = FreeImage_OpenMultiBitmap(FIF_WEBP, dst_filename, FALSE, TRUE, FALSE);
+	assert(in != NULL);
+	assert(FreeImage_GetPageCount(in) == frame_count);
+	const int pages[] = { 0, 1, 2, 1, 0 };
+	for(int i = 0; i < (int)(sizeof(pages) / sizeof(pages[0])); i++) {
+		const int k = pages[i];
+		FIBITMAP *dib = FreeImage_LockPage(in, k);
+		assert(dib != NULL);
+		assert(sameImage(dib, frames[k]));
+		FITAG *tag = NULL;
+		bResult = FreeImage_GetMetadata(FIMD_ANIMATION, dib, "FrameTime", &tag);
+		assert(bResult);
+		assert(*(LONG*)FreeImage_GetTagValue(tag) == 40 * (k + 1));
+		if(k == 0) {
+			bResult = FreeImage_GetMetadata(FIMD_ANIMATION, dib, "Loop", &tag);
+			assert(bResult);
+			assert(*(LONG*)FreeImage_GetTagValue(tag) == 3);
+		}
+		FreeImage_UnlockPage(in, dib, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(in, 0);
+
+	// a single image load gives the first frame
+	FIBITMAP *dib = FreeImage_Load(FIF_WEBP, dst_filename, 0);
+	assert(dib != NULL);
+	assert(sameImage(dib, frames[0]));
+	FreeImage_Unload(dib);
+
+	for(int k = 0; k < frame_count; k++) {
+		FreeImage_Unload(frames[k]);
+	}
+}
+
+// --------------------------------------------------------------------------
+
 void testMultiPage(const char *lpszPathName) {
 	printf("testMultiPage ...\n");
 
@@ -188,6 +320,13 @@ void testMultiPage(const char *lpszPathName) {
 	// test multipage lock & delete
 	testLockDeleteMultiPage("clone.tif");
 
+	// test multipage append
+	testAppendMultiPage("clone.tif");
+	testAppendMultiPage("sample.gif");
+
 	// test multipage cache
 	testMPageCache(lpszPathName, "mpages.tif");
+
+	// test animated WebP
+	testAnimatedWebP(lpszPathName, "animated.webp");
 }
@@ -137,6 +137,87 @@ BOOL testSaveMultiBitmapToMemory(const char *input, const char *output, int outp
 
 // --------------------------------------------------------------------------
 
+static void
+copyFile(const char *input, const char *output) {
+	BYTE buffer[4096];
+	FILE *in = fopen(input, "rb");
+	FILE *out = fopen(output, "wb");
+	assert(in && out);
+	size_t count;
+	while((count = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		const size_t written = fwrite(buffer, 1, count, out);
+		assert(written == count);
+	}
+	fclose(in);
+	fclose(out);
+}
+
+void testAppendMultiBitmapToMemory(const char *input, const char *output) {
+	BOOL bSuccess;
+
+	// the stream already holds some data: the document does not start at offset 0
+	const BYTE header[13] = { 'F', 'r', 'e', 'e', 'I', 'm', 'a', 'g', 'e', 0, 1, 2, 3 };
+
+	// work on a copy, closing the multipage bitmap applies the changes to the file
+	copyFile(input, output);
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(output);
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(fif, output, FALSE, FALSE, TRUE);
+	assert(src != NULL);
+	const int count = FreeImage_GetPageCount(src);
+
+	// append a copy of the first page: only the new page is encoded
+	FIBITMAP *dib = FreeImage_LockPage(src, 0);
+	assert(dib != NULL);
+	FIBITMAP *clone = FreeImage_Clone(dib);
+	FreeImage_UnlockPage(src, dib, FALSE);
+	FreeImage_AppendPage(src, clone);
+
+	FIMEMORY *dst_memory = FreeImage_OpenMemory();
+	const unsigned written = FreeImage_WriteMemory(header, 1, sizeof(header), dst_memory);
+	assert(written == sizeof(header));
+	bSuccess = FreeImage_SaveMultiBitmapToMemory(fif, src, dst_memory, 0);
+	assert(bSuccess);
+	bSuccess = FreeImage_CloseMultiBitmap(src, 0);
+	assert(bSuccess);
+
+	BYTE *mem_buffer = NULL;
+	DWORD size_in_bytes = 0;
+	bSuccess = FreeImage_AcquireMemory(dst_memory, &mem_buffer, &size_in_bytes);
+	assert(bSuccess);
+	assert((size_in_bytes > sizeof(header)) && (memcmp(mem_buffer, header, sizeof(header)) == 0));
+
+	// the document saved after the header and the file updated on close both hold the new page
+	FIMEMORY *doc_memory = FreeImage_OpenMemory(mem_buffer + sizeof(header), size_in_bytes - sizeof(header));
+	FIMULTIBITMAP *mem_doc = FreeImage_LoadMultiBitmapFromMemory(fif, doc_memory, 0);
+	FIMULTIBITMAP *file_doc = FreeImage_OpenMultiBitmap(fif, output, FALSE, TRUE, TRUE);
+	assert(mem_doc && file_doc);
+
+	FIMULTIBITMAP *docs[2] = { mem_doc, file_doc };
+	for(int k = 0; k < 2; k++) {
+		assert(FreeImage_GetPageCount(docs[k]) == count + 1);
+		for(int page = 0; page <= count; page++) {
+			dib = FreeImage_LockPage(docs[k], page);
+			assert(dib != NULL);
+			if(page == count) {
+				assert(FreeImage_GetWidth(dib) == FreeImage_GetWidth(clone));
+				assert(FreeImage_GetHeight(dib) == FreeImage_GetHeight(clone));
+				for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+					assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(clone, y), FreeImage_GetLine(clone)) == 0);
+				}
+			}
+			FreeImage_UnlockPage(docs[k], dib, FALSE);
+		}
+		FreeImage_CloseMultiBitmap(docs[k], 0);
+	}
+
+	FreeImage_CloseMemory(doc_memory);
+	FreeImage_CloseMemory(dst_memory);
+	FreeImage_Unload(clone);
+}
+
+// --------------------------------------------------------------------------
+
 static BOOL  
 loadBuffer(const char *lpszPathName, BYTE **buffer, DWORD *length) {
 	struct stat file_info;
@@ -268,4 +349,8 @@ void testMultiPageMemory(const char *lpszPathName) {
 	bSuccess = testMemoryStreamMultiPageOpenSave("sample.tif", "mpage-mstream-redirect.tif", 0, 0);
 	assert(bSuccess);
 
+	// test the append path of FreeImage_SaveMultiBitmapToMemory, at a non-zero stream offset
+	testAppendMultiBitmapToMemory("sample.tif", "mpage-mstream-append.tif");
+	testAppendMultiBitmapToMemory("sample.gif", "mpage-mstream-append.gif");
+
 }
@@ -146,3 +146,605 @@ void testMemIO(const char *lpszPathName) {
 	testAcquireMemIO(lpszPathName);
 }
 
+/**
+Save images of various types to PNG with each encoder setting and check that they load back unchanged
+*/
+void testSavePNGMemIO(unsigned width, unsigned height) {
+	const int flags[] = { PNG_DEFAULT, PNG_Z_FASTEST, PNG_PARALLEL, PNG_PARALLEL | PNG_Z_FASTEST, PNG_PARALLEL | PNG_Z_BEST_COMPRESSION, PNG_PARALLEL | PNG_Z_NO_COMPRESSION };
+
+	printf("testSavePNGMemIO ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+
+	FIBITMAP *images[5];
+	images[0] = FreeImage_Threshold(zone, 128);
+	images[1] = FreeImage_Clone(zone);
+	images[2] = FreeImage_ConvertTo24Bits(zone);
+	images[3] = FreeImage_ConvertTo32Bits(zone);
+	FreeImage_SetChannel(images[3], zone, FICC_ALPHA);
+	images[4] = FreeImage_ConvertToType(zone, FIT_RGB16);
+
+	for(int i = 0; i < 5; i++) {
+		FIBITMAP *dib = images[i];
+		assert(dib != NULL);
+		const unsigned line = FreeImage_GetLine(dib);
+
+		for(int j = 0; j < (int)(sizeof(flags) / sizeof(flags[0])); j++) {
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			BOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, flags[j]);
+			assert(bResult);
+
+			FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+			FIBITMAP *check = FreeImage_LoadFromMemory(FIF_PNG, hmem, PNG_DEFAULT);
+			assert(check != NULL);
+			assert(FreeImage_GetImageType(check) == FreeImage_GetImageType(dib));
+			assert(FreeImage_GetBPP(check) == FreeImage_GetBPP(dib));
+			for(unsigned y = 0; y < height; y++) {
+				assert(memcmp(FreeImage_GetScanLine(check, y), FreeImage_GetScanLine(dib, y), line) == 0);
+			}
+
+			FreeImage_Unload(check);
+			FreeImage_CloseMemory(hmem);
+		}
+
+		FreeImage_Unload(dib);
+	}
+
+	FreeImage_Unload(zone);
+}
+
+// ----------------------------------------------------------
+
+struct PreviewState {
+	unsigned passes;		// number of previews received
+	unsigned stop_after;	// number of previews to accept before stopping
+	BOOL complete;			// TRUE if every preview was a complete image of the right size
+	unsigned width;
+	unsigned height;
+};
+
+static BOOL DLL_CALLCONV 
+onPreview(void *user, FIBITMAP *dib, unsigned pass, void *more) {
+	PreviewState *state = (PreviewState*)user;
+	state->complete = state->complete && (pass == state->passes) && FreeImage_HasPixels(dib)
+		&& (FreeImage_GetWidth(dib) == state->width) && (FreeImage_GetHeight(dib) == state->height);
+	state->passes++;
+	return (state->passes < state->stop_after) ? TRUE : FALSE;
+}
+
+/**
+Load an image from memory with a preview callback
+@return Returns the loaded image
+*/
+static FIBITMAP* 
+loadWithPreview(FREE_IMAGE_FORMAT fif, FIMEMORY *hmem, PreviewState *state) {
+	FreeImageCB cb;
+	memset(&cb, 0, sizeof(FreeImageCB));
+	cb.user = state;
+	cb.onPreview = onPreview;
+
+	FreeImageLoadArgs args;
+	memset(&args, 0, sizeof(FreeImageLoadArgs));
+	args.cb = &cb;
+
+	FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+	return FreeImage_LoadFromMemoryAdv(fif, hmem, &args);
+}
+
+void testProgressiveLoadMemIO(unsigned width, unsigned height) {
+	const FREE_IMAGE_FORMAT fif[] = { FIF_PNG, FIF_JPEG };
+	const int flags[] = { PNG_INTERLACED, JPEG_PROGRESSIVE | JPEG_QUALITYGOOD };
+
+	printf("testProgressiveLoadMemIO ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *dib = FreeImage_ConvertTo24Bits(zone);
+	assert(dib != NULL);
+	const unsigned line = FreeImage_GetLine(dib);
+
+	for(int i = 0; i < (int)(sizeof(fif) / sizeof(fif[0])); i++) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(fif[i], dib, hmem, flags[i]);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *reference = FreeImage_LoadFromMemory(fif[i], hmem, 0);
+		assert(reference != NULL);
+
+		// all passes: the final image is the same as the one of a normal load
+
+		PreviewState state = { 0, (unsigned)-1, TRUE, width, height };
+		FIBITMAP *check = loadWithPreview(fif[i], hmem, &state);
+		assert(check != NULL);
+		assert(state.complete && (state.passes > 0));
+		if(fif[i] == FIF_PNG) {
+			assert(state.passes == 6);
+		}
+		for(unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(check, y), FreeImage_GetScanLine(reference, y), line) == 0);
+		}
+		FreeImage_Unload(check);
+
+		// early stop after the first pass: a complete, lower quality, image is returned
+
+		PreviewState first = { 0, 1, TRUE, width, height };
+		check = loadWithPreview(fif[i], hmem, &first);
+		assert(check != NULL);
+		assert(first.complete && (first.passes == 1));
+		assert(FreeImage_GetWidth(check) == width && FreeImage_GetHeight(check) == height);
+		FreeImage_Unload(check);
+
+		FreeImage_Unload(reference);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(dib);
+	FreeImage_Unload(zone);
+}
+
+// ----------------------------------------------------------
+
+// sub-rectangle loaded by the round trip tests, in top-down coordinates
+static const int ROUND_TRIP_LEFT = 37, ROUND_TRIP_TOP = 21, ROUND_TRIP_RIGHT = 237, ROUND_TRIP_BOTTOM = 421;
+
+/**
+Save an image to a memory stream with lossless settings, then check that loading gives back the whole image 
+and the ROUND_TRIP_xxx sub-rectangle.
+@param fif Format to save to
+@param dib Image to save
+@param flags Save flags
+@param threads Number of decoding threads used by the sub-rectangle load
+@param load_args Format specific load arguments (FreeImageEXRLoadArgs or FreeImageWebPLoadArgs), receives the sub-rectangle arguments
+@param args Receives the load arguments, pointing to load_args
+@return Returns the memory stream, to be closed by the caller
+*/
+template <class LoadArgs> static FIMEMORY* 
+checkLosslessRoundTrip(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags, int threads, LoadArgs *load_args, FreeImageLoadArgs *args) {
+	const int left = ROUND_TRIP_LEFT, top = ROUND_TRIP_TOP, right = ROUND_TRIP_RIGHT, bottom = ROUND_TRIP_BOTTOM;
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	BOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, flags);
+	assert(bResult);
+
+	// whole image
+
+	FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+	FIBITMAP *check = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(check != NULL);
+	assert((FreeImage_GetImageType(check) == FreeImage_GetImageType(dib)) && (FreeImage_GetBPP(check) == FreeImage_GetBPP(dib)));
+	for(unsigned y = 0; y < height; y++) {
+		assert(memcmp(FreeImage_GetScanLine(check, y), FreeImage_GetScanLine(dib, y), FreeImage_GetLine(dib)) == 0);
+	}
+	FreeImage_Unload(check);
+
+	// sub-rectangle
+
+	memset(load_args, 0, sizeof(LoadArgs));
+	load_args->format = fif;
+	load_args->threads = threads;
+	load_args->left = left;
+	load_args->top = top;
+	load_args->width = right - left;
+	load_args->height = bottom - top;
+
+	memset(args, 0, sizeof(FreeImageLoadArgs));
+	args->more = load_args;
+
+	FIBITMAP *crop = FreeImage_Copy(dib, left, top, right, bottom);
+	assert(crop != NULL);
+
+	FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+	check = FreeImage_LoadFromMemoryAdv(fif, hmem, args);
+	assert(check != NULL);
+	assert(FreeImage_GetWidth(check) == FreeImage_GetWidth(crop));
+	assert(FreeImage_GetHeight(check) == FreeImage_GetHeight(crop));
+	for(unsigned y = 0; y < FreeImage_GetHeight(crop); y++) {
+		assert(memcmp(FreeImage_GetScanLine(check, y), FreeImage_GetScanLine(crop, y), FreeImage_GetLine(crop)) == 0);
+	}
+	FreeImage_Unload(check);
+	FreeImage_Unload(crop);
+
+	return hmem;
+}
+
+// ----------------------------------------------------------
+
+void testSaveEXRMemIO(unsigned width, unsigned height) {
+	const int flags[] = { EXR_FLOAT | EXR_ZIP, EXR_FLOAT | EXR_PIZ | EXR_TILED, EXR_FLOAT | EXR_ZIP | EXR_TILE_SIZE(100) };
+
+	printf("testSaveEXRMemIO ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *dib = FreeImage_ConvertToType(zone, FIT_RGBAF);
+	assert(dib != NULL);
+
+	// whole image with automatic threading, sub-rectangle with 4 threads
+	for(int j = 0; j < (int)(sizeof(flags) / sizeof(flags[0])); j++) {
+		FreeImageEXRLoadArgs exr_args;
+		FreeImageLoadArgs args;
+		FIMEMORY *hmem = checkLosslessRoundTrip(FIF_EXR, dib, flags[j], 4, &exr_args, &args);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// half samples, scanline and tiled
+	const int half_flags[] = { EXR_DEFAULT, EXR_ZIP | EXR_TILED };
+	for(int j = 0; j < (int)(sizeof(half_flags) / sizeof(half_flags[0])); j++) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_EXR, dib, hmem, half_flags[j]);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_EXR, hmem, 0);
+		assert(check != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			const float *src_bits = (float*)FreeImage_GetScanLine(dib, y);
+			const float *check_bits = (float*)FreeImage_GetScanLine(check, y);
+			for(unsigned x = 0; x < 4 * width; x++) {
+				// half has an 11-bit mantissa
+				assert(fabs(check_bits[x] - src_bits[x]) <= src_bits[x] / 1024);
+			}
+		}
+		FreeImage_Unload(check);
+
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(dib);
+	FreeImage_Unload(zone);
+}
+
+// ----------------------------------------------------------
+
+void testSaveWebPMemIO(unsigned width, unsigned height) {
+	const int lossless_flags[] = { WEBP_LOSSLESS, WEBP_LOSSLESS | WEBP_FAST, WEBP_LOSSLESS | WEBP_BEST | WEBP_LOW_MEMORY };
+	const int lossy_flags[] = { 75 | WEBP_FAST, 90 | WEBP_BEST, 50 | WEBP_MULTITHREAD | WEBP_METHOD(4) | WEBP_PASS(2) | WEBP_SEGMENTS(2) };
+
+	printf("testSaveWebPMemIO ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *dib = FreeImage_ConvertTo24Bits(zone);
+	assert(dib != NULL);
+
+	// whole image, sub-rectangle on the calling thread only
+	for(int j = 0; j < (int)(sizeof(lossless_flags) / sizeof(lossless_flags[0])); j++) {
+		FreeImageWebPLoadArgs webp_args;
+		FreeImageLoadArgs args;
+		FIMEMORY *hmem = checkLosslessRoundTrip(FIF_WEBP, dib, lossless_flags[j], 1, &webp_args, &args);
+
+		// scaled sub-rectangle, keeping the aspect ratio
+
+		webp_args.scaled_width = webp_args.width / 2;
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemoryAdv(FIF_WEBP, hmem, &args);
+		assert(check != NULL);
+		assert(FreeImage_GetWidth(check) == (unsigned)webp_args.width / 2);
+		assert(FreeImage_GetHeight(check) == (unsigned)webp_args.height / 2);
+		FreeImage_Unload(check);
+
+		// requested size, header only
+
+		memset(&args, 0, sizeof(FreeImageLoadArgs));
+		args.flags = FIF_LOAD_NOPIXELS;
+		args.option = width / 4;
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		check = FreeImage_LoadFromMemoryAdv(FIF_WEBP, hmem, &args);
+		assert(check != NULL);
+		assert(!FreeImage_HasPixels(check));
+		assert((FreeImage_GetWidth(check) == width / 4) || (FreeImage_GetHeight(check) == height / 4));
+		FreeImage_Unload(check);
+
+		FreeImage_CloseMemory(hmem);
+	}
+
+	for(int j = 0; j < (int)(sizeof(lossy_flags) / sizeof(lossy_flags[0])); j++) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_WEBP, dib, hmem, lossy_flags[j]);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_WEBP, hmem, 0);
+		assert(check != NULL);
+		assert(FreeImage_GetWidth(check) == width);
+		assert(FreeImage_GetHeight(check) == height);
+		FreeImage_Unload(check);
+
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(dib);
+	FreeImage_Unload(zone);
+}
+
+/**
+Get the largest difference between two 32-bit images, for the RGB channels and for the alpha channel.
+Pixels which are fully transparent in the second image are ignored for the RGB channels.
+*/
+static void
+getMaxError32(FIBITMAP *dib1, FIBITMAP *dib2, int *color_error, int *alpha_error) {
+	*color_error = 0;
+	*alpha_error = 0;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		const BYTE *bits1 = FreeImage_GetScanLine(dib1, y);
+		const BYTE *bits2 = FreeImage_GetScanLine(dib2, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(dib1); x++, bits1 += 4, bits2 += 4) {
+			for(int c = 0; (c < 3) && (bits2[FI_RGBA_ALPHA] != 0); c++) {
+				const int error = abs((int)bits1[c] - (int)bits2[c]);
+				if(error > *color_error) {
+					*color_error = error;
+				}
+			}
+			const int error = abs((int)bits1[FI_RGBA_ALPHA] - (int)bits2[FI_RGBA_ALPHA]);
+			if(error > *alpha_error) {
+				*alpha_error = error;
+			}
+		}
+	}
+}
+
+void testSaveDDSMemIO(unsigned width, unsigned height) {
+	printf("testSaveDDSMemIO ...\n");
+
+	// smooth gradients, with a size which is not a multiple of the 4x4 blocks
+	width -= 1;
+	height -= 3;
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			bits[FI_RGBA_RED] = (BYTE)((x * 255) / width);
+			bits[FI_RGBA_GREEN] = (BYTE)((y * 255) / height);
+			bits[FI_RGBA_BLUE] = (BYTE)(((x + y) * 255) / (width + height));
+			bits[FI_RGBA_ALPHA] = (BYTE)(255 - (x * 255) / width);
+		}
+	}
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib);
+	assert(dib24 != NULL);
+
+	const int flags[] = { DDS_DEFAULT, DDS_FAST, DDS_BC1, DDS_BC1 | DDS_FAST };
+	for(int j = 0; j < 2 * (int)(sizeof(flags) / sizeof(flags[0])); j++) {
+		const BOOL is24 = (j & 1);
+		const int save_flags = flags[j / 2];
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_DDS, is24 ? dib24 : dib, hmem, save_flags);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(check != NULL);
+		assert(FreeImage_GetBPP(check) == 32);
+		assert(FreeImage_GetWidth(check) == width);
+		assert(FreeImage_GetHeight(check) == height);
+
+		int color_error, alpha_error;
+		if(is24) {
+			// opaque
+			FIBITMAP *opaque = FreeImage_ConvertTo32Bits(dib24);
+			getMaxError32(opaque, check, &color_error, &alpha_error);
+			FreeImage_Unload(opaque);
+		} else {
+			getMaxError32(dib, check, &color_error, &alpha_error);
+		}
+		assert(color_error <= 8);
+		if(is24) {
+			assert(alpha_error == 0);
+		} else if(save_flags & DDS_BC1) {
+			// punch-through alpha
+			assert(alpha_error <= 128);
+		} else {
+			assert(alpha_error <= 4);
+		}
+
+		FreeImage_Unload(check);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib);
+}
+
+/**
+Write the header of a DDS file holding a single compressed surface
+@param hmem Memory stream
+@param width Image width
+@param height Image height
+@param fourcc Pixel format FourCC
+@param dxgi_format DXGI format of the extended header, written when the FourCC is DX10
+*/
+static void 
+writeDDSHeader(FIMEMORY *hmem, unsigned width, unsigned height, const char *fourcc, DWORD dxgi_format) {
+	BYTE header[148];
+	memset(header, 0, sizeof(header));
+	const bool dx10 = (memcmp(fourcc, "DX10", 4) == 0);
+	const DWORD fields[][2] = {
+		{ 4, 124 },			// dwSize
+		{ 8, 0x81007 },		// DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE
+		{ 12, height },
+		{ 16, width },
+		{ 76, 32 },			// ddspf.dwSize
+		{ 80, 0x4 },		// DDPF_FOURCC
+		{ 108, 0x1000 },	// DDSCAPS_TEXTURE
+		{ 128, dxgi_format },
+		{ 132, 3 },			// D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		{ 140, 1 }			// arraySize
+	};
+	for(unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		for(unsigned k = 0; k < 4; k++) {
+			header[fields[i][0] + k] = (BYTE)(fields[i][1] >> (8 * k));
+		}
+	}
+	memcpy(header, "DDS ", 4);
+	memcpy(header + 84, fourcc, 4);
+	FreeImage_WriteMemory(header, dx10 ? 148 : 128, 1, hmem);
+}
+
+/**
+Decode a row of known BCn blocks, then the same file truncated
+@param fourcc Pixel format FourCC
+@param dxgi_format DXGI format, when the FourCC is DX10
+@param blocks Encoded blocks
+@param block_size Size of a block, in bytes
+@param count Number of blocks
+@param expected Expected pixels, block after block, 16 pixels of samples each
+@param samples Number of samples per expected pixel
+*/
+static void 
+testLoadDDSBlocks(const char *fourcc, DWORD dxgi_format, const BYTE *blocks, unsigned block_size, unsigned count, const BYTE *expected, unsigned samples) {
+	const unsigned width = 4 * count;
+	const unsigned height = 4;
+
+	// the blocks form a single row, the last one is truncated
+	for(int truncated = 0; truncated < 2; truncated++) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		writeDDSHeader(hmem, width, height, fourcc, dxgi_format);
+		FreeImage_WriteMemory(blocks, block_size * count - (truncated ? block_size / 2 : 0), 1, hmem);
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		FreeImage_CloseMemory(hmem);
+		if(truncated) {
+			assert(dib == NULL);
+			continue;
+		}
+		assert(dib != NULL);
+		assert((FreeImage_GetWidth(dib) == width) && (FreeImage_GetHeight(dib) == height));
+
+		const unsigned bytespp = FreeImage_GetLine(dib) / width;
+		for(unsigned b = 0; b < count; b++) {
+			for(unsigned i = 0; i < 16; i++) {
+				// pixels of a block are given from top to bottom
+				const BYTE *pixel = FreeImage_GetScanLine(dib, height - 1 - i / 4) + (4 * b + i % 4) * bytespp;
+				const BYTE *ref = expected + (16 * b + i) * samples;
+				if(bytespp == 1) {
+					assert(pixel[0] == ref[0]);
+				} else {
+					assert((pixel[FI_RGBA_RED] == ref[0]) && (pixel[FI_RGBA_GREEN] == ref[1]));
+					assert(pixel[FI_RGBA_BLUE] == ((samples > 2) ? ref[2] : 0));
+					if(bytespp == 4) {
+						assert(pixel[FI_RGBA_ALPHA] == ref[3]);
+					}
+				}
+			}
+		}
+		FreeImage_Unload(dib);
+	}
+}
+
+void testLoadDDSBlocksMemIO() {
+	printf("testLoadDDSBlocksMemIO ...\n");
+
+	// BC4 blocks with 8 and with 6 interpolated values
+	const BYTE bc4_blocks[2][8] = {
+		{ 0xC8, 0x1E, 0x35, 0x42, 0x62, 0x06, 0x31, 0x38 },
+		{ 0x28, 0xDC, 0x65, 0xBA, 0x90, 0x01, 0xA5, 0xCC }
+	};
+	const BYTE bc4_expected[2][16] = {
+		{ 0x67, 0x4F, 0xC8, 0x1E, 0x7F, 0x7F, 0xC8, 0x97, 0x4F, 0xC8, 0x7F, 0xC8, 0x97, 0xC8, 0x4F, 0x1E },
+		{ 0xB8, 0x94, 0xDC, 0xB8, 0x70, 0xDC, 0x94, 0x94, 0xDC, 0x28, 0x94, 0x4C, 0x4C, 0xDC, 0x70, 0x00 }
+	};
+	testLoadDDSBlocks("ATI1", 0, bc4_blocks[0], 8, 2, bc4_expected[0], 1);
+
+	// BC5 block, red and green pixels
+	const BYTE bc5_blocks[1][16] = {
+		{ 0xFA, 0x0A, 0x41, 0xAD, 0x5B, 0xB5, 0x2D, 0xF5, 0x14, 0xB4, 0xD0, 0x06, 0x4B, 0xAC, 0xE1, 0xD8 }
+	};
+	const BYTE bc5_expected[1][32] = {
+		{ 0x0A, 0x14, 0xFA, 0x34, 0x71, 0x54, 0x4F, 0x54, 0xD8, 0x14, 0x2C, 0x00, 0x4F, 0x34, 0xD8, 0x34, 0x71, 0x74, 0x4F, 0x94, 0x4F, 0x00, 0x4F, 0x14, 0xD8, 0x00, 0xD8, 0xB4, 0x71, 0x00, 0x2C, 0x00 }
+	};
+	testLoadDDSBlocks("ATI2", 0, bc5_blocks[0], 16, 1, bc5_expected[0], 2);
+
+	// BC7 blocks of modes 0 to 7 (DXGI_FORMAT_BC7_UNORM), RGBA pixels
+	const BYTE bc7_blocks[8][16] = {
+		{ 0x13, 0x5D, 0x02, 0x1B, 0x6C, 0x59, 0x6C, 0xCA, 0xC0, 0x18, 0xDE, 0x64, 0x83, 0x94, 0x4C, 0x44 },
+		{ 0xB6, 0x11, 0x75, 0x6E, 0x41, 0x93, 0x52, 0x90, 0x00, 0xB9, 0xB5, 0xDD, 0x0B, 0xA6, 0x30, 0xEA },
+		{ 0x9C, 0xE6, 0x9E, 0x7B, 0x9E, 0xC0, 0xA2, 0x61, 0xCD, 0x50, 0xF1, 0xCF, 0xF7, 0x48, 0x63, 0xA7 },
+		{ 0x58, 0x7A, 0x22, 0x87, 0x6E, 0x12, 0x2C, 0x4C, 0xEF, 0xAD, 0xC0, 0x49, 0x3C, 0xCA, 0xB1, 0xBA },
+		{ 0xB0, 0xD7, 0x19, 0x65, 0xCF, 0xF1, 0xBB, 0xDE, 0x78, 0xF8, 0xF1, 0x83, 0x16, 0x6A, 0x08, 0x04 },
+		{ 0xA0, 0xBA, 0xAA, 0x6B, 0x01, 0xE3, 0x9B, 0x93, 0x97, 0xA6, 0x60, 0xB2, 0x20, 0xFA, 0xD1, 0xBE },
+		{ 0xC0, 0xE4, 0x8E, 0x9F, 0x38, 0x1E, 0x8A, 0x70, 0xA5, 0x33, 0x84, 0xE3, 0xCD, 0xD0, 0x3A, 0xDA },
+		{ 0x80, 0xFC, 0xB7, 0x3D, 0x21, 0x8A, 0x16, 0x9D, 0xC7, 0x7D, 0x54, 0xE2, 0xE6, 0xE8, 0xEE, 0x82 }
+	};
+	const BYTE bc7_expected[8][64] = {
+		{ 0xAE, 0x2A, 0x3F, 0xFF, 0xD9, 0x55, 0x4D, 0xFF, 0xBD, 0x39, 0x44, 0xFF, 0xBD, 0x39, 0x44, 0xFF, 0x15, 0xC1, 0x1C, 0xFF, 0x1F, 0xB7, 0x55, 0xFF, 0x21, 0xB5, 0x63, 0xFF, 0x1F, 0xB7, 0x55, 0xFF,
+		  0x1F, 0xB7, 0x55, 0xFF, 0x1F, 0xB7, 0x55, 0xFF, 0x1F, 0xB7, 0x55, 0xFF, 0x1A, 0xBC, 0x39, 0xFF, 0xA3, 0x3C, 0x87, 0xFF, 0xBB, 0x4F, 0xA4, 0xFF, 0x8C, 0x29, 0x6B, 0xFF, 0x98, 0x32, 0x79, 0xFF },
+		{ 0x48, 0x0D, 0x3A, 0xFF, 0x4B, 0x1A, 0x2A, 0xFF, 0x88, 0x81, 0x73, 0xFF, 0x6C, 0x50, 0xB9, 0xFF, 0x73, 0x5C, 0xA8, 0xFF, 0x88, 0x81, 0x73, 0xFF, 0x48, 0x0D, 0x3A, 0xFF, 0x46, 0x06, 0x42, 0xFF,
+		  0x88, 0x81, 0x73, 0xFF, 0x8F, 0x8D, 0x62, 0xFF, 0x48, 0x0D, 0x3A, 0xFF, 0x4D, 0x22, 0x22, 0xFF, 0x48, 0x0D, 0x3A, 0xFF, 0x49, 0x14, 0x32, 0xFF, 0x7A, 0x68, 0x97, 0xFF, 0x88, 0x81, 0x73, 0xFF },
+		{ 0x9C, 0x08, 0x31, 0xFF, 0xDE, 0x63, 0xA5, 0xFF, 0x39, 0x6B, 0xFF, 0xFF, 0x9C, 0x63, 0x39, 0xFF, 0x9C, 0x08, 0x31, 0xFF, 0xB2, 0x26, 0x57, 0xFF, 0x59, 0x68, 0xBE, 0xFF, 0x59, 0x68, 0xBE, 0xFF,
+		  0xB2, 0x26, 0x57, 0xFF, 0x9C, 0x08, 0x31, 0xFF, 0x39, 0x6B, 0xFF, 0xFF, 0x59, 0x68, 0xBE, 0xFF, 0xDE, 0x31, 0xFF, 0xFF, 0x9C, 0x8C, 0x10, 0xFF, 0xB2, 0x6E, 0x5E, 0xFF, 0xB2, 0x6E, 0x5E, 0xFF },
+		{ 0x34, 0xA2, 0xDE, 0xFF, 0xBA, 0xD2, 0x26, 0xFF, 0x34, 0xA2, 0xDE, 0xFF, 0x0E, 0x84, 0x80, 0xFF, 0x34, 0xA2, 0xDE, 0xFF, 0x46, 0x9E, 0x62, 0xFF, 0x2B, 0xB1, 0xC5, 0xFF, 0xBA, 0xD2, 0x26, 0xFF,
+		  0x0E, 0x84, 0x80, 0xFF, 0x3D, 0x93, 0xF7, 0xFF, 0xBA, 0xD2, 0x26, 0xFF, 0x2B, 0xB1, 0xC5, 0xFF, 0x82, 0xB8, 0x44, 0xFF, 0x2B, 0xB1, 0xC5, 0xFF, 0xBA, 0xD2, 0x26, 0xFF, 0x2B, 0xB1, 0xC5, 0xFF },
+		{ 0x1C, 0x31, 0xB5, 0xBD, 0xFF, 0x4D, 0x4A, 0x7D, 0x66, 0x52, 0x39, 0x73, 0x66, 0x36, 0xA4, 0xB3, 0xFF, 0x31, 0xB5, 0xBD, 0xFF, 0x49, 0x5C, 0x88, 0xB5, 0x49, 0x5C, 0x88, 0x66, 0x31, 0xB5, 0xBD,
+		  0x1C, 0x3A, 0x92, 0xA8, 0xFF, 0x49, 0x5C, 0x88, 0xFF, 0x36, 0xA4, 0xB3, 0x1C, 0x44, 0x6D, 0x92, 0x1C, 0x31, 0xB5, 0xBD, 0xFF, 0x31, 0xB5, 0xBD, 0xFF, 0x36, 0xA4, 0xB3, 0xFF, 0x31, 0xB5, 0xBD },
+		{ 0x86, 0xE6, 0x92, 0x45, 0x99, 0xE6, 0xC7, 0x2D, 0x74, 0xE5, 0x60, 0x5C, 0x86, 0xE6, 0x92, 0x45, 0xAB, 0xE5, 0xF9, 0x16, 0x74, 0xE5, 0x60, 0x5C, 0x86, 0xE4, 0x92, 0x45, 0x86, 0xE4, 0x92, 0x45,
+		  0x74, 0xE5, 0x60, 0x5C, 0x74, 0xE6, 0x60, 0x5C, 0xAB, 0xE5, 0xF9, 0x16, 0x74, 0xE4, 0x60, 0x5C, 0x86, 0xE5, 0x92, 0x45, 0x99, 0xE4, 0xC7, 0x2D, 0x86, 0xE4, 0x92, 0x45, 0x86, 0xE5, 0x92, 0x45 },
+		{ 0x8E, 0xD8, 0x7C, 0x96, 0x80, 0x5E, 0x39, 0xC4, 0x8D, 0xC9, 0x74, 0x9C, 0x8D, 0xC9, 0x74, 0x9C, 0x8B, 0xBB, 0x6C, 0xA1, 0x84, 0x7E, 0x4B, 0xB8, 0x8D, 0xC9, 0x74, 0x9C, 0x79, 0x21, 0x17, 0xDC,
+		  0x7B, 0x33, 0x21, 0xD5, 0x7C, 0x42, 0x29, 0xCF, 0x92, 0xF8, 0x8E, 0x8A, 0x7B, 0x33, 0x21, 0xD5, 0x80, 0x5E, 0x39, 0xC4, 0x8D, 0xC9, 0x74, 0x9C, 0x80, 0x5E, 0x39, 0xC4, 0x7B, 0x33, 0x21, 0xD5 },
+		{ 0xE7, 0x65, 0xA3, 0xC2, 0xFF, 0x45, 0xA6, 0xFF, 0xB6, 0xA6, 0x9E, 0x45, 0xE7, 0x65, 0xA3, 0xC2, 0xEB, 0x41, 0x38, 0x28, 0xB7, 0x4A, 0x4C, 0x49, 0x4D, 0x5D, 0x75, 0x8E, 0xB7, 0x4A, 0x4C, 0x49,
+		  0xB6, 0xA6, 0x9E, 0x45, 0xE7, 0x65, 0xA3, 0xC2, 0x4D, 0x5D, 0x75, 0x8E, 0xB7, 0x4A, 0x4C, 0x49, 0xE7, 0x65, 0xA3, 0xC2, 0xFF, 0x45, 0xA6, 0xFF, 0xEB, 0x41, 0x38, 0x28, 0xB7, 0x4A, 0x4C, 0x49 }
+	};
+	testLoadDDSBlocks("DX10", 98, bc7_blocks[0], 16, 8, bc7_expected[0], 4);
+}
+
+void testSaveHDRMemIO(unsigned width, unsigned height) {
+	printf("testSaveHDRMemIO ...\n");
+
+	// a wide dynamic range, with zero and tiny pixels
+	// a width lower than 8 cannot be run length encoded and is written flat
+	const unsigned widths[] = { width, 5 };
+	for(int j = 0; j < 2; j++) {
+		const unsigned w = widths[j];
+		FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, w, height);
+		assert(dib != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+			for(unsigned x = 0; x < w; x++) {
+				const float scale = (float)ldexp(1.0, (int)(y % 64) - 32);
+				bits[x].red = scale * x / w;
+				bits[x].green = scale * (w - x) / w;
+				bits[x].blue = ((x + y) % 16) ? scale * 0.5F : 0;
+				if((x % 29) == 0) {
+					bits[x].red = bits[x].green = bits[x].blue = 0;
+				} else if((x % 31) == 0) {
+					bits[x].red = bits[x].green = bits[x].blue = 1e-35F;
+				}
+			}
+		}
+
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		BOOL bResult = FreeImage_SaveToMemory(FIF_HDR, dib, hmem, 0);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_HDR, hmem, 0);
+		assert(check != NULL);
+		assert(FreeImage_GetImageType(check) == FIT_RGBF);
+		assert(FreeImage_GetWidth(check) == w);
+		assert(FreeImage_GetHeight(check) == height);
+
+		// the mantissas are stored with 8 bits, relative to the largest component
+		for(unsigned y = 0; y < height; y++) {
+			const FIRGBF *src = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+			const FIRGBF *dst = (FIRGBF*)FreeImage_GetScanLine(check, y);
+			for(unsigned x = 0; x < w; x++) {
+				float v = src[x].red;
+				if(src[x].green > v) v = src[x].green;
+				if(src[x].blue > v) v = src[x].blue;
+				const float tolerance = v / 128 + 1e-32F;
+				assert(fabs(src[x].red - dst[x].red) <= tolerance);
+				assert(fabs(src[x].green - dst[x].green) <= tolerance);
+				assert(fabs(src[x].blue - dst[x].blue) <= tolerance);
+			}
+		}
+
+		FreeImage_Unload(check);
+		FreeImage_CloseMemory(hmem);
+		FreeImage_Unload(dib);
+	}
+}
@@ -0,0 +1,346 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Create a 24- or 32-bit image with smooth colour gradients, using far more than 256 colours
+*/
+static FIBITMAP* 
+createColorRamp(unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	assert(dib != NULL);
+	const unsigned bytespp = bpp / 8;
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[FI_RGBA_RED]   = (BYTE)((255 * x) / (width - 1));
+			bits[FI_RGBA_GREEN] = (BYTE)((255 * y) / (height - 1));
+			bits[FI_RGBA_BLUE]  = (BYTE)((x + y) * 255 / (width + height - 2));
+			if(bytespp == 4) {
+				bits[FI_RGBA_ALPHA] = 0xFF;
+			}
+			bits += bytespp;
+		}
+	}
+	return dib;
+}
+
+/**
+Check that every pixel of a quantized image uses the nearest entry of the first 'size' palette entries 
+(squared euclidean distance, lowest index on ties)
+*/
+static void 
+checkNearestColors(FIBITMAP *src, FIBITMAP *dst, unsigned size) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+	const RGBQUAD *pal = FreeImage_GetPalette(dst);
+
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(src, y);
+		const BYTE *index = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			int best = -1;
+			unsigned nearest = 0;
+			for(unsigned i = 0; i < size; i++) {
+				const int dr = pal[i].rgbRed - bits[FI_RGBA_RED];
+				const int dg = pal[i].rgbGreen - bits[FI_RGBA_GREEN];
+				const int db = pal[i].rgbBlue - bits[FI_RGBA_BLUE];
+				const int d = dr * dr + dg * dg + db * db;
+				if((best < 0) || (d < best)) {
+					best = d;
+					nearest = i;
+				}
+			}
+			assert(index[x] == nearest);
+			bits += bytespp;
+		}
+	}
+}
+
+/**
+Return the mean absolute difference between the 8x8 block averages of a source image 
+and of its quantized version, summed over the colour components
+*/
+static double 
+blockColorError(FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+	const RGBQUAD *pal = FreeImage_GetPalette(dst);
+
+	double error = 0;
+	unsigned blocks = 0;
+	for(unsigned by = 0; by + 8 <= height; by += 8) {
+		for(unsigned bx = 0; bx + 8 <= width; bx += 8) {
+			int sum[3] = { 0, 0, 0 };
+			for(unsigned y = by; y < by + 8; y++) {
+				const BYTE *bits = FreeImage_GetScanLine(src, y) + bx * bytespp;
+				const BYTE *index = FreeImage_GetScanLine(dst, y) + bx;
+				for(unsigned x = 0; x < 8; x++) {
+					sum[0] += (int)bits[FI_RGBA_RED] - pal[index[x]].rgbRed;
+					sum[1] += (int)bits[FI_RGBA_GREEN] - pal[index[x]].rgbGreen;
+					sum[2] += (int)bits[FI_RGBA_BLUE] - pal[index[x]].rgbBlue;
+					bits += bytespp;
+				}
+			}
+			error += (abs(sum[0]) + abs(sum[1]) + abs(sum[2])) / 64.0;
+			blocks++;
+		}
+	}
+	return blocks ? (error / blocks) : 0;
+}
+
+/**
+Serial Sierra Lite error diffusion of a 8-, 24- or 32-bit image against the first 'size' palette entries 
+(the image is scanned from the top line down, left to right, errors in 1/4 units). 
+Return the palette indices as a 8-bit image
+*/
+static FIBITMAP* 
+sierraLiteReference(FIBITMAP *src, const RGBQUAD *pal, unsigned size) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 8);
+	assert(dst != NULL);
+
+	// errors of the current and of the next line, with a guard pixel on both sides
+	const size_t count = (width + 2) * 3;
+	int *buffer = (int*)calloc(2 * count, sizeof(int));
+	assert(buffer != NULL);
+	int *cerr = buffer;
+	int *nerr = buffer + count;
+
+	for(unsigned k = 0; k < height; k++) {
+		const unsigned y = height - 1 - k;
+		const BYTE *bits = FreeImage_GetScanLine(src, y);
+		BYTE *index = FreeImage_GetScanLine(dst, y);
+		int carry[3] = { 0, 0, 0 };
+		for(unsigned x = 0; x < width; x++) {
+			const BYTE *pixel = bits + x * bytespp;
+			const int source[3] = {
+				(bytespp == 1) ? pixel[0] : pixel[FI_RGBA_RED],
+				(bytespp == 1) ? pixel[0] : pixel[FI_RGBA_GREEN],
+				(bytespp == 1) ? pixel[0] : pixel[FI_RGBA_BLUE]
+			};
+			int value[3];
+			for(int c = 0; c < 3; c++) {
+				value[c] = source[c] + ((cerr[3 * (x + 1) + c] + carry[c] + 2) >> 2);
+				value[c] = (value[c] < 0) ? 0 : ((value[c] > 255) ? 255 : value[c]);
+			}
+
+			int best = -1;
+			unsigned nearest = 0;
+			for(unsigned i = 0; i < size; i++) {
+				const int dr = pal[i].rgbRed - value[0];
+				const int dg = pal[i].rgbGreen - value[1];
+				const int db = pal[i].rgbBlue - value[2];
+				const int d = dr * dr + dg * dg + db * db;
+				if((best < 0) || (d < best)) {
+					best = d;
+					nearest = i;
+				}
+			}
+			index[x] = (BYTE)nearest;
+
+			const int error[3] = { value[0] - pal[nearest].rgbRed, value[1] - pal[nearest].rgbGreen, value[2] - pal[nearest].rgbBlue };
+			for(int c = 0; c < 3; c++) {
+				carry[c] = 2 * error[c];
+				nerr[3 * x + c] += error[c];
+				nerr[3 * (x + 1) + c] += error[c];
+			}
+		}
+		int *terr = cerr; cerr = nerr; nerr = terr;
+		memset(nerr, 0, count * sizeof(int));
+	}
+	free(buffer);
+
+	return dst;
+}
+
+// ----------------------------------------------------------
+
+void testQuantize(unsigned width, unsigned height) {
+	printf("testQuantize ...\n");
+
+	const unsigned sizes[][2] = { { width, height }, { 37, 21 }, { 300, 2 } };
+
+	for(int j = 0; j < 3; j++) {
+		const unsigned w = sizes[j][0];
+		const unsigned h = sizes[j][1];
+
+		FIBITMAP *src = createColorRamp(w, h, 24);
+
+		// the NeuQuant quantizer maps each pixel to its nearest palette entry
+		FIBITMAP *dst = FreeImage_ColorQuantizeEx(src, FIQ_NNQUANT, 64);
+		assert(dst != NULL);
+		assert(FreeImage_GetBPP(dst) == 8);
+		assert((FreeImage_GetWidth(dst) == w) && (FreeImage_GetHeight(dst) == h));
+		checkNearestColors(src, dst, 64);
+		FreeImage_Unload(dst);
+
+		// error diffusion keeps the local averages closer to the source than plain quantization
+		// (the LFP quantizer falls back to the Wu quantizer for a ramp)
+		for(int q = 0; q < 3; q++) {
+			dst = FreeImage_ColorQuantizeDither(src, (FREE_IMAGE_QUANTIZE)q, FID_FS, 16);
+			assert(dst != NULL);
+			assert(FreeImage_GetBPP(dst) == 8);
+			assert((FreeImage_GetWidth(dst) == w) && (FreeImage_GetHeight(dst) == h));
+			FIBITMAP *plain = FreeImage_ColorQuantizeEx(src, (q == FIQ_LFPQUANT) ? FIQ_WUQUANT : (FREE_IMAGE_QUANTIZE)q, 16);
+			assert(plain != NULL);
+			if(w * h >= 64 * 64) {
+				assert(blockColorError(src, dst) < blockColorError(src, plain));
+			}
+			FreeImage_Unload(plain);
+			FreeImage_Unload(dst);
+		}
+		FreeImage_Unload(src);
+
+		// 32-bit input
+		src = createColorRamp(w, h, 32);
+		dst = FreeImage_ColorQuantizeDither(src, FIQ_WUQUANT, FID_FS, 256);
+		assert(dst != NULL);
+		assert(FreeImage_GetBPP(dst) == 8);
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+	}
+
+	// dithering to a fixed 27 colour palette
+	{
+		RGBQUAD palette[27];
+		for(int i = 0; i < 27; i++) {
+			palette[i].rgbRed = (BYTE)(127 * (i / 9));
+			palette[i].rgbGreen = (BYTE)(127 * ((i / 3) % 3));
+			palette[i].rgbBlue = (BYTE)(127 * (i % 3));
+			palette[i].rgbReserved = 0;
+		}
+
+		FIBITMAP *src = createColorRamp(width, height, 24);
+		const FREE_IMAGE_DITHER algorithms[] = { FID_FS, FID_SIERRALITE, FID_BAYER4x4, FID_BAYER8x8, FID_BAYER16x16, FID_CLUSTER6x6, FID_CLUSTER8x8, FID_CLUSTER16x16 };
+		for(int a = 0; a < 8; a++) {
+			FIBITMAP *dst = FreeImage_DitherToPalette(src, algorithms[a], palette, 27);
+			assert(dst != NULL);
+			assert(FreeImage_GetBPP(dst) == 8);
+			assert((FreeImage_GetWidth(dst) == width) && (FreeImage_GetHeight(dst) == height));
+			assert(memcmp(FreeImage_GetPalette(dst), palette, sizeof(palette)) == 0);
+			for(unsigned y = 0; y < height; y++) {
+				const BYTE *index = FreeImage_GetScanLine(dst, y);
+				for(unsigned x = 0; x < width; x++) {
+					assert(index[x] < 27);
+				}
+			}
+			// error diffusion and the dispersed dot matrices keep the 8x8 block averages close to the source
+			if((algorithms[a] == FID_FS) || (algorithms[a] == FID_SIERRALITE) || (algorithms[a] == FID_BAYER8x8) || (algorithms[a] == FID_BAYER16x16)) {
+				assert(blockColorError(src, dst) < 8);
+			}
+			FreeImage_Unload(dst);
+		}
+		// unknown algorithm
+		FIBITMAP *invalid = FreeImage_DitherToPalette(src, (FREE_IMAGE_DITHER)100, palette, 27);
+		assert(invalid == NULL);
+		FreeImage_Unload(src);
+
+		// 8-bit input
+		src = createZonePlateImage(width, height, 128);
+		FIBITMAP *dst = FreeImage_DitherToPalette(src, FID_SIERRALITE, palette, 3);
+		assert(dst != NULL);
+		assert(FreeImage_GetBPP(dst) == 8);
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+	}
+
+	// the wavefront Sierra Lite diffusion gives the serial result, whatever the number of threads 
+	// (the images are large enough to be split between several threads on a multi-core machine)
+	{
+		RGBQUAD palette[27];
+		for(int i = 0; i < 27; i++) {
+			palette[i].rgbRed = (BYTE)(127 * (i / 9));
+			palette[i].rgbGreen = (BYTE)(127 * ((i / 3) % 3));
+			palette[i].rgbBlue = (BYTE)(127 * (i % 3));
+			palette[i].rgbReserved = 0;
+		}
+
+		const unsigned sizes[][2] = { { 1024, 768 }, { 1021, 523 } };
+		for(int j = 0; j < 2; j++) {
+			const unsigned w = sizes[j][0];
+			const unsigned h = sizes[j][1];
+
+			FIBITMAP *src = createColorRamp(w, h, (j == 0) ? 24 : 32);
+			FIBITMAP *dst = FreeImage_DitherToPalette(src, FID_SIERRALITE, palette, 27);
+			assert(dst != NULL);
+			FIBITMAP *ref = sierraLiteReference(src, palette, 27);
+			assert(sameImage(dst, ref));
+			FreeImage_Unload(ref);
+			FreeImage_Unload(dst);
+			FreeImage_Unload(src);
+
+			// halftoning to black and white
+			src = createZonePlateImage(w, h, 128);
+			assert(src != NULL);
+			dst = FreeImage_Dither(src, FID_SIERRALITE);
+			assert(dst != NULL);
+			assert(FreeImage_GetBPP(dst) == 1);
+			const RGBQUAD bw[2] = { { 0, 0, 0, 0 }, { 255, 255, 255, 0 } };
+			ref = sierraLiteReference(src, bw, 2);
+			for(unsigned y = 0; y < h; y++) {
+				const BYTE *bits = FreeImage_GetScanLine(dst, y);
+				const BYTE *index = FreeImage_GetScanLine(ref, y);
+				for(unsigned x = 0; x < w; x++) {
+					assert(((bits[x >> 3] >> (7 - (x & 7))) & 1) == index[x]);
+				}
+			}
+			FreeImage_Unload(ref);
+			FreeImage_Unload(dst);
+			FreeImage_Unload(src);
+		}
+	}
+
+	// an image with few colours is converted losslessly, without any dithering
+	{
+		FIBITMAP *src = FreeImage_Allocate(width, height, 24);
+		assert(src != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			BYTE *bits = FreeImage_GetScanLine(src, y);
+			for(unsigned x = 0; x < width; x++) {
+				bits[FI_RGBA_RED] = (BYTE)(((x / 8) & 3) * 85);
+				bits[FI_RGBA_GREEN] = (BYTE)(((y / 8) & 1) * 255);
+				bits[FI_RGBA_BLUE] = 40;
+				bits += 3;
+			}
+		}
+		FIBITMAP *dst = FreeImage_ColorQuantizeDither(src, FIQ_LFPQUANT, FID_FS, 16);
+		assert(dst != NULL);
+		for(unsigned y = 0; y < height; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(src, y);
+			const BYTE *index = FreeImage_GetScanLine(dst, y);
+			const RGBQUAD *pal = FreeImage_GetPalette(dst);
+			for(unsigned x = 0; x < width; x++) {
+				assert(pal[index[x]].rgbRed == bits[FI_RGBA_RED]);
+				assert(pal[index[x]].rgbGreen == bits[FI_RGBA_GREEN]);
+				assert(pal[index[x]].rgbBlue == bits[FI_RGBA_BLUE]);
+				bits += 3;
+			}
+		}
+		FreeImage_Unload(dst);
+		FreeImage_Unload(src);
+	}
+}
@@ -0,0 +1,322 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Fill an image with a byte pattern that differs from pixel to pixel
+*/
+static void 
+fillPattern(FIBITMAP *dib) {
+	const unsigned line = FreeImage_GetLine(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned i = 0; i < line; i++) {
+			bits[i] = (BYTE)((i * 7) ^ (y * 13) ^ (i >> 8) ^ (y >> 5));
+		}
+	}
+}
+
+/**
+Compare pixel (dst_x, dst_y) of dst with pixel (src_x, src_y) of src
+*/
+static BOOL 
+samePixel(FIBITMAP *dst, unsigned dst_x, unsigned dst_y, FIBITMAP *src, unsigned src_x, unsigned src_y) {
+	if(FreeImage_GetBPP(src) == 4) {
+		const BYTE a = FreeImage_GetScanLine(dst, dst_y)[dst_x >> 1] >> ((dst_x & 0x01) ? 0 : 4);
+		const BYTE b = FreeImage_GetScanLine(src, src_y)[src_x >> 1] >> ((src_x & 0x01) ? 0 : 4);
+		return (a & 0x0F) == (b & 0x0F);
+	}
+	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+	return memcmp(FreeImage_GetScanLine(dst, dst_y) + dst_x * bytespp, FreeImage_GetScanLine(src, src_y) + src_x * bytespp, bytespp) == 0;
+}
+
+static void 
+testRotateFlipType(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(src != NULL);
+	fillPattern(src);
+
+	// the rotation angle is counter clockwise, images are stored upside down
+
+	FIBITMAP *dst = FreeImage_Rotate(src, 90);
+	assert(dst != NULL);
+	assert((FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width));
+	for(unsigned y = 0; y < width; y++) {
+		for(unsigned x = 0; x < height; x++) {
+			assert(samePixel(dst, x, y, src, y, height - 1 - x));
+		}
+	}
+	FreeImage_Unload(dst);
+
+	dst = FreeImage_Rotate(src, -90);
+	assert(dst != NULL);
+	assert((FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width));
+	for(unsigned y = 0; y < width; y++) {
+		for(unsigned x = 0; x < height; x++) {
+			assert(samePixel(dst, x, y, src, width - 1 - y, x));
+		}
+	}
+	FreeImage_Unload(dst);
+
+	dst = FreeImage_Rotate(src, 180);
+	assert(dst != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		for(unsigned x = 0; x < width; x++) {
+			assert(samePixel(dst, x, y, src, width - 1 - x, height - 1 - y));
+		}
+	}
+	FreeImage_Unload(dst);
+
+	dst = FreeImage_Clone(src);
+	assert(dst != NULL);
+	BOOL bResult = FreeImage_FlipHorizontal(dst);
+	assert(bResult);
+	for(unsigned y = 0; y < height; y++) {
+		for(unsigned x = 0; x < width; x++) {
+			assert(samePixel(dst, x, y, src, width - 1 - x, y));
+		}
+	}
+	FreeImage_Unload(dst);
+
+	FreeImage_Unload(src);
+}
+
+/**
+Rotate a uniform integer image by arbitrary angles, using its color as background : 
+the 3 shears must leave every pixel unchanged
+*/
+static void 
+testRotateAngleType(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(src != NULL);
+
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	BYTE color[16] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 };
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			memcpy(bits + x * bytespp, color, bytespp);
+		}
+	}
+
+	const double angles[] = { 0.5, -3.25, 30, -45, 75, 200 };
+	for(unsigned i = 0; i < sizeof(angles) / sizeof(angles[0]); i++) {
+		FIBITMAP *dst = FreeImage_Rotate(src, angles[i], color);
+		assert(dst != NULL);
+		for(unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+			const BYTE *bits = FreeImage_GetScanLine(dst, y);
+			for(unsigned x = 0; x < FreeImage_GetWidth(dst); x++) {
+				assert(memcmp(bits + x * bytespp, color, bytespp) == 0);
+			}
+		}
+		FreeImage_Unload(dst);
+	}
+
+	FreeImage_Unload(src);
+}
+
+/**
+FNV-1a hash of the pixels of an image
+*/
+static DWORD 
+hashPixels(FIBITMAP *dib) {
+	DWORD hash = 2166136261U;
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			hash = (hash ^ bits[x]) * 16777619U;
+		}
+	}
+	return hash;
+}
+
+/**
+Rotate a 601x467 pattern by arbitrary angles, with and without a background color : 
+the 3 shears must reproduce, bit for bit, the output of the original scalar implementation 
+(recorded below as hashes of the rotated pixels)
+*/
+static void 
+testRotateAngleReference() {
+	const FREE_IMAGE_TYPE types[] = { FIT_BITMAP, FIT_BITMAP, FIT_BITMAP, FIT_UINT16, FIT_RGB16, FIT_RGBA16 };
+	const unsigned bpps[] = { 8, 24, 32, 16, 48, 64 };
+	const double angles[] = { 0.5, -3.25, 30, -45, 75, 200 };
+	const DWORD hashes[6][6] = {
+		{ 0x8F179C2B, 0xE8C4685B, 0x797AD932, 0x2FF9D38F, 0x9651DFDB, 0x8512B719 },
+		{ 0xAF52042E, 0x669A21B0, 0xD5E0B5AE, 0x99B90016, 0xE875FBC0, 0x24B89413 },
+		{ 0x1416C2A3, 0x04080BE8, 0x922B7957, 0x642AC3F8, 0xA182990C, 0x19CA8E72 },
+		{ 0x3B55D800, 0xC9A2B859, 0x2FA6B11C, 0xBC1A421E, 0xE44024CC, 0x27EE57AC },
+		{ 0x4178C2AF, 0x453DAB39, 0x75886D0A, 0xE861FEE1, 0x334F5C64, 0xEAF662A2 },
+		{ 0x429D7C3B, 0x85B8C273, 0x7BEC554D, 0xAC3ED72A, 0x17AE649C, 0x151905BE }
+	};
+	const BYTE color[16] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 };
+
+	for(unsigned i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		FIBITMAP *src = FreeImage_AllocateT(types[i], 601, 467, bpps[i]);
+		assert(src != NULL);
+		fillPattern(src);
+		for(unsigned k = 0; k < sizeof(angles) / sizeof(angles[0]); k++) {
+			// odd angles use the background color, even ones the default black background
+			FIBITMAP *dst = FreeImage_Rotate(src, angles[k], (k & 1) ? color : NULL);
+			assert(dst != NULL);
+			assert(hashPixels(dst) == hashes[i][k]);
+			FreeImage_Unload(dst);
+		}
+		FreeImage_Unload(src);
+	}
+}
+
+/**
+Rotate a pattern with FreeImage_RotateEx and with the cached coefficients path:
+both results must agree within the rounding of the single precision coefficients
+*/
+static void 
+testRotateExType(unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_Allocate(width, height, bpp);
+	assert(src != NULL);
+	fillPattern(src);
+
+	FIBITMAP *coeff = FreeImage_MakeBSplineCoefficients(src);
+	assert(coeff != NULL);
+	assert(FreeImage_GetWidth(coeff) == width && FreeImage_GetHeight(coeff) == height);
+	assert(FreeImage_GetImageType(coeff) == ((bpp == 8) ? FIT_FLOAT : (bpp == 24) ? FIT_RGBF : FIT_RGBAF));
+
+	const double angles[] = { 12.5, -60 };
+	for(unsigned i = 0; i < sizeof(angles) / sizeof(angles[0]); i++) {
+		for(int use_mask = 0; use_mask < 2; use_mask++) {
+			FIBITMAP *ref = FreeImage_RotateEx(src, angles[i], 3.5, -2, width / 2.0, height / 3.0, use_mask);
+			FIBITMAP *dst = FreeImage_RotateExCoefficients(coeff, angles[i], 3.5, -2, width / 2.0, height / 3.0, use_mask);
+			assert(ref != NULL && dst != NULL);
+			assert(FreeImage_GetBPP(dst) == bpp);
+			for(unsigned y = 0; y < height; y++) {
+				const BYTE *a = FreeImage_GetScanLine(ref, y);
+				const BYTE *b = FreeImage_GetScanLine(dst, y);
+				for(unsigned x = 0; x < FreeImage_GetLine(dst); x++) {
+					assert(abs((int)a[x] - (int)b[x]) <= 1);
+				}
+			}
+			FreeImage_Unload(dst);
+			FreeImage_Unload(ref);
+		}
+	}
+
+	FreeImage_Unload(coeff);
+	FreeImage_Unload(src);
+}
+
+/**
+Check FreeImage_Warp against the right angle rotations, and check that a uniform
+image stays uniform inside the warped area and gets the background color outside
+*/
+static void 
+testWarpType(unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_Allocate(width, height, 24);
+	assert(src != NULL);
+	fillPattern(src);
+
+	// 90 degree rotation, with the separable path and with the single pass evaluation
+	const double rotate90[9] = { 0, 1, 0, -1, 0, (double)width, 0, 0, 1 };
+	FIBITMAP *ref = FreeImage_Rotate(src, 90);
+	assert(ref != NULL);
+	for(int i = 0; i < 2; i++) {
+		FIBITMAP *dst = FreeImage_Warp(src, height, width, rotate90, FILTER_CATMULLROM, NULL, i ? FI_WARP_NO_SEPARABLE : FI_WARP_DEFAULT);
+		assert(dst != NULL);
+		assert(sameImage(dst, ref));
+		FreeImage_Unload(dst);
+	}
+	FreeImage_Unload(ref);
+
+	// identity
+	const double identity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+	FIBITMAP *dst = FreeImage_Warp(src, width, height, identity, FILTER_LANCZOS3, NULL, FI_WARP_NO_SEPARABLE);
+	assert(dst != NULL);
+	assert(sameImage(dst, src));
+	FreeImage_Unload(dst);
+
+	FreeImage_Unload(src);
+
+	// uniform float image, rotated, minified and with a perspective
+	src = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	assert(src != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		float *bits = (float*)FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = 0.25F;
+		}
+	}
+	const float bkcolor = -1;
+	const double matrices[][9] = {
+		{ 0.8, -0.6, 20, 0.6, 0.8, -10, 0, 0, 1 },
+		{ 0.3, 0.1, 5.5, -0.05, 0.4, 7.25, 0, 0, 1 },
+		{ 1, 0.2, 0, 0.1, 1, 0, 0.001, 0.002, 1 }
+	};
+	for(unsigned i = 0; i < sizeof(matrices) / sizeof(matrices[0]); i++) {
+		dst = FreeImage_Warp(src, width, height, matrices[i], FILTER_BICUBIC, &bkcolor);
+		assert(dst != NULL);
+		unsigned inside = 0;
+		for(unsigned y = 0; y < height; y++) {
+			const float *bits = (float*)FreeImage_GetScanLine(dst, y);
+			for(unsigned x = 0; x < width; x++) {
+				if(bits[x] != bkcolor) {
+					assert(fabs(bits[x] - 0.25F) < 1e-5F);
+					inside++;
+				}
+			}
+		}
+		assert((inside > 0) && (inside < width * height));
+		FreeImage_Unload(dst);
+	}
+	FreeImage_Unload(src);
+}
+
+void 
+testRotateFlip(unsigned width, unsigned height) {
+	printf("testRotateFlip ...\n");
+
+	// odd sizes, so that neither the blocks nor the SIMD tiles fit exactly
+	width += 5;
+	height = height / 2 + 3;
+
+	testRotateFlipType(FIT_BITMAP, 4, width, height);
+	testRotateFlipType(FIT_BITMAP, 8, width, height);
+	testRotateFlipType(FIT_BITMAP, 24, width, height);
+	testRotateFlipType(FIT_BITMAP, 32, width, height);
+	testRotateFlipType(FIT_UINT16, 16, width, height);
+	testRotateFlipType(FIT_RGB16, 48, width, height);
+	testRotateFlipType(FIT_RGBA16, 64, width, height);
+	testRotateFlipType(FIT_FLOAT, 32, width, height);
+	testRotateFlipType(FIT_RGBF, 96, width, height);
+	testRotateFlipType(FIT_RGBAF, 128, width, height);
+
+	testRotateAngleType(FIT_BITMAP, 8, width, height);
+	testRotateAngleType(FIT_BITMAP, 24, width, height);
+	testRotateAngleType(FIT_BITMAP, 32, width, height);
+	testRotateAngleType(FIT_UINT16, 16, width, height);
+	testRotateAngleType(FIT_RGB16, 48, width, height);
+	testRotateAngleType(FIT_RGBA16, 64, width, height);
+	testRotateAngleReference();
+
+	testRotateExType(8, width, height);
+	testRotateExType(24, width, height);
+	testRotateExType(32, width, height);
+
+	testWarpType(width, height);
+}
@@ -0,0 +1,292 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "TestSuite.h"
+
+// ----------------------------------------------------------
+
+/**
+Create a RGBF image whose rows are constant, with a luminance increasing over 5 decades from bottom to top. 
+When gray is FALSE, every row gets a different hue.
+*/
+static FIBITMAP* 
+createHDRRamp(unsigned width, unsigned height, BOOL gray) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		const float L = (float)pow(10.0, -2 + (5.0 * y) / (height - 1));
+		FIRGBF color = { L, L, L };
+		if(!gray) {
+			color.red   *= 0.2F + 0.8F * ((y % 3) == 0);
+			color.green *= 0.2F + 0.8F * ((y % 3) == 1);
+			color.blue  *= 0.2F + 0.8F * ((y % 5) == 2);
+		}
+		FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = color;
+		}
+	}
+	return dib;
+}
+
+/**
+Check that every row of a tone mapped ramp is constant (within 1 level), 
+and when gray is TRUE that the rows get brighter from bottom to top
+*/
+static void 
+checkToneMappedRamp(FIBITMAP *dib, unsigned width, unsigned height, BOOL gray) {
+	assert(dib != NULL);
+	assert(FreeImage_GetImageType(dib) == FIT_BITMAP);
+	assert(FreeImage_GetBPP(dib) == 24);
+	assert(FreeImage_GetWidth(dib) == width);
+	assert(FreeImage_GetHeight(dib) == height);
+
+	int previous = -1;
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 1; x < width; x++) {
+			for(int c = 0; c < 3; c++) {
+				assert(abs(bits[3 * x + c] - bits[c]) <= 1);
+			}
+		}
+		if(gray) {
+			const int value = bits[FI_RGBA_GREEN];
+			assert(value + 1 >= previous);
+			previous = value;
+		}
+	}
+	if(gray) {
+		// the ramp covers most of the display range
+		assert(previous >= 200);
+	}
+}
+
+/**
+Create a RGBF image whose luminance varies over 5 decades in both directions, with varying hues
+*/
+static FIBITMAP* 
+createHDRPattern(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for(unsigned y = 0; y < height; y++) {
+		FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			const double L = pow(10.0, -2 + 5.0 * (0.5 + 0.5 * sin(x * 0.07) * cos(y * 0.05)));
+			bits[x].red   = (float)(L * (0.3 + 0.7 * ((x / 7) % 2)));
+			bits[x].green = (float)(L * (0.5 + 0.5 * sin(y * 0.13)));
+			bits[x].blue  = (float)(L * (0.2 + 0.4 * ((x + y) % 3)));
+		}
+	}
+	return dib;
+}
+
+/**
+Compare a grid of 12x8 pixels of a tone mapped 515x301 pattern with the expected RGB values, within 1 level
+*/
+static void 
+checkToneMappedPattern(FIBITMAP *dib, const BYTE expected[8][36]) {
+	assert(dib != NULL);
+	assert((FreeImage_GetBPP(dib) == 24) && (FreeImage_GetWidth(dib) == 515) && (FreeImage_GetHeight(dib) == 301));
+	for(unsigned j = 0; j < 8; j++) {
+		const BYTE *bits = FreeImage_GetScanLine(dib, 7 + 36 * j);
+		for(unsigned i = 0; i < 12; i++) {
+			const BYTE *pixel = bits + 3 * (13 + 40 * i);
+			assert(abs((int)pixel[FI_RGBA_RED] - (int)expected[j][3 * i]) <= 1);
+			assert(abs((int)pixel[FI_RGBA_GREEN] - (int)expected[j][3 * i + 1]) <= 1);
+			assert(abs((int)pixel[FI_RGBA_BLUE] - (int)expected[j][3 * i + 2]) <= 1);
+		}
+	}
+	FreeImage_Unload(dib);
+}
+
+/**
+Regression test of the Drago03 and Reinhard05 operators : 
+the expected values are the output of the original, single threaded scalar implementation
+*/
+static void 
+checkToneMappingReference() {
+	const BYTE drago03[8][36] = {
+		{ 248, 236, 248, 46, 43, 12, 188, 179, 148, 167, 159, 167, 28, 58, 20, 151, 251, 209, 3, 9, 10, 255, 254, 126, 7, 6, 4, 250, 238, 250, 39, 36, 9, 118, 199, 166 },
+		{ 61, 17, 61, 255, 119, 125, 135, 54, 105, 152, 63, 152, 164, 128, 135, 33, 22, 53, 202, 159, 255, 43, 10, 11, 255, 143, 249, 57, 16, 57, 255, 123, 130, 70, 52, 101 },
+		{ 43, 7, 43, 255, 112, 141, 127, 40, 98, 148, 49, 148, 187, 123, 154, 22, 9, 38, 233, 156, 255, 25, 3, 5, 255, 136, 255, 39, 6, 39, 255, 117, 146, 63, 37, 92 },
+		{ 247, 229, 247, 53, 48, 15, 187, 173, 147, 167, 155, 167, 32, 62, 23, 151, 243, 208, 4, 12, 14, 255, 247, 126, 11, 9, 7, 250, 231, 250, 46, 41, 12, 118, 193, 165 },
+		{ 192, 179, 192, 113, 104, 46, 162, 150, 127, 154, 143, 154, 65, 114, 52, 113, 187, 159, 45, 82, 90, 207, 192, 95, 84, 77, 64, 194, 180, 194, 109, 100, 44, 97, 162, 137 },
+		{ 15, 2, 15, 255, 132, 161, 108, 33, 83, 138, 46, 138, 218, 149, 180, 7, 3, 14, 255, 181, 255, 5, 1, 1, 255, 155, 255, 12, 2, 12, 255, 137, 166, 48, 27, 72 },
+		{ 208, 88, 208, 149, 59, 65, 184, 77, 145, 177, 73, 177, 89, 66, 72, 129, 98, 180, 73, 53, 135, 225, 97, 104, 128, 49, 99, 210, 89, 210, 146, 58, 63, 113, 85, 159 },
+		{ 248, 235, 248, 47, 44, 13, 188, 178, 148, 167, 158, 167, 29, 59, 20, 151, 249, 209, 3, 9, 10, 255, 253, 126, 8, 7, 5, 250, 237, 250, 40, 37, 10, 118, 198, 165 }
+	};
+	const BYTE drago03_exposure[8][36] = {
+		{ 255, 230, 255, 16, 15, 3, 161, 144, 97, 132, 118, 132, 8, 23, 5, 90, 255, 179, 1, 2, 3, 255, 255, 60, 2, 2, 1, 255, 234, 255, 13, 11, 3, 61, 181, 121 },
+		{ 26, 5, 26, 255, 64, 71, 108, 19, 65, 131, 24, 131, 135, 81, 90, 10, 6, 21, 182, 109, 255, 15, 3, 3, 255, 84, 255, 24, 4, 24, 255, 68, 75, 32, 19, 64 },
+		{ 15, 2, 15, 255, 56, 88, 98, 12, 59, 128, 16, 128, 177, 74, 118, 6, 3, 12, 240, 101, 255, 7, 1, 1, 255, 73, 255, 13, 2, 13, 255, 59, 94, 27, 11, 55 },
+		{ 255, 217, 255, 20, 17, 4, 162, 137, 97, 134, 113, 134, 9, 26, 6, 90, 254, 180, 1, 3, 4, 255, 253, 60, 3, 3, 2, 255, 222, 255, 16, 14, 3, 61, 171, 122 },
+		{ 168, 143, 168, 70, 60, 14, 127, 109, 76, 116, 99, 116, 25, 72, 17, 57, 162, 114, 15, 41, 49, 192, 164, 38, 43, 37, 26, 171, 145, 171, 66, 56, 13, 45, 127, 90 },
+		{ 4, 1, 4, 255, 73, 109, 72, 10, 43, 112, 15, 112, 228, 101, 152, 2, 1, 4, 255, 131, 255, 1, 0, 0, 255, 93, 255, 3, 0, 3, 255, 77, 115, 18, 8, 35 },
+		{ 227, 39, 227, 130, 22, 26, 188, 32, 113, 173, 30, 173, 49, 28, 33, 90, 51, 179, 34, 19, 112, 255, 46, 54, 98, 17, 59, 230, 40, 230, 126, 22, 25, 72, 41, 144 },
+		{ 255, 228, 255, 17, 15, 3, 161, 143, 97, 132, 118, 132, 8, 24, 5, 90, 255, 179, 1, 3, 3, 255, 255, 60, 2, 2, 1, 255, 233, 255, 13, 12, 3, 61, 179, 121 }
+	};
+	const BYTE reinhard05[8][36] = {
+		{ 244, 242, 244, 79, 73, 21, 201, 196, 175, 186, 180, 186, 41, 93, 29, 211, 240, 232, 12, 33, 37, 250, 249, 221, 30, 27, 19, 245, 243, 245, 70, 65, 18, 150, 208, 190 },
+		{ 113, 32, 113, 226, 145, 151, 172, 69, 141, 180, 76, 180, 182, 152, 158, 66, 45, 106, 211, 188, 242, 97, 25, 28, 241, 184, 230, 109, 30, 109, 229, 151, 157, 105, 76, 149 },
+		{ 96, 18, 96, 233, 140, 169, 170, 50, 138, 180, 58, 180, 196, 147, 175, 56, 27, 93, 226, 193, 248, 76, 13, 20, 247, 189, 240, 91, 16, 91, 236, 147, 175, 103, 56, 147 },
+		{ 241, 238, 241, 87, 77, 24, 200, 192, 174, 185, 176, 185, 45, 97, 32, 206, 237, 229, 15, 39, 45, 248, 246, 214, 37, 32, 24, 243, 240, 243, 79, 70, 21, 147, 204, 188 },
+		{ 205, 197, 205, 142, 132, 51, 181, 172, 151, 175, 166, 175, 79, 143, 59, 140, 199, 182, 57, 115, 125, 213, 207, 125, 117, 107, 85, 206, 199, 206, 139, 129, 49, 116, 181, 160 },
+		{ 57, 10, 57, 242, 173, 194, 157, 44, 125, 174, 56, 174, 212, 174, 195, 33, 16, 58, 243, 226, 253, 37, 6, 8, 253, 225, 250, 52, 9, 52, 245, 182, 202, 87, 47, 130 },
+		{ 206, 105, 206, 181, 75, 83, 197, 92, 170, 193, 87, 193, 127, 92, 101, 156, 121, 195, 106, 74, 180, 213, 116, 125, 168, 63, 137, 207, 106, 207, 180, 73, 81, 144, 108, 185 },
+		{ 243, 241, 243, 80, 73, 21, 201, 196, 175, 186, 179, 186, 42, 94, 29, 210, 240, 232, 13, 34, 38, 250, 249, 220, 31, 28, 20, 245, 243, 245, 72, 66, 18, 150, 207, 189 }
+	};
+	const BYTE reinhard05_local[8][36] = {
+		{ 248, 247, 248, 10, 9, 2, 180, 176, 152, 147, 142, 148, 5, 16, 4, 223, 244, 239, 0, 1, 1, 253, 252, 236, 1, 1, 1, 249, 248, 249, 8, 7, 2, 129, 193, 172 },
+		{ 15, 3, 16, 203, 109, 115, 70, 17, 48, 88, 23, 90, 121, 92, 97, 6, 4, 12, 200, 176, 235, 8, 2, 2, 237, 183, 227, 14, 3, 14, 210, 119, 125, 22, 14, 40 },
+		{ 8, 1, 8, 218, 113, 142, 61, 10, 41, 83, 15, 84, 144, 92, 119, 3, 1, 7, 224, 193, 245, 4, 0, 1, 246, 199, 241, 7, 1, 7, 224, 126, 154, 17, 8, 33 },
+		{ 245, 243, 245, 13, 11, 3, 175, 167, 146, 144, 135, 145, 6, 18, 4, 216, 240, 234, 1, 2, 2, 251, 250, 231, 2, 1, 1, 247, 245, 247, 10, 9, 2, 121, 184, 165 },
+		{ 187, 180, 188, 59, 53, 15, 133, 125, 103, 121, 113, 123, 25, 61, 17, 109, 174, 154, 12, 31, 36, 202, 196, 113, 32, 29, 21, 190, 183, 191, 55, 50, 14, 69, 132, 110 },
+		{ 2, 0, 2, 238, 170, 191, 44, 7, 29, 72, 13, 73, 186, 142, 166, 1, 0, 2, 246, 235, 254, 1, 0, 0, 254, 237, 252, 2, 0, 2, 242, 185, 203, 11, 5, 21 },
+		{ 153, 54, 154, 82, 20, 23, 122, 36, 92, 116, 33, 118, 34, 22, 24, 77, 52, 119, 24, 15, 66, 164, 62, 69, 62, 14, 42, 155, 56, 156, 79, 19, 22, 58, 38, 96 },
+		{ 247, 246, 247, 11, 10, 2, 179, 174, 151, 147, 141, 148, 5, 16, 4, 222, 244, 238, 0, 1, 2, 253, 252, 236, 1, 1, 1, 249, 248, 249, 8, 7, 2, 128, 191, 171 }
+	};
+
+	FIBITMAP *src = createHDRPattern(515, 301);
+
+	checkToneMappedPattern(FreeImage_TmoDrago03(src, 2.2, 0), drago03);
+	checkToneMappedPattern(FreeImage_TmoDrago03(src, 1, 1), drago03_exposure);
+	checkToneMappedPattern(FreeImage_TmoReinhard05Ex(src, 0, 0, 1, 0), reinhard05);
+	checkToneMappedPattern(FreeImage_TmoReinhard05Ex(src, 0, 0, 0.5, 0.5), reinhard05_local);
+
+	FreeImage_Unload(src);
+}
+
+/**
+Solve a Poisson equation whose solution vanishes on the image border, 
+and compare the result with the expected solution, remapped to [0..1]
+*/
+static void 
+checkPoissonSolver(unsigned width, unsigned height, unsigned flags) {
+	// expected solution U, and its discrete Laplacian
+	FIBITMAP *U = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	FIBITMAP *Laplacian = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	assert(U && Laplacian);
+	float maxU = 0;
+	for(unsigned y = 0; y < height; y++) {
+		float *bits = (float*)FreeImage_GetScanLine(U, y);
+		for(unsigned x = 0; x < width; x++) {
+			const double value = sin(3.14159265358979 * x / (width - 1)) * sin(3.14159265358979 * y / (height - 1));
+			bits[x] = (float)(value * value);
+			maxU = (maxU < bits[x]) ? bits[x] : maxU;
+		}
+	}
+	for(unsigned y = 0; y < height; y++) {
+		const float *center = (float*)FreeImage_GetScanLine(U, y);
+		const float *above = (y + 1 < height) ? (float*)FreeImage_GetScanLine(U, y + 1) : NULL;
+		const float *below = (y > 0) ? (float*)FreeImage_GetScanLine(U, y - 1) : NULL;
+		float *bits = (float*)FreeImage_GetScanLine(Laplacian, y);
+		for(unsigned x = 0; x < width; x++) {
+			float value = -4 * center[x];
+			value += (x > 0) ? center[x - 1] : 0;
+			value += (x + 1 < width) ? center[x + 1] : 0;
+			value += above ? above[x] : 0;
+			value += below ? below[x] : 0;
+			bits[x] = value;
+		}
+	}
+
+	FIBITMAP *dst = FreeImage_MultigridPoissonSolverEx(Laplacian, 3, flags);
+	assert(dst != NULL);
+	assert(FreeImage_GetImageType(dst) == FIT_FLOAT);
+	assert((FreeImage_GetWidth(dst) == width) && (FreeImage_GetHeight(dst) == height));
+
+	// the expected solution has a zero minimum on the border
+	for(unsigned y = 0; y < height; y++) {
+		const float *expected = (float*)FreeImage_GetScanLine(U, y);
+		const float *bits = (float*)FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			assert(fabs(bits[x] - expected[x] / maxU) < 0.01);
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(Laplacian);
+	FreeImage_Unload(U);
+}
+
+void testToneMapping(unsigned width, unsigned height) {
+	printf("testToneMapping ...\n");
+
+	// an odd width, so that rows mix vectorized and scalar code paths
+	const unsigned widths[] = { width + 3, 7 };
+
+	for(int j = 0; j < 2; j++) {
+		const unsigned w = widths[j];
+		for(int k = 0; k < 2; k++) {
+			const BOOL gray = (k == 0);
+			FIBITMAP *src = createHDRRamp(w, height, gray);
+
+			FIBITMAP *dst = FreeImage_ToneMapping(src, FITMO_DRAGO03);
+			checkToneMappedRamp(dst, w, height, gray);
+			FreeImage_Unload(dst);
+
+			// no gamma correction, with exposure
+			dst = FreeImage_TmoDrago03(src, 1, 1);
+			checkToneMappedRamp(dst, w, height, gray);
+			FreeImage_Unload(dst);
+
+			dst = FreeImage_ToneMapping(src, FITMO_REINHARD05);
+			checkToneMappedRamp(dst, w, height, gray);
+			FreeImage_Unload(dst);
+
+			// complete algorithm, with local adaptation and color correction
+			dst = FreeImage_TmoReinhard05Ex(src, 0, 0, 0.5, 0.5);
+			checkToneMappedRamp(dst, w, height, gray);
+			FreeImage_Unload(dst);
+
+			// RGB16 input is converted by the operators
+			dst = FreeImage_ToneMapping(src, FITMO_DRAGO03);
+			FIBITMAP *src16 = FreeImage_ConvertToType(dst, FIT_RGB16);
+			assert(src16 != NULL);
+			FreeImage_Unload(dst);
+			dst = FreeImage_TmoReinhard05Ex(src16, 0, 0, 0.5, 0.5);
+			assert(dst != NULL);
+			FreeImage_Unload(dst);
+			dst = FreeImage_TmoDrago03(src16, 2.2, 0);
+			assert(dst != NULL);
+			FreeImage_Unload(dst);
+			FreeImage_Unload(src16);
+
+			// the Fattal operator needs a 32x32 image at least
+			if(w >= 32) {
+				dst = FreeImage_ToneMapping(src, FITMO_FATTAL02);
+				assert(dst != NULL);
+				assert(FreeImage_GetBPP(dst) == 24);
+				assert((FreeImage_GetWidth(dst) == w) && (FreeImage_GetHeight(dst) == height));
+				FreeImage_Unload(dst);
+			}
+
+			FreeImage_Unload(src);
+		}
+	}
+
+	// compare with the output of the original operators
+	checkToneMappingReference();
+
+	// multigrid Poisson solver, on square and rectangular grids
+	const unsigned sizes[][2] = { { width / 4 + 3, height / 4 }, { 61, 17 }, { 32, 32 }, { 100, 7 } };
+	for(int j = 0; j < 4; j++) {
+		checkPoissonSolver(sizes[j][0], sizes[j][1], FI_POISSON_DEFAULT);
+		checkPoissonSolver(sizes[j][0], sizes[j][1], FI_POISSON_RECTANGULAR);
+	}
+}
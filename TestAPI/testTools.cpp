@@ -80,3 +80,22 @@ FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale) {
 	return dst;
 }
 
+/**
+Compare two images of the same size and type byte per byte
+@return Returns TRUE if both images have the same size, type and pixels, FALSE otherwise
+*/
+BOOL sameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if((FreeImage_GetImageType(dib1) != FreeImage_GetImageType(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	if((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
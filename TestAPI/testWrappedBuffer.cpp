@@ -161,3 +161,103 @@ void testCreateView(const char *lpszPathName, int flags) {
 
 	FreeImage_Unload(dib);
 }
+
+void testSharedPixels(const char *lpszPathName, int flags) {
+	BOOL bResult = FALSE;
+
+	// load the dib
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, flags);
+	assert(dib != NULL);
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	FIBITMAP *reference = FreeImage_Clone(dib);
+	assert(!FreeImage_IsShared(dib) && !FreeImage_IsShared(reference));
+
+	// a view keeps the pixels of its backing image alive
+	// -------------------------------
+	FIBITMAP *view = FreeImage_CreateView(dib, 0, 0, width, height);
+	assert(FreeImage_IsShared(view) && FreeImage_IsShared(dib));
+	FreeImage_Unload(dib);
+	assert(sameImage(view, reference));
+	// a view writes through: making it writable does not copy the pixels
+	BYTE *bits = FreeImage_GetBits(view);
+	bResult = FreeImage_MakeWritable(view);
+	assert(bResult && (FreeImage_GetBits(view) == bits));
+	FreeImage_Unload(view);
+
+	// copy-on-write clones
+	// -------------------------------
+	dib = FreeImage_Clone(reference);
+	FIBITMAP *clone = FreeImage_CloneShared(dib);
+	assert(FreeImage_GetBits(clone) == FreeImage_GetBits(dib));
+	assert(FreeImage_IsShared(clone) && sameImage(clone, reference));
+
+	// writing the clone leaves the original image untouched
+	bResult = FreeImage_MakeWritable(clone);
+	assert(bResult);
+	assert(FreeImage_GetBits(clone) != FreeImage_GetBits(dib));
+	assert(!FreeImage_IsShared(clone) && sameImage(clone, reference));
+	bResult = FreeImage_Invert(clone);
+	assert(bResult);
+	assert(sameImage(dib, reference));
+	FreeImage_Unload(clone);
+
+	// the last copy is written in place
+	clone = FreeImage_CloneShared(dib);
+	FreeImage_Unload(clone);
+	bits = FreeImage_GetBits(dib);
+	bResult = FreeImage_MakeWritable(dib);
+	assert(bResult && (FreeImage_GetBits(dib) == bits));
+
+	// copy-on-write sub images
+	// -------------------------------
+	FIBITMAP *copy = FreeImage_Copy(dib, width / 4, height / 4, width / 2, height / 2);
+	FIBITMAP *shared_copy = FreeImage_CopyShared(dib, width / 4, height / 4, width / 2, height / 2);
+	assert(FreeImage_IsShared(shared_copy) && sameImage(copy, shared_copy));
+	// writing the backing image leaves the sub image untouched
+	bResult = FreeImage_MakeWritable(dib);
+	assert(bResult && !FreeImage_IsShared(dib));
+	bResult = FreeImage_Invert(dib);
+	assert(bResult);
+	assert(sameImage(copy, shared_copy));
+	FreeImage_Unload(shared_copy);
+	FreeImage_Unload(copy);
+
+	// attached thumbnails are private copies of the given thumbnail
+	// -------------------------------
+	FIBITMAP *thumbnail = FreeImage_Rescale(reference, 64, 48);
+	FIBITMAP *thumbnail_copy = FreeImage_Clone(thumbnail);
+	bResult = FreeImage_SetThumbnail(dib, thumbnail);
+	assert(bResult);
+	assert(!FreeImage_IsShared(FreeImage_GetThumbnail(dib)) && !FreeImage_IsShared(thumbnail));
+	assert(FreeImage_GetBits(FreeImage_GetThumbnail(dib)) != FreeImage_GetBits(thumbnail));
+	bResult = FreeImage_Invert(thumbnail);
+	assert(bResult);
+	FreeImage_Unload(thumbnail);
+	assert(sameImage(FreeImage_GetThumbnail(dib), thumbnail_copy));
+	// so are the thumbnails of clones
+	clone = FreeImage_Clone(dib);
+	assert(!FreeImage_IsShared(FreeImage_GetThumbnail(clone)));
+	bResult = FreeImage_Invert(FreeImage_GetThumbnail(clone));
+	assert(bResult);
+	assert(sameImage(FreeImage_GetThumbnail(dib), thumbnail_copy));
+	FreeImage_Unload(clone);
+	FreeImage_Unload(thumbnail_copy);
+
+	// user provided buffers are never shared
+	// -------------------------------
+	FIBITMAP *wrapper = FreeImage_ConvertFromRawBitsEx(FALSE, FreeImage_GetBits(reference), FreeImage_GetImageType(reference), 
+		width, height, FreeImage_GetPitch(reference), FreeImage_GetBPP(reference), 
+		FreeImage_GetRedMask(reference), FreeImage_GetGreenMask(reference), FreeImage_GetBlueMask(reference), FALSE);
+	assert(wrapper != NULL);
+	clone = FreeImage_CloneShared(wrapper);
+	assert(!FreeImage_IsShared(clone) && (FreeImage_GetBits(clone) != FreeImage_GetBits(wrapper)));
+	assert(sameImage(clone, reference));
+	FreeImage_Unload(clone);
+	FreeImage_Unload(wrapper);
+
+	FreeImage_Unload(dib);
+	FreeImage_Unload(reference);
+}